@@ -24,6 +24,7 @@ cp ./release/bin/jaldb_tool 		%{buildroot}/usr/bin
 cp ./release/bin/jal_dump 		%{buildroot}/usr/bin
 cp ./release/bin/jalp_test 		%{buildroot}/usr/bin
 cp ./release/bin/jal_purge 		%{buildroot}/usr/bin
+cp ./release/bin/jaldb_migrate 		%{buildroot}/usr/bin
 
 mkdir -p %{buildroot}/usr/lib64
 cp ./release/lib/libjal-common.so 	%{buildroot}/usr/lib64
@@ -72,6 +73,7 @@ mkdir -p %{buildroot}/var/log/jalop
 /usr/bin/jal_dump
 /usr/bin/jalp_test
 /usr/bin/jal_purge
+/usr/bin/jaldb_migrate
 
 /usr/lib64/libjal-common.so
 /usr/lib64/libjal-db.so
@@ -0,0 +1,214 @@
+/**
+ * @file jaldb_arena.c This file contains the bump allocator that holds the
+ * strings and segments of one jaldb_record.
+ *
+ * @section LICENSE
+ *
+ * Source code in 3rd-party is licensed and owned by their respective
+ * copyright holders.
+ *
+ * All other source code is copyright Tresys Technology and licensed as below.
+ *
+ * Copyright (c) 2012 Tresys Technology LLC, Columbia, Maryland, USA
+ *
+ * This software was developed by Tresys Technology LLC
+ * with U.S. Government sponsorship.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <jalop/jal_status.h>
+#include "jal_alloc.h"
+#include "jal_error_callback_internal.h"
+
+#include "jaldb_arena.h"
+
+#define JALDB_ARENA_ALIGN 8
+
+struct jaldb_arena_chunk {
+	struct jaldb_arena_chunk *next;
+	size_t size;
+	size_t used;
+	uint8_t *data;
+};
+
+struct jaldb_arena {
+	/** The chunk allocations are made from, followed by the others */
+	struct jaldb_arena_chunk *chunks;
+	/** The chunk that comes with the arena, which is never freed */
+	struct jaldb_arena_chunk first;
+	/** The next arena in the pool of the thread */
+	struct jaldb_arena *next_free;
+	/** The number of arenas in the pool from this one on */
+	int pool_len;
+};
+
+static pthread_once_t jaldb_arena_once = PTHREAD_ONCE_INIT;
+static pthread_key_t jaldb_arena_pool_key;
+
+/**
+ * Free every chunk but the first, and empty the first.
+ */
+static void jaldb_arena_reset(struct jaldb_arena *arena)
+{
+	struct jaldb_arena_chunk *chunk = arena->chunks;
+	while (chunk) {
+		struct jaldb_arena_chunk *next = chunk->next;
+		if (chunk != &arena->first) {
+			free(chunk);
+		}
+		chunk = next;
+	}
+	arena->first.next = NULL;
+	arena->first.used = 0;
+	arena->chunks = &arena->first;
+}
+
+static void jaldb_arena_destroy(struct jaldb_arena *arena)
+{
+	jaldb_arena_reset(arena);
+	free(arena);
+}
+
+static void jaldb_arena_pool_destroy(void *pool)
+{
+	struct jaldb_arena *arena = pool;
+	while (arena) {
+		struct jaldb_arena *next = arena->next_free;
+		jaldb_arena_destroy(arena);
+		arena = next;
+	}
+}
+
+static void jaldb_arena_pool_init()
+{
+	pthread_key_create(&jaldb_arena_pool_key, jaldb_arena_pool_destroy);
+}
+
+struct jaldb_arena *jaldb_arena_get()
+{
+	pthread_once(&jaldb_arena_once, jaldb_arena_pool_init);
+
+	struct jaldb_arena *arena = pthread_getspecific(jaldb_arena_pool_key);
+	if (arena) {
+		pthread_setspecific(jaldb_arena_pool_key, arena->next_free);
+		arena->next_free = NULL;
+		return arena;
+	}
+
+	// The first chunk's data follows the arena in the same allocation
+	arena = jal_malloc(sizeof(*arena) + JALDB_ARENA_CHUNK_SIZE);
+	arena->first.next = NULL;
+	arena->first.size = JALDB_ARENA_CHUNK_SIZE;
+	arena->first.used = 0;
+	arena->first.data = (uint8_t *) (arena + 1);
+	arena->chunks = &arena->first;
+	arena->next_free = NULL;
+	arena->pool_len = 0;
+	return arena;
+}
+
+void jaldb_arena_put(struct jaldb_arena **arena)
+{
+	if (!arena || !*arena) {
+		return;
+	}
+	struct jaldb_arena *a = *arena;
+	*arena = NULL;
+
+	jaldb_arena_reset(a);
+
+	pthread_once(&jaldb_arena_once, jaldb_arena_pool_init);
+	struct jaldb_arena *pool = pthread_getspecific(jaldb_arena_pool_key);
+	int pool_len = pool ? pool->pool_len : 0;
+	if (pool_len >= JALDB_ARENA_POOL_SIZE) {
+		jaldb_arena_destroy(a);
+		return;
+	}
+	a->next_free = pool;
+	a->pool_len = pool_len + 1;
+	pthread_setspecific(jaldb_arena_pool_key, a);
+}
+
+void *jaldb_arena_alloc(struct jaldb_arena *arena, size_t size)
+{
+	// Every allocation gets its own byte, so jaldb_arena_owns() holds
+	// for it even at the very end of a chunk.
+	if (0 == size) {
+		size = 1;
+	}
+	size_t aligned = (size + JALDB_ARENA_ALIGN - 1) & ~((size_t) JALDB_ARENA_ALIGN - 1);
+	struct jaldb_arena_chunk *chunk = arena->chunks;
+
+	if (aligned < size) {
+		jal_error_handler(JAL_E_NO_MEM);
+	}
+	if (aligned <= chunk->size - chunk->used) {
+		void *ret = chunk->data + chunk->used;
+		chunk->used += aligned;
+		return ret;
+	}
+
+	size_t chunk_size = aligned > JALDB_ARENA_CHUNK_SIZE ? aligned : JALDB_ARENA_CHUNK_SIZE;
+	struct jaldb_arena_chunk *added = jal_malloc(sizeof(*added) + chunk_size);
+	added->size = chunk_size;
+	added->used = aligned;
+	added->data = (uint8_t *) (added + 1);
+	if (aligned > JALDB_ARENA_CHUNK_SIZE / 2) {
+		// Big enough to fill a chunk of its own. Keep allocating from
+		// the current chunk, which likely has more room left.
+		added->next = chunk->next;
+		chunk->next = added;
+		return added->data;
+	}
+	added->next = chunk;
+	arena->chunks = added;
+	return added->data;
+}
+
+void *jaldb_arena_calloc(struct jaldb_arena *arena, size_t size)
+{
+	void *ret = jaldb_arena_alloc(arena, size);
+	memset(ret, 0, size);
+	return ret;
+}
+
+char *jaldb_arena_strdup(struct jaldb_arena *arena, const char *str)
+{
+	if (!str) {
+		return NULL;
+	}
+	size_t len = strlen(str) + 1;
+	char *ret = jaldb_arena_alloc(arena, len);
+	memcpy(ret, str, len);
+	return ret;
+}
+
+int jaldb_arena_owns(const struct jaldb_arena *arena, const void *ptr)
+{
+	const uint8_t *p = ptr;
+	if (!arena || !p) {
+		return 0;
+	}
+	for (const struct jaldb_arena_chunk *chunk = arena->chunks; chunk; chunk = chunk->next) {
+		if (p >= chunk->data && p < chunk->data + chunk->size) {
+			return 1;
+		}
+	}
+	return 0;
+}
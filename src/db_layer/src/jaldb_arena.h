@@ -0,0 +1,117 @@
+/**
+ * @file jaldb_arena.h This file defines the bump allocator that holds the
+ * strings and segments of one jaldb_record.
+ *
+ * @section LICENSE
+ *
+ * Source code in 3rd-party is licensed and owned by their respective
+ * copyright holders.
+ *
+ * All other source code is copyright Tresys Technology and licensed as below.
+ *
+ * Copyright (c) 2012 Tresys Technology LLC, Columbia, Maryland, USA
+ *
+ * This software was developed by Tresys Technology LLC
+ * with U.S. Government sponsorship.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+
+#ifndef _JALDB_ARENA_H_
+#define _JALDB_ARENA_H_
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * The bytes an arena holds without going back to malloc(), enough for the
+ * strings, segments and system metadata of a typical record.
+ */
+#define JALDB_ARENA_CHUNK_SIZE 8192
+
+/**
+ * The most released arenas each thread keeps for reuse.
+ */
+#define JALDB_ARENA_POOL_SIZE 8
+
+/**
+ * A bump allocator. Memory is handed out in order from a chunk, and is only
+ * given back when the whole arena is released with jaldb_arena_put().
+ */
+struct jaldb_arena;
+
+/**
+ * Get an empty arena, reusing one released by this thread if there is one.
+ *
+ * @return The arena.
+ */
+struct jaldb_arena *jaldb_arena_get();
+
+/**
+ * Release everything allocated from an arena. The arena is kept for the
+ * next jaldb_arena_get() on this thread, or freed if this thread already
+ * keeps #JALDB_ARENA_POOL_SIZE arenas.
+ *
+ * @param[in,out] arena The arena to release. Set to NULL.
+ */
+void jaldb_arena_put(struct jaldb_arena **arena);
+
+/**
+ * Allocate memory from an arena. The memory is aligned for any of the
+ * jaldb structures and is not zeroed.
+ *
+ * @param[in] arena The arena.
+ * @param[in] size The number of bytes to allocate.
+ *
+ * @return The memory, valid until the arena is released.
+ */
+void *jaldb_arena_alloc(struct jaldb_arena *arena, size_t size);
+
+/**
+ * Allocate zeroed memory from an arena.
+ *
+ * @param[in] arena The arena.
+ * @param[in] size The number of bytes to allocate.
+ *
+ * @return The memory, valid until the arena is released.
+ */
+void *jaldb_arena_calloc(struct jaldb_arena *arena, size_t size);
+
+/**
+ * Copy a string into an arena.
+ *
+ * @param[in] arena The arena.
+ * @param[in] str The string to copy, or NULL.
+ *
+ * @return The copy, or NULL if \p str is NULL.
+ */
+char *jaldb_arena_strdup(struct jaldb_arena *arena, const char *str);
+
+/**
+ * Check whether memory came from an arena.
+ *
+ * @param[in] arena The arena.
+ * @param[in] ptr The memory, or NULL.
+ *
+ * @return 1 if \p ptr was allocated from \p arena, 0 otherwise.
+ */
+int jaldb_arena_owns(const struct jaldb_arena *arena, const void *ptr);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _JALDB_ARENA_H_
@@ -29,27 +29,37 @@
 
 #define __STDC_FORMAT_MACROS
 
+#include <deque>
+#include <errno.h>
 #include <fcntl.h>
 #include <jalop/jal_status.h>
 #include <inttypes.h> // For PRIu64
 #include <list>
+#include <pthread.h>
 #include <sstream>
 #include <string.h>
 #include <sys/stat.h>
+#include <sys/time.h>
+#include <time.h>
+#include <vector>
 
 #include "jal_alloc.h"
 #include "jal_error_callback_internal.h"
 #include "jal_asprintf_internal.h"
 
 #include "jaldb_context.hpp"
+#include "jaldb_datetime.h"
 #include "jaldb_record.h"
 #include "jaldb_record_dbs.h"
+#include "jaldb_record_view.h"
 #include "jaldb_record_xml.h"
 #include "jaldb_segment.h"
 #include "jaldb_serialize_record.h"
 #include "jaldb_nonce.h"
+#include "jaldb_notify.h"
 #include "jaldb_status.h"
 #include "jaldb_strings.h"
+#include "jaldb_sys_meta_cache.h"
 #include "jaldb_utils.h"
 
 using namespace std;
@@ -58,6 +68,47 @@ using namespace std;
 
 static enum jaldb_status jaldb_remove_record_from_db(jaldb_context *ctx, jaldb_record_dbs *rdbs, const char *nonce);
 
+/**
+ * A single record handed to jaldb_insert_batch().
+ */
+struct jaldb_insert_req {
+	struct jaldb_record *rec;	//!< The record to insert
+	int update_network_nonce;	//!< Whether the network nonce is generated from the primary key
+	char *nonce;			//!< The nonce assigned to the record
+	enum jaldb_status status;	//!< The result of inserting this record
+	bool done;			//!< Set once the batch holding this record has finished
+};
+
+/**
+ * State for combining inserts from concurrent callers into one transaction.
+ */
+struct jaldb_group_commit {
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	bool enabled;				//!< Whether jaldb_insert_record() joins a group
+	size_t max_records;			//!< Maximum number of records per transaction
+	uint64_t max_bytes;			//!< Maximum in-memory bytes per transaction
+	uint32_t max_delay_usec;		//!< How long a leader waits for a batch to fill
+	bool committing;			//!< Whether a leader currently owns a batch
+	uint64_t pending_bytes;			//!< In-memory bytes of the pending requests
+	std::deque<jaldb_insert_req *> pending;	//!< Requests waiting for a leader
+	struct jaldb_group_commit_stats stats;	//!< Batch metrics, protected by lock
+
+	jaldb_group_commit() : enabled(false), max_records(1), max_bytes(UINT64_MAX),
+		max_delay_usec(0), committing(false), pending_bytes(0)
+	{
+		pthread_mutex_init(&lock, NULL);
+		pthread_cond_init(&cond, NULL);
+		memset(&stats, 0, sizeof(stats));
+	}
+
+	~jaldb_group_commit()
+	{
+		pthread_cond_destroy(&cond);
+		pthread_mutex_destroy(&lock);
+	}
+};
+
 jaldb_context *jaldb_context_create()
 {
 	jaldb_context *context = (jaldb_context *)jal_calloc(1, sizeof(*context));
@@ -150,20 +201,23 @@ enum jaldb_status jaldb_context_init(
 		return JALDB_E_INVAL;
 	}
 
+	enum jaldb_primary_key_format key_format = (JDB_TIME_ORDERED_KEYS & jdb_flags) ?
+		JALDB_PRIMARY_KEY_TIME_ORDERED : JALDB_PRIMARY_KEY_UUID;
+
 	enum jaldb_status ret;
-	ret = jaldb_create_primary_dbs_with_indices(env, db_txn, "log", db_flags, &ctx->log_dbs);
+	ret = jaldb_create_primary_dbs_with_indices(env, db_txn, "log", db_flags, key_format, &ctx->log_dbs);
 	if (ret != JALDB_OK) {
 		db_txn->abort(db_txn);
 		return JALDB_E_INVAL;
 	}
 
-	ret = jaldb_create_primary_dbs_with_indices(env, db_txn, "audit", db_flags, &ctx->audit_dbs);
+	ret = jaldb_create_primary_dbs_with_indices(env, db_txn, "audit", db_flags, key_format, &ctx->audit_dbs);
 	if (ret != JALDB_OK) {
 		db_txn->abort(db_txn);
 		return JALDB_E_INVAL;
 	}
 
-	ret = jaldb_create_primary_dbs_with_indices(env, db_txn, "journal", db_flags, &ctx->journal_dbs);
+	ret = jaldb_create_primary_dbs_with_indices(env, db_txn, "journal", db_flags, key_format, &ctx->journal_dbs);
 	if (ret != JALDB_OK) {
 		db_txn->abort(db_txn);
 		return JALDB_E_INVAL;
@@ -214,9 +268,10 @@ enum jaldb_status jaldb_context_init(
 	db_txn->commit(db_txn, 0);
 	ctx->env = env;
 
-	ctx->seen_journal_records = new std::set<string>();
-	ctx->seen_audit_records = new std::set<string>();
-	ctx->seen_log_records = new std::set<string>();
+	ctx->group_commit = new jaldb_group_commit();
+
+	// Readers fall back to polling if the notification file can't be set up
+	ctx->notify = jaldb_notify_open(db_root, ctx->db_read_only);
 
 	return JALDB_OK;
 }
@@ -246,9 +301,8 @@ void jaldb_context_destroy(jaldb_context **ctx)
 	jaldb_destroy_record_dbs(&(ctxp->audit_dbs));
 	jaldb_destroy_record_dbs(&(ctxp->log_dbs));
 
-	delete ctxp->seen_journal_records;
-	delete ctxp->seen_audit_records;
-	delete ctxp->seen_log_records;
+	delete ctxp->group_commit;
+	jaldb_notify_close(&ctxp->notify);
 
 	if (ctxp->env) {
 		ctxp->env->close(ctxp->env, 0);
@@ -265,6 +319,34 @@ std::string jaldb_make_temp_db_name(const string &id, const string &suffix)
         return o.str();
 }
 
+/**
+ * Set and clear state flags of a record in \p txn. Only the state DB is
+ * written, and only if the state changes.
+ *
+ * @param[in] rdbs The DBs of the record.
+ * @param[in] txn The transaction to use.
+ * @param[in] pkey The primary key of the record.
+ * @param[in] set The state flags to set.
+ * @param[in] clear The state flags to clear.
+ * @param[out] old_state The state of the record before the change.
+ *
+ * @return 0 on success, DB_NOTFOUND if there is no such record, or another
+ * Berkeley DB error.
+ */
+static int jaldb_update_record_state(struct jaldb_record_dbs *rdbs, DB_TXN *txn,
+		DBT *pkey, uint32_t set, uint32_t clear, uint32_t *old_state)
+{
+	int db_ret = jaldb_record_dbs_get_state(rdbs, txn, pkey, old_state, DB_RMW);
+	if (0 != db_ret) {
+		return db_ret;
+	}
+	uint32_t state = (*old_state | set) & ~clear;
+	if (state == *old_state) {
+		return 0;
+	}
+	return jaldb_record_dbs_put_state(rdbs, txn, pkey, state);
+}
+
 enum jaldb_status jaldb_mark_sent(
 	jaldb_context *ctx,
 	enum jaldb_rec_type type,
@@ -276,20 +358,15 @@ enum jaldb_status jaldb_mark_sent(
 
 	struct jaldb_record_dbs *rdbs = NULL;
 
-	int byte_swap;
-
-	struct jaldb_serialize_record_headers *header_ptr = NULL;
-	size_t header_bytes = sizeof(jaldb_serialize_record_headers);
+	uint32_t old_state;
 	DB_TXN *txn = NULL;
 	DBT key;
-	DBT val;
 
 	if (!ctx || !type || !nonce) {
 		return JALDB_E_INVAL;
 	}
 
 	memset(&key, 0, sizeof(key));
-	memset(&val, 0, sizeof(val));
 
 	switch (type) {
 	case JALDB_RTYPE_JOURNAL:
@@ -302,73 +379,41 @@ enum jaldb_status jaldb_mark_sent(
 		rdbs = ctx->log_dbs;
 		break;
 	default:
-		ret = JALDB_E_INVAL;
-		goto out;
+		return JALDB_E_INVAL;
 	}
 
 	if (!rdbs || !rdbs->record_id_idx_db) {
-		ret = JALDB_E_INVAL;
-		goto out;
+		return JALDB_E_INVAL;
 	}
-
-	key.flags = DB_DBT_REALLOC;
-	key.size = strlen(nonce)+1;
-	key.data = jal_strdup(nonce);
-
-	val.flags = DB_DBT_REALLOC | DB_DBT_PARTIAL;
-	val.dlen = header_bytes;
-	val.size = header_bytes;
-	val.doff = 0;
-	val.data = jal_malloc(header_bytes);
-
-	db_ret = rdbs->primary_db->get_byteswapped(rdbs->primary_db, &byte_swap);
-	if (0 != db_ret){
-		ret = JALDB_E_INVAL;
-		goto out;
+	if (!rdbs->state_db) {
+		return JALDB_E_READ_ONLY;
+	}
+	if (0 != target_state && 1 != target_state) {
+		return JALDB_OK;
 	}
 
+	key.data = (void *) nonce;
+	key.size = strlen(nonce) + 1;
+
 	while (1) {
 		db_ret = ctx->env->txn_begin(ctx->env, NULL, &txn, 0);
 		if (0 != db_ret) {
-			ret = JALDB_E_DB;
-			goto out;
+			return JALDB_E_DB;
 		}
 
-		db_ret = rdbs->primary_db->get(rdbs->primary_db, txn, &key, &val, DB_DEGREE_2);
+		if (1 == target_state) {
+			db_ret = jaldb_update_record_state(rdbs, txn, &key,
+					JALDB_RFLAGS_SENT, 0, &old_state);
+		} else {
+			db_ret = jaldb_update_record_state(rdbs, txn, &key,
+					0, JALDB_RFLAGS_SENT | JALDB_RFLAGS_SYNCED, &old_state);
+		}
 		if (0 == db_ret) {
-			header_ptr = (struct jaldb_serialize_record_headers *)val.data;
-			if (header_ptr->version != JALDB_DB_LAYOUT_VERSION) {
-				txn->abort(txn);
-				ret = JALDB_E_INVAL;
-				goto out;
-			// Check to see if state matches target - nothing to do if they match
-			} else if (((header_ptr->flags & JALDB_RFLAGS_SENT) ? 1 : 0) == target_state) {
-				txn->abort(txn);
-				goto out;
-			// Update the state
+			db_ret = txn->commit(txn, 0);
+			if (0 == db_ret) {
+				break;
 			} else {
-				if (1 == target_state) {
-					// Set the flag
-					header_ptr->flags |= JALDB_RFLAGS_SENT;
-				}
-				else if (0 == target_state){
-					// Clear the flag
-					header_ptr->flags &= ~JALDB_RFLAGS_SENT;
-					header_ptr->flags &= ~JALDB_RFLAGS_SYNCED;
-				} else {
-					txn->abort(txn);
-					goto out;
-				}
-
-				db_ret = rdbs->primary_db->put(rdbs->primary_db, txn, &key, &val, 0);
-				if (0 == db_ret) {
-					db_ret = txn->commit(txn, 0);
-					if (0 == db_ret) {
-						break;
-					} else {
-						continue;
-					}
-				}
+				continue;
 			}
 		}
 
@@ -377,17 +422,103 @@ enum jaldb_status jaldb_mark_sent(
 			continue;
 		} else if (DB_NOTFOUND == db_ret) {
 			ret = JALDB_E_NOT_FOUND;
-			goto out;
+			break;
 		}
 
 		/* Something else went wrong... */
 		ret = JALDB_E_DB;
-		goto out;
+		break;
 	}
 
-out:
-	free(key.data);
-	free(val.data);
+	return ret;
+}
+
+enum jaldb_status jaldb_mark_sent_batch(
+	jaldb_context *ctx,
+	enum jaldb_rec_type type,
+	char * const *nonces,
+	size_t count,
+	int target_state)
+{
+	enum jaldb_status ret = JALDB_OK;
+	int db_ret;
+	struct jaldb_record_dbs *rdbs = NULL;
+	uint32_t old_state;
+	DB_TXN *txn = NULL;
+	DBT key;
+
+	if (!ctx || !type || (count && !nonces) || (0 != target_state && 1 != target_state)) {
+		return JALDB_E_INVAL;
+	}
+
+	switch (type) {
+	case JALDB_RTYPE_JOURNAL:
+		rdbs = ctx->journal_dbs;
+		break;
+	case JALDB_RTYPE_AUDIT:
+		rdbs = ctx->audit_dbs;
+		break;
+	case JALDB_RTYPE_LOG:
+		rdbs = ctx->log_dbs;
+		break;
+	default:
+		return JALDB_E_INVAL;
+	}
+
+	if (!rdbs || !rdbs->primary_db) {
+		return JALDB_E_INVAL;
+	}
+	if (!rdbs->state_db) {
+		return JALDB_E_READ_ONLY;
+	}
+	if (0 == count) {
+		return JALDB_OK;
+	}
+
+	memset(&key, 0, sizeof(key));
+
+	while (1) {
+		db_ret = ctx->env->txn_begin(ctx->env, NULL, &txn, 0);
+		if (0 != db_ret) {
+			return JALDB_E_DB;
+		}
+
+		for (size_t i = 0; i < count; i++) {
+			key.data = nonces[i];
+			key.size = strlen(nonces[i]) + 1;
+
+			if (1 == target_state) {
+				db_ret = jaldb_update_record_state(rdbs, txn, &key,
+						JALDB_RFLAGS_SENT, 0, &old_state);
+			} else {
+				db_ret = jaldb_update_record_state(rdbs, txn, &key,
+						0, JALDB_RFLAGS_SENT | JALDB_RFLAGS_SYNCED, &old_state);
+			}
+			if (DB_NOTFOUND == db_ret) {
+				// Purged since it was read
+				db_ret = 0;
+			} else if (0 != db_ret) {
+				break;
+			}
+		}
+
+		if (0 == db_ret) {
+			db_ret = txn->commit(txn, 0);
+			if (0 != db_ret) {
+				JALDB_DB_ERR(rdbs->state_db, db_ret);
+				ret = JALDB_E_DB;
+			}
+			break;
+		}
+
+		txn->abort(txn);
+		if (DB_LOCK_DEADLOCK == db_ret) {
+			continue;
+		}
+		JALDB_DB_ERR(rdbs->state_db, db_ret);
+		ret = JALDB_E_DB;
+		break;
+	}
 	return ret;
 }
 
@@ -401,21 +532,15 @@ enum jaldb_status jaldb_mark_synced(
 
 	struct jaldb_record_dbs *rdbs = NULL;
 
-	int byte_swap;
-
-	struct jaldb_serialize_record_headers *header_ptr = NULL;
-	size_t header_bytes = sizeof(jaldb_serialize_record_headers);
-
+	uint32_t old_state;
 	DB_TXN *txn = NULL;
 	DBT key;
-	DBT val;
 
 	if (!ctx || !type || !nonce) {
 		return JALDB_E_INVAL;
 	}
 
 	memset(&key, 0, sizeof(key));
-	memset(&val, 0, sizeof(val));
 
 	switch (type) {
 	case JALDB_RTYPE_JOURNAL:
@@ -428,64 +553,33 @@ enum jaldb_status jaldb_mark_synced(
 		rdbs = ctx->log_dbs;
 		break;
 	default:
-		ret = JALDB_E_INVAL;
-		goto out;
+		return JALDB_E_INVAL;
 	}
 
 	if (!rdbs || !rdbs->record_id_idx_db) {
-		ret = JALDB_E_INVAL;
-		goto out;
+		return JALDB_E_INVAL;
 	}
-
-	key.flags = DB_DBT_REALLOC;
-	key.size = strlen(nonce)+1;
-	key.data = jal_strdup(nonce);
-
-	val.flags = DB_DBT_REALLOC | DB_DBT_PARTIAL;
-	val.dlen = header_bytes;
-	val.size = header_bytes;
-	val.doff = 0;
-	val.data = jal_malloc(header_bytes);
-
-	db_ret = rdbs->primary_db->get_byteswapped(rdbs->primary_db, &byte_swap);
-	if (0 != db_ret){
-		ret = JALDB_E_INVAL;
-		goto out;
+	if (!rdbs->state_db) {
+		return JALDB_E_READ_ONLY;
 	}
 
+	key.data = (void *) nonce;
+	key.size = strlen(nonce) + 1;
+
 	while (1) {
 		db_ret = ctx->env->txn_begin(ctx->env, NULL, &txn, 0);
 		if (0 != db_ret) {
-			ret = JALDB_E_DB;
-			goto out;
+			return JALDB_E_DB;
 		}
 
-		db_ret = rdbs->primary_db->get(rdbs->primary_db, txn, &key, &val, DB_DEGREE_2);
+		db_ret = jaldb_update_record_state(rdbs, txn, &key,
+				JALDB_RFLAGS_SYNCED, 0, &old_state);
 		if (0 == db_ret) {
-			header_ptr = (struct jaldb_serialize_record_headers *)val.data;
-			if (header_ptr->version != JALDB_DB_LAYOUT_VERSION) {
-				txn->abort(txn);
-				ret = JALDB_E_INVAL;
-				goto out;
-
-			} else if (header_ptr->flags & JALDB_RFLAGS_SYNCED) {
-				txn->abort(txn);
-				goto out;
-
+			db_ret = txn->commit(txn, 0);
+			if (0 == db_ret) {
+				break;
 			} else {
-				header_ptr->flags |= JALDB_RFLAGS_SYNCED;
-
-				db_ret = rdbs->primary_db->put(rdbs->primary_db, txn, &key, &val, 0);
-
-				if (0 == db_ret) {
-					db_ret = txn->commit(txn, 0);
-
-					if (0 == db_ret) {
-						break;
-					} else {
-						continue;
-					}
-				}
+				continue;
 			}
 		}
 
@@ -494,17 +588,14 @@ enum jaldb_status jaldb_mark_synced(
 			continue;
 		} else if (DB_NOTFOUND == db_ret) {
 			ret = JALDB_E_NOT_FOUND;
-			goto out;
+			break;
 		}
 
 		/* Something else went wrong... */
 		ret = JALDB_E_DB;
-		goto out;
+		break;
 	}
 
-out:
-	free(key.data);
-	free(val.data);
 	return ret;
 }
 
@@ -525,6 +616,7 @@ enum jaldb_status jaldb_mark_confirmed(
 
 	int byte_swap;
 
+	uint32_t old_state;
 	struct jaldb_serialize_record_headers *header_ptr = NULL;
 	size_t header_bytes = sizeof(jaldb_serialize_record_headers);
 	DB_TXN *txn = NULL;
@@ -559,6 +651,10 @@ enum jaldb_status jaldb_mark_confirmed(
 		ret = JALDB_E_INVAL;
 		goto out;
 	}
+	if (!rdbs->state_db) {
+		ret = JALDB_E_READ_ONLY;
+		goto out;
+	}
 
 	timestamp_bytes = header_bytes + JALDB_TIMESTAMP_LENGTH + 1;
 	network_nonce_bytes = timestamp_bytes + JALDB_MAX_NETWORK_NONCE_LENGTH + 1;
@@ -596,39 +692,41 @@ enum jaldb_status jaldb_mark_confirmed(
 				txn->abort(txn);
 				ret = JALDB_E_INVAL;
 				goto out;
-
-			} else if (header_ptr->flags & JALDB_RFLAGS_CONFIRMED) {
+			}
+			db_ret = jaldb_update_record_state(rdbs, txn, &pkey,
+					JALDB_RFLAGS_CONFIRMED, 0, &old_state);
+		}
+		if (0 == db_ret) {
+			if (old_state & JALDB_RFLAGS_CONFIRMED) {
 				txn->abort(txn);
 				ret = JALDB_E_INTERNAL_ERROR;
 				goto out;
+			}
 
-			} else {
-				header_ptr->flags |= JALDB_RFLAGS_CONFIRMED;
+			// Update the network nonce. This is the only change to
+			// the record itself, its state is in the state DB.
 
-				// Update the network nonce.
+			buffer = (uint8_t *) header_ptr;
+			buffer += timestamp_bytes;
 
-				buffer = (uint8_t *) header_ptr;
-				buffer += timestamp_bytes;
+			// Don't include the null terminator.
+			memcpy(buffer, pkey.data, pkey.size - 1);
+			buffer += (pkey.size - 1);
 
-				// Don't include the null terminator.
-				memcpy(buffer, pkey.data, pkey.size - 1);
-				buffer += (pkey.size - 1);
+			// Account for the null terminator now.
+			memset(buffer, '\0', (JALDB_MAX_NETWORK_NONCE_LENGTH - pkey.size + 1));
 
-				// Account for the null terminator now.
-				memset(buffer, '\0', (JALDB_MAX_NETWORK_NONCE_LENGTH - pkey.size + 1));
+			db_ret = rdbs->primary_db->put(rdbs->primary_db, txn, &pkey, &val, 0);
 
-				db_ret = rdbs->primary_db->put(rdbs->primary_db, txn, &pkey, &val, 0);
+			if (0 == db_ret) {
+				db_ret = txn->commit(txn, 0);
 
 				if (0 == db_ret) {
-					db_ret = txn->commit(txn, 0);
-
-					if (0 == db_ret) {
-						*nonce_out = (char*) pkey.data;
-						pkey.data = NULL;
-						break;
-					} else {
-						continue;
-					}
+					*nonce_out = (char*) pkey.data;
+					pkey.data = NULL;
+					break;
+				} else {
+					continue;
 				}
 			}
 		}
@@ -1243,38 +1341,60 @@ out:
 	return ret;
 }
 
-enum jaldb_status jaldb_insert_record(jaldb_context *ctx, struct jaldb_record *rec, int confirmed, char **local_nonce)
+static uint64_t jaldb_usec_now()
 {
-	int byte_swap;
-	enum jaldb_status ret;
-	size_t buf_size = 0;
-	struct jaldb_record_dbs *rdbs = NULL;
-	uint8_t* buffer = NULL;
-	int db_ret;
-	int update_network_nonce = 0;
-	DBT key;
-	DBT val;
-	DB_TXN *txn;
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
 
-	if (!ctx || !rec || !local_nonce || *local_nonce) {
-		return JALDB_E_INVAL;
+static uint64_t jaldb_record_mem_size(const struct jaldb_record *rec)
+{
+	uint64_t size = 0;
+	const struct jaldb_segment *segs[] = { rec->sys_meta, rec->app_meta, rec->payload };
+	for (size_t i = 0; i < sizeof(segs) / sizeof(segs[0]); i++) {
+		if (segs[i] && !segs[i]->on_disk) {
+			size += segs[i]->length;
+		}
 	}
-	if (!rec->source) {
-		rec->source = jal_strdup("localhost");
+	return size;
+}
+
+static void jaldb_prepare_insert_req(struct jaldb_insert_req *req, struct jaldb_record *rec)
+{
+	memset(req, 0, sizeof(*req));
+	req->rec = rec;
+	req->status = JALDB_E_INVAL;
+	if (!rec) {
+		return;
 	}
-	if (!rec->network_nonce) {
-		update_network_nonce = 1;
+	if (!rec->source) {
+		rec->source = jaldb_record_strdup(rec, "localhost");
 	}
+	req->update_network_nonce = rec->network_nonce ? 0 : 1;
+	req->status = jaldb_record_sanity_check(rec);
+}
 
-	memset(&key, 0, sizeof(key));
-	memset(&val, 0, sizeof(val));
-
-	ret = jaldb_record_sanity_check(rec);
-	if (ret != JALDB_OK) {
-		goto out;
-	}
+/**
+ * Serialize a record and put it in its primary DB as part of \p txn. A new
+ * primary key is generated until one is found that does not exist yet.
+ *
+ * @return JALDB_OK on success, JALDB_E_INVAL for a bad record or
+ * JALDB_E_DB on a Berkeley DB error, in which case \p db_err_out holds the
+ * Berkeley DB error code.
+ */
+static enum jaldb_status jaldb_put_record(jaldb_context *ctx, DB_TXN *txn,
+		struct jaldb_insert_req *req, int *db_err_out)
+{
+	struct jaldb_record *rec = req->rec;
+	struct jaldb_record_dbs *rdbs = NULL;
+	enum jaldb_status ret;
+	int byte_swap;
+	int db_ret;
+	DBT key;
+	DBT val;
 
-	rec->confirmed = confirmed ? 1 : 0;
+	*db_err_out = 0;
 
 	switch(rec->type) {
 	case JALDB_RTYPE_JOURNAL:
@@ -1287,72 +1407,589 @@ enum jaldb_status jaldb_insert_record(jaldb_context *ctx, struct jaldb_record *r
 		rdbs = ctx->log_dbs;
 		break;
 	default:
-		ret = JALDB_E_INVAL;
-		goto out;
+		return JALDB_E_INVAL;
 	}
 
 	db_ret = rdbs->primary_db->get_byteswapped(rdbs->primary_db, &byte_swap);
 	if (0 != db_ret) {
-		ret = JALDB_E_INVAL;
-		goto out;
+		return JALDB_E_INVAL;
 	}
 
-	while (1) {
-		db_ret = ctx->env->txn_begin(ctx->env, NULL, &txn, 0);
-		if (0 != db_ret) {
-			ret = JALDB_E_INTERNAL_ERROR;
-			goto out;
-		}
+	memset(&val, 0, sizeof(val));
 
-		char *primary_key = jaldb_gen_primary_key(rec->uuid);
+	while (1) {
+		char *primary_key = (JALDB_PRIMARY_KEY_TIME_ORDERED == rdbs->primary_key_format) ?
+			jaldb_gen_time_ordered_primary_key(rec->uuid) :
+			jaldb_gen_primary_key(rec->uuid);
 		if (NULL == primary_key) {
-			ret = JALDB_E_INVAL;
-			goto out;
+			return JALDB_E_INVAL;
 		}
 
+		memset(&key, 0, sizeof(key));
 		key.data = primary_key;
 		key.size = strlen(primary_key) + 1;
-		key.flags = DB_DBT_REALLOC;
 
-		if (update_network_nonce) {
-			free(rec->network_nonce);
-			rec->network_nonce = jal_strdup(primary_key);
+		if (req->update_network_nonce) {
+			jaldb_record_set_string(rec, &rec->network_nonce, primary_key);
 		}
 
+		uint8_t *buffer = NULL;
+		size_t buf_size = 0;
 		ret = jaldb_serialize_record(byte_swap, rec, &buffer, &buf_size);
 		if (ret != JALDB_OK) {
-			goto out;
+			free(primary_key);
+			return ret;
 		}
 		val.data = buffer;
 		val.size = buf_size;
 
 		db_ret = rdbs->primary_db->put(rdbs->primary_db, txn, &key, &val, DB_NOOVERWRITE);
+		free(buffer);
 		if (0 == db_ret) {
-			db_ret = txn->commit(txn, 0);
+			db_ret = jaldb_record_dbs_put_state(rdbs, txn, &key,
+					jaldb_record_get_state(rec));
+		}
+		if (0 == db_ret) {
+			free(req->nonce);
+			req->nonce = primary_key;
+			return JALDB_OK;
+		}
+		free(primary_key);
+		if (DB_KEYEXIST != db_ret) {
+			*db_err_out = db_ret;
+			return JALDB_E_DB;
+		}
+	}
+}
+
+/**
+ * Insert every request whose status is JALDB_OK in a single transaction.
+ * The transaction is retried as a whole on deadlock. On return, each
+ * request's status and nonce hold the result for that record.
+ */
+static void jaldb_insert_batch(jaldb_context *ctx, struct jaldb_insert_req **reqs, size_t count)
+{
+	uint64_t start = jaldb_usec_now();
+	std::vector<bool> skip(count);
+	size_t inserted = 0;
+	enum jaldb_status batch_err = JALDB_OK;
+	DB_TXN *txn = NULL;
+	int db_ret;
+
+	for (size_t i = 0; i < count; i++) {
+		skip[i] = (JALDB_OK != reqs[i]->status);
+	}
+
+	while (1) {
+		inserted = 0;
+		db_ret = ctx->env->txn_begin(ctx->env, NULL, &txn, 0);
+		if (0 != db_ret) {
+			batch_err = JALDB_E_INTERNAL_ERROR;
+			break;
+		}
+
+		for (size_t i = 0; i < count && 0 == db_ret; i++) {
+			if (skip[i]) {
+				continue;
+			}
+			reqs[i]->status = jaldb_put_record(ctx, txn, reqs[i], &db_ret);
+			if (JALDB_OK == reqs[i]->status) {
+				inserted++;
+			} else if (JALDB_E_DB != reqs[i]->status) {
+				// Bad record, the rest of the batch can still go in.
+				skip[i] = true;
+			}
+		}
+
+		if (0 == db_ret) {
+			db_ret = txn->commit(txn, 0);
 		} else {
 			txn->abort(txn);
 		}
+		txn = NULL;
 		if (0 == db_ret) {
-			ret = JALDB_OK;
 			break;
 		}
-		if (DB_LOCK_DEADLOCK == db_ret || DB_KEYEXIST == db_ret) {
-			free(buffer);
-			buffer = NULL;
+		if (DB_LOCK_DEADLOCK != db_ret) {
+			batch_err = JALDB_E_DB;
+			break;
+		}
+	}
+
+	for (size_t i = 0; i < count; i++) {
+		if (skip[i]) {
 			continue;
+		}
+		if (JALDB_OK != batch_err) {
+			reqs[i]->status = batch_err;
+			free(reqs[i]->nonce);
+			reqs[i]->nonce = NULL;
+		}
+	}
+	if (JALDB_OK != batch_err) {
+		inserted = 0;
+	}
+
+	// Wake readers once the records are committed and can be found
+	int inserted_types = 0;
+	for (size_t i = 0; i < count && 0 < inserted; i++) {
+		if (!skip[i] && JALDB_OK == reqs[i]->status) {
+			inserted_types |= reqs[i]->rec->type;
+		}
+	}
+	if (inserted_types & JALDB_RTYPE_JOURNAL) {
+		jaldb_notify_post(ctx->notify, JALDB_RTYPE_JOURNAL);
+	}
+	if (inserted_types & JALDB_RTYPE_AUDIT) {
+		jaldb_notify_post(ctx->notify, JALDB_RTYPE_AUDIT);
+	}
+	if (inserted_types & JALDB_RTYPE_LOG) {
+		jaldb_notify_post(ctx->notify, JALDB_RTYPE_LOG);
+	}
+
+	uint64_t latency = jaldb_usec_now() - start;
+
+	pthread_mutex_lock(&ctx->group_commit->lock);
+	struct jaldb_group_commit_stats *stats = &ctx->group_commit->stats;
+	stats->batches++;
+	stats->records += inserted;
+	stats->last_batch_records = inserted;
+	stats->last_latency_usec = latency;
+	stats->total_latency_usec += latency;
+	if (inserted > stats->max_batch_records) {
+		stats->max_batch_records = inserted;
+	}
+	if (latency > stats->max_latency_usec) {
+		stats->max_latency_usec = latency;
+	}
+	pthread_mutex_unlock(&ctx->group_commit->lock);
+}
+
+/**
+ * Queue \p req for the next group transaction and wait for it to finish.
+ * The first waiting caller becomes the leader: it takes a batch from the
+ * pending queue, bounded by max_records and max_bytes, and inserts it on
+ * behalf of everybody in it. Callers arriving while a batch is being
+ * committed form the next batch.
+ */
+static void jaldb_group_insert(jaldb_context *ctx, struct jaldb_insert_req *req)
+{
+	struct jaldb_group_commit *gc = ctx->group_commit;
+	uint64_t req_bytes = jaldb_record_mem_size(req->rec);
+
+	pthread_mutex_lock(&gc->lock);
+	gc->pending.push_back(req);
+	gc->pending_bytes += req_bytes;
+	pthread_cond_broadcast(&gc->cond);
+
+	while (!req->done) {
+		if (gc->committing) {
+			pthread_cond_wait(&gc->cond, &gc->lock);
+			continue;
+		}
+		gc->committing = true;
+
+		if (gc->max_delay_usec > 0) {
+			struct timeval now;
+			struct timespec deadline;
+			gettimeofday(&now, NULL);
+			uint64_t usec = (uint64_t)now.tv_usec + gc->max_delay_usec;
+			deadline.tv_sec = now.tv_sec + usec / 1000000;
+			deadline.tv_nsec = (usec % 1000000) * 1000;
+			while (gc->pending.size() < gc->max_records && gc->pending_bytes < gc->max_bytes) {
+				if (ETIMEDOUT == pthread_cond_timedwait(&gc->cond, &gc->lock, &deadline)) {
+					break;
+				}
+			}
+		}
+
+		std::vector<jaldb_insert_req *> batch;
+		uint64_t batch_bytes = 0;
+		while (!gc->pending.empty() && batch.size() < gc->max_records) {
+			jaldb_insert_req *next = gc->pending.front();
+			uint64_t next_bytes = jaldb_record_mem_size(next->rec);
+			if (!batch.empty() && batch_bytes + next_bytes > gc->max_bytes) {
+				break;
+			}
+			batch.push_back(next);
+			batch_bytes += next_bytes;
+			gc->pending.pop_front();
+		}
+		gc->pending_bytes -= batch_bytes;
+
+		pthread_mutex_unlock(&gc->lock);
+		jaldb_insert_batch(ctx, &batch[0], batch.size());
+		pthread_mutex_lock(&gc->lock);
+
+		for (size_t i = 0; i < batch.size(); i++) {
+			batch[i]->done = true;
+		}
+		gc->committing = false;
+		pthread_cond_broadcast(&gc->cond);
+	}
+	pthread_mutex_unlock(&gc->lock);
+}
+
+enum jaldb_status jaldb_insert_record(jaldb_context *ctx, struct jaldb_record *rec, int confirmed, char **local_nonce)
+{
+	struct jaldb_insert_req req;
+
+	if (!ctx || !rec || !local_nonce || *local_nonce || !ctx->group_commit) {
+		return JALDB_E_INVAL;
+	}
+
+	rec->confirmed = confirmed ? 1 : 0;
+	jaldb_prepare_insert_req(&req, rec);
+	if (JALDB_OK != req.status) {
+		return req.status;
+	}
+
+	struct jaldb_insert_req *reqp = &req;
+	if (ctx->group_commit->enabled) {
+		jaldb_group_insert(ctx, reqp);
+	} else {
+		jaldb_insert_batch(ctx, &reqp, 1);
+	}
+
+	*local_nonce = req.nonce;
+	return req.status;
+}
+
+enum jaldb_status jaldb_insert_records(jaldb_context *ctx, struct jaldb_record **recs,
+		size_t count, int confirmed, char **local_nonces, enum jaldb_status *rec_status)
+{
+	if (!ctx || !recs || 0 == count || !local_nonces || !ctx->group_commit) {
+		return JALDB_E_INVAL;
+	}
+	for (size_t i = 0; i < count; i++) {
+		if (local_nonces[i]) {
+			return JALDB_E_INVAL;
+		}
+	}
+
+	std::vector<jaldb_insert_req> reqs(count);
+	std::vector<jaldb_insert_req *> reqps(count);
+	for (size_t i = 0; i < count; i++) {
+		if (recs[i]) {
+			recs[i]->confirmed = confirmed ? 1 : 0;
+		}
+		jaldb_prepare_insert_req(&reqs[i], recs[i]);
+		reqps[i] = &reqs[i];
+	}
+
+	jaldb_insert_batch(ctx, &reqps[0], count);
+
+	enum jaldb_status ret = JALDB_OK;
+	for (size_t i = 0; i < count; i++) {
+		local_nonces[i] = reqs[i].nonce;
+		if (rec_status) {
+			rec_status[i] = reqs[i].status;
+		}
+		if (JALDB_OK != reqs[i].status && JALDB_OK == ret) {
+			ret = reqs[i].status;
+		}
+	}
+	return ret;
+}
+
+enum jaldb_status jaldb_enable_group_commit(jaldb_context *ctx, uint32_t max_records,
+		uint64_t max_bytes, uint32_t max_delay_usec)
+{
+	if (!ctx || !ctx->group_commit) {
+		return JALDB_E_INVAL;
+	}
+	struct jaldb_group_commit *gc = ctx->group_commit;
+	pthread_mutex_lock(&gc->lock);
+	gc->enabled = (max_records > 1);
+	gc->max_records = max_records;
+	gc->max_bytes = max_bytes ? max_bytes : UINT64_MAX;
+	gc->max_delay_usec = max_delay_usec;
+	pthread_mutex_unlock(&gc->lock);
+	return JALDB_OK;
+}
+
+enum jaldb_status jaldb_get_group_commit_stats(jaldb_context *ctx,
+		struct jaldb_group_commit_stats *stats)
+{
+	if (!ctx || !ctx->group_commit || !stats) {
+		return JALDB_E_INVAL;
+	}
+	pthread_mutex_lock(&ctx->group_commit->lock);
+	*stats = ctx->group_commit->stats;
+	pthread_mutex_unlock(&ctx->group_commit->lock);
+	return JALDB_OK;
+}
+
+enum jaldb_status jaldb_set_sys_meta_cache(jaldb_context *ctx,
+		struct jaldb_sys_meta_cache *cache, int write_back)
+{
+	if (!ctx) {
+		return JALDB_E_INVAL;
+	}
+	if (write_back && ctx->db_read_only) {
+		return JALDB_E_READ_ONLY;
+	}
+	ctx->sys_meta_cache = cache;
+	ctx->sys_meta_write_back = write_back ? 1 : 0;
+	return JALDB_OK;
+}
+
+enum jaldb_status jaldb_get_insert_seq(jaldb_context *ctx, enum jaldb_rec_type type,
+		uint32_t *seq)
+{
+	if (!ctx) {
+		return JALDB_E_INVAL;
+	}
+	return jaldb_notify_seq(ctx->notify, type, seq);
+}
+
+enum jaldb_status jaldb_wait_for_insert(jaldb_context *ctx, enum jaldb_rec_type type,
+		uint32_t *seq, long timeout_ms)
+{
+	if (!ctx) {
+		return JALDB_E_INVAL;
+	}
+	return jaldb_notify_wait(ctx->notify, type, seq, timeout_ms);
+}
+
+enum jaldb_status jaldb_migrate_timestamp_keys(jaldb_context *ctx,
+		enum jaldb_rec_type type, uint32_t batch_size, uint64_t *migrated)
+{
+	struct jaldb_record_dbs *rdbs = NULL;
+	const char *prefix = NULL;
+
+	if (!ctx || !ctx->env) {
+		return JALDB_E_INVAL;
+	}
+	if (ctx->db_read_only) {
+		return JALDB_E_READ_ONLY;
+	}
+
+	switch(type) {
+	case JALDB_RTYPE_JOURNAL:
+		rdbs = ctx->journal_dbs;
+		prefix = "journal";
+		break;
+	case JALDB_RTYPE_AUDIT:
+		rdbs = ctx->audit_dbs;
+		prefix = "audit";
+		break;
+	case JALDB_RTYPE_LOG:
+		rdbs = ctx->log_dbs;
+		prefix = "log";
+		break;
+	default:
+		return JALDB_E_INVAL;
+	}
+
+	u_int64_t count = 0;
+	enum jaldb_status ret = jaldb_migrate_timestamp_indices(ctx->env, prefix, rdbs,
+			batch_size, &count);
+	if (migrated) {
+		*migrated = count;
+	}
+	return ret;
+}
+
+enum jaldb_status jaldb_timestamp_keys_binary(jaldb_context *ctx,
+		enum jaldb_rec_type type, int *binary)
+{
+	struct jaldb_record_dbs *rdbs = NULL;
+
+	if (!ctx || !binary) {
+		return JALDB_E_INVAL;
+	}
+
+	switch(type) {
+	case JALDB_RTYPE_JOURNAL:
+		rdbs = ctx->journal_dbs;
+		break;
+	case JALDB_RTYPE_AUDIT:
+		rdbs = ctx->audit_dbs;
+		break;
+	case JALDB_RTYPE_LOG:
+		rdbs = ctx->log_dbs;
+		break;
+	default:
+		return JALDB_E_INVAL;
+	}
+	if (!rdbs) {
+		return JALDB_E_INVAL;
+	}
+	*binary = rdbs->timestamp_keys_binary;
+	return JALDB_OK;
+}
+
+/**
+ * Store \p doc as the system metadata of a record that was inserted without
+ * any, so it doesn't have to be generated again. Nothing is changed if the
+ * record got system metadata in the meantime.
+ */
+static enum jaldb_status jaldb_store_sys_meta(jaldb_context *ctx, enum jaldb_rec_type type,
+		const char *nonce, const uint8_t *doc, size_t doc_len)
+{
+	enum jaldb_status ret = JALDB_E_INVAL;
+	struct jaldb_record_dbs *rdbs = NULL;
+	struct jaldb_record *rec = NULL;
+	uint8_t *buffer = NULL;
+	size_t buf_size = 0;
+	int byte_swap;
+	int db_ret;
+	DB_TXN *txn = NULL;
+	DBT key;
+	DBT val;
+
+	memset(&key, 0, sizeof(key));
+	memset(&val, 0, sizeof(val));
+
+	if (JALDB_OK != jaldb_get_primary_record_dbs(ctx, type, &rdbs) || !rdbs->primary_db) {
+		return JALDB_E_INVAL;
+	}
+	db_ret = rdbs->primary_db->get_byteswapped(rdbs->primary_db, &byte_swap);
+	if (0 != db_ret) {
+		return JALDB_E_INVAL;
+	}
+
+	key.data = (void *) nonce;
+	key.size = strlen(nonce) + 1;
+	val.flags = DB_DBT_REALLOC;
+
+	while (1) {
+		jaldb_destroy_record(&rec);
+		free(buffer);
+		buffer = NULL;
+
+		db_ret = ctx->env->txn_begin(ctx->env, NULL, &txn, 0);
+		if (0 != db_ret) {
+			ret = JALDB_E_DB;
+			goto out;
+		}
+		db_ret = rdbs->primary_db->get(rdbs->primary_db, txn, &key, &val, DB_RMW);
+		if (0 != db_ret) {
+			txn->abort(txn);
+			if (DB_LOCK_DEADLOCK == db_ret) {
+				continue;
+			}
+			ret = (DB_NOTFOUND == db_ret) ? JALDB_E_NOT_FOUND : JALDB_E_DB;
+			goto out;
+		}
+
+		ret = jaldb_deserialize_record(byte_swap, (uint8_t*) val.data, val.size, &rec);
+		if (JALDB_OK != ret || rec->sys_meta) {
+			txn->abort(txn);
+			goto out;
+		}
+		rec->sys_meta = jaldb_record_create_segment(rec);
+		rec->sys_meta->payload = (uint8_t *) jaldb_record_alloc(rec, doc_len);
+		memcpy(rec->sys_meta->payload, doc, doc_len);
+		rec->sys_meta->length = doc_len;
+
+		ret = jaldb_serialize_record(byte_swap, rec, &buffer, &buf_size);
+		if (JALDB_OK != ret) {
+			txn->abort(txn);
+			goto out;
+		}
+		DBT new_val;
+		memset(&new_val, 0, sizeof(new_val));
+		new_val.data = buffer;
+		new_val.size = buf_size;
+		db_ret = rdbs->primary_db->put(rdbs->primary_db, txn, &key, &new_val, 0);
+		if (0 == db_ret) {
+			db_ret = txn->commit(txn, 0);
+			if (0 == db_ret) {
+				ret = JALDB_OK;
+				goto out;
+			}
 		} else {
+			txn->abort(txn);
+		}
+		if (DB_LOCK_DEADLOCK != db_ret) {
 			ret = JALDB_E_DB;
-			break;
+			goto out;
 		}
 	}
-
 out:
-	*local_nonce = (char *)key.data;
+	jaldb_destroy_record(&rec);
+	free(buffer);
 	free(val.data);
 	return ret;
 }
 
+/**
+ * Give \p rec the system metadata generated from its fields if it was
+ * stored without any. The document comes from the context's
+ * jaldb_sys_meta_cache when it is there, and is written back to the record
+ * if the context is set to.
+ */
+static enum jaldb_status jaldb_fill_sys_meta(jaldb_context *ctx, struct jaldb_record *rec,
+		const char *nonce)
+{
+	if (rec->sys_meta) {
+		return JALDB_OK;
+	}
 
+	uint8_t *doc = NULL;
+	size_t doc_len = 0;
+	if (!ctx->sys_meta_cache || JALDB_OK != jaldb_sys_meta_cache_get(ctx->sys_meta_cache,
+				rec->type, nonce, &doc, &doc_len)) {
+		char *gen_doc = NULL;
+		enum jaldb_status ret = jaldb_record_to_system_metadata_doc(rec, NULL, NULL, 0,
+				NULL, NULL, 0, NULL, &gen_doc, &doc_len);
+		if (ret != JALDB_OK) {
+			return ret;
+		}
+		doc = (uint8_t *) gen_doc;
+
+		// The record is still sent if the write back fails, it will
+		// just be generated again next time.
+		if (ctx->sys_meta_write_back &&
+				JALDB_OK == jaldb_store_sys_meta(ctx, rec->type, nonce, doc, doc_len)) {
+			jaldb_sys_meta_cache_add_write_back(ctx->sys_meta_cache);
+		} else {
+			jaldb_sys_meta_cache_put(ctx->sys_meta_cache, rec->type, nonce, doc, doc_len);
+		}
+	}
+
+	rec->sys_meta = jaldb_create_segment();
+	rec->sys_meta->payload = doc;
+	rec->sys_meta->length = doc_len;
+	return JALDB_OK;
+}
+
+/**
+ * Read the state of a record from the state DB.
+ *
+ * @param[in] rdbs The DBs of the record.
+ * @param[in] txn The transaction the record is read in.
+ * @param[in] pkey The primary key of the record.
+ * @param[out] state The state of the record, or -1 if none is stored and the
+ * state in its headers should be used.
+ *
+ * @return 0 on success, or a Berkeley DB error.
+ */
+static int jaldb_read_record_state(struct jaldb_record_dbs *rdbs, DB_TXN *txn,
+		DBT *pkey, int64_t *state)
+{
+	uint32_t stored;
+	int db_ret = jaldb_record_dbs_get_state(rdbs, txn, pkey, &stored, DB_DEGREE_2);
+	if (0 == db_ret) {
+		*state = stored;
+	} else if (DB_NOTFOUND == db_ret) {
+		*state = -1;
+		db_ret = 0;
+	}
+	return db_ret;
+}
+
+/**
+ * Use the state read by jaldb_read_record_state() for a deserialized record.
+ */
+static void jaldb_apply_record_state(struct jaldb_record *rec, int64_t state)
+{
+	if (0 <= state) {
+		jaldb_record_set_state(rec, (uint32_t) state);
+	}
+}
 
 enum jaldb_status jaldb_get_record(jaldb_context *ctx,
 		enum jaldb_rec_type type,
@@ -1364,6 +2001,7 @@ enum jaldb_status jaldb_get_record(jaldb_context *ctx,
 	enum jaldb_status ret;
 	struct jaldb_record_dbs *rdbs = NULL;
 	int db_ret;
+	int64_t state = -1;
 	DB_TXN *txn = NULL;
 	DBT key;
 	DBT val;
@@ -1415,6 +2053,9 @@ enum jaldb_status jaldb_get_record(jaldb_context *ctx,
 		}
 
 		db_ret = rdbs->primary_db->get(rdbs->primary_db, txn, &key, &val, DB_DEGREE_2);
+		if (0 == db_ret) {
+			db_ret = jaldb_read_record_state(rdbs, txn, &key, &state);
+		}
 		if (0 == db_ret) {
 			txn->commit(txn, 0);
 			break;
@@ -1436,16 +2077,10 @@ enum jaldb_status jaldb_get_record(jaldb_context *ctx,
 		goto out;
 	}
 	rec->type = type;
-	if (!rec->sys_meta) {
-		rec->sys_meta = jaldb_create_segment();
-		char *doc = NULL;
-		size_t doc_len = 0;
-		ret = jaldb_record_to_system_metadata_doc(rec, NULL, NULL, 0, NULL, NULL, 0, NULL, &doc, &doc_len);
-		if (ret != JALDB_OK) {
-			goto out;
-		}
-		rec->sys_meta->payload = (uint8_t*)doc;
-		rec->sys_meta->length = doc_len;
+	jaldb_apply_record_state(rec, state);
+	ret = jaldb_fill_sys_meta(ctx, rec, nonce);
+	if (ret != JALDB_OK) {
+		goto out;
 	}
 
 	*recpp = rec;
@@ -1469,6 +2104,7 @@ enum jaldb_status jaldb_get_record_by_uuid(jaldb_context *ctx,
 	enum jaldb_status ret;
 	struct jaldb_record_dbs *rdbs = NULL;
 	int db_ret;
+	int64_t state = -1;
 	DB_TXN *txn = NULL;
 	DBT key;
 	DBT pkey;
@@ -1523,6 +2159,9 @@ enum jaldb_status jaldb_get_record_by_uuid(jaldb_context *ctx,
 		}
 
 		db_ret = rdbs->record_id_idx_db->pget(rdbs->record_id_idx_db, txn, &key, &pkey, &val, 0);
+		if (0 == db_ret) {
+			db_ret = jaldb_read_record_state(rdbs, txn, &pkey, &state);
+		}
 		if (0 == db_ret) {
 			txn->commit(txn, 0);
 			break;
@@ -1544,16 +2183,10 @@ enum jaldb_status jaldb_get_record_by_uuid(jaldb_context *ctx,
 		goto out;
 	}
 	rec->type = type;
-	if (!rec->sys_meta) {
-		rec->sys_meta = jaldb_create_segment();
-		char *doc = NULL;
-		size_t doc_len = 0;
-		ret = jaldb_record_to_system_metadata_doc(rec, NULL, NULL, 0, NULL, NULL, 0, NULL, &doc, &doc_len);
-		if (ret != JALDB_OK) {
-			goto out;
-		}
-		rec->sys_meta->payload = (uint8_t*)doc;
-		rec->sys_meta->length = doc_len;
+	jaldb_apply_record_state(rec, state);
+	ret = jaldb_fill_sys_meta(ctx, rec, (char*)pkey.data);
+	if (ret != JALDB_OK) {
+		goto out;
 	}
 
 	*nonce = (char*)pkey.data;
@@ -1642,6 +2275,12 @@ enum jaldb_status jaldb_remove_record_from_db(jaldb_context *ctx,
 		}
 
 		db_ret = rdbs->primary_db->del(rdbs->primary_db, txn, &key, 0);
+		if (0 == db_ret && rdbs->state_db) {
+			db_ret = rdbs->state_db->del(rdbs->state_db, txn, &key, 0);
+			if (DB_NOTFOUND == db_ret) {
+				db_ret = 0;
+			}
+		}
 		if (0 == db_ret) {
 			txn->commit(txn, 0);
 			break;
@@ -1707,21 +2346,17 @@ enum jaldb_status jaldb_mark_unsynced_records_unsent(
 {
 	enum jaldb_status ret = JALDB_E_INVAL;
 
-	int byte_swap;
 	int db_ret;
 
-	struct jaldb_serialize_record_headers *headers = NULL;
 	struct jaldb_record_dbs *rdbs = NULL;
 
 	DBC *cursor = NULL;
 
 	DBT skey;
 	DBT pkey;
-	DBT val;
 
 	memset(&skey, 0, sizeof(skey));
 	memset(&pkey, 0, sizeof(pkey));
-	memset(&val, 0, sizeof(val));
 
 	if (!ctx) {
 		ret = JALDB_E_INVAL;
@@ -1743,35 +2378,24 @@ enum jaldb_status jaldb_mark_unsynced_records_unsent(
 		goto out;
 	}
 
-	if (!rdbs || !rdbs->primary_db || !rdbs->record_sent_db) {
+	if (!rdbs || !rdbs->primary_db || !rdbs->state_idx_db) {
 		ret = JALDB_E_INVAL;
 		goto out;
 	}
 
 	skey.flags = DB_DBT_REALLOC;
-	skey.size = sizeof(uint32_t);
-	skey.data = jal_malloc(skey.size);
-	// Set the secondary index we want to get records by
-	*((uint32_t*)(skey.data)) = JALDB_RFLAGS_SENT | JALDB_RFLAGS_CONFIRMED; // Check for Sent and Confirmed (and not Synced)
-
-	val.flags = DB_DBT_REALLOC | DB_DBT_PARTIAL;
-	val.dlen = sizeof(*headers);
-	val.size = sizeof(*headers);
-	val.doff = 0;
-	val.data = jal_malloc(val.size);
 
-	pkey.flags = DB_DBT_REALLOC;
-
-	db_ret = rdbs->record_sent_db->get_byteswapped(rdbs->primary_db, &byte_swap);
-	if (0 != db_ret) {
-		ret = JALDB_E_INVAL;
-		goto out;
-	}
-
-	// pget will continue to return records matching the requested flag until no more found
+	// Look up the first record that is sent and confirmed (and not synced)
+	// until no more are found
 	while (1) {
-		val.flags = DB_DBT_REALLOC | DB_DBT_PARTIAL;
-		db_ret = rdbs->record_sent_db->pget(rdbs->record_sent_db, NULL, &skey, &pkey, &val, 0);
+		db_ret = rdbs->state_idx_db->cursor(rdbs->state_idx_db, NULL, &cursor, DB_DEGREE_2);
+		if (0 == db_ret) {
+			db_ret = jaldb_record_dbs_state_cursor_get(cursor,
+					JALDB_RFLAGS_SENT | JALDB_RFLAGS_CONFIRMED, DB_SET_RANGE,
+					&skey, &pkey);
+			cursor->c_close(cursor);
+			cursor = NULL;
+		}
 
 		if (DB_NOTFOUND == db_ret) {
 			ret = JALDB_OK;
@@ -1780,11 +2404,14 @@ enum jaldb_status jaldb_mark_unsynced_records_unsent(
 			continue;
 		} else if (0 != db_ret) {
 			ret = JALDB_E_DB;
-			JALDB_DB_ERR(rdbs->primary_db, db_ret);
+			JALDB_DB_ERR(rdbs->state_idx_db, db_ret);
 			goto out;
 		}
 		// Use the returned nonce to id the record to be updated
-		db_ret = jaldb_mark_sent(ctx, type, (char *)pkey.data, 0);
+		ret = jaldb_mark_sent(ctx, type, (char *)pkey.data, 0);
+		if (JALDB_OK != ret) {
+			goto out;
+		}
 	}
 out:
 	if (cursor) {
@@ -1792,32 +2419,187 @@ out:
 	}
 
 	free(skey.data);
-	free(pkey.data);
-	free(val.data);
 
 	return ret;
 }
 
-enum jaldb_status jaldb_next_unsynced_record(
+/**
+ * Read the record under \p cursor into the buffer of \p view, growing it
+ * until the record fits. \p size gets the size of the record.
+ */
+static int jaldb_cursor_read_view(DBC *cursor, DBT *key, DBT *pkey,
+		struct jaldb_record_view *view, size_t *size)
+{
+	DBT val;
+	int db_ret;
+	memset(&val, 0, sizeof(val));
+	while (1) {
+		val.flags = DB_DBT_USERMEM;
+		val.data = view->buf;
+		val.ulen = view->capacity;
+		db_ret = cursor->c_pget(cursor, key, pkey, &val, DB_CURRENT);
+		if (DB_BUFFER_SMALL != db_ret) {
+			break;
+		}
+		jaldb_record_view_reserve(view, val.size);
+	}
+	*size = val.size;
+	return db_ret;
+}
+
+/**
+ * Read the record with the primary key \p key into the buffer of \p view,
+ * growing it until the record fits. \p size gets the size of the record.
+ */
+static int jaldb_db_read_view(DB *db, DB_TXN *txn, DBT *key,
+		struct jaldb_record_view *view, size_t *size)
+{
+	DBT val;
+	int db_ret;
+	memset(&val, 0, sizeof(val));
+	while (1) {
+		val.flags = DB_DBT_USERMEM;
+		val.data = view->buf;
+		val.ulen = view->capacity;
+		db_ret = db->get(db, txn, key, &val, DB_DEGREE_2);
+		if (DB_BUFFER_SMALL != db_ret) {
+			break;
+		}
+		jaldb_record_view_reserve(view, val.size);
+	}
+	*size = val.size;
+	return db_ret;
+}
+
+/**
+ * Read the next unsynced record into \p view, which has to be empty.
+ * \p pkey gets the primary key of the record.
+ */
+static enum jaldb_status jaldb_next_unsynced_view(
 	jaldb_context *ctx,
 	enum jaldb_rec_type type,
-	char **network_nonce,
-	struct jaldb_record **rec_out)
+	DBT *pkey,
+	struct jaldb_record_view *view)
 {
 	enum jaldb_status ret = JALDB_E_INVAL;
-	struct jaldb_record *rec = NULL;
 	int byte_swap;
-	struct jaldb_serialize_record_headers *headers = NULL;
 	struct jaldb_record_dbs *rdbs = NULL;
 	int db_ret;
+	size_t size = 0;
+	DBC *cursor = NULL;
 	DBT skey;
+	DBT found;
+	memset(&skey, 0, sizeof(skey));
+	memset(&found, 0, sizeof(found));
+
+	switch(type) {
+	case JALDB_RTYPE_JOURNAL:
+		rdbs = ctx->journal_dbs;
+		break;
+	case JALDB_RTYPE_AUDIT:
+		rdbs = ctx->audit_dbs;
+		break;
+	case JALDB_RTYPE_LOG:
+		rdbs = ctx->log_dbs;
+		break;
+	default:
+		return JALDB_E_INVAL;
+	}
+
+	if (!rdbs || !rdbs->primary_db || !rdbs->state_idx_db) {
+		return JALDB_E_INVAL;
+	}
+
+	skey.flags = DB_DBT_REALLOC;
+	pkey->flags = DB_DBT_REALLOC;
+
+	db_ret = rdbs->primary_db->get_byteswapped(rdbs->primary_db, &byte_swap);
+	if (0 != db_ret) {
+		return JALDB_E_INVAL;
+	}
+
+	while (1) {
+		// Find the first record that is confirmed and not yet sent
+		db_ret = rdbs->state_idx_db->cursor(rdbs->state_idx_db, NULL, &cursor, DB_DEGREE_2);
+		if (0 == db_ret) {
+			db_ret = jaldb_record_dbs_state_cursor_get(cursor, JALDB_RFLAGS_CONFIRMED,
+					DB_SET_RANGE, &skey, &found);
+			cursor->c_close(cursor);
+		}
+		if (DB_NOTFOUND == db_ret) {
+			ret = JALDB_E_NOT_FOUND;
+			goto out;
+		} else if (DB_LOCK_DEADLOCK == db_ret) {
+			continue;
+		} else if (0 != db_ret) {
+			JALDB_DB_ERR(rdbs->state_idx_db, db_ret);
+			ret = JALDB_E_DB;
+			goto out;
+		}
+
+		pkey->data = jal_realloc(pkey->data, found.size);
+		memcpy(pkey->data, found.data, found.size);
+		pkey->size = found.size;
+
+		// Read straight into the view, instead of into a buffer that is
+		// then copied apart
+		db_ret = jaldb_db_read_view(rdbs->primary_db, NULL, pkey, view, &size);
+		if (DB_NOTFOUND == db_ret || DB_LOCK_DEADLOCK == db_ret) {
+			// Removed since its state was read, or a deadlock
+			continue;
+		} else if (0 != db_ret) {
+			JALDB_DB_ERR(rdbs->primary_db, db_ret);
+			ret = JALDB_E_DB;
+			goto out;
+		}
+		break;
+	}
+
+	ret = jaldb_record_view_set(view, byte_swap, size, type);
+out:
+	free(skey.data);
+	return ret;
+}
+
+/**
+ * Read the record that follows the position (\p *timestamp, \p *last_nonce)
+ * in the timestamp index into \p view, which has to be empty, or just move
+ * past it if \p view is NULL.
+ *
+ * The index has sorted duplicates, so the index key and the primary key
+ * together give every record a place of its own. That position is all a
+ * caller has to keep between calls. It is updated to the returned record.
+ */
+static enum jaldb_status jaldb_next_chronological_view(
+	jaldb_context *ctx,
+	enum jaldb_rec_type type,
+	struct jaldb_record_view *view,
+	char **timestamp,
+	char **last_nonce)
+{
+	enum jaldb_status ret = JALDB_E_INVAL;
+	uint8_t search_key[JALDB_TIMESTAMP_KEY_LEN];
+	int byte_swap;
+	struct jaldb_record_dbs *rdbs = NULL;
+	int db_ret;
+	size_t size = 0;
+	char *new_timestamp = NULL;
+	DBT start;
+	DBT key;
 	DBT pkey;
 	DBT val;
-	memset(&skey, 0, sizeof(skey));
+	DBC *cursor = NULL;
+	memset(&start, 0, sizeof(start));
+	memset(&key, 0, sizeof(key));
 	memset(&pkey, 0, sizeof(pkey));
 	memset(&val, 0, sizeof(val));
+	key.flags = DB_DBT_REALLOC;
+	pkey.flags = DB_DBT_REALLOC;
+	// Only the keys are needed until the record to return is found
+	val.flags = DB_DBT_USERMEM | DB_DBT_PARTIAL;
 
-	if (!ctx || !network_nonce || *network_nonce || !rec_out || *rec_out) {
+	if (!timestamp || !*timestamp || !last_nonce ||
+			JALDB_OK != jaldb_timestamp_key_encode(*timestamp, strlen(*timestamp), search_key)) {
 		ret = JALDB_E_INVAL;
 		goto out;
 	}
@@ -1837,85 +2619,228 @@ enum jaldb_status jaldb_next_unsynced_record(
 		goto out;
 	}
 
-	if (!rdbs || !rdbs->primary_db || !rdbs->record_sent_db) {
+	if (!rdbs) {
 		ret = JALDB_E_INVAL;
 		goto out;
 	}
 
-	skey.size = sizeof(uint32_t);
-	skey.data = jal_malloc(skey.size);
-	*((uint32_t*)(skey.data)) = JALDB_RFLAGS_CONFIRMED;
-	skey.flags = DB_DBT_REALLOC;
+	if (rdbs->timestamp_keys_binary) {
+		start.data = search_key;
+		start.size = JALDB_TIMESTAMP_KEY_LEN;
+	} else {
+		start.data = *timestamp;
+		start.size = strlen(*timestamp) + 1;
+	}
 
-	val.flags = DB_DBT_REALLOC | DB_DBT_PARTIAL;
-	val.dlen = sizeof(*headers);
-	val.size = sizeof(*headers);
-	val.doff = 0;
-	val.data = jal_malloc(val.size);
+	db_ret = rdbs->nonce_timestamp_db->get_byteswapped(rdbs->nonce_timestamp_db, &byte_swap);
+	if (0 != db_ret) {
+		ret = JALDB_E_INVAL;
+		goto out;
+	}
+
+	db_ret = rdbs->nonce_timestamp_db->cursor(rdbs->nonce_timestamp_db, NULL, &cursor, DB_DEGREE_2);
+	if (0 != db_ret) {
+		JALDB_DB_ERR(rdbs->nonce_timestamp_db, db_ret);
+		goto out;
+	}
+
+	db_ret = DB_NOTFOUND;
+	if (*last_nonce) {
+		// The first record at the same time that was not returned yet
+		key.data = jal_malloc(start.size);
+		memcpy(key.data, start.data, start.size);
+		key.size = start.size;
+		pkey.data = jal_strdup(*last_nonce);
+		pkey.size = strlen(*last_nonce) + 1;
+		db_ret = cursor->c_pget(cursor, &key, &pkey, &val, DB_GET_BOTH_RANGE);
+		if (0 == db_ret && 0 == strcmp((char *) pkey.data, *last_nonce)) {
+			db_ret = cursor->c_pget(cursor, &key, &pkey, &val, DB_NEXT);
+		}
+	}
+	if (DB_NOTFOUND == db_ret) {
+		key.data = jal_realloc(key.data, start.size);
+		memcpy(key.data, start.data, start.size);
+		key.size = start.size;
+		db_ret = cursor->c_pget(cursor, &key, &pkey, &val, DB_SET_RANGE);
+		if (0 == db_ret && *last_nonce && key.size == start.size &&
+				0 == memcmp(key.data, start.data, start.size)) {
+			// Everything at this time was returned already
+			db_ret = cursor->c_pget(cursor, &key, &pkey, &val, DB_NEXT_NODUP);
+		}
+	}
+	if (0 != db_ret) {
+		if (DB_NOTFOUND == db_ret) {
+			ret = JALDB_E_NOT_FOUND;
+		} else {
+			JALDB_DB_ERR(rdbs->nonce_timestamp_db, db_ret);
+		}
+		goto out;
+	}
+
+	if (key.size != start.size || 0 != memcmp(key.data, start.data, start.size)) {
+		if (rdbs->timestamp_keys_binary) {
+			ret = jaldb_timestamp_key_decode((uint8_t*) key.data, key.size, &new_timestamp);
+			if (ret != JALDB_OK) {
+				goto out;
+			}
+		} else {
+			new_timestamp = jal_strdup((char*) key.data);
+		}
+	}
+
+	if (view) {
+		db_ret = jaldb_cursor_read_view(cursor, &key, &pkey, view, &size);
+		if (0 != db_ret) {
+			JALDB_DB_ERR(rdbs->nonce_timestamp_db, db_ret);
+			ret = JALDB_E_DB;
+			goto out;
+		}
+		ret = jaldb_record_view_set(view, byte_swap, size, type);
+		if (ret != JALDB_OK) {
+			goto out;
+		}
+	}
+	ret = JALDB_OK;
+
+	if (new_timestamp) {
+		free(*timestamp);
+		*timestamp = new_timestamp;
+		new_timestamp = NULL;
+	}
+	free(*last_nonce);
+	*last_nonce = (char *) pkey.data;
+	pkey.data = NULL;
+
+out:
+	if (cursor) {
+		cursor->c_close(cursor);
+	}
+
+	free(new_timestamp);
+	free(key.data);
+	free(pkey.data);
+	return ret;
+}
+
+/**
+ * Give a view the system metadata generated from its record if it was stored
+ * without any, like jaldb_fill_sys_meta().
+ */
+static enum jaldb_status jaldb_fill_view_sys_meta(jaldb_context *ctx,
+		struct jaldb_record_view *view, const char *nonce)
+{
+	if (view->flags & JALDB_RFLAGS_HAVE_SYS_META) {
+		return JALDB_OK;
+	}
+	struct jaldb_record *rec = NULL;
+	enum jaldb_status ret = jaldb_record_view_to_record(view, &rec);
+	if (JALDB_OK == ret) {
+		ret = jaldb_fill_sys_meta(ctx, rec, nonce);
+	}
+	if (JALDB_OK == ret) {
+		// The document is malloc()ed by jaldb_fill_sys_meta()
+		jaldb_record_view_set_sys_meta(view, rec->sys_meta->payload, rec->sys_meta->length);
+		rec->sys_meta->payload = NULL;
+	}
+	jaldb_destroy_record(&rec);
+	return ret;
+}
+
+enum jaldb_status jaldb_get_record_view(jaldb_context *ctx,
+		enum jaldb_rec_type type,
+		const char *nonce,
+		struct jaldb_record_view *view)
+{
+	enum jaldb_status ret = JALDB_E_INVAL;
+	struct jaldb_record_dbs *rdbs = NULL;
+	int byte_swap;
+	int db_ret;
+	size_t size = 0;
+	DBT key;
+	memset(&key, 0, sizeof(key));
+
+	if (!ctx || !nonce || !view || view->size) {
+		return JALDB_E_INVAL;
+	}
+
+	switch(type) {
+	case JALDB_RTYPE_JOURNAL:
+		rdbs = ctx->journal_dbs;
+		break;
+	case JALDB_RTYPE_AUDIT:
+		rdbs = ctx->audit_dbs;
+		break;
+	case JALDB_RTYPE_LOG:
+		rdbs = ctx->log_dbs;
+		break;
+	default:
+		return JALDB_E_INVAL;
+	}
 
-	pkey.flags = DB_DBT_REALLOC;
+	if (!rdbs || !rdbs->primary_db) {
+		return JALDB_E_INVAL;
+	}
 
-	db_ret = rdbs->record_sent_db->get_byteswapped(rdbs->primary_db, &byte_swap);
+	db_ret = rdbs->primary_db->get_byteswapped(rdbs->primary_db, &byte_swap);
 	if (0 != db_ret) {
-		ret = JALDB_E_INVAL;
-		goto out;
+		return JALDB_E_INVAL;
 	}
 
-	while (1) {
-
-		val.flags = DB_DBT_REALLOC | DB_DBT_PARTIAL;
-		db_ret = rdbs->record_sent_db->pget(rdbs->record_sent_db, NULL, &skey, &pkey, &val, 0);
-		val.flags = DB_DBT_REALLOC;
-
-		if (DB_NOTFOUND == db_ret) {
-			ret = JALDB_E_NOT_FOUND;
-			goto out;
-		} else if (DB_LOCK_DEADLOCK == db_ret) {
-			continue;
-		} else if (0 != db_ret) {
-			ret = JALDB_E_DB;
-			JALDB_DB_ERR(rdbs->primary_db, db_ret);
-			goto out;
-		}
-
-		headers = ((struct jaldb_serialize_record_headers *)val.data);
+	key.data = (void *) nonce;
+	key.size = strlen(nonce) + 1;
+	do {
+		db_ret = jaldb_db_read_view(rdbs->primary_db, NULL, &key, view, &size);
+	} while (DB_LOCK_DEADLOCK == db_ret);
+	if (DB_NOTFOUND == db_ret) {
+		return JALDB_E_NOT_FOUND;
+	} else if (0 != db_ret) {
+		JALDB_DB_ERR(rdbs->primary_db, db_ret);
+		return JALDB_E_DB;
+	}
 
-		val.flags = DB_DBT_REALLOC;
-		val.dlen = 0;
-		db_ret = rdbs->record_sent_db->pget(rdbs->record_sent_db, NULL, &skey, &pkey, &val, 0);
-		if (DB_LOCK_DEADLOCK == db_ret) {
-			continue;
-		}
+	ret = jaldb_record_view_set(view, byte_swap, size, type);
+	if (JALDB_OK == ret) {
+		ret = jaldb_fill_view_sys_meta(ctx, view, nonce);
+	}
+	if (JALDB_OK != ret) {
+		jaldb_record_view_release(view);
+	}
+	return ret;
+}
 
-		if (0 != db_ret) {
-			JALDB_DB_ERR(rdbs->primary_db, db_ret);
-			ret = JALDB_E_DB;
-			goto out;
-		}
+enum jaldb_status jaldb_next_unsynced_record(
+	jaldb_context *ctx,
+	enum jaldb_rec_type type,
+	char **network_nonce,
+	struct jaldb_record **rec_out)
+{
+	enum jaldb_status ret = JALDB_E_INVAL;
+	struct jaldb_record *rec = NULL;
+	struct jaldb_record_view view;
+	DBT pkey;
+	memset(&pkey, 0, sizeof(pkey));
+	jaldb_record_view_init(&view);
 
-		break;
+	if (!ctx || !network_nonce || *network_nonce || !rec_out || *rec_out) {
+		ret = JALDB_E_INVAL;
+		goto out;
 	}
 
-	if (db_ret != 0) {
-		ret = JALDB_E_DB;
+	ret = jaldb_next_unsynced_view(ctx, type, &pkey, &view);
+	if (ret != JALDB_OK) {
 		goto out;
 	}
 
-	ret = jaldb_deserialize_record(byte_swap, (uint8_t*) val.data, val.size, &rec);
+	ret = jaldb_deserialize_record(view.byte_swap, view.buf, view.size, &rec);
 	if (ret != JALDB_OK) {
 		goto out;
 	}
 	rec->type = type;
-	if (!rec->sys_meta) {
-		rec->sys_meta = jaldb_create_segment();
-		char *doc = NULL;
-		size_t doc_len = 0;
-		ret = jaldb_record_to_system_metadata_doc(rec, NULL, NULL, 0, NULL, NULL, 0, NULL, &doc, &doc_len);
-		if (ret != JALDB_OK) {
-			goto out;
-		}
-		rec->sys_meta->payload = (uint8_t*)doc;
-		rec->sys_meta->length = doc_len;
+	// The record was found by its state, its headers may be out of date
+	jaldb_record_set_state(rec, JALDB_RFLAGS_CONFIRMED);
+	ret = jaldb_fill_sys_meta(ctx, rec, (char*)pkey.data);
+	if (ret != JALDB_OK) {
+		goto out;
 	}
 
 	*network_nonce = jal_strdup(rec->network_nonce);
@@ -1928,176 +2853,211 @@ enum jaldb_status jaldb_next_unsynced_record(
 	rec = NULL;
 	ret = JALDB_OK;
 out:
-	free(skey.data);
 	free(pkey.data);
-	free(val.data);
+	jaldb_record_view_free(&view);
 	jaldb_destroy_record(&rec);
 
 	return ret;
 }
 
-enum jaldb_status jaldb_next_chronological_record(
+enum jaldb_status jaldb_next_unsynced_record_view(
 	jaldb_context *ctx,
 	enum jaldb_rec_type type,
 	char **network_nonce,
-	struct jaldb_record **rec_out,
-	char **timestamp)
+	struct jaldb_record_view *view)
 {
 	enum jaldb_status ret = JALDB_E_INVAL;
-	struct jaldb_record *rec = NULL;
-	struct tm search_time, current_time;
-	int search_microseconds, cur_microseconds;
-	memset(&search_time,0,sizeof(search_time));
-	memset(&current_time,0,sizeof(current_time));
-	int byte_swap;
-	struct jaldb_record_dbs *rdbs = NULL;
-	int db_ret;
-	std::set <std::string> *seen_records = NULL;
-	std::string nonce_string;
-	DBT key;
+	const char *nonce = NULL;
 	DBT pkey;
-	DBT val;
-	DBC *cursor = NULL;
-	memset(&key, 0, sizeof(key));
 	memset(&pkey, 0, sizeof(pkey));
-	memset(&val, 0, sizeof(val));
-	key.flags = DB_DBT_REALLOC;
-	val.flags = DB_DBT_REALLOC;
 
-	char *end_timestamp = strptime(*timestamp, "%Y-%m-%dT%H:%M:%S", &search_time);
+	if (!ctx || !network_nonce || *network_nonce || !view || view->size) {
+		return JALDB_E_INVAL;
+	}
 
-	if (!end_timestamp) {
-		ret = JALDB_E_INVAL;
+	ret = jaldb_next_unsynced_view(ctx, type, &pkey, view);
+	if (ret != JALDB_OK) {
 		goto out;
 	}
-
-	if (!sscanf(end_timestamp,".%d-%*d:%*d",&search_microseconds)) {
-		ret = JALDB_E_INVAL;
+	ret = jaldb_fill_view_sys_meta(ctx, view, (char*)pkey.data);
+	if (ret != JALDB_OK) {
 		goto out;
 	}
-
-	if (!ctx || !network_nonce || *network_nonce || !rec_out || *rec_out) {
-		ret = JALDB_E_INVAL;
+	ret = jaldb_record_view_get_string(view, JALDB_VIEW_NETWORK_NONCE, &nonce);
+	if (ret != JALDB_OK) {
 		goto out;
 	}
+	*network_nonce = jal_strdup(nonce);
+out:
+	if (ret != JALDB_OK) {
+		jaldb_record_view_release(view);
+	}
+	free(pkey.data);
+	return ret;
+}
+
+enum jaldb_status jaldb_next_unsynced_records(
+	jaldb_context *ctx,
+	enum jaldb_rec_type type,
+	size_t max_records,
+	size_t max_bytes,
+	struct jaldb_record_batch *batch)
+{
+	enum jaldb_status ret = JALDB_E_INVAL;
+	struct jaldb_record_dbs *rdbs = NULL;
+	struct jaldb_record_view *view = NULL;
+	std::vector<std::string> keys;
+	size_t bytes = 0;
+	size_t size = 0;
+	int byte_swap;
+	int db_ret;
+	u_int32_t flag;
+	DBC *cursor = NULL;
+	DBT skey;
+	DBT pkey;
+	memset(&skey, 0, sizeof(skey));
+	memset(&pkey, 0, sizeof(pkey));
+
+	if (!ctx || !batch || batch->count || 0 == max_records) {
+		return JALDB_E_INVAL;
+	}
 
 	switch(type) {
 	case JALDB_RTYPE_JOURNAL:
 		rdbs = ctx->journal_dbs;
-		seen_records = ctx->seen_journal_records;
 		break;
 	case JALDB_RTYPE_AUDIT:
 		rdbs = ctx->audit_dbs;
-		seen_records = ctx->seen_audit_records;
 		break;
 	case JALDB_RTYPE_LOG:
 		rdbs = ctx->log_dbs;
-		seen_records = ctx->seen_log_records;
 		break;
 	default:
-		ret = JALDB_E_INVAL;
-		goto out;
+		return JALDB_E_INVAL;
 	}
 
-	if (!rdbs) {
-		ret = JALDB_E_INVAL;
-		goto out;
+	if (!rdbs || !rdbs->primary_db || !rdbs->state_idx_db) {
+		return JALDB_E_INVAL;
 	}
 
-	key.size = strlen(*timestamp) + 1;
-	key.data = jal_strdup(*timestamp);
-
-	db_ret = rdbs->nonce_timestamp_db->get_byteswapped(rdbs->nonce_timestamp_db, &byte_swap);
+	db_ret = rdbs->primary_db->get_byteswapped(rdbs->primary_db, &byte_swap);
 	if (0 != db_ret) {
-		ret = JALDB_E_INVAL;
-		goto out;
+		return JALDB_E_INVAL;
 	}
 
-	db_ret = rdbs->nonce_timestamp_db->cursor(rdbs->nonce_timestamp_db, NULL, &cursor, DB_DEGREE_2);
-	if (0 != db_ret) {
-		JALDB_DB_ERR(rdbs->nonce_timestamp_db, db_ret);
-		goto out;
+	skey.flags = DB_DBT_REALLOC;
+
+	// The state index has one key per record, so one cursor walks the
+	// confirmed, un-sent records and each one is read from the primary DB
+	// straight into its view.
+	while (1) {
+		db_ret = rdbs->state_idx_db->cursor(rdbs->state_idx_db, NULL, &cursor, DB_DEGREE_2);
+		if (0 != db_ret) {
+			JALDB_DB_ERR(rdbs->state_idx_db, db_ret);
+			ret = JALDB_E_DB;
+			goto out;
+		}
+
+		flag = DB_SET_RANGE;
+		while (batch->count < max_records && bytes < max_bytes) {
+			db_ret = jaldb_record_dbs_state_cursor_get(cursor, JALDB_RFLAGS_CONFIRMED,
+					flag, &skey, &pkey);
+			if (0 != db_ret) {
+				break;
+			}
+			flag = DB_NEXT;
+			view = jaldb_record_batch_next_view(batch);
+			db_ret = jaldb_db_read_view(rdbs->primary_db, NULL, &pkey, view, &size);
+			if (DB_NOTFOUND == db_ret) {
+				// Removed since its state was read
+				db_ret = 0;
+				continue;
+			} else if (0 != db_ret) {
+				break;
+			}
+			ret = jaldb_record_view_set(view, byte_swap, size, type);
+			if (JALDB_OK != ret) {
+				goto out;
+			}
+			keys.push_back((char *) pkey.data);
+			batch->count++;
+			bytes += size;
+		}
+
+		cursor->c_close(cursor);
+		cursor = NULL;
+		if (DB_LOCK_DEADLOCK == db_ret && 0 == batch->count) {
+			continue;
+		}
+		break;
 	}
 
-	db_ret = cursor->c_pget(cursor, &key, &pkey, &val, DB_SET_RANGE);
-	if (0 != db_ret) {
+	if (0 == batch->count) {
 		if (DB_NOTFOUND == db_ret) {
 			ret = JALDB_E_NOT_FOUND;
 		} else {
-			JALDB_DB_ERR(rdbs->nonce_timestamp_db, db_ret);
+			JALDB_DB_ERR(rdbs->state_idx_db, db_ret);
+			ret = JALDB_E_DB;
 		}
 		goto out;
 	}
+	// A deadlock partway through just ends the batch early
 
-	end_timestamp = strptime((char*) key.data, "%Y-%m-%dT%H:%M:%S", &current_time);
-
-	if (!end_timestamp) {
-		ret = JALDB_E_INVAL;
-		goto out;
+	// The cursor is closed by now, so writing the system metadata back
+	// does not wait on its locks
+	for (size_t i = 0; i < batch->count; i++) {
+		ret = jaldb_fill_view_sys_meta(ctx, &batch->views[i], keys[i].c_str());
+		if (JALDB_OK != ret) {
+			goto out;
+		}
 	}
+	ret = JALDB_OK;
 
-	if (!sscanf(end_timestamp,".%d-%*d:%*d",&cur_microseconds)) {
-		ret = JALDB_E_INVAL;
-		goto out;
+out:
+	if (cursor) {
+		cursor->c_close(cursor);
+	}
+	if (JALDB_OK != ret) {
+		jaldb_record_batch_release(batch);
 	}
+	free(skey.data);
+	return ret;
+}
 
-	nonce_string = (char *)pkey.data;
+enum jaldb_status jaldb_next_chronological_record(
+	jaldb_context *ctx,
+	enum jaldb_rec_type type,
+	char **network_nonce,
+	struct jaldb_record **rec_out,
+	char **timestamp,
+	char **last_nonce)
+{
+	enum jaldb_status ret = JALDB_E_INVAL;
+	struct jaldb_record *rec = NULL;
+	struct jaldb_record_view view;
+	jaldb_record_view_init(&view);
 
-	while (difftime(mktime(&search_time), mktime(&current_time)) == 0 &&
-			search_microseconds == cur_microseconds) {
-		// Check to see if we already got a record at this time
-		if (seen_records->count(nonce_string) == 0) {
-			//Haven't seen it
-			seen_records->insert(nonce_string);
-			break;
-		} else {
-			db_ret = cursor->c_pget(cursor, &key, &pkey, &val, DB_NEXT);
-			if (0 != db_ret) {
-				if (DB_NOTFOUND == db_ret) {
-					ret = JALDB_E_NOT_FOUND;
-				} else {
-					JALDB_DB_ERR(rdbs->nonce_timestamp_db, db_ret);
-				}
-				goto out;
-			}
-			nonce_string = (char *)pkey.data;
-		}
-		end_timestamp = strptime((char*) key.data, "%Y-%m-%dT%H:%M:%S", &current_time);
-		if (!end_timestamp) {
-			ret = JALDB_E_INVAL;
-			goto out;
-		}
-		if (!sscanf(end_timestamp,".%d-%*d:%*d",&cur_microseconds)) {
-			ret = JALDB_E_INVAL;
-			goto out;
-		}
+	if (!ctx || !network_nonce || *network_nonce || !rec_out || *rec_out) {
+		ret = JALDB_E_INVAL;
+		goto out;
 	}
 
-	if (difftime(mktime(&search_time), mktime(&current_time)) != 0 ||
-			search_microseconds != cur_microseconds) {
-		free(*timestamp);
-		*timestamp = (char*)key.data;
-		key.data = NULL;
-		seen_records->clear();
-		seen_records->insert(nonce_string);
+	// The cursor is closed by now, so writing the system metadata back
+	// does not wait on its locks
+	ret = jaldb_next_chronological_view(ctx, type, &view, timestamp, last_nonce);
+	if (ret != JALDB_OK) {
+		goto out;
 	}
 
-	ret = jaldb_deserialize_record(byte_swap, (uint8_t*) val.data, val.size, &rec);
+	ret = jaldb_deserialize_record(view.byte_swap, view.buf, view.size, &rec);
 	if (ret != JALDB_OK) {
 		goto out;
 	}
 
 	rec->type = type;
-	if (!rec->sys_meta) {
-		rec->sys_meta = jaldb_create_segment();
-		char *doc = NULL;
-		size_t doc_len = 0;
-		ret = jaldb_record_to_system_metadata_doc(rec, NULL, NULL, 0, NULL, NULL, 0, NULL, &doc, &doc_len);
-		if (ret != JALDB_OK) {
-			goto out;
-		}
-		rec->sys_meta->payload = (uint8_t*)doc;
-		rec->sys_meta->length = doc_len;
+	ret = jaldb_fill_sys_meta(ctx, rec, *last_nonce);
+	if (ret != JALDB_OK) {
+		goto out;
 	}
 
 	*network_nonce = jal_strdup(rec->network_nonce);
@@ -2111,16 +3071,56 @@ enum jaldb_status jaldb_next_chronological_record(
 	ret = JALDB_OK;
 
 out:
-	if (cursor) {
-		cursor->c_close(cursor);
-	}
-
-	free(key.data);
-	free(val.data);
+	jaldb_record_view_free(&view);
 	jaldb_destroy_record(&rec);
 	return ret;
+}
+
+enum jaldb_status jaldb_next_chronological_record_view(
+	jaldb_context *ctx,
+	enum jaldb_rec_type type,
+	char **network_nonce,
+	struct jaldb_record_view *view,
+	char **timestamp,
+	char **last_nonce)
+{
+	enum jaldb_status ret = JALDB_E_INVAL;
+	const char *nonce = NULL;
 
+	if (!ctx || !network_nonce || *network_nonce || !view || view->size) {
+		return JALDB_E_INVAL;
+	}
+
+	ret = jaldb_next_chronological_view(ctx, type, view, timestamp, last_nonce);
+	if (ret != JALDB_OK) {
+		goto out;
+	}
+	ret = jaldb_fill_view_sys_meta(ctx, view, *last_nonce);
+	if (ret != JALDB_OK) {
+		goto out;
+	}
+	ret = jaldb_record_view_get_string(view, JALDB_VIEW_NETWORK_NONCE, &nonce);
+	if (ret != JALDB_OK) {
+		goto out;
+	}
+	*network_nonce = jal_strdup(nonce);
+out:
+	if (ret != JALDB_OK) {
+		jaldb_record_view_release(view);
+	}
+	return ret;
+}
 
+enum jaldb_status jaldb_next_chronological_nonce(
+	jaldb_context *ctx,
+	enum jaldb_rec_type type,
+	char **timestamp,
+	char **last_nonce)
+{
+	if (!ctx) {
+		return JALDB_E_INVAL;
+	}
+	return jaldb_next_chronological_view(ctx, type, NULL, timestamp, last_nonce);
 }
 
 enum jaldb_status jaldb_get_primary_record_dbs(
@@ -2298,13 +3298,6 @@ enum jaldb_status jaldb_compact_dbs(
 		fprintf(stderr, "ERROR: Faild to compact %s\n", db_name.c_str());
 	}
 
-	db_name = "record_sent_db";
-	fprintf(stdout, "Compact %s\n", db_name.c_str());
-	ret = jaldb_compact_db(ctx, rdbs->record_sent_db);
-	if (JALDB_OK != ret) {
-		fprintf(stderr, "ERROR: Faild to compact %s\n", db_name.c_str());
-	}
-
 	db_name = "metadata_db";
 	fprintf(stdout, "Compact %s\n", db_name.c_str());
 	ret = jaldb_compact_db(ctx, rdbs->metadata_db);
@@ -2319,11 +3312,20 @@ enum jaldb_status jaldb_compact_dbs(
 		fprintf(stderr, "ERROR: Faild to compact %s\n", db_name.c_str());
 	}
 
-	db_name = "record_confirmed_db";
-	fprintf(stdout, "Compact %s\n", db_name.c_str());
-	ret = jaldb_compact_db(ctx, rdbs->record_confirmed_db);
-	if (JALDB_OK != ret) {
-		fprintf(stderr, "ERROR: Faild to compact %s\n", db_name.c_str());
+	if (rdbs->state_db) {
+		db_name = "state_db";
+		fprintf(stdout, "Compact %s\n", db_name.c_str());
+		ret = jaldb_compact_db(ctx, rdbs->state_db);
+		if (JALDB_OK != ret) {
+			fprintf(stderr, "ERROR: Faild to compact %s\n", db_name.c_str());
+		}
+
+		db_name = "state_idx_db";
+		fprintf(stdout, "Compact %s\n", db_name.c_str());
+		ret = jaldb_compact_db(ctx, rdbs->state_idx_db);
+		if (JALDB_OK != ret) {
+			fprintf(stderr, "ERROR: Faild to compact %s\n", db_name.c_str());
+		}
 	}
 
 	switch (type) {
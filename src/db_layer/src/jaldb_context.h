@@ -31,6 +31,7 @@
 
 #include "db.h"
 #include "jaldb_record.h"
+#include "jaldb_record_view.h"
 #include "jaldb_status.h"
 
 #ifdef __cplusplus
@@ -46,7 +47,9 @@ typedef struct jaldb_context_t jaldb_context;
 enum jaldb_flags {
 	JDB_NONE = 0,
 	JDB_READONLY = 1,
-        JDB_DB_RECOVER = 2
+        JDB_DB_RECOVER = 2,
+	// Give records in newly created DBs time ordered primary keys
+	JDB_TIME_ORDERED_KEYS = 4
 };
 
 /**
@@ -123,6 +126,24 @@ enum jaldb_status jaldb_get_record_by_uuid(jaldb_context *ctx,
 		char **nonce,
 		struct jaldb_record **rec);
 
+/**
+ * Retrieves a record by nonce, like jaldb_get_record(), without copying its
+ * fields out. A record stored without system metadata gets it generated.
+ *
+ * @param[in] ctx The context.
+ * @param[in] type The type of record (journal, audit, log).
+ * @param[in] nonce The nonce of the record being retrieved.
+ * @param[in,out] view An empty view, which gets the record. Release it with
+ * jaldb_record_view_release() once the record is no longer needed.
+ *
+ * @return JALDB_OK if the function succeeds, JALDB_E_NOT_FOUND if there is
+ * no such record, or an error code.
+ */
+enum jaldb_status jaldb_get_record_view(jaldb_context *ctx,
+		enum jaldb_rec_type type,
+		const char *nonce,
+		struct jaldb_record_view *view);
+
 /**
  * Finds a given record and marks the sent to 0 or 1 for the remote archive source.
  * Note: Is up to the caller to verify valid states for Confirmed and/or Synced before
@@ -141,6 +162,26 @@ enum jaldb_status jaldb_mark_sent(
 		const char *nonce,
 		int target_state);
 
+/**
+ * Marks the sent flag of many records to 0 or 1 in a single transaction,
+ * like jaldb_mark_sent(). Records that no longer exist are skipped.
+ *
+ * @param[in] ctx The context.
+ * @param[in] type The type of records (journal, audit, or log).
+ * @param[in] nonces The nonces of the records to mark.
+ * @param[in] count The number of nonces.
+ * @param[in] target_state The requested state for the Sent flag.
+ *
+ * @return JALDB_OK on success, or a different JALDB error code on failure,
+ * in which case none of the records are marked.
+ */
+enum jaldb_status jaldb_mark_sent_batch(
+		jaldb_context *ctx,
+		enum jaldb_rec_type type,
+		char * const *nonces,
+		size_t count,
+		int target_state);
+
 /**
  * Finds a given record and marks it as synced with a remote source.
  *
@@ -199,9 +240,55 @@ enum jaldb_status jaldb_next_unsynced_record(
 	char **nonce,
 	struct jaldb_record **rec);
 
+/**
+ * Retrieves the next un-synced record from the database, like
+ * jaldb_next_unsynced_record(), without copying its fields out.
+ *
+ * @param[in] ctx The context.
+ * @param[in] type The type of record to retrieve.
+ * @param[out] nonce The nonce for the returned record.
+ * @param[in,out] view An empty view, which gets the record. Release it with
+ * jaldb_record_view_release() once the record is no longer needed.
+ *
+ * @return JALDB_OK if the function succeeds or an error code.
+ */
+enum jaldb_status jaldb_next_unsynced_record_view(
+	jaldb_context *ctx,
+	enum jaldb_rec_type type,
+	char **nonce,
+	struct jaldb_record_view *view);
+
+/**
+ * Retrieves up to \p max_records un-synced records from the database,
+ * with a single cursor. Reading stops early once the records read add up
+ * to \p max_bytes, but at least one record is returned.
+ *
+ * The records stay un-sent until they are marked, so the caller has to
+ * mark them (see jaldb_mark_sent_batch()) before retrieving the next batch.
+ *
+ * @param[in] ctx The context.
+ * @param[in] type The type of record to retrieve.
+ * @param[in] max_records The most records to return.
+ * @param[in] max_bytes The size of the serialized records to stop at.
+ * @param[in,out] batch An empty batch, which gets the records. Release it
+ * with jaldb_record_batch_release() once they are no longer needed.
+ *
+ * @return JALDB_OK if the function succeeds, JALDB_E_NOT_FOUND if there
+ * are no un-synced records, or an error code.
+ */
+enum jaldb_status jaldb_next_unsynced_records(
+	jaldb_context *ctx,
+	enum jaldb_rec_type type,
+	size_t max_records,
+	size_t max_bytes,
+	struct jaldb_record_batch *batch);
+
 /**
  * Retrieves the next chronological record from the database.
  *
+ * The position of a caller is \p timestamp and \p last_nonce, which each
+ * caller keeps for itself, so several callers can share a context.
+ *
  * @param[in] ctx The context.
  * @param[in] type The type of record to retrieve.
  * @param[out] nonce The nonce for the returned record.
@@ -210,6 +297,10 @@ enum jaldb_status jaldb_next_unsynced_record(
  * 		Overwritten to the new timestamp when a record is returned
  * 		Calling with a timestamp less than a previous timestamp
  * 		may result in records being sent multiple times.
+ * @param[in/out] last_nonce The local nonce of the last sent record, or
+ * 		NULL to start with the first record at \p timestamp.
+ * 		Overwritten with a new string when a record is returned,
+ * 		the caller must free it.
  *
  * @return JALDB_OK if the function succeeds or an error code.
  */
@@ -218,7 +309,55 @@ enum jaldb_status jaldb_next_chronological_record(
 	enum jaldb_rec_type type,
 	char **nonce,
 	struct jaldb_record **rec,
-	char** timestamp);
+	char** timestamp,
+	char **last_nonce);
+
+/**
+ * Retrieves the next chronological record from the database, like
+ * jaldb_next_chronological_record(), without copying its fields out.
+ *
+ * @param[in] ctx The context.
+ * @param[in] type The type of record to retrieve.
+ * @param[out] nonce The nonce for the returned record.
+ * @param[in,out] view An empty view, which gets the record. Release it with
+ * jaldb_record_view_release() once the record is no longer needed.
+ * @param[in/out] timestamp The timestamp of the last sent record, see
+ * 		jaldb_next_chronological_record().
+ * @param[in/out] last_nonce The local nonce of the last sent record, see
+ * 		jaldb_next_chronological_record().
+ *
+ * @return JALDB_OK if the function succeeds or an error code.
+ */
+enum jaldb_status jaldb_next_chronological_record_view(
+	jaldb_context *ctx,
+	enum jaldb_rec_type type,
+	char **nonce,
+	struct jaldb_record_view *view,
+	char **timestamp,
+	char **last_nonce);
+
+/**
+ * Moves to the next chronological record, like
+ * jaldb_next_chronological_record(), without reading it. The record is
+ * then read with jaldb_get_record_view() or jaldb_get_record(), unless the
+ * caller has it already.
+ *
+ * @param[in] ctx The context.
+ * @param[in] type The type of record.
+ * @param[in/out] timestamp The timestamp of the last sent record, see
+ * 		jaldb_next_chronological_record().
+ * @param[in/out] last_nonce The local nonce of the last sent record, see
+ * 		jaldb_next_chronological_record(). Overwritten with the
+ * 		local nonce of the next record.
+ *
+ * @return JALDB_OK if the function succeeds, JALDB_E_NOT_FOUND if there is
+ * no next record yet, or an error code.
+ */
+enum jaldb_status jaldb_next_chronological_nonce(
+	jaldb_context *ctx,
+	enum jaldb_rec_type type,
+	char **timestamp,
+	char **last_nonce);
 
 /**
  * Utility to insert any JALoP record
@@ -231,6 +370,162 @@ enum jaldb_status jaldb_next_chronological_record(
  */
 enum jaldb_status jaldb_insert_record(jaldb_context *ctx, struct jaldb_record *rec, int confirmed, char **local_nonce);
 
+/**
+ * Insert several JALoP records in a single transaction.
+ *
+ * Records that fail the sanity check are skipped and the remaining records
+ * are still inserted. A Berkeley DB error fails every record that was not
+ * skipped.
+ *
+ * @param[in] ctx the DB context.
+ * @param[in] recs The records to insert.
+ * @param[in] count The number of records in \p recs.
+ * @param[in] confirmed Whether or not to mark these records as confirmed.
+ * @param[out] local_nonces Array of \p count pointers, all initialized to
+ * NULL. On return, holds the nonce assigned to each inserted record.
+ * @param[out] rec_status Optional array of \p count entries that receives
+ * the result for each record.
+ *
+ * @return JALDB_OK if every record was inserted, otherwise the first error
+ * encountered.
+ */
+enum jaldb_status jaldb_insert_records(jaldb_context *ctx, struct jaldb_record **recs,
+		size_t count, int confirmed, char **local_nonces, enum jaldb_status *rec_status);
+
+struct jaldb_sys_meta_cache;
+
+/**
+ * Configure how the system metadata of records stored without any is
+ * handled.
+ *
+ * Such records get a system metadata document generated from their fields
+ * every time they are retrieved. With a \p cache, generated documents are
+ * kept in memory and reused. With \p write_back, the document is also
+ * stored in the record so later retrievals read it like any other record.
+ *
+ * @param[in] ctx the DB context.
+ * @param[in] cache The cache to use, or NULL for none. The cache may be
+ * shared by several contexts and must outlive them.
+ * @param[in] write_back Whether to store generated documents.
+ *
+ * @return JALDB_OK on success, JALDB_E_READ_ONLY if \p write_back is set
+ * for a read only context, or JALDB_E_INVAL.
+ */
+enum jaldb_status jaldb_set_sys_meta_cache(jaldb_context *ctx,
+		struct jaldb_sys_meta_cache *cache, int write_back);
+
+/**
+ * Get the insert sequence number of a record type.
+ *
+ * The sequence number changes every time records of \p type are
+ * committed, by this or any other process using the same db_root. Take it
+ * before looking for new records, then pass it to jaldb_wait_for_insert()
+ * to sleep until there may be more.
+ *
+ * @param[in] ctx the DB context.
+ * @param[in] type the type of records.
+ * @param[out] seq The current sequence number.
+ *
+ * @return JALDB_OK on success, or JALDB_E_INVAL.
+ */
+enum jaldb_status jaldb_get_insert_seq(jaldb_context *ctx, enum jaldb_rec_type type,
+		uint32_t *seq);
+
+/**
+ * Block until records of \p type are inserted.
+ *
+ * If insert notifications are not available for this db_root, this
+ * sleeps for \p timeout_ms and the caller should just check for records.
+ *
+ * @param[in] ctx the DB context.
+ * @param[in] type the type of records to wait for.
+ * @param[in,out] seq The sequence number from jaldb_get_insert_seq() or the
+ * last call to this function. Updated when records are inserted.
+ * @param[in] timeout_ms The longest to wait, in milliseconds.
+ *
+ * @return
+ *  - JALDB_OK if records were inserted since \p seq
+ *  - JALDB_E_NOT_FOUND if \p timeout_ms passed first
+ *  - JALDB_E_INVAL if one of the parameters is invalid
+ */
+enum jaldb_status jaldb_wait_for_insert(jaldb_context *ctx, enum jaldb_rec_type type,
+		uint32_t *seq, long timeout_ms);
+
+/**
+ * Metrics about the transactions used to insert records.
+ */
+struct jaldb_group_commit_stats {
+	uint64_t batches;		//!< Number of insert transactions
+	uint64_t records;		//!< Number of records committed
+	uint64_t max_batch_records;	//!< Largest number of records in one transaction
+	uint64_t last_batch_records;	//!< Number of records in the last transaction
+	uint64_t total_latency_usec;	//!< Sum of the time spent in every transaction
+	uint64_t max_latency_usec;	//!< Longest time spent in one transaction
+	uint64_t last_latency_usec;	//!< Time spent in the last transaction
+};
+
+/**
+ * Configure group commit for jaldb_insert_record().
+ *
+ * When enabled, records inserted concurrently from several threads are
+ * combined into a single transaction, so the cost of the log flush at
+ * commit is shared between them. Each caller still blocks until its own
+ * record is durable.
+ *
+ * @param[in] ctx the DB context.
+ * @param[in] max_records Maximum number of records per transaction. 0 or 1
+ * disables group commit.
+ * @param[in] max_bytes Maximum size of the in-memory segments per
+ * transaction, or 0 for no limit. A single record is always accepted.
+ * @param[in] max_delay_usec How long the first caller waits for the batch
+ * to fill up before committing, in microseconds.
+ *
+ * @return JALDB_OK on success, or JALDB_E_INVAL.
+ */
+enum jaldb_status jaldb_enable_group_commit(jaldb_context *ctx, uint32_t max_records,
+		uint64_t max_bytes, uint32_t max_delay_usec);
+
+/**
+ * Retrieve the insert transaction metrics.
+ *
+ * @param[in] ctx the DB context.
+ * @param[out] stats Receives a copy of the metrics.
+ *
+ * @return JALDB_OK on success, or JALDB_E_INVAL.
+ */
+enum jaldb_status jaldb_get_group_commit_stats(jaldb_context *ctx,
+		struct jaldb_group_commit_stats *stats);
+
+/**
+ * Migrate the timestamp indices of one record type from XML DateTime keys to
+ * binary timestamp keys. This can run while other processes use the
+ * database, they switch to the binary indices the next time they open it.
+ *
+ * @see jaldb_migrate_timestamp_indices
+ *
+ * @param[in] ctx the DB context, not opened read-only.
+ * @param[in] type the type of records to migrate.
+ * @param[in] batch_size the number of records to index per transaction.
+ * @param[out] migrated Optional, receives the number of records indexed.
+ *
+ * @return JALDB_OK on success (including when there is nothing to migrate),
+ * or an error code.
+ */
+enum jaldb_status jaldb_migrate_timestamp_keys(jaldb_context *ctx,
+		enum jaldb_rec_type type, uint32_t batch_size, uint64_t *migrated);
+
+/**
+ * Check whether the timestamp indices of a record type use binary keys.
+ *
+ * @param[in] ctx the DB context.
+ * @param[in] type the type of records.
+ * @param[out] binary Set to 1 if binary keys are used, 0 otherwise.
+ *
+ * @return JALDB_OK on success, or JALDB_E_INVAL.
+ */
+enum jaldb_status jaldb_timestamp_keys_binary(jaldb_context *ctx,
+		enum jaldb_rec_type type, int *binary);
+
 /**
  * Open a segment on disk for reading.
  *
@@ -31,12 +31,14 @@
 #define _JALDB_CONTEXT_HPP_
 
 #include <list>
-#include <set>
 #include <string>
 #include <db.h>
 #include "jaldb_context.h"
 
 struct jaldb_record_dbs;
+struct jaldb_group_commit;
+struct jaldb_notify;
+struct jaldb_sys_meta_cache;
 
 struct jaldb_context_t {
 	char *journal_root; 				//!< The journal record root path.
@@ -48,9 +50,10 @@ struct jaldb_context_t {
 	DB *audit_conf_db; 				//!< The database for conf'ed audit records
 	DB *log_conf_db; 				//!< The database for conf'ed log records
 	int db_read_only; 				//!< Whether or not to open the databases read only
-	std::set<std::string> *seen_journal_records;	//<! Journal records already seen in live mode
-	std::set<std::string> *seen_audit_records;	//<! Audit records already seen in live mode
-	std::set<std::string> *seen_log_records;	//<! Log records already seen in live mode
+	struct jaldb_group_commit *group_commit;	//!< State for batching concurrent inserts
+	struct jaldb_notify *notify;			//!< Insert notifications, NULL if unavailable
+	struct jaldb_sys_meta_cache *sys_meta_cache;	//!< Generated system metadata, not owned
+	int sys_meta_write_back;			//!< Whether generated system metadata is stored in the record
 };
 
 /**
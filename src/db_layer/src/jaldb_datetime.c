@@ -29,6 +29,7 @@
 
 #include <stdio.h>
 #include <ctype.h>
+#include <inttypes.h>
 #include <libxml/xmlschemastypes.h>
 #include <jalop/jal_status.h>
 #include <string.h>
@@ -167,3 +168,358 @@ int jaldb_extract_nonce_timestamp_key(DB *secondary, const DBT *key, const DBT *
 
 	return 0;
 }
+
+#define JALDB_NSEC_PER_SEC 1000000000LL
+#define JALDB_SEC_PER_DAY 86400LL
+/* Largest timezone offset allowed by XML Schema, in minutes (14:00) */
+#define JALDB_MAX_TZ_MINUTES (14 * 60)
+/* Flipping the sign bit makes the big-endian bytes sort like the signed value */
+#define JALDB_TIMESTAMP_SIGN_BIT 0x8000000000000000ULL
+/* -YYYYYYYYY-MM-DDTHH:MM:SS.nnnnnnnnn+HH:MM */
+#define JALDB_DATETIME_MAX_LEN 48
+
+/*
+ * Days since 1970-01-01 of a date in the proleptic Gregorian calendar, and the
+ * inverse, from http://howardhinnant.github.io/date_algorithms.html
+ */
+static int64_t jaldb_days_from_civil(int64_t y, int m, int d)
+{
+	y -= m <= 2;
+	int64_t era = (y >= 0 ? y : y - 399) / 400;
+	int64_t yoe = y - era * 400;
+	int64_t doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+	int64_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+	return era * 146097 + doe - 719468;
+}
+
+static void jaldb_civil_from_days(int64_t z, int64_t *y, int *m, int *d)
+{
+	z += 719468;
+	int64_t era = (z >= 0 ? z : z - 146096) / 146097;
+	int64_t doe = z - era * 146097;
+	int64_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+	int64_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+	int64_t mp = (5 * doy + 2) / 153;
+	*d = (int)(doy - (153 * mp + 2) / 5 + 1);
+	*m = (int)(mp < 10 ? mp + 3 : mp - 9);
+	*y = yoe + era * 400 + (*m <= 2);
+}
+
+static int jaldb_is_leap_year(int64_t y)
+{
+	return (0 == y % 4 && 0 != y % 100) || 0 == y % 400;
+}
+
+/* Parse exactly \p digits decimal digits, advancing \p pos. */
+static int jaldb_parse_digits(const char *str, size_t len, size_t *pos,
+		int digits, int64_t *out)
+{
+	int64_t val = 0;
+	if (*pos + digits > len) {
+		return -1;
+	}
+	for (int i = 0; i < digits; i++) {
+		char c = str[*pos + i];
+		if (!isdigit((unsigned char) c)) {
+			return -1;
+		}
+		val = val * 10 + (c - '0');
+	}
+	*pos += digits;
+	*out = val;
+	return 0;
+}
+
+static int jaldb_expect_char(const char *str, size_t len, size_t *pos, char c)
+{
+	if (*pos >= len || str[*pos] != c) {
+		return -1;
+	}
+	*pos += 1;
+	return 0;
+}
+
+enum jaldb_status jaldb_timestamp_key_encode(const char *datetime, size_t len,
+		uint8_t *key)
+{
+	static const int days_in_month[] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+	size_t pos = 0;
+	int negative = 0;
+	size_t year_digits = 0;
+	int64_t year = 0;
+	int64_t month, day, hour, minute, second;
+	int64_t nsec = 0;
+	int tz = 0;
+
+	if (!datetime || !key) {
+		return JALDB_E_INVAL;
+	}
+
+	if (pos < len && '-' == datetime[pos]) {
+		negative = 1;
+		pos++;
+	}
+	// Years may have more than 4 digits, but 9 is already far out of range.
+	while (pos < len && isdigit((unsigned char) datetime[pos]) && year_digits < 9) {
+		year = year * 10 + (datetime[pos] - '0');
+		year_digits++;
+		pos++;
+	}
+	if (year_digits < 4) {
+		return JALDB_E_INVAL_TIMESTAMP;
+	}
+	if (negative) {
+		year = -year;
+	}
+
+	if (0 != jaldb_expect_char(datetime, len, &pos, '-') ||
+			0 != jaldb_parse_digits(datetime, len, &pos, 2, &month) ||
+			0 != jaldb_expect_char(datetime, len, &pos, '-') ||
+			0 != jaldb_parse_digits(datetime, len, &pos, 2, &day) ||
+			0 != jaldb_expect_char(datetime, len, &pos, 'T') ||
+			0 != jaldb_parse_digits(datetime, len, &pos, 2, &hour) ||
+			0 != jaldb_expect_char(datetime, len, &pos, ':') ||
+			0 != jaldb_parse_digits(datetime, len, &pos, 2, &minute) ||
+			0 != jaldb_expect_char(datetime, len, &pos, ':') ||
+			0 != jaldb_parse_digits(datetime, len, &pos, 2, &second)) {
+		return JALDB_E_INVAL_TIMESTAMP;
+	}
+
+	if (pos < len && '.' == datetime[pos]) {
+		int frac_digits = 0;
+		pos++;
+		while (pos < len && isdigit((unsigned char) datetime[pos])) {
+			if (frac_digits < 9) {
+				nsec = nsec * 10 + (datetime[pos] - '0');
+				frac_digits++;
+			}
+			pos++;
+		}
+		if (0 == frac_digits) {
+			return JALDB_E_INVAL_TIMESTAMP;
+		}
+		for (; frac_digits < 9; frac_digits++) {
+			nsec *= 10;
+		}
+	}
+
+	if (pos < len && 'Z' == datetime[pos]) {
+		tz = JALDB_TIMESTAMP_KEY_TZ_BIAS;
+		pos++;
+	} else if (pos < len && ('+' == datetime[pos] || '-' == datetime[pos])) {
+		int sign = ('-' == datetime[pos]) ? -1 : 1;
+		int64_t tz_hour, tz_minute;
+		pos++;
+		if (0 != jaldb_parse_digits(datetime, len, &pos, 2, &tz_hour) ||
+				0 != jaldb_expect_char(datetime, len, &pos, ':') ||
+				0 != jaldb_parse_digits(datetime, len, &pos, 2, &tz_minute) ||
+				tz_minute > 59 ||
+				tz_hour * 60 + tz_minute > JALDB_MAX_TZ_MINUTES) {
+			return JALDB_E_INVAL_TIMESTAMP;
+		}
+		tz = JALDB_TIMESTAMP_KEY_TZ_BIAS + sign * (int)(tz_hour * 60 + tz_minute);
+	}
+
+	if (pos != len) {
+		return JALDB_E_INVAL_TIMESTAMP;
+	}
+
+	if (month < 1 || month > 12 || day < 1 || minute > 59 || second > 59) {
+		return JALDB_E_INVAL_TIMESTAMP;
+	}
+	if (day > days_in_month[month - 1] &&
+			!(2 == month && 29 == day && jaldb_is_leap_year(year))) {
+		return JALDB_E_INVAL_TIMESTAMP;
+	}
+	// 24:00:00 is allowed and is the first instant of the next day.
+	if (hour > 24 || (24 == hour && (minute || second || nsec))) {
+		return JALDB_E_INVAL_TIMESTAMP;
+	}
+
+	int64_t secs = jaldb_days_from_civil(year, (int)month, (int)day) * JALDB_SEC_PER_DAY +
+		hour * 3600 + minute * 60 + second;
+	if (tz) {
+		secs -= (int64_t)(tz - JALDB_TIMESTAMP_KEY_TZ_BIAS) * 60;
+	}
+	// Keep secs * JALDB_NSEC_PER_SEC + nsec within an int64_t.
+	if (secs >= INT64_MAX / JALDB_NSEC_PER_SEC ||
+			secs < INT64_MIN / JALDB_NSEC_PER_SEC) {
+		return JALDB_E_INVAL_TIMESTAMP;
+	}
+
+	jaldb_timestamp_key_from_ns(secs * JALDB_NSEC_PER_SEC + nsec, key);
+	key[8] = (uint8_t)((tz >> 8) & 0xff);
+	key[9] = (uint8_t)(tz & 0xff);
+
+	return JALDB_OK;
+}
+
+void jaldb_timestamp_key_from_ns(int64_t ns, uint8_t *key)
+{
+	uint64_t val = (uint64_t)ns ^ JALDB_TIMESTAMP_SIGN_BIT;
+	for (int i = 7; i >= 0; i--) {
+		key[i] = (uint8_t)(val & 0xff);
+		val >>= 8;
+	}
+	key[8] = 0;
+	key[9] = 0;
+}
+
+enum jaldb_status jaldb_timestamp_key_decode(const uint8_t *key, size_t key_len,
+		char **datetime)
+{
+	if (!key || JALDB_TIMESTAMP_KEY_LEN != key_len || !datetime || *datetime) {
+		return JALDB_E_INVAL;
+	}
+
+	uint64_t val = 0;
+	for (int i = 0; i < 8; i++) {
+		val = (val << 8) | key[i];
+	}
+	int64_t ns = (int64_t)(val ^ JALDB_TIMESTAMP_SIGN_BIT);
+	int tz = (key[8] << 8) | key[9];
+	int tz_minutes = tz ? tz - JALDB_TIMESTAMP_KEY_TZ_BIAS : 0;
+
+	int64_t secs = ns / JALDB_NSEC_PER_SEC;
+	int64_t nsec = ns % JALDB_NSEC_PER_SEC;
+	if (nsec < 0) {
+		nsec += JALDB_NSEC_PER_SEC;
+		secs -= 1;
+	}
+	secs += (int64_t)tz_minutes * 60;
+
+	int64_t days = secs / JALDB_SEC_PER_DAY;
+	int64_t sec_of_day = secs % JALDB_SEC_PER_DAY;
+	if (sec_of_day < 0) {
+		sec_of_day += JALDB_SEC_PER_DAY;
+		days -= 1;
+	}
+	int64_t year;
+	int month, day;
+	jaldb_civil_from_days(days, &year, &month, &day);
+
+	char *buf = jal_malloc(JALDB_DATETIME_MAX_LEN);
+	int off = snprintf(buf, JALDB_DATETIME_MAX_LEN,
+			"%s%04" PRId64 "-%02d-%02dT%02d:%02d:%02d",
+			year < 0 ? "-" : "", year < 0 ? -year : year, month, day,
+			(int)(sec_of_day / 3600), (int)(sec_of_day / 60 % 60), (int)(sec_of_day % 60));
+	if (0 == nsec % 1000) {
+		off += snprintf(buf + off, JALDB_DATETIME_MAX_LEN - off, ".%06d", (int)(nsec / 1000));
+	} else {
+		off += snprintf(buf + off, JALDB_DATETIME_MAX_LEN - off, ".%09d", (int)nsec);
+	}
+	if (tz && 0 == tz_minutes) {
+		snprintf(buf + off, JALDB_DATETIME_MAX_LEN - off, "Z");
+	} else if (tz) {
+		int abs_minutes = tz_minutes < 0 ? -tz_minutes : tz_minutes;
+		snprintf(buf + off, JALDB_DATETIME_MAX_LEN - off, "%c%02d:%02d",
+				tz_minutes < 0 ? '-' : '+', abs_minutes / 60, abs_minutes % 60);
+	}
+
+	*datetime = buf;
+	return JALDB_OK;
+}
+
+int jaldb_timestamp_key_compare(DB *db, const DBT *dbt1, const DBT *dbt2)
+{
+	u_int32_t len = (dbt1->size < dbt2->size) ? dbt1->size : dbt2->size;
+	int ret = memcmp(dbt1->data, dbt2->data, len);
+	if (ret) {
+		return (ret < 0) ? -1 : 1;
+	}
+	if (dbt1->size == dbt2->size) {
+		return 0;
+	}
+	return (dbt1->size < dbt2->size) ? -1 : 1;
+}
+
+int jaldb_extract_datetime_bin_key(DB *secondary,
+		const DBT *key,
+		const DBT *data,
+		DBT *result)
+{
+	const struct jaldb_serialize_record_headers *headers =
+		(const struct jaldb_serialize_record_headers*) data->data;
+	uint8_t bin_key[JALDB_TIMESTAMP_KEY_LEN];
+
+	if (!headers || data->size <= sizeof(*headers) ||
+			headers->version != JALDB_DB_LAYOUT_VERSION) {
+		return -1;
+	}
+
+	const char *dt = (const char*)data->data + sizeof(*headers);
+	size_t dt_len = strnlen(dt, data->size - sizeof(*headers));
+	if (JALDB_OK != jaldb_timestamp_key_encode(dt, dt_len, bin_key)) {
+		return -1;
+	}
+	result->data = jal_malloc(JALDB_TIMESTAMP_KEY_LEN);
+	memcpy(result->data, bin_key, JALDB_TIMESTAMP_KEY_LEN);
+	result->size = JALDB_TIMESTAMP_KEY_LEN;
+	result->flags = DB_DBT_APPMALLOC;
+	return 0;
+}
+
+int jaldb_extract_nonce_timestamp_bin_key(DB *secondary,
+		const DBT *key,
+		const DBT *data,
+		DBT *result)
+{
+	uint8_t bin_key[JALDB_TIMESTAMP_KEY_LEN];
+	const char *nonce = (const char*)key->data;
+	const char *end = nonce + strnlen(nonce, key->size);
+	const char *timestamp = memchr(nonce, '_', end - nonce);
+	if (!timestamp) {
+		return DB_DONOTINDEX;
+	}
+	timestamp += 1;
+	const char *timestamp_end = memchr(timestamp, '_', end - timestamp);
+	if (!timestamp_end) {
+		return DB_DONOTINDEX;
+	}
+	if (JALDB_OK != jaldb_timestamp_key_encode(timestamp, timestamp_end - timestamp, bin_key)) {
+		return DB_DONOTINDEX;
+	}
+	result->data = jal_malloc(JALDB_TIMESTAMP_KEY_LEN);
+	memcpy(result->data, bin_key, JALDB_TIMESTAMP_KEY_LEN);
+	result->size = JALDB_TIMESTAMP_KEY_LEN;
+	result->flags = DB_DBT_APPMALLOC;
+	return 0;
+}
+
+static int jaldb_hex_value(char c)
+{
+	if (c >= '0' && c <= '9') {
+		return c - '0';
+	}
+	if (c >= 'a' && c <= 'f') {
+		return c - 'a' + 10;
+	}
+	return -1;
+}
+
+int jaldb_extract_time_ordered_nonce_key(DB *secondary,
+		const DBT *key,
+		const DBT *data,
+		DBT *result)
+{
+	const char *nonce = (const char*)key->data;
+	if (!nonce || key->size <= JALDB_TIME_ORDERED_KEY_PREFIX_LEN ||
+			'_' != nonce[JALDB_TIME_ORDERED_KEY_PREFIX_LEN]) {
+		return DB_DONOTINDEX;
+	}
+
+	uint8_t *bin_key = jal_calloc(1, JALDB_TIMESTAMP_KEY_LEN);
+	for (int i = 0; i < JALDB_TIMESTAMP_KEY_TIME_LEN; i++) {
+		int hi = jaldb_hex_value(nonce[2 * i]);
+		int lo = jaldb_hex_value(nonce[2 * i + 1]);
+		if (hi < 0 || lo < 0) {
+			free(bin_key);
+			return DB_DONOTINDEX;
+		}
+		bin_key[i] = (uint8_t)((hi << 4) | lo);
+	}
+	result->data = bin_key;
+	result->size = JALDB_TIMESTAMP_KEY_LEN;
+	result->flags = DB_DBT_APPMALLOC;
+	return 0;
+}
@@ -31,6 +31,44 @@
 #define _JALDB_DATETIME_H_
 
 #include <db.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "jaldb_status.h"
+
+/**
+ * Size of a binary timestamp key.
+ *
+ * A binary timestamp key is the number of nanoseconds since the epoch (UTC),
+ * stored big-endian with the sign bit flipped, followed by the timezone of
+ * the original DateTime as a big-endian 16-bit value. The timezone is 0 when
+ * the DateTime had no timezone, and the offset in minutes plus
+ * JALDB_TIMESTAMP_KEY_TZ_BIAS otherwise. DateTimes without a timezone are
+ * taken to be UTC, which is how the JALoP components generate them.
+ *
+ * Because of this layout, comparing two keys with memcmp() orders them by
+ * time, so the key can be used with the default B-Tree ordering.
+ */
+#define JALDB_TIMESTAMP_KEY_LEN 10
+
+/**
+ * Number of leading bytes of a binary timestamp key that hold the time, the
+ * keys of two DateTimes that are the same instant in different timezones
+ * only differ after these.
+ */
+#define JALDB_TIMESTAMP_KEY_TIME_LEN 8
+
+/** Added to the timezone offset (in minutes) stored in a binary timestamp key */
+#define JALDB_TIMESTAMP_KEY_TZ_BIAS 1024
+
+/**
+ * Number of characters at the start of a time ordered primary key that hold
+ * the time, as the first JALDB_TIMESTAMP_KEY_TIME_LEN bytes of a binary
+ * timestamp key in lower case hex.
+ *
+ * @see jaldb_gen_time_ordered_primary_key
+ */
+#define JALDB_TIME_ORDERED_KEY_PREFIX_LEN (2 * JALDB_TIMESTAMP_KEY_TIME_LEN)
 
 #ifdef __cplusplus
 extern "C" {
@@ -124,6 +162,117 @@ int jaldb_extract_nonce_timestamp_key(DB *secondary,
 		const DBT *data,
 		DBT *result);
 
+/**
+ * Encode an XML DateTime string as a binary timestamp key.
+ *
+ * Only DateTimes between the years 1678 and 2261 can be encoded, fractional
+ * seconds beyond nanoseconds are truncated.
+ *
+ * @param[in] datetime The XML DateTime, for example
+ * <tt>2012-12-12T09:00:00.000001</tt> or <tt>2012-12-12T09:00:00-05:00</tt>.
+ * @param[in] len The length of \p datetime, not including any NULL terminator.
+ * @param[out] key A buffer of JALDB_TIMESTAMP_KEY_LEN bytes to fill in.
+ *
+ * @return JALDB_OK on success, JALDB_E_INVAL_TIMESTAMP if \p datetime is not
+ * a valid DateTime or is out of range, or JALDB_E_INVAL.
+ */
+enum jaldb_status jaldb_timestamp_key_encode(const char *datetime, size_t len,
+		uint8_t *key);
+
+/**
+ * Build the binary timestamp key of an instant without a timezone.
+ *
+ * @param[in] ns The number of nanoseconds since the epoch (UTC).
+ * @param[out] key A buffer of JALDB_TIMESTAMP_KEY_LEN bytes to fill in.
+ */
+void jaldb_timestamp_key_from_ns(int64_t ns, uint8_t *key);
+
+/**
+ * Convert a binary timestamp key back to an XML DateTime string.
+ *
+ * The DateTime is given in the timezone it was encoded with and always has
+ * fractional seconds, 6 digits unless nanoseconds are needed. Encoding the
+ * returned string gives back the same key.
+ *
+ * @param[in] key The binary timestamp key.
+ * @param[in] key_len The size of \p key, this must be JALDB_TIMESTAMP_KEY_LEN.
+ * @param[out] datetime The DateTime, the caller must free() it.
+ *
+ * @return JALDB_OK on success, or JALDB_E_INVAL.
+ */
+enum jaldb_status jaldb_timestamp_key_decode(const uint8_t *key, size_t key_len,
+		char **datetime);
+
+/**
+ * B-Tree Comparison function for binary timestamp keys.
+ *
+ * This is a plain byte comparison, it never parses the keys.
+ *
+ * @see jaldb_timestamp_key_encode
+ *
+ * @param[in] db The Berkeley DB that contains the keys, this is unused.
+ * @param[in] dbt1 The DBT that represents the application provided key.
+ * @param[in] dbt2 The DBT that represents the current key from the tree.
+ *
+ * @return -1 if <tt>(db1 < dbt2)</tt>, 0 if <tt>(dbt1 == dbt1)</tt>, 1 if <tt>(dbt1 > dbt2)</tt>
+ */
+int jaldb_timestamp_key_compare(DB *db, const DBT *dbt1, const DBT *dbt2);
+
+/**
+ * Function to extract the record Timestamp as a binary secondary key.
+ *
+ * This is the binary key counterpart of jaldb_extract_datetime_key().
+ *
+ * @param[in] secondary Pointer to the secondary DB that is getting modified.
+ * @param[in] key The key for the data in the primary DB
+ * @param[in] data The data for the record
+ * @param[out] result the DBT object to fill in with the binary timestamp key.
+ *
+ * @return 0 on success, -1 if the timestamp is not a valid DateTime.
+ */
+int jaldb_extract_datetime_bin_key(DB *secondary,
+		const DBT *key,
+		const DBT *data,
+		DBT *result);
+
+/**
+ * Function to extract the nonce timestamp as a binary secondary key.
+ *
+ * This is the binary key counterpart of jaldb_extract_nonce_timestamp_key().
+ *
+ * @param[in] secondary Pointer to the secondary DB that is getting modified.
+ * @param[in] key The key for the data in the primary DB
+ * @param[in] data The data for the record
+ * @param[out] result the DBT object to fill in with the binary timestamp key.
+ *
+ * @return 0 on success, DB_DONOTINDEX if the nonce has no valid timestamp.
+ */
+int jaldb_extract_nonce_timestamp_bin_key(DB *secondary,
+		const DBT *key,
+		const DBT *data,
+		DBT *result);
+
+/**
+ * Function to extract the nonce timestamp of a time ordered primary key as a
+ * binary secondary key.
+ *
+ * The key starts with the time in hex, so this decodes the first
+ * JALDB_TIME_ORDERED_KEY_PREFIX_LEN characters without parsing a DateTime.
+ *
+ * @see jaldb_gen_time_ordered_primary_key
+ *
+ * @param[in] secondary Pointer to the secondary DB that is getting modified.
+ * @param[in] key The key for the data in the primary DB
+ * @param[in] data The data for the record
+ * @param[out] result the DBT object to fill in with the binary timestamp key.
+ *
+ * @return 0 on success, DB_DONOTINDEX if the key is not a time ordered key.
+ */
+int jaldb_extract_time_ordered_nonce_key(DB *secondary,
+		const DBT *key,
+		const DBT *data,
+		DBT *result);
+
 #ifdef __cplusplus
 }
 #endif
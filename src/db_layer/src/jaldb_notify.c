@@ -0,0 +1,246 @@
+/**
+ * @file jaldb_notify.c This file contains the functions used to tell
+ * readers in other processes that new records were inserted.
+ *
+ * @section LICENSE
+ *
+ * Source code in 3rd-party is licensed and owned by their respective
+ * copyright holders.
+ *
+ * All other source code is copyright Tresys Technology and licensed as below.
+ *
+ * Copyright (c) 2012 Tresys Technology LLC, Columbia, Maryland, USA
+ *
+ * This software was developed by Tresys Technology LLC
+ * with U.S. Government sponsorship.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+
+#include "jal_alloc.h"
+#include "jal_asprintf_internal.h"
+
+#include "jaldb_notify.h"
+#include "jaldb_strings.h"
+
+/** How often to check the sequence number where futexes are not available */
+#define JALDB_NOTIFY_POLL_MS 10
+
+/**
+ * The sequence number of one record type. Each one is on its own cache
+ * line so that writers of different types don't slow each other down.
+ */
+struct jaldb_notify_slot {
+	uint32_t seq;
+	char pad[60];
+};
+
+/** The layout of the notification file */
+struct jaldb_notify_page {
+	struct jaldb_notify_slot journal;
+	struct jaldb_notify_slot audit;
+	struct jaldb_notify_slot log;
+};
+
+struct jaldb_notify {
+	struct jaldb_notify_page *page;	//!< The shared mapping of the file
+	int writable;			//!< Whether the mapping may be written to
+};
+
+static struct jaldb_notify_slot *jaldb_notify_get_slot(struct jaldb_notify *notify,
+		enum jaldb_rec_type type)
+{
+	switch (type) {
+	case JALDB_RTYPE_JOURNAL:
+		return &notify->page->journal;
+	case JALDB_RTYPE_AUDIT:
+		return &notify->page->audit;
+	case JALDB_RTYPE_LOG:
+		return &notify->page->log;
+	default:
+		return NULL;
+	}
+}
+
+static uint64_t jaldb_notify_now_ms()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static void jaldb_notify_sleep_ms(long ms)
+{
+	struct timespec ts;
+	ts.tv_sec = ms / 1000;
+	ts.tv_nsec = (ms % 1000) * 1000000;
+	while (-1 == nanosleep(&ts, &ts) && EINTR == errno) {
+		continue;
+	}
+}
+
+struct jaldb_notify *jaldb_notify_open(const char *db_root, int read_only)
+{
+	struct jaldb_notify *notify = NULL;
+	char *path = NULL;
+	int writable = 1;
+	int fd = -1;
+	struct stat st;
+	void *page = NULL;
+
+	if (!db_root) {
+		return NULL;
+	}
+	if (-1 == jal_asprintf(&path, "%s/%s", db_root, JALDB_NOTIFY_FILE_NAME)) {
+		return NULL;
+	}
+
+	if (read_only) {
+		fd = open(path, O_RDWR | O_CLOEXEC);
+		if (-1 == fd) {
+			writable = 0;
+			fd = open(path, O_RDONLY | O_CLOEXEC);
+		}
+	} else {
+		fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP);
+	}
+	if (-1 == fd) {
+		goto out;
+	}
+
+	if (0 != fstat(fd, &st)) {
+		goto out;
+	}
+	if ((size_t) st.st_size < sizeof(struct jaldb_notify_page)) {
+		// Growing the file zero fills it, so a new file starts with
+		// every sequence number at 0.
+		if (!writable || 0 != ftruncate(fd, sizeof(struct jaldb_notify_page))) {
+			goto out;
+		}
+	}
+
+	page = mmap(NULL, sizeof(struct jaldb_notify_page),
+			writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+	if (MAP_FAILED == page) {
+		goto out;
+	}
+
+	notify = jal_calloc(1, sizeof(*notify));
+	notify->page = page;
+	notify->writable = writable;
+
+out:
+	if (-1 != fd) {
+		close(fd);
+	}
+	free(path);
+	return notify;
+}
+
+void jaldb_notify_close(struct jaldb_notify **pnotify)
+{
+	if (!pnotify || !*pnotify) {
+		return;
+	}
+	munmap((*pnotify)->page, sizeof(struct jaldb_notify_page));
+	free(*pnotify);
+	*pnotify = NULL;
+}
+
+void jaldb_notify_post(struct jaldb_notify *notify, enum jaldb_rec_type type)
+{
+	if (!notify || !notify->writable) {
+		return;
+	}
+	struct jaldb_notify_slot *slot = jaldb_notify_get_slot(notify, type);
+	if (!slot) {
+		return;
+	}
+	__atomic_add_fetch(&slot->seq, 1, __ATOMIC_SEQ_CST);
+#ifdef __linux__
+	syscall(SYS_futex, &slot->seq, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+#endif
+}
+
+enum jaldb_status jaldb_notify_seq(struct jaldb_notify *notify,
+		enum jaldb_rec_type type, uint32_t *seq)
+{
+	if (!seq) {
+		return JALDB_E_INVAL;
+	}
+	if (!notify) {
+		*seq = 0;
+		return JALDB_OK;
+	}
+	struct jaldb_notify_slot *slot = jaldb_notify_get_slot(notify, type);
+	if (!slot) {
+		return JALDB_E_INVAL;
+	}
+	*seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+	return JALDB_OK;
+}
+
+enum jaldb_status jaldb_notify_wait(struct jaldb_notify *notify,
+		enum jaldb_rec_type type, uint32_t *seq, long timeout_ms)
+{
+	if (!seq || 0 > timeout_ms) {
+		return JALDB_E_INVAL;
+	}
+	if (!notify) {
+		jaldb_notify_sleep_ms(timeout_ms);
+		return JALDB_E_NOT_FOUND;
+	}
+	struct jaldb_notify_slot *slot = jaldb_notify_get_slot(notify, type);
+	if (!slot) {
+		return JALDB_E_INVAL;
+	}
+
+	const uint64_t deadline = jaldb_notify_now_ms() + timeout_ms;
+	while (1) {
+		uint32_t cur = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+		if (cur != *seq) {
+			*seq = cur;
+			return JALDB_OK;
+		}
+		uint64_t now = jaldb_notify_now_ms();
+		if (now >= deadline) {
+			return JALDB_E_NOT_FOUND;
+		}
+		long remaining = (long) (deadline - now);
+#ifdef __linux__
+		// Returns early on a wake, a signal, or if the sequence number
+		// changed before the kernel looked at it; the loop sorts it out.
+		struct timespec ts;
+		ts.tv_sec = remaining / 1000;
+		ts.tv_nsec = (remaining % 1000) * 1000000;
+		syscall(SYS_futex, &slot->seq, FUTEX_WAIT, cur, &ts, NULL, 0);
+#else
+		jaldb_notify_sleep_ms(remaining < JALDB_NOTIFY_POLL_MS ?
+				remaining : JALDB_NOTIFY_POLL_MS);
+#endif
+	}
+}
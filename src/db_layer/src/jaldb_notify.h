@@ -0,0 +1,114 @@
+/**
+ * @file jaldb_notify.h This file contains the functions used to tell
+ * readers in other processes that new records were inserted.
+ *
+ * @section LICENSE
+ *
+ * Source code in 3rd-party is licensed and owned by their respective
+ * copyright holders.
+ *
+ * All other source code is copyright Tresys Technology and licensed as below.
+ *
+ * Copyright (c) 2012 Tresys Technology LLC, Columbia, Maryland, USA
+ *
+ * This software was developed by Tresys Technology LLC
+ * with U.S. Government sponsorship.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _JALDB_NOTIFY_H_
+#define _JALDB_NOTIFY_H_
+
+#include <stdint.h>
+
+#include "jaldb_record.h"
+#include "jaldb_status.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Insert notifications for one database root.
+ *
+ * Each record type has a sequence number kept in a small file in the
+ * db_root that every process using the databases maps. Writers bump the
+ * sequence number after committing new records, and readers block on it
+ * (with a futex on Linux) until it changes.
+ */
+struct jaldb_notify;
+
+/**
+ * Open the notification file in \p db_root, creating it if needed.
+ *
+ * @param[in] db_root The database root directory.
+ * @param[in] read_only If non-zero, the file is never created, and is
+ * mapped read only if it cannot be opened for writing.
+ *
+ * @return the new jaldb_notify, or NULL if the file could not be set up.
+ * Callers should then fall back to polling.
+ */
+struct jaldb_notify *jaldb_notify_open(const char *db_root, int read_only);
+
+/**
+ * Unmap the notification file.
+ *
+ * @param[in,out] pnotify The jaldb_notify to release, set to NULL.
+ */
+void jaldb_notify_close(struct jaldb_notify **pnotify);
+
+/**
+ * Bump the sequence number of \p type and wake every waiting reader.
+ * Does nothing if \p notify is NULL or was opened read only.
+ *
+ * @param[in] notify The jaldb_notify.
+ * @param[in] type The type of the records that were inserted.
+ */
+void jaldb_notify_post(struct jaldb_notify *notify, enum jaldb_rec_type type);
+
+/**
+ * Get the current sequence number of \p type.
+ *
+ * @param[in] notify The jaldb_notify.
+ * @param[in] type The type of records.
+ * @param[out] seq The sequence number, 0 if \p notify is NULL.
+ *
+ * @return JALDB_OK, or JALDB_E_INVAL if \p type or \p seq is invalid.
+ */
+enum jaldb_status jaldb_notify_seq(struct jaldb_notify *notify,
+		enum jaldb_rec_type type, uint32_t *seq);
+
+/**
+ * Wait until the sequence number of \p type is no longer \p seq.
+ * If \p notify is NULL, this sleeps for \p timeout_ms.
+ *
+ * @param[in] notify The jaldb_notify.
+ * @param[in] type The type of records to wait for.
+ * @param[in,out] seq The last sequence number the caller has seen. Updated
+ * when it changes.
+ * @param[in] timeout_ms The longest to wait, in milliseconds.
+ *
+ * @return
+ *  - JALDB_OK if the sequence number changed
+ *  - JALDB_E_NOT_FOUND if \p timeout_ms passed without a change
+ *  - JALDB_E_INVAL if one of the parameters is invalid
+ */
+enum jaldb_status jaldb_notify_wait(struct jaldb_notify *notify,
+		enum jaldb_rec_type type, uint32_t *seq, long timeout_ms);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _JALDB_NOTIFY_H_
@@ -32,6 +32,7 @@
 #include "jal_alloc.h"
 #include "jaldb_record.h"
 #include "jaldb_record_dbs.h"
+#include "jaldb_serialize_record.h"
 #include "jaldb_status.h"
 #include "jaldb_strings.h"
 #include "jaldb_utils.h"
@@ -61,15 +62,23 @@ enum jaldb_status jaldb_purge_unconfirmed_records(
 		return JALDB_E_INVAL;
 	}
 
-	if (!rdbs || !rdbs->primary_db) {
+	if (!rdbs || !rdbs->primary_db || !rdbs->state_idx_db) {
 		return JALDB_E_INVAL;
 	}
 
-	DBT key;
-	memset(&key, 0, sizeof(DBT));
-	key.size = sizeof(int);
-	key.data = jal_malloc(sizeof(int));
-	*((int*)key.data) = 0;
+	// Every state without JALDB_RFLAGS_CONFIRMED
+	static const uint32_t unconfirmed[] = {
+		0,
+		JALDB_RFLAGS_SENT,
+		JALDB_RFLAGS_SYNCED,
+		JALDB_RFLAGS_SENT | JALDB_RFLAGS_SYNCED,
+	};
+	DBC *cursor = NULL;
+	DBT skey;
+	DBT pkey;
+	memset(&skey, 0, sizeof(DBT));
+	memset(&pkey, 0, sizeof(DBT));
+	skey.flags = DB_DBT_REALLOC;
 
 	while (1) {
 		db_ret = ctx->env->txn_begin(ctx->env, NULL, &txn, 0);
@@ -78,19 +87,43 @@ enum jaldb_status jaldb_purge_unconfirmed_records(
 			goto out;
 		}
 
-		// If a secondary index supports duplicates, one delete will delete all records with that value
-		db_ret = rdbs->record_confirmed_db->del(rdbs->record_confirmed_db, txn, &key, 0);
+		db_ret = rdbs->state_idx_db->cursor(rdbs->state_idx_db, txn, &cursor, 0);
+		for (size_t i = 0; 0 == db_ret && i < sizeof(unconfirmed) / sizeof(unconfirmed[0]); i++) {
+			u_int32_t flag = DB_SET_RANGE;
+			while (0 == (db_ret = jaldb_record_dbs_state_cursor_get(cursor,
+							unconfirmed[i], flag, &skey, &pkey))) {
+				// Deleting through the cursor removes the state, the
+				// record is removed from the primary DB first.
+				db_ret = rdbs->primary_db->del(rdbs->primary_db, txn, &pkey, 0);
+				if (0 == db_ret || DB_NOTFOUND == db_ret) {
+					db_ret = cursor->c_del(cursor, 0);
+				}
+				if (0 != db_ret) {
+					break;
+				}
+				flag = DB_NEXT;
+			}
+			if (DB_NOTFOUND == db_ret) {
+				// If there weren't any records in this state, we're good
+				db_ret = 0;
+			}
+		}
+		if (cursor) {
+			cursor->c_close(cursor);
+			cursor = NULL;
+		}
+
 		if (0 == db_ret) {
-			txn->commit(txn,0);
+			db_ret = txn->commit(txn, 0);
+			if (0 != db_ret) {
+				ret = JALDB_E_DB;
+				goto out;
+			}
 			break;
 		}
 		txn->abort(txn);
 		if (DB_LOCK_DEADLOCK == db_ret) {
 			continue;
-		} else if (DB_NOTFOUND == db_ret) {
-			// If there weren't any unconfirmed records, we're good
-			ret = JALDB_OK;
-			goto out;
 		}
 		ret = JALDB_E_DB;
 		goto out;
@@ -98,7 +131,7 @@ enum jaldb_status jaldb_purge_unconfirmed_records(
 	}
 	ret = JALDB_OK;
 out:
-	free(key.data);
+	free(skey.data);
 	return ret;
 }
 
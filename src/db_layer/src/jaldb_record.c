@@ -27,8 +27,11 @@
  * limitations under the License.
  */
 
+#include <unistd.h>
+
 #include "jal_alloc.h"
 
+#include "jaldb_arena.h"
 #include "jaldb_record.h"
 #include "jaldb_segment.h"
 #include "jaldb_serialize_record.h"
@@ -42,6 +45,40 @@ struct jaldb_record *jaldb_create_record()
 	return ret;
 }
 
+struct jaldb_record *jaldb_create_arena_record()
+{
+	struct jaldb_arena *arena = jaldb_arena_get();
+	struct jaldb_record *ret = jaldb_arena_calloc(arena, sizeof(*ret));
+	ret->version = JALDB_RECORD_VERSION;
+	ret->type = JALDB_RTYPE_UNKNOWN;
+	uuid_clear(ret->uuid);
+	ret->arena = arena;
+	return ret;
+}
+
+/**
+ * Free a member of a record held in \p arena, unless it came from there.
+ */
+static void jaldb_arena_record_free(struct jaldb_arena *arena, void *member)
+{
+	if (!jaldb_arena_owns(arena, member)) {
+		free(member);
+	}
+}
+
+static void jaldb_arena_record_destroy_segment(struct jaldb_arena *arena,
+		struct jaldb_segment *seg)
+{
+	if (!seg) {
+		return;
+	}
+	if (seg->fd >= 0) {
+		close(seg->fd);
+	}
+	jaldb_arena_record_free(arena, seg->payload);
+	jaldb_arena_record_free(arena, seg);
+}
+
 void jaldb_destroy_record(struct jaldb_record **pprecord)
 {
 	if (!pprecord || !*pprecord) {
@@ -49,6 +86,23 @@ void jaldb_destroy_record(struct jaldb_record **pprecord)
 	}
 
 	struct jaldb_record *rec = *pprecord;
+	if (rec->arena) {
+		struct jaldb_arena *arena = rec->arena;
+		jaldb_arena_record_destroy_segment(arena, rec->sys_meta);
+		jaldb_arena_record_destroy_segment(arena, rec->app_meta);
+		jaldb_arena_record_destroy_segment(arena, rec->payload);
+		jaldb_arena_record_free(arena, rec->network_nonce);
+		jaldb_arena_record_free(arena, rec->source);
+		jaldb_arena_record_free(arena, rec->hostname);
+		jaldb_arena_record_free(arena, rec->timestamp);
+		jaldb_arena_record_free(arena, rec->username);
+		jaldb_arena_record_free(arena, rec->sec_lbl);
+		// rec itself is in the arena
+		jaldb_arena_put(&arena);
+		*pprecord = NULL;
+		return;
+	}
+
 	jaldb_destroy_segment(&(rec->sys_meta));
 	jaldb_destroy_segment(&(rec->app_meta));
 	jaldb_destroy_segment(&(rec->payload));
@@ -62,6 +116,42 @@ void jaldb_destroy_record(struct jaldb_record **pprecord)
 	*pprecord = NULL;
 }
 
+void *jaldb_record_alloc(struct jaldb_record *rec, size_t size)
+{
+	if (rec->arena) {
+		return jaldb_arena_alloc(rec->arena, size);
+	}
+	return jal_malloc(size);
+}
+
+char *jaldb_record_strdup(struct jaldb_record *rec, const char *str)
+{
+	if (rec->arena) {
+		return jaldb_arena_strdup(rec->arena, str);
+	}
+	return str ? jal_strdup(str) : NULL;
+}
+
+struct jaldb_segment *jaldb_record_create_segment(struct jaldb_record *rec)
+{
+	if (!rec->arena) {
+		return jaldb_create_segment();
+	}
+	struct jaldb_segment *ret = jaldb_arena_calloc(rec->arena, sizeof(*ret));
+	ret->fd = -1;
+	return ret;
+}
+
+void jaldb_record_set_string(struct jaldb_record *rec, char **member, const char *str)
+{
+	if (!rec->arena) {
+		free(*member);
+	} else {
+		jaldb_arena_record_free(rec->arena, *member);
+	}
+	*member = jaldb_record_strdup(rec, str);
+}
+
 enum jaldb_status jaldb_record_sanity_check(struct jaldb_record *rec)
 {
 	uint64_t total_seg_size = 0;
@@ -31,6 +31,7 @@
 #ifndef _JALDB_RECORD_H_
 #define _JALDB_RECORD_H_
 
+#include <stddef.h>
 #include <stdint.h>
 #include <uuid/uuid.h>
 
@@ -43,6 +44,7 @@ extern "C" {
 #define JALDB_RECORD_VERSION 1
 #define JALDB_MAX_REC_LENGTH 200000000 
 
+struct jaldb_arena;
 struct jaldb_segment;
 
 
@@ -94,6 +96,7 @@ struct jaldb_record {
 	char                 have_uid;        //!< Indicates if the uid filed is valid.
 	uuid_t               host_uuid;       //!< The UUID of the machine that created the record.
 	uuid_t               uuid;            //!< The UUID of the record.
+	struct jaldb_arena   *arena;          //!< The arena holding this record and its members, or NULL.
 };
 
 /**
@@ -102,13 +105,69 @@ struct jaldb_record {
  */
 struct jaldb_record *jaldb_create_record();
 
+/**
+ * Function to create a jaldb_record held in an arena.
+ *
+ * The record, and the members allocated with jaldb_record_strdup(),
+ * jaldb_record_alloc() and jaldb_record_create_segment(), come from one
+ * arena taken from the pool of the calling thread, and are all released at
+ * once by jaldb_destroy_record(). Members allocated with malloc() may still
+ * be assigned, they are freed as usual.
+ *
+ * @return a newly allocated jaldb_record.
+ */
+struct jaldb_record *jaldb_create_arena_record();
+
 /**
  * Function to destroy a jaldb_record.
  * This will call appropriate destroy functions & free on all of it's members.
+ * For a record created by jaldb_create_arena_record(), the arena is
+ * released instead of freeing what came from it.
  * @param [in,out] pprecord The jaldb_record to destroy. This will be set to NULL.
  */
 void jaldb_destroy_record(struct jaldb_record **pprecord);
 
+/**
+ * Allocate memory for a member of a record. The memory comes from the
+ * arena of \p rec if it has one, and from malloc() otherwise.
+ *
+ * @param[in] rec The record.
+ * @param[in] size The number of bytes to allocate.
+ *
+ * @return The memory, which is not zeroed.
+ */
+void *jaldb_record_alloc(struct jaldb_record *rec, size_t size);
+
+/**
+ * Copy a string for a member of a record, like jaldb_record_alloc().
+ *
+ * @param[in] rec The record.
+ * @param[in] str The string, or NULL.
+ *
+ * @return The copy, or NULL if \p str is NULL.
+ */
+char *jaldb_record_strdup(struct jaldb_record *rec, const char *str);
+
+/**
+ * Create a segment for a record, like jaldb_record_alloc(). The segment is
+ * destroyed along with \p rec once it is assigned to one of its members.
+ *
+ * @param[in] rec The record.
+ *
+ * @return a newly allocated jaldb_segment.
+ */
+struct jaldb_segment *jaldb_record_create_segment(struct jaldb_record *rec);
+
+/**
+ * Replace one of the string members of a record, freeing the old string
+ * unless it came from the arena of \p rec.
+ *
+ * @param[in] rec The record.
+ * @param[in,out] member The member of \p rec to replace.
+ * @param[in] str The new string, copied with jaldb_record_strdup().
+ */
+void jaldb_record_set_string(struct jaldb_record *rec, char **member, const char *str);
+
 /**
  * Perform some basic sanity checks on a record before inserting into the DB.
  * This function ensures that some basic attributes are in place and that each
@@ -0,0 +1,216 @@
+/**
+ * @file jaldb_record_cache.cpp This file implements the cache of records
+ * read for sending.
+ *
+ * @section LICENSE
+ *
+ * Source code in 3rd-party is licensed and owned by their respective
+ * copyright holders.
+ *
+ * All other source code is copyright Tresys Technology and licensed as below.
+ *
+ * Copyright (c) 2012 Tresys Technology LLC, Columbia, Maryland, USA
+ *
+ * This software was developed by Tresys Technology LLC
+ * with U.S. Government sponsorship.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <list>
+#include <pthread.h>
+#include <string.h>
+#include <string>
+#include <unordered_map>
+
+#include "jaldb_record_cache.h"
+
+struct jaldb_record_cache_entry {
+	struct jaldb_record_view view;
+	std::string key;
+	uint64_t bytes;			//!< Memory held by view
+	unsigned int refs;		//!< References handed out, plus one while cached
+	std::list<jaldb_record_cache_entry *>::iterator lru_pos;	//!< Position in jaldb_record_cache::lru
+};
+
+typedef std::unordered_map<std::string, jaldb_record_cache_entry *> jaldb_record_cache_map;
+
+struct jaldb_record_cache {
+	pthread_mutex_t lock;
+	uint64_t max_bytes;
+	jaldb_record_cache_map entries;
+	std::list<jaldb_record_cache_entry *> lru;	//!< Entries, most recently used first
+	struct jaldb_record_cache_stats stats;		//!< Protected by lock
+};
+
+// Nonces are only unique within a record type
+static std::string jaldb_record_cache_key(enum jaldb_rec_type type, const char *nonce)
+{
+	std::string key(1, (char) type);
+	key.append(nonce);
+	return key;
+}
+
+static void jaldb_record_cache_free_entry(jaldb_record_cache_entry *entry)
+{
+	jaldb_record_view_free(&entry->view);
+	delete entry;
+}
+
+// Must be called with the lock held
+static void jaldb_record_cache_erase(struct jaldb_record_cache *cache,
+		jaldb_record_cache_entry *entry)
+{
+	cache->stats.bytes -= entry->bytes;
+	cache->stats.entries--;
+	cache->lru.erase(entry->lru_pos);
+	cache->entries.erase(entry->key);
+	if (0 == --entry->refs) {
+		jaldb_record_cache_free_entry(entry);
+	}
+}
+
+struct jaldb_record_cache *jaldb_record_cache_create(uint64_t max_bytes)
+{
+	if (0 == max_bytes) {
+		return NULL;
+	}
+	struct jaldb_record_cache *cache = new jaldb_record_cache();
+	pthread_mutex_init(&cache->lock, NULL);
+	cache->max_bytes = max_bytes;
+	memset(&cache->stats, 0, sizeof(cache->stats));
+	return cache;
+}
+
+void jaldb_record_cache_destroy(struct jaldb_record_cache **pcache)
+{
+	if (!pcache || !*pcache) {
+		return;
+	}
+	struct jaldb_record_cache *cache = *pcache;
+	while (!cache->lru.empty()) {
+		jaldb_record_cache_erase(cache, cache->lru.back());
+	}
+	pthread_mutex_destroy(&cache->lock);
+	delete cache;
+	*pcache = NULL;
+}
+
+enum jaldb_status jaldb_record_cache_get(struct jaldb_record_cache *cache,
+		enum jaldb_rec_type type, const char *nonce,
+		struct jaldb_record_cache_entry **entry)
+{
+	if (!cache || !nonce || !entry || *entry) {
+		return JALDB_E_INVAL;
+	}
+	std::string key = jaldb_record_cache_key(type, nonce);
+
+	pthread_mutex_lock(&cache->lock);
+	jaldb_record_cache_map::iterator it = cache->entries.find(key);
+	if (it == cache->entries.end()) {
+		cache->stats.misses++;
+		pthread_mutex_unlock(&cache->lock);
+		return JALDB_E_NOT_FOUND;
+	}
+	cache->stats.hits++;
+	cache->lru.splice(cache->lru.begin(), cache->lru, it->second->lru_pos);
+	it->second->refs++;
+	*entry = it->second;
+	pthread_mutex_unlock(&cache->lock);
+	return JALDB_OK;
+}
+
+enum jaldb_status jaldb_record_cache_put(struct jaldb_record_cache *cache,
+		enum jaldb_rec_type type, const char *nonce,
+		struct jaldb_record_view *view,
+		struct jaldb_record_cache_entry **entry)
+{
+	const uint8_t *buf = NULL;
+	uint64_t len = 0;
+	int on_disk = 0;
+
+	if (!cache || !nonce || !view || !view->size || !entry || *entry) {
+		return JALDB_E_INVAL;
+	}
+	// Locate every field up front, so readers never update the view
+	if (JALDB_OK != jaldb_record_view_get_segment(view, JALDB_VIEW_PAYLOAD,
+			&buf, &len, &on_disk)) {
+		return JALDB_E_INVAL;
+	}
+
+	jaldb_record_cache_entry *added = new jaldb_record_cache_entry();
+	added->view = *view;
+	jaldb_record_view_init(view);
+	added->key = jaldb_record_cache_key(type, nonce);
+	added->bytes = added->view.capacity + added->view.sys_meta_doc_len;
+	added->refs = 1;
+
+	pthread_mutex_lock(&cache->lock);
+	jaldb_record_cache_map::iterator it = cache->entries.find(added->key);
+	if (it != cache->entries.end()) {
+		// Read by another session at the same time
+		it->second->refs++;
+		*entry = it->second;
+		pthread_mutex_unlock(&cache->lock);
+		jaldb_record_cache_free_entry(added);
+		return JALDB_OK;
+	}
+	if (added->bytes <= cache->max_bytes) {
+		while (!cache->lru.empty() && cache->stats.bytes + added->bytes > cache->max_bytes) {
+			jaldb_record_cache_erase(cache, cache->lru.back());
+			cache->stats.evictions++;
+		}
+		cache->lru.push_front(added);
+		cache->entries[added->key] = added;
+		added->lru_pos = cache->lru.begin();
+		added->refs++;
+		cache->stats.entries++;
+		cache->stats.bytes += added->bytes;
+	}
+	*entry = added;
+	pthread_mutex_unlock(&cache->lock);
+	return JALDB_OK;
+}
+
+struct jaldb_record_view *jaldb_record_cache_entry_view(
+		struct jaldb_record_cache_entry *entry)
+{
+	return entry ? &entry->view : NULL;
+}
+
+void jaldb_record_cache_release(struct jaldb_record_cache *cache,
+		struct jaldb_record_cache_entry **entry)
+{
+	if (!cache || !entry || !*entry) {
+		return;
+	}
+	pthread_mutex_lock(&cache->lock);
+	bool last = (0 == --(*entry)->refs);
+	pthread_mutex_unlock(&cache->lock);
+	if (last) {
+		jaldb_record_cache_free_entry(*entry);
+	}
+	*entry = NULL;
+}
+
+enum jaldb_status jaldb_record_cache_get_stats(struct jaldb_record_cache *cache,
+		struct jaldb_record_cache_stats *stats)
+{
+	if (!cache || !stats) {
+		return JALDB_E_INVAL;
+	}
+	pthread_mutex_lock(&cache->lock);
+	*stats = cache->stats;
+	pthread_mutex_unlock(&cache->lock);
+	return JALDB_OK;
+}
@@ -0,0 +1,163 @@
+/**
+ * @file jaldb_record_cache.h This file contains the functions of the
+ * cache of records read for sending.
+ *
+ * @section LICENSE
+ *
+ * Source code in 3rd-party is licensed and owned by their respective
+ * copyright holders.
+ *
+ * All other source code is copyright Tresys Technology and licensed as below.
+ *
+ * Copyright (c) 2012 Tresys Technology LLC, Columbia, Maryland, USA
+ *
+ * This software was developed by Tresys Technology LLC
+ * with U.S. Government sponsorship.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _JALDB_RECORD_CACHE_H_
+#define _JALDB_RECORD_CACHE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "jaldb_record.h"
+#include "jaldb_record_view.h"
+#include "jaldb_status.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * A bounded, least recently used cache of records read from the database,
+ * keyed by record type and nonce, so a record sent to several peers is
+ * only read once. A cache is safe to use from several threads.
+ *
+ * Records are handed out as reference counted entries. An entry dropped
+ * from the cache while it is still in use stays valid until it is
+ * released, but no longer counts against the byte limit.
+ */
+struct jaldb_record_cache;
+
+/**
+ * A record in a jaldb_record_cache.
+ */
+struct jaldb_record_cache_entry;
+
+/**
+ * Metrics about a jaldb_record_cache.
+ */
+struct jaldb_record_cache_stats {
+	uint64_t hits;		//!< Lookups served from the cache
+	uint64_t misses;	//!< Lookups that had to read the record
+	uint64_t evictions;	//!< Records dropped to stay within the limit
+	uint64_t entries;	//!< Records currently cached
+	uint64_t bytes;		//!< Memory held by the records currently cached
+};
+
+/**
+ * Create a cache.
+ *
+ * @param[in] max_bytes The most bytes of records to keep, must be at
+ * least 1.
+ *
+ * @return The new cache, or NULL if \p max_bytes is 0.
+ */
+struct jaldb_record_cache *jaldb_record_cache_create(uint64_t max_bytes);
+
+/**
+ * Destroy a cache. All of its entries must have been released.
+ *
+ * @param[in,out] pcache The cache to destroy, set to NULL.
+ */
+void jaldb_record_cache_destroy(struct jaldb_record_cache **pcache);
+
+/**
+ * Look up a record, and take a reference to it.
+ *
+ * @param[in] cache The cache.
+ * @param[in] type The type of the record.
+ * @param[in] nonce The nonce of the record.
+ * @param[out] entry The record, release it with
+ * jaldb_record_cache_release().
+ *
+ * @return JALDB_OK on a hit, JALDB_E_NOT_FOUND on a miss, or JALDB_E_INVAL.
+ */
+enum jaldb_status jaldb_record_cache_get(struct jaldb_record_cache *cache,
+		enum jaldb_rec_type type, const char *nonce,
+		struct jaldb_record_cache_entry **entry);
+
+/**
+ * Add a record, dropping the least recently used records if the cache is
+ * full, and take a reference to it. The record is moved out of \p view,
+ * which is left empty.
+ *
+ * If another thread added the same record first, \p entry is that one.
+ * A record larger than the byte limit is not cached, but \p entry still
+ * gets it.
+ *
+ * @param[in] cache The cache.
+ * @param[in] type The type of the record.
+ * @param[in] nonce The nonce of the record.
+ * @param[in,out] view The record.
+ * @param[out] entry The record, release it with
+ * jaldb_record_cache_release().
+ *
+ * @return JALDB_OK, or JALDB_E_INVAL if the record is malformed.
+ */
+enum jaldb_status jaldb_record_cache_put(struct jaldb_record_cache *cache,
+		enum jaldb_rec_type type, const char *nonce,
+		struct jaldb_record_view *view,
+		struct jaldb_record_cache_entry **entry);
+
+/**
+ * Get the record of an entry. Its fields are already located, so reading
+ * them does not change the view and several threads can read it at once.
+ * The view must not be released or changed otherwise.
+ *
+ * @param[in] entry The entry.
+ *
+ * @return The record.
+ */
+struct jaldb_record_view *jaldb_record_cache_entry_view(
+		struct jaldb_record_cache_entry *entry);
+
+/**
+ * Release a reference taken by jaldb_record_cache_get() or
+ * jaldb_record_cache_put().
+ *
+ * @param[in] cache The cache.
+ * @param[in,out] entry The entry, set to NULL.
+ */
+void jaldb_record_cache_release(struct jaldb_record_cache *cache,
+		struct jaldb_record_cache_entry **entry);
+
+/**
+ * Retrieve the cache metrics.
+ *
+ * @param[in] cache The cache.
+ * @param[out] stats Receives a copy of the metrics.
+ *
+ * @return JALDB_OK, or JALDB_E_INVAL.
+ */
+enum jaldb_status jaldb_record_cache_get_stats(struct jaldb_record_cache *cache,
+		struct jaldb_record_cache_stats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _JALDB_RECORD_CACHE_H_
@@ -27,15 +27,21 @@
  * limitations under the License.
  */
 
+#include <arpa/inet.h>
+#include <errno.h>
 #include <db.h>
+#include <string.h>
 
 #include "jal_alloc.h"
 #include "jal_asprintf_internal.h"
+#include "jal_byteswap.h"
 
 #include "jaldb_datetime.h"
 #include "jaldb_record_dbs.h"
 #include "jaldb_record_extract.h"
 #include "jaldb_nonce.h"
+#include "jaldb_serialize_record.h"
+#include "jaldb_strings.h"
 #include "jaldb_utils.h"
 
 struct jaldb_record_dbs *jaldb_create_record_dbs()
@@ -62,17 +68,23 @@ void jaldb_destroy_record_dbs(struct jaldb_record_dbs **record_dbs)
 	if (rdbs->nonce_timestamp_db) {
 		rdbs->nonce_timestamp_db->close(rdbs->nonce_timestamp_db, 0);
 	}
+	if (rdbs->pending_timestamp_idx_db) {
+		rdbs->pending_timestamp_idx_db->close(rdbs->pending_timestamp_idx_db, 0);
+	}
+	if (rdbs->pending_nonce_timestamp_db) {
+		rdbs->pending_nonce_timestamp_db->close(rdbs->pending_nonce_timestamp_db, 0);
+	}
 	if (rdbs->record_id_idx_db) {
 		rdbs->record_id_idx_db->close(rdbs->record_id_idx_db, 0);
 	}
-	if (rdbs->record_sent_db) {
-		rdbs->record_sent_db->close(rdbs->record_sent_db, 0);
-	}
 	if (rdbs->network_nonce_idx_db) {
 		rdbs->network_nonce_idx_db->close(rdbs->network_nonce_idx_db, 0);
 	}
-	if (rdbs->record_confirmed_db) {
-		rdbs->record_confirmed_db->close(rdbs->record_confirmed_db, 0);
+	if (rdbs->state_idx_db) {
+		rdbs->state_idx_db->close(rdbs->state_idx_db, 0);
+	}
+	if (rdbs->state_db) {
+		rdbs->state_db->close(rdbs->state_db, 0);
 	}
 	if (rdbs->primary_db) {
 		rdbs->primary_db->close(rdbs->primary_db, 0);
@@ -84,11 +96,336 @@ void jaldb_destroy_record_dbs(struct jaldb_record_dbs **record_dbs)
 	*record_dbs = NULL;
 }
 
+static enum jaldb_status jaldb_set_db_format(DB *metadata_db, DB_TXN *txn,
+		const char *name, const char *value)
+{
+	DBT key;
+	DBT val;
+	memset(&key, 0, sizeof(key));
+	memset(&val, 0, sizeof(val));
+	key.data = (void*) name;
+	key.size = strlen(name) + 1;
+	val.data = (void*) value;
+	val.size = strlen(value) + 1;
+
+	int db_ret = metadata_db->put(metadata_db, txn, &key, &val, 0);
+	if (0 != db_ret) {
+		JALDB_DB_ERR(metadata_db, db_ret);
+		return JALDB_E_DB;
+	}
+	return JALDB_OK;
+}
+
+/*
+ * Look up a format recorded in the metadata DB, \p is_set tells whether
+ * \p name is recorded as \p value.
+ */
+static enum jaldb_status jaldb_get_db_format(DB *metadata_db, DB_TXN *txn,
+		const char *name, const char *value, int *is_set)
+{
+	DBT key;
+	DBT val;
+	memset(&key, 0, sizeof(key));
+	memset(&val, 0, sizeof(val));
+	key.data = (void*) name;
+	key.size = strlen(name) + 1;
+	val.flags = DB_DBT_MALLOC;
+
+	*is_set = 0;
+	int db_ret = metadata_db->get(metadata_db, txn, &key, &val, 0);
+	if (DB_NOTFOUND == db_ret) {
+		return JALDB_OK;
+	}
+	if (0 != db_ret) {
+		JALDB_DB_ERR(metadata_db, db_ret);
+		return JALDB_E_DB;
+	}
+	*is_set = (val.size == strlen(value) + 1) && (0 == memcmp(val.data, value, val.size));
+	free(val.data);
+	return JALDB_OK;
+}
+
+static enum jaldb_status jaldb_open_timestamp_idx(
+		DB_ENV *env,
+		DB_TXN *txn,
+		const char *name,
+		int binary,
+		const u_int32_t db_flags,
+		DB **db)
+{
+	int db_ret = db_create(db, env, 0);
+	if (db_ret != 0) {
+		return JALDB_E_DB;
+	}
+
+	db_ret = (*db)->set_flags(*db, DB_DUP | DB_DUPSORT);
+	if (db_ret != 0) {
+		JALDB_DB_ERR((*db), db_ret);
+		return JALDB_E_DB;
+	}
+
+	db_ret = (*db)->set_bt_compare(*db,
+			binary ? jaldb_timestamp_key_compare : jaldb_xml_datetime_compare);
+	if (db_ret != 0) {
+		JALDB_DB_ERR((*db), db_ret);
+		return JALDB_E_DB;
+	}
+
+	db_ret = (*db)->open(*db, txn, name, NULL, DB_BTREE, db_flags, 0);
+	if (db_ret != 0) {
+		JALDB_DB_ERR((*db), db_ret);
+		return JALDB_E_DB;
+	}
+	return JALDB_OK;
+}
+
+static enum jaldb_status jaldb_open_timestamp_bin_indices(
+		DB_ENV *env,
+		DB_TXN *txn,
+		const char *prefix,
+		const u_int32_t db_flags,
+		DB **timestamp_db,
+		DB **nonce_timestamp_db)
+{
+	enum jaldb_status ret;
+	char *timestamp_name = NULL;
+	char *nonce_timestamp_name = NULL;
+
+	if (prefix) {
+		jal_asprintf(&timestamp_name, "%s_timestamp_bin_idx.db", prefix);
+		jal_asprintf(&nonce_timestamp_name, "%s_nonce_timestamp_bin.db", prefix);
+	}
+
+	ret = jaldb_open_timestamp_idx(env, txn, timestamp_name, 1, db_flags, timestamp_db);
+	if (ret != JALDB_OK) {
+		goto out;
+	}
+	ret = jaldb_open_timestamp_idx(env, txn, nonce_timestamp_name, 1, db_flags, nonce_timestamp_db);
+out:
+	free(timestamp_name);
+	free(nonce_timestamp_name);
+	return ret;
+}
+
+static enum jaldb_status jaldb_primary_db_is_empty(DB *primary_db, DB_TXN *txn, int *empty)
+{
+	DBC *cursor = NULL;
+	DBT key;
+	DBT val;
+	memset(&key, 0, sizeof(key));
+	memset(&val, 0, sizeof(val));
+	key.flags = DB_DBT_REALLOC;
+	val.flags = DB_DBT_PARTIAL;
+
+	int db_ret = primary_db->cursor(primary_db, txn, &cursor, 0);
+	if (0 != db_ret) {
+		JALDB_DB_ERR(primary_db, db_ret);
+		return JALDB_E_DB;
+	}
+	db_ret = cursor->c_get(cursor, &key, &val, DB_FIRST);
+	cursor->c_close(cursor);
+	free(key.data);
+	if (0 != db_ret && DB_NOTFOUND != db_ret) {
+		JALDB_DB_ERR(primary_db, db_ret);
+		return JALDB_E_DB;
+	}
+	*empty = (DB_NOTFOUND == db_ret);
+	return JALDB_OK;
+}
+
+/*
+ * Databases created before binary timestamp keys existed have no key format
+ * in the metadata DB. They keep their XML DateTime indices until they are
+ * migrated, and their UUID primary keys, except when they have no records
+ * yet. New databases record the formats they are created with.
+ */
+static enum jaldb_status jaldb_get_key_formats(
+		struct jaldb_record_dbs *rdbs,
+		DB_TXN *txn,
+		const u_int32_t db_flags,
+		enum jaldb_primary_key_format key_format)
+{
+	enum jaldb_status ret;
+	int time_ordered = 0;
+	int empty = 0;
+
+	ret = jaldb_get_db_format(rdbs->metadata_db, txn, JALDB_TIMESTAMP_KEY_FORMAT_NAME,
+			JALDB_TIMESTAMP_KEY_FORMAT_BINARY, &rdbs->timestamp_keys_binary);
+	if (ret != JALDB_OK) {
+		return ret;
+	}
+	ret = jaldb_get_db_format(rdbs->metadata_db, txn, JALDB_PRIMARY_KEY_FORMAT_NAME,
+			JALDB_PRIMARY_KEY_FORMAT_TIME_ORDERED, &time_ordered);
+	if (ret != JALDB_OK) {
+		return ret;
+	}
+
+	if (!(db_flags & DB_RDONLY) &&
+			(!rdbs->timestamp_keys_binary ||
+			(!time_ordered && JALDB_PRIMARY_KEY_TIME_ORDERED == key_format))) {
+		ret = jaldb_primary_db_is_empty(rdbs->primary_db, txn, &empty);
+		if (ret != JALDB_OK) {
+			return ret;
+		}
+	}
+	if (empty && !rdbs->timestamp_keys_binary) {
+		ret = jaldb_set_db_format(rdbs->metadata_db, txn, JALDB_TIMESTAMP_KEY_FORMAT_NAME,
+				JALDB_TIMESTAMP_KEY_FORMAT_BINARY);
+		if (ret != JALDB_OK) {
+			return ret;
+		}
+		rdbs->timestamp_keys_binary = 1;
+	}
+	if (empty && !time_ordered && JALDB_PRIMARY_KEY_TIME_ORDERED == key_format) {
+		ret = jaldb_set_db_format(rdbs->metadata_db, txn, JALDB_PRIMARY_KEY_FORMAT_NAME,
+				JALDB_PRIMARY_KEY_FORMAT_TIME_ORDERED);
+		if (ret != JALDB_OK) {
+			return ret;
+		}
+		time_ordered = 1;
+	}
+
+	rdbs->primary_key_format = time_ordered ?
+		JALDB_PRIMARY_KEY_TIME_ORDERED : JALDB_PRIMARY_KEY_UUID;
+	return JALDB_OK;
+}
+
+/*
+ * Copy the state of every record out of its headers into the state DB.
+ */
+static enum jaldb_status jaldb_copy_record_states(struct jaldb_record_dbs *rdbs, DB_TXN *txn)
+{
+	enum jaldb_status ret = JALDB_E_DB;
+	struct jaldb_serialize_record_headers headers;
+	DBC *cursor = NULL;
+	int byte_swap;
+	DBT key;
+	DBT val;
+	memset(&key, 0, sizeof(key));
+	memset(&val, 0, sizeof(val));
+	key.flags = DB_DBT_REALLOC;
+	val.flags = DB_DBT_USERMEM | DB_DBT_PARTIAL;
+	val.data = &headers;
+	val.ulen = sizeof(headers);
+	val.dlen = sizeof(headers);
+
+	int db_ret = rdbs->primary_db->get_byteswapped(rdbs->primary_db, &byte_swap);
+	if (0 != db_ret) {
+		goto out;
+	}
+	db_ret = rdbs->primary_db->cursor(rdbs->primary_db, txn, &cursor, 0);
+	if (0 != db_ret) {
+		goto out;
+	}
+	while (0 == (db_ret = cursor->c_get(cursor, &key, &val, DB_NEXT))) {
+		if (sizeof(headers) != val.size) {
+			continue;
+		}
+		uint32_t flags = byte_swap ? jal_bswap_32(headers.flags) : headers.flags;
+		db_ret = jaldb_record_dbs_put_state(rdbs, txn, &key, flags);
+		if (0 != db_ret) {
+			goto out;
+		}
+	}
+	if (DB_NOTFOUND == db_ret) {
+		db_ret = 0;
+		ret = JALDB_OK;
+	}
+out:
+	if (0 != db_ret) {
+		JALDB_DB_ERR(rdbs->primary_db, db_ret);
+	}
+	if (cursor) {
+		cursor->c_close(cursor);
+	}
+	free(key.data);
+	return ret;
+}
+
+/*
+ * Open the record state DB and its index. Databases created before the
+ * state DB existed have the state of their records copied out of the
+ * headers, unless they are opened read only.
+ */
+static enum jaldb_status jaldb_open_state_dbs(
+		DB_ENV *env,
+		DB_TXN *txn,
+		const char *prefix,
+		const u_int32_t db_flags,
+		struct jaldb_record_dbs *rdbs)
+{
+	enum jaldb_status ret;
+	int have_state_db = 0;
+	int empty = 0;
+	int db_ret;
+	char *state_name = NULL;
+	char *state_idx_name = NULL;
+
+	ret = jaldb_get_db_format(rdbs->metadata_db, txn, JALDB_RECORD_STATE_FORMAT_NAME,
+			JALDB_RECORD_STATE_FORMAT_STATE_DB, &have_state_db);
+	if (ret != JALDB_OK || (!have_state_db && (db_flags & DB_RDONLY))) {
+		return ret;
+	}
+
+	if (prefix) {
+		jal_asprintf(&state_name, "%s_record_state.db", prefix);
+		jal_asprintf(&state_idx_name, "%s_record_state_idx.db", prefix);
+	}
+
+	ret = JALDB_E_DB;
+	db_ret = db_create(&(rdbs->state_db), env, 0);
+	if (db_ret != 0) {
+		goto out;
+	}
+	db_ret = rdbs->state_db->open(rdbs->state_db, txn,
+			state_name, NULL, DB_BTREE, db_flags, 0);
+	if (db_ret != 0) {
+		JALDB_DB_ERR((rdbs->state_db), db_ret);
+		goto out;
+	}
+
+	// The keys of the index are unique, see jaldb_extract_record_state().
+	db_ret = db_create(&(rdbs->state_idx_db), env, 0);
+	if (db_ret != 0) {
+		goto out;
+	}
+	db_ret = rdbs->state_idx_db->open(rdbs->state_idx_db, txn,
+			state_idx_name, NULL, DB_BTREE, db_flags, 0);
+	if (db_ret != 0) {
+		JALDB_DB_ERR((rdbs->state_idx_db), db_ret);
+		goto out;
+	}
+
+	db_ret = rdbs->state_db->associate(rdbs->state_db, txn, rdbs->state_idx_db,
+			jaldb_extract_record_state, 0);
+	if (db_ret != 0) {
+		JALDB_DB_ERR((rdbs->state_db), db_ret);
+		goto out;
+	}
+
+	ret = JALDB_OK;
+	if (!have_state_db) {
+		ret = jaldb_primary_db_is_empty(rdbs->primary_db, txn, &empty);
+		if (ret == JALDB_OK && !empty) {
+			ret = jaldb_copy_record_states(rdbs, txn);
+		}
+		if (ret == JALDB_OK) {
+			ret = jaldb_set_db_format(rdbs->metadata_db, txn, JALDB_RECORD_STATE_FORMAT_NAME,
+					JALDB_RECORD_STATE_FORMAT_STATE_DB);
+		}
+	}
+out:
+	free(state_name);
+	free(state_idx_name);
+	return ret;
+}
+
 enum jaldb_status jaldb_create_primary_dbs_with_indices(
 		DB_ENV *env,
 		DB_TXN *txn,
 		const char *prefix,
 		const u_int32_t db_flags,
+		enum jaldb_primary_key_format key_format,
 		struct jaldb_record_dbs **pprdbs)
 {
 	if (!pprdbs || *pprdbs) {
@@ -101,8 +438,6 @@ enum jaldb_status jaldb_create_primary_dbs_with_indices(
 	char *timestamp_name = NULL;
 	char *nonce_timestamp_name = NULL;
 	char *record_uuid_name = NULL;
-	char *record_sent_name = NULL;
-	char *record_confirmed_name = NULL;
 	char *nonce_name = NULL;
 	char *network_nonce_name = NULL;
 	char *metadata_name = NULL;
@@ -114,8 +449,6 @@ enum jaldb_status jaldb_create_primary_dbs_with_indices(
 		jal_asprintf(&timestamp_name, "%s_timestamp_idx.db", prefix);
 		jal_asprintf(&nonce_timestamp_name, "%s_nonce_timestamp.db", prefix);
 		jal_asprintf(&record_uuid_name, "%s_record_uuid_idx.db", prefix);
-		jal_asprintf(&record_sent_name, "%s_record_sent.db", prefix);
-		jal_asprintf(&record_confirmed_name, "%s_record_confirmed.db", prefix);
 		jal_asprintf(&nonce_name, "%s_nonce.db", prefix);
 		jal_asprintf(&network_nonce_name, "%s_network_nonce_idx.db", prefix);
 		jal_asprintf(&metadata_name, "%s_metadata.db", prefix);
@@ -143,73 +476,59 @@ enum jaldb_status jaldb_create_primary_dbs_with_indices(
 		goto err_out;
 	}
 
-	// Open the 'Timestamp' DB. The Primary DB keys are XML DateTime
-	// strings. The timestamp DB is is used as a secondary index for the
-	// primary DB.
-
-	db_ret = db_create(&(rdbs->timestamp_idx_db), env, 0);
-	if (db_ret != 0) {
-		ret = JALDB_E_DB;
-		goto err_out;
-	}
-
-	db_ret = rdbs->timestamp_idx_db->set_flags(rdbs->timestamp_idx_db, DB_DUP | DB_DUPSORT);
-	if (db_ret != 0) {
-		JALDB_DB_ERR((rdbs->timestamp_idx_db), db_ret);
-		ret = JALDB_E_DB;
-		goto err_out;
-	}
-
-	db_ret = rdbs->timestamp_idx_db->set_bt_compare(rdbs->timestamp_idx_db,
-			jaldb_xml_datetime_compare);
-	if (db_ret != 0) {
-		JALDB_DB_ERR((rdbs->timestamp_idx_db), db_ret);
-		ret = JALDB_E_DB;
-		goto err_out;
-	}
-
-	db_ret = rdbs->timestamp_idx_db->open(rdbs->timestamp_idx_db, txn,
-			timestamp_name, NULL, DB_BTREE, db_flags, 0);
-	if (db_ret != 0) {
-		JALDB_DB_ERR((rdbs->timestamp_idx_db), db_ret);
-		ret = JALDB_E_DB;
-		goto err_out;
-	}
-
-	// Open the 'Nonce timestamp' DB. The Primary DB keys are XML DateTime
-	// strings. The nonce timestamp DB is is used as a secondary index for the
-	// primary DB.
-
-	db_ret = db_create(&(rdbs->nonce_timestamp_db), env, 0);
+	// Open the metadata DB. This is for tracking metadata and is *NOT* a
+	// secondary index into the primary db. It is opened first since it
+	// records which format the timestamp indices use.
+	db_ret = db_create(&(rdbs->metadata_db), env, 0);
 	if (db_ret != 0) {
 		ret = JALDB_E_DB;
 		goto err_out;
 	}
-
-	db_ret = rdbs->nonce_timestamp_db->set_flags(rdbs->nonce_timestamp_db, DB_DUP | DB_DUPSORT);
+	db_ret = rdbs->metadata_db->open(rdbs->metadata_db, txn,
+			metadata_name, NULL, DB_BTREE, db_flags, 0);
 	if (db_ret != 0) {
-		JALDB_DB_ERR((rdbs->nonce_timestamp_db), db_ret);
+		JALDB_DB_ERR((rdbs->metadata_db), db_ret);
 		ret = JALDB_E_DB;
 		goto err_out;
 	}
 
-	db_ret = rdbs->nonce_timestamp_db->set_bt_compare(rdbs->nonce_timestamp_db,
-			jaldb_xml_datetime_compare);
-	if (db_ret != 0) {
-		JALDB_DB_ERR((rdbs->nonce_timestamp_db), db_ret);
-		ret = JALDB_E_DB;
+	ret = jaldb_get_key_formats(rdbs, txn, db_flags, key_format);
+	if (ret != JALDB_OK) {
 		goto err_out;
 	}
 
-	db_ret = rdbs->nonce_timestamp_db->open(rdbs->nonce_timestamp_db, txn,
-			nonce_timestamp_name, NULL, DB_BTREE, db_flags, 0);
-	if (db_ret != 0) {
-		JALDB_DB_ERR((rdbs->nonce_timestamp_db), db_ret);
-		ret = JALDB_E_DB;
-		goto err_out;
+	// Open the 'Timestamp' and 'Nonce timestamp' DBs. These are secondary
+	// indices for the primary DB, keyed by the record timestamp and by the
+	// timestamp embedded in the nonce at insertion time.
+	if (rdbs->timestamp_keys_binary) {
+		ret = jaldb_open_timestamp_bin_indices(env, txn, prefix, db_flags,
+				&(rdbs->timestamp_idx_db), &(rdbs->nonce_timestamp_db));
+		if (ret != JALDB_OK) {
+			goto err_out;
+		}
+	} else {
+		ret = jaldb_open_timestamp_idx(env, txn, timestamp_name, 0, db_flags,
+				&(rdbs->timestamp_idx_db));
+		if (ret != JALDB_OK) {
+			goto err_out;
+		}
+		ret = jaldb_open_timestamp_idx(env, txn, nonce_timestamp_name, 0, db_flags,
+				&(rdbs->nonce_timestamp_db));
+		if (ret != JALDB_OK) {
+			goto err_out;
+		}
+		// Keep the binary indices up to date so they can be migrated to
+		// while the DB is in use.
+		if (!(db_flags & DB_RDONLY)) {
+			ret = jaldb_open_timestamp_bin_indices(env, txn, prefix, db_flags,
+					&(rdbs->pending_timestamp_idx_db),
+					&(rdbs->pending_nonce_timestamp_db));
+			if (ret != JALDB_OK) {
+				goto err_out;
+			}
+		}
 	}
 
-
 	// Open the record id DB. This is used as (yet another) secondary
 	// index for the primary DB. The keys for this DB are the record UUID
 	// identified in the system metadata.
@@ -234,29 +553,6 @@ enum jaldb_status jaldb_create_primary_dbs_with_indices(
 		goto err_out;
 	}
 
-	// Open the sent DB.  This is a secondary index grouping whether records
-	// Have been sent.
-	db_ret = db_create(&(rdbs->record_sent_db), env, 0);
-	if (db_ret != 0) {
-		ret = JALDB_E_DB;
-		goto err_out;
-	}
-
-	db_ret = rdbs->record_sent_db->set_flags(rdbs->record_sent_db, DB_DUP | DB_DUPSORT);
-	if (db_ret != 0) {
-		JALDB_DB_ERR((rdbs->record_sent_db), db_ret);
-		ret = JALDB_E_DB;
-		goto err_out;
-	}
-
-	db_ret = rdbs->record_sent_db->open(rdbs->record_sent_db, txn,
-			record_sent_name, NULL, DB_BTREE, db_flags, 0);
-	if (db_ret != 0) {
-		JALDB_DB_ERR((rdbs->record_sent_db), db_ret);
-		ret = JALDB_E_DB;
-		goto err_out;
-	}
-
 	// Open the network nonce DB.  This is a secondary index grouping records
 	// via their network nonce.
 	db_ret = db_create(&(rdbs->network_nonce_idx_db), env, 0);
@@ -280,71 +576,58 @@ enum jaldb_status jaldb_create_primary_dbs_with_indices(
 		goto err_out;
 	}
 
-	// Open the confirmed DB.  This is a secondary index grouping whether records
-	// have yet to be confirmed via digest.
-	db_ret = db_create(&(rdbs->record_confirmed_db), env, 0);
-	if (db_ret != 0) {
-		ret = JALDB_E_DB;
-		goto err_out;
-	}
-
-	db_ret = rdbs->record_confirmed_db->set_flags(rdbs->record_confirmed_db, DB_DUP | DB_DUPSORT);
-	if (db_ret != 0) {
-		JALDB_DB_ERR((rdbs->record_confirmed_db), db_ret);
-		ret = JALDB_E_DB;
+	// Open the state DB and its index. Like the metadata DB, the state DB is
+	// *NOT* a secondary index into the primary db, so that a record's state
+	// can change without rewriting the record.
+	ret = jaldb_open_state_dbs(env, txn, prefix, db_flags, rdbs);
+	if (ret != JALDB_OK) {
 		goto err_out;
 	}
 
-	db_ret = rdbs->record_confirmed_db->open(rdbs->record_confirmed_db, txn,
-			record_confirmed_name, NULL, DB_BTREE, db_flags, 0);
-	if (db_ret != 0) {
-		JALDB_DB_ERR((rdbs->record_confirmed_db), db_ret);
-		ret = JALDB_E_DB;
-		goto err_out;
-	}
-
-	// Open the metadata DB. This is for tracking metadata and is *NOT* a
-	// secondary index into the primary db
-        db_ret = db_create(&(rdbs->metadata_db), env, 0);
-        if (db_ret != 0) {
-                ret = JALDB_E_DB;
-                goto err_out;
-        }
-        db_ret = rdbs->metadata_db->open(rdbs->metadata_db, txn,
-                        metadata_name, NULL, DB_BTREE, db_flags, 0);
-        if (db_ret != 0) {
-                JALDB_DB_ERR((rdbs->metadata_db), db_ret);
-                ret = JALDB_E_DB;
-                goto err_out;
-        }
- 
 	// Associate the databases for secondary keys.
 	db_ret = rdbs->primary_db->associate(rdbs->primary_db, txn, rdbs->timestamp_idx_db,
-			jaldb_extract_datetime_key, 0);
+			rdbs->timestamp_keys_binary ?
+				jaldb_extract_datetime_bin_key : jaldb_extract_datetime_key, 0);
 	if (db_ret != 0) {
 		JALDB_DB_ERR((rdbs->primary_db), db_ret);
 		ret = JALDB_E_DB;
 		goto err_out;
 	}
 
-	db_ret = rdbs->primary_db->associate(rdbs->primary_db, txn, rdbs->nonce_timestamp_db,
-			jaldb_extract_nonce_timestamp_key, 0);
+	if (JALDB_PRIMARY_KEY_TIME_ORDERED == rdbs->primary_key_format) {
+		db_ret = rdbs->primary_db->associate(rdbs->primary_db, txn, rdbs->nonce_timestamp_db,
+				jaldb_extract_time_ordered_nonce_key, 0);
+	} else {
+		db_ret = rdbs->primary_db->associate(rdbs->primary_db, txn, rdbs->nonce_timestamp_db,
+				rdbs->timestamp_keys_binary ?
+					jaldb_extract_nonce_timestamp_bin_key : jaldb_extract_nonce_timestamp_key, 0);
+	}
 	if (db_ret != 0) {
 		JALDB_DB_ERR((rdbs->primary_db), db_ret);
 		ret = JALDB_E_DB;
 		goto err_out;
 	}
 
-	db_ret = rdbs->primary_db->associate(rdbs->primary_db, txn, rdbs->record_id_idx_db,
-			jaldb_extract_record_uuid, 0);
-	if (db_ret != 0) {
-		JALDB_DB_ERR((rdbs->primary_db), db_ret);
-		ret = JALDB_E_DB;
-		goto err_out;
+	if (rdbs->pending_timestamp_idx_db) {
+		db_ret = rdbs->primary_db->associate(rdbs->primary_db, txn,
+				rdbs->pending_timestamp_idx_db, jaldb_extract_datetime_bin_key, 0);
+		if (db_ret != 0) {
+			JALDB_DB_ERR((rdbs->primary_db), db_ret);
+			ret = JALDB_E_DB;
+			goto err_out;
+		}
+
+		db_ret = rdbs->primary_db->associate(rdbs->primary_db, txn,
+				rdbs->pending_nonce_timestamp_db, jaldb_extract_nonce_timestamp_bin_key, 0);
+		if (db_ret != 0) {
+			JALDB_DB_ERR((rdbs->primary_db), db_ret);
+			ret = JALDB_E_DB;
+			goto err_out;
+		}
 	}
 
-	db_ret = rdbs->primary_db->associate(rdbs->primary_db, txn, rdbs->record_sent_db,
-			jaldb_extract_record_sent_flag, 0);
+	db_ret = rdbs->primary_db->associate(rdbs->primary_db, txn, rdbs->record_id_idx_db,
+			jaldb_extract_record_uuid, 0);
 	if (db_ret != 0) {
 		JALDB_DB_ERR((rdbs->primary_db), db_ret);
 		ret = JALDB_E_DB;
@@ -359,15 +642,6 @@ enum jaldb_status jaldb_create_primary_dbs_with_indices(
 		goto err_out;
 	}
 
-
-	db_ret = rdbs->primary_db->associate(rdbs->primary_db, txn, rdbs->record_confirmed_db,
-			jaldb_extract_record_confirmed_flag, 0);
-	if (db_ret != 0) {
-		JALDB_DB_ERR((rdbs->primary_db), db_ret);
-		ret = JALDB_E_DB;
-		goto err_out;
-	}
-
 	*pprdbs = rdbs;
 	ret = JALDB_OK;
 	goto out;
@@ -378,11 +652,323 @@ out:
 	free(timestamp_name);
 	free(record_uuid_name);
 	free(nonce_timestamp_name);
-	free(record_sent_name);
 	free(network_nonce_name);
-	free(record_confirmed_name);
 	free(nonce_name);
 	free(metadata_name);
 	return ret;
 }
 
+int jaldb_record_dbs_get_state(
+		struct jaldb_record_dbs *rdbs,
+		DB_TXN *txn,
+		DBT *pkey,
+		uint32_t *state,
+		u_int32_t flags)
+{
+	uint32_t net_state;
+	DBT key;
+	DBT val;
+
+	if (!rdbs || !pkey || !state) {
+		return EINVAL;
+	}
+	if (!rdbs->state_db) {
+		return DB_NOTFOUND;
+	}
+	memset(&key, 0, sizeof(key));
+	memset(&val, 0, sizeof(val));
+	key.data = pkey->data;
+	key.size = pkey->size;
+	val.flags = DB_DBT_USERMEM;
+	val.data = &net_state;
+	val.ulen = sizeof(net_state);
+
+	int db_ret = rdbs->state_db->get(rdbs->state_db, txn, &key, &val, flags);
+	if (0 == db_ret) {
+		*state = ntohl(net_state);
+	}
+	return db_ret;
+}
+
+int jaldb_record_dbs_put_state(
+		struct jaldb_record_dbs *rdbs,
+		DB_TXN *txn,
+		DBT *pkey,
+		uint32_t state)
+{
+	// Stored in network order so that the index keys sort by state the
+	// same way on every host.
+	uint32_t net_state = htonl(state & JALDB_RFLAGS_STATE);
+	DBT key;
+	DBT val;
+
+	if (!rdbs || !rdbs->state_db || !pkey) {
+		return EINVAL;
+	}
+	memset(&key, 0, sizeof(key));
+	memset(&val, 0, sizeof(val));
+	key.data = pkey->data;
+	key.size = pkey->size;
+	val.data = &net_state;
+	val.size = sizeof(net_state);
+
+	return rdbs->state_db->put(rdbs->state_db, txn, &key, &val, 0);
+}
+
+int jaldb_record_dbs_state_cursor_get(
+		DBC *cursor,
+		uint32_t state,
+		u_int32_t flags,
+		DBT *skey,
+		DBT *pkey)
+{
+	uint32_t net_state = htonl(state & JALDB_RFLAGS_STATE);
+	uint32_t cur_state;
+	DBT val;
+	int db_ret;
+
+	if (!cursor || !skey || !pkey || (DB_SET_RANGE != flags && DB_NEXT != flags)) {
+		return EINVAL;
+	}
+	memset(&val, 0, sizeof(val));
+	val.flags = DB_DBT_USERMEM;
+	val.data = &cur_state;
+	val.ulen = sizeof(cur_state);
+
+	if (DB_SET_RANGE == flags) {
+		skey->data = jal_realloc(skey->data, sizeof(net_state));
+		memcpy(skey->data, &net_state, sizeof(net_state));
+		skey->size = sizeof(net_state);
+	}
+	db_ret = cursor->c_get(cursor, skey, &val, flags);
+	if (0 != db_ret) {
+		return db_ret;
+	}
+	if (skey->size <= sizeof(net_state) ||
+			0 != memcmp(skey->data, &net_state, sizeof(net_state))) {
+		return DB_NOTFOUND;
+	}
+	memset(pkey, 0, sizeof(*pkey));
+	pkey->data = (uint8_t *) skey->data + sizeof(net_state);
+	pkey->size = skey->size - sizeof(net_state);
+	return 0;
+}
+
+enum jaldb_status jaldb_record_dbs_timestamp_key(
+		const struct jaldb_record_dbs *rdbs,
+		const DBT *key,
+		uint8_t *bin_key)
+{
+	if (!rdbs || !key || !key->data || !bin_key) {
+		return JALDB_E_INVAL;
+	}
+	if (rdbs->timestamp_keys_binary) {
+		if (JALDB_TIMESTAMP_KEY_LEN != key->size) {
+			return JALDB_E_INVAL_TIMESTAMP;
+		}
+		memcpy(bin_key, key->data, JALDB_TIMESTAMP_KEY_LEN);
+		return JALDB_OK;
+	}
+	return jaldb_timestamp_key_encode((const char*) key->data,
+			strnlen((const char*) key->data, key->size), bin_key);
+}
+
+static int jaldb_put_timestamp_bin_key(DB *db, DB_TXN *txn, DBT *pkey, DBT *data,
+		int (*extract)(DB*, const DBT*, const DBT*, DBT*))
+{
+	DBT skey;
+	memset(&skey, 0, sizeof(skey));
+
+	if (0 != extract(db, pkey, data, &skey)) {
+		// The record cannot be indexed, the same as when it is inserted.
+		return 0;
+	}
+	int db_ret = db->put(db, txn, &skey, pkey, DB_NODUPDATA);
+	if (DB_KEYEXIST == db_ret) {
+		// Already indexed by whoever inserted the record.
+		db_ret = 0;
+	}
+	if (skey.flags & DB_DBT_APPMALLOC) {
+		free(skey.data);
+	}
+	return db_ret;
+}
+
+enum jaldb_status jaldb_migrate_timestamp_indices(
+		DB_ENV *env,
+		const char *prefix,
+		struct jaldb_record_dbs *rdbs,
+		u_int32_t batch_size,
+		u_int64_t *migrated)
+{
+	enum jaldb_status ret = JALDB_E_DB;
+	int db_ret = 0;
+	DB *timestamp_db = NULL;
+	DB *nonce_timestamp_db = NULL;
+	DB_TXN *txn = NULL;
+	DBC *cursor = NULL;
+	u_int64_t count = 0;
+	u_int32_t batch_count;
+	int done = 0;
+	DBT last;
+	DBT batch_last;
+	DBT pkey;
+	DBT data;
+	memset(&last, 0, sizeof(last));
+	memset(&batch_last, 0, sizeof(batch_last));
+	memset(&pkey, 0, sizeof(pkey));
+	memset(&data, 0, sizeof(data));
+	pkey.flags = DB_DBT_REALLOC;
+	data.flags = DB_DBT_REALLOC;
+
+	if (!prefix || !rdbs || !rdbs->primary_db || !rdbs->metadata_db || 0 == batch_size) {
+		return JALDB_E_INVAL;
+	}
+	if (migrated) {
+		*migrated = 0;
+	}
+	if (rdbs->timestamp_keys_binary) {
+		return JALDB_OK;
+	}
+	if (!rdbs->pending_timestamp_idx_db || !rdbs->pending_nonce_timestamp_db) {
+		return JALDB_E_READ_ONLY;
+	}
+
+	// The pending indices are associated with the primary DB, and Berkeley
+	// DB does not allow writing to an associated secondary directly, so
+	// the entries are written through separate handles.
+	ret = jaldb_open_timestamp_bin_indices(env, NULL, prefix,
+			DB_THREAD | (env ? DB_AUTO_COMMIT : 0),
+			&timestamp_db, &nonce_timestamp_db);
+	if (ret != JALDB_OK) {
+		goto out;
+	}
+
+	while (!done) {
+		ret = JALDB_E_DB;
+		batch_count = 0;
+		if (env) {
+			db_ret = env->txn_begin(env, NULL, &txn, 0);
+			if (0 != db_ret) {
+				goto out;
+			}
+		}
+
+		db_ret = rdbs->primary_db->cursor(rdbs->primary_db, txn, &cursor, 0);
+		if (0 != db_ret) {
+			JALDB_DB_ERR(rdbs->primary_db, db_ret);
+			goto out;
+		}
+
+		// Resume after the last record of the previous batch.
+		if (last.data) {
+			pkey.data = jal_realloc(pkey.data, last.size);
+			memcpy(pkey.data, last.data, last.size);
+			pkey.size = last.size;
+			db_ret = cursor->c_get(cursor, &pkey, &data, DB_SET_RANGE);
+			if (0 == db_ret && 0 == jaldb_nonce_compare(rdbs->primary_db, &pkey, &last)) {
+				db_ret = cursor->c_get(cursor, &pkey, &data, DB_NEXT);
+			}
+		} else {
+			db_ret = cursor->c_get(cursor, &pkey, &data, DB_FIRST);
+		}
+
+		while (0 == db_ret && batch_count < batch_size) {
+			db_ret = jaldb_put_timestamp_bin_key(timestamp_db, txn, &pkey, &data,
+					jaldb_extract_datetime_bin_key);
+			if (0 == db_ret) {
+				db_ret = jaldb_put_timestamp_bin_key(nonce_timestamp_db, txn, &pkey, &data,
+						jaldb_extract_nonce_timestamp_bin_key);
+			}
+			if (0 != db_ret) {
+				break;
+			}
+			batch_last.data = jal_realloc(batch_last.data, pkey.size);
+			memcpy(batch_last.data, pkey.data, pkey.size);
+			batch_last.size = pkey.size;
+			batch_count++;
+			if (batch_count < batch_size) {
+				db_ret = cursor->c_get(cursor, &pkey, &data, DB_NEXT);
+			}
+		}
+		if (DB_NOTFOUND == db_ret) {
+			done = 1;
+			db_ret = 0;
+		}
+
+		cursor->c_close(cursor);
+		cursor = NULL;
+
+		if (DB_LOCK_DEADLOCK == db_ret && txn) {
+			// Redo the batch.
+			txn->abort(txn);
+			txn = NULL;
+			continue;
+		}
+		if (0 != db_ret) {
+			JALDB_DB_ERR(rdbs->primary_db, db_ret);
+			goto out;
+		}
+		if (txn) {
+			db_ret = txn->commit(txn, 0);
+			txn = NULL;
+			if (0 != db_ret) {
+				goto out;
+			}
+		}
+
+		if (batch_count) {
+			last.data = jal_realloc(last.data, batch_last.size);
+			memcpy(last.data, batch_last.data, batch_last.size);
+			last.size = batch_last.size;
+		}
+		count += batch_count;
+	}
+
+	// Every record that existed before the pending indices were in use is
+	// indexed now, so the DB can switch over to them.
+	if (env) {
+		db_ret = env->txn_begin(env, NULL, &txn, 0);
+		if (0 != db_ret) {
+			ret = JALDB_E_DB;
+			goto out;
+		}
+	}
+	ret = jaldb_set_db_format(rdbs->metadata_db, txn, JALDB_TIMESTAMP_KEY_FORMAT_NAME,
+			JALDB_TIMESTAMP_KEY_FORMAT_BINARY);
+	if (ret != JALDB_OK) {
+		goto out;
+	}
+	if (txn) {
+		db_ret = txn->commit(txn, 0);
+		txn = NULL;
+		if (0 != db_ret) {
+			ret = JALDB_E_DB;
+			goto out;
+		}
+	}
+
+	if (migrated) {
+		*migrated = count;
+	}
+	ret = JALDB_OK;
+
+out:
+	if (cursor) {
+		cursor->c_close(cursor);
+	}
+	if (txn) {
+		txn->abort(txn);
+	}
+	if (timestamp_db) {
+		timestamp_db->close(timestamp_db, 0);
+	}
+	if (nonce_timestamp_db) {
+		nonce_timestamp_db->close(nonce_timestamp_db, 0);
+	}
+	free(last.data);
+	free(batch_last.data);
+	free(pkey.data);
+	free(data.data);
+	return ret;
+}
@@ -31,12 +31,23 @@
 #define _JALDB_RECORD_BDS_
 
 #include <db.h>
+#include <stdint.h>
 #include "jaldb_status.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/**
+ * The formats of the primary DB keys.
+ */
+enum jaldb_primary_key_format {
+	/** uuid_timestamp_pid_tid, see jaldb_gen_primary_key() */
+	JALDB_PRIMARY_KEY_UUID = 0,
+	/** time_uuid, see jaldb_gen_time_ordered_primary_key() */
+	JALDB_PRIMARY_KEY_TIME_ORDERED,
+};
+
 /**
  * This structure is used to track related DBs for a specific type of record.
  *
@@ -49,10 +60,14 @@ struct jaldb_record_dbs {
 	DB *timestamp_idx_db;       //<! The secondary database to use for timestamps indices.
 	DB *nonce_timestamp_db;     //<! The timestamp associated with the nonce at insertion time
 	DB *record_id_idx_db;       //<! The database to use for record UUID indices
-	DB *record_sent_db;         //<! The database to use for record sent flag indices
 	DB *metadata_db;            //<! The database to use for storing metadata about unconfirmed records
 	DB *network_nonce_idx_db;   //<! The database to use for network nonce indices
-	DB *record_confirmed_db;    //<! The database to use for record confirmed flag indices.
+	DB *state_db;               //<! The sent, synced and confirmed state of each record, keyed by its primary key.
+	DB *state_idx_db;           //<! The secondary database to use for record state indices.
+	DB *pending_timestamp_idx_db;   //<! Binary timestamp index being built while timestamp_idx_db still has XML DateTime keys.
+	DB *pending_nonce_timestamp_db; //<! Binary nonce timestamp index being built while nonce_timestamp_db still has XML DateTime keys.
+	int timestamp_keys_binary;  //<! Whether timestamp_idx_db and nonce_timestamp_db use binary timestamp keys.
+	enum jaldb_primary_key_format primary_key_format; //<! How the keys of primary_db are generated.
 };
 
 /**
@@ -73,13 +88,148 @@ struct jaldb_record_dbs *jaldb_create_record_dbs();
  */
 void jaldb_destroy_record_dbs(struct jaldb_record_dbs **record_dbs);
 
+/**
+ * Open the primary DB and all of its secondary indices.
+ *
+ * New databases index timestamps with binary timestamp keys (see
+ * jaldb_timestamp_key_encode()). Databases created before binary keys
+ * existed keep using the XML DateTime indices until
+ * jaldb_migrate_timestamp_indices() completes; until then the binary indices
+ * are opened as well (unless \p db_flags contains DB_RDONLY) so that they
+ * are kept up to date while the migration runs.
+ *
+ * The primary key format is recorded when the DBs are created, later calls
+ * use the recorded format and ignore \p key_format.
+ *
+ * The state of each record is kept in a DB of its own so that marking a
+ * record sent, synced or confirmed does not rewrite it. Databases created
+ * before that keep the state in the record headers only; the first time
+ * they are opened without DB_RDONLY the state is copied out of the headers.
+ * Until then, \p rdbs->state_db is left NULL when opened with DB_RDONLY.
+ *
+ * @param[in] env The DB environment.
+ * @param[in] txn The transaction to open the DBs in.
+ * @param[in] prefix The prefix of the DB file names, if NULL the DBs are only
+ * kept in memory.
+ * @param[in] db_flags The flags to open the DBs with.
+ * @param[in] key_format The primary key format to use if the DBs are new.
+ * @param[out] pprdbs The opened DBs.
+ *
+ * @return JALDB_OK on success, or an error code.
+ */
 enum jaldb_status jaldb_create_primary_dbs_with_indices(
 		DB_ENV *env,
 		DB_TXN *txn,
 		const char *prefix,
 		const u_int32_t db_flags,
+		enum jaldb_primary_key_format key_format,
 		struct jaldb_record_dbs **pprdbs);
 
+/**
+ * Get the state of a record from \p rdbs->state_db.
+ *
+ * @param[in] rdbs The DBs of the record.
+ * @param[in] txn The transaction to use, may be NULL.
+ * @param[in] pkey The primary key of the record.
+ * @param[out] state The state of the record, a combination of
+ * JALDB_RFLAGS_SENT, JALDB_RFLAGS_SYNCED and JALDB_RFLAGS_CONFIRMED.
+ * @param[in] flags The flags to pass to DB->get().
+ *
+ * @return 0 on success, DB_NOTFOUND if no state is stored for the record
+ * (including when \p rdbs has no state DB), or another Berkeley DB error.
+ */
+int jaldb_record_dbs_get_state(
+		struct jaldb_record_dbs *rdbs,
+		DB_TXN *txn,
+		DBT *pkey,
+		uint32_t *state,
+		u_int32_t flags);
+
+/**
+ * Store the state of a record in \p rdbs->state_db. The record itself is
+ * not touched.
+ *
+ * @param[in] rdbs The DBs of the record.
+ * @param[in] txn The transaction to use, may be NULL.
+ * @param[in] pkey The primary key of the record.
+ * @param[in] state The state of the record.
+ *
+ * @return 0 on success, EINVAL if \p rdbs has no state DB, or another
+ * Berkeley DB error.
+ */
+int jaldb_record_dbs_put_state(
+		struct jaldb_record_dbs *rdbs,
+		DB_TXN *txn,
+		DBT *pkey,
+		uint32_t state);
+
+/**
+ * Move a cursor on \p rdbs->state_idx_db to a record in a given state.
+ *
+ * @param[in] cursor The cursor.
+ * @param[in] state The state to look for.
+ * @param[in] flags DB_SET_RANGE for the first record in \p state, or DB_NEXT
+ * for the one after the current record.
+ * @param[in,out] skey The secondary key, this must have DB_DBT_REALLOC set
+ * and is freed by the caller.
+ * @param[out] pkey Receives the primary key of the record, which points into
+ * \p skey.
+ *
+ * @return 0 on success, DB_NOTFOUND when there are no more records in
+ * \p state, or another Berkeley DB error.
+ */
+int jaldb_record_dbs_state_cursor_get(
+		DBC *cursor,
+		uint32_t state,
+		u_int32_t flags,
+		DBT *skey,
+		DBT *pkey);
+
+/**
+ * Get the binary timestamp key of an entry of \p rdbs->timestamp_idx_db or
+ * \p rdbs->nonce_timestamp_db, regardless of the key format those indices use.
+ *
+ * @param[in] rdbs The DBs the key was read from.
+ * @param[in] key The secondary key.
+ * @param[out] bin_key A buffer of JALDB_TIMESTAMP_KEY_LEN bytes to fill in.
+ *
+ * @return JALDB_OK on success, or JALDB_E_INVAL_TIMESTAMP if the key is not a
+ * valid timestamp.
+ */
+enum jaldb_status jaldb_record_dbs_timestamp_key(
+		const struct jaldb_record_dbs *rdbs,
+		const DBT *key,
+		uint8_t *bin_key);
+
+/**
+ * Fill the binary timestamp indices of a database that still uses XML
+ * DateTime keys, and switch the database over to them.
+ *
+ * The primary DB is walked in transactions of \p batch_size records so that
+ * other processes can keep reading and inserting records while the indices
+ * are built. Records inserted or removed during the migration are indexed by
+ * the handles that have the binary indices associated. Once every record is
+ * indexed, the key format is recorded in the metadata DB and the binary
+ * indices are used the next time the DBs are opened.
+ *
+ * Nothing is done if \p rdbs already uses binary timestamp keys.
+ *
+ * @param[in] env The DB environment, this must be transactional unless it is
+ * NULL.
+ * @param[in] prefix The prefix \p rdbs was opened with, this must not be NULL.
+ * @param[in] rdbs The DBs to migrate, opened without DB_RDONLY.
+ * @param[in] batch_size The number of records to index per transaction.
+ * @param[out] migrated Optional, receives the number of records indexed.
+ *
+ * @return JALDB_OK on success, or an error code.
+ */
+enum jaldb_status jaldb_migrate_timestamp_indices(
+		DB_ENV *env,
+		const char *prefix,
+		struct jaldb_record_dbs *rdbs,
+		u_int32_t batch_size,
+		u_int64_t *migrated);
+
 #ifdef __cplusplus
 }
 #endif
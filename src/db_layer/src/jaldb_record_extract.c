@@ -59,32 +59,6 @@ int jaldb_extract_record_uuid(DB *secondary, const DBT *key, const DBT *data, DB
 	return 0;
 }
 
-int jaldb_extract_record_sent_flag(DB *secondary, const DBT *key, const DBT *data, DBT *result)
-{
-	struct jaldb_serialize_record_headers *headers = NULL;
-
-	if (!data || !result || !data->data || (sizeof(headers) > data->size + JALDB_TIMESTAMP_LENGTH + 1)) {
-		return -1;
-	}
-
-	headers = (struct jaldb_serialize_record_headers*)data->data;
-
-	// TODO: Need BOM for this to work correctly
-	if (headers->version != JALDB_DB_LAYOUT_VERSION) {
-		return -1;
-	}
-
-	result->data = jal_malloc(sizeof(uint32_t));
-	// Set the extractor to use three bits: confirmed, sent, synced
-	// The states are in sequence, so the only valid values should be
-	// conf, conf+sent, conf+sent+sync
-	*((uint32_t*)(result->data)) = headers->flags & (JALDB_RFLAGS_SENT|JALDB_RFLAGS_SYNCED|JALDB_RFLAGS_CONFIRMED);
-	result->size = sizeof(uint32_t);
-	result->flags = DB_DBT_APPMALLOC;
-
-	return 0;
-}
-
 int jaldb_extract_record_network_nonce(DB *secondary, const DBT *key, const DBT *data, DBT *result)
 {
 	char *nnString = NULL;
@@ -117,26 +91,19 @@ int jaldb_extract_record_network_nonce(DB *secondary, const DBT *key, const DBT
 	return 0;
 }
 
-int jaldb_extract_record_confirmed_flag(DB *secondary, const DBT *key, const DBT *data, DBT *result)
+int jaldb_extract_record_state(DB *secondary, const DBT *key, const DBT *data, DBT *result)
 {
-	struct jaldb_serialize_record_headers *headers = NULL;
-
-	if (!data || !result || !data->data || (sizeof(headers) > data->size)) {
+	if (!key || !data || !result || !key->data || !data->data ||
+			sizeof(uint32_t) != data->size) {
 		return -1;
 	}
 
-	headers = (struct jaldb_serialize_record_headers*)data->data;
-
-	// TODO: Need BOM for this to work correctly
-	if (headers->version != JALDB_DB_LAYOUT_VERSION) {
-		return -1;
-	}
-
-
-	result->data = jal_malloc(sizeof(uint32_t));
-	*((uint32_t*)(result->data)) = headers->flags & JALDB_RFLAGS_CONFIRMED;
-	result->size = sizeof(uint32_t);
+	uint8_t *buffer = jal_malloc(data->size + key->size);
+	memcpy(buffer, data->data, data->size);
+	memcpy(buffer + data->size, key->data, key->size);
 
+	result->data = buffer;
+	result->size = data->size + key->size;
 	result->flags = DB_DBT_APPMALLOC;
 
 	return 0;
@@ -52,23 +52,6 @@ extern "C" {
  */
 int jaldb_extract_record_uuid(DB *secondary, const DBT *key, const DBT *data, DBT *result);
 
-/**
- * Function to extract the record sent flag as a secondary key.
- *
- * This function extracts the sent flag component of the JALoP record as it is
- * inserted into the database.
- *
- * @param[in] secondary Pointer to the secondary DB that is getting modified,
- * this is only checked to see if the record is byte-swapped.
- * @param[in] key The key for the data in the primary DB
- * @param[in] data The data for the record
- * @param[out] result the DBT object to fill in for the sent flag secondary key.
- *
- * @return 0 to indicate the record should be indexed, -1 to indicate an error
- * occurred.
- */
-int jaldb_extract_record_sent_flag(DB *secondary, const DBT *key, const DBT *data, DBT *result);
-
 /**
  * Function to extract the network nonce as a secondary key.
  *
@@ -87,21 +70,21 @@ int jaldb_extract_record_sent_flag(DB *secondary, const DBT *key, const DBT *dat
 int jaldb_extract_record_network_nonce(DB *secondary, const DBT *key, const DBT *data, DBT *result);
 
 /**
- * Function to extract the record confirmed flag as a secondary key.
+ * Function to extract the key of a record state index.
  *
- * This function extracts the confirmed flag component of the JALoP record as it is
- * inserted into the database.
+ * The key is the state stored in the record state DB followed by the primary
+ * key of the record, so that the records in one state can be found with a
+ * range search and no two records share a key.
  *
- * @param[in] secondary Pointer to the secondary DB that is getting modified,
- * this is only checked to see if the record is byte-swapped.
- * @param[in] key The key for the data in the primary DB
- * @param[in] data The data for the record
- * @param[out] result the DBT object to fill in for the confirmed flag secondary key.
+ * @param[in] secondary Pointer to the secondary DB that is getting modified.
+ * @param[in] key The primary key of the record
+ * @param[in] data The state of the record
+ * @param[out] result the DBT object to fill in for the state secondary key.
  *
  * @return 0 to indicate the record should be indexed, -1 to indicate an error
  * occurred.
  */
-int jaldb_extract_record_confirmed_flag(DB *secondary, const DBT *key, const DBT *data, DBT *result);
+int jaldb_extract_record_state(DB *secondary, const DBT *key, const DBT *data, DBT *result);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,346 @@
+/**
+ * @file jaldb_record_view.c This file contains the read only view of a
+ * serialized JALoP record.
+ *
+ * @section LICENSE
+ *
+ * Source code in 3rd-party is licensed and owned by their respective
+ * copyright holders.
+ *
+ * All other source code is copyright Tresys Technology and licensed as below.
+ *
+ * Copyright (c) 2012 Tresys Technology LLC, Columbia, Maryland, USA
+ *
+ * This software was developed by Tresys Technology LLC
+ * with U.S. Government sponsorship.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "jal_alloc.h"
+#include "jal_byteswap.h"
+
+#include "jaldb_record_view.h"
+#include "jaldb_segment.h"
+#include "jaldb_serialize_record.h"
+
+void jaldb_record_view_init(struct jaldb_record_view *view)
+{
+	memset(view, 0, sizeof(*view));
+	view->type = JALDB_RTYPE_UNKNOWN;
+}
+
+void jaldb_record_view_free(struct jaldb_record_view *view)
+{
+	if (!view) {
+		return;
+	}
+	free(view->buf);
+	free(view->sys_meta_doc);
+	jaldb_record_view_init(view);
+}
+
+void jaldb_record_view_release(struct jaldb_record_view *view)
+{
+	if (!view) {
+		return;
+	}
+	free(view->sys_meta_doc);
+	view->sys_meta_doc = NULL;
+	view->sys_meta_doc_len = 0;
+	view->size = 0;
+	view->located = 0;
+	view->flags = 0;
+	view->type = JALDB_RTYPE_UNKNOWN;
+}
+
+void jaldb_record_view_reserve(struct jaldb_record_view *view, size_t size)
+{
+	if (size <= view->capacity) {
+		return;
+	}
+	// The old contents are not kept, so there is nothing to copy.
+	free(view->buf);
+	view->buf = (uint8_t *) jal_malloc(size);
+	view->capacity = size;
+}
+
+/**
+ * Copy the headers out of the buffer, which is not necessarily aligned for
+ * them, and swap them to host order.
+ */
+static void jaldb_record_view_headers(const struct jaldb_record_view *view,
+		struct jaldb_serialize_record_headers *headers)
+{
+	memcpy(headers, view->buf, sizeof(*headers));
+	if (view->byte_swap) {
+		headers->version = jal_bswap_16(headers->version);
+		headers->flags = jal_bswap_32(headers->flags);
+		headers->pid = jal_bswap_64(headers->pid);
+		headers->uid = jal_bswap_64(headers->uid);
+		headers->sys_meta_sz = jal_bswap_64(headers->sys_meta_sz);
+		headers->app_meta_sz = jal_bswap_64(headers->app_meta_sz);
+		headers->payload_sz = jal_bswap_64(headers->payload_sz);
+	}
+}
+
+enum jaldb_status jaldb_record_view_set(struct jaldb_record_view *view,
+		char byte_swap, size_t size, enum jaldb_rec_type type)
+{
+	struct jaldb_serialize_record_headers headers;
+
+	if (!view || !view->buf || size > view->capacity) {
+		return JALDB_E_INVAL;
+	}
+	jaldb_record_view_release(view);
+	if (size < sizeof(headers)) {
+		return JALDB_E_INVAL;
+	}
+	view->byte_swap = byte_swap;
+	jaldb_record_view_headers(view, &headers);
+	if (JALDB_DB_LAYOUT_VERSION != headers.version) {
+		return JALDB_E_LAYOUT_VERSION_UNKNOWN;
+	}
+	view->size = size;
+	view->type = type;
+	view->flags = headers.flags;
+	view->offsets[0] = sizeof(headers);
+	return JALDB_OK;
+}
+
+/**
+ * Find where the string at \p off ends, or return 0 if it is longer than
+ * \p max_len or runs off the end of the record.
+ */
+static size_t jaldb_record_view_string_end(const struct jaldb_record_view *view,
+		size_t off, size_t max_len)
+{
+	size_t len = view->size - off;
+	if (len > max_len + 1) {
+		len = max_len + 1;
+	}
+	const uint8_t *end = (const uint8_t *) memchr(view->buf + off, '\0', len);
+	return end ? (size_t) (end - view->buf) + 1 : 0;
+}
+
+/**
+ * Get the flags and the size of the segment \p field from the headers.
+ */
+static void jaldb_record_view_segment_info(const struct jaldb_record_view *view,
+		enum jaldb_record_view_field field, uint32_t *have_flag,
+		uint32_t *on_disk_flag, uint64_t *size)
+{
+	struct jaldb_serialize_record_headers headers;
+	jaldb_record_view_headers(view, &headers);
+	if (JALDB_VIEW_SYS_META == field) {
+		*have_flag = JALDB_RFLAGS_HAVE_SYS_META;
+		*on_disk_flag = JALDB_RFLAGS_SYS_META_ON_DISK;
+		*size = headers.sys_meta_sz;
+	} else if (JALDB_VIEW_APP_META == field) {
+		*have_flag = JALDB_RFLAGS_HAVE_APP_META;
+		*on_disk_flag = JALDB_RFLAGS_APP_META_ON_DISK;
+		*size = headers.app_meta_sz;
+	} else {
+		*have_flag = JALDB_RFLAGS_HAVE_PAYLOAD;
+		*on_disk_flag = JALDB_RFLAGS_PAYLOAD_ON_DISK;
+		*size = headers.payload_sz;
+	}
+}
+
+/**
+ * Locate the fields of the record up to and including \p field.
+ */
+static enum jaldb_status jaldb_record_view_locate(struct jaldb_record_view *view,
+		enum jaldb_record_view_field field)
+{
+	uint32_t have_flag;
+	uint32_t on_disk_flag;
+	uint64_t seg_size;
+
+	if (!view || !view->size) {
+		return JALDB_E_INVAL;
+	}
+	while (view->located <= (int) field) {
+		int cur = view->located;
+		size_t off = view->offsets[cur];
+		size_t next = 0;
+
+		switch (cur) {
+		case JALDB_VIEW_NETWORK_NONCE:
+			if (JALDB_MAX_NETWORK_NONCE_LENGTH >= view->size - off ||
+					0 == jaldb_record_view_string_end(view, off,
+						JALDB_MAX_NETWORK_NONCE_LENGTH)) {
+				return JALDB_E_INVAL;
+			}
+			next = off + JALDB_MAX_NETWORK_NONCE_LENGTH + 1;
+			break;
+		case JALDB_VIEW_TIMESTAMP:
+		case JALDB_VIEW_SOURCE:
+		case JALDB_VIEW_SEC_LBL:
+		case JALDB_VIEW_HOSTNAME:
+		case JALDB_VIEW_USERNAME:
+			next = jaldb_record_view_string_end(view, off, SIZE_MAX - 1);
+			break;
+		default:
+			jaldb_record_view_segment_info(view, (enum jaldb_record_view_field) cur,
+					&have_flag, &on_disk_flag, &seg_size);
+			if (!(view->flags & have_flag)) {
+				next = off;
+			} else if (view->flags & on_disk_flag) {
+				next = jaldb_record_view_string_end(view, off, SIZE_MAX - 1);
+			} else if (seg_size <= view->size - off) {
+				next = off + seg_size;
+			}
+			break;
+		}
+		if (0 == next) {
+			return JALDB_E_INVAL;
+		}
+		view->offsets[cur + 1] = next;
+		view->located = cur + 1;
+	}
+	return JALDB_OK;
+}
+
+enum jaldb_status jaldb_record_view_get_string(struct jaldb_record_view *view,
+		enum jaldb_record_view_field field, const char **str)
+{
+	if (!str || field > JALDB_VIEW_USERNAME) {
+		return JALDB_E_INVAL;
+	}
+	enum jaldb_status ret = jaldb_record_view_locate(view, field);
+	if (JALDB_OK != ret) {
+		return ret;
+	}
+	const char *s = (const char *) view->buf + view->offsets[field];
+	*str = '\0' == *s ? NULL : s;
+	return JALDB_OK;
+}
+
+enum jaldb_status jaldb_record_view_get_segment(struct jaldb_record_view *view,
+		enum jaldb_record_view_field field, const uint8_t **buf,
+		uint64_t *len, int *on_disk)
+{
+	uint32_t have_flag;
+	uint32_t on_disk_flag;
+	uint64_t seg_size;
+
+	if (!buf || !len || !on_disk || field < JALDB_VIEW_SYS_META ||
+			field > JALDB_VIEW_PAYLOAD) {
+		return JALDB_E_INVAL;
+	}
+	enum jaldb_status ret = jaldb_record_view_locate(view, field);
+	if (JALDB_OK != ret) {
+		return ret;
+	}
+	jaldb_record_view_segment_info(view, field, &have_flag, &on_disk_flag, &seg_size);
+
+	*buf = NULL;
+	*len = 0;
+	*on_disk = 0;
+	if (view->flags & have_flag) {
+		*buf = view->buf + view->offsets[field];
+		*len = seg_size;
+		*on_disk = (view->flags & on_disk_flag) ? 1 : 0;
+	} else if (JALDB_VIEW_SYS_META == field && view->sys_meta_doc) {
+		*buf = view->sys_meta_doc;
+		*len = view->sys_meta_doc_len;
+	}
+	return JALDB_OK;
+}
+
+void jaldb_record_view_get_uuid(const struct jaldb_record_view *view, uuid_t uuid)
+{
+	struct jaldb_serialize_record_headers headers;
+	jaldb_record_view_headers(view, &headers);
+	uuid_copy(uuid, headers.record_uuid);
+}
+
+enum jaldb_status jaldb_record_view_to_record(const struct jaldb_record_view *view,
+		struct jaldb_record **record)
+{
+	if (!view || !view->size || !record || *record) {
+		return JALDB_E_INVAL;
+	}
+	// jaldb_deserialize_record() swaps the headers in place, so leave the
+	// view alone.
+	uint8_t *copy = (uint8_t *) jal_malloc(view->size);
+	memcpy(copy, view->buf, view->size);
+	enum jaldb_status ret = jaldb_deserialize_record(view->byte_swap, copy, view->size, record);
+	free(copy);
+	if (JALDB_OK != ret) {
+		return ret;
+	}
+	struct jaldb_record *rec = *record;
+	rec->type = view->type;
+	if (!rec->sys_meta && view->sys_meta_doc) {
+		rec->sys_meta = jaldb_record_create_segment(rec);
+		rec->sys_meta->payload = jaldb_record_alloc(rec, view->sys_meta_doc_len);
+		memcpy(rec->sys_meta->payload, view->sys_meta_doc, view->sys_meta_doc_len);
+		rec->sys_meta->length = view->sys_meta_doc_len;
+	}
+	return JALDB_OK;
+}
+
+void jaldb_record_view_set_sys_meta(struct jaldb_record_view *view,
+		uint8_t *doc, size_t doc_len)
+{
+	free(view->sys_meta_doc);
+	view->sys_meta_doc = doc;
+	view->sys_meta_doc_len = doc_len;
+}
+
+void jaldb_record_batch_init(struct jaldb_record_batch *batch)
+{
+	memset(batch, 0, sizeof(*batch));
+}
+
+void jaldb_record_batch_free(struct jaldb_record_batch *batch)
+{
+	if (!batch) {
+		return;
+	}
+	for (size_t i = 0; i < batch->allocated; i++) {
+		jaldb_record_view_free(&batch->views[i]);
+	}
+	free(batch->views);
+	jaldb_record_batch_init(batch);
+}
+
+void jaldb_record_batch_release(struct jaldb_record_batch *batch)
+{
+	if (!batch) {
+		return;
+	}
+	for (size_t i = 0; i < batch->count; i++) {
+		jaldb_record_view_release(&batch->views[i]);
+	}
+	batch->count = 0;
+}
+
+struct jaldb_record_view *jaldb_record_batch_next_view(struct jaldb_record_batch *batch)
+{
+	if (batch->count == batch->allocated) {
+		size_t allocated = batch->allocated ? 2 * batch->allocated : 16;
+		batch->views = (struct jaldb_record_view *) jal_realloc(batch->views,
+				allocated * sizeof(*batch->views));
+		for (size_t i = batch->allocated; i < allocated; i++) {
+			jaldb_record_view_init(&batch->views[i]);
+		}
+		batch->allocated = allocated;
+	}
+	return &batch->views[batch->count];
+}
@@ -0,0 +1,240 @@
+/**
+ * @file jaldb_record_view.h This file defines a read only view of a
+ * serialized JALoP record, which reads the fields in place instead of
+ * copying them out like jaldb_deserialize_record().
+ *
+ * @section LICENSE
+ *
+ * Source code in 3rd-party is licensed and owned by their respective
+ * copyright holders.
+ *
+ * All other source code is copyright Tresys Technology and licensed as below.
+ *
+ * Copyright (c) 2012 Tresys Technology LLC, Columbia, Maryland, USA
+ *
+ * This software was developed by Tresys Technology LLC
+ * with U.S. Government sponsorship.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+
+#ifndef _JALDB_RECORD_VIEW_H_
+#define _JALDB_RECORD_VIEW_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <uuid/uuid.h>
+
+#include "jaldb_record.h"
+#include "jaldb_status.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * The fields of a serialized record, in the order they are stored.
+ */
+enum jaldb_record_view_field {
+	JALDB_VIEW_TIMESTAMP,
+	JALDB_VIEW_NETWORK_NONCE,
+	JALDB_VIEW_SOURCE,
+	JALDB_VIEW_SEC_LBL,
+	JALDB_VIEW_HOSTNAME,
+	JALDB_VIEW_USERNAME,
+	JALDB_VIEW_SYS_META,
+	JALDB_VIEW_APP_META,
+	JALDB_VIEW_PAYLOAD,
+	JALDB_VIEW_NUM_FIELDS,
+};
+
+/**
+ * A record as it is stored in its primary database, read in place.
+ *
+ * The view owns a buffer that the value is read into with DB_DBT_USERMEM,
+ * and that is kept for the next record. Fields are only located when they
+ * are asked for. Everything returned points into the buffer and is valid
+ * until the view is released.
+ *
+ * The fields of this structure are private.
+ */
+struct jaldb_record_view {
+	uint8_t *buf;                //!< The serialized record.
+	size_t size;                 //!< The size of the serialized record, 0 if the view is empty.
+	size_t capacity;             //!< The allocated size of buf.
+	char byte_swap;              //!< Whether the integers in the headers need to be byte swapped.
+	enum jaldb_rec_type type;    //!< The type of the record.
+	uint32_t flags;              //!< The JALDB_RFLAGS of the record.
+	int located;                 //!< The number of fields located so far.
+	size_t offsets[JALDB_VIEW_NUM_FIELDS + 1]; //!< Where each located field starts, and the one after it.
+	uint8_t *sys_meta_doc;       //!< System metadata generated for a record stored without any.
+	size_t sys_meta_doc_len;     //!< The size of sys_meta_doc.
+};
+
+/**
+ * Initialize an empty view.
+ *
+ * @param[out] view The view.
+ */
+void jaldb_record_view_init(struct jaldb_record_view *view);
+
+/**
+ * Free the memory held by a view.
+ *
+ * @param[in,out] view The view, which is empty afterwards.
+ */
+void jaldb_record_view_free(struct jaldb_record_view *view);
+
+/**
+ * Empty a view, keeping its buffer for the next record.
+ *
+ * @param[in,out] view The view.
+ */
+void jaldb_record_view_release(struct jaldb_record_view *view);
+
+/**
+ * Make sure the buffer of a view holds at least \p size bytes.
+ *
+ * @param[in,out] view The view.
+ * @param[in] size The number of bytes needed.
+ */
+void jaldb_record_view_reserve(struct jaldb_record_view *view, size_t size);
+
+/**
+ * Start viewing the serialized record that was read into the buffer of
+ * \p view. Only the headers are checked.
+ *
+ * @param[in,out] view The view.
+ * @param[in] byte_swap Whether the integers in the headers need to be byte
+ * swapped.
+ * @param[in] size The size of the serialized record.
+ * @param[in] type The type of the record.
+ *
+ * @return JALDB_OK on success, JALDB_E_INVAL if the buffer is too small to
+ * be a record, or JALDB_E_LAYOUT_VERSION_UNKNOWN.
+ */
+enum jaldb_status jaldb_record_view_set(struct jaldb_record_view *view,
+		char byte_swap, size_t size, enum jaldb_rec_type type);
+
+/**
+ * Get one of the string fields of a record.
+ *
+ * @param[in] view The view.
+ * @param[in] field The field, one of JALDB_VIEW_TIMESTAMP through
+ * JALDB_VIEW_USERNAME.
+ * @param[out] str The string, or NULL if it is empty.
+ *
+ * @return JALDB_OK on success, or JALDB_E_INVAL for a bad field or a
+ * malformed record.
+ */
+enum jaldb_status jaldb_record_view_get_string(struct jaldb_record_view *view,
+		enum jaldb_record_view_field field, const char **str);
+
+/**
+ * Get one of the segments of a record. For a segment stored on disk,
+ * \p buf is the relative path of its file.
+ *
+ * @param[in] view The view.
+ * @param[in] field JALDB_VIEW_SYS_META, JALDB_VIEW_APP_META or
+ * JALDB_VIEW_PAYLOAD.
+ * @param[out] buf The contents of the segment, or NULL if the record has
+ * no such segment.
+ * @param[out] len The length of the segment.
+ * @param[out] on_disk Whether the segment is stored on disk.
+ *
+ * @return JALDB_OK on success, or JALDB_E_INVAL for a bad field or a
+ * malformed record.
+ */
+enum jaldb_status jaldb_record_view_get_segment(struct jaldb_record_view *view,
+		enum jaldb_record_view_field field, const uint8_t **buf,
+		uint64_t *len, int *on_disk);
+
+/**
+ * Get the UUID of a record.
+ *
+ * @param[in] view The view.
+ * @param[out] uuid The UUID of the record.
+ */
+void jaldb_record_view_get_uuid(const struct jaldb_record_view *view, uuid_t uuid);
+
+/**
+ * Copy the record out of a view, as jaldb_deserialize_record() does.
+ *
+ * @param[in] view The view.
+ * @param[out] record The record.
+ *
+ * @return JALDB_OK on success, or an error code.
+ */
+enum jaldb_status jaldb_record_view_to_record(const struct jaldb_record_view *view,
+		struct jaldb_record **record);
+
+/**
+ * Use \p doc as the system metadata of a record that was stored without any.
+ * The view takes ownership of \p doc.
+ *
+ * @param[in,out] view The view.
+ * @param[in] doc The system metadata document.
+ * @param[in] doc_len The length of \p doc.
+ */
+void jaldb_record_view_set_sys_meta(struct jaldb_record_view *view,
+		uint8_t *doc, size_t doc_len);
+
+/**
+ * A batch of records, each read into a view of its own.
+ *
+ * The views keep their buffers from one batch to the next, so reading a
+ * batch no bigger than an earlier one does not allocate.
+ */
+struct jaldb_record_batch {
+	struct jaldb_record_view *views; //!< The records in the batch, followed by the unused views.
+	size_t count;                    //!< The number of records in the batch.
+	size_t allocated;                //!< The number of views allocated.
+};
+
+/**
+ * Initialize an empty batch.
+ *
+ * @param[out] batch The batch.
+ */
+void jaldb_record_batch_init(struct jaldb_record_batch *batch);
+
+/**
+ * Free the memory held by a batch.
+ *
+ * @param[in,out] batch The batch, which is empty afterwards.
+ */
+void jaldb_record_batch_free(struct jaldb_record_batch *batch);
+
+/**
+ * Empty a batch, keeping its views and their buffers for the next batch.
+ *
+ * @param[in,out] batch The batch.
+ */
+void jaldb_record_batch_release(struct jaldb_record_batch *batch);
+
+/**
+ * Get the empty view that follows the records of a batch, adding one if
+ * needed. The view becomes part of the batch once the caller increments
+ * \p batch->count.
+ *
+ * @param[in,out] batch The batch.
+ *
+ * @return The view.
+ */
+struct jaldb_record_view *jaldb_record_batch_next_view(struct jaldb_record_batch *batch);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _JALDB_RECORD_VIEW_H_
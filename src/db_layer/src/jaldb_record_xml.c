@@ -40,6 +40,7 @@
 #include "jaldb_record.h"
 #include "jaldb_record_xml.h"
 #include "jal_xml_utils.h"
+#include "jaldb_xml_writer.h"
 
 #define JALDB_XSI_NS         "http://www.w3.org/2001/XMLSchema-instance"
 #define JALDB_JID            "JID"
@@ -65,63 +66,236 @@
 // Theoretical max PID on 64 bit Linux is 4194304
 #define PID_STR_MAX_LEN 10
 #define UID_STR_MAX_LEN 22
+// Big enough for a record with a manifest, so the writer does not need to
+// grow its buffer
+#define JALDB_SYS_META_SIZE_HINT 1536
 
-enum jaldb_status jaldb_record_to_system_metadata_doc(struct jaldb_record *rec,
-						RSA* signing_key,
-						uint8_t *app_meta_dgst, size_t app_meta_dgst_len, const char *app_meta_algorithm_uri,
-						uint8_t *payload_dgst, size_t payload_dgst_len, const char *payload_algorithm_uri,
-						char **doc, size_t *dsize)
-{
-	enum jaldb_status ret;
+/** The generated text that goes into the system metadata of a record */
+struct jaldb_sys_meta_fields {
+	const char *type_str;
 	char uuid_str[UUID_STR_LEN];
 	char uuid_str_with_prefix[UUID_STR_LEN + 5];
 	char host_uuid_str[UUID_STR_LEN];
 	char pid_str[PID_STR_MAX_LEN];
 	char uid_str[UID_STR_MAX_LEN];
-	xmlChar *res = NULL;
-	char *type_str;
-	xmlDocPtr xmlDoc = NULL;
-	xmlNodePtr root_node = NULL;
-
-	if (!rec || !doc || *doc) {
-		return JALDB_E_INVAL;
-	}
+};
 
+static enum jaldb_status jaldb_sys_meta_fields_fill(struct jaldb_record *rec,
+		struct jaldb_sys_meta_fields *f)
+{
 	if (JALDB_OK != jaldb_record_sanity_check(rec)) {
 		return JALDB_E_INVAL;
 	}
 
 	switch(rec->type) {
 	case JALDB_RTYPE_JOURNAL:
-		type_str = JALDB_JOURNAL;
+		f->type_str = JALDB_JOURNAL;
 		break;
 	case JALDB_RTYPE_AUDIT:
-		type_str = JALDB_AUDIT;
+		f->type_str = JALDB_AUDIT;
 		break;
 	case JALDB_RTYPE_LOG:
-		type_str = JALDB_LOG;
+		f->type_str = JALDB_LOG;
 		break;
 	default:
 		return JALDB_E_INVAL;
 	}
 
-	uuid_unparse(rec->uuid, uuid_str);
-	snprintf(uuid_str_with_prefix, UUID_STR_LEN + 5, "UUID-%s", uuid_str);
-	uuid_unparse(rec->host_uuid, host_uuid_str);
- 
-	if (PID_STR_MAX_LEN <= snprintf(pid_str, PID_STR_MAX_LEN, "%"PRIu64, rec->pid)) {
+	uuid_unparse(rec->uuid, f->uuid_str);
+	snprintf(f->uuid_str_with_prefix, UUID_STR_LEN + 5, "UUID-%s", f->uuid_str);
+	uuid_unparse(rec->host_uuid, f->host_uuid_str);
+
+	if (PID_STR_MAX_LEN <= snprintf(f->pid_str, PID_STR_MAX_LEN, "%"PRIu64, rec->pid)) {
 		return JALDB_E_INVAL;
 	}
 
 	if (rec->have_uid) {
-		if (UID_STR_MAX_LEN <= snprintf(uid_str, UID_STR_MAX_LEN, "%"PRIu64, rec->uid)) {
+		if (UID_STR_MAX_LEN <= snprintf(f->uid_str, UID_STR_MAX_LEN, "%"PRIu64, rec->uid)) {
 			return JALDB_E_INVAL;
 		}
 	}
+	return JALDB_OK;
+}
+
+enum jaldb_status jaldb_record_to_system_metadata_doc(struct jaldb_record *rec,
+						struct jal_sign_pool *signing_pool,
+						uint8_t *app_meta_dgst, size_t app_meta_dgst_len, const char *app_meta_algorithm_uri,
+						uint8_t *payload_dgst, size_t payload_dgst_len, const char *payload_algorithm_uri,
+						char **doc, size_t *dsize)
+{
+	enum jaldb_status ret;
+	struct jaldb_xml_writer w;
+
+	if (!rec || !doc || *doc || !dsize) {
+		return JALDB_E_INVAL;
+	}
+
+	// Signing needs the DOM anyway
+	if (signing_pool) {
+		goto dom;
+	}
+
+	jaldb_xml_writer_init(&w, JALDB_SYS_META_SIZE_HINT);
+	ret = jaldb_record_to_system_metadata_write(rec,
+			app_meta_dgst, app_meta_dgst_len, app_meta_algorithm_uri,
+			payload_dgst, payload_dgst_len, payload_algorithm_uri,
+			&w);
+	if (JALDB_OK == ret) {
+		*doc = jaldb_xml_writer_take(&w, dsize);
+		return JALDB_OK;
+	}
+	jaldb_xml_writer_free(&w);
+	if (JALDB_E_NOT_IMPL != ret) {
+		return ret;
+	}
+
+dom:
+	return jaldb_record_to_system_metadata_dom(rec, signing_pool,
+			app_meta_dgst, app_meta_dgst_len, app_meta_algorithm_uri,
+			payload_dgst, payload_dgst_len, payload_algorithm_uri,
+			doc, dsize);
+}
+
+/**
+ * Write an element that holds only text, the way libxml2 formats it.
+ */
+static void jaldb_sys_meta_write_elem(struct jaldb_xml_writer *w,
+		const char *indent_tag, size_t indent_tag_len, const char *text)
+{
+	jaldb_xml_writer_raw(w, indent_tag, indent_tag_len);
+	if (!text || !*text) {
+		jaldb_xml_writer_lit(w, "/>\n");
+		return;
+	}
+	jaldb_xml_writer_lit(w, ">");
+	jaldb_xml_writer_text(w, text);
+	jaldb_xml_writer_lit(w, "</");
+	// Skip the indentation and the '<'
+	jaldb_xml_writer_raw(w, indent_tag + 3, indent_tag_len - 3);
+	jaldb_xml_writer_lit(w, ">\n");
+}
+
+#define JALDB_WRITE_ELEM(w, tag, text) \
+	jaldb_sys_meta_write_elem((w), "  <" tag, sizeof("  <" tag) - 1, (text))
+
+static void jaldb_sys_meta_write_reference(struct jaldb_xml_writer *w,
+		const char *uri, const char *algorithm_uri,
+		const uint8_t *dgst, size_t dgst_len)
+{
+	jaldb_xml_writer_lit(w, "    <Reference URI=\"");
+	jaldb_xml_writer_attr(w, uri);
+	jaldb_xml_writer_lit(w, "\">\n      <DigestMethod Algorithm=\"");
+	jaldb_xml_writer_attr(w, algorithm_uri);
+	jaldb_xml_writer_lit(w, "\"/>\n      <DigestValue xmlns=\"" JAL_XMLDSIG_URI "\">");
+	jaldb_xml_writer_base64(w, dgst, dgst_len);
+	jaldb_xml_writer_lit(w, "</DigestValue>\n    </Reference>\n");
+}
+
+enum jaldb_status jaldb_record_to_system_metadata_write(struct jaldb_record *rec,
+						uint8_t *app_meta_dgst, size_t app_meta_dgst_len, const char *app_meta_algorithm_uri,
+						uint8_t *payload_dgst, size_t payload_dgst_len, const char *payload_algorithm_uri,
+						struct jaldb_xml_writer *w)
+{
+	enum jaldb_status ret;
+	struct jaldb_sys_meta_fields f;
+
+	if (!rec || !w) {
+		return JALDB_E_INVAL;
+	}
+
+	ret = jaldb_sys_meta_fields_fill(rec, &f);
+	if (JALDB_OK != ret) {
+		return ret;
+	}
+
+	// Leave anything libxml2 would escape differently, or reject, to the
+	// DOM
+	if (!jaldb_xml_writer_is_plain(rec->hostname, 0) ||
+			!jaldb_xml_writer_is_plain(rec->timestamp, 0) ||
+			!jaldb_xml_writer_is_plain(rec->sec_lbl, 0) ||
+			!jaldb_xml_writer_is_plain(rec->username, 1)) {
+		return JALDB_E_NOT_IMPL;
+	}
+	if (payload_dgst && (0 == payload_dgst_len || !payload_algorithm_uri ||
+			!jaldb_xml_writer_is_plain(payload_algorithm_uri, 1))) {
+		return JALDB_E_NOT_IMPL;
+	}
+	if (app_meta_dgst && (0 == app_meta_dgst_len || !app_meta_algorithm_uri ||
+			!jaldb_xml_writer_is_plain(app_meta_algorithm_uri, 1))) {
+		return JALDB_E_NOT_IMPL;
+	}
+
+	jaldb_xml_writer_lit(w, "<?xml version=\"1.0\"?>\n"
+			"<" JALDB_RECORD_TAG " xmlns=\"" JAL_SYS_META_NAMESPACE_URI "\" "
+			JALDB_JID "=\"");
+	jaldb_xml_writer_raw(w, f.uuid_str_with_prefix, strlen(f.uuid_str_with_prefix));
+	jaldb_xml_writer_lit(w, "\">\n");
+
+	JALDB_WRITE_ELEM(w, JALDB_DATA_TYPE_TAG, f.type_str);
+	JALDB_WRITE_ELEM(w, JALDB_RECORD_ID_TAG, f.uuid_str);
+	JALDB_WRITE_ELEM(w, JALDB_HOSTNAME_TAG, rec->hostname);
+	JALDB_WRITE_ELEM(w, JALDB_HOST_UUID_TAG, f.host_uuid_str);
+	JALDB_WRITE_ELEM(w, JALDB_TIMESTAMP_TAG, rec->timestamp);
+	JALDB_WRITE_ELEM(w, JALDB_PROCESS_ID_TAG, f.pid_str);
+
+	if (rec->have_uid) {
+		jaldb_xml_writer_lit(w, "  <" JALDB_USER_TAG " " JALDB_USERNAME_PROP "=\"");
+		jaldb_xml_writer_attr(w, rec->username);
+		jaldb_xml_writer_lit(w, "\">");
+		jaldb_xml_writer_raw(w, f.uid_str, strlen(f.uid_str));
+		jaldb_xml_writer_lit(w, "</" JALDB_USER_TAG ">\n");
+	} else {
+		jaldb_xml_writer_lit(w, "  <" JALDB_USER_TAG " xmlns:xsi=\"" JALDB_XSI_NS "\" "
+				JALDB_USERNAME_PROP "=\"");
+		jaldb_xml_writer_attr(w, rec->username);
+		jaldb_xml_writer_lit(w, "\" xsi:nil=\"true\"/>\n");
+	}
+
+	if (rec->sec_lbl) {
+		JALDB_WRITE_ELEM(w, JALDB_SEC_LABEL_TAG, rec->sec_lbl);
+	}
+
+	if (payload_dgst || app_meta_dgst) {
+		jaldb_xml_writer_lit(w, "  <Manifest xmlns=\"" JAL_XMLDSIG_URI "\">\n");
+		if (payload_dgst) {
+			jaldb_sys_meta_write_reference(w, JAL_PAYLOAD_URI,
+					payload_algorithm_uri, payload_dgst, payload_dgst_len);
+		}
+		if (app_meta_dgst) {
+			jaldb_sys_meta_write_reference(w, JAL_APP_META_URI,
+					app_meta_algorithm_uri, app_meta_dgst, app_meta_dgst_len);
+		}
+		jaldb_xml_writer_lit(w, "  </Manifest>\n");
+	}
+
+	jaldb_xml_writer_lit(w, "</" JALDB_RECORD_TAG ">\n");
+	return JALDB_OK;
+}
+
+enum jaldb_status jaldb_record_to_system_metadata_dom(struct jaldb_record *rec,
+						struct jal_sign_pool *signing_pool,
+						uint8_t *app_meta_dgst, size_t app_meta_dgst_len, const char *app_meta_algorithm_uri,
+						uint8_t *payload_dgst, size_t payload_dgst_len, const char *payload_algorithm_uri,
+						char **doc, size_t *dsize)
+{
+	enum jaldb_status ret;
+	struct jaldb_sys_meta_fields f;
+	xmlChar *res = NULL;
+	xmlDocPtr xmlDoc = NULL;
+	xmlNodePtr root_node = NULL;
+
+	if (!rec || !doc || *doc) {
+		return JALDB_E_INVAL;
+	}
+
+	ret = jaldb_sys_meta_fields_fill(rec, &f);
+	if (JALDB_OK != ret) {
+		return ret;
+	}
 
 	xmlDoc = xmlNewDoc((xmlChar *) "1.0");
 	root_node = xmlNewDocNode(xmlDoc, NULL, (xmlChar *) JALDB_RECORD_TAG, NULL);
-	xmlSetProp(root_node, (xmlChar *) JALDB_JID, (xmlChar *) uuid_str_with_prefix);
+	xmlSetProp(root_node, (xmlChar *) JALDB_JID, (xmlChar *) f.uuid_str_with_prefix);
 
 	xmlNsPtr ns = xmlNewNs(root_node, (xmlChar *) JAL_SYS_META_NAMESPACE_URI, NULL);
 	xmlSetNs(root_node, ns);
@@ -133,19 +307,19 @@ enum jaldb_status jaldb_record_to_system_metadata_doc(struct jaldb_record *rec,
 		xmlFreeDoc(xmlDoc);
 		return JALDB_E_INVAL;
 	}
-	xmlAddID(NULL, xmlDoc, (xmlChar *)uuid_str_with_prefix, attr);
+	xmlAddID(NULL, xmlDoc, (xmlChar *)f.uuid_str_with_prefix, attr);
 
-	xmlNewChild(root_node, NULL, (xmlChar *) JALDB_DATA_TYPE_TAG, (xmlChar *) type_str);
-	xmlNewChild(root_node, NULL, (xmlChar *) JALDB_RECORD_ID_TAG, (xmlChar *) uuid_str);
+	xmlNewChild(root_node, NULL, (xmlChar *) JALDB_DATA_TYPE_TAG, (xmlChar *) f.type_str);
+	xmlNewChild(root_node, NULL, (xmlChar *) JALDB_RECORD_ID_TAG, (xmlChar *) f.uuid_str);
 	xmlNewChild(root_node, NULL, (xmlChar *) JALDB_HOSTNAME_TAG, (xmlChar *) rec->hostname);
-	xmlNewChild(root_node, NULL, (xmlChar *) JALDB_HOST_UUID_TAG, (xmlChar *) host_uuid_str);
+	xmlNewChild(root_node, NULL, (xmlChar *) JALDB_HOST_UUID_TAG, (xmlChar *) f.host_uuid_str);
 	xmlNewChild(root_node, NULL, (xmlChar *) JALDB_TIMESTAMP_TAG, (xmlChar *) rec->timestamp);
-	xmlNewChild(root_node, NULL, (xmlChar *) JALDB_PROCESS_ID_TAG, (xmlChar *) pid_str);
+	xmlNewChild(root_node, NULL, (xmlChar *) JALDB_PROCESS_ID_TAG, (xmlChar *) f.pid_str);
 	xmlNodePtr last_node = xmlNewChild(root_node, NULL, (xmlChar *) JALDB_USER_TAG, NULL);
 	xmlSetProp(last_node, (xmlChar *) JALDB_USERNAME_PROP, (xmlChar *) rec->username);
 
 	if (rec->have_uid) {
-		xmlNodeSetContent(last_node, (xmlChar *) uid_str);
+		xmlNodeSetContent(last_node, (xmlChar *) f.uid_str);
 	} else {
 		// TODO
 		ns = xmlNewNs(last_node, (xmlChar *) JALDB_XSI_NS, (xmlChar*) "xsi");
@@ -189,8 +363,8 @@ enum jaldb_status jaldb_record_to_system_metadata_doc(struct jaldb_record *rec,
 		last_node = NULL;
 	} 
 
-	if (signing_key) {
-		ret = jal_add_signature_block(signing_key, NULL, xmlDoc, last_node, uuid_str_with_prefix);
+	if (signing_pool) {
+		ret = jal_sign_pool_add_signature_block(signing_pool, xmlDoc, last_node, f.uuid_str_with_prefix);
 		if (0 != ret) {
 			xmlFreeDoc(xmlDoc);
 			return ret;
@@ -41,16 +41,23 @@ extern "C" {
 #endif
 
 struct jaldb_record;
+struct jal_sign_pool;
+struct jaldb_xml_writer;
 
 /**
  * Generate a XML document for the system meta-data.
+ * Unsigned documents are written straight to a buffer by
+ * #jaldb_record_to_system_metadata_write; signed documents, and records
+ * the writer cannot handle, are built with libxml2 by
+ * #jaldb_record_to_system_metadata_dom. Both give the same bytes.
+ *
  * Note that although the returned buffer is NULL terminated, the length
  * returned in \p dsize, will be the number of characters in the
  * buffer, not including the NULL terminator.
  *
  * @param [in] rec The record to create the document for.
- * @param [in] signing_key The key to sign the document with. If NULL, the
- * document will be left unsigned
+ * @param [in] signing_pool The signing contexts to sign the document with.
+ * If NULL, the document will be left unsigned
  * @param [in] app_meta_dgst The digest of the application metadata. If NULL
  * the manifest will not include this digest.
  * @param [in] payload_dgst The digest of the payload. If NULL the manifest
@@ -63,7 +70,45 @@ struct jaldb_record;
  * @return JALDB_OK on success, or an error code.
  */
 enum jaldb_status jaldb_record_to_system_metadata_doc(struct jaldb_record *rec,
-		RSA *signing_key,
+		struct jal_sign_pool *signing_pool,
+		uint8_t *app_meta_dgst, size_t app_meta_dgst_len, const char *app_meta_algorithm_uri,
+		uint8_t *payload_dgst, size_t payload_dgst_len, const char *payload_algorithm_uri,
+		char **doc,
+		size_t *dsize);
+
+/**
+ * Write the unsigned system meta-data document for \p rec to \p w,
+ * without building a DOM. The document is appended to whatever \p w
+ * already holds.
+ *
+ * The output is byte for byte what #jaldb_record_to_system_metadata_dom
+ * produces without a signing pool.
+ *
+ * @param [in] rec The record to create the document for.
+ * @param [in] app_meta_dgst The digest of the application metadata, or NULL.
+ * @param [in] payload_dgst The digest of the payload, or NULL.
+ * @param [in,out] w The writer to append the document to.
+ *
+ * @return
+ *  - JALDB_OK on success
+ *  - JALDB_E_INVAL if the record is not valid
+ *  - JALDB_E_NOT_IMPL if the record has text libxml2 would write
+ *  differently, in which case nothing is written and the caller should use
+ *  #jaldb_record_to_system_metadata_dom
+ */
+enum jaldb_status jaldb_record_to_system_metadata_write(struct jaldb_record *rec,
+		uint8_t *app_meta_dgst, size_t app_meta_dgst_len, const char *app_meta_algorithm_uri,
+		uint8_t *payload_dgst, size_t payload_dgst_len, const char *payload_algorithm_uri,
+		struct jaldb_xml_writer *w);
+
+/**
+ * Generate the system meta-data document by building it with libxml2.
+ * The parameters are the same as #jaldb_record_to_system_metadata_doc.
+ *
+ * @return JALDB_OK on success, or an error code.
+ */
+enum jaldb_status jaldb_record_to_system_metadata_dom(struct jaldb_record *rec,
+		struct jal_sign_pool *signing_pool,
 		uint8_t *app_meta_dgst, size_t app_meta_dgst_len, const char *app_meta_algorithm_uri,
 		uint8_t *payload_dgst, size_t payload_dgst_len, const char *payload_algorithm_uri,
 		char **doc,
@@ -32,6 +32,7 @@
 #include "jal_alloc.h"
 #include "jal_byteswap.h"
 
+#include "jaldb_arena.h"
 #include "jaldb_record.h"
 #include "jaldb_segment.h"
 #include "jaldb_serialize_record.h"
@@ -265,6 +266,33 @@ err_out:
 	return ret;
 }
 
+uint32_t jaldb_record_get_state(const struct jaldb_record *record)
+{
+	uint32_t state = 0;
+	if (JALDB_SENT == record->synced) {  // record is sent but not synced
+		state |= JALDB_RFLAGS_SENT;
+	}
+	if (JALDB_SYNCED == record->synced) { // record is both synced and sent
+		state |= JALDB_RFLAGS_SYNCED | JALDB_RFLAGS_SENT;
+	}
+	if (record->confirmed) {
+		state |= JALDB_RFLAGS_CONFIRMED;
+	}
+	return state;
+}
+
+void jaldb_record_set_state(struct jaldb_record *record, uint32_t state)
+{
+	if (state & JALDB_RFLAGS_SENT && state & JALDB_RFLAGS_SYNCED) {
+		record->synced = JALDB_SYNCED; // Record sent and synced.
+	} else if (!(state & JALDB_RFLAGS_SYNCED) && state & JALDB_RFLAGS_SENT) {
+		record->synced = JALDB_SENT; // Record sent but not synced.
+	} else {
+		record->synced = JALDB_NOT_SENT; // Record not sent.
+	}
+	record->confirmed = state & JALDB_RFLAGS_CONFIRMED ? 1 : 0;
+}
+
 enum jaldb_status jaldb_serialize_record(
 					const char byte_swap,
 					struct jaldb_record *record,
@@ -357,16 +385,7 @@ enum jaldb_status jaldb_serialize_record(
 	if (record->have_uid) {
 		headers.flags |= bs32(JALDB_RFLAGS_HAVE_UID);
 	}
-	if (JALDB_SENT == record->synced) {  // record is sent but not synced
-		headers.flags |= bs32(JALDB_RFLAGS_SENT);
-	}
-	if (JALDB_SYNCED == record->synced) { // record is both synced and sent
-		headers.flags |= bs32(JALDB_RFLAGS_SYNCED);
-		headers.flags |= bs32(JALDB_RFLAGS_SENT);
-	}
-	if (record->confirmed) {
-		headers.flags |= bs32(JALDB_RFLAGS_CONFIRMED);
-	}
+	headers.flags |= bs32(jaldb_record_get_state(record));
 	headers.pid = bs64(record->pid);
 	headers.uid = bs64(record->uid);
 	uuid_copy(headers.host_uuid, record->host_uuid);
@@ -395,6 +414,17 @@ out:
 	return ret;
 }
 
+static enum jaldb_status jaldb_deserialize_arena_string(struct jaldb_arena *arena,
+		uint8_t **buffer, size_t *size, char** str);
+static enum jaldb_status jaldb_deserialize_arena_fixed_string(struct jaldb_arena *arena,
+		uint8_t **buffer, size_t *buf_size, size_t str_size, char** str);
+static enum jaldb_status jaldb_deserialize_arena_segment(struct jaldb_arena *arena,
+		char on_disk,
+		uint64_t segment_length,
+		uint8_t **buffer,
+		size_t *bsize,
+		struct jaldb_segment **segment);
+
 enum jaldb_status jaldb_deserialize_record(
 					const char byte_swap,
 					uint8_t *buffer,
@@ -428,7 +458,7 @@ enum jaldb_status jaldb_deserialize_record(
 	}
 
 	headers = (struct jaldb_serialize_record_headers*) buffer;
-	res = jaldb_create_record();
+	res = jaldb_create_arena_record();
 
 	headers->version = bs16(headers->version);
 	if (headers->version != JALDB_DB_LAYOUT_VERSION) {
@@ -439,15 +469,8 @@ enum jaldb_status jaldb_deserialize_record(
 
 	res->version = JALDB_DB_LAYOUT_VERSION;
 	res->type = JALDB_RTYPE_UNKNOWN;
-	if (headers->flags & JALDB_RFLAGS_SENT && headers->flags & JALDB_RFLAGS_SYNCED) {
-		res->synced = JALDB_SYNCED; // Record sent and synced.
-	} else if (!(headers->flags & JALDB_RFLAGS_SYNCED) && headers->flags & JALDB_RFLAGS_SENT) {
-		res->synced = JALDB_SENT; // Record sent but not synced.
-	} else {
-		res->synced = JALDB_NOT_SENT; // Record not sent.
-	}
+	jaldb_record_set_state(res, headers->flags);
 	res->have_uid = headers->flags & JALDB_RFLAGS_HAVE_UID ? 1 : 0;
-	res->confirmed = headers->flags & JALDB_RFLAGS_CONFIRMED ? 1 : 0;
 	res->pid = bs64(headers->pid);
 	res->uid = bs64(headers->uid);
 	uuid_copy(res->host_uuid, headers->host_uuid);
@@ -456,33 +479,35 @@ enum jaldb_status jaldb_deserialize_record(
 	buffer += sizeof(*headers);
 	bsize -= sizeof(*headers);
 
-	ret = jaldb_deserialize_string(&buffer, &bsize, &res->timestamp);
+	ret = jaldb_deserialize_arena_string(res->arena, &buffer, &bsize, &res->timestamp);
 	if (ret != JALDB_OK) {
 		goto err_out;
 	}
-	ret = jaldb_deserialize_fixed_string(&buffer, &bsize, JALDB_MAX_NETWORK_NONCE_LENGTH, &res->network_nonce);
+	ret = jaldb_deserialize_arena_fixed_string(res->arena, &buffer, &bsize,
+			JALDB_MAX_NETWORK_NONCE_LENGTH, &res->network_nonce);
 	if (ret != JALDB_OK) {
 		goto err_out;
 	}
-	ret = jaldb_deserialize_string(&buffer, &bsize, &res->source);
+	ret = jaldb_deserialize_arena_string(res->arena, &buffer, &bsize, &res->source);
 	if (ret != JALDB_OK) {
 		goto err_out;
 	}
-	ret = jaldb_deserialize_string(&buffer, &bsize, &res->sec_lbl);
+	ret = jaldb_deserialize_arena_string(res->arena, &buffer, &bsize, &res->sec_lbl);
 	if (ret != JALDB_OK) {
 		goto err_out;
 	}
-	ret = jaldb_deserialize_string(&buffer, &bsize, &res->hostname);
+	ret = jaldb_deserialize_arena_string(res->arena, &buffer, &bsize, &res->hostname);
 	if (ret != JALDB_OK) {
 		goto err_out;
 	}
-	ret = jaldb_deserialize_string(&buffer, &bsize, &res->username);
+	ret = jaldb_deserialize_arena_string(res->arena, &buffer, &bsize, &res->username);
 	if (ret != JALDB_OK) {
 		goto err_out;
 	}
 
 	if (headers->flags & JALDB_RFLAGS_HAVE_SYS_META) {
-		ret = jaldb_deserialize_segment(headers->flags & JALDB_RFLAGS_SYS_META_ON_DISK ? 1 : 0,
+		ret = jaldb_deserialize_arena_segment(res->arena,
+				headers->flags & JALDB_RFLAGS_SYS_META_ON_DISK ? 1 : 0,
 				headers->sys_meta_sz,
 				&buffer,
 				&bsize,
@@ -493,7 +518,8 @@ enum jaldb_status jaldb_deserialize_record(
 	}
 
 	if (headers->flags & JALDB_RFLAGS_HAVE_APP_META) {
-		ret = jaldb_deserialize_segment(headers->flags & JALDB_RFLAGS_APP_META_ON_DISK ? 1 : 0,
+		ret = jaldb_deserialize_arena_segment(res->arena,
+				headers->flags & JALDB_RFLAGS_APP_META_ON_DISK ? 1 : 0,
 				headers->app_meta_sz,
 				&buffer,
 				&bsize,
@@ -503,7 +529,8 @@ enum jaldb_status jaldb_deserialize_record(
 		}
 	}
 	if (headers->flags & JALDB_RFLAGS_HAVE_PAYLOAD) {
-		ret = jaldb_deserialize_segment(headers->flags & JALDB_RFLAGS_PAYLOAD_ON_DISK ? 1 : 0,
+		ret = jaldb_deserialize_arena_segment(res->arena,
+				headers->flags & JALDB_RFLAGS_PAYLOAD_ON_DISK ? 1 : 0,
 				headers->payload_sz,
 				&buffer,
 				&bsize,
@@ -521,7 +548,17 @@ out:
 	return ret;
 }
 
-enum jaldb_status jaldb_deserialize_string(uint8_t **buffer, size_t *size, char** str)
+/**
+ * Copy a deserialized string into \p arena, or with jal_strdup() if
+ * \p arena is NULL.
+ */
+static char *jaldb_deserialize_strdup(struct jaldb_arena *arena, const char *str)
+{
+	return arena ? jaldb_arena_strdup(arena, str) : jal_strdup(str);
+}
+
+static enum jaldb_status jaldb_deserialize_arena_string(struct jaldb_arena *arena,
+		uint8_t **buffer, size_t *size, char** str)
 {
 	if (!buffer || !*buffer || !size || !str || *str) {
 		return JALDB_E_INVAL;
@@ -542,13 +579,14 @@ enum jaldb_status jaldb_deserialize_string(uint8_t **buffer, size_t *size, char*
 		return JALDB_E_INVAL;
 	}
 
-	*str = jal_strdup((char*)*buffer);
+	*str = jaldb_deserialize_strdup(arena, (char*)*buffer);
 	*buffer += (s_len + 1);
 	*size -= (s_len + 1);
 	return JALDB_OK;
 }
 
-enum jaldb_status jaldb_deserialize_fixed_string(uint8_t **buffer, size_t *buf_size, size_t str_size, char** str)
+static enum jaldb_status jaldb_deserialize_arena_fixed_string(struct jaldb_arena *arena,
+		uint8_t **buffer, size_t *buf_size, size_t str_size, char** str)
 {
 	if (!buffer || !*buffer || !buf_size || !str || *str) {
 		return JALDB_E_INVAL;
@@ -579,13 +617,14 @@ enum jaldb_status jaldb_deserialize_fixed_string(uint8_t **buffer, size_t *buf_s
 		return JALDB_E_INVAL;
 	}
 
-	*str = jal_strdup((char*)*buffer);
+	*str = jaldb_deserialize_strdup(arena, (char*)*buffer);
 	*buffer += (str_size + 1);
 	*buf_size -= (str_size + 1);
 	return JALDB_OK;
 }
 
-enum jaldb_status jaldb_deserialize_segment(char on_disk,
+static enum jaldb_status jaldb_deserialize_arena_segment(struct jaldb_arena *arena,
+		char on_disk,
 		uint64_t segment_length,
 		uint8_t **buffer,
 		size_t *bsize,
@@ -595,11 +634,17 @@ enum jaldb_status jaldb_deserialize_segment(char on_disk,
 		return JALDB_E_INVAL;
 	}
 	enum jaldb_status ret;
-	struct jaldb_segment *seg = jaldb_create_segment();
+	struct jaldb_segment *seg = NULL;
+	if (arena) {
+		seg = jaldb_arena_calloc(arena, sizeof(*seg));
+		seg->fd = -1;
+	} else {
+		seg = jaldb_create_segment();
+	}
 	seg->length = segment_length;
 	if (on_disk) {
 		char *pl = NULL;
-		ret = jaldb_deserialize_string(buffer, bsize, &pl);
+		ret = jaldb_deserialize_arena_string(arena, buffer, bsize, &pl);
 		if (ret != JALDB_OK) {
 			ret = JALDB_E_INVAL;
 			goto err_out;
@@ -612,7 +657,8 @@ enum jaldb_status jaldb_deserialize_segment(char on_disk,
 			ret = JALDB_E_INVAL;
 			goto err_out;
 		}
-		seg->payload = (uint8_t*)jal_malloc(seg->length);
+		seg->payload = arena ? (uint8_t*)jaldb_arena_alloc(arena, seg->length) :
+			(uint8_t*)jal_malloc(seg->length);
 		memcpy(seg->payload, *buffer, seg->length);
 		*buffer += seg->length;
 		*bsize -= seg->length;
@@ -621,8 +667,30 @@ enum jaldb_status jaldb_deserialize_segment(char on_disk,
 	*segment = seg;
 	goto out;
 err_out:
-	jaldb_destroy_segment(&seg);
+	if (!arena) {
+		jaldb_destroy_segment(&seg);
+	}
 out:
 	return ret;
 }
 
+enum jaldb_status jaldb_deserialize_string(uint8_t **buffer, size_t *size, char** str)
+{
+	return jaldb_deserialize_arena_string(NULL, buffer, size, str);
+}
+
+enum jaldb_status jaldb_deserialize_fixed_string(uint8_t **buffer, size_t *buf_size, size_t str_size, char** str)
+{
+	return jaldb_deserialize_arena_fixed_string(NULL, buffer, buf_size, str_size, str);
+}
+
+enum jaldb_status jaldb_deserialize_segment(char on_disk,
+		uint64_t segment_length,
+		uint8_t **buffer,
+		size_t *bsize,
+		struct jaldb_segment **segment)
+{
+	return jaldb_deserialize_arena_segment(NULL, on_disk, segment_length,
+			buffer, bsize, segment);
+}
+
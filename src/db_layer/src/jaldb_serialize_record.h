@@ -48,6 +48,7 @@ extern "C" {
 #define JALDB_RFLAGS_SYNCED           (1 << 7)
 #define JALDB_RFLAGS_SENT             (1 << 8)
 #define JALDB_RFLAGS_CONFIRMED        (1 << 9)
+#define JALDB_RFLAGS_STATE (JALDB_RFLAGS_SYNCED | JALDB_RFLAGS_SENT | JALDB_RFLAGS_CONFIRMED)
 
 struct jaldb_record;
 struct jaldb_segment;
@@ -159,6 +160,24 @@ enum jaldb_status jaldb_serialize_inc_by_segment_size(size_t *size, const struct
  */
 enum jaldb_status jaldb_serialize_inc_by_fixed_string(size_t *size, size_t str_len);
 
+/**
+ * Get the state of a record as JALDB_RFLAGS_SENT, JALDB_RFLAGS_SYNCED and
+ * JALDB_RFLAGS_CONFIRMED flags.
+ *
+ * @param[in] record The record.
+ *
+ * @return The state flags of \p record.
+ */
+uint32_t jaldb_record_get_state(const struct jaldb_record *record);
+
+/**
+ * Set the synced and confirmed members of a record from state flags.
+ *
+ * @param[in,out] record The record.
+ * @param[in] state The state flags, other flags are ignored.
+ */
+void jaldb_record_set_state(struct jaldb_record *record, uint32_t state);
+
 /**
  * Utility to serialize a \p jaldb_record to a memory buffer
  * @param[in] byte_swap Flag to control whether or not integer fields need to
@@ -182,7 +201,8 @@ enum jaldb_status jaldb_serialize_record(
  * @param[in] buffer The buffer to de-serialize
  * @param[in] bsize The size (in bytes) of \p buffer
  * @param[out] record The de-serialized contents of \p buffer as a \p
- * jaldb_record.
+ * jaldb_record. The record and its members are held in an arena, see
+ * jaldb_create_arena_record().
  *
  * @return JALDB_OK on success, or an error code.
  */
@@ -38,6 +38,7 @@
 #define JALDB_JOURNAL_CONF_NAME "conf_journal"
 #define JALDB_AUDIT_CONF_NAME "conf_audit"
 #define JALDB_LOG_CONF_NAME "conf_log"
+#define JALDB_NOTIFY_FILE_NAME "__jaldb_notify"
 
 #define JALDB_INITIAL_NONCE "0"
 #define JALDB_DEFAULT_OFFSET "0"
@@ -69,6 +70,13 @@
 #define JALDB_SYNC_META_SUFFIX "..sync"
 #define JALDB_SENT_META_SUFFIX "..sent"
 
+#define JALDB_TIMESTAMP_KEY_FORMAT_NAME "timestamp_key_format"
+#define JALDB_TIMESTAMP_KEY_FORMAT_BINARY "binary"
+#define JALDB_PRIMARY_KEY_FORMAT_NAME "primary_key_format"
+#define JALDB_PRIMARY_KEY_FORMAT_TIME_ORDERED "time_ordered"
+#define JALDB_RECORD_STATE_FORMAT_NAME "record_state_format"
+#define JALDB_RECORD_STATE_FORMAT_STATE_DB "state_db"
+
 #define JALDB_GLOBAL_SYNCED_KEY "global_synced"
 #define JALDB_GLOBAL_SENT_KEY "global_sent"
 
@@ -0,0 +1,192 @@
+/**
+ * @file jaldb_sys_meta_cache.cpp This file implements the cache of
+ * generated system metadata documents.
+ *
+ * @section LICENSE
+ *
+ * Source code in 3rd-party is licensed and owned by their respective
+ * copyright holders.
+ *
+ * All other source code is copyright Tresys Technology and licensed as below.
+ *
+ * Copyright (c) 2012 Tresys Technology LLC, Columbia, Maryland, USA
+ *
+ * This software was developed by Tresys Technology LLC
+ * with U.S. Government sponsorship.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <list>
+#include <pthread.h>
+#include <string.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "jal_alloc.h"
+
+#include "jaldb_sys_meta_cache.h"
+
+struct jaldb_sys_meta_cache_entry {
+	std::vector<uint8_t> doc;
+	std::list<std::string>::iterator lru_pos;	//!< Position in jaldb_sys_meta_cache::lru
+};
+
+typedef std::unordered_map<std::string, jaldb_sys_meta_cache_entry> jaldb_sys_meta_cache_map;
+
+struct jaldb_sys_meta_cache {
+	pthread_mutex_t lock;
+	size_t max_entries;
+	uint64_t max_bytes;
+	jaldb_sys_meta_cache_map entries;
+	std::list<std::string> lru;			//!< Keys, most recently used first
+	struct jaldb_sys_meta_cache_stats stats;	//!< Protected by lock
+};
+
+// Nonces are only unique within a record type
+static std::string jaldb_sys_meta_cache_key(enum jaldb_rec_type type, const char *nonce)
+{
+	std::string key(1, (char) type);
+	key.append(nonce);
+	return key;
+}
+
+// Must be called with the lock held
+static void jaldb_sys_meta_cache_erase(struct jaldb_sys_meta_cache *cache,
+		jaldb_sys_meta_cache_map::iterator it)
+{
+	cache->stats.bytes -= it->second.doc.size();
+	cache->stats.entries--;
+	cache->lru.erase(it->second.lru_pos);
+	cache->entries.erase(it);
+}
+
+struct jaldb_sys_meta_cache *jaldb_sys_meta_cache_create(size_t max_entries, uint64_t max_bytes)
+{
+	if (0 == max_entries) {
+		return NULL;
+	}
+	struct jaldb_sys_meta_cache *cache = new jaldb_sys_meta_cache();
+	pthread_mutex_init(&cache->lock, NULL);
+	cache->max_entries = max_entries;
+	cache->max_bytes = max_bytes ? max_bytes : UINT64_MAX;
+	memset(&cache->stats, 0, sizeof(cache->stats));
+	return cache;
+}
+
+void jaldb_sys_meta_cache_destroy(struct jaldb_sys_meta_cache **pcache)
+{
+	if (!pcache || !*pcache) {
+		return;
+	}
+	pthread_mutex_destroy(&(*pcache)->lock);
+	delete *pcache;
+	*pcache = NULL;
+}
+
+enum jaldb_status jaldb_sys_meta_cache_get(struct jaldb_sys_meta_cache *cache,
+		enum jaldb_rec_type type, const char *nonce,
+		uint8_t **doc, size_t *doc_len)
+{
+	if (!cache || !nonce || !doc || *doc || !doc_len) {
+		return JALDB_E_INVAL;
+	}
+	std::string key = jaldb_sys_meta_cache_key(type, nonce);
+
+	pthread_mutex_lock(&cache->lock);
+	jaldb_sys_meta_cache_map::iterator it = cache->entries.find(key);
+	if (it == cache->entries.end()) {
+		cache->stats.misses++;
+		pthread_mutex_unlock(&cache->lock);
+		return JALDB_E_NOT_FOUND;
+	}
+	cache->stats.hits++;
+	cache->lru.splice(cache->lru.begin(), cache->lru, it->second.lru_pos);
+	const std::vector<uint8_t> &cached = it->second.doc;
+	*doc = (uint8_t *) jal_malloc(cached.size());
+	memcpy(*doc, cached.data(), cached.size());
+	*doc_len = cached.size();
+	pthread_mutex_unlock(&cache->lock);
+	return JALDB_OK;
+}
+
+enum jaldb_status jaldb_sys_meta_cache_put(struct jaldb_sys_meta_cache *cache,
+		enum jaldb_rec_type type, const char *nonce,
+		const uint8_t *doc, size_t doc_len)
+{
+	if (!cache || !nonce || !doc) {
+		return JALDB_E_INVAL;
+	}
+	if (doc_len > cache->max_bytes) {
+		return JALDB_OK;
+	}
+	std::string key = jaldb_sys_meta_cache_key(type, nonce);
+
+	pthread_mutex_lock(&cache->lock);
+	jaldb_sys_meta_cache_map::iterator it = cache->entries.find(key);
+	if (it != cache->entries.end()) {
+		jaldb_sys_meta_cache_erase(cache, it);
+	}
+	while (!cache->lru.empty() && (cache->stats.entries >= cache->max_entries ||
+			cache->stats.bytes + doc_len > cache->max_bytes)) {
+		jaldb_sys_meta_cache_erase(cache, cache->entries.find(cache->lru.back()));
+		cache->stats.evictions++;
+	}
+	cache->lru.push_front(key);
+	jaldb_sys_meta_cache_entry &entry = cache->entries[key];
+	entry.doc.assign(doc, doc + doc_len);
+	entry.lru_pos = cache->lru.begin();
+	cache->stats.entries++;
+	cache->stats.bytes += doc_len;
+	pthread_mutex_unlock(&cache->lock);
+	return JALDB_OK;
+}
+
+void jaldb_sys_meta_cache_remove(struct jaldb_sys_meta_cache *cache,
+		enum jaldb_rec_type type, const char *nonce)
+{
+	if (!cache || !nonce) {
+		return;
+	}
+	std::string key = jaldb_sys_meta_cache_key(type, nonce);
+
+	pthread_mutex_lock(&cache->lock);
+	jaldb_sys_meta_cache_map::iterator it = cache->entries.find(key);
+	if (it != cache->entries.end()) {
+		jaldb_sys_meta_cache_erase(cache, it);
+	}
+	pthread_mutex_unlock(&cache->lock);
+}
+
+void jaldb_sys_meta_cache_add_write_back(struct jaldb_sys_meta_cache *cache)
+{
+	if (!cache) {
+		return;
+	}
+	pthread_mutex_lock(&cache->lock);
+	cache->stats.write_backs++;
+	pthread_mutex_unlock(&cache->lock);
+}
+
+enum jaldb_status jaldb_sys_meta_cache_get_stats(struct jaldb_sys_meta_cache *cache,
+		struct jaldb_sys_meta_cache_stats *stats)
+{
+	if (!cache || !stats) {
+		return JALDB_E_INVAL;
+	}
+	pthread_mutex_lock(&cache->lock);
+	*stats = cache->stats;
+	pthread_mutex_unlock(&cache->lock);
+	return JALDB_OK;
+}
@@ -0,0 +1,146 @@
+/**
+ * @file jaldb_sys_meta_cache.h This file contains the functions of the
+ * cache of generated system metadata documents.
+ *
+ * @section LICENSE
+ *
+ * Source code in 3rd-party is licensed and owned by their respective
+ * copyright holders.
+ *
+ * All other source code is copyright Tresys Technology and licensed as below.
+ *
+ * Copyright (c) 2012 Tresys Technology LLC, Columbia, Maryland, USA
+ *
+ * This software was developed by Tresys Technology LLC
+ * with U.S. Government sponsorship.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _JALDB_SYS_META_CACHE_H_
+#define _JALDB_SYS_META_CACHE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "jaldb_record.h"
+#include "jaldb_status.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * A bounded, least recently used cache of the system metadata documents
+ * generated for records that were stored without one, keyed by record type
+ * and nonce. A cache may be shared by several jaldb_contexts, and is safe
+ * to use from several threads.
+ */
+struct jaldb_sys_meta_cache;
+
+/**
+ * Metrics about a jaldb_sys_meta_cache.
+ */
+struct jaldb_sys_meta_cache_stats {
+	uint64_t hits;		//!< Lookups served from the cache
+	uint64_t misses;	//!< Lookups that had to generate the document
+	uint64_t evictions;	//!< Documents dropped to stay within the limits
+	uint64_t write_backs;	//!< Documents stored back into their record
+	uint64_t entries;	//!< Documents currently cached
+	uint64_t bytes;		//!< Size of the documents currently cached
+};
+
+/**
+ * Create a cache.
+ *
+ * @param[in] max_entries The most documents to keep, must be at least 1.
+ * @param[in] max_bytes The most bytes of documents to keep, or 0 for no
+ * limit.
+ *
+ * @return The new cache, or NULL if \p max_entries is 0.
+ */
+struct jaldb_sys_meta_cache *jaldb_sys_meta_cache_create(size_t max_entries, uint64_t max_bytes);
+
+/**
+ * Destroy a cache. No jaldb_context may still be using it.
+ *
+ * @param[in,out] pcache The cache to destroy, set to NULL.
+ */
+void jaldb_sys_meta_cache_destroy(struct jaldb_sys_meta_cache **pcache);
+
+/**
+ * Look up the system metadata of a record.
+ *
+ * @param[in] cache The cache.
+ * @param[in] type The type of the record.
+ * @param[in] nonce The nonce of the record.
+ * @param[out] doc A newly allocated copy of the document.
+ * @param[out] doc_len The size of \p doc.
+ *
+ * @return JALDB_OK on a hit, JALDB_E_NOT_FOUND on a miss, or JALDB_E_INVAL.
+ */
+enum jaldb_status jaldb_sys_meta_cache_get(struct jaldb_sys_meta_cache *cache,
+		enum jaldb_rec_type type, const char *nonce,
+		uint8_t **doc, size_t *doc_len);
+
+/**
+ * Add the system metadata of a record, dropping the least recently used
+ * documents if the cache is full. Documents larger than the byte limit
+ * are not cached.
+ *
+ * @param[in] cache The cache.
+ * @param[in] type The type of the record.
+ * @param[in] nonce The nonce of the record.
+ * @param[in] doc The document, copied into the cache.
+ * @param[in] doc_len The size of \p doc.
+ *
+ * @return JALDB_OK, or JALDB_E_INVAL.
+ */
+enum jaldb_status jaldb_sys_meta_cache_put(struct jaldb_sys_meta_cache *cache,
+		enum jaldb_rec_type type, const char *nonce,
+		const uint8_t *doc, size_t doc_len);
+
+/**
+ * Drop the system metadata of a record, e.g. once it is stored in the
+ * record.
+ *
+ * @param[in] cache The cache.
+ * @param[in] type The type of the record.
+ * @param[in] nonce The nonce of the record.
+ */
+void jaldb_sys_meta_cache_remove(struct jaldb_sys_meta_cache *cache,
+		enum jaldb_rec_type type, const char *nonce);
+
+/**
+ * Count a document stored back into its record.
+ *
+ * @param[in] cache The cache.
+ */
+void jaldb_sys_meta_cache_add_write_back(struct jaldb_sys_meta_cache *cache);
+
+/**
+ * Retrieve the cache metrics.
+ *
+ * @param[in] cache The cache.
+ * @param[out] stats Receives a copy of the metrics.
+ *
+ * @return JALDB_OK, or JALDB_E_INVAL.
+ */
+enum jaldb_status jaldb_sys_meta_cache_get_stats(struct jaldb_sys_meta_cache *cache,
+		struct jaldb_sys_meta_cache_stats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _JALDB_SYS_META_CACHE_H_
@@ -36,6 +36,7 @@
 #include "jal_asprintf_internal.h"
 
 #include "jaldb_context.hpp"
+#include "jaldb_datetime.h"
 #include "jaldb_record_dbs.h"
 #include "jaldb_serialize_record.h"
 #include "jaldb_traverse.h"
@@ -49,16 +50,13 @@ enum jaldb_status jaldb_iterate_by_timestamp(jaldb_context *ctx,
 		jaldb_iter_cb cb, void *up)
 {
 	enum jaldb_status ret = JALDB_E_INVAL;
-	struct tm target_time, record_time;
-	memset(&target_time, 0, sizeof(target_time));
-	memset(&record_time, 0, sizeof(record_time));
-	int target_ms = 0;
-	int record_ms = 0;
-	char *tmp_time = NULL;
+	uint8_t target_key[JALDB_TIMESTAMP_KEY_LEN];
+	uint8_t record_key[JALDB_TIMESTAMP_KEY_LEN];
 	struct jaldb_record *rec = NULL;
 	int byte_swap = 0;
 	struct jaldb_record_dbs *rdbs = NULL;
 	int db_ret = 0;
+	uint32_t state;
 	DBT key;
 	DBT pkey;
 	DBT val;
@@ -68,23 +66,14 @@ enum jaldb_status jaldb_iterate_by_timestamp(jaldb_context *ctx,
 	memset(&val, 0, sizeof(val));
 	key.flags = DB_DBT_REALLOC;
 	val.flags = DB_DBT_REALLOC;
-	time_t target_secs = 0;
 
-	tmp_time = strptime(timestamp, "%Y-%m-%dT%H:%M:%S", &target_time);
-	if (!tmp_time) {
+	if (!timestamp ||
+			JALDB_OK != jaldb_timestamp_key_encode(timestamp, strlen(timestamp), target_key)) {
 		fprintf(stderr, "ERROR: Invalid time format specified.\n");
 		ret = JALDB_E_INVAL_TIMESTAMP;
 		goto out;
 	}
 
-	if (!sscanf(tmp_time,".%d-%*d:%*d", &target_ms)) {
-		fprintf(stderr, "ERROR: Invalid time format specified.\n");
-		ret = JALDB_E_INVAL_TIMESTAMP;
-		goto out;
-	}
-	// Calculate the target time in secs once before we start looping
-	target_secs = mktime(&target_time);
-
 	if (!ctx || !cb) {
 		ret = JALDB_E_UNINITIALIZED;
 		goto out;
@@ -136,37 +125,30 @@ enum jaldb_status jaldb_iterate_by_timestamp(jaldb_context *ctx,
 			goto out;
 		}
 
-		// mktime() like to set things like timezone to system timezone - need to clean out the tm struct before each call
-		memset(&record_time, 0, sizeof(record_time));
-
-		tmp_time = strptime((char*) key.data, "%Y-%m-%dT%H:%M:%S", &record_time);
-		if (!tmp_time) {
-			fprintf(stderr, "ERROR: Cannot get strptime from record\n");
-			ret = JALDB_E_INVAL_TIMESTAMP;
-			goto out;
-		}
-
-		if (!sscanf(tmp_time,".%d-%*d:%*d", &record_ms)) {
+		if (JALDB_OK != jaldb_record_dbs_timestamp_key(rdbs, &key, record_key)) {
+			fprintf(stderr, "ERROR: Cannot get timestamp from record\n");
 			ret = JALDB_E_INVAL_TIMESTAMP;
 			goto out;
 		}
 
-		double delta = difftime(target_secs,mktime(&record_time));
-		if (delta < 0) {
+		if (0 < memcmp(record_key, target_key, JALDB_TIMESTAMP_KEY_TIME_LEN)) {
 			// record_time is > target_time, so break out
-			goto out; 
-		}
-		
-		if (delta == 0) {
-			if (record_ms > target_ms) {
-				goto out;
-			}
+			goto out;
 		}
 
 		ret = jaldb_deserialize_record(byte_swap, (uint8_t*) val.data, val.size, &rec);
 		if (ret != JALDB_OK) {
 			goto out;
 		}
+		db_ret = jaldb_record_dbs_get_state(rdbs, NULL, &pkey, &state, DB_DEGREE_2);
+		if (0 == db_ret) {
+			jaldb_record_set_state(rec, state);
+		} else if (DB_NOTFOUND != db_ret) {
+			JALDB_DB_ERR(rdbs->state_db, db_ret);
+			ret = JALDB_E_INVAL;
+			goto out;
+		}
+		db_ret = 0;
 
 		switch (cb((char*) pkey.data, rec, up)) {
 		case JALDB_ITER_CONT:
@@ -217,16 +199,13 @@ enum jaldb_status jaldb_iterate_by_timestamp2(jaldb_context *ctx,
 		jaldb_iter_cb cb, void *up)
 {
 	enum jaldb_status ret = JALDB_E_INVAL;
-	struct tm target_time, record_time;
-	memset(&target_time, 0, sizeof(target_time));
-	memset(&record_time, 0, sizeof(record_time));
-	int target_ms = 0;
-	int record_ms = 0;
-	char *tmp_time = NULL;
+	uint8_t target_key[JALDB_TIMESTAMP_KEY_LEN];
+	uint8_t record_key[JALDB_TIMESTAMP_KEY_LEN];
 	struct jaldb_record *rec = NULL;
 	int byte_swap = 0;
 	struct jaldb_record_dbs *rdbs = NULL;
 	int db_ret = 0;
+	uint32_t state;
 	DBT key;
 	DBT pkey;
 	DBT val;
@@ -236,24 +215,15 @@ enum jaldb_status jaldb_iterate_by_timestamp2(jaldb_context *ctx,
 	memset(&val, 0, sizeof(val));
 	key.flags = DB_DBT_REALLOC;
 	val.flags = DB_DBT_REALLOC;
-	time_t target_secs = 0;
 	list<string> purge_nonce_list;
 
-	tmp_time = strptime(timestamp, "%Y-%m-%dT%H:%M:%S", &target_time);
-	if (!tmp_time) {
+	if (!timestamp ||
+			JALDB_OK != jaldb_timestamp_key_encode(timestamp, strlen(timestamp), target_key)) {
 		fprintf(stderr, "ERROR: Invalid time format specified.\n");
 		ret = JALDB_E_INVAL_TIMESTAMP;
 		goto out;
 	}
 
-	if (!sscanf(tmp_time,".%d-%*d:%*d", &target_ms)) {
-		fprintf(stderr, "ERROR: Invalid time format specified.\n");
-		ret = JALDB_E_INVAL_TIMESTAMP;
-		goto out;
-	}
-	// Calculate the target time in secs once before we start looping
-	target_secs = mktime(&target_time);
-
 	if (!ctx || !cb) {
 		ret = JALDB_E_UNINITIALIZED;
 		goto out;
@@ -305,37 +275,30 @@ enum jaldb_status jaldb_iterate_by_timestamp2(jaldb_context *ctx,
 			goto out;
 		}
 
-		// mktime() like to set things like timezone to system timezone - need to clean out the tm struct before each call
-		memset(&record_time, 0, sizeof(record_time));
-
-		tmp_time = strptime((char*) key.data, "%Y-%m-%dT%H:%M:%S", &record_time);
-		if (!tmp_time) {
-			fprintf(stderr, "ERROR: Cannot get strptime from record\n");
-			ret = JALDB_E_INVAL_TIMESTAMP;
-			goto out;
-		}
-
-		if (!sscanf(tmp_time,".%d-%*d:%*d", &record_ms)) {
+		if (JALDB_OK != jaldb_record_dbs_timestamp_key(rdbs, &key, record_key)) {
+			fprintf(stderr, "ERROR: Cannot get timestamp from record\n");
 			ret = JALDB_E_INVAL_TIMESTAMP;
 			goto out;
 		}
 
-		double delta = difftime(target_secs,mktime(&record_time));
-		if (delta < 0) {
+		if (0 < memcmp(record_key, target_key, JALDB_TIMESTAMP_KEY_TIME_LEN)) {
 			// record_time is > target_time, so break out
-			goto out; 
-		}
-		
-		if (delta == 0) {
-			if (record_ms > target_ms) {
-				goto out;
-			}
+			goto out;
 		}
 
 		ret = jaldb_deserialize_record(byte_swap, (uint8_t*) val.data, val.size, &rec);
 		if (ret != JALDB_OK) {
 			goto out;
 		}
+		db_ret = jaldb_record_dbs_get_state(rdbs, NULL, &pkey, &state, DB_DEGREE_2);
+		if (0 == db_ret) {
+			jaldb_record_set_state(rec, state);
+		} else if (DB_NOTFOUND != db_ret) {
+			JALDB_DB_ERR(rdbs->state_db, db_ret);
+			ret = JALDB_E_INVAL;
+			goto out;
+		}
+		db_ret = 0;
 
 		switch (cb((char*) pkey.data, rec, up)) {
 		case JALDB_ITER_CONT:
@@ -32,12 +32,14 @@
 #include "jal_asprintf_internal.h"
 #include "jal_fs_utils.h"
 #include "jaldb_context.h"
+#include "jaldb_datetime.h"
 #include "jaldb_record_dbs.h"
 
 #include <errno.h>
 #include <fcntl.h>
 #include <jalop/jal_status.h>
 #include <stdio.h>
+#include <time.h>
 #include <sys/stat.h>
 #include <sys/syscall.h>
 #include <sys/types.h>
@@ -50,6 +52,9 @@
 
 #define UUID_STR_LEN 37
 
+static pthread_mutex_t jaldb_primary_key_mutex = PTHREAD_MUTEX_INITIALIZER;
+static int64_t jaldb_last_primary_key_ns = INT64_MIN;
+
 enum jaldb_status jaldb_store_confed_nonce(DB *db, DB_TXN *txn, const char *remote_host,
 		const char *nonce, int *db_err_out)
 {
@@ -280,3 +285,40 @@ char *jaldb_gen_primary_key(uuid_t uuid)
 
 	return key;
 }
+
+char *jaldb_gen_time_ordered_primary_key(uuid_t uuid)
+{
+	if (uuid_is_null(uuid)) {
+		return NULL;
+	}
+
+	struct timespec now;
+	if (0 != clock_gettime(CLOCK_REALTIME, &now)) {
+		return NULL;
+	}
+	int64_t ns = (int64_t)now.tv_sec * 1000000000LL + now.tv_nsec;
+
+	// Records inserted within the clock resolution, or after the clock
+	// is set back, still get increasing keys.
+	pthread_mutex_lock(&jaldb_primary_key_mutex);
+	if (ns <= jaldb_last_primary_key_ns) {
+		ns = jaldb_last_primary_key_ns + 1;
+	}
+	jaldb_last_primary_key_ns = ns;
+	pthread_mutex_unlock(&jaldb_primary_key_mutex);
+
+	uint8_t ts_key[JALDB_TIMESTAMP_KEY_LEN];
+	jaldb_timestamp_key_from_ns(ns, ts_key);
+
+	char uuid_str[UUID_STR_LEN];
+	uuid_unparse_lower(uuid, uuid_str);
+
+	char *key = jal_malloc(JALDB_TIME_ORDERED_KEY_PREFIX_LEN + 1 + UUID_STR_LEN);
+	for (int i = 0; i < JALDB_TIMESTAMP_KEY_TIME_LEN; i++) {
+		sprintf(key + 2 * i, "%02x", ts_key[i]);
+	}
+	key[JALDB_TIME_ORDERED_KEY_PREFIX_LEN] = '_';
+	memcpy(key + JALDB_TIME_ORDERED_KEY_PREFIX_LEN + 1, uuid_str, UUID_STR_LEN);
+
+	return key;
+}
@@ -118,6 +118,21 @@ char *jaldb_gen_timestamp();
  */
 char *jaldb_gen_primary_key(uuid_t uuid);
 
+/**
+ * Generate a time ordered primary key for use in the database. The format is:
+ * time_uuid
+ * where time is the current time as JALDB_TIME_ORDERED_KEY_PREFIX_LEN lower
+ * case hex digits (see jaldb_timestamp_key_from_ns()). The time strictly
+ * increases between the keys generated by a process, so the keys sort in the
+ * order they were generated and new records are appended to the end of the
+ * primary DB.
+ *
+ * @param[in] uuid the uuid to use in the key
+ *
+ * @return key generated, or NULL on error
+ */
+char *jaldb_gen_time_ordered_primary_key(uuid_t uuid);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,179 @@
+/**
+ * @file jaldb_xml_writer.c This file contains the functions used to write
+ * XML text straight into a reusable buffer.
+ *
+ * @section LICENSE
+ *
+ * Source code in 3rd-party is licensed and owned by their respective
+ * copyright holders.
+ *
+ * All other source code is copyright Tresys Technology and licensed as below.
+ *
+ * Copyright (c) 2012 Tresys Technology LLC, Columbia, Maryland, USA
+ *
+ * This software was developed by Tresys Technology LLC
+ * with U.S. Government sponsorship.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <openssl/evp.h>
+
+#include "jal_alloc.h"
+
+#include "jaldb_xml_writer.h"
+
+#define JALDB_XML_WRITER_MIN_CAP 256
+
+/**
+ * Make room for \p extra more bytes plus the NUL terminator.
+ */
+static void jaldb_xml_writer_reserve(struct jaldb_xml_writer *w, size_t extra)
+{
+	size_t need = w->len + extra + 1;
+	if (need <= w->cap) {
+		return;
+	}
+	size_t cap = w->cap ? w->cap : JALDB_XML_WRITER_MIN_CAP;
+	while (cap < need) {
+		cap *= 2;
+	}
+	w->buf = jal_realloc(w->buf, cap);
+	w->cap = cap;
+}
+
+void jaldb_xml_writer_init(struct jaldb_xml_writer *w, size_t size_hint)
+{
+	w->buf = NULL;
+	w->len = 0;
+	w->cap = 0;
+	if (size_hint) {
+		w->buf = jal_malloc(size_hint);
+		w->buf[0] = '\0';
+		w->cap = size_hint;
+	}
+}
+
+void jaldb_xml_writer_reset(struct jaldb_xml_writer *w)
+{
+	w->len = 0;
+	if (w->buf) {
+		w->buf[0] = '\0';
+	}
+}
+
+void jaldb_xml_writer_free(struct jaldb_xml_writer *w)
+{
+	free(w->buf);
+	w->buf = NULL;
+	w->len = 0;
+	w->cap = 0;
+}
+
+char *jaldb_xml_writer_take(struct jaldb_xml_writer *w, size_t *len)
+{
+	jaldb_xml_writer_reserve(w, 0);
+	w->buf[w->len] = '\0';
+	char *buf = w->buf;
+	*len = w->len;
+	w->buf = NULL;
+	w->len = 0;
+	w->cap = 0;
+	return buf;
+}
+
+void jaldb_xml_writer_raw(struct jaldb_xml_writer *w, const char *s, size_t len)
+{
+	jaldb_xml_writer_reserve(w, len);
+	memcpy(w->buf + w->len, s, len);
+	w->len += len;
+	w->buf[w->len] = '\0';
+}
+
+/**
+ * Append \p s, replacing the characters that have an entry in \p escapes.
+ * Runs of characters that need no escaping are copied in one go.
+ */
+static void jaldb_xml_writer_escaped(struct jaldb_xml_writer *w, const char *s,
+		const char *const escapes[256])
+{
+	if (!s) {
+		return;
+	}
+	const char *run = s;
+	for (; *s; s++) {
+		const char *esc = escapes[(unsigned char) *s];
+		if (!esc) {
+			continue;
+		}
+		jaldb_xml_writer_raw(w, run, s - run);
+		jaldb_xml_writer_raw(w, esc, strlen(esc));
+		run = s + 1;
+	}
+	jaldb_xml_writer_raw(w, run, s - run);
+}
+
+// The same replacements as xmlEscapeEntities() in libxml2
+static const char *const jaldb_xml_text_escapes[256] = {
+	['&'] = "&amp;",
+	['<'] = "&lt;",
+	['>'] = "&gt;",
+};
+
+// The same replacements as xmlBufAttrSerializeTxtContent() in libxml2
+static const char *const jaldb_xml_attr_escapes[256] = {
+	['\t'] = "&#9;",
+	['\n'] = "&#10;",
+	['"'] = "&quot;",
+	['&'] = "&amp;",
+	['<'] = "&lt;",
+	['>'] = "&gt;",
+};
+
+void jaldb_xml_writer_text(struct jaldb_xml_writer *w, const char *s)
+{
+	jaldb_xml_writer_escaped(w, s, jaldb_xml_text_escapes);
+}
+
+void jaldb_xml_writer_attr(struct jaldb_xml_writer *w, const char *s)
+{
+	jaldb_xml_writer_escaped(w, s, jaldb_xml_attr_escapes);
+}
+
+void jaldb_xml_writer_base64(struct jaldb_xml_writer *w, const uint8_t *data, size_t len)
+{
+	size_t enc_len = 4 * ((len + 2) / 3);
+	jaldb_xml_writer_reserve(w, enc_len);
+	// EVP_EncodeBlock() NUL terminates, which the reserve left room for
+	EVP_EncodeBlock((unsigned char *) w->buf + w->len, data, (int) len);
+	w->len += enc_len;
+}
+
+int jaldb_xml_writer_is_plain(const char *s, int allow_amp)
+{
+	if (!s) {
+		return 1;
+	}
+	for (; *s; s++) {
+		unsigned char c = (unsigned char) *s;
+		if ((c < 0x20 && c != '\t' && c != '\n') || c >= 0x80) {
+			return 0;
+		}
+		if (c == '&' && !allow_amp) {
+			return 0;
+		}
+	}
+	return 1;
+}
@@ -0,0 +1,147 @@
+/**
+ * @file jaldb_xml_writer.h This file contains the functions used to write
+ * XML text straight into a reusable buffer.
+ *
+ * @section LICENSE
+ *
+ * Source code in 3rd-party is licensed and owned by their respective
+ * copyright holders.
+ *
+ * All other source code is copyright Tresys Technology and licensed as below.
+ *
+ * Copyright (c) 2012 Tresys Technology LLC, Columbia, Maryland, USA
+ *
+ * This software was developed by Tresys Technology LLC
+ * with U.S. Government sponsorship.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _JALDB_XML_WRITER_H_
+#define _JALDB_XML_WRITER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * A growable output buffer for XML text.
+ *
+ * The escaping matches what libxml2 produces when it saves a document
+ * without an encoding, for the characters #jaldb_xml_writer_is_plain
+ * accepts. Anything else should go through libxml2 instead.
+ *
+ * The buffer is kept between documents, so once it has grown to the size
+ * of the largest document, writing another one does not allocate.
+ */
+struct jaldb_xml_writer {
+	char *buf;	//!< The text written so far, NUL terminated.
+	size_t len;	//!< The number of bytes in \p buf, not counting the NUL.
+	size_t cap;	//!< The number of bytes allocated for \p buf.
+};
+
+/**
+ * Set up an empty writer.
+ *
+ * @param[out] w The writer.
+ * @param[in] size_hint How many bytes to allocate up front, may be 0.
+ */
+void jaldb_xml_writer_init(struct jaldb_xml_writer *w, size_t size_hint);
+
+/**
+ * Drop the text in \p w, keeping the buffer for the next document.
+ *
+ * @param[in,out] w The writer.
+ */
+void jaldb_xml_writer_reset(struct jaldb_xml_writer *w);
+
+/**
+ * Release the buffer of \p w.
+ *
+ * @param[in,out] w The writer, left empty.
+ */
+void jaldb_xml_writer_free(struct jaldb_xml_writer *w);
+
+/**
+ * Hand the buffer of \p w to the caller, who must free() it. The writer is
+ * left empty and may be used again.
+ *
+ * @param[in,out] w The writer.
+ * @param[out] len The number of bytes in the buffer, not counting the NUL.
+ *
+ * @return The NUL terminated text.
+ */
+char *jaldb_xml_writer_take(struct jaldb_xml_writer *w, size_t *len);
+
+/**
+ * Append \p len bytes without escaping them.
+ *
+ * @param[in,out] w The writer.
+ * @param[in] s The bytes to append.
+ * @param[in] len The number of bytes.
+ */
+void jaldb_xml_writer_raw(struct jaldb_xml_writer *w, const char *s, size_t len);
+
+/**
+ * Append a string literal without escaping it.
+ */
+#define jaldb_xml_writer_lit(w, s) jaldb_xml_writer_raw((w), (s), sizeof(s) - 1)
+
+/**
+ * Append a NUL terminated string, escaped as element content.
+ *
+ * @param[in,out] w The writer.
+ * @param[in] s The string. NULL is treated as an empty string.
+ */
+void jaldb_xml_writer_text(struct jaldb_xml_writer *w, const char *s);
+
+/**
+ * Append a NUL terminated string, escaped as an attribute value. The
+ * quotes are not written.
+ *
+ * @param[in,out] w The writer.
+ * @param[in] s The string. NULL is treated as an empty string.
+ */
+void jaldb_xml_writer_attr(struct jaldb_xml_writer *w, const char *s);
+
+/**
+ * Append the base64 encoding of \p len bytes, without line breaks.
+ *
+ * @param[in,out] w The writer.
+ * @param[in] data The bytes to encode.
+ * @param[in] len The number of bytes.
+ */
+void jaldb_xml_writer_base64(struct jaldb_xml_writer *w, const uint8_t *data, size_t len);
+
+/**
+ * Check whether \p s only has characters the writer escapes the same way
+ * libxml2 does: printable ASCII, tab and newline. Carriage returns are left
+ * out since libxml2 releases escape them differently.
+ *
+ * @param[in] s The string. NULL counts as plain.
+ * @param[in] allow_amp Whether '&' is allowed. libxml2 reads entity
+ * references out of element content given to xmlNewChild(), so '&' only
+ * round trips in attribute values.
+ *
+ * @return 1 if \p s is plain, 0 otherwise.
+ */
+int jaldb_xml_writer_is_plain(const char *s, int allow_amp);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _JALDB_XML_WRITER_H_
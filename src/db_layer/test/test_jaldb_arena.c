@@ -0,0 +1,174 @@
+/**
+ * @file test_jaldb_arena.c This file contains functions to test the bump
+ * allocator that holds the members of a jaldb_record.
+ *
+ * @section LICENSE
+ *
+ * Source code in 3rd-party is licensed and owned by their respective
+ * copyright holders.
+ *
+ * All other source code is copyright Tresys Technology and licensed as below.
+ *
+ * Copyright (c) 2012 Tresys Technology LLC, Columbia, Maryland, USA
+ *
+ * This software was developed by Tresys Technology LLC
+ * with U.S. Government sponsorship.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <test-dept.h>
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "jaldb_arena.h"
+
+static struct jaldb_arena *arena;
+
+void setup()
+{
+	arena = jaldb_arena_get();
+}
+
+void teardown()
+{
+	jaldb_arena_put(&arena);
+}
+
+void test_arena_alloc_returns_aligned_distinct_memory()
+{
+	uint8_t *a = jaldb_arena_alloc(arena, 3);
+	uint8_t *b = jaldb_arena_alloc(arena, 5);
+	uint8_t *c = jaldb_arena_alloc(arena, 0);
+	uint8_t *d = jaldb_arena_alloc(arena, 1);
+
+	assert_not_equals((void*) NULL, a);
+	assert_equals(0, (uintptr_t) a % 8);
+	assert_equals(0, (uintptr_t) b % 8);
+	assert_true(b >= a + 3);
+	assert_true(c >= b + 5);
+	assert_true(d > c);
+	memset(a, 'a', 3);
+	memset(b, 'b', 5);
+	assert_equals('a', a[2]);
+}
+
+void test_arena_calloc_zeroes_memory()
+{
+	uint8_t *a = jaldb_arena_alloc(arena, 64);
+	memset(a, 0xff, 64);
+	jaldb_arena_put(&arena);
+
+	// The arena just released is reused, with its old contents.
+	arena = jaldb_arena_get();
+	uint8_t *b = jaldb_arena_calloc(arena, 64);
+	for (int i = 0; i < 64; i++) {
+		assert_equals(0, b[i]);
+	}
+}
+
+void test_arena_strdup_works()
+{
+	char *str = jaldb_arena_strdup(arena, "some string");
+	assert_string_equals("some string", str);
+	assert_true(jaldb_arena_owns(arena, str));
+	assert_pointer_equals((void*) NULL, jaldb_arena_strdup(arena, NULL));
+	str = jaldb_arena_strdup(arena, "");
+	assert_string_equals("", str);
+}
+
+void test_arena_grows_past_a_chunk()
+{
+	uint8_t *first = jaldb_arena_alloc(arena, 16);
+	uint8_t *small = NULL;
+	for (int i = 0; i < 3 * JALDB_ARENA_CHUNK_SIZE / 100; i++) {
+		small = jaldb_arena_alloc(arena, 100);
+		memset(small, i, 100);
+	}
+	uint8_t *big = jaldb_arena_alloc(arena, 3 * JALDB_ARENA_CHUNK_SIZE);
+	memset(big, 0, 3 * JALDB_ARENA_CHUNK_SIZE);
+	uint8_t *after = jaldb_arena_alloc(arena, 16);
+
+	assert_true(jaldb_arena_owns(arena, first));
+	assert_true(jaldb_arena_owns(arena, small));
+	assert_true(jaldb_arena_owns(arena, big));
+	assert_true(jaldb_arena_owns(arena, big + 3 * JALDB_ARENA_CHUNK_SIZE - 1));
+	assert_true(jaldb_arena_owns(arena, after));
+	// The big allocation has its own chunk, small ones keep using the
+	// current chunk.
+	assert_true(after == small + 104);
+}
+
+void test_arena_owns_fails_for_other_memory()
+{
+	char *str = strdup("malloced");
+	assert_false(jaldb_arena_owns(arena, str));
+	assert_false(jaldb_arena_owns(arena, NULL));
+	assert_false(jaldb_arena_owns(NULL, str));
+	free(str);
+}
+
+void test_arena_put_works_with_null()
+{
+	struct jaldb_arena *null_arena = NULL;
+	jaldb_arena_put(&null_arena);
+	jaldb_arena_put(NULL);
+}
+
+void test_arena_put_keeps_a_bounded_pool()
+{
+	struct jaldb_arena *arenas[JALDB_ARENA_POOL_SIZE + 2];
+	int i;
+	for (i = 0; i < JALDB_ARENA_POOL_SIZE + 2; i++) {
+		arenas[i] = jaldb_arena_get();
+		jaldb_arena_alloc(arenas[i], 2 * JALDB_ARENA_CHUNK_SIZE);
+	}
+	for (i = 0; i < JALDB_ARENA_POOL_SIZE + 2; i++) {
+		jaldb_arena_put(&arenas[i]);
+		assert_pointer_equals((void*) NULL, arenas[i]);
+	}
+	// The pool keeps at most JALDB_ARENA_POOL_SIZE of them.
+	struct jaldb_arena *again = jaldb_arena_get();
+	assert_not_equals((void*) NULL, again);
+	jaldb_arena_put(&again);
+}
+
+static void *use_arenas(__attribute__((unused)) void *unused)
+{
+	struct jaldb_arena *a = jaldb_arena_get();
+	char *str = jaldb_arena_strdup(a, "thread");
+	int err = strcmp("thread", str);
+	jaldb_arena_put(&a);
+	a = jaldb_arena_get();
+	jaldb_arena_alloc(a, 10);
+	// One arena is left in this thread's pool, freed when it exits.
+	jaldb_arena_put(&a);
+	return err ? (void *) str : NULL;
+}
+
+void test_arena_pools_are_per_thread()
+{
+	pthread_t threads[4];
+	void *res;
+	int i;
+	for (i = 0; i < 4; i++) {
+		assert_equals(0, pthread_create(&threads[i], NULL, use_arenas, NULL));
+	}
+	for (i = 0; i < 4; i++) {
+		assert_equals(0, pthread_join(threads[i], &res));
+		assert_pointer_equals((void*) NULL, res);
+	}
+}
@@ -51,9 +51,12 @@ extern "C" {
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <inttypes.h>
+#include <pthread.h>
 #include <stdlib.h>
 #include "jal_alloc.h"
 #include "jaldb_context.hpp"
+#include "jaldb_record_dbs.h"
+#include "jaldb_serialize_record.h"
 #include "jaldb_strings.h"
 #include "jaldb_segment.h"
 #include "jaldb_utils.h"
@@ -268,6 +271,40 @@ extern "C" void test_mark_record_sent_and_synced()
 	free(nonce);
 }
 
+extern "C" void test_marking_record_sent_and_synced_does_not_rewrite_record()
+{
+	struct jaldb_record_dbs *rdbs = NULL;
+	uint32_t state = 0;
+	char *nonce = NULL;
+	DBT key;
+	DBT before;
+	DBT after;
+	memset(&key, 0, sizeof(key));
+	memset(&before, 0, sizeof(before));
+	memset(&after, 0, sizeof(after));
+	before.flags = DB_DBT_MALLOC;
+	after.flags = DB_DBT_MALLOC;
+
+	assert_equals(JALDB_OK, jaldb_insert_record(context, records[0], 1, &nonce));
+	assert_equals(JALDB_OK, jaldb_get_primary_record_dbs(context, JALDB_RTYPE_LOG, &rdbs));
+	key.data = nonce;
+	key.size = strlen(nonce) + 1;
+	assert_equals(0, rdbs->primary_db->get(rdbs->primary_db, NULL, &key, &before, 0));
+
+	assert_equals(JALDB_OK, jaldb_mark_sent(context, JALDB_RTYPE_LOG, nonce, 1));
+	assert_equals(JALDB_OK, jaldb_mark_synced(context, JALDB_RTYPE_LOG, nonce));
+
+	assert_equals(0, rdbs->primary_db->get(rdbs->primary_db, NULL, &key, &after, 0));
+	assert_equals(before.size, after.size);
+	assert_equals(0, memcmp(before.data, after.data, before.size));
+	assert_equals(0, jaldb_record_dbs_get_state(rdbs, NULL, &key, &state, 0));
+	assert_equals(JALDB_RFLAGS_SENT | JALDB_RFLAGS_SYNCED | JALDB_RFLAGS_CONFIRMED, state);
+
+	free(before.data);
+	free(after.data);
+	free(nonce);
+}
+
 extern "C" void test_marking_record_synced_doesnt_affect_sent_ordering()
 {
 	struct jaldb_record *rec1 = NULL;
@@ -533,6 +570,117 @@ extern "C" void test_next_unsynced_skips_unconfirmed_records()
 
 }
 
+extern "C" void test_next_unsynced_records_works()
+{
+	struct jaldb_record_batch batch;
+	const char *source = NULL;
+	const char *nonce = NULL;
+	char *nonces[4];
+	char *inserted = NULL;
+	jaldb_record_batch_init(&batch);
+
+	assert_equals(JALDB_OK, jaldb_insert_record(context, records[0], 1, &inserted));
+	free(inserted);
+	inserted = NULL;
+	assert_equals(JALDB_OK, jaldb_insert_record(context, records[1], 0, &inserted));
+	free(inserted);
+	inserted = NULL;
+	assert_equals(JALDB_OK, jaldb_insert_record(context, records[2], 1, &inserted));
+	free(inserted);
+	inserted = NULL;
+	assert_equals(JALDB_OK, jaldb_insert_record(context, records[3], 1, &inserted));
+	free(inserted);
+	inserted = NULL;
+
+	// Unconfirmed records are skipped
+	assert_equals(JALDB_OK, jaldb_next_unsynced_records(context, JALDB_RTYPE_LOG, 2, 1024 * 1024, &batch));
+	assert_equals(2, batch.count);
+	assert_equals(JALDB_OK, jaldb_record_view_get_string(&batch.views[0], JALDB_VIEW_SOURCE, &source));
+	assert_string_equals(S1, source);
+	assert_equals(JALDB_OK, jaldb_record_view_get_string(&batch.views[1], JALDB_VIEW_SOURCE, &source));
+	assert_string_equals(S3, source);
+
+	// Nothing is marked until the caller does so
+	for (size_t i = 0; i < batch.count; i++) {
+		assert_equals(JALDB_OK, jaldb_record_view_get_string(&batch.views[i], JALDB_VIEW_NETWORK_NONCE, &nonce));
+		nonces[i] = jal_strdup(nonce);
+	}
+	jaldb_record_batch_release(&batch);
+	assert_equals(JALDB_OK, jaldb_next_unsynced_records(context, JALDB_RTYPE_LOG, 2, 1024 * 1024, &batch));
+	assert_equals(2, batch.count);
+	jaldb_record_batch_release(&batch);
+
+	assert_equals(JALDB_OK, jaldb_mark_sent_batch(context, JALDB_RTYPE_LOG, nonces, 2, 1));
+	assert_equals(JALDB_OK, jaldb_next_unsynced_records(context, JALDB_RTYPE_LOG, 2, 1024 * 1024, &batch));
+	assert_equals(1, batch.count);
+	assert_equals(JALDB_OK, jaldb_record_view_get_string(&batch.views[0], JALDB_VIEW_SOURCE, &source));
+	assert_string_equals(S4, source);
+	assert_equals(JALDB_OK, jaldb_record_view_get_string(&batch.views[0], JALDB_VIEW_NETWORK_NONCE, &nonce));
+	nonces[2] = jal_strdup(nonce);
+	jaldb_record_batch_release(&batch);
+
+	assert_equals(JALDB_OK, jaldb_mark_sent_batch(context, JALDB_RTYPE_LOG, nonces + 2, 1, 1));
+	assert_equals(JALDB_E_NOT_FOUND, jaldb_next_unsynced_records(context, JALDB_RTYPE_LOG, 2, 1024 * 1024, &batch));
+	assert_equals(0, batch.count);
+
+	for (int i = 0; i < 3; i++) {
+		free(nonces[i]);
+	}
+	jaldb_record_batch_free(&batch);
+}
+
+extern "C" void test_next_unsynced_records_stops_at_max_bytes()
+{
+	struct jaldb_record_batch batch;
+	char *nonce = NULL;
+	jaldb_record_batch_init(&batch);
+
+	assert_equals(JALDB_OK, jaldb_insert_record(context, records[0], 1, &nonce));
+	free(nonce);
+	nonce = NULL;
+	assert_equals(JALDB_OK, jaldb_insert_record(context, records[1], 1, &nonce));
+	free(nonce);
+	nonce = NULL;
+
+	// At least one record is returned
+	assert_equals(JALDB_OK, jaldb_next_unsynced_records(context, JALDB_RTYPE_LOG, 10, 1, &batch));
+	assert_equals(1, batch.count);
+	jaldb_record_batch_release(&batch);
+
+	assert_equals(JALDB_E_INVAL, jaldb_next_unsynced_records(context, JALDB_RTYPE_LOG, 0, 1, &batch));
+	jaldb_record_batch_free(&batch);
+}
+
+extern "C" void test_mark_sent_batch_works()
+{
+	struct jaldb_record *rec = NULL;
+	char *nonces[3] = { NULL, NULL, (char *) "not_a_nonce" };
+	assert_equals(JALDB_OK, jaldb_insert_record(context, records[0], 1, &nonces[0]));
+	assert_equals(JALDB_OK, jaldb_insert_record(context, records[1], 1, &nonces[1]));
+
+	// Missing records are skipped
+	assert_equals(JALDB_OK, jaldb_mark_sent_batch(context, JALDB_RTYPE_LOG, nonces, 3, 1));
+	for (int i = 0; i < 2; i++) {
+		assert_equals(JALDB_OK, jaldb_get_record(context, JALDB_RTYPE_LOG, nonces[i], &rec));
+		assert_equals(1, rec->synced);
+		jaldb_destroy_record(&rec);
+	}
+
+	assert_equals(JALDB_OK, jaldb_mark_sent_batch(context, JALDB_RTYPE_LOG, nonces, 1, 0));
+	assert_equals(JALDB_OK, jaldb_get_record(context, JALDB_RTYPE_LOG, nonces[0], &rec));
+	assert_equals(0, rec->synced);
+	jaldb_destroy_record(&rec);
+	assert_equals(JALDB_OK, jaldb_get_record(context, JALDB_RTYPE_LOG, nonces[1], &rec));
+	assert_equals(1, rec->synced);
+	jaldb_destroy_record(&rec);
+
+	assert_equals(JALDB_E_INVAL, jaldb_mark_sent_batch(context, JALDB_RTYPE_LOG, nonces, 2, 2));
+	assert_equals(JALDB_OK, jaldb_mark_sent_batch(context, JALDB_RTYPE_LOG, NULL, 0, 1));
+
+	free(nonces[0]);
+	free(nonces[1]);
+}
+
 
 extern "C" void test_next_chronological_works()
 {
@@ -540,6 +688,8 @@ extern "C" void test_next_chronological_works()
 	char *nonce = NULL;
 	char *start_time = NULL;
 	char *end_time = NULL;
+	char *last_nonce = NULL;
+	char *end_last_nonce = NULL;
 
 	start_time = jaldb_gen_timestamp();
 	assert_not_equals(NULL, start_time);
@@ -565,7 +715,7 @@ extern "C" void test_next_chronological_works()
 	end_time = jaldb_gen_timestamp();
 	assert_not_equals(NULL,end_time);
 
-	assert_equals(JALDB_OK, jaldb_next_chronological_record(context, JALDB_RTYPE_LOG, &nonce, &rec, &start_time));
+	assert_equals(JALDB_OK, jaldb_next_chronological_record(context, JALDB_RTYPE_LOG, &nonce, &rec, &start_time, &last_nonce));
 	assert_string_equals(S1, rec->source);
 	jaldb_destroy_record(&rec);
 
@@ -573,7 +723,7 @@ extern "C" void test_next_chronological_works()
 	nonce = NULL;
 	rec = NULL;
 
-	assert_equals(JALDB_OK, jaldb_next_chronological_record(context, JALDB_RTYPE_LOG, &nonce, &rec, &start_time));
+	assert_equals(JALDB_OK, jaldb_next_chronological_record(context, JALDB_RTYPE_LOG, &nonce, &rec, &start_time, &last_nonce));
 	assert_string_equals(S2, rec->source);
 	jaldb_destroy_record(&rec);
 
@@ -581,9 +731,9 @@ extern "C" void test_next_chronological_works()
 	nonce = NULL;
 	rec = NULL;
 
-	assert_equals(JALDB_E_NOT_FOUND, jaldb_next_chronological_record(context, JALDB_RTYPE_LOG, &nonce, &rec, &end_time));
+	assert_equals(JALDB_E_NOT_FOUND, jaldb_next_chronological_record(context, JALDB_RTYPE_LOG, &nonce, &rec, &end_time, &end_last_nonce));
 
-	assert_equals(JALDB_OK, jaldb_next_chronological_record(context, JALDB_RTYPE_LOG, &nonce, &rec, &start_time));
+	assert_equals(JALDB_OK, jaldb_next_chronological_record(context, JALDB_RTYPE_LOG, &nonce, &rec, &start_time, &last_nonce));
 	assert_string_equals(S3, rec->source);
 	jaldb_destroy_record(&rec);
 
@@ -591,7 +741,7 @@ extern "C" void test_next_chronological_works()
 	nonce = NULL;
 	rec = NULL;
 
-	assert_equals(JALDB_OK, jaldb_next_chronological_record(context, JALDB_RTYPE_LOG, &nonce, &rec, &start_time));
+	assert_equals(JALDB_OK, jaldb_next_chronological_record(context, JALDB_RTYPE_LOG, &nonce, &rec, &start_time, &last_nonce));
 	assert_string_equals(S4, rec->source);
 	jaldb_destroy_record(&rec);
 
@@ -599,11 +749,108 @@ extern "C" void test_next_chronological_works()
 	nonce = NULL;
 	rec = NULL;
 
-	assert_equals(JALDB_E_NOT_FOUND, jaldb_next_chronological_record(context, JALDB_RTYPE_LOG, &nonce, &rec, &start_time));
+	assert_equals(JALDB_E_NOT_FOUND, jaldb_next_chronological_record(context, JALDB_RTYPE_LOG, &nonce, &rec, &start_time, &last_nonce));
 
 	free(start_time);
 	free(end_time);
+	free(last_nonce);
+	free(end_last_nonce);
+}
+
+extern "C" void test_next_chronological_keeps_each_caller_apart()
+{
+	struct jaldb_record *rec = NULL;
+	char *nonce = NULL;
+	char *time_a = NULL;
+	char *time_b = NULL;
+	char *last_a = NULL;
+	char *last_b = NULL;
+
+	time_a = jaldb_gen_timestamp();
+	assert_not_equals(NULL, time_a);
+	time_b = jal_strdup(time_a);
+
+	assert_equals(JALDB_OK, jaldb_insert_record(context, records[0], 1, &nonce));
+	free(nonce);
+	nonce = NULL;
+	assert_equals(JALDB_OK, jaldb_insert_record(context, records[1], 1, &nonce));
+	free(nonce);
+	nonce = NULL;
+
+	// A record returned to one caller is still there for the other
+	assert_equals(JALDB_OK, jaldb_next_chronological_record(context, JALDB_RTYPE_LOG, &nonce, &rec, &time_a, &last_a));
+	assert_string_equals(S1, rec->source);
+	jaldb_destroy_record(&rec);
+	free(nonce);
+	nonce = NULL;
 
+	assert_equals(JALDB_OK, jaldb_next_chronological_record(context, JALDB_RTYPE_LOG, &nonce, &rec, &time_b, &last_b));
+	assert_string_equals(S1, rec->source);
+	jaldb_destroy_record(&rec);
+	free(nonce);
+	nonce = NULL;
+
+	assert_equals(JALDB_OK, jaldb_next_chronological_record(context, JALDB_RTYPE_LOG, &nonce, &rec, &time_a, &last_a));
+	assert_string_equals(S2, rec->source);
+	jaldb_destroy_record(&rec);
+	free(nonce);
+	nonce = NULL;
+
+	assert_equals(JALDB_E_NOT_FOUND, jaldb_next_chronological_record(context, JALDB_RTYPE_LOG, &nonce, &rec, &time_a, &last_a));
+
+	assert_equals(JALDB_OK, jaldb_next_chronological_record(context, JALDB_RTYPE_LOG, &nonce, &rec, &time_b, &last_b));
+	assert_string_equals(S2, rec->source);
+	jaldb_destroy_record(&rec);
+	free(nonce);
+	nonce = NULL;
+
+	assert_equals(JALDB_E_NOT_FOUND, jaldb_next_chronological_record(context, JALDB_RTYPE_LOG, &nonce, &rec, &time_b, &last_b));
+
+	free(time_a);
+	free(time_b);
+	free(last_a);
+	free(last_b);
+}
+
+extern "C" void test_next_chronological_nonce_moves_without_reading()
+{
+	struct jaldb_record_view view;
+	char *nonce = NULL;
+	char *first = NULL;
+	char *timestamp = NULL;
+	char *last_nonce = NULL;
+	const char *source = NULL;
+	jaldb_record_view_init(&view);
+
+	timestamp = jaldb_gen_timestamp();
+	assert_not_equals(NULL, timestamp);
+
+	assert_equals(JALDB_OK, jaldb_insert_record(context, records[0], 1, &first));
+	assert_equals(JALDB_OK, jaldb_insert_record(context, records[1], 1, &nonce));
+	free(nonce);
+	nonce = NULL;
+
+	assert_equals(JALDB_OK, jaldb_next_chronological_nonce(context, JALDB_RTYPE_LOG, &timestamp, &last_nonce));
+	assert_string_equals(first, last_nonce);
+
+	assert_equals(JALDB_OK, jaldb_get_record_view(context, JALDB_RTYPE_LOG, last_nonce, &view));
+	assert_equals(JALDB_OK, jaldb_record_view_get_string(&view, JALDB_VIEW_SOURCE, &source));
+	assert_string_equals(S1, source);
+	jaldb_record_view_release(&view);
+
+	assert_equals(JALDB_OK, jaldb_next_chronological_nonce(context, JALDB_RTYPE_LOG, &timestamp, &last_nonce));
+	assert_equals(JALDB_OK, jaldb_get_record_view(context, JALDB_RTYPE_LOG, last_nonce, &view));
+	assert_equals(JALDB_OK, jaldb_record_view_get_string(&view, JALDB_VIEW_SOURCE, &source));
+	assert_string_equals(S2, source);
+	jaldb_record_view_release(&view);
+
+	assert_equals(JALDB_E_NOT_FOUND, jaldb_next_chronological_nonce(context, JALDB_RTYPE_LOG, &timestamp, &last_nonce));
+	assert_equals(JALDB_E_NOT_FOUND, jaldb_get_record_view(context, JALDB_RTYPE_LOG, "not_a_nonce", &view));
+
+	jaldb_record_view_free(&view);
+	free(first);
+	free(timestamp);
+	free(last_nonce);
 }
 
 extern "C" void test_jaldb_get_last_k_records_works()
@@ -1812,3 +2059,106 @@ extern "C" void test_jaldb_next_journal_record_returns_corrupted_when_no_journal
 }
 #endif
 
+
+extern "C" void test_insert_records_inserts_all_records()
+{
+	char *nonces[ITEMS_IN_DB] = { NULL, NULL, NULL, NULL };
+	enum jaldb_status status[ITEMS_IN_DB];
+	struct jaldb_group_commit_stats stats;
+
+	assert_equals(JALDB_OK, jaldb_insert_records(context, records, ITEMS_IN_DB, 1, nonces, status));
+	for (int i = 0; i < ITEMS_IN_DB; i++) {
+		struct jaldb_record *rec = NULL;
+		assert_equals(JALDB_OK, status[i]);
+		assert_not_equals((void *) NULL, nonces[i]);
+		assert_equals(JALDB_OK, jaldb_get_record(context, JALDB_RTYPE_LOG, nonces[i], &rec));
+		assert_equals(0, strcmp(records[i]->hostname, rec->hostname));
+		jaldb_destroy_record(&rec);
+		free(nonces[i]);
+	}
+
+	assert_equals(JALDB_OK, jaldb_get_group_commit_stats(context, &stats));
+	assert_equals(1, stats.batches);
+	assert_equals(ITEMS_IN_DB, stats.records);
+	assert_equals(ITEMS_IN_DB, stats.last_batch_records);
+	assert_equals(ITEMS_IN_DB, stats.max_batch_records);
+}
+
+extern "C" void test_insert_records_skips_invalid_records()
+{
+	char *nonces[ITEMS_IN_DB] = { NULL, NULL, NULL, NULL };
+	enum jaldb_status status[ITEMS_IN_DB];
+	struct jaldb_record *rec = NULL;
+
+	free(records[1]->hostname);
+	records[1]->hostname = NULL;
+
+	assert_equals(JALDB_E_INVAL, jaldb_insert_records(context, records, ITEMS_IN_DB, 1, nonces, status));
+	assert_equals(JALDB_E_INVAL, status[1]);
+	assert_equals((void *) NULL, nonces[1]);
+	for (int i = 0; i < ITEMS_IN_DB; i++) {
+		if (1 == i) {
+			continue;
+		}
+		assert_equals(JALDB_OK, status[i]);
+		assert_equals(JALDB_OK, jaldb_get_record(context, JALDB_RTYPE_LOG, nonces[i], &rec));
+		jaldb_destroy_record(&rec);
+		free(nonces[i]);
+	}
+}
+
+extern "C" void test_insert_records_returns_error_with_bad_input()
+{
+	char *nonces[ITEMS_IN_DB] = { NULL, NULL, NULL, NULL };
+	char *nonce = jal_strdup(FAKE_NONCE);
+
+	assert_equals(JALDB_E_INVAL, jaldb_insert_records(NULL, records, ITEMS_IN_DB, 1, nonces, NULL));
+	assert_equals(JALDB_E_INVAL, jaldb_insert_records(context, NULL, ITEMS_IN_DB, 1, nonces, NULL));
+	assert_equals(JALDB_E_INVAL, jaldb_insert_records(context, records, 0, 1, nonces, NULL));
+	assert_equals(JALDB_E_INVAL, jaldb_insert_records(context, records, ITEMS_IN_DB, 1, NULL, NULL));
+	nonces[2] = nonce;
+	assert_equals(JALDB_E_INVAL, jaldb_insert_records(context, records, ITEMS_IN_DB, 1, nonces, NULL));
+	free(nonce);
+}
+
+struct group_insert_args {
+	struct jaldb_record *rec;
+	char *nonce;
+	enum jaldb_status ret;
+};
+
+static void *group_insert_thread(void *arg)
+{
+	struct group_insert_args *args = (struct group_insert_args *) arg;
+	args->ret = jaldb_insert_record(context, args->rec, 1, &args->nonce);
+	return NULL;
+}
+
+extern "C" void test_insert_record_with_group_commit()
+{
+	pthread_t threads[ITEMS_IN_DB];
+	struct group_insert_args args[ITEMS_IN_DB];
+	struct jaldb_group_commit_stats stats;
+
+	assert_equals(JALDB_OK, jaldb_enable_group_commit(context, ITEMS_IN_DB, 0, 100000));
+
+	for (int i = 0; i < ITEMS_IN_DB; i++) {
+		args[i].rec = records[i];
+		args[i].nonce = NULL;
+		args[i].ret = JALDB_E_UNKNOWN;
+		assert_equals(0, pthread_create(&threads[i], NULL, group_insert_thread, &args[i]));
+	}
+	for (int i = 0; i < ITEMS_IN_DB; i++) {
+		struct jaldb_record *rec = NULL;
+		assert_equals(0, pthread_join(threads[i], NULL));
+		assert_equals(JALDB_OK, args[i].ret);
+		assert_equals(JALDB_OK, jaldb_get_record(context, JALDB_RTYPE_LOG, args[i].nonce, &rec));
+		jaldb_destroy_record(&rec);
+		free(args[i].nonce);
+	}
+
+	assert_equals(JALDB_OK, jaldb_get_group_commit_stats(context, &stats));
+	assert_equals(ITEMS_IN_DB, stats.records);
+	assert_true(stats.batches <= ITEMS_IN_DB);
+	assert_true(stats.max_batch_records <= ITEMS_IN_DB);
+}
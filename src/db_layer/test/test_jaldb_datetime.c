@@ -260,3 +260,259 @@ void test_extract_datetime_key_works()
 	assert_equals(0, strcmp(result.data, DT8));
 	free(result.data);
 }
+
+/////////////////////////////////////////////////////
+// Unit tests for binary timestamp keys
+/////////////////////////////////////////////////////
+static void encode(const char *dt, uint8_t *key)
+{
+	assert_equals(JALDB_OK, jaldb_timestamp_key_encode(dt, strlen(dt), key));
+}
+
+void test_timestamp_key_orders_by_time()
+{
+	uint8_t k1[JALDB_TIMESTAMP_KEY_LEN];
+	uint8_t k2[JALDB_TIMESTAMP_KEY_LEN];
+	uint8_t k5[JALDB_TIMESTAMP_KEY_LEN];
+	uint8_t k6[JALDB_TIMESTAMP_KEY_LEN];
+	uint8_t k7[JALDB_TIMESTAMP_KEY_LEN];
+	uint8_t before_epoch[JALDB_TIMESTAMP_KEY_LEN];
+
+	encode(DT1, k1);
+	encode(DT2, k2);
+	encode(DT5, k5);
+	encode(DT6, k6);
+	encode(DT7, k7);
+	encode("1969-12-31T23:59:59.999999Z", before_epoch);
+
+	assert_true(memcmp(k1, k2, JALDB_TIMESTAMP_KEY_LEN) < 0);
+	assert_true(memcmp(k5, k6, JALDB_TIMESTAMP_KEY_LEN) < 0);
+	assert_true(memcmp(k6, k7, JALDB_TIMESTAMP_KEY_LEN) < 0);
+	// DT7 is 17:00:00.000001Z
+	assert_true(memcmp(k1, k7, JALDB_TIMESTAMP_KEY_LEN) < 0);
+	assert_true(memcmp(before_epoch, k1, JALDB_TIMESTAMP_KEY_LEN) < 0);
+}
+
+void test_timestamp_key_normalizes_timezones()
+{
+	uint8_t utc[JALDB_TIMESTAMP_KEY_LEN];
+	uint8_t est[JALDB_TIMESTAMP_KEY_LEN];
+	uint8_t no_tz[JALDB_TIMESTAMP_KEY_LEN];
+
+	encode("2012-12-12T09:00:00.000001Z", utc);
+	encode("2012-12-12T04:00:00.000001-05:00", est);
+	encode(DT8, no_tz);
+
+	assert_equals(0, memcmp(utc, est, JALDB_TIMESTAMP_KEY_TIME_LEN));
+	assert_not_equals(0, memcmp(utc, est, JALDB_TIMESTAMP_KEY_LEN));
+	// DateTimes without a timezone are UTC.
+	assert_equals(0, memcmp(utc, no_tz, JALDB_TIMESTAMP_KEY_TIME_LEN));
+	assert_equals(0, no_tz[8]);
+	assert_equals(0, no_tz[9]);
+}
+
+void test_timestamp_key_encode_fails_on_bad_input()
+{
+	uint8_t key[JALDB_TIMESTAMP_KEY_LEN];
+
+	assert_equals(JALDB_E_INVAL, jaldb_timestamp_key_encode(NULL, 0, key));
+	assert_equals(JALDB_E_INVAL, jaldb_timestamp_key_encode(DT1, strlen(DT1), NULL));
+	assert_equals(JALDB_E_INVAL_TIMESTAMP,
+			jaldb_timestamp_key_encode(BAD_DATETIME, strlen(BAD_DATETIME), key));
+	assert_equals(JALDB_E_INVAL_TIMESTAMP,
+			jaldb_timestamp_key_encode("2012-12-12T09:00:0", 18, key));
+	assert_equals(JALDB_E_INVAL_TIMESTAMP,
+			jaldb_timestamp_key_encode("2013-02-29T09:00:00", 19, key));
+	assert_equals(JALDB_E_INVAL_TIMESTAMP,
+			jaldb_timestamp_key_encode("2012-12-12T09:00:00.", 20, key));
+	assert_equals(JALDB_E_INVAL_TIMESTAMP,
+			jaldb_timestamp_key_encode("2012-12-12T09:00:00+14:01", 25, key));
+	assert_equals(JALDB_E_INVAL_TIMESTAMP,
+			jaldb_timestamp_key_encode("2012-12-12T09:00:00Zjunk", 24, key));
+	assert_equals(JALDB_E_INVAL_TIMESTAMP,
+			jaldb_timestamp_key_encode("2300-01-01T00:00:00", 19, key));
+}
+
+void test_timestamp_key_decode_round_trips()
+{
+	const char *datetimes[] = {
+		DT1, DT3, DT4, DT8,
+		"2012-02-29T23:59:59.123456789-08:00",
+		"1969-12-31T23:59:59.999999",
+	};
+	uint8_t key[JALDB_TIMESTAMP_KEY_LEN];
+	uint8_t key2[JALDB_TIMESTAMP_KEY_LEN];
+
+	for (size_t i = 0; i < sizeof(datetimes) / sizeof(datetimes[0]); i++) {
+		char *decoded = NULL;
+		encode(datetimes[i], key);
+		assert_equals(JALDB_OK, jaldb_timestamp_key_decode(key, sizeof(key), &decoded));
+		assert_string_equals(datetimes[i], decoded);
+		encode(decoded, key2);
+		assert_equals(0, memcmp(key, key2, JALDB_TIMESTAMP_KEY_LEN));
+		free(decoded);
+	}
+}
+
+void test_timestamp_key_decode_adds_fractional_seconds()
+{
+	uint8_t key[JALDB_TIMESTAMP_KEY_LEN];
+	char *decoded = NULL;
+
+	encode("2012-12-12T09:00:00+00:00", key);
+	assert_equals(JALDB_OK, jaldb_timestamp_key_decode(key, sizeof(key), &decoded));
+	assert_string_equals("2012-12-12T09:00:00.000000Z", decoded);
+	free(decoded);
+}
+
+void test_timestamp_key_decode_fails_on_bad_input()
+{
+	uint8_t key[JALDB_TIMESTAMP_KEY_LEN];
+	char *decoded = NULL;
+
+	encode(DT1, key);
+	assert_equals(JALDB_E_INVAL, jaldb_timestamp_key_decode(NULL, sizeof(key), &decoded));
+	assert_equals(JALDB_E_INVAL, jaldb_timestamp_key_decode(key, sizeof(key) - 1, &decoded));
+	assert_equals(JALDB_E_INVAL, jaldb_timestamp_key_decode(key, sizeof(key), NULL));
+	decoded = (char*) 0xdeadbeef;
+	assert_equals(JALDB_E_INVAL, jaldb_timestamp_key_decode(key, sizeof(key), &decoded));
+}
+
+void test_timestamp_key_compare_works()
+{
+	uint8_t k1[JALDB_TIMESTAMP_KEY_LEN];
+	uint8_t k2[JALDB_TIMESTAMP_KEY_LEN];
+	DBT bin1;
+	DBT bin2;
+	memset(&bin1, 0, sizeof(bin1));
+	memset(&bin2, 0, sizeof(bin2));
+
+	encode(DT1, k1);
+	encode(DT2, k2);
+	bin1.data = k1;
+	bin1.size = sizeof(k1);
+	bin2.data = k2;
+	bin2.size = sizeof(k2);
+
+	assert_equals(-1, jaldb_timestamp_key_compare(NULL, &bin1, &bin2));
+	assert_equals( 1, jaldb_timestamp_key_compare(NULL, &bin2, &bin1));
+	assert_equals( 0, jaldb_timestamp_key_compare(NULL, &bin1, &bin1));
+}
+
+void test_extract_datetime_bin_key_works()
+{
+	DBT result;
+	uint8_t expected[JALDB_TIMESTAMP_KEY_LEN];
+	memset(&result, 0, sizeof(result));
+
+	strcpy(datetime_in_buffer, DT8);
+	encode(DT8, expected);
+	assert_equals(0, jaldb_extract_datetime_bin_key(NULL, NULL, &dbt_record, &result));
+	assert_equals(JALDB_TIMESTAMP_KEY_LEN, result.size);
+	assert_equals(DB_DBT_APPMALLOC, result.flags);
+	assert_equals(0, memcmp(expected, result.data, JALDB_TIMESTAMP_KEY_LEN));
+	free(result.data);
+}
+
+void test_extract_datetime_bin_key_fails_on_bad_datetime()
+{
+	DBT result;
+	memset(&result, 0, sizeof(result));
+
+	strcpy(datetime_in_buffer, BAD_DATETIME);
+	assert_equals(-1, jaldb_extract_datetime_bin_key(NULL, NULL, &dbt_record, &result));
+
+	strcpy(datetime_in_buffer, DT8);
+	headers->version = JALDB_DB_LAYOUT_VERSION + 1;
+	assert_equals(-1, jaldb_extract_datetime_bin_key(NULL, NULL, &dbt_record, &result));
+}
+
+void test_extract_nonce_timestamp_bin_key_works()
+{
+	const char *nonce = "00000000-0000-0000-0000-000000000001_" DT8 "_123_456";
+	DBT key;
+	DBT result;
+	uint8_t expected[JALDB_TIMESTAMP_KEY_LEN];
+	memset(&key, 0, sizeof(key));
+	memset(&result, 0, sizeof(result));
+	key.data = (void*) nonce;
+	key.size = strlen(nonce) + 1;
+
+	encode(DT8, expected);
+	assert_equals(0, jaldb_extract_nonce_timestamp_bin_key(NULL, &key, NULL, &result));
+	assert_equals(JALDB_TIMESTAMP_KEY_LEN, result.size);
+	assert_equals(0, memcmp(expected, result.data, JALDB_TIMESTAMP_KEY_LEN));
+	free(result.data);
+}
+
+void test_extract_nonce_timestamp_bin_key_skips_bad_nonces()
+{
+	const char *nonces[] = { "1", "uuid_" DT8, "uuid_" BAD_DATETIME "_1_2" };
+	DBT key;
+	DBT result;
+	memset(&result, 0, sizeof(result));
+
+	for (size_t i = 0; i < sizeof(nonces) / sizeof(nonces[0]); i++) {
+		memset(&key, 0, sizeof(key));
+		key.data = (void*) nonces[i];
+		key.size = strlen(nonces[i]) + 1;
+		assert_equals(DB_DONOTINDEX,
+				jaldb_extract_nonce_timestamp_bin_key(NULL, &key, NULL, &result));
+	}
+}
+
+void test_timestamp_key_from_ns_matches_encode()
+{
+	uint8_t from_ns[JALDB_TIMESTAMP_KEY_LEN];
+	uint8_t expected[JALDB_TIMESTAMP_KEY_LEN];
+
+	// 2012-12-12T09:00:00.000001
+	jaldb_timestamp_key_from_ns(1355302800000001000LL, from_ns);
+	encode(DT8, expected);
+	assert_equals(0, memcmp(expected, from_ns, JALDB_TIMESTAMP_KEY_LEN));
+}
+
+void test_extract_time_ordered_nonce_key_works()
+{
+	uint8_t expected[JALDB_TIMESTAMP_KEY_LEN];
+	char nonce[JALDB_TIME_ORDERED_KEY_PREFIX_LEN + 64];
+	DBT key;
+	DBT result;
+	memset(&key, 0, sizeof(key));
+	memset(&result, 0, sizeof(result));
+
+	encode(DT8, expected);
+	for (int i = 0; i < JALDB_TIMESTAMP_KEY_TIME_LEN; i++) {
+		sprintf(nonce + 2 * i, "%02x", expected[i]);
+	}
+	strcat(nonce, "_00000000-0000-0000-0000-000000000001");
+	key.data = nonce;
+	key.size = strlen(nonce) + 1;
+
+	assert_equals(0, jaldb_extract_time_ordered_nonce_key(NULL, &key, NULL, &result));
+	assert_equals(JALDB_TIMESTAMP_KEY_LEN, result.size);
+	assert_equals(DB_DBT_APPMALLOC, result.flags);
+	assert_equals(0, memcmp(expected, result.data, JALDB_TIMESTAMP_KEY_LEN));
+	free(result.data);
+}
+
+void test_extract_time_ordered_nonce_key_skips_other_keys()
+{
+	const char *nonces[] = {
+		"00000000-0000-0000-0000-000000000001_" DT8 "_123_456",
+		"94d9e1b0d2c2a1e8",
+		"94D9E1B0D2C2A1E8_00000000-0000-0000-0000-000000000001",
+		"94d9e1b0d2c2a1e_800000000-0000-0000-0000-000000000001",
+	};
+	DBT key;
+	DBT result;
+	memset(&result, 0, sizeof(result));
+
+	for (size_t i = 0; i < sizeof(nonces) / sizeof(nonces[0]); i++) {
+		memset(&key, 0, sizeof(key));
+		key.data = (void*) nonces[i];
+		key.size = strlen(nonces[i]) + 1;
+		assert_equals(DB_DONOTINDEX,
+				jaldb_extract_time_ordered_nonce_key(NULL, &key, NULL, &result));
+	}
+}
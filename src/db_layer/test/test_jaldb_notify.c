@@ -0,0 +1,151 @@
+/**
+ * @file test_jaldb_notify.c This file contains tests for jaldb_notify.c
+ * functions.
+ *
+ * @section LICENSE
+ *
+ * Source code in 3rd-party is licensed and owned by their respective
+ * copyright holders.
+ *
+ * All other source code is copyright Tresys Technology and licensed as below.
+ *
+ * Copyright (c) 2011-2012 Tresys Technology LLC, Columbia, Maryland, USA
+ *
+ * This software was developed by Tresys Technology LLC
+ * with U.S. Government sponsorship.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <test-dept.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "jaldb_notify.h"
+#include "jaldb_strings.h"
+
+#define DB_ROOT "./testdb_notify"
+
+static struct jaldb_notify *notify;
+
+void setup()
+{
+	mkdir(DB_ROOT, S_IRWXU | S_IRWXG | S_IROTH | S_IXOTH);
+	notify = jaldb_notify_open(DB_ROOT, 0);
+}
+
+void teardown()
+{
+	jaldb_notify_close(&notify);
+	unlink(DB_ROOT "/" JALDB_NOTIFY_FILE_NAME);
+	rmdir(DB_ROOT);
+}
+
+void test_open_creates_the_file()
+{
+	struct stat st;
+	assert_not_equals((void *) NULL, notify);
+	assert_equals(0, stat(DB_ROOT "/" JALDB_NOTIFY_FILE_NAME, &st));
+
+	uint32_t seq = 1;
+	assert_equals(JALDB_OK, jaldb_notify_seq(notify, JALDB_RTYPE_LOG, &seq));
+	assert_equals(0, seq);
+}
+
+void test_open_read_only_does_not_create_the_file()
+{
+	jaldb_notify_close(&notify);
+	unlink(DB_ROOT "/" JALDB_NOTIFY_FILE_NAME);
+	assert_equals((void *) NULL, jaldb_notify_open(DB_ROOT, 1));
+}
+
+void test_open_fails_with_bad_input()
+{
+	assert_equals((void *) NULL, jaldb_notify_open(NULL, 0));
+	assert_equals((void *) NULL, jaldb_notify_open("./does_not_exist", 0));
+}
+
+void test_close_does_not_crash_on_null()
+{
+	struct jaldb_notify *null_notify = NULL;
+	jaldb_notify_close(NULL);
+	jaldb_notify_close(&null_notify);
+}
+
+void test_post_only_bumps_its_own_type()
+{
+	uint32_t seq;
+	jaldb_notify_post(notify, JALDB_RTYPE_AUDIT);
+	jaldb_notify_post(notify, JALDB_RTYPE_AUDIT);
+
+	assert_equals(JALDB_OK, jaldb_notify_seq(notify, JALDB_RTYPE_AUDIT, &seq));
+	assert_equals(2, seq);
+	assert_equals(JALDB_OK, jaldb_notify_seq(notify, JALDB_RTYPE_JOURNAL, &seq));
+	assert_equals(0, seq);
+	assert_equals(JALDB_OK, jaldb_notify_seq(notify, JALDB_RTYPE_LOG, &seq));
+	assert_equals(0, seq);
+}
+
+void test_post_is_seen_through_another_mapping()
+{
+	struct jaldb_notify *reader = jaldb_notify_open(DB_ROOT, 1);
+	assert_not_equals((void *) NULL, reader);
+
+	uint32_t seq;
+	jaldb_notify_post(notify, JALDB_RTYPE_JOURNAL);
+	assert_equals(JALDB_OK, jaldb_notify_seq(reader, JALDB_RTYPE_JOURNAL, &seq));
+	assert_equals(1, seq);
+
+	// Readers can't post
+	jaldb_notify_post(reader, JALDB_RTYPE_JOURNAL);
+	assert_equals(JALDB_OK, jaldb_notify_seq(reader, JALDB_RTYPE_JOURNAL, &seq));
+	assert_equals(1, seq);
+
+	jaldb_notify_close(&reader);
+}
+
+void test_wait_returns_right_away_when_the_seq_changed()
+{
+	uint32_t seq = 0;
+	jaldb_notify_post(notify, JALDB_RTYPE_LOG);
+	assert_equals(JALDB_OK, jaldb_notify_wait(notify, JALDB_RTYPE_LOG, &seq, 10000));
+	assert_equals(1, seq);
+}
+
+void test_wait_times_out()
+{
+	uint32_t seq = 0;
+	jaldb_notify_post(notify, JALDB_RTYPE_AUDIT);
+	assert_equals(JALDB_E_NOT_FOUND, jaldb_notify_wait(notify, JALDB_RTYPE_LOG, &seq, 10));
+	assert_equals(0, seq);
+}
+
+void test_wait_sleeps_without_a_notify()
+{
+	uint32_t seq = 0;
+	assert_equals(JALDB_E_NOT_FOUND, jaldb_notify_wait(NULL, JALDB_RTYPE_LOG, &seq, 10));
+}
+
+void test_seq_and_wait_fail_with_bad_input()
+{
+	uint32_t seq = 0;
+	assert_equals(JALDB_E_INVAL, jaldb_notify_seq(notify, JALDB_RTYPE_LOG, NULL));
+	assert_equals(JALDB_E_INVAL, jaldb_notify_seq(notify, JALDB_RTYPE_UNKNOWN, &seq));
+	assert_equals(JALDB_E_INVAL, jaldb_notify_wait(notify, JALDB_RTYPE_LOG, NULL, 10));
+	assert_equals(JALDB_E_INVAL, jaldb_notify_wait(notify, JALDB_RTYPE_UNKNOWN, &seq, 10));
+	assert_equals(JALDB_E_INVAL, jaldb_notify_wait(notify, JALDB_RTYPE_LOG, &seq, -1));
+}
@@ -31,6 +31,7 @@
 
 #include "jal_alloc.h"
 
+#include "jaldb_arena.h"
 #include "jaldb_record.h"
 #include "jaldb_segment.h"
 
@@ -96,6 +97,97 @@ void test_jaldb_destroy_works()
 	assert_pointer_equals((void*) NULL, record);
 }
 
+void test_jaldb_create_arena_record_works()
+{
+	uuid_t test_uuid;
+	uuid_clear(test_uuid);
+
+	struct jaldb_record *record = jaldb_create_arena_record();
+
+	assert_not_equals(NULL, record);
+	assert_not_equals(NULL, record->arena);
+	assert_true(jaldb_arena_owns(record->arena, record));
+	assert_pointer_equals((void*)NULL, record->sys_meta);
+	assert_pointer_equals((void*)NULL, record->payload);
+	assert_pointer_equals((void*)NULL, record->source);
+	assert_equals(EXPECTED_RECORD_VERSION, record->version);
+	assert_equals(JALDB_RTYPE_UNKNOWN, record->type);
+	assert_equals(0, uuid_compare(test_uuid, record->uuid));
+
+	jaldb_destroy_record(&record);
+	assert_pointer_equals((void*) NULL, record);
+}
+
+void test_jaldb_record_alloc_uses_the_arena()
+{
+	struct jaldb_record *record = jaldb_create_arena_record();
+
+	record->source = jaldb_record_strdup(record, "source");
+	record->payload = jaldb_record_create_segment(record);
+	record->payload->payload = jaldb_record_alloc(record, 10);
+
+	assert_string_equals("source", record->source);
+	assert_true(jaldb_arena_owns(record->arena, record->source));
+	assert_true(jaldb_arena_owns(record->arena, record->payload));
+	assert_true(jaldb_arena_owns(record->arena, record->payload->payload));
+	assert_equals(-1, record->payload->fd);
+	assert_equals(0, record->payload->length);
+	assert_pointer_equals((void*) NULL, jaldb_record_strdup(record, NULL));
+
+	jaldb_destroy_record(&record);
+}
+
+void test_jaldb_record_alloc_without_an_arena()
+{
+	struct jaldb_record *record = jaldb_create_record();
+
+	record->source = jaldb_record_strdup(record, "source");
+	record->payload = jaldb_record_create_segment(record);
+	record->payload->payload = jaldb_record_alloc(record, 10);
+	assert_string_equals("source", record->source);
+	assert_equals(-1, record->payload->fd);
+
+	// All of these are freed individually
+	jaldb_destroy_record(&record);
+}
+
+void test_jaldb_destroy_arena_record_frees_malloced_members()
+{
+	struct jaldb_record *record = jaldb_create_arena_record();
+	record->sys_meta = jaldb_create_segment();
+	record->sys_meta->payload = (uint8_t *) jal_strdup("sys_meta");
+	record->app_meta = jaldb_record_create_segment(record);
+	record->app_meta->payload = (uint8_t *) jal_strdup("app_meta");
+	record->hostname = jal_strdup("hostname");
+	record->username = jaldb_record_strdup(record, "username");
+
+	jaldb_destroy_record(&record);
+	assert_pointer_equals((void*) NULL, record);
+}
+
+void test_jaldb_record_set_string_replaces_the_member()
+{
+	struct jaldb_record *record = jaldb_create_arena_record();
+	record->network_nonce = jal_strdup("malloced");
+
+	jaldb_record_set_string(record, &record->network_nonce, "first");
+	assert_string_equals("first", record->network_nonce);
+	assert_true(jaldb_arena_owns(record->arena, record->network_nonce));
+
+	jaldb_record_set_string(record, &record->network_nonce, "second");
+	assert_string_equals("second", record->network_nonce);
+
+	jaldb_record_set_string(record, &record->network_nonce, NULL);
+	assert_pointer_equals((void*) NULL, record->network_nonce);
+	jaldb_destroy_record(&record);
+
+	record = jaldb_create_record();
+	jaldb_record_set_string(record, &record->network_nonce, "first");
+	jaldb_record_set_string(record, &record->network_nonce, "second");
+	assert_string_equals("second", record->network_nonce);
+	jaldb_destroy_record(&record);
+}
+
 void test_jaldfb_record_sanity_check_works_for_journal()
 {
 	enum jaldb_status ret;
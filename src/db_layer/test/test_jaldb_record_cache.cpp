@@ -0,0 +1,300 @@
+/**
+ * @file test_jaldb_record_cache.cpp This file contains tests for
+ * jaldb_record_cache.cpp functions.
+ *
+ * @section LICENSE
+ *
+ * Source code in 3rd-party is licensed and owned by their respective
+ * copyright holders.
+ *
+ * All other source code is copyright Tresys Technology and licensed as below.
+ *
+ * Copyright (c) 2011-2012 Tresys Technology LLC, Columbia, Maryland, USA
+ *
+ * This software was developed by Tresys Technology LLC
+ * with U.S. Government sponsorship.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+// The test-dept code doesn't work very well in C++ when __STRICT_ANSI__ is
+// not defined. It tries to use some gcc extensions that don't work well with
+// C++.
+#ifndef __STRICT_ANSI__
+#define __STRICT_ANSI__
+#endif
+extern "C" {
+#include <test-dept.h>
+}
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "jaldb_record_cache.h"
+#include "jaldb_segment.h"
+#include "jaldb_serialize_record.h"
+
+#define NONCE_1 "1"
+#define NONCE_2 "2"
+#define NONCE_3 "3"
+#define PAYLOAD_1 "payload one"
+#define PAYLOAD_2 "payload two"
+#define PAYLOAD_3 "payload six"
+#define SYS_META "<sys_meta/>"
+#define TIMESTAMP "2012-12-06T14:22:60.1234Z"
+
+static struct jaldb_record_cache *cache;
+static size_t record_size;
+
+/* Read a record with \p payload into \p view, as the db layer does. */
+static void make_view(struct jaldb_record_view *view, const char *payload)
+{
+	struct jaldb_segment sys_meta;
+	struct jaldb_segment payload_sgmt;
+	struct jaldb_record rec;
+	uint8_t *buf = NULL;
+	size_t size = 0;
+
+	memset(&sys_meta, 0, sizeof(sys_meta));
+	sys_meta.payload = (uint8_t *) SYS_META;
+	sys_meta.length = strlen(SYS_META);
+	sys_meta.fd = -1;
+	memset(&payload_sgmt, 0, sizeof(payload_sgmt));
+	payload_sgmt.payload = (uint8_t *) payload;
+	payload_sgmt.length = strlen(payload);
+	payload_sgmt.fd = -1;
+	memset(&rec, 0, sizeof(rec));
+	rec.network_nonce = (char *) NONCE_1;
+	rec.timestamp = (char *) TIMESTAMP;
+	rec.sys_meta = &sys_meta;
+	rec.payload = &payload_sgmt;
+
+	assert_equals(JALDB_OK, jaldb_serialize_record(0, &rec, &buf, &size));
+	jaldb_record_view_init(view);
+	jaldb_record_view_reserve(view, size);
+	memcpy(view->buf, buf, size);
+	free(buf);
+	assert_equals(JALDB_OK, jaldb_record_view_set(view, 0, size, JALDB_RTYPE_LOG));
+	record_size = size;
+}
+
+static struct jaldb_record_cache_entry *put(enum jaldb_rec_type type, const char *nonce,
+		const char *payload)
+{
+	struct jaldb_record_view view;
+	struct jaldb_record_cache_entry *entry = NULL;
+	make_view(&view, payload);
+	assert_equals(JALDB_OK, jaldb_record_cache_put(cache, type, nonce, &view, &entry));
+	assert_not_equals((void *) NULL, entry);
+	jaldb_record_view_free(&view);
+	return entry;
+}
+
+static void assert_payload(struct jaldb_record_cache_entry *entry, const char *expected)
+{
+	const uint8_t *buf = NULL;
+	uint64_t len = 0;
+	int on_disk = 1;
+	assert_equals(JALDB_OK, jaldb_record_view_get_segment(jaldb_record_cache_entry_view(entry),
+			JALDB_VIEW_PAYLOAD, &buf, &len, &on_disk));
+	assert_equals(strlen(expected), len);
+	assert_equals(0, memcmp(expected, buf, len));
+	assert_equals(0, on_disk);
+}
+
+static void assert_cached(enum jaldb_rec_type type, const char *nonce, const char *expected)
+{
+	struct jaldb_record_cache_entry *entry = NULL;
+	assert_equals(JALDB_OK, jaldb_record_cache_get(cache, type, nonce, &entry));
+	assert_payload(entry, expected);
+	jaldb_record_cache_release(cache, &entry);
+	assert_equals((void *) NULL, entry);
+}
+
+static void assert_not_cached(enum jaldb_rec_type type, const char *nonce)
+{
+	struct jaldb_record_cache_entry *entry = NULL;
+	assert_equals(JALDB_E_NOT_FOUND, jaldb_record_cache_get(cache, type, nonce, &entry));
+	assert_equals((void *) NULL, entry);
+}
+
+extern "C" void setup()
+{
+	struct jaldb_record_view view;
+	make_view(&view, PAYLOAD_1);
+	jaldb_record_view_free(&view);
+	// Room for two records
+	cache = jaldb_record_cache_create(2 * record_size + record_size / 2);
+}
+
+extern "C" void teardown()
+{
+	jaldb_record_cache_destroy(&cache);
+}
+
+extern "C" void test_create_returns_null_without_bytes()
+{
+	assert_equals((void *) NULL, jaldb_record_cache_create(0));
+}
+
+extern "C" void test_destroy_does_not_crash_on_null()
+{
+	struct jaldb_record_cache *null_cache = NULL;
+	jaldb_record_cache_destroy(NULL);
+	jaldb_record_cache_destroy(&null_cache);
+	jaldb_record_cache_destroy(&cache);
+	assert_equals((void *) NULL, cache);
+}
+
+extern "C" void test_get_returns_what_was_put()
+{
+	struct jaldb_record_cache_stats stats;
+
+	assert_not_cached(JALDB_RTYPE_LOG, NONCE_1);
+	struct jaldb_record_cache_entry *entry = put(JALDB_RTYPE_LOG, NONCE_1, PAYLOAD_1);
+	assert_payload(entry, PAYLOAD_1);
+	jaldb_record_cache_release(cache, &entry);
+	assert_cached(JALDB_RTYPE_LOG, NONCE_1, PAYLOAD_1);
+
+	assert_equals(JALDB_OK, jaldb_record_cache_get_stats(cache, &stats));
+	assert_equals(1, stats.hits);
+	assert_equals(1, stats.misses);
+	assert_equals(0, stats.evictions);
+	assert_equals(1, stats.entries);
+	assert_equals(record_size, stats.bytes);
+}
+
+extern "C" void test_get_shares_one_copy()
+{
+	struct jaldb_record_cache_entry *first = put(JALDB_RTYPE_LOG, NONCE_1, PAYLOAD_1);
+	struct jaldb_record_cache_entry *second = NULL;
+	assert_equals(JALDB_OK, jaldb_record_cache_get(cache, JALDB_RTYPE_LOG, NONCE_1, &second));
+	assert_pointer_equals(first, second);
+	jaldb_record_cache_release(cache, &first);
+	jaldb_record_cache_release(cache, &second);
+}
+
+extern "C" void test_put_moves_the_record_out_of_the_view()
+{
+	struct jaldb_record_view view;
+	struct jaldb_record_cache_entry *entry = NULL;
+	make_view(&view, PAYLOAD_1);
+	uint8_t *buf = view.buf;
+
+	assert_equals(JALDB_OK, jaldb_record_cache_put(cache, JALDB_RTYPE_LOG, NONCE_1, &view, &entry));
+	assert_equals((void *) NULL, view.buf);
+	assert_equals(0, view.size);
+	assert_pointer_equals(buf, jaldb_record_cache_entry_view(entry)->buf);
+	jaldb_record_cache_release(cache, &entry);
+}
+
+extern "C" void test_put_returns_the_record_already_cached()
+{
+	struct jaldb_record_cache_entry *first = put(JALDB_RTYPE_LOG, NONCE_1, PAYLOAD_1);
+	struct jaldb_record_cache_entry *second = put(JALDB_RTYPE_LOG, NONCE_1, PAYLOAD_2);
+	assert_pointer_equals(first, second);
+	assert_payload(second, PAYLOAD_1);
+	jaldb_record_cache_release(cache, &first);
+	jaldb_record_cache_release(cache, &second);
+}
+
+extern "C" void test_nonces_are_per_record_type()
+{
+	struct jaldb_record_cache_entry *log = put(JALDB_RTYPE_LOG, NONCE_1, PAYLOAD_1);
+	struct jaldb_record_cache_entry *audit = put(JALDB_RTYPE_AUDIT, NONCE_1, PAYLOAD_2);
+	jaldb_record_cache_release(cache, &log);
+	jaldb_record_cache_release(cache, &audit);
+
+	assert_cached(JALDB_RTYPE_LOG, NONCE_1, PAYLOAD_1);
+	assert_cached(JALDB_RTYPE_AUDIT, NONCE_1, PAYLOAD_2);
+	assert_not_cached(JALDB_RTYPE_JOURNAL, NONCE_1);
+}
+
+extern "C" void test_put_evicts_least_recently_used()
+{
+	struct jaldb_record_cache_stats stats;
+	struct jaldb_record_cache_entry *entry = put(JALDB_RTYPE_LOG, NONCE_1, PAYLOAD_1);
+	jaldb_record_cache_release(cache, &entry);
+	entry = put(JALDB_RTYPE_LOG, NONCE_2, PAYLOAD_2);
+	jaldb_record_cache_release(cache, &entry);
+	// Use NONCE_1 so NONCE_2 is the oldest
+	assert_cached(JALDB_RTYPE_LOG, NONCE_1, PAYLOAD_1);
+	entry = put(JALDB_RTYPE_LOG, NONCE_3, PAYLOAD_3);
+	jaldb_record_cache_release(cache, &entry);
+
+	assert_cached(JALDB_RTYPE_LOG, NONCE_1, PAYLOAD_1);
+	assert_not_cached(JALDB_RTYPE_LOG, NONCE_2);
+	assert_cached(JALDB_RTYPE_LOG, NONCE_3, PAYLOAD_3);
+
+	assert_equals(JALDB_OK, jaldb_record_cache_get_stats(cache, &stats));
+	assert_equals(1, stats.evictions);
+	assert_equals(2, stats.entries);
+	assert_equals(2 * record_size, stats.bytes);
+}
+
+extern "C" void test_evicted_record_stays_valid_until_released()
+{
+	struct jaldb_record_cache_stats stats;
+	struct jaldb_record_cache_entry *held = put(JALDB_RTYPE_LOG, NONCE_1, PAYLOAD_1);
+	struct jaldb_record_cache_entry *entry = put(JALDB_RTYPE_LOG, NONCE_2, PAYLOAD_2);
+	jaldb_record_cache_release(cache, &entry);
+	entry = put(JALDB_RTYPE_LOG, NONCE_3, PAYLOAD_3);
+	jaldb_record_cache_release(cache, &entry);
+
+	assert_not_cached(JALDB_RTYPE_LOG, NONCE_1);
+	assert_payload(held, PAYLOAD_1);
+	assert_equals(JALDB_OK, jaldb_record_cache_get_stats(cache, &stats));
+	assert_equals(2 * record_size, stats.bytes);
+	jaldb_record_cache_release(cache, &held);
+}
+
+extern "C" void test_put_does_not_cache_record_larger_than_limit()
+{
+	struct jaldb_record_cache_stats stats;
+	struct jaldb_record_cache_entry *entry = NULL;
+	jaldb_record_cache_destroy(&cache);
+	cache = jaldb_record_cache_create(record_size - 1);
+
+	entry = put(JALDB_RTYPE_LOG, NONCE_1, PAYLOAD_1);
+	assert_payload(entry, PAYLOAD_1);
+	jaldb_record_cache_release(cache, &entry);
+	assert_not_cached(JALDB_RTYPE_LOG, NONCE_1);
+
+	assert_equals(JALDB_OK, jaldb_record_cache_get_stats(cache, &stats));
+	assert_equals(0, stats.evictions);
+	assert_equals(0, stats.entries);
+	assert_equals(0, stats.bytes);
+}
+
+extern "C" void test_put_fails_for_empty_view()
+{
+	struct jaldb_record_view view;
+	struct jaldb_record_cache_entry *entry = NULL;
+	jaldb_record_view_init(&view);
+	assert_equals(JALDB_E_INVAL, jaldb_record_cache_put(cache, JALDB_RTYPE_LOG, NONCE_1, &view, &entry));
+	assert_equals((void *) NULL, entry);
+}
+
+extern "C" void test_functions_fail_with_bad_input()
+{
+	struct jaldb_record_cache_stats stats;
+	struct jaldb_record_cache_entry *entry = NULL;
+	assert_equals(JALDB_E_INVAL, jaldb_record_cache_get(NULL, JALDB_RTYPE_LOG, NONCE_1, &entry));
+	assert_equals(JALDB_E_INVAL, jaldb_record_cache_get(cache, JALDB_RTYPE_LOG, NULL, &entry));
+	assert_equals(JALDB_E_INVAL, jaldb_record_cache_get(cache, JALDB_RTYPE_LOG, NONCE_1, NULL));
+	assert_equals(JALDB_E_INVAL, jaldb_record_cache_get_stats(NULL, &stats));
+	assert_equals(JALDB_E_INVAL, jaldb_record_cache_get_stats(cache, NULL));
+	jaldb_record_cache_release(cache, NULL);
+	jaldb_record_cache_release(cache, &entry);
+}
@@ -34,8 +34,10 @@
 #include <stdlib.h>
 #include <uuid/uuid.h>
 
+#include "jaldb_datetime.h"
 #include "jaldb_record_dbs.h"
 #include "jaldb_serialize_record.h"
+#include "jaldb_strings.h"
 
 #define DEF_MOCK_CLOSE(dbname) \
 char dbname ## _closed; \
@@ -337,7 +339,7 @@ void test_create_primary_dbs_w_indices_works()
 {
 	enum jaldb_status ret;
 	int db_err;
-	ret = jaldb_create_primary_dbs_with_indices(NULL, NULL, NULL, DB_CREATE, &rdbs);
+	ret = jaldb_create_primary_dbs_with_indices(NULL, NULL, NULL, DB_CREATE, JALDB_PRIMARY_KEY_UUID, &rdbs);
 	assert_equals(JALDB_OK, ret);
 
 	db_err = rdbs->primary_db->put(rdbs->primary_db, NULL, &rec1_key, &rec1_data, DB_NOOVERWRITE);
@@ -514,11 +516,11 @@ void test_create_primary_w_indices_dbs_returns_error_on_bad_input()
 {
 	enum jaldb_status ret;
 
-	ret = jaldb_create_primary_dbs_with_indices(NULL, NULL, NULL, DB_CREATE, NULL);
+	ret = jaldb_create_primary_dbs_with_indices(NULL, NULL, NULL, DB_CREATE, JALDB_PRIMARY_KEY_UUID, NULL);
 	assert_not_equals(JALDB_OK, ret);
 
 	rdbs = (struct jaldb_record_dbs*) 0xdeadbeef;
-	ret = jaldb_create_primary_dbs_with_indices(NULL, NULL, NULL, DB_CREATE, &rdbs);
+	ret = jaldb_create_primary_dbs_with_indices(NULL, NULL, NULL, DB_CREATE, JALDB_PRIMARY_KEY_UUID, &rdbs);
 	assert_not_equals(JALDB_OK, ret);
 	rdbs = NULL;
 }
@@ -530,27 +532,27 @@ void test_create_primary_w_indices_dbs_returns_error_when_db_create_fails()
 	// count fo db_create_fails...
 	replace_function(db_create, db_create_fails_by_count);
 	db_create_fail_at = 0;
-	ret = jaldb_create_primary_dbs_with_indices(NULL, NULL, NULL, DB_CREATE, &rdbs);
+	ret = jaldb_create_primary_dbs_with_indices(NULL, NULL, NULL, DB_CREATE, JALDB_PRIMARY_KEY_UUID, &rdbs);
 	assert_not_equals(JALDB_OK, ret);
 	assert_pointer_equals((void*) NULL, rdbs);
 
 	db_create_fail_at = 1;
-	ret = jaldb_create_primary_dbs_with_indices(NULL, NULL, NULL, DB_CREATE, &rdbs);
+	ret = jaldb_create_primary_dbs_with_indices(NULL, NULL, NULL, DB_CREATE, JALDB_PRIMARY_KEY_UUID, &rdbs);
 	assert_not_equals(JALDB_OK, ret);
 	assert_pointer_equals((void*) NULL, rdbs);
 
 	db_create_fail_at = 2;
-	ret = jaldb_create_primary_dbs_with_indices(NULL, NULL, NULL, DB_CREATE, &rdbs);
+	ret = jaldb_create_primary_dbs_with_indices(NULL, NULL, NULL, DB_CREATE, JALDB_PRIMARY_KEY_UUID, &rdbs);
 	assert_not_equals(JALDB_OK, ret);
 	assert_pointer_equals((void*) NULL, rdbs);
 
 	db_create_fail_at = 3;
-	ret = jaldb_create_primary_dbs_with_indices(NULL, NULL, NULL, DB_CREATE, &rdbs);
+	ret = jaldb_create_primary_dbs_with_indices(NULL, NULL, NULL, DB_CREATE, JALDB_PRIMARY_KEY_UUID, &rdbs);
 	assert_not_equals(JALDB_OK, ret);
 	assert_pointer_equals((void*) NULL, rdbs);
 
 	db_create_fail_at = 4;
-	ret = jaldb_create_primary_dbs_with_indices(NULL, NULL, NULL, DB_CREATE, &rdbs);
+	ret = jaldb_create_primary_dbs_with_indices(NULL, NULL, NULL, DB_CREATE, JALDB_PRIMARY_KEY_UUID, &rdbs);
 	assert_not_equals(JALDB_OK, ret);
 	assert_pointer_equals((void*) NULL, rdbs);
 
@@ -563,17 +565,18 @@ void test_create_primary_w_indices_dbs_returns_error_when_set_bt_compare_fails()
 	// count fo db_create_fails...
 	replace_function(db_create, db_create_fails_bt_compare_by_count);
 	bt_compare_fail_at = 0;
-	ret = jaldb_create_primary_dbs_with_indices(NULL, NULL, NULL, DB_CREATE, &rdbs);
+	ret = jaldb_create_primary_dbs_with_indices(NULL, NULL, NULL, DB_CREATE, JALDB_PRIMARY_KEY_UUID, &rdbs);
 	assert_not_equals(JALDB_OK, ret);
 	assert_pointer_equals((void*) NULL, rdbs);
 
-	bt_compare_fail_at = 1;
-	ret = jaldb_create_primary_dbs_with_indices(NULL, NULL, NULL, DB_CREATE, &rdbs);
+	// The metadata DB is created second and has no comparison function.
+	bt_compare_fail_at = 2;
+	ret = jaldb_create_primary_dbs_with_indices(NULL, NULL, NULL, DB_CREATE, JALDB_PRIMARY_KEY_UUID, &rdbs);
 	assert_not_equals(JALDB_OK, ret);
 	assert_pointer_equals((void*) NULL, rdbs);
 
-	bt_compare_fail_at = 2;
-	ret = jaldb_create_primary_dbs_with_indices(NULL, NULL, NULL, DB_CREATE, &rdbs);
+	bt_compare_fail_at = 3;
+	ret = jaldb_create_primary_dbs_with_indices(NULL, NULL, NULL, DB_CREATE, JALDB_PRIMARY_KEY_UUID, &rdbs);
 	assert_not_equals(JALDB_OK, ret);
 	assert_pointer_equals((void*) NULL, rdbs);
 
@@ -586,17 +589,17 @@ void test_create_primary_w_indices_dbs_returns_error_when_associate_fails()
 	// count fo db_create_fails...
 	replace_function(db_create, db_create_fails_associate_by_count);
 	associate_fail_at = 0;
-	ret = jaldb_create_primary_dbs_with_indices(NULL, NULL, NULL, DB_CREATE, &rdbs);
+	ret = jaldb_create_primary_dbs_with_indices(NULL, NULL, NULL, DB_CREATE, JALDB_PRIMARY_KEY_UUID, &rdbs);
 	assert_not_equals(JALDB_OK, ret);
 	assert_pointer_equals((void*) NULL, rdbs);
 
 	associate_fail_at = 1;
-	ret = jaldb_create_primary_dbs_with_indices(NULL, NULL, NULL, DB_CREATE, &rdbs);
+	ret = jaldb_create_primary_dbs_with_indices(NULL, NULL, NULL, DB_CREATE, JALDB_PRIMARY_KEY_UUID, &rdbs);
 	assert_not_equals(JALDB_OK, ret);
 	assert_pointer_equals((void*) NULL, rdbs);
 
 	associate_fail_at = 2;
-	ret = jaldb_create_primary_dbs_with_indices(NULL, NULL, NULL, DB_CREATE, &rdbs);
+	ret = jaldb_create_primary_dbs_with_indices(NULL, NULL, NULL, DB_CREATE, JALDB_PRIMARY_KEY_UUID, &rdbs);
 	assert_not_equals(JALDB_OK, ret);
 	assert_pointer_equals((void*) NULL, rdbs);
 
@@ -609,28 +612,100 @@ void test_create_primary_w_indices_dbs_returns_error_when_db_open_fails()
 	// count fo db_create_fails...
 	replace_function(db_create, db_create_fails_open_by_count);
 	open_fail_at = 0;
-	ret = jaldb_create_primary_dbs_with_indices(NULL, NULL, NULL, DB_CREATE, &rdbs);
+	ret = jaldb_create_primary_dbs_with_indices(NULL, NULL, NULL, DB_CREATE, JALDB_PRIMARY_KEY_UUID, &rdbs);
 	assert_not_equals(JALDB_OK, ret);
 	assert_pointer_equals((void*) NULL, rdbs);
 
 	open_fail_at = 1;
-	ret = jaldb_create_primary_dbs_with_indices(NULL, NULL, NULL, DB_CREATE, &rdbs);
+	ret = jaldb_create_primary_dbs_with_indices(NULL, NULL, NULL, DB_CREATE, JALDB_PRIMARY_KEY_UUID, &rdbs);
 	assert_not_equals(JALDB_OK, ret);
 	assert_pointer_equals((void*) NULL, rdbs);
 
 	open_fail_at = 2;
-	ret = jaldb_create_primary_dbs_with_indices(NULL, NULL, NULL, DB_CREATE, &rdbs);
+	ret = jaldb_create_primary_dbs_with_indices(NULL, NULL, NULL, DB_CREATE, JALDB_PRIMARY_KEY_UUID, &rdbs);
 	assert_not_equals(JALDB_OK, ret);
 	assert_pointer_equals((void*) NULL, rdbs);
 
 	open_fail_at = 3;
-	ret = jaldb_create_primary_dbs_with_indices(NULL, NULL, NULL, DB_CREATE, &rdbs);
+	ret = jaldb_create_primary_dbs_with_indices(NULL, NULL, NULL, DB_CREATE, JALDB_PRIMARY_KEY_UUID, &rdbs);
 	assert_not_equals(JALDB_OK, ret);
 	assert_pointer_equals((void*) NULL, rdbs);
 
 	open_fail_at = 4;
-	ret = jaldb_create_primary_dbs_with_indices(NULL, NULL, NULL, DB_CREATE, &rdbs);
+	ret = jaldb_create_primary_dbs_with_indices(NULL, NULL, NULL, DB_CREATE, JALDB_PRIMARY_KEY_UUID, &rdbs);
 	assert_not_equals(JALDB_OK, ret);
 	assert_pointer_equals((void*) NULL, rdbs);
 
 }
+
+void test_new_dbs_use_binary_timestamp_keys()
+{
+	enum jaldb_status ret;
+	uint8_t bin_key[JALDB_TIMESTAMP_KEY_LEN];
+	uint8_t expected[JALDB_TIMESTAMP_KEY_LEN];
+	ret = jaldb_create_primary_dbs_with_indices(NULL, NULL, NULL, DB_CREATE, JALDB_PRIMARY_KEY_UUID, &rdbs);
+	assert_equals(JALDB_OK, ret);
+	assert_true(rdbs->timestamp_keys_binary);
+	assert_pointer_equals((void*) NULL, rdbs->pending_timestamp_idx_db);
+
+	assert_equals(0, rdbs->primary_db->put(rdbs->primary_db, NULL, &rec4_key, &rec4_data, DB_NOOVERWRITE));
+
+	DBT key;
+	DBT pkey;
+	DBT val;
+	DBC *ts_c = NULL;
+	memset(&key, 0, sizeof(key));
+	memset(&pkey, 0, sizeof(pkey));
+	memset(&val, 0, sizeof(val));
+	assert_equals(0, rdbs->timestamp_idx_db->cursor(rdbs->timestamp_idx_db, NULL, &ts_c, 0));
+	assert_equals(0, ts_c->c_pget(ts_c, &key, &pkey, &val, DB_NEXT));
+	assert_equals(JALDB_TIMESTAMP_KEY_LEN, key.size);
+	assert_equals(JALDB_OK, jaldb_timestamp_key_encode(R4_DATETIME, strlen(R4_DATETIME), expected));
+	assert_equals(0, memcmp(expected, key.data, JALDB_TIMESTAMP_KEY_LEN));
+
+	assert_equals(JALDB_OK, jaldb_record_dbs_timestamp_key(rdbs, &key, bin_key));
+	assert_equals(0, memcmp(expected, bin_key, JALDB_TIMESTAMP_KEY_LEN));
+	ts_c->c_close(ts_c);
+}
+
+void test_record_dbs_timestamp_key_converts_legacy_keys()
+{
+	uint8_t bin_key[JALDB_TIMESTAMP_KEY_LEN];
+	uint8_t expected[JALDB_TIMESTAMP_KEY_LEN];
+	rdbs = jaldb_create_record_dbs();
+	rdbs->timestamp_keys_binary = 0;
+
+	assert_equals(JALDB_OK, jaldb_timestamp_key_encode(R4_DATETIME, strlen(R4_DATETIME), expected));
+	assert_equals(JALDB_OK, jaldb_record_dbs_timestamp_key(rdbs, &rec4_ts_key, bin_key));
+	assert_equals(0, memcmp(expected, bin_key, JALDB_TIMESTAMP_KEY_LEN));
+
+	assert_not_equals(JALDB_OK, jaldb_record_dbs_timestamp_key(rdbs, &rec5_ts_key, bin_key));
+	assert_not_equals(JALDB_OK, jaldb_record_dbs_timestamp_key(NULL, &rec4_ts_key, bin_key));
+}
+
+void test_create_primary_w_indices_dbs_records_time_ordered_keys()
+{
+	enum jaldb_status ret;
+	ret = jaldb_create_primary_dbs_with_indices(NULL, NULL, NULL, DB_CREATE,
+			JALDB_PRIMARY_KEY_TIME_ORDERED, &rdbs);
+	assert_equals(JALDB_OK, ret);
+	assert_equals(JALDB_PRIMARY_KEY_TIME_ORDERED, rdbs->primary_key_format);
+
+	DBT key;
+	DBT val;
+	memset(&key, 0, sizeof(key));
+	memset(&val, 0, sizeof(val));
+	key.data = JALDB_PRIMARY_KEY_FORMAT_NAME;
+	key.size = strlen(JALDB_PRIMARY_KEY_FORMAT_NAME) + 1;
+	assert_equals(0, rdbs->metadata_db->get(rdbs->metadata_db, NULL, &key, &val, 0));
+	assert_string_equals(JALDB_PRIMARY_KEY_FORMAT_TIME_ORDERED, (char*) val.data);
+}
+
+void test_create_primary_w_indices_dbs_defaults_to_uuid_keys()
+{
+	enum jaldb_status ret;
+	ret = jaldb_create_primary_dbs_with_indices(NULL, NULL, NULL, DB_CREATE,
+			JALDB_PRIMARY_KEY_UUID, &rdbs);
+	assert_equals(JALDB_OK, ret);
+	assert_equals(JALDB_PRIMARY_KEY_UUID, rdbs->primary_key_format);
+}
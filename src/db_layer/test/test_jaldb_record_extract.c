@@ -116,89 +116,72 @@ void test_extract_uuid_returns_error_for_input()
 	assert_not_equals(0, ret);
 }
 
-void test_extract_record_sent_flag_returns_error_for_bad_version()
+void test_extract_record_network_nonce_returns_zero_for_bad_version()
 {
 	DBT result;
 	memset(&result, 0, sizeof(result));
 	headers->version = 1234;
 
-	int ret = jaldb_extract_record_sent_flag(NULL, NULL, &record_dbt, &result);
+	int ret = jaldb_extract_record_network_nonce(NULL, NULL, &record_dbt, &result);
 	assert_not_equals(0, ret);
 	assert_not_equals(DB_DONOTINDEX, ret);
 }
 
-void test_extract_record_sent_flag_works()
-{
+void test_extract_record_network_nonce_works() {
 	DBT result;
 	memset(&result, 0, sizeof(result));
 
-	int ret = jaldb_extract_record_sent_flag(NULL, NULL, &record_dbt, &result);
+	strcpy(network_nonce_in_buffer, NN1);
+	int ret = jaldb_extract_record_network_nonce(NULL, NULL, &record_dbt, &result);
 	assert_equals(0, ret);
-	assert_equals(sizeof(uint32_t), result.size);
-	assert_equals(JALDB_RFLAGS_SENT,*((uint32_t*)result.data));
+	assert_not_equals((void*) NULL, result.data);
+	assert_equals(strlen(NN1) + 1, result.size);
+	assert_equals(0, strcmp(NN1, result.data));
 
 	free(result.data);
 }
 
-void test_extract_record_sent_flag_works_after_a_record_is_synced()
+void test_extract_record_state_works()
 {
+	uint32_t state = 0x12345678;
+	DBT key;
+	DBT data;
 	DBT result;
+	memset(&key, 0, sizeof(key));
+	memset(&data, 0, sizeof(data));
 	memset(&result, 0, sizeof(result));
+	key.data = NN1;
+	key.size = strlen(NN1) + 1;
+	data.data = &state;
+	data.size = sizeof(state);
 
-	headers->flags |= JALDB_RFLAGS_SYNCED;
-
-	int ret = jaldb_extract_record_sent_flag(NULL, NULL, &record_dbt, &result);
+	int ret = jaldb_extract_record_state(NULL, &key, &data, &result);
 	assert_equals(0, ret);
-	assert_equals(sizeof(uint32_t), result.size);
-	assert_equals(JALDB_RFLAGS_SENT|JALDB_RFLAGS_SYNCED,*((uint32_t*)result.data));
+	assert_equals(sizeof(state) + strlen(NN1) + 1, result.size);
+	assert_equals(DB_DBT_APPMALLOC, result.flags);
+	assert_equals(0, memcmp(result.data, &state, sizeof(state)));
+	assert_string_equals(NN1, (char*)result.data + sizeof(state));
 
 	free(result.data);
 }
 
-void test_extract_record_sent_flag_returns_error_for_input()
-{
-	DBT result;
-	memset(&result, 0, sizeof(result));
-	headers->version = 1234;
-	int ret;
-
-	record_dbt.data = NULL;
-	ret = jaldb_extract_record_sent_flag(NULL, NULL, &record_dbt, &result);
-	record_dbt.data = buffer;
-	assert_not_equals(0, ret);
-
-	record_dbt.size = sizeof(*headers) - 1;;
-	ret = jaldb_extract_record_sent_flag(NULL, NULL, &record_dbt, &result);
-	record_dbt.size = BUFFER_SIZE;
-	assert_not_equals(0, ret);
-
-	ret = jaldb_extract_record_sent_flag(NULL, NULL, NULL, &result);
-	assert_not_equals(0, ret);
-
-	ret = jaldb_extract_record_sent_flag(NULL, NULL, &record_dbt, NULL);
-	assert_not_equals(0, ret);
-}
-void test_extract_record_network_nonce_returns_zero_for_bad_version()
+void test_extract_record_state_returns_error_for_input()
 {
+	uint32_t state = 0;
+	DBT key;
+	DBT data;
 	DBT result;
+	memset(&key, 0, sizeof(key));
+	memset(&data, 0, sizeof(data));
 	memset(&result, 0, sizeof(result));
-	headers->version = 1234;
-
-	int ret = jaldb_extract_record_network_nonce(NULL, NULL, &record_dbt, &result);
-	assert_not_equals(0, ret);
-	assert_not_equals(DB_DONOTINDEX, ret);
-}
-
-void test_extract_record_network_nonce_works() {
-	DBT result;
-	memset(&result, 0, sizeof(result));
-
-	strcpy(network_nonce_in_buffer, NN1);
-	int ret = jaldb_extract_record_network_nonce(NULL, NULL, &record_dbt, &result);
-	assert_equals(0, ret);
-	assert_not_equals((void*) NULL, result.data);
-	assert_equals(strlen(NN1) + 1, result.size);
-	assert_equals(0, strcmp(NN1, result.data));
-
-	free(result.data);
+	key.data = NN1;
+	key.size = strlen(NN1) + 1;
+	data.data = &state;
+	data.size = sizeof(state) - 1;
+
+	assert_not_equals(0, jaldb_extract_record_state(NULL, &key, &data, &result));
+	data.size = sizeof(state);
+	assert_not_equals(0, jaldb_extract_record_state(NULL, NULL, &data, &result));
+	assert_not_equals(0, jaldb_extract_record_state(NULL, &key, NULL, &result));
+	assert_not_equals(0, jaldb_extract_record_state(NULL, &key, &data, NULL));
 }
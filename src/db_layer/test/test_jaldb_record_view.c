@@ -0,0 +1,363 @@
+/**
+ * @file test_jaldb_record_view.c This file contains functions to test the
+ * read only view of a serialized record.
+ *
+ * @section LICENSE
+ *
+ * Source code in 3rd-party is licensed and owned by their respective
+ * copyright holders.
+ *
+ * All other source code is copyright Tresys Technology and licensed as below.
+ *
+ * Copyright (c) 2012 Tresys Technology LLC, Columbia, Maryland, USA
+ *
+ * This software was developed by Tresys Technology LLC
+ * with U.S. Government sponsorship.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <test-dept.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "jaldb_record.h"
+#include "jaldb_record_view.h"
+#include "jaldb_segment.h"
+#include "jaldb_serialize_record.h"
+
+#define SYS_META "sys_meta_in_ram"
+#define APP_META_PATH "path/to/app/disk"
+#define APP_META_LENGTH 5678
+#define PAYLOAD "payload_in_ram"
+#define NONCE "1b4e28ba-2fa1-11d2-883f-b9a761bde3fb"
+#define SOURCE "the.source"
+#define TIMESTAMP "2012-12-06T14:22:60.1234Z"
+#define USERNAME "someuser"
+#define HOSTNAME "some.host"
+#define UUID_STR "abcdef12-0011-5566-7788-0123456789ab"
+
+static struct jaldb_segment sys_meta_sgmt;
+static struct jaldb_segment app_meta_sgmt;
+static struct jaldb_segment payload_sgmt;
+static struct jaldb_record rec;
+static struct jaldb_record_view view;
+static uuid_t uuid;
+
+/* Serialize rec into the buffer of the view. */
+static size_t serialize_into_view()
+{
+	uint8_t *buf = NULL;
+	size_t size = 0;
+	assert_equals(JALDB_OK, jaldb_serialize_record(0, &rec, &buf, &size));
+	jaldb_record_view_reserve(&view, size);
+	memcpy(view.buf, buf, size);
+	free(buf);
+	return size;
+}
+
+void setup()
+{
+	assert_equals(0, uuid_parse(UUID_STR, uuid));
+
+	memset(&sys_meta_sgmt, 0, sizeof(sys_meta_sgmt));
+	sys_meta_sgmt.payload = (uint8_t *) SYS_META;
+	sys_meta_sgmt.length = strlen(SYS_META);
+	sys_meta_sgmt.fd = -1;
+
+	memset(&app_meta_sgmt, 0, sizeof(app_meta_sgmt));
+	app_meta_sgmt.payload = (uint8_t *) APP_META_PATH;
+	app_meta_sgmt.length = APP_META_LENGTH;
+	app_meta_sgmt.on_disk = 1;
+	app_meta_sgmt.fd = -1;
+
+	memset(&payload_sgmt, 0, sizeof(payload_sgmt));
+	payload_sgmt.payload = (uint8_t *) PAYLOAD;
+	payload_sgmt.length = strlen(PAYLOAD);
+	payload_sgmt.fd = -1;
+
+	memset(&rec, 0, sizeof(rec));
+	rec.pid = 1234;
+	rec.have_uid = 1;
+	rec.uid = 4321;
+	rec.network_nonce = NONCE;
+	rec.source = SOURCE;
+	rec.timestamp = TIMESTAMP;
+	rec.username = USERNAME;
+	rec.hostname = HOSTNAME;
+	uuid_copy(rec.uuid, uuid);
+	rec.sys_meta = &sys_meta_sgmt;
+	rec.app_meta = &app_meta_sgmt;
+	rec.payload = &payload_sgmt;
+
+	jaldb_record_view_init(&view);
+}
+
+void teardown()
+{
+	jaldb_record_view_free(&view);
+}
+
+void test_view_get_string_works()
+{
+	size_t size = serialize_into_view();
+	const char *str = NULL;
+
+	assert_equals(JALDB_OK, jaldb_record_view_set(&view, 0, size, JALDB_RTYPE_LOG));
+	// Fields can be asked for in any order
+	assert_equals(JALDB_OK, jaldb_record_view_get_string(&view, JALDB_VIEW_HOSTNAME, &str));
+	assert_string_equals(HOSTNAME, str);
+	assert_equals(JALDB_OK, jaldb_record_view_get_string(&view, JALDB_VIEW_TIMESTAMP, &str));
+	assert_string_equals(TIMESTAMP, str);
+	assert_equals(JALDB_OK, jaldb_record_view_get_string(&view, JALDB_VIEW_NETWORK_NONCE, &str));
+	assert_string_equals(NONCE, str);
+	assert_equals(JALDB_OK, jaldb_record_view_get_string(&view, JALDB_VIEW_SOURCE, &str));
+	assert_string_equals(SOURCE, str);
+	assert_equals(JALDB_OK, jaldb_record_view_get_string(&view, JALDB_VIEW_USERNAME, &str));
+	assert_string_equals(USERNAME, str);
+	// The strings point into the buffer
+	assert_true((const uint8_t *) str > view.buf && (const uint8_t *) str < view.buf + size);
+}
+
+void test_view_get_string_returns_null_for_empty_string()
+{
+	const char *str = SOURCE;
+	size_t size = serialize_into_view();
+
+	assert_equals(JALDB_OK, jaldb_record_view_set(&view, 0, size, JALDB_RTYPE_LOG));
+	assert_equals(JALDB_OK, jaldb_record_view_get_string(&view, JALDB_VIEW_SEC_LBL, &str));
+	assert_pointer_equals((void*) NULL, str);
+}
+
+void test_view_get_string_fails_for_segment_field()
+{
+	const char *str = NULL;
+	size_t size = serialize_into_view();
+
+	assert_equals(JALDB_OK, jaldb_record_view_set(&view, 0, size, JALDB_RTYPE_LOG));
+	assert_equals(JALDB_E_INVAL, jaldb_record_view_get_string(&view, JALDB_VIEW_PAYLOAD, &str));
+	assert_equals(JALDB_E_INVAL, jaldb_record_view_get_string(&view, JALDB_VIEW_SOURCE, NULL));
+}
+
+void test_view_get_segment_works()
+{
+	const uint8_t *buf = NULL;
+	uint64_t len = 0;
+	int on_disk = -1;
+	size_t size = serialize_into_view();
+
+	assert_equals(JALDB_OK, jaldb_record_view_set(&view, 0, size, JALDB_RTYPE_LOG));
+	assert_equals(JALDB_OK, jaldb_record_view_get_segment(&view, JALDB_VIEW_PAYLOAD,
+			&buf, &len, &on_disk));
+	assert_equals(strlen(PAYLOAD), len);
+	assert_equals(0, on_disk);
+	assert_equals(0, memcmp(PAYLOAD, buf, len));
+	// The payload is the end of the record
+	assert_pointer_equals(view.buf + size - len, buf);
+
+	assert_equals(JALDB_OK, jaldb_record_view_get_segment(&view, JALDB_VIEW_SYS_META,
+			&buf, &len, &on_disk));
+	assert_equals(strlen(SYS_META), len);
+	assert_equals(0, on_disk);
+	assert_equals(0, memcmp(SYS_META, buf, len));
+}
+
+void test_view_get_segment_works_for_segment_on_disk()
+{
+	const uint8_t *buf = NULL;
+	uint64_t len = 0;
+	int on_disk = 0;
+	size_t size = serialize_into_view();
+
+	assert_equals(JALDB_OK, jaldb_record_view_set(&view, 0, size, JALDB_RTYPE_LOG));
+	assert_equals(JALDB_OK, jaldb_record_view_get_segment(&view, JALDB_VIEW_APP_META,
+			&buf, &len, &on_disk));
+	assert_equals(APP_META_LENGTH, len);
+	assert_equals(1, on_disk);
+	assert_string_equals(APP_META_PATH, (const char *) buf);
+}
+
+void test_view_get_segment_works_for_missing_segment()
+{
+	const uint8_t *buf = (const uint8_t *) PAYLOAD;
+	uint64_t len = 1;
+	int on_disk = 1;
+	rec.app_meta = NULL;
+	size_t size = serialize_into_view();
+
+	assert_equals(JALDB_OK, jaldb_record_view_set(&view, 0, size, JALDB_RTYPE_AUDIT));
+	assert_equals(JALDB_OK, jaldb_record_view_get_segment(&view, JALDB_VIEW_APP_META,
+			&buf, &len, &on_disk));
+	assert_pointer_equals((void*) NULL, buf);
+	assert_equals(0, len);
+	assert_equals(0, on_disk);
+	assert_equals(JALDB_OK, jaldb_record_view_get_segment(&view, JALDB_VIEW_PAYLOAD,
+			&buf, &len, &on_disk));
+	assert_equals(0, memcmp(PAYLOAD, buf, len));
+}
+
+void test_view_get_segment_returns_generated_sys_meta()
+{
+	const uint8_t *buf = NULL;
+	uint64_t len = 0;
+	int on_disk = 1;
+	rec.sys_meta = NULL;
+	size_t size = serialize_into_view();
+
+	assert_equals(JALDB_OK, jaldb_record_view_set(&view, 0, size, JALDB_RTYPE_LOG));
+	assert_equals(JALDB_OK, jaldb_record_view_get_segment(&view, JALDB_VIEW_SYS_META,
+			&buf, &len, &on_disk));
+	assert_pointer_equals((void*) NULL, buf);
+
+	uint8_t *doc = (uint8_t *) strdup(SYS_META);
+	jaldb_record_view_set_sys_meta(&view, doc, strlen(SYS_META));
+	assert_equals(JALDB_OK, jaldb_record_view_get_segment(&view, JALDB_VIEW_SYS_META,
+			&buf, &len, &on_disk));
+	assert_pointer_equals(doc, buf);
+	assert_equals(strlen(SYS_META), len);
+	assert_equals(0, on_disk);
+}
+
+void test_view_set_fails_for_bad_version()
+{
+	size_t size = serialize_into_view();
+	struct jaldb_serialize_record_headers *headers =
+		(struct jaldb_serialize_record_headers *) view.buf;
+	headers->version = JALDB_DB_LAYOUT_VERSION + 1;
+
+	assert_equals(JALDB_E_LAYOUT_VERSION_UNKNOWN,
+			jaldb_record_view_set(&view, 0, size, JALDB_RTYPE_LOG));
+	assert_equals(0, view.size);
+}
+
+void test_view_set_fails_for_short_buffer()
+{
+	jaldb_record_view_reserve(&view, 4);
+	memset(view.buf, 0, 4);
+	assert_equals(JALDB_E_INVAL, jaldb_record_view_set(&view, 0, 4, JALDB_RTYPE_LOG));
+	assert_equals(JALDB_E_INVAL, jaldb_record_view_set(&view, 0, 5, JALDB_RTYPE_LOG));
+}
+
+void test_view_fails_for_truncated_record()
+{
+	const uint8_t *buf = NULL;
+	const char *str = NULL;
+	uint64_t len = 0;
+	int on_disk = 0;
+	size_t size = serialize_into_view();
+
+	// Cut the payload short
+	assert_equals(JALDB_OK, jaldb_record_view_set(&view, 0, size - 1, JALDB_RTYPE_LOG));
+	assert_equals(JALDB_OK, jaldb_record_view_get_string(&view, JALDB_VIEW_USERNAME, &str));
+	assert_equals(JALDB_E_INVAL, jaldb_record_view_get_segment(&view, JALDB_VIEW_PAYLOAD,
+			&buf, &len, &on_disk));
+
+	// Cut a string short
+	memset(view.buf + sizeof(struct jaldb_serialize_record_headers), 'x',
+			strlen(TIMESTAMP) + 1);
+	assert_equals(JALDB_OK, jaldb_record_view_set(&view, 0,
+			sizeof(struct jaldb_serialize_record_headers) + strlen(TIMESTAMP) + 1,
+			JALDB_RTYPE_LOG));
+	assert_equals(JALDB_E_INVAL, jaldb_record_view_get_string(&view, JALDB_VIEW_TIMESTAMP, &str));
+}
+
+void test_view_to_record_works()
+{
+	struct jaldb_record *res = NULL;
+	uuid_t res_uuid;
+	rec.sys_meta = NULL;
+	size_t size = serialize_into_view();
+
+	assert_equals(JALDB_OK, jaldb_record_view_set(&view, 0, size, JALDB_RTYPE_AUDIT));
+	jaldb_record_view_set_sys_meta(&view, (uint8_t *) strdup(SYS_META), strlen(SYS_META));
+	assert_equals(JALDB_OK, jaldb_record_view_to_record(&view, &res));
+
+	assert_equals(JALDB_RTYPE_AUDIT, res->type);
+	assert_string_equals(NONCE, res->network_nonce);
+	assert_string_equals(HOSTNAME, res->hostname);
+	assert_equals(strlen(PAYLOAD), res->payload->length);
+	assert_equals(0, memcmp(PAYLOAD, res->payload->payload, res->payload->length));
+	assert_equals(strlen(SYS_META), res->sys_meta->length);
+	assert_equals(0, memcmp(SYS_META, res->sys_meta->payload, res->sys_meta->length));
+	jaldb_record_view_get_uuid(&view, res_uuid);
+	assert_equals(0, uuid_compare(uuid, res_uuid));
+	assert_equals(0, uuid_compare(uuid, res->uuid));
+	jaldb_destroy_record(&res);
+
+	// The view is left alone
+	const char *str = NULL;
+	assert_equals(JALDB_OK, jaldb_record_view_get_string(&view, JALDB_VIEW_SOURCE, &str));
+	assert_string_equals(SOURCE, str);
+}
+
+void test_view_to_record_fails_for_empty_view()
+{
+	struct jaldb_record *res = NULL;
+	assert_equals(JALDB_E_INVAL, jaldb_record_view_to_record(&view, &res));
+	assert_pointer_equals((void*) NULL, res);
+}
+
+void test_view_release_keeps_buffer()
+{
+	const char *str = NULL;
+	size_t size = serialize_into_view();
+	uint8_t *buf = view.buf;
+
+	assert_equals(JALDB_OK, jaldb_record_view_set(&view, 0, size, JALDB_RTYPE_LOG));
+	jaldb_record_view_set_sys_meta(&view, (uint8_t *) strdup(SYS_META), strlen(SYS_META));
+	jaldb_record_view_release(&view);
+
+	assert_equals(0, view.size);
+	assert_pointer_equals((void*) NULL, view.sys_meta_doc);
+	assert_equals(JALDB_E_INVAL, jaldb_record_view_get_string(&view, JALDB_VIEW_SOURCE, &str));
+
+	// A record that fits is read into the same buffer
+	jaldb_record_view_reserve(&view, size);
+	assert_pointer_equals(buf, view.buf);
+	assert_equals(JALDB_OK, jaldb_record_view_set(&view, 0, size, JALDB_RTYPE_LOG));
+	assert_equals(JALDB_OK, jaldb_record_view_get_string(&view, JALDB_VIEW_SOURCE, &str));
+	assert_string_equals(SOURCE, str);
+}
+
+void test_batch_next_view_grows_batch()
+{
+	struct jaldb_record_batch batch;
+	size_t size = serialize_into_view();
+	jaldb_record_batch_init(&batch);
+
+	for (int i = 0; i < 20; i++) {
+		struct jaldb_record_view *next = jaldb_record_batch_next_view(&batch);
+		assert_equals(0, next->size);
+		jaldb_record_view_reserve(next, size);
+		memcpy(next->buf, view.buf, size);
+		assert_equals(JALDB_OK, jaldb_record_view_set(next, 0, size, JALDB_RTYPE_LOG));
+		batch.count++;
+	}
+	assert_true(batch.allocated >= 20);
+
+	const char *str = NULL;
+	assert_equals(JALDB_OK, jaldb_record_view_get_string(&batch.views[19], JALDB_VIEW_SOURCE, &str));
+	assert_string_equals(SOURCE, str);
+
+	// Released views keep their buffers
+	uint8_t *buf = batch.views[3].buf;
+	jaldb_record_batch_release(&batch);
+	assert_equals(0, batch.count);
+	assert_equals(0, batch.views[3].size);
+	assert_pointer_equals(buf, batch.views[3].buf);
+
+	jaldb_record_batch_free(&batch);
+	assert_equals(0, batch.allocated);
+	assert_pointer_equals((void*) NULL, batch.views);
+}
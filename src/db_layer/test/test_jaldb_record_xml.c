@@ -43,10 +43,12 @@
 #include <test-dept.h>
 
 #include "jal_alloc.h"
+#include "jal_xml_utils.h"
 
 #include "jaldb_record.h"
 #include "jaldb_record_xml.h"
 #include "jaldb_segment.h"
+#include "jaldb_xml_writer.h"
 
 #include "xml_test_utils2.h"
 
@@ -54,6 +56,7 @@ struct jaldb_record rec;
 struct jaldb_segment app_meta;
 struct jaldb_segment payload;
 RSA *key;
+struct jal_sign_pool *pool;
 
 #define TEST_RSA_KEY  TEST_INPUT_ROOT "TLS_Unit_Test_Files/rsa_key"
 
@@ -99,11 +102,14 @@ void setup()
 	xmlSecCryptoInit();
 
 	key = NULL;
+	pool = NULL;
 }
 
 void teardown()
 {
 	jaldb_destroy_segment(&rec.payload);
+	jal_sign_pool_destroy(&pool);
+	RSA_free(key);
 	xmlCleanupParser();
 }
 
@@ -113,7 +119,7 @@ do { \
 	char* dbuf = NULL; \
 	size_t dbufsz = 0; \
 	xmlDocPtr doc; \
-	ret = jaldb_record_to_system_metadata_doc(&rec, key, NULL, 0, NULL, NULL, 0, NULL, &dbuf, &dbufsz); \
+	ret = jaldb_record_to_system_metadata_doc(&rec, pool, NULL, 0, NULL, NULL, 0, NULL, &dbuf, &dbufsz); \
 	assert_equals(JALDB_OK, ret); \
 	assert_not_equals((void*) NULL, dbuf); \
 	assert_not_equals(0, dbufsz); \
@@ -246,6 +252,8 @@ void test_to_system_works_with_signing_key()
 	assert_not_equals(NULL, fp);
 	key = PEM_read_RSAPrivateKey(fp, NULL, NULL, NULL);
 	fclose(fp);
+	pool = jal_sign_pool_create(key, NULL);
+	assert_not_equals((void *) NULL, pool);
 
 	VERIFY_DOC(log, 1, 1, 1);
 }
@@ -273,6 +281,158 @@ void test_to_system_fails_with_bad_input()
 	assert_not_equals(JALDB_OK, ret);
 }
 
+#define DGST "0123456789abcdef"
+#define DGST_LEN 16
+#define DGST_B64 "MDEyMzQ1Njc4OWFiY2RlZg=="
+#define DGST_ALG "http://www.w3.org/2001/04/xmlenc#sha256"
+
+#define GOLDEN_SYS_META \
+	"<?xml version=\"1.0\"?>\n" \
+	"<JALRecord xmlns=\"" JAL_SYS_META_NAMESPACE_URI "\" JID=\"" JID "\">\n" \
+	"  <JALDataType>log</JALDataType>\n" \
+	"  <RecordID>" REC_UUID "</RecordID>\n" \
+	"  <Hostname>" HOSTNAME "</Hostname>\n" \
+	"  <HostUUID>" HOST_UUID "</HostUUID>\n" \
+	"  <Timestamp>" TIMESTAMP "</Timestamp>\n" \
+	"  <ProcessID>" PID_STR "</ProcessID>\n" \
+	"  <User name=\"" USERNAME "\">" UID_STR "</User>\n" \
+	"  <SecurityLabel>" SEC_LABEL "</SecurityLabel>\n" \
+	"  <Manifest xmlns=\"" JAL_XMLDSIG_URI "\">\n" \
+	"    <Reference URI=\"" JAL_PAYLOAD_URI "\">\n" \
+	"      <DigestMethod Algorithm=\"" DGST_ALG "\"/>\n" \
+	"      <DigestValue xmlns=\"" JAL_XMLDSIG_URI "\">" DGST_B64 "</DigestValue>\n" \
+	"    </Reference>\n" \
+	"    <Reference URI=\"" JAL_APP_META_URI "\">\n" \
+	"      <DigestMethod Algorithm=\"" DGST_ALG "\"/>\n" \
+	"      <DigestValue xmlns=\"" JAL_XMLDSIG_URI "\">" DGST_B64 "</DigestValue>\n" \
+	"    </Reference>\n" \
+	"  </Manifest>\n" \
+	"</JALRecord>\n"
+
+#define GOLDEN_SYS_META_NO_UID \
+	"<?xml version=\"1.0\"?>\n" \
+	"<JALRecord xmlns=\"" JAL_SYS_META_NAMESPACE_URI "\" JID=\"" JID "\">\n" \
+	"  <JALDataType>journal</JALDataType>\n" \
+	"  <RecordID>" REC_UUID "</RecordID>\n" \
+	"  <Hostname>" HOSTNAME "</Hostname>\n" \
+	"  <HostUUID>" HOST_UUID "</HostUUID>\n" \
+	"  <Timestamp/>\n" \
+	"  <ProcessID>" PID_STR "</ProcessID>\n" \
+	"  <User xmlns:xsi=\"http://www.w3.org/2001/XMLSchema-instance\" name=\"" USERNAME "\" xsi:nil=\"true\"/>\n" \
+	"</JALRecord>\n"
+
+/*
+ * Generate the document with both the writer and libxml2, and check that
+ * they match each other and, if given, \p golden.
+ */
+static void assert_writer_matches_dom(uint8_t *dgst, size_t dgst_len,
+		const char *golden)
+{
+	char *dom_buf = NULL;
+	size_t dom_sz = 0;
+	char *doc_buf = NULL;
+	size_t doc_sz = 0;
+	const char *alg = dgst ? DGST_ALG : NULL;
+
+	assert_equals(JALDB_OK, jaldb_record_to_system_metadata_dom(&rec, NULL,
+			dgst, dgst_len, alg, dgst, dgst_len, alg, &dom_buf, &dom_sz));
+	assert_equals(JALDB_OK, jaldb_record_to_system_metadata_doc(&rec, NULL,
+			dgst, dgst_len, alg, dgst, dgst_len, alg, &doc_buf, &doc_sz));
+	assert_equals(dom_sz, doc_sz);
+	assert_string_equals(dom_buf, doc_buf);
+	if (golden) {
+		assert_equals(strlen(golden), doc_sz);
+		assert_string_equals(golden, doc_buf);
+	}
+	free(dom_buf);
+	free(doc_buf);
+}
+
+void test_to_system_matches_golden_output()
+{
+	rec.type = JALDB_RTYPE_LOG;
+	assert_writer_matches_dom((uint8_t *) DGST, DGST_LEN, GOLDEN_SYS_META);
+}
+
+void test_to_system_matches_golden_output_without_uid()
+{
+	rec.type = JALDB_RTYPE_JOURNAL;
+	rec.have_uid = 0;
+	rec.sec_lbl = NULL;
+	rec.timestamp = "";
+	assert_writer_matches_dom(NULL, 0, GOLDEN_SYS_META_NO_UID);
+}
+
+void test_to_system_writer_escapes_like_libxml2()
+{
+	rec.type = JALDB_RTYPE_AUDIT;
+	rec.hostname = "<host> \"name\" 'x'\t\n";
+	rec.sec_lbl = "a<b>c";
+	rec.username = "us&er <\"name\">\t\n";
+	assert_writer_matches_dom((uint8_t *) DGST, DGST_LEN, NULL);
+
+	rec.have_uid = 0;
+	assert_writer_matches_dom(NULL, 0, NULL);
+}
+
+void test_to_system_writer_leaves_other_text_to_libxml2()
+{
+	struct jaldb_xml_writer w;
+	jaldb_xml_writer_init(&w, 0);
+	rec.type = JALDB_RTYPE_LOG;
+
+	rec.hostname = "a&amp;b";
+	assert_equals(JALDB_E_NOT_IMPL, jaldb_record_to_system_metadata_write(&rec,
+			NULL, 0, NULL, NULL, 0, NULL, &w));
+	assert_equals(0, w.len);
+	assert_writer_matches_dom(NULL, 0, NULL);
+
+	rec.hostname = HOSTNAME;
+	rec.timestamp = "2012\r";
+	assert_equals(JALDB_E_NOT_IMPL, jaldb_record_to_system_metadata_write(&rec,
+			NULL, 0, NULL, NULL, 0, NULL, &w));
+	assert_writer_matches_dom(NULL, 0, NULL);
+
+	rec.timestamp = TIMESTAMP;
+	rec.sec_lbl = "\xc3\xa9";
+	assert_equals(JALDB_E_NOT_IMPL, jaldb_record_to_system_metadata_write(&rec,
+			NULL, 0, NULL, NULL, 0, NULL, &w));
+	assert_writer_matches_dom(NULL, 0, NULL);
+
+	jaldb_xml_writer_free(&w);
+}
+
+void test_to_system_writer_appends_to_the_buffer()
+{
+	struct jaldb_xml_writer w;
+	jaldb_xml_writer_init(&w, 0);
+	rec.type = JALDB_RTYPE_LOG;
+
+	jaldb_xml_writer_lit(&w, "prefix");
+	assert_equals(JALDB_OK, jaldb_record_to_system_metadata_write(&rec,
+			(uint8_t *) DGST, DGST_LEN, DGST_ALG, (uint8_t *) DGST, DGST_LEN, DGST_ALG, &w));
+	assert_string_equals("prefix" GOLDEN_SYS_META, w.buf);
+
+	jaldb_xml_writer_free(&w);
+}
+
+void test_to_system_writer_fails_with_bad_input()
+{
+	struct jaldb_xml_writer w;
+	jaldb_xml_writer_init(&w, 0);
+
+	assert_equals(JALDB_E_INVAL, jaldb_record_to_system_metadata_write(NULL,
+			NULL, 0, NULL, NULL, 0, NULL, &w));
+	assert_equals(JALDB_E_INVAL, jaldb_record_to_system_metadata_write(&rec,
+			NULL, 0, NULL, NULL, 0, NULL, NULL));
+	rec.type = JALDB_RTYPE_UNKNOWN;
+	assert_equals(JALDB_E_INVAL, jaldb_record_to_system_metadata_write(&rec,
+			NULL, 0, NULL, NULL, 0, NULL, &w));
+	assert_equals(0, w.len);
+
+	jaldb_xml_writer_free(&w);
+}
+
 void test_jaldb_xml_to_sys_metadata_works()
 {
 	struct jaldb_record *sys_meta;
@@ -31,6 +31,7 @@
 #include <stdint.h>
 #include <stdlib.h>
 
+#include "jaldb_arena.h"
 #include "jaldb_segment.h"
 #include "jaldb_serialize_record.h"
 #include "jaldb_record.h"
@@ -907,3 +908,47 @@ void test_serialize_deserialize_record_works_when_not_synced()
 
 	jaldb_destroy_record(&dsr);
 }
+
+void test_deserialize_record_allocates_from_one_arena()
+{
+	size_t res_size = 0;
+	struct jaldb_record *dsr = NULL;
+	rec.sys_meta = &sys_meta_on_disk_sgmt;
+	rec.payload = &payload_in_ram_sgmt;
+
+	enum jaldb_status ret;
+	ret = jaldb_serialize_record(0, &rec, &buffer, &res_size);
+	assert_equals(JALDB_OK, ret);
+
+	ret = jaldb_deserialize_record(0, buffer, res_size, &dsr);
+	assert_equals(JALDB_OK, ret);
+
+	assert_not_equals((void*) NULL, dsr->arena);
+	assert_true(jaldb_arena_owns(dsr->arena, dsr));
+	assert_true(jaldb_arena_owns(dsr->arena, dsr->source));
+	assert_true(jaldb_arena_owns(dsr->arena, dsr->timestamp));
+	assert_true(jaldb_arena_owns(dsr->arena, dsr->sys_meta));
+	assert_true(jaldb_arena_owns(dsr->arena, dsr->sys_meta->payload));
+	assert_true(jaldb_arena_owns(dsr->arena, dsr->payload->payload));
+	assert_equals(-1, dsr->sys_meta->fd);
+	assert_equals(1, dsr->sys_meta->on_disk);
+
+	jaldb_destroy_record(&dsr);
+}
+
+void test_deserialize_segment_does_not_use_an_arena()
+{
+	struct jaldb_segment *seg = NULL;
+	uint8_t *ptr = NULL;
+	size_t bsize = SYS_META_IN_RAM_LENGTH;
+	init_buffer(bsize);
+	memcpy(buffer, SYS_META_IN_RAM_PAYLOAD, bsize);
+	ptr = buffer;
+
+	enum jaldb_status ret = jaldb_deserialize_segment(0, SYS_META_IN_RAM_LENGTH, &ptr, &bsize, &seg);
+	assert_equals(JALDB_OK, ret);
+	assert_equals(0, memcmp(SYS_META_IN_RAM_PAYLOAD, seg->payload, SYS_META_IN_RAM_LENGTH));
+
+	// Freed individually
+	jaldb_destroy_segment(&seg);
+}
@@ -0,0 +1,244 @@
+/**
+ * @file test_jaldb_sys_meta_cache.cpp This file contains tests for
+ * jaldb_sys_meta_cache.cpp functions.
+ *
+ * @section LICENSE
+ *
+ * Source code in 3rd-party is licensed and owned by their respective
+ * copyright holders.
+ *
+ * All other source code is copyright Tresys Technology and licensed as below.
+ *
+ * Copyright (c) 2011-2012 Tresys Technology LLC, Columbia, Maryland, USA
+ *
+ * This software was developed by Tresys Technology LLC
+ * with U.S. Government sponsorship.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+// The test-dept code doesn't work very well in C++ when __STRICT_ANSI__ is
+// not defined. It tries to use some gcc extensions that don't work well with
+// C++.
+#ifndef __STRICT_ANSI__
+#define __STRICT_ANSI__
+#endif
+extern "C" {
+#include <test-dept.h>
+}
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "jaldb_sys_meta_cache.h"
+
+#define NONCE_1 "1"
+#define NONCE_2 "2"
+#define NONCE_3 "3"
+#define DOC_1 "<sys_meta>one</sys_meta>"
+#define DOC_2 "<sys_meta>two</sys_meta>"
+#define DOC_3 "<sys_meta>three</sys_meta>"
+
+static struct jaldb_sys_meta_cache *cache;
+
+static enum jaldb_status put(enum jaldb_rec_type type, const char *nonce, const char *doc)
+{
+	return jaldb_sys_meta_cache_put(cache, type, nonce, (const uint8_t *) doc, strlen(doc));
+}
+
+static void assert_cached(enum jaldb_rec_type type, const char *nonce, const char *expected)
+{
+	uint8_t *doc = NULL;
+	size_t doc_len = 0;
+	assert_equals(JALDB_OK, jaldb_sys_meta_cache_get(cache, type, nonce, &doc, &doc_len));
+	assert_equals(strlen(expected), doc_len);
+	assert_equals(0, memcmp(expected, doc, doc_len));
+	free(doc);
+}
+
+static void assert_not_cached(enum jaldb_rec_type type, const char *nonce)
+{
+	uint8_t *doc = NULL;
+	size_t doc_len = 0;
+	assert_equals(JALDB_E_NOT_FOUND, jaldb_sys_meta_cache_get(cache, type, nonce, &doc, &doc_len));
+	assert_equals((void *) NULL, doc);
+}
+
+extern "C" void setup()
+{
+	cache = jaldb_sys_meta_cache_create(2, 0);
+}
+
+extern "C" void teardown()
+{
+	jaldb_sys_meta_cache_destroy(&cache);
+}
+
+extern "C" void test_create_returns_null_without_entries()
+{
+	assert_equals((void *) NULL, jaldb_sys_meta_cache_create(0, 100));
+}
+
+extern "C" void test_destroy_does_not_crash_on_null()
+{
+	struct jaldb_sys_meta_cache *null_cache = NULL;
+	jaldb_sys_meta_cache_destroy(NULL);
+	jaldb_sys_meta_cache_destroy(&null_cache);
+	jaldb_sys_meta_cache_destroy(&cache);
+	assert_equals((void *) NULL, cache);
+}
+
+extern "C" void test_get_returns_what_was_put()
+{
+	struct jaldb_sys_meta_cache_stats stats;
+
+	assert_not_cached(JALDB_RTYPE_LOG, NONCE_1);
+	assert_equals(JALDB_OK, put(JALDB_RTYPE_LOG, NONCE_1, DOC_1));
+	assert_cached(JALDB_RTYPE_LOG, NONCE_1, DOC_1);
+
+	assert_equals(JALDB_OK, jaldb_sys_meta_cache_get_stats(cache, &stats));
+	assert_equals(1, stats.hits);
+	assert_equals(1, stats.misses);
+	assert_equals(1, stats.entries);
+	assert_equals(strlen(DOC_1), stats.bytes);
+}
+
+extern "C" void test_nonces_are_per_record_type()
+{
+	assert_equals(JALDB_OK, put(JALDB_RTYPE_LOG, NONCE_1, DOC_1));
+	assert_equals(JALDB_OK, put(JALDB_RTYPE_AUDIT, NONCE_1, DOC_2));
+	assert_cached(JALDB_RTYPE_LOG, NONCE_1, DOC_1);
+	assert_cached(JALDB_RTYPE_AUDIT, NONCE_1, DOC_2);
+	assert_not_cached(JALDB_RTYPE_JOURNAL, NONCE_1);
+}
+
+extern "C" void test_put_replaces_an_existing_document()
+{
+	struct jaldb_sys_meta_cache_stats stats;
+
+	assert_equals(JALDB_OK, put(JALDB_RTYPE_LOG, NONCE_1, DOC_1));
+	assert_equals(JALDB_OK, put(JALDB_RTYPE_LOG, NONCE_1, DOC_3));
+	assert_cached(JALDB_RTYPE_LOG, NONCE_1, DOC_3);
+
+	assert_equals(JALDB_OK, jaldb_sys_meta_cache_get_stats(cache, &stats));
+	assert_equals(1, stats.entries);
+	assert_equals(strlen(DOC_3), stats.bytes);
+	assert_equals(0, stats.evictions);
+}
+
+extern "C" void test_put_evicts_the_least_recently_used()
+{
+	struct jaldb_sys_meta_cache_stats stats;
+
+	assert_equals(JALDB_OK, put(JALDB_RTYPE_LOG, NONCE_1, DOC_1));
+	assert_equals(JALDB_OK, put(JALDB_RTYPE_LOG, NONCE_2, DOC_2));
+	// Looking up the first document makes the second the oldest
+	assert_cached(JALDB_RTYPE_LOG, NONCE_1, DOC_1);
+	assert_equals(JALDB_OK, put(JALDB_RTYPE_LOG, NONCE_3, DOC_3));
+
+	assert_cached(JALDB_RTYPE_LOG, NONCE_1, DOC_1);
+	assert_not_cached(JALDB_RTYPE_LOG, NONCE_2);
+	assert_cached(JALDB_RTYPE_LOG, NONCE_3, DOC_3);
+
+	assert_equals(JALDB_OK, jaldb_sys_meta_cache_get_stats(cache, &stats));
+	assert_equals(1, stats.evictions);
+	assert_equals(2, stats.entries);
+	assert_equals(strlen(DOC_1) + strlen(DOC_3), stats.bytes);
+}
+
+extern "C" void test_put_evicts_to_stay_within_the_byte_limit()
+{
+	struct jaldb_sys_meta_cache_stats stats;
+
+	jaldb_sys_meta_cache_destroy(&cache);
+	cache = jaldb_sys_meta_cache_create(10, strlen(DOC_1) + strlen(DOC_2));
+
+	assert_equals(JALDB_OK, put(JALDB_RTYPE_LOG, NONCE_1, DOC_1));
+	assert_equals(JALDB_OK, put(JALDB_RTYPE_LOG, NONCE_2, DOC_2));
+	assert_equals(JALDB_OK, put(JALDB_RTYPE_LOG, NONCE_3, DOC_3));
+
+	assert_not_cached(JALDB_RTYPE_LOG, NONCE_1);
+	assert_cached(JALDB_RTYPE_LOG, NONCE_3, DOC_3);
+
+	assert_equals(JALDB_OK, jaldb_sys_meta_cache_get_stats(cache, &stats));
+	assert_true(stats.bytes <= strlen(DOC_1) + strlen(DOC_2));
+	assert_true(stats.evictions >= 1);
+}
+
+extern "C" void test_put_skips_documents_larger_than_the_byte_limit()
+{
+	struct jaldb_sys_meta_cache_stats stats;
+
+	jaldb_sys_meta_cache_destroy(&cache);
+	cache = jaldb_sys_meta_cache_create(10, strlen(DOC_1));
+
+	assert_equals(JALDB_OK, put(JALDB_RTYPE_LOG, NONCE_1, DOC_1));
+	assert_equals(JALDB_OK, put(JALDB_RTYPE_LOG, NONCE_3, DOC_3));
+	assert_cached(JALDB_RTYPE_LOG, NONCE_1, DOC_1);
+	assert_not_cached(JALDB_RTYPE_LOG, NONCE_3);
+
+	assert_equals(JALDB_OK, jaldb_sys_meta_cache_get_stats(cache, &stats));
+	assert_equals(0, stats.evictions);
+	assert_equals(1, stats.entries);
+}
+
+extern "C" void test_remove_drops_the_document()
+{
+	struct jaldb_sys_meta_cache_stats stats;
+
+	assert_equals(JALDB_OK, put(JALDB_RTYPE_LOG, NONCE_1, DOC_1));
+	jaldb_sys_meta_cache_remove(cache, JALDB_RTYPE_LOG, NONCE_1);
+	jaldb_sys_meta_cache_remove(cache, JALDB_RTYPE_LOG, NONCE_2);
+	assert_not_cached(JALDB_RTYPE_LOG, NONCE_1);
+
+	assert_equals(JALDB_OK, jaldb_sys_meta_cache_get_stats(cache, &stats));
+	assert_equals(0, stats.entries);
+	assert_equals(0, stats.bytes);
+}
+
+extern "C" void test_add_write_back_counts_write_backs()
+{
+	struct jaldb_sys_meta_cache_stats stats;
+
+	jaldb_sys_meta_cache_add_write_back(cache);
+	jaldb_sys_meta_cache_add_write_back(cache);
+	jaldb_sys_meta_cache_add_write_back(NULL);
+
+	assert_equals(JALDB_OK, jaldb_sys_meta_cache_get_stats(cache, &stats));
+	assert_equals(2, stats.write_backs);
+}
+
+extern "C" void test_functions_fail_with_bad_input()
+{
+	struct jaldb_sys_meta_cache_stats stats;
+	uint8_t *doc = NULL;
+	uint8_t *not_null = (uint8_t *) DOC_1;
+	size_t doc_len = 0;
+
+	assert_equals(JALDB_E_INVAL, jaldb_sys_meta_cache_get(NULL, JALDB_RTYPE_LOG, NONCE_1, &doc, &doc_len));
+	assert_equals(JALDB_E_INVAL, jaldb_sys_meta_cache_get(cache, JALDB_RTYPE_LOG, NULL, &doc, &doc_len));
+	assert_equals(JALDB_E_INVAL, jaldb_sys_meta_cache_get(cache, JALDB_RTYPE_LOG, NONCE_1, NULL, &doc_len));
+	assert_equals(JALDB_E_INVAL, jaldb_sys_meta_cache_get(cache, JALDB_RTYPE_LOG, NONCE_1, &not_null, &doc_len));
+	assert_equals(JALDB_E_INVAL, jaldb_sys_meta_cache_get(cache, JALDB_RTYPE_LOG, NONCE_1, &doc, NULL));
+
+	assert_equals(JALDB_E_INVAL, jaldb_sys_meta_cache_put(NULL, JALDB_RTYPE_LOG, NONCE_1, (const uint8_t *) DOC_1, 1));
+	assert_equals(JALDB_E_INVAL, jaldb_sys_meta_cache_put(cache, JALDB_RTYPE_LOG, NULL, (const uint8_t *) DOC_1, 1));
+	assert_equals(JALDB_E_INVAL, jaldb_sys_meta_cache_put(cache, JALDB_RTYPE_LOG, NONCE_1, NULL, 1));
+
+	assert_equals(JALDB_E_INVAL, jaldb_sys_meta_cache_get_stats(NULL, &stats));
+	assert_equals(JALDB_E_INVAL, jaldb_sys_meta_cache_get_stats(cache, NULL));
+
+	jaldb_sys_meta_cache_remove(NULL, JALDB_RTYPE_LOG, NONCE_1);
+	jaldb_sys_meta_cache_remove(cache, JALDB_RTYPE_LOG, NULL);
+}
@@ -41,6 +41,7 @@
 #include <fcntl.h>
 
 #include "jal_alloc.h"
+#include "jaldb_datetime.h"
 #include "jaldb_strings.h"
 #include "jaldb_utils.h"
 #include "test_utils.h"
@@ -299,3 +300,30 @@ void test_jaldb_gen_timestamp_works()
 	assert_equals(1,sscanf(end_timestamp,".%d-%*d:%*d",&ms));
 
 }
+
+void test_jaldb_gen_time_ordered_primary_key_works()
+{
+	uuid_t uuid = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15 };
+	char *key1 = jaldb_gen_time_ordered_primary_key(uuid);
+	char *key2 = jaldb_gen_time_ordered_primary_key(uuid);
+	assert_not_equals(NULL, key1);
+	assert_not_equals(NULL, key2);
+
+	assert_equals('_', key1[JALDB_TIME_ORDERED_KEY_PREFIX_LEN]);
+	assert_string_equals("00010203-0405-0607-0809-0a0b0c0d0e0f",
+			key1 + JALDB_TIME_ORDERED_KEY_PREFIX_LEN + 1);
+	// Keys generated later sort after earlier ones, even within the same
+	// clock tick.
+	assert_equals(strlen(key1), strlen(key2));
+	assert_true(strcmp(key1, key2) < 0);
+
+	free(key1);
+	free(key2);
+}
+
+void test_jaldb_gen_time_ordered_primary_key_fails_with_null_uuid()
+{
+	uuid_t uuid;
+	uuid_clear(uuid);
+	assert_equals((void*) NULL, jaldb_gen_time_ordered_primary_key(uuid));
+}
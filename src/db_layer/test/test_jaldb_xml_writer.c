@@ -0,0 +1,155 @@
+/**
+ * @file test_jaldb_xml_writer.c This file contains tests for
+ * jaldb_xml_writer.c functions.
+ *
+ * @section LICENSE
+ *
+ * Source code in 3rd-party is licensed and owned by their respective
+ * copyright holders.
+ *
+ * All other source code is copyright Tresys Technology and licensed as below.
+ *
+ * Copyright (c) 2012 Tresys Technology LLC, Columbia, Maryland, USA
+ *
+ * This software was developed by Tresys Technology LLC
+ * with U.S. Government sponsorship.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <test-dept.h>
+
+#include "jaldb_xml_writer.h"
+
+static struct jaldb_xml_writer w;
+
+void setup()
+{
+	jaldb_xml_writer_init(&w, 0);
+}
+
+void teardown()
+{
+	jaldb_xml_writer_free(&w);
+}
+
+void test_init_with_a_size_hint_allocates()
+{
+	struct jaldb_xml_writer hinted;
+	jaldb_xml_writer_init(&hinted, 64);
+	assert_not_equals((void *) NULL, hinted.buf);
+	assert_equals(64, hinted.cap);
+	assert_equals(0, hinted.len);
+	assert_string_equals("", hinted.buf);
+	jaldb_xml_writer_free(&hinted);
+	assert_equals((void *) NULL, hinted.buf);
+	assert_equals(0, hinted.cap);
+}
+
+void test_raw_appends_and_grows()
+{
+	char big[1000];
+	memset(big, 'x', sizeof(big));
+
+	jaldb_xml_writer_lit(&w, "abc");
+	assert_equals(3, w.len);
+	assert_string_equals("abc", w.buf);
+
+	jaldb_xml_writer_raw(&w, big, sizeof(big));
+	assert_equals(3 + sizeof(big), w.len);
+	assert_true(w.cap > w.len);
+	assert_equals('x', w.buf[w.len - 1]);
+	assert_equals('\0', w.buf[w.len]);
+}
+
+void test_reset_keeps_the_buffer()
+{
+	jaldb_xml_writer_lit(&w, "abc");
+	char *buf = w.buf;
+	size_t cap = w.cap;
+
+	jaldb_xml_writer_reset(&w);
+	assert_equals(0, w.len);
+	assert_pointer_equals(buf, w.buf);
+	assert_equals(cap, w.cap);
+	assert_string_equals("", w.buf);
+}
+
+void test_take_hands_over_the_buffer()
+{
+	size_t len = 0;
+	jaldb_xml_writer_lit(&w, "abc");
+
+	char *buf = jaldb_xml_writer_take(&w, &len);
+	assert_equals(3, len);
+	assert_string_equals("abc", buf);
+	assert_equals((void *) NULL, w.buf);
+	assert_equals(0, w.len);
+	assert_equals(0, w.cap);
+	free(buf);
+
+	buf = jaldb_xml_writer_take(&w, &len);
+	assert_equals(0, len);
+	assert_string_equals("", buf);
+	free(buf);
+}
+
+void test_text_escapes_markup()
+{
+	jaldb_xml_writer_text(&w, "a<b>&\"c'\t\n");
+	assert_string_equals("a&lt;b&gt;&amp;\"c'\t\n", w.buf);
+}
+
+void test_attr_escapes_markup_quotes_and_whitespace()
+{
+	jaldb_xml_writer_attr(&w, "a<b>&\"c'\t\n");
+	assert_string_equals("a&lt;b&gt;&amp;&quot;c'&#9;&#10;", w.buf);
+}
+
+void test_text_and_attr_treat_null_as_empty()
+{
+	jaldb_xml_writer_text(&w, NULL);
+	jaldb_xml_writer_attr(&w, NULL);
+	assert_equals(0, w.len);
+}
+
+void test_base64_works()
+{
+	jaldb_xml_writer_base64(&w, (const uint8_t *) "a", 1);
+	assert_string_equals("YQ==", w.buf);
+	jaldb_xml_writer_reset(&w);
+
+	jaldb_xml_writer_base64(&w, (const uint8_t *) "ab", 2);
+	assert_string_equals("YWI=", w.buf);
+	jaldb_xml_writer_reset(&w);
+
+	jaldb_xml_writer_lit(&w, ">");
+	jaldb_xml_writer_base64(&w, (const uint8_t *) "abc", 3);
+	jaldb_xml_writer_lit(&w, "<");
+	assert_string_equals(">YWJj<", w.buf);
+	assert_equals(6, w.len);
+}
+
+void test_is_plain_works()
+{
+	assert_true(jaldb_xml_writer_is_plain(NULL, 0));
+	assert_true(jaldb_xml_writer_is_plain("", 0));
+	assert_true(jaldb_xml_writer_is_plain("some.host <name>\t\n", 0));
+	assert_false(jaldb_xml_writer_is_plain("a&b", 0));
+	assert_true(jaldb_xml_writer_is_plain("a&b", 1));
+	assert_false(jaldb_xml_writer_is_plain("a\rb", 1));
+	assert_false(jaldb_xml_writer_is_plain("a\x01" "b", 1));
+	assert_false(jaldb_xml_writer_is_plain("caf\xc3\xa9", 1));
+}
@@ -324,6 +324,68 @@ enum jal_status jal_parse_digest_algorithm_str(const char *str, enum jal_digest_
  */
 enum jal_status jal_get_digest_algorithm_list(const char *config, const char *cli, enum jal_digest_algorithm **digest_list, size_t *num_digests);
 
+/**
+ * Opaque structure to compute digests with several algorithms in a single
+ * pass over the data.
+ */
+struct jal_multi_digest;
+
+/**
+ * Create a jal_multi_digest and initialize a digest instance for each
+ * algorithm. Duplicate algorithms are ignored.
+ *
+ * @param[in] algorithms The digest algorithms to compute.
+ * @param[in] count The number of entries in \p algorithms.
+ *
+ * @return the newly created jal_multi_digest, or NULL if \p count is 0, an
+ * algorithm is not supported, or a digest instance could not be initialized.
+ */
+struct jal_multi_digest *jal_multi_digest_create(const enum jal_digest_algorithm *algorithms,
+		size_t count);
+
+/**
+ * Feed bytes into every digest instance.
+ *
+ * @param[in] md The jal_multi_digest.
+ * @param[in] data A buffer containing bytes to feed into the digests.
+ * @param[in] len The size of the buffer.
+ *
+ * @returns JAL_OK on success, JAL_E_INVAL on failure or if jal_multi_digest_final()
+ * was already called.
+ */
+enum jal_status jal_multi_digest_update(struct jal_multi_digest *md,
+		const uint8_t *data, size_t len);
+
+/**
+ * Finish every digest. After this call, jal_multi_digest_get() can be used
+ * to retrieve the digest values.
+ *
+ * @param[in] md The jal_multi_digest.
+ *
+ * @returns JAL_OK on success, JAL_E_INVAL on failure.
+ */
+enum jal_status jal_multi_digest_final(struct jal_multi_digest *md);
+
+/**
+ * Retrieve a copy of one of the digests computed by a jal_multi_digest.
+ *
+ * @param[in] md The jal_multi_digest, jal_multi_digest_final() must have been called.
+ * @param[in] algorithm The algorithm to retrieve the digest for.
+ * @param[out] digest A pointer to hold a copy of the digest. Should point to NULL.
+ * @param[out] len The length of the digest.
+ *
+ * @returns JAL_OK on success, JAL_E_INVAL if the digest is not available.
+ */
+enum jal_status jal_multi_digest_get(const struct jal_multi_digest *md,
+		enum jal_digest_algorithm algorithm, uint8_t **digest, int *len);
+
+/**
+ * Release memory associated with a jal_multi_digest.
+ *
+ * @param[in] md The jal_multi_digest to destroy, this will be set to NULL.
+ */
+void jal_multi_digest_destroy(struct jal_multi_digest **md);
+
 #ifdef __cplusplus
 }
 #endif
@@ -369,6 +369,137 @@ err_out:
 
 }
 
+struct jal_multi_digest_entry {
+	enum jal_digest_algorithm algorithm;
+	struct jal_digest_ctx *ctx;
+	void *instance;
+	uint8_t *digest;
+};
+
+struct jal_multi_digest {
+	size_t count;
+	int finalized;
+	struct jal_multi_digest_entry entries[JAL_DIGEST_ALGORITHM_COUNT];
+};
+
+struct jal_multi_digest *jal_multi_digest_create(const enum jal_digest_algorithm *algorithms,
+		size_t count)
+{
+	if (!algorithms || 0 == count) {
+		return NULL;
+	}
+
+	struct jal_multi_digest *md = jal_calloc(1, sizeof(*md));
+
+	for (size_t i = 0; i < count; i++) {
+		if (algorithms[i] < 0 || algorithms[i] >= JAL_DIGEST_ALGORITHM_COUNT) {
+			goto err_out;
+		}
+		int dup = 0;
+		for (size_t j = 0; j < md->count; j++) {
+			if (md->entries[j].algorithm == algorithms[i]) {
+				dup = 1;
+				break;
+			}
+		}
+		if (dup) {
+			continue;
+		}
+
+		struct jal_multi_digest_entry *entry = &md->entries[md->count];
+		entry->algorithm = algorithms[i];
+		entry->ctx = jal_digest_ctx_create(algorithms[i]);
+		entry->instance = entry->ctx->create();
+		md->count++;
+		if (!entry->instance) {
+			jal_error_handler(JAL_E_NO_MEM);
+		}
+		if (JAL_OK != entry->ctx->init(entry->instance)) {
+			goto err_out;
+		}
+	}
+	return md;
+
+err_out:
+	jal_multi_digest_destroy(&md);
+	return NULL;
+}
+
+enum jal_status jal_multi_digest_update(struct jal_multi_digest *md,
+		const uint8_t *data, size_t len)
+{
+	if (!md || md->finalized || (!data && len)) {
+		return JAL_E_INVAL;
+	}
+	for (size_t i = 0; i < md->count; i++) {
+		struct jal_multi_digest_entry *entry = &md->entries[i];
+		enum jal_status ret = entry->ctx->update(entry->instance, data, len);
+		if (JAL_OK != ret) {
+			return ret;
+		}
+	}
+	return JAL_OK;
+}
+
+enum jal_status jal_multi_digest_final(struct jal_multi_digest *md)
+{
+	if (!md || md->finalized) {
+		return JAL_E_INVAL;
+	}
+	md->finalized = 1;
+	for (size_t i = 0; i < md->count; i++) {
+		struct jal_multi_digest_entry *entry = &md->entries[i];
+		size_t digest_length = entry->ctx->len;
+		entry->digest = jal_malloc(digest_length);
+		enum jal_status ret = entry->ctx->final(entry->instance, entry->digest, &digest_length);
+		if (JAL_OK != ret) {
+			free(entry->digest);
+			entry->digest = NULL;
+			return ret;
+		}
+	}
+	return JAL_OK;
+}
+
+enum jal_status jal_multi_digest_get(const struct jal_multi_digest *md,
+		enum jal_digest_algorithm algorithm, uint8_t **digest, int *len)
+{
+	if (!md || !digest || *digest || !len) {
+		return JAL_E_INVAL;
+	}
+	for (size_t i = 0; i < md->count; i++) {
+		const struct jal_multi_digest_entry *entry = &md->entries[i];
+		if (entry->algorithm != algorithm) {
+			continue;
+		}
+		if (!entry->digest) {
+			return JAL_E_INVAL;
+		}
+		*digest = jal_malloc(entry->ctx->len);
+		memcpy(*digest, entry->digest, entry->ctx->len);
+		*len = entry->ctx->len;
+		return JAL_OK;
+	}
+	return JAL_E_INVAL;
+}
+
+void jal_multi_digest_destroy(struct jal_multi_digest **md)
+{
+	if (!md || !*md) {
+		return;
+	}
+	for (size_t i = 0; i < (*md)->count; i++) {
+		struct jal_multi_digest_entry *entry = &(*md)->entries[i];
+		if (entry->instance) {
+			entry->ctx->destroy(entry->instance);
+		}
+		jal_digest_ctx_destroy(&entry->ctx);
+		free(entry->digest);
+	}
+	free(*md);
+	*md = NULL;
+}
+
 enum jal_status jal_get_digest_from_str(const char *str, enum jal_digest_algorithm *digest) {
 	for (unsigned long int i = 0; i < sizeof(conversion) / sizeof(conversion[0]); i++) {
 		if (!strcasecmp(str, conversion[i].str)) {
@@ -0,0 +1,249 @@
+/**
+ * @file jal_shm_ring.c This file contains the functions that add frames to
+ * and take frames from the shared memory ring.
+ *
+ * @section LICENSE
+ *
+ * Source code in 3rd-party is licensed and owned by their respective
+ * copyright holders.
+ *
+ * All other source code is copyright Tresys Technology and licensed as below.
+ *
+ * Copyright (c) 2012 Tresys Technology LLC, Columbia, Maryland, USA
+ *
+ * This software was developed by Tresys Technology LLC
+ * with U.S. Government sponsorship.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+#include <jalop/jal_version.h>
+
+#include "jal_shm_ring.h"
+
+static int jal_shm_ring_size_ok(uint64_t size)
+{
+	return size >= JAL_SHM_RING_MIN_SIZE && size <= JAL_SHM_RING_MAX_SIZE &&
+		0 == (size & (size - 1));
+}
+
+size_t jal_shm_ring_map_size(uint64_t size)
+{
+	return JAL_SHM_RING_HEADER_SIZE + size;
+}
+
+uint64_t jal_shm_ring_frame_len(uint64_t data_len, uint64_t meta_len)
+{
+	uint64_t max = JAL_SHM_RING_MAX_SIZE;
+	if (data_len > max || meta_len > max) {
+		return 0;
+	}
+	uint64_t len = JAL_SHM_RING_FRAME_HEADER_LEN + data_len + meta_len +
+		2 * JAL_SHM_RING_BREAK_LEN;
+	return (len + JAL_SHM_RING_ALIGN - 1) & ~((uint64_t) JAL_SHM_RING_ALIGN - 1);
+}
+
+int jal_shm_ring_init(struct jal_shm_ring *ring, void *base, size_t map_len)
+{
+	if (!ring || !base || map_len <= JAL_SHM_RING_HEADER_SIZE ||
+			!jal_shm_ring_size_ok(map_len - JAL_SHM_RING_HEADER_SIZE)) {
+		return -1;
+	}
+
+	struct jal_shm_ring_header *hdr = base;
+	memset(hdr, 0, sizeof(*hdr));
+	hdr->magic = JAL_SHM_RING_MAGIC;
+	hdr->version = JAL_SHM_RING_VERSION;
+	hdr->size = map_len - JAL_SHM_RING_HEADER_SIZE;
+
+	ring->hdr = hdr;
+	ring->data = (uint8_t *) base + JAL_SHM_RING_HEADER_SIZE;
+	ring->size = hdr->size;
+	ring->pos = 0;
+	return 0;
+}
+
+int jal_shm_ring_attach(struct jal_shm_ring *ring, void *base, size_t map_len)
+{
+	if (!ring || !base || map_len <= JAL_SHM_RING_HEADER_SIZE) {
+		return -1;
+	}
+
+	struct jal_shm_ring_header *hdr = base;
+	uint64_t size = map_len - JAL_SHM_RING_HEADER_SIZE;
+	if (JAL_SHM_RING_MAGIC != hdr->magic || JAL_SHM_RING_VERSION != hdr->version ||
+			size != hdr->size || !jal_shm_ring_size_ok(size)) {
+		return -1;
+	}
+
+	ring->hdr = hdr;
+	ring->data = (uint8_t *) base + JAL_SHM_RING_HEADER_SIZE;
+	ring->size = size;
+	ring->pos = __atomic_load_n(&hdr->tail, __ATOMIC_ACQUIRE);
+	if (ring->pos & (JAL_SHM_RING_ALIGN - 1)) {
+		return -1;
+	}
+	return 0;
+}
+
+int jal_shm_ring_reserve(struct jal_shm_ring *ring, uint64_t frame_len, uint8_t **frame)
+{
+	if (!ring || !frame || 0 == frame_len || frame_len > ring->size / 2 ||
+			(frame_len & (JAL_SHM_RING_ALIGN - 1))) {
+		return -1;
+	}
+
+	uint64_t off = ring->pos & (ring->size - 1);
+	uint64_t rest = ring->size - off;
+	uint64_t need = frame_len;
+	if (frame_len > rest) {
+		need += rest;
+	}
+
+	uint64_t used = ring->pos - __atomic_load_n(&ring->hdr->tail, __ATOMIC_SEQ_CST);
+	if (used > ring->size || need > ring->size - used) {
+		return 1;
+	}
+
+	if (frame_len <= rest) {
+		*frame = ring->data + off;
+		return 0;
+	}
+
+	if (rest >= JAL_SHM_RING_FRAME_HEADER_LEN) {
+		uint8_t *pad = ring->data + off;
+		uint16_t version = JPP_VERSION;
+		uint16_t type = JAL_SHM_RING_PAD;
+		uint64_t data_len = rest - JAL_SHM_RING_FRAME_HEADER_LEN;
+		uint64_t meta_len = 0;
+		memcpy(pad, &version, sizeof(version));
+		memcpy(pad + 2, &type, sizeof(type));
+		memcpy(pad + 4, &data_len, sizeof(data_len));
+		memcpy(pad + 12, &meta_len, sizeof(meta_len));
+	}
+	*frame = ring->data;
+	return 0;
+}
+
+int jal_shm_ring_commit(struct jal_shm_ring *ring, uint64_t frame_len)
+{
+	uint64_t rest = ring->size - (ring->pos & (ring->size - 1));
+	if (frame_len > rest) {
+		ring->pos += rest;
+	}
+	ring->pos += frame_len;
+	__atomic_store_n(&ring->hdr->head, ring->pos, __ATOMIC_SEQ_CST);
+	return __atomic_exchange_n(&ring->hdr->consumer_waiting, 0, __ATOMIC_SEQ_CST) ? 1 : 0;
+}
+
+void jal_shm_ring_producer_wait(struct jal_shm_ring *ring)
+{
+	__atomic_store_n(&ring->hdr->producer_waiting, 1, __ATOMIC_SEQ_CST);
+}
+
+int jal_shm_ring_is_drained(struct jal_shm_ring *ring)
+{
+	return ring->pos == __atomic_load_n(&ring->hdr->tail, __ATOMIC_ACQUIRE);
+}
+
+int jal_shm_ring_next(struct jal_shm_ring *ring, uint64_t *pos,
+		struct jal_shm_ring_frame *frame)
+{
+	if (!ring || !pos || !frame) {
+		return -1;
+	}
+
+	uint64_t head = __atomic_load_n(&ring->hdr->head, __ATOMIC_ACQUIRE);
+	if (head - ring->pos > ring->size || *pos - ring->pos > head - ring->pos) {
+		return -1;
+	}
+
+	while (*pos != head) {
+		uint64_t avail = head - *pos;
+		uint64_t off = *pos & (ring->size - 1);
+		uint64_t rest = ring->size - off;
+		if (off & (JAL_SHM_RING_ALIGN - 1)) {
+			return -1;
+		}
+		if (rest < JAL_SHM_RING_FRAME_HEADER_LEN) {
+			if (avail < rest) {
+				return -1;
+			}
+			*pos += rest;
+			continue;
+		}
+		if (avail < JAL_SHM_RING_FRAME_HEADER_LEN) {
+			return -1;
+		}
+
+		// The producer can still write to the frame, so read the
+		// header once and only use the copy.
+		const uint8_t *buf = ring->data + off;
+		uint16_t version;
+		uint16_t type;
+		uint64_t data_len;
+		uint64_t meta_len;
+		memcpy(&version, buf, sizeof(version));
+		memcpy(&type, buf + 2, sizeof(type));
+		memcpy(&data_len, buf + 4, sizeof(data_len));
+		memcpy(&meta_len, buf + 12, sizeof(meta_len));
+
+		if (JAL_SHM_RING_PAD == type) {
+			if (avail < rest || 0 != meta_len ||
+					data_len != rest - JAL_SHM_RING_FRAME_HEADER_LEN) {
+				return -1;
+			}
+			*pos += rest;
+			continue;
+		}
+
+		uint64_t frame_len = jal_shm_ring_frame_len(data_len, meta_len);
+		if (0 == frame_len || frame_len > rest || frame_len > avail) {
+			return -1;
+		}
+		const uint8_t *data = buf + JAL_SHM_RING_FRAME_HEADER_LEN;
+		const uint8_t *meta = data + data_len + JAL_SHM_RING_BREAK_LEN;
+		if (0 != memcmp(data + data_len, JAL_SHM_RING_BREAK_STR, JAL_SHM_RING_BREAK_LEN) ||
+				0 != memcmp(meta + meta_len, JAL_SHM_RING_BREAK_STR, JAL_SHM_RING_BREAK_LEN)) {
+			return -1;
+		}
+
+		frame->protocol_version = version;
+		frame->message_type = type;
+		frame->data = data;
+		frame->data_len = data_len;
+		frame->meta = meta;
+		frame->meta_len = meta_len;
+		*pos += frame_len;
+		return 1;
+	}
+	return 0;
+}
+
+int jal_shm_ring_release(struct jal_shm_ring *ring, uint64_t pos)
+{
+	ring->pos = pos;
+	__atomic_store_n(&ring->hdr->tail, pos, __ATOMIC_SEQ_CST);
+	return __atomic_exchange_n(&ring->hdr->producer_waiting, 0, __ATOMIC_SEQ_CST) ? 1 : 0;
+}
+
+int jal_shm_ring_consumer_wait(struct jal_shm_ring *ring)
+{
+	__atomic_store_n(&ring->hdr->consumer_waiting, 1, __ATOMIC_SEQ_CST);
+	if (ring->pos != __atomic_load_n(&ring->hdr->head, __ATOMIC_SEQ_CST)) {
+		__atomic_store_n(&ring->hdr->consumer_waiting, 0, __ATOMIC_RELAXED);
+		return 0;
+	}
+	return 1;
+}
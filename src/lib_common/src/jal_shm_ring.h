@@ -0,0 +1,218 @@
+/**
+ * @file jal_shm_ring.h This file defines the shared memory ring used by the
+ * producer library and the local store as an alternative to sending records
+ * over the socket.
+ *
+ * @section LICENSE
+ *
+ * Source code in 3rd-party is licensed and owned by their respective
+ * copyright holders.
+ *
+ * All other source code is copyright Tresys Technology and licensed as below.
+ *
+ * Copyright (c) 2012 Tresys Technology LLC, Columbia, Maryland, USA
+ *
+ * This software was developed by Tresys Technology LLC
+ * with U.S. Government sponsorship.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _JAL_SHM_RING_H_
+#define _JAL_SHM_RING_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * The ring lives in a memfd created by the producer. The first
+ * #JAL_SHM_RING_HEADER_SIZE bytes hold a struct jal_shm_ring_header, and
+ * the rest is the data area, whose size is a power of two.
+ *
+ * Each frame in the data area is a message in the same format it has on the
+ * socket: the 20 byte message header, the data, "BREAK", the application
+ * metadata and "BREAK". Frames start on an 8 byte boundary and never wrap
+ * around the end of the data area, so the local store can use them in place.
+ * When a frame does not fit before the end, the producer skips to the start
+ * of the data area, marking the skipped bytes with a header whose message type
+ * is #JAL_SHM_RING_PAD, unless fewer than #JAL_SHM_RING_FRAME_HEADER_LEN bytes
+ * are left. A frame takes at most half the data area, so a frame and the
+ * bytes skipped before it always fit in an empty ring.
+ *
+ * head and tail count bytes since the ring was created. Only the producer
+ * writes head and only the local store writes tail. Each side keeps its own
+ * copy of the position it writes and never trusts the one in shared memory,
+ * so a misbehaving peer can only corrupt its own records.
+ *
+ * Either side sets its waiting flag before it goes to sleep on its eventfd,
+ * and the other side only writes to the eventfd when it sees the flag, so a
+ * busy ring costs no system calls.
+ */
+#define JAL_SHM_RING_MAGIC 0x4a414c52
+#define JAL_SHM_RING_VERSION 1
+#define JAL_SHM_RING_HEADER_SIZE 4096
+#define JAL_SHM_RING_MIN_SIZE (64 * 1024)
+#define JAL_SHM_RING_MAX_SIZE (1024 * 1024 * 1024)
+#define JAL_SHM_RING_ALIGN 8
+#define JAL_SHM_RING_FRAME_HEADER_LEN 20
+#define JAL_SHM_RING_BREAK_STR "BREAK"
+#define JAL_SHM_RING_BREAK_LEN 5
+
+/** The message type of the header that marks skipped bytes */
+#define JAL_SHM_RING_PAD 0
+
+struct jal_shm_ring_header {
+	uint32_t magic;
+	uint32_t version;
+	/** The size of the data area */
+	uint64_t size;
+	/** Written by the producer */
+	uint64_t head __attribute__((aligned(64)));
+	/** Set by the producer while it waits for room */
+	uint32_t producer_waiting;
+	/** Written by the local store */
+	uint64_t tail __attribute__((aligned(64)));
+	/** Set by the local store while it waits for records */
+	uint32_t consumer_waiting;
+};
+
+/** One side's view of a ring */
+struct jal_shm_ring {
+	struct jal_shm_ring_header *hdr;
+	uint8_t *data;
+	uint64_t size;
+	/** head for the producer, tail for the local store */
+	uint64_t pos;
+};
+
+/** A frame found by jal_shm_ring_next(), pointing into the data area */
+struct jal_shm_ring_frame {
+	uint16_t protocol_version;
+	uint16_t message_type;
+	const uint8_t *data;
+	uint64_t data_len;
+	const uint8_t *meta;
+	uint64_t meta_len;
+};
+
+/**
+ * Get the size of a mapping with a data area of \p size bytes.
+ */
+size_t jal_shm_ring_map_size(uint64_t size);
+
+/**
+ * Get the number of bytes a message takes up in the ring.
+ *
+ * @return The frame length, or 0 if it would overflow.
+ */
+uint64_t jal_shm_ring_frame_len(uint64_t data_len, uint64_t meta_len);
+
+/**
+ * Set up a new ring in \p base. Used by the producer.
+ *
+ * @param[out] ring The producer's view.
+ * @param[in] base The start of the mapping.
+ * @param[in] map_len The length of the mapping, which must be
+ * jal_shm_ring_map_size() of a power of two between #JAL_SHM_RING_MIN_SIZE
+ * and #JAL_SHM_RING_MAX_SIZE.
+ *
+ * @return 0 on success, -1 if \p map_len is not usable.
+ */
+int jal_shm_ring_init(struct jal_shm_ring *ring, void *base, size_t map_len);
+
+/**
+ * Check a ring set up by a producer and attach to it. Used by the local
+ * store.
+ *
+ * @param[out] ring The local store's view.
+ * @param[in] base The start of the mapping.
+ * @param[in] map_len The length of the mapping.
+ *
+ * @return 0 on success, -1 if the header does not describe a ring that
+ * fills \p map_len.
+ */
+int jal_shm_ring_attach(struct jal_shm_ring *ring, void *base, size_t map_len);
+
+/**
+ * Find room for a frame of \p frame_len bytes, skipping to the start of the
+ * data area if necessary.
+ *
+ * @param[in] ring The producer's view.
+ * @param[in] frame_len The frame length, from jal_shm_ring_frame_len().
+ * @param[out] frame Where to write the frame.
+ *
+ * @return 0 on success, 1 if there is not enough room yet, or -1 if the
+ * frame is not aligned or is larger than half the data area and can never
+ * fit.
+ */
+int jal_shm_ring_reserve(struct jal_shm_ring *ring, uint64_t frame_len, uint8_t **frame);
+
+/**
+ * Publish the frame written after jal_shm_ring_reserve().
+ *
+ * @return 1 if the local store is waiting and must be woken up, 0 otherwise.
+ */
+int jal_shm_ring_commit(struct jal_shm_ring *ring, uint64_t frame_len);
+
+/**
+ * Get ready to wait for room. Call jal_shm_ring_reserve() once more
+ * afterwards, and only sleep if there is still no room; the local store
+ * then wakes the producer up after it releases frames.
+ */
+void jal_shm_ring_producer_wait(struct jal_shm_ring *ring);
+
+/**
+ * Check whether the local store has released every frame.
+ */
+int jal_shm_ring_is_drained(struct jal_shm_ring *ring);
+
+/**
+ * Find the frame at \p *pos. The frame stays valid until the position is
+ * passed to jal_shm_ring_release().
+ *
+ * @param[in] ring The local store's view.
+ * @param[in,out] pos Where to look, which starts out as ring->pos. Moved
+ * past the frame.
+ * @param[out] frame The frame.
+ *
+ * @return 1 if a frame was found, 0 if there are no more, or -1 if the ring
+ * is corrupt.
+ */
+int jal_shm_ring_next(struct jal_shm_ring *ring, uint64_t *pos,
+		struct jal_shm_ring_frame *frame);
+
+/**
+ * Hand every frame before \p pos back to the producer.
+ *
+ * @return 1 if the producer is waiting and must be woken up, 0 otherwise.
+ */
+int jal_shm_ring_release(struct jal_shm_ring *ring, uint64_t pos);
+
+/**
+ * Get ready to wait for frames. When this returns 1, the producer will wake
+ * the local store up after it commits a frame.
+ *
+ * @return 1 if the local store may sleep, 0 if the producer committed
+ * frames in the meantime.
+ */
+int jal_shm_ring_consumer_wait(struct jal_shm_ring *ring);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _JAL_SHM_RING_H_
@@ -383,37 +383,190 @@ xmlNodePtr jal_get_first_element_child(xmlNodePtr elem)
 	return child;
 }
 
+#if OPENSSL_VERSION_NUMBER < 0x10100000L
 /*
  * xmlSecDSigCtxSign() is not documented as not being threadsafe, but a user
  * observed it crashing under load.  Wrapping it in a mutex seems to address
- * this issue.
+ * this issue. OpenSSL 1.1 and later do their own locking, and every signing
+ * context has its own copy of the key, so signing only needs to be
+ * serialized with older versions.
  */
 static pthread_mutex_t xmlsec_sign_lock = PTHREAD_MUTEX_INITIALIZER;
+#define JAL_XMLSEC_SIGN_LOCK() pthread_mutex_lock(&xmlsec_sign_lock)
+#define JAL_XMLSEC_SIGN_UNLOCK() pthread_mutex_unlock(&xmlsec_sign_lock)
+#else
+#define JAL_XMLSEC_SIGN_LOCK() do {} while (0)
+#define JAL_XMLSEC_SIGN_UNLOCK() do {} while (0)
+#endif
 
-enum jal_status jal_add_signature_block(
-		RSA *rsa,
-		X509 *x509,
-		xmlDocPtr doc,
-		xmlNodePtr last,
-		const char *id)
+/**
+ * A signing key loaded into xmlsec, ready to sign with. Loading one means
+ * copying the RSA key and parsing the certificate, so they are kept in
+ * jal_sign_pool and reused.
+ */
+struct jal_sign_ctx {
+	xmlSecKeyPtr key;
+	struct jal_sign_ctx *next;
+};
+
+struct jal_sign_pool {
+	pthread_mutex_t lock;
+	RSA *rsa;			//!< The pool's own copy of the signing key
+	X509 *x509;			//!< The certificate, may be NULL
+	struct jal_sign_ctx *free_ctxs;	//!< Contexts not in use, protected by lock
+};
+
+static struct jal_sign_ctx *jal_sign_ctx_create(struct jal_sign_pool *pool)
 {
-	if (!doc || !rsa || !id) {
-		return JAL_E_INVAL;
+	xmlSecKeyDataPtr key_data = NULL;
+	xmlSecKeyPtr key = NULL;
+	EVP_PKEY *pkey = NULL;
+	BIO *bio = NULL;
+	struct jal_sign_ctx *ctx = NULL;
+
+	// Each context gets its own copy of the key so that threads signing
+	// at the same time don't share any OpenSSL state.
+	RSA *rsa = RSAPrivateKey_dup(pool->rsa);
+	if (!rsa) {
+		goto out;
+	}
+	pkey = EVP_PKEY_new();
+	if (!pkey || !EVP_PKEY_assign_RSA(pkey, rsa)) {
+		goto out;
+	}
+	rsa = NULL;
+	key_data = xmlSecOpenSSLEvpKeyAdopt(pkey);
+	if (!key_data) {
+		goto out;
+	}
+	pkey = NULL;
+
+	key = xmlSecKeyCreate();
+	if (!key) {
+		goto out;
+	}
+	if (0 != xmlSecKeySetValue(key, key_data)) {
+		goto out;
+	}
+	key_data = NULL;
+
+	if (pool->x509) {
+		bio = BIO_new(BIO_s_mem());
+		if (!bio || !PEM_write_bio_X509(bio, pool->x509)) {
+			goto out;
+		}
+		if (0 > xmlSecOpenSSLAppKeyCertLoadBIO(key, bio, xmlSecKeyDataFormatCertPem)) {
+			goto out;
+		}
+	}
+
+	ctx = jal_calloc(1, sizeof(*ctx));
+	ctx->key = key;
+	key = NULL;
+out:
+	if (bio) {
+		BIO_free(bio);
+	}
+	if (key) {
+		xmlSecKeyDestroy(key);
+	}
+	if (key_data) {
+		xmlSecKeyDataDestroy(key_data);
+	}
+	EVP_PKEY_free(pkey);
+	RSA_free(rsa);
+	return ctx;
+}
+
+static void jal_sign_ctx_destroy(struct jal_sign_ctx **pctx)
+{
+	if (!pctx || !*pctx) {
+		return;
+	}
+	xmlSecKeyDestroy((*pctx)->key);
+	free(*pctx);
+	*pctx = NULL;
+}
+
+struct jal_sign_pool *jal_sign_pool_create(RSA *rsa, X509 *x509)
+{
+	if (!rsa) {
+		return NULL;
 	}
+	struct jal_sign_pool *pool = jal_calloc(1, sizeof(*pool));
+	pool->rsa = RSAPrivateKey_dup(rsa);
+	if (!pool->rsa) {
+		free(pool);
+		return NULL;
+	}
+	if (x509) {
+		X509_up_ref(x509);
+		pool->x509 = x509;
+	}
+	pthread_mutex_init(&pool->lock, NULL);
+	return pool;
+}
+
+void jal_sign_pool_destroy(struct jal_sign_pool **ppool)
+{
+	if (!ppool || !*ppool) {
+		return;
+	}
+	struct jal_sign_pool *pool = *ppool;
+	while (pool->free_ctxs) {
+		struct jal_sign_ctx *ctx = pool->free_ctxs;
+		pool->free_ctxs = ctx->next;
+		jal_sign_ctx_destroy(&ctx);
+	}
+	RSA_free(pool->rsa);
+	X509_free(pool->x509);
+	pthread_mutex_destroy(&pool->lock);
+	free(pool);
+	*ppool = NULL;
+}
 
+/*
+ * Take a context that isn't in use, or load a new one if every context is
+ * in use. The pool grows to the number of threads that sign at once.
+ */
+static struct jal_sign_ctx *jal_sign_pool_acquire(struct jal_sign_pool *pool)
+{
+	pthread_mutex_lock(&pool->lock);
+	struct jal_sign_ctx *ctx = pool->free_ctxs;
+	if (ctx) {
+		pool->free_ctxs = ctx->next;
+		ctx->next = NULL;
+	}
+	pthread_mutex_unlock(&pool->lock);
+
+	if (!ctx) {
+		ctx = jal_sign_ctx_create(pool);
+	}
+	return ctx;
+}
+
+static void jal_sign_pool_release(struct jal_sign_pool *pool, struct jal_sign_ctx *ctx)
+{
+	pthread_mutex_lock(&pool->lock);
+	ctx->next = pool->free_ctxs;
+	pool->free_ctxs = ctx;
+	pthread_mutex_unlock(&pool->lock);
+}
+
+/*
+ * Add the signature template, which says what to sign and how, to the
+ * document. Returns the Signature node, or NULL on error.
+ */
+static xmlNodePtr jal_add_signature_template(
+		xmlDocPtr doc,
+		xmlNodePtr last,
+		const char *id,
+		int with_cert)
+{
 	xmlNodePtr signNode = NULL;
 	xmlNodePtr refNode = NULL;
 	xmlNodePtr keyInfoNode = NULL;
 	xmlNodePtr x509DataNode = NULL;
-	xmlNodePtr x509IssuerSerialNode = NULL;
-	xmlSecDSigCtxPtr dsigCtx = NULL;
-
-	RSA *new_rsa = RSAPrivateKey_dup(rsa);
-	if (!new_rsa) {
-		return JAL_E_INVAL;
-	}
-
-	enum jal_status ret = JAL_E_INVAL;
 
 	signNode = xmlSecTmplSignatureCreate(
 				doc,
@@ -422,7 +575,7 @@ enum jal_status jal_add_signature_block(
 				NULL);
 
 	if (!signNode) {
-		goto done;
+		return NULL;
 	}
 
 	if (last) {
@@ -440,7 +593,7 @@ enum jal_status jal_add_signature_block(
 	strncat(reference_uri, JAL_XML_XPOINTER_ID_BEG, beg_len);
 	strncat(reference_uri, id, id_len);
 	strncat(reference_uri, JAL_XML_XPOINTER_ID_END, end_len);
-	
+
 	refNode = xmlSecTmplSignatureAddReference(signNode,
 						xmlSecOpenSSLTransformSha256Id,
 						NULL, // id
@@ -448,89 +601,106 @@ enum jal_status jal_add_signature_block(
 						NULL);// type
 	free(reference_uri);
 	if (!refNode) {
-		ret = JAL_E_INVAL;
-		goto done;
+		return NULL;
 	}
 
 	if (!xmlSecTmplReferenceAddTransform(refNode, xmlSecTransformEnvelopedId)) {
-		goto done;
+		return NULL;
 	}
-	
+
 	keyInfoNode = xmlSecTmplSignatureEnsureKeyInfo(signNode, NULL);
 	if (!keyInfoNode) {
-		goto done;
+		return NULL;
 	}
 
 	if (!xmlSecTmplKeyInfoAddKeyValue(keyInfoNode)) {
-		goto done;
-	}
-
-	xmlSecKeyDataPtr pKeyData = NULL;
-	pKeyData = xmlSecKeyDataCreate(xmlSecKeyDataRsaId);
-
-	if (0 != xmlSecOpenSSLKeyDataRsaAdoptRsa(pKeyData, new_rsa)) {
-		goto done;
-	}
-
-	xmlSecKeyPtr pSecKey = xmlSecKeyCreate();
-	if (!pSecKey) {
-		goto done;
-	}
-	
-	if (0 != xmlSecKeySetValue(pSecKey, pKeyData)) {
-		goto done;
+		return NULL;
 	}
 
-    	dsigCtx = xmlSecDSigCtxCreate(NULL);
-    	if (!dsigCtx) {
-		goto done;
-    	}
-	
-	dsigCtx->signKey = pSecKey;
-
 	// add certificate information, if available
-	if (x509) {
+	if (with_cert) {
 		x509DataNode = xmlSecTmplKeyInfoAddX509Data(keyInfoNode);
 		if (!x509DataNode) {
-			goto done;
+			return NULL;
 		}
 
 		if (!xmlSecTmplX509DataAddSubjectName(x509DataNode)) {
-			goto done;
+			return NULL;
 		}
 
-		x509IssuerSerialNode = xmlSecTmplX509DataAddIssuerSerial(x509DataNode);
-		if (!x509IssuerSerialNode) {
-			goto done;
+		if (!xmlSecTmplX509DataAddIssuerSerial(x509DataNode)) {
+			return NULL;
 		}
 
 		if (!xmlSecTmplX509DataAddCertificate(x509DataNode)) {
-			goto done;
+			return NULL;
 		}
+	}
 
-		BIO *bio = BIO_new(BIO_s_mem());
-		PEM_write_bio_X509(bio, x509);
-		if (0 > xmlSecOpenSSLAppKeyCertLoadBIO(dsigCtx->signKey,
-						bio,
-						xmlSecKeyDataFormatCertPem)) {
-			goto done;
-		}
-		BIO_free(bio);
+	return signNode;
+}
+
+enum jal_status jal_sign_pool_add_signature_block(
+		struct jal_sign_pool *pool,
+		xmlDocPtr doc,
+		xmlNodePtr last,
+		const char *id)
+{
+	if (!pool || !doc || !id) {
+		return JAL_E_INVAL;
 	}
 
-	pthread_mutex_lock(&xmlsec_sign_lock);
-	if (0 > xmlSecDSigCtxSign(dsigCtx, signNode)) {
-		pthread_mutex_unlock(&xmlsec_sign_lock);
-		goto done;
+	xmlNodePtr signNode = jal_add_signature_template(doc, last, id, NULL != pool->x509);
+	if (!signNode) {
+		return JAL_E_INVAL;
+	}
+
+	struct jal_sign_ctx *ctx = jal_sign_pool_acquire(pool);
+	if (!ctx) {
+		return JAL_E_INVAL;
+	}
+
+	enum jal_status ret = JAL_E_INVAL;
+	xmlSecDSigCtx dsigCtx;
+	if (0 != xmlSecDSigCtxInitialize(&dsigCtx, NULL)) {
+		goto out;
+	}
+	// The key is lent to the xmlsec context, take it back before the
+	// context is finalized so it isn't destroyed.
+	dsigCtx.signKey = ctx->key;
+
+	JAL_XMLSEC_SIGN_LOCK();
+	int sign_ret = xmlSecDSigCtxSign(&dsigCtx, signNode);
+	JAL_XMLSEC_SIGN_UNLOCK();
+
+	dsigCtx.signKey = NULL;
+	xmlSecDSigCtxFinalize(&dsigCtx);
+	if (0 > sign_ret) {
+		goto out;
 	}
-	pthread_mutex_unlock(&xmlsec_sign_lock);
 
 	ret = JAL_OK;
-done:
-	/* cleanup */
-	if (dsigCtx != NULL) {
-		xmlSecDSigCtxDestroy(dsigCtx);
+out:
+	jal_sign_pool_release(pool, ctx);
+	return ret;
+}
+
+enum jal_status jal_add_signature_block(
+		RSA *rsa,
+		X509 *x509,
+		xmlDocPtr doc,
+		xmlNodePtr last,
+		const char *id)
+{
+	if (!doc || !rsa || !id) {
+		return JAL_E_INVAL;
 	}
 
+	struct jal_sign_pool *pool = jal_sign_pool_create(rsa, x509);
+	if (!pool) {
+		return JAL_E_INVAL;
+	}
+	enum jal_status ret = jal_sign_pool_add_signature_block(pool, doc, last, id);
+	jal_sign_pool_destroy(&pool);
 	return ret;
 }
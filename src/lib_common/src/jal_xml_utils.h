@@ -195,8 +195,56 @@ enum jal_status jal_digest_arbitrary_data(
  */
 xmlNodePtr jal_get_first_element_child(xmlNodePtr elem);
 
+/**
+ * A pool of signing contexts for one key and certificate. The key and
+ * certificate are loaded into xmlsec once per context instead of once per
+ * signature, and each thread signing at the same time uses its own context.
+ * A pool may be shared by any number of threads.
+ */
+struct jal_sign_pool;
+
+/**
+ * Create a signing context pool.
+ *
+ * @param[in] rsa RSA key to use as a signing key.  This is required. The
+ * pool keeps its own copy.
+ * @param[in] x509 Certificate to use when signing.  This is not required
+ * and could be passed in as NULL. The pool keeps a reference to it.
+ *
+ * @return the new pool, or NULL on error.
+ */
+struct jal_sign_pool *jal_sign_pool_create(RSA *rsa, X509 *x509);
+
+/**
+ * Destroy a signing context pool. No thread may be signing with it.
+ *
+ * @param[in,out] pool The pool to destroy, set to NULL.
+ */
+void jal_sign_pool_destroy(struct jal_sign_pool **pool);
+
+/**
+ * Add a signature block to a document, signing with a context from \p pool.
+ *
+ * @param[in] pool The signing context pool.
+ * @param[in] doc The document to sign.
+ * @param[in] last The element to add the signature before.  Pass in
+ * NULL to have the signature element added as the last element under
+ * parent_element.
+ * @param[in] id The id to use in the Reference elements URI attribute.
+ * This should be the id of the root node in the document.
+ *
+ * @return JAL_OK,  or JAL_E_INVAL on error
+ */
+enum jal_status jal_sign_pool_add_signature_block(
+		struct jal_sign_pool *pool,
+		xmlDocPtr doc,
+		xmlNodePtr last,
+		const char *id);
+
 /**
  * Add a signature block to a document.
+ * This loads the key for just this signature, callers that sign many
+ * documents with the same key should use a jal_sign_pool instead.
  *
  * @param[in] rsa RSA key to use as a signing key.  This is required.
  * @param[in] x509 Certificate to use when signing.  This is not required
@@ -1039,4 +1039,74 @@ void test_jal_get_digest_from_uri()
 	assert_equals(JAL_DIGEST_ALGORITHM_SHA384, digest_algorithm);
 	jal_get_digest_from_uri(JAL_SHA512_ALGORITHM_URI, &digest_algorithm);
 	assert_equals(JAL_DIGEST_ALGORITHM_SHA512, digest_algorithm);
-}
\ No newline at end of file
+}
+void test_jal_multi_digest_create_returns_null_on_bad_input()
+{
+	enum jal_digest_algorithm algs[] = { JAL_DIGEST_ALGORITHM_SHA256, JAL_DIGEST_ALGORITHM_COUNT };
+	assert_equals((void *) NULL, jal_multi_digest_create(NULL, 1));
+	assert_equals((void *) NULL, jal_multi_digest_create(algs, 0));
+	assert_equals((void *) NULL, jal_multi_digest_create(algs, 2));
+}
+
+void test_jal_multi_digest_computes_all_algorithms_in_one_pass()
+{
+	enum jal_digest_algorithm algs[] = { JAL_DIGEST_ALGORITHM_SHA512,
+		JAL_DIGEST_ALGORITHM_SHA256, JAL_DIGEST_ALGORITHM_SHA384 };
+	struct jal_multi_digest *md = jal_multi_digest_create(algs, 3);
+	assert_not_equals((void *) NULL, md);
+
+	// Feed the input in two pieces to make sure the state carries over.
+	assert_equals(JAL_OK, jal_multi_digest_update(md, (uint8_t *)HELLO_WORLD, 5));
+	assert_equals(JAL_OK, jal_multi_digest_update(md, (uint8_t *)HELLO_WORLD + 5, strlen(HELLO_WORLD) - 5));
+	assert_equals(JAL_OK, jal_multi_digest_final(md));
+
+	for (int i = 0; i < JAL_DIGEST_ALGORITHM_COUNT; i++) {
+		uint8_t *data = NULL;
+		int len = 0;
+		assert_equals(JAL_OK, jal_multi_digest_get(md, (enum jal_digest_algorithm) i, &data, &len));
+		assert_equals(get_digest_length(i), len);
+		char buf[(len * 2) + 1];
+		for (int j = 0; j < len; j++) {
+			sprintf(buf + (j * 2), "%02x", data[j]);
+		}
+		buf[(len * 2)] = 0;
+		assert_string_equals(get_digest_sum(i), buf);
+		free(data);
+	}
+	jal_multi_digest_destroy(&md);
+	assert_equals((void *) NULL, md);
+}
+
+void test_jal_multi_digest_ignores_duplicates()
+{
+	enum jal_digest_algorithm algs[] = { JAL_DIGEST_ALGORITHM_SHA256, JAL_DIGEST_ALGORITHM_SHA256 };
+	struct jal_multi_digest *md = jal_multi_digest_create(algs, 2);
+	uint8_t *data = NULL;
+	int len = 0;
+
+	assert_not_equals((void *) NULL, md);
+	assert_equals(JAL_OK, jal_multi_digest_update(md, (uint8_t *)HELLO_WORLD, strlen(HELLO_WORLD)));
+	assert_equals(JAL_OK, jal_multi_digest_final(md));
+	assert_equals(JAL_OK, jal_multi_digest_get(md, JAL_DIGEST_ALGORITHM_SHA256, &data, &len));
+	assert_equals(SHA256_DIGEST_LENGTH, len);
+	free(data);
+	data = NULL;
+	assert_equals(JAL_E_INVAL, jal_multi_digest_get(md, JAL_DIGEST_ALGORITHM_SHA384, &data, &len));
+	jal_multi_digest_destroy(&md);
+}
+
+void test_jal_multi_digest_get_fails_before_final()
+{
+	enum jal_digest_algorithm algs[] = { JAL_DIGEST_ALGORITHM_SHA256 };
+	struct jal_multi_digest *md = jal_multi_digest_create(algs, 1);
+	uint8_t *data = NULL;
+	int len = 0;
+
+	assert_equals(JAL_E_INVAL, jal_multi_digest_get(md, JAL_DIGEST_ALGORITHM_SHA256, &data, &len));
+	assert_equals(JAL_OK, jal_multi_digest_final(md));
+	assert_equals(JAL_E_INVAL, jal_multi_digest_update(md, (uint8_t *)HELLO_WORLD, strlen(HELLO_WORLD)));
+	assert_equals(JAL_E_INVAL, jal_multi_digest_final(md));
+	jal_multi_digest_destroy(&md);
+	jal_multi_digest_destroy(&md);
+	jal_multi_digest_destroy(NULL);
+}
@@ -0,0 +1,233 @@
+/**
+ * @file test_jal_shm_ring.c This file contains tests for jal_shm_ring.c
+ * functions.
+ *
+ * @section LICENSE
+ *
+ * Source code in 3rd-party is licensed and owned by their respective
+ * copyright holders.
+ *
+ * All other source code is copyright Tresys Technology and licensed as below.
+ *
+ * Copyright (c) 2012 Tresys Technology LLC, Columbia, Maryland, USA
+ *
+ * This software was developed by Tresys Technology LLC
+ * with U.S. Government sponsorship.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <test-dept.h>
+#include <jalop/jal_version.h>
+
+#include "jal_shm_ring.h"
+
+#define RING_SIZE JAL_SHM_RING_MIN_SIZE
+#define MAP_LEN (JAL_SHM_RING_HEADER_SIZE + RING_SIZE)
+
+static void *base;
+static struct jal_shm_ring producer;
+static struct jal_shm_ring consumer;
+
+static uint64_t put(const char *data, uint64_t data_len, const char *meta, uint64_t meta_len)
+{
+	uint8_t *frame = NULL;
+	uint64_t frame_len = jal_shm_ring_frame_len(data_len, meta_len);
+	uint16_t version = JPP_VERSION;
+	uint16_t type = 1;
+
+	assert_equals(0, jal_shm_ring_reserve(&producer, frame_len, &frame));
+	memcpy(frame, &version, sizeof(version));
+	memcpy(frame + 2, &type, sizeof(type));
+	memcpy(frame + 4, &data_len, sizeof(data_len));
+	memcpy(frame + 12, &meta_len, sizeof(meta_len));
+	uint8_t *p = frame + JAL_SHM_RING_FRAME_HEADER_LEN;
+	memcpy(p, data, data_len);
+	p += data_len;
+	memcpy(p, JAL_SHM_RING_BREAK_STR, JAL_SHM_RING_BREAK_LEN);
+	p += JAL_SHM_RING_BREAK_LEN;
+	memcpy(p, meta, meta_len);
+	p += meta_len;
+	memcpy(p, JAL_SHM_RING_BREAK_STR, JAL_SHM_RING_BREAK_LEN);
+	jal_shm_ring_commit(&producer, frame_len);
+	return frame_len;
+}
+
+void setup()
+{
+	base = calloc(1, MAP_LEN);
+	assert_equals(0, jal_shm_ring_init(&producer, base, MAP_LEN));
+	assert_equals(0, jal_shm_ring_attach(&consumer, base, MAP_LEN));
+}
+
+void teardown()
+{
+	free(base);
+}
+
+void test_frame_len_is_aligned()
+{
+	assert_equals(32, jal_shm_ring_frame_len(0, 0));
+	assert_equals(32, jal_shm_ring_frame_len(2, 0));
+	assert_equals(40, jal_shm_ring_frame_len(1, 2));
+	assert_equals(0, jal_shm_ring_frame_len(UINT64_MAX, 0));
+	assert_equals(0, jal_shm_ring_frame_len(0, UINT64_MAX));
+}
+
+void test_init_fails_with_bad_sizes()
+{
+	struct jal_shm_ring ring;
+	assert_equals(-1, jal_shm_ring_init(NULL, base, MAP_LEN));
+	assert_equals(-1, jal_shm_ring_init(&ring, NULL, MAP_LEN));
+	assert_equals(-1, jal_shm_ring_init(&ring, base, JAL_SHM_RING_HEADER_SIZE));
+	assert_equals(-1, jal_shm_ring_init(&ring, base, MAP_LEN - 8));
+	assert_equals(-1, jal_shm_ring_init(&ring, base,
+			jal_shm_ring_map_size(JAL_SHM_RING_MIN_SIZE / 2)));
+}
+
+void test_attach_fails_with_bad_header()
+{
+	struct jal_shm_ring ring;
+	struct jal_shm_ring_header *hdr = base;
+
+	assert_equals(-1, jal_shm_ring_attach(&ring, base, MAP_LEN - 8));
+	assert_equals(-1, jal_shm_ring_attach(&ring, base, jal_shm_ring_map_size(RING_SIZE / 2)));
+
+	hdr->magic++;
+	assert_equals(-1, jal_shm_ring_attach(&ring, base, MAP_LEN));
+	hdr->magic--;
+	hdr->version++;
+	assert_equals(-1, jal_shm_ring_attach(&ring, base, MAP_LEN));
+	hdr->version--;
+	hdr->size *= 2;
+	assert_equals(-1, jal_shm_ring_attach(&ring, base, MAP_LEN));
+	hdr->size /= 2;
+	hdr->tail = 3;
+	assert_equals(-1, jal_shm_ring_attach(&ring, base, MAP_LEN));
+}
+
+void test_frames_are_read_in_place_in_order()
+{
+	struct jal_shm_ring_frame frame;
+	uint64_t pos = consumer.pos;
+
+	assert_equals(0, jal_shm_ring_next(&consumer, &pos, &frame));
+	put("first", 5, "", 0);
+	put("second", 6, "meta", 4);
+
+	assert_equals(1, jal_shm_ring_next(&consumer, &pos, &frame));
+	assert_equals(JPP_VERSION, frame.protocol_version);
+	assert_equals(1, frame.message_type);
+	assert_equals(5, frame.data_len);
+	assert_equals(0, frame.meta_len);
+	assert_equals(0, memcmp("first", frame.data, 5));
+	assert_true(frame.data > consumer.data && frame.data < consumer.data + RING_SIZE);
+
+	assert_equals(1, jal_shm_ring_next(&consumer, &pos, &frame));
+	assert_equals(6, frame.data_len);
+	assert_equals(4, frame.meta_len);
+	assert_equals(0, memcmp("second", frame.data, 6));
+	assert_equals(0, memcmp("meta", frame.meta, 4));
+
+	assert_equals(0, jal_shm_ring_next(&consumer, &pos, &frame));
+	assert_false(jal_shm_ring_is_drained(&producer));
+	jal_shm_ring_release(&consumer, pos);
+	assert_true(jal_shm_ring_is_drained(&producer));
+}
+
+void test_reserve_waits_for_room_and_wraps()
+{
+	struct jal_shm_ring_frame frame;
+	uint8_t *where = NULL;
+	char rec[RING_SIZE / 4];
+	uint64_t frame_len = jal_shm_ring_frame_len(sizeof(rec), 0);
+	uint64_t pos = consumer.pos;
+
+	memset(rec, 'x', sizeof(rec));
+	for (int i = 0; i < 3; i++) {
+		put(rec, sizeof(rec), "", 0);
+	}
+	// The fourth does not fit before the end of the data area
+	assert_equals(1, jal_shm_ring_reserve(&producer, frame_len, &where));
+
+	assert_equals(1, jal_shm_ring_next(&consumer, &pos, &frame));
+	assert_equals(1, jal_shm_ring_next(&consumer, &pos, &frame));
+	jal_shm_ring_release(&consumer, pos);
+
+	put(rec, sizeof(rec), "", 0);
+	assert_equals(1, jal_shm_ring_next(&consumer, &pos, &frame));
+	// Skips the padding at the end
+	assert_equals(1, jal_shm_ring_next(&consumer, &pos, &frame));
+	assert_true(frame.data == consumer.data + JAL_SHM_RING_FRAME_HEADER_LEN);
+	assert_equals(0, jal_shm_ring_next(&consumer, &pos, &frame));
+	jal_shm_ring_release(&consumer, pos);
+	assert_true(jal_shm_ring_is_drained(&producer));
+}
+
+void test_reserve_fails_for_frames_that_never_fit()
+{
+	uint8_t *where = NULL;
+	assert_equals(-1, jal_shm_ring_reserve(&producer, RING_SIZE / 2 + 8, &where));
+	assert_equals(-1, jal_shm_ring_reserve(&producer, 0, &where));
+	assert_equals(-1, jal_shm_ring_reserve(&producer, 44, &where));
+	assert_equals(0, jal_shm_ring_reserve(&producer, RING_SIZE / 2, &where));
+}
+
+void test_next_fails_with_corrupt_frames()
+{
+	struct jal_shm_ring_frame frame;
+	uint64_t pos = consumer.pos;
+	uint64_t huge = RING_SIZE;
+
+	put("first", 5, "", 0);
+	memcpy(consumer.data + 4, &huge, sizeof(huge));
+	assert_equals(-1, jal_shm_ring_next(&consumer, &pos, &frame));
+
+	pos = consumer.pos;
+	huge = 5;
+	memcpy(consumer.data + 4, &huge, sizeof(huge));
+	consumer.data[JAL_SHM_RING_FRAME_HEADER_LEN + 5] = 'X';
+	assert_equals(-1, jal_shm_ring_next(&consumer, &pos, &frame));
+
+	// A head the producer could not have written
+	pos = consumer.pos;
+	producer.hdr->head = RING_SIZE + 8;
+	assert_equals(-1, jal_shm_ring_next(&consumer, &pos, &frame));
+}
+
+void test_waiting_sides_are_woken_once()
+{
+	uint8_t *where = NULL;
+	uint64_t frame_len = jal_shm_ring_frame_len(5, 0);
+
+	// Nobody is waiting yet
+	assert_equals(0, jal_shm_ring_reserve(&producer, frame_len, &where));
+	assert_equals(0, jal_shm_ring_commit(&producer, frame_len));
+
+	// The local store must not sleep while frames are pending
+	assert_equals(0, jal_shm_ring_consumer_wait(&consumer));
+	assert_equals(0, jal_shm_ring_release(&consumer, producer.pos));
+	assert_equals(1, jal_shm_ring_consumer_wait(&consumer));
+
+	assert_equals(0, jal_shm_ring_reserve(&producer, frame_len, &where));
+	assert_equals(1, jal_shm_ring_commit(&producer, frame_len));
+	assert_equals(0, jal_shm_ring_reserve(&producer, frame_len, &where));
+	assert_equals(0, jal_shm_ring_commit(&producer, frame_len));
+
+	jal_shm_ring_producer_wait(&producer);
+	assert_equals(1, jal_shm_ring_release(&consumer, producer.pos));
+	assert_equals(0, jal_shm_ring_release(&consumer, producer.pos));
+}
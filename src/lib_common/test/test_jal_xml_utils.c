@@ -917,6 +917,87 @@ void test_add_signature_works_without_cert()
 	assert_equals((void*) NULL, x509_data);
 }
 
+static xmlChar *get_signature_value()
+{
+	xmlNodePtr sig_node = doc->children->last;
+	xmlNodePtr signed_info = jal_get_first_element_child(sig_node);
+	xmlNodePtr sig_value = get_next_element(signed_info);
+	assert_not_equals((void*) NULL, sig_value);
+	assert_tag_equals("SignatureValue", sig_value);
+	return xmlNodeGetContent(sig_value);
+}
+
+void test_sign_pool_signs_like_add_signature_block()
+{
+	load_key_and_cert();
+	build_dom_for_signing();
+	assert_equals(JAL_OK, jal_add_signature_block(key, cert, doc, NULL, id_val));
+	xmlChar *expected = get_signature_value();
+
+	struct jal_sign_pool *pool = jal_sign_pool_create(key, cert);
+	assert_not_equals((void*) NULL, pool);
+
+	// The second signature reuses the context loaded for the first
+	for (int i = 0; i < 2; i++) {
+		xmlFreeDoc(doc);
+		doc = xmlNewDoc((xmlChar *)"1.0");
+		build_dom_for_signing();
+		assert_equals(JAL_OK, jal_sign_pool_add_signature_block(pool, doc, NULL, id_val));
+
+		xmlNodePtr sig_node = doc->children->last;
+		assert_tag_equals("Signature", sig_node);
+		xmlChar *actual = get_signature_value();
+		assert_string_equals((char *) expected, (char *) actual);
+		xmlFree(actual);
+	}
+
+	jal_sign_pool_destroy(&pool);
+	assert_equals((void*) NULL, pool);
+	xmlFree(expected);
+}
+
+void test_sign_pool_works_with_prev()
+{
+	load_key_and_cert();
+	build_dom_for_signing();
+
+	struct jal_sign_pool *pool = jal_sign_pool_create(key, NULL);
+	assert_not_equals((void*) NULL, pool);
+	assert_equals(JAL_OK, jal_sign_pool_add_signature_block(pool, doc, doc->children->last, id_val));
+
+	xmlNodePtr elm2 = doc->children->last;
+	assert_tag_equals("bchild", elm2);
+	assert_tag_equals("Signature", elm2->prev);
+
+	jal_sign_pool_destroy(&pool);
+}
+
+void test_sign_pool_create_fails_without_key()
+{
+	load_key_and_cert();
+	assert_equals((void*) NULL, jal_sign_pool_create(NULL, cert));
+}
+
+void test_sign_pool_destroy_does_not_crash_on_null()
+{
+	struct jal_sign_pool *pool = NULL;
+	jal_sign_pool_destroy(NULL);
+	jal_sign_pool_destroy(&pool);
+}
+
+void test_sign_pool_add_signature_block_fails_with_bad_input()
+{
+	load_key_and_cert();
+	build_dom_for_signing();
+	struct jal_sign_pool *pool = jal_sign_pool_create(key, cert);
+
+	assert_equals(JAL_E_INVAL, jal_sign_pool_add_signature_block(NULL, doc, NULL, id_val));
+	assert_equals(JAL_E_INVAL, jal_sign_pool_add_signature_block(pool, NULL, NULL, id_val));
+	assert_equals(JAL_E_INVAL, jal_sign_pool_add_signature_block(pool, doc, NULL, NULL));
+
+	jal_sign_pool_destroy(&pool);
+}
+
 void test_get_first_element_child_returns_NULL_on_NULL_input()
 {
 	assert_equals((void*) NULL, jal_get_first_element_child(NULL));
@@ -74,7 +74,9 @@
 #include "jalls_handler.h"
 #include "jalls_msg.h"
 #include "jalls_init.h"
+#include "jalls_worker_pool.h"
 #include "jal_alloc.h"
+#include "jal_xml_utils.h"
 
 #define JALLS_LISTEN_BACKLOG 20
 #define JALLS_ERRNO_MSG_SIZE 1024
@@ -123,6 +125,7 @@ int main(int argc, char **argv) {
 	FILE *fp;
 	RSA *key = NULL;
 	X509 *cert = NULL;
+	struct jal_sign_pool *signing_pool = NULL;
 	jaldb_context *db_ctx = NULL;
 	struct jalls_context *jalls_ctx = NULL;
 	enum jal_status jal_err = JAL_E_INVAL;
@@ -196,6 +199,12 @@ int main(int argc, char **argv) {
 			fprintf(stderr, "failed to read private key\n");
 			goto err_out;
 		}
+		// The system metadata is signed without the certificate
+		signing_pool = jal_sign_pool_create(key, NULL);
+		if (!signing_pool) {
+			fprintf(stderr, "failed to load private key for signing\n");
+			goto err_out;
+		}
 	}
 
 	//load the public cert
@@ -242,6 +251,9 @@ int main(int argc, char **argv) {
 	else{
 	    dfprintf(stderr, "Not setting DB_RECOVER flag.\n");
 	}
+	if (jalls_ctx->time_ordered_keys) {
+		db_flags |= JDB_TIME_ORDERED_KEYS;
+	}
 	jal_err = jaldb_context_init(db_ctx, jalls_ctx->db_root, db_flags);
 
 	if (jal_err != JAL_OK) {
@@ -249,6 +261,12 @@ int main(int argc, char **argv) {
 		goto err_out;
 	}
 
+	if (JALDB_OK != jaldb_enable_group_commit(db_ctx, jalls_ctx->group_commit_max_records,
+			jalls_ctx->group_commit_max_bytes, jalls_ctx->group_commit_max_delay)) {
+		fprintf(stderr, "failed to configure group commit\n");
+		goto err_out;
+	}
+
 	systemd_sockfd = get_sockfd_from_systemd();
 	if (systemd_sockfd>0){
 		sock = systemd_sockfd;
@@ -406,9 +424,15 @@ int main(int argc, char **argv) {
 	}
 
 	if (jalls_ctx->debug) {
-		fprintf(stderr, "Accept delay thread count: %d\n", jalls_ctx->accept_delay_thread_count);
-		fprintf(stderr, "Accept delay increment: %d microSec\n", jalls_ctx->accept_delay_increment);
-		fprintf(stderr, "Accept delay max: %d microSec\n", jalls_ctx->accept_delay_max);
+		if (JALLS_CONN_ENGINE_EPOLL == jalls_ctx->conn_engine) {
+			fprintf(stderr, "Worker threads: %d\n", jalls_ctx->worker_threads);
+			fprintf(stderr, "Work queue size: %d\n", jalls_ctx->work_queue_size);
+			fprintf(stderr, "Max connections: %d\n", jalls_ctx->max_connections);
+		} else {
+			fprintf(stderr, "Accept delay thread count: %d\n", jalls_ctx->accept_delay_thread_count);
+			fprintf(stderr, "Accept delay increment: %d microSec\n", jalls_ctx->accept_delay_increment);
+			fprintf(stderr, "Accept delay max: %d microSec\n", jalls_ctx->accept_delay_max);
+		}
 		fprintf(stderr, "Ready to accept connections\n");
 	}
 
@@ -428,6 +452,18 @@ int main(int argc, char **argv) {
 	if(sock==systemd_sockfd){
 		sd_notify(0, "READY=1");
 	}
+	if (JALLS_CONN_ENGINE_EPOLL == jalls_ctx->conn_engine) {
+		struct jalls_thread_context proto_ctx;
+		memset(&proto_ctx, 0, sizeof(proto_ctx));
+		proto_ctx.fd = -1;
+		proto_ctx.signing_key = key;
+		proto_ctx.signing_cert = cert;
+		proto_ctx.signing_pool = signing_pool;
+		proto_ctx.db_ctx = db_ctx;
+		proto_ctx.ctx = jalls_ctx;
+		jalls_worker_pool_run(sock, &proto_ctx);
+		goto err_out;
+	}
 	while (!should_exit) {
 		struct jalls_thread_context *thread_ctx = calloc(1, sizeof(*thread_ctx));
 		if (thread_ctx == NULL) {
@@ -473,6 +509,7 @@ int main(int argc, char **argv) {
 		}
 		thread_ctx->signing_key = key;
 		thread_ctx->signing_cert = cert;
+		thread_ctx->signing_pool = signing_pool;
 		thread_ctx->db_ctx = db_ctx;
 		thread_ctx->ctx = jalls_ctx;
 		int my_errno = errno;
@@ -500,6 +537,7 @@ err_out:
 	}
 	RSA_free(key);
 	X509_free(cert);
+	jal_sign_pool_destroy(&signing_pool);
 	jalls_shutdown();
 	jaldb_context_destroy(&db_ctx);	
 	config_destroy(&sc_config);
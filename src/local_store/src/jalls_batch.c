@@ -0,0 +1,107 @@
+/**
+ * @file jalls_batch.c This file contains the function to take apart a
+ * batch message.
+ *
+ * @section LICENSE
+ *
+ * Source code in 3rd-party is licensed and owned by their respective
+ * copyright holders.
+ *
+ * All other source code is copyright Tresys Technology and licensed as below.
+ *
+ * Copyright (c) 2012 Tresys Technology LLC, Columbia, Maryland, USA
+ *
+ * This software was developed by Tresys Technology LLC
+ * with U.S. Government sponsorship.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "jal_alloc.h"
+#include "jalls_batch.h"
+
+// These match the message types in jalls_handler.c
+#define JALLS_BATCH_LOG_MSG 1
+#define JALLS_BATCH_AUDIT_MSG 2
+
+int jalls_check_batch_entry(const struct jalls_batch_entry *entry)
+{
+	if (JALLS_BATCH_LOG_MSG != entry->message_type &&
+			JALLS_BATCH_AUDIT_MSG != entry->message_type) {
+		return -1;
+	}
+	// Audit records always have data, log records need data or
+	// application metadata.
+	if ((JALLS_BATCH_AUDIT_MSG == entry->message_type && 0 == entry->data_len) ||
+			(0 == entry->data_len && 0 == entry->meta_len)) {
+		return -1;
+	}
+	return 0;
+}
+
+int jalls_parse_batch(const uint8_t *buf, uint64_t len,
+		struct jalls_batch_entry **entries, uint32_t *count)
+{
+	uint16_t version;
+	uint32_t n;
+
+	if (!buf || !entries || !count || len < JALLS_BATCH_HEADER_LEN) {
+		return -1;
+	}
+
+	memcpy(&version, buf, sizeof(version));
+	memcpy(&n, buf + 4, sizeof(n));
+	if (JALLS_BATCH_VERSION != version || 0 == n || n > JALLS_BATCH_MAX_RECORDS ||
+			len - JALLS_BATCH_HEADER_LEN < (uint64_t) n * JALLS_BATCH_ENTRY_LEN) {
+		return -1;
+	}
+
+	struct jalls_batch_entry *e = jal_calloc(n, sizeof(*e));
+	const uint8_t *table = buf + JALLS_BATCH_HEADER_LEN;
+	uint64_t off = JALLS_BATCH_HEADER_LEN + (uint64_t) n * JALLS_BATCH_ENTRY_LEN;
+
+	for (uint32_t i = 0; i < n; i++) {
+		const uint8_t *entry = table + (uint64_t) i * JALLS_BATCH_ENTRY_LEN;
+		memcpy(&e[i].message_type, entry, sizeof(e[i].message_type));
+		memcpy(&e[i].data_len, entry + 8, sizeof(e[i].data_len));
+		memcpy(&e[i].meta_len, entry + 16, sizeof(e[i].meta_len));
+
+		if (0 != jalls_check_batch_entry(&e[i])) {
+			goto err_out;
+		}
+		if (e[i].data_len > len - off) {
+			goto err_out;
+		}
+		e[i].data = e[i].data_len ? buf + off : NULL;
+		off += e[i].data_len;
+		if (e[i].meta_len > len - off) {
+			goto err_out;
+		}
+		e[i].meta = e[i].meta_len ? buf + off : NULL;
+		off += e[i].meta_len;
+	}
+	if (off != len) {
+		goto err_out;
+	}
+
+	*entries = e;
+	*count = n;
+	return 0;
+
+err_out:
+	free(e);
+	return -1;
+}
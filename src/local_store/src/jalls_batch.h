@@ -0,0 +1,101 @@
+/**
+ * @file jalls_batch.h This file defines the layout of a batch message and
+ * the function used to take one apart.
+ *
+ * @section LICENSE
+ *
+ * Source code in 3rd-party is licensed and owned by their respective
+ * copyright holders.
+ *
+ * All other source code is copyright Tresys Technology and licensed as below.
+ *
+ * Copyright (c) 2012 Tresys Technology LLC, Columbia, Maryland, USA
+ *
+ * This software was developed by Tresys Technology LLC
+ * with U.S. Government sponsorship.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _JALLS_BATCH_H_
+#define _JALLS_BATCH_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * A batch message carries several log or audit records in the data
+ * section of one message, with no application metadata section. The data
+ * section is laid out as follows, in host byte order:
+ *
+ *   uint16_t version          JALLS_BATCH_VERSION
+ *   uint16_t reserved         0
+ *   uint32_t count            number of records
+ *   count times:
+ *     uint16_t message_type   JALLS_LOG_MSG or JALLS_AUDIT_MSG
+ *     uint16_t reserved       0
+ *     uint32_t reserved       0
+ *     uint64_t data_len
+ *     uint64_t meta_len
+ *   count times:
+ *     data_len bytes of data, then meta_len bytes of application metadata
+ */
+#define JALLS_BATCH_MSG 5
+#define JALLS_BATCH_VERSION 1
+#define JALLS_BATCH_HEADER_LEN 8
+#define JALLS_BATCH_ENTRY_LEN 24
+
+/** The most records accepted in one batch */
+#define JALLS_BATCH_MAX_RECORDS 1024
+
+/** One record of a batch, pointing into the batch buffer */
+struct jalls_batch_entry {
+	uint16_t message_type;
+	const uint8_t *data;
+	uint64_t data_len;
+	const uint8_t *meta;
+	uint64_t meta_len;
+};
+
+/**
+ * Check the type and lengths of one log or audit record.
+ *
+ * @param[in] entry The record.
+ *
+ * @return 0 if the record can be stored, -1 otherwise.
+ */
+int jalls_check_batch_entry(const struct jalls_batch_entry *entry);
+
+/**
+ * Check a batch and find the records in it.
+ *
+ * @param[in] buf The data section of a batch message.
+ * @param[in] len The length of \p buf.
+ * @param[out] entries An array of \p count records, which point into
+ * \p buf. The caller must free() it.
+ * @param[out] count The number of records.
+ *
+ * @return 0 on success, or -1 if the batch is malformed, in which case
+ * \p entries is left untouched.
+ */
+int jalls_parse_batch(const uint8_t *buf, uint64_t len,
+		struct jalls_batch_entry **entries, uint32_t *count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _JALLS_BATCH_H_
@@ -52,6 +52,7 @@ int jalls_parse_config(const char *config_file_path, struct jalls_context **jall
 	}
 
 	char *system_uuid_str = NULL;
+	char *conn_engine_str = NULL;
 	char **private_key_file = &((*jalls_ctx)->private_key_file);
 	char **public_cert_file = &((*jalls_ctx)->public_cert_file);
 	uuid_t *system_uuid = &(*jalls_ctx)->system_uuid;
@@ -68,9 +69,18 @@ int jalls_parse_config(const char *config_file_path, struct jalls_context **jall
 	int *daemon = &((*jalls_ctx)->daemon);
 	int *sign_sys_meta = &((*jalls_ctx)->sign_sys_meta);
 	int *manifest_sys_meta = &((*jalls_ctx)->manifest_sys_meta);
+	int *journal_zero_copy = &((*jalls_ctx)->journal_zero_copy);
+	int *time_ordered_keys = &((*jalls_ctx)->time_ordered_keys);
 	int *accept_delay_thread_count = &((*jalls_ctx)->accept_delay_thread_count);
 	int *accept_delay_increment = &((*jalls_ctx)->accept_delay_increment);
 	int *accept_delay_max = &((*jalls_ctx)->accept_delay_max);
+	int *worker_threads = &((*jalls_ctx)->worker_threads);
+	int *work_queue_size = &((*jalls_ctx)->work_queue_size);
+	int *max_connections = &((*jalls_ctx)->max_connections);
+	int *group_commit_max_records = &((*jalls_ctx)->group_commit_max_records);
+	int *group_commit_max_bytes = &((*jalls_ctx)->group_commit_max_bytes);
+	int *group_commit_max_delay = &((*jalls_ctx)->group_commit_max_delay);
+	int *shm_max_ring_size = &((*jalls_ctx)->shm_max_ring_size);
 
 	config_t jalls_config;
 	config_init(&jalls_config);
@@ -165,6 +175,13 @@ int jalls_parse_config(const char *config_file_path, struct jalls_context **jall
 
 	config_setting_lookup_bool(root, JALLS_CFG_MANIFEST, manifest_sys_meta);
 
+	ret = config_setting_lookup_bool(root, JALLS_CFG_JOURNAL_ZERO_COPY, journal_zero_copy);
+	if (CONFIG_FALSE == ret) {
+		*journal_zero_copy = 1;
+	}
+
+	config_setting_lookup_bool(root, JALLS_CFG_TIME_ORDERED_KEYS, time_ordered_keys);
+
 	ret = config_setting_lookup_int(root,
 		JALLS_CFG_ACCEPT_DELAY_THREAD_COUNT,
 		accept_delay_thread_count);
@@ -191,6 +208,56 @@ int jalls_parse_config(const char *config_file_path, struct jalls_context **jall
 		*accept_delay_max = JALLS_CFG_ACCEPT_DELAY_MAX_DEFAULT;
 	}
 
+	ret = jalu_config_lookup_string(root, JALLS_CFG_CONN_ENGINE, &conn_engine_str, JALU_CFG_OPTIONAL);
+	if (-1 == ret) {
+		goto err_out;
+	}
+	if (NULL == conn_engine_str || 0 == strcmp(conn_engine_str, JALLS_CFG_CONN_ENGINE_EPOLL)) {
+		(*jalls_ctx)->conn_engine = JALLS_CONN_ENGINE_EPOLL;
+	} else if (0 == strcmp(conn_engine_str, JALLS_CFG_CONN_ENGINE_THREAD)) {
+		(*jalls_ctx)->conn_engine = JALLS_CONN_ENGINE_THREAD;
+	} else {
+		ret = -1;
+		fprintf(stderr, "Error: %s must be \"%s\" or \"%s\"\n", JALLS_CFG_CONN_ENGINE,
+			JALLS_CFG_CONN_ENGINE_EPOLL, JALLS_CFG_CONN_ENGINE_THREAD);
+		goto err_out;
+	}
+
+	ret = config_setting_lookup_int(root, JALLS_CFG_WORKER_THREADS, worker_threads);
+	if (CONFIG_FALSE == ret || 0 >= *worker_threads) {
+		*worker_threads = JALLS_CFG_WORKER_THREADS_DEFAULT;
+	}
+
+	ret = config_setting_lookup_int(root, JALLS_CFG_WORK_QUEUE_SIZE, work_queue_size);
+	if (CONFIG_FALSE == ret || 0 >= *work_queue_size) {
+		*work_queue_size = JALLS_CFG_WORK_QUEUE_SIZE_DEFAULT;
+	}
+
+	ret = config_setting_lookup_int(root, JALLS_CFG_MAX_CONNECTIONS, max_connections);
+	if (CONFIG_FALSE == ret || 0 >= *max_connections) {
+		*max_connections = JALLS_CFG_MAX_CONNECTIONS_DEFAULT;
+	}
+
+	ret = config_setting_lookup_int(root, JALLS_CFG_GROUP_COMMIT_MAX_RECORDS, group_commit_max_records);
+	if (CONFIG_FALSE == ret || 0 > *group_commit_max_records) {
+		*group_commit_max_records = JALLS_CFG_GROUP_COMMIT_MAX_RECORDS_DEFAULT;
+	}
+
+	ret = config_setting_lookup_int(root, JALLS_CFG_GROUP_COMMIT_MAX_BYTES, group_commit_max_bytes);
+	if (CONFIG_FALSE == ret || 0 > *group_commit_max_bytes) {
+		*group_commit_max_bytes = JALLS_CFG_GROUP_COMMIT_MAX_BYTES_DEFAULT;
+	}
+
+	ret = config_setting_lookup_int(root, JALLS_CFG_GROUP_COMMIT_MAX_DELAY, group_commit_max_delay);
+	if (CONFIG_FALSE == ret || 0 > *group_commit_max_delay) {
+		*group_commit_max_delay = JALLS_CFG_GROUP_COMMIT_MAX_DELAY_DEFAULT;
+	}
+
+	ret = config_setting_lookup_int(root, JALLS_CFG_SHM_MAX_RING_SIZE, shm_max_ring_size);
+	if (CONFIG_FALSE == ret || 0 > *shm_max_ring_size) {
+		*shm_max_ring_size = JALLS_CFG_SHM_MAX_RING_SIZE_DEFAULT;
+	}
+
 	if (*hostname == NULL) {
 		char name[_POSIX_HOST_NAME_MAX+1];
 		if (gethostname(name, sizeof(name)) == 0) {
@@ -222,6 +289,7 @@ int jalls_parse_config(const char *config_file_path, struct jalls_context **jall
 
 	config_destroy(&jalls_config);
 	free(system_uuid_str);
+	free(conn_engine_str);
 	return 0;
 
 err_out:
@@ -229,6 +297,7 @@ err_out:
 	free((*jalls_ctx)->private_key_file);
 	free((*jalls_ctx)->public_cert_file);
 	free(system_uuid_str);
+	free(conn_engine_str);
 	free((*jalls_ctx)->hostname);
 	free((*jalls_ctx)->schemas_root);
 	free((*jalls_ctx)->db_root);
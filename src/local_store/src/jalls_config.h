@@ -39,6 +39,13 @@
 #define JALLS_CFG_ACCEPT_DELAY_THREAD_COUNT_DEFAULT 10
 #define JALLS_CFG_ACCEPT_DELAY_INCREMENT_DEFAULT 100
 #define JALLS_CFG_ACCEPT_DELAY_MAX_DEFAULT 10000000
+#define JALLS_CFG_WORKER_THREADS_DEFAULT 16
+#define JALLS_CFG_WORK_QUEUE_SIZE_DEFAULT 256
+#define JALLS_CFG_MAX_CONNECTIONS_DEFAULT 1024
+#define JALLS_CFG_GROUP_COMMIT_MAX_RECORDS_DEFAULT 32
+#define JALLS_CFG_GROUP_COMMIT_MAX_BYTES_DEFAULT 4194304
+#define JALLS_CFG_GROUP_COMMIT_MAX_DELAY_DEFAULT 0
+#define JALLS_CFG_SHM_MAX_RING_SIZE_DEFAULT 67108864
 
 #define JALLS_CFG_PRIVATE_KEY_FILE "private_key_file"
 #define JALLS_CFG_PUBLIC_CERT_FILE "public_cert_file"
@@ -53,12 +60,25 @@
 #define JALLS_CFG_DAEMON "daemon"
 #define JALLS_CFG_SIGNATURE "sign_sys_meta"
 #define JALLS_CFG_MANIFEST "manifest_sys_meta"
+#define JALLS_CFG_JOURNAL_ZERO_COPY "journal_zero_copy"
+#define JALLS_CFG_TIME_ORDERED_KEYS "time_ordered_keys"
 #define JALLS_CFG_SCHEMAS_ROOT "schemas_root"
 #define JALLS_CFG_PID_FILE "pid_file"
 #define JALLS_CFG_LOG_DIR "log_dir"
 #define JALLS_CFG_ACCEPT_DELAY_THREAD_COUNT "accept_delay_thread_count"
 #define JALLS_CFG_ACCEPT_DELAY_INCREMENT "accept_delay_increment"
 #define JALLS_CFG_ACCEPT_DELAY_MAX "accept_delay_max"
+#define JALLS_CFG_CONN_ENGINE "connection_engine"
+#define JALLS_CFG_WORKER_THREADS "worker_threads"
+#define JALLS_CFG_WORK_QUEUE_SIZE "work_queue_size"
+#define JALLS_CFG_MAX_CONNECTIONS "max_connections"
+#define JALLS_CFG_GROUP_COMMIT_MAX_RECORDS "group_commit_max_records"
+#define JALLS_CFG_GROUP_COMMIT_MAX_BYTES "group_commit_max_bytes"
+#define JALLS_CFG_GROUP_COMMIT_MAX_DELAY "group_commit_max_delay"
+#define JALLS_CFG_SHM_MAX_RING_SIZE "shm_max_ring_size"
+
+#define JALLS_CFG_CONN_ENGINE_EPOLL "epoll"
+#define JALLS_CFG_CONN_ENGINE_THREAD "thread"
 
 /**
  * Parses the config file and fills out the jalls_context struct.
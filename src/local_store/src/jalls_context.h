@@ -42,6 +42,17 @@ extern "C" {
 
 #include "jaldb_context.h"
 
+struct jal_sign_pool;
+struct jalls_shm;
+
+/** The engine used to service producer connections */
+enum jalls_conn_engine {
+	/** An epoll event loop feeding a fixed-size pool of worker threads */
+	JALLS_CONN_ENGINE_EPOLL = 0,
+	/** A new thread is created for every accepted connection */
+	JALLS_CONN_ENGINE_THREAD,
+};
+
 /** holds the fields to be passed to a worker thread */
 struct jalls_context {
 	/** Holds the debug flag, to be passed to worker threads */
@@ -76,6 +87,10 @@ struct jalls_context {
 	int sign_sys_meta;
 	/** A boolean for whether to include manifests in the system metadata for data received from the producer library. */
 	int manifest_sys_meta;
+	/** A boolean for whether to copy journal files passed by descriptor without reading them into the local store. */
+	int journal_zero_copy;
+	/** A boolean for whether newly created databases use time ordered primary keys. */
+	int time_ordered_keys;
 	/** Absolute path to file where the PID will be written if run as a daemon. */
 	char *pid_file;
 	/** Absolute path to directory where stdout and stderr logs will be written if run as a daemon. */
@@ -86,6 +101,22 @@ struct jalls_context {
 	int accept_delay_increment;
 	/** Maximum accept delay in microseconds. */
 	int accept_delay_max;
+	/** The engine used to service producer connections. */
+	enum jalls_conn_engine conn_engine;
+	/** Number of worker threads started by the epoll connection engine. */
+	int worker_threads;
+	/** Maximum number of connections with a pending message waiting for a worker thread. */
+	int work_queue_size;
+	/** Maximum number of open connections for the epoll connection engine, new connections are not accepted above this limit. */
+	int max_connections;
+	/** Maximum number of records committed in one transaction, 0 or 1 disables group commit. */
+	int group_commit_max_records;
+	/** Maximum number of in-memory record bytes committed in one transaction, 0 for no limit. */
+	int group_commit_max_bytes;
+	/** Time in microseconds to wait for more records before committing a group. */
+	int group_commit_max_delay;
+	/** Largest shared memory ring, in bytes, a producer may set up, 0 to turn them all down. */
+	int shm_max_ring_size;
 };
 
 struct jalls_thread_context { /* the worker thread should never write to or free any of the jalls_thread_context fields */
@@ -103,6 +134,10 @@ struct jalls_thread_context { /* the worker thread should never write to or free
 	RSA *signing_key;
 	/** The certificate used for signing the system metadata */
 	X509 *signing_cert;
+	/** Signing contexts loaded with signing_key, shared by every thread */
+	struct jal_sign_pool *signing_pool;
+	/** The shared memory ring set up by the peer, or NULL */
+	struct jalls_shm *shm;
 };
 
 
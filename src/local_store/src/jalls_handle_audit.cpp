@@ -88,10 +88,10 @@ extern "C" int jalls_handle_audit(struct jalls_thread_context *thread_ctx, uint6
 
 	char *nonce = NULL;
 
-	RSA *signing_key = NULL;
+	struct jal_sign_pool *signing_pool = NULL;
 
 	if (thread_ctx->ctx->sign_sys_meta) {
-		signing_key = thread_ctx->signing_key;
+		signing_pool = thread_ctx->signing_pool;
 	}
 
 	bytes_received = jalls_recvmsg_helper(thread_ctx->fd, &msgh, debug);
@@ -144,7 +144,7 @@ extern "C" int jalls_handle_audit(struct jalls_thread_context *thread_ctx, uint6
 	}
 
 	if (meta_len) {
-		rec->app_meta = jaldb_create_segment();
+		rec->app_meta = jaldb_record_create_segment(rec);
 		rec->app_meta->length = meta_len;
 		rec->app_meta->payload = app_meta_buf;
 		rec->app_meta->on_disk = 0;
@@ -152,7 +152,7 @@ extern "C" int jalls_handle_audit(struct jalls_thread_context *thread_ctx, uint6
 	}
 
 	if (data_len > 0) {
-		rec->payload = jaldb_create_segment();
+		rec->payload = jaldb_record_create_segment(rec);
 		rec->payload->length = data_len;
 		rec->payload->payload = data_buf;
 		rec->payload->on_disk = 0;
@@ -160,7 +160,7 @@ extern "C" int jalls_handle_audit(struct jalls_thread_context *thread_ctx, uint6
 	}
 
 	// Needed to generate system metadata
-	rec->source = jal_strdup("localhost");
+	rec->source = jaldb_record_strdup(rec, "localhost");
 
 	if (thread_ctx->ctx->manifest_sys_meta) {
 		digest_ctx = jal_digest_ctx_create(JAL_DIGEST_ALGORITHM_SHA256);
@@ -190,9 +190,9 @@ extern "C" int jalls_handle_audit(struct jalls_thread_context *thread_ctx, uint6
 
 	}
 
-	rec->sys_meta = jaldb_create_segment();
+	rec->sys_meta = jaldb_record_create_segment(rec);
 	db_err = jaldb_record_to_system_metadata_doc(rec,
-						signing_key,
+						signing_pool,
 						app_meta_digest,
 						app_meta_digest_len,
 						app_meta_alg,
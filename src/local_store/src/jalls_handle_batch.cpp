@@ -0,0 +1,308 @@
+/**
+ * @file jalls_handle_batch.cpp This file contains functions to handle a batch
+ * of log and audit records to the jal local store.
+ *
+ * @section LICENSE
+ *
+ * Source code in 3rd-party is licensed and owned by their respective
+ * copyright holders.
+ *
+ * All other source code is copyright Tresys Technology and licensed as below.
+ *
+ * Copyright (c) 2012 Tresys Technology LLC, Columbia, Maryland, USA
+ *
+ * This software was developed by Tresys Technology LLC
+ * with U.S. Government sponsorship.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <inttypes.h>
+#include <string.h>
+#include <stdio.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <jalop/jal_digest.h>
+#include <jalop/jal_status.h>
+
+#include "jal_alloc.h"
+
+#include "jaldb_context.hpp"
+#include "jaldb_record.h"
+#include "jaldb_record_xml.h"
+#include "jaldb_segment.h"
+#include "jaldb_utils.h"
+
+#include "jalls_batch.h"
+#include "jalls_context.h"
+#include "jalls_msg.h"
+#include "jalls_handle_batch.hpp"
+#include "jalls_handler.h"
+#include "jalls_record_utils.h"
+
+#define JALLS_BATCH_LOG_MSG 1
+#define JALLS_BATCH_BREAK_STRING "BREAKBREAK"
+#define JALLS_BATCH_BREAK_LEN 10
+
+/**
+ * Make a segment that points at \p buf instead of holding a copy. It must
+ * be released with jalls_batch_release_segment().
+ */
+static struct jaldb_segment *jalls_batch_segment(struct jaldb_record *rec,
+		const uint8_t *buf, uint64_t len)
+{
+	struct jaldb_segment *seg = jaldb_record_create_segment(rec);
+	seg->payload = (uint8_t *)buf;
+	seg->length = len;
+	seg->on_disk = 0;
+	return seg;
+}
+
+static void jalls_batch_release_segment(struct jaldb_segment *seg)
+{
+	if (seg) {
+		seg->payload = NULL;
+	}
+}
+
+static void jalls_batch_destroy_record(struct jaldb_record **rec)
+{
+	if (*rec) {
+		jalls_batch_release_segment((*rec)->payload);
+		jalls_batch_release_segment((*rec)->app_meta);
+	}
+	jaldb_destroy_record(rec);
+}
+
+/**
+ * Build the record for one entry of a batch, including its system metadata.
+ */
+static int jalls_batch_record(struct jalls_thread_context *thread_ctx,
+		struct jal_digest_ctx *digest_ctx, const struct jalls_batch_entry *entry,
+		struct jaldb_record **prec)
+{
+	struct jaldb_record *rec = NULL;
+	int debug = thread_ctx->ctx->debug;
+	int ret = -1;
+	int err;
+	enum jaldb_status db_err;
+	uint8_t *payload_digest = NULL;
+	int payload_digest_len = 0;
+	const char *payload_alg = NULL;
+	uint8_t *app_meta_digest = NULL;
+	int app_meta_digest_len = 0;
+	const char *app_meta_alg = NULL;
+
+	struct jal_sign_pool *signing_pool = NULL;
+	if (thread_ctx->ctx->sign_sys_meta) {
+		signing_pool = thread_ctx->signing_pool;
+	}
+
+	enum jaldb_rec_type type = (JALLS_BATCH_LOG_MSG == entry->message_type) ?
+		JALDB_RTYPE_LOG : JALDB_RTYPE_AUDIT;
+	err = jalls_create_record(type, thread_ctx, &rec);
+	if (err < 0) {
+		if (debug) {
+			fprintf(stderr, "failed to create record struct\n");
+		}
+		goto out;
+	}
+
+	if (entry->meta_len) {
+		rec->app_meta = jalls_batch_segment(rec, entry->meta, entry->meta_len);
+	}
+	if (entry->data_len) {
+		rec->payload = jalls_batch_segment(rec, entry->data, entry->data_len);
+	}
+
+	// Needed to generate system metadata
+	rec->source = jaldb_record_strdup(rec, "localhost");
+
+	if (digest_ctx) {
+		if (rec->payload) {
+			err = jal_digest_buffer(digest_ctx, rec->payload->payload, rec->payload->length, &payload_digest);
+			if (JAL_OK != err) {
+				if (debug) {
+					fprintf(stderr, "Failed to calculate digest for record payload\n");
+				}
+				goto out;
+			}
+			payload_digest_len = digest_ctx->len;
+			payload_alg = digest_ctx->algorithm_uri;
+		}
+
+		if (rec->app_meta) {
+			err = jal_digest_buffer(digest_ctx, rec->app_meta->payload, rec->app_meta->length, &app_meta_digest);
+			if (JAL_OK != err) {
+				if (debug) {
+					fprintf(stderr, "Failed to calculate digest for record Application Metadata\n");
+				}
+				goto out;
+			}
+			app_meta_digest_len = digest_ctx->len;
+			app_meta_alg = digest_ctx->algorithm_uri;
+		}
+	}
+
+	rec->sys_meta = jaldb_record_create_segment(rec);
+	db_err = jaldb_record_to_system_metadata_doc(rec,
+						signing_pool,
+						app_meta_digest,
+						app_meta_digest_len,
+						app_meta_alg,
+						payload_digest,
+						payload_digest_len,
+						payload_alg,
+						(char **) &(rec->sys_meta->payload),
+						&(rec->sys_meta->length));
+	if (JALDB_OK != db_err) {
+		if (debug) {
+			fprintf(stderr, "Failed to generate system metadata for record\n");
+		}
+		goto out;
+	}
+
+	*prec = rec;
+	rec = NULL;
+	ret = 0;
+
+out:
+	free(payload_digest);
+	free(app_meta_digest);
+	jalls_batch_destroy_record(&rec);
+	return ret;
+}
+
+extern "C" int jalls_insert_batch_entries(struct jalls_thread_context *thread_ctx,
+		const struct jalls_batch_entry *entries, uint32_t count)
+{
+	if (!thread_ctx || !(thread_ctx->ctx) || !entries || 0 == count) {
+		return -1; //should never happen.
+	}
+
+	int ret = -1;
+	struct jal_digest_ctx *digest_ctx = NULL;
+	struct jaldb_record **recs = NULL;
+	char **nonces = NULL;
+	enum jaldb_status *rec_status = NULL;
+	enum jaldb_status db_err;
+
+	if (thread_ctx->ctx->manifest_sys_meta) {
+		digest_ctx = jal_digest_ctx_create(JAL_DIGEST_ALGORITHM_SHA256);
+	}
+
+	recs = (struct jaldb_record **)jal_calloc(count, sizeof(*recs));
+	for (uint32_t i = 0; i < count; i++) {
+		if (0 != jalls_batch_record(thread_ctx, digest_ctx, &entries[i], &recs[i])) {
+			goto out;
+		}
+	}
+
+	nonces = (char **)jal_calloc(count, sizeof(*nonces));
+	rec_status = (enum jaldb_status *)jal_calloc(count, sizeof(*rec_status));
+	db_err = jaldb_insert_records(thread_ctx->db_ctx, recs, count, 1, nonces, rec_status);
+	if (JALDB_OK != db_err) {
+		for (uint32_t i = 0; i < count; i++) {
+			if (JALDB_E_REJECT == rec_status[i]) {
+				fprintf(stderr, "batch record %" PRIu32 " was too large and was rejected\n", i);
+			}
+		}
+		fprintf(stderr, "failed to insert batch records\n");
+		if (JALDB_E_INTERNAL_ERROR == db_err) {
+			ret = JALDB_E_INTERNAL_ERROR;
+			fprintf(stderr, "Internal database error occurred\n");
+		}
+		goto out;
+	}
+	ret = 0;
+
+out:
+	if (digest_ctx) {
+		jal_digest_ctx_destroy(&digest_ctx);
+	}
+	for (uint32_t i = 0; recs && i < count; i++) {
+		jalls_batch_destroy_record(&recs[i]);
+		if (nonces) {
+			free(nonces[i]);
+		}
+	}
+	free(recs);
+	free(nonces);
+	free(rec_status);
+	return ret;
+}
+
+extern "C" int jalls_handle_batch(struct jalls_thread_context *thread_ctx, uint64_t data_len, uint64_t meta_len)
+{
+	if (!thread_ctx || !(thread_ctx->ctx)) {
+		return -1; //should never happen.
+	}
+
+	int debug = thread_ctx->ctx->debug;
+	int ret = -1;
+	struct jalls_batch_entry *entries = NULL;
+	uint32_t count = 0;
+	uint8_t *batch_buf = NULL;
+	char break_buf[JALLS_BATCH_BREAK_LEN];
+
+	if (0 != meta_len || data_len < JALLS_BATCH_HEADER_LEN) {
+		if (debug) {
+			fprintf(stderr, "malformed batch message\n");
+		}
+		return -1;
+	}
+
+	// The whole batch and both BREAK strings arrive with one recvmsg()
+	batch_buf = (uint8_t *)jal_malloc(data_len);
+
+	struct iovec iov[2];
+	iov[0].iov_base = batch_buf;
+	iov[0].iov_len = data_len;
+	iov[1].iov_base = break_buf;
+	iov[1].iov_len = JALLS_BATCH_BREAK_LEN;
+
+	struct msghdr msgh;
+	memset(&msgh, 0, sizeof(msgh));
+	msgh.msg_iov = iov;
+	msgh.msg_iovlen = 2;
+
+	ssize_t bytes_received = jalls_recvmsg_helper(thread_ctx->fd, &msgh, debug);
+	if (bytes_received <= 0) {
+		if (debug) {
+			fprintf(stderr, "could not receive batch\n");
+		}
+		goto out;
+	}
+	if (0 != memcmp(break_buf, JALLS_BATCH_BREAK_STRING, JALLS_BATCH_BREAK_LEN)) {
+		if (debug) {
+			fprintf(stderr, "%s: could not receive BREAK\n", __FILE__);
+		}
+		goto out;
+	}
+
+	if (0 != jalls_parse_batch(batch_buf, data_len, &entries, &count)) {
+		if (debug) {
+			fprintf(stderr, "malformed batch message\n");
+		}
+		goto out;
+	}
+
+	ret = jalls_insert_batch_entries(thread_ctx, entries, count);
+
+out:
+	free(entries);
+	free(batch_buf);
+	return ret;
+}
@@ -0,0 +1,75 @@
+/**
+ * @file jalls_handle_batch.hpp This file contains functions to handle a batch
+ * of log and audit records to the jal local store.
+ *
+ * @section LICENSE
+ *
+ * Source code in 3rd-party is licensed and owned by their respective
+ * copyright holders.
+ *
+ * All other source code is copyright Tresys Technology and licensed as below.
+ *
+ * Copyright (c) 2012 Tresys Technology LLC, Columbia, Maryland, USA
+ *
+ * This software was developed by Tresys Technology LLC
+ * with U.S. Government sponsorship.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _JALLS_HANDLE_BATCH_H_
+#define _JALLS_HANDLE_BATCH_H_
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "jalls_batch.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Receive a batch message, described in jalls_batch.h, and insert all of
+ * its records with a single transaction.
+ *
+ * @param[in] thread_ctx The connection.
+ * @param[in] data_len The length of the batch.
+ * @param[in] meta_len Must be 0.
+ *
+ * @return 0 on success, -1 on error, or JALDB_E_INTERNAL_ERROR if the
+ * database failed.
+ */
+int jalls_handle_batch(struct jalls_thread_context *thread_ctx, uint64_t data_len, uint64_t meta_len);
+
+/**
+ * Store log and audit records with a single transaction. The records are
+ * digested and inserted straight from the buffers \p entries point into,
+ * which must not be released until this returns.
+ *
+ * @param[in] thread_ctx The connection the records came from.
+ * @param[in] entries The records.
+ * @param[in] count The number of records, at least 1.
+ *
+ * @return 0 on success, -1 on error, or JALDB_E_INTERNAL_ERROR if the
+ * database failed.
+ */
+int jalls_insert_batch_entries(struct jalls_thread_context *thread_ctx,
+		const struct jalls_batch_entry *entries, uint32_t count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _JALLS_HANDLE_BATCH_H_
@@ -74,7 +74,8 @@ extern "C" int jalls_handle_journal(struct jalls_thread_context *thread_ctx, uin
 	uint64_t bytes_remaining;
 
 	struct jal_digest_ctx *digest_ctx = NULL;
-	uint8_t *digest = NULL;
+	struct jal_multi_digest *payload_md = NULL;
+	enum jal_digest_algorithm payload_algorithm = JAL_DIGEST_ALGORITHM_SHA256;
 	uint8_t *payload_digest = NULL;
 	int payload_digest_len = 0;
 	char *payload_alg = NULL;
@@ -82,14 +83,12 @@ extern "C" int jalls_handle_journal(struct jalls_thread_context *thread_ctx, uin
 	int app_meta_digest_len = 0;
 	char *app_meta_alg = NULL;
 
-	void *sha256_instance = NULL;
-
 	char *nonce = NULL;
 	
-	RSA *signing_key = NULL;
+	struct jal_sign_pool *signing_pool = NULL;
 
 	if (thread_ctx->ctx->sign_sys_meta) {
-		signing_key = thread_ctx->signing_key;
+		signing_pool = thread_ctx->signing_pool;
 	}
 
 	//get a file from the db layer to write the journal data to.
@@ -128,11 +127,9 @@ extern "C" int jalls_handle_journal(struct jalls_thread_context *thread_ctx, uin
 	bytes_remaining = data_len;
 	int bytes_written;
 
-	digest_ctx = jal_digest_ctx_create(JAL_DIGEST_ALGORITHM_SHA256);
-	sha256_instance = digest_ctx->create();
-	digest = (uint8_t *)jal_malloc(digest_ctx->len);
-	jal_err = digest_ctx->init(sha256_instance);
-	if(jal_err != JAL_OK) {
+	digest_ctx = jal_digest_ctx_create(payload_algorithm);
+	payload_md = jal_multi_digest_create(&payload_algorithm, 1);
+	if (!payload_md) {
 		if (debug) {
 			fprintf(stderr, "could not init sha256 digest context\n");
 		}
@@ -142,7 +139,7 @@ extern "C" int jalls_handle_journal(struct jalls_thread_context *thread_ctx, uin
 	bytes_received = jalls_recvmsg_helper(thread_ctx->fd, &msgh, debug);
 	while (bytes_received > 0 && bytes_remaining >= (uint64_t)bytes_received) {
 		bytes_remaining -= (uint64_t)bytes_received;
-		jal_err = digest_ctx->update(sha256_instance, (uint8_t *)data_buf, bytes_received);
+		jal_err = jal_multi_digest_update(payload_md, (uint8_t *)data_buf, bytes_received);
 		if (jal_err != JAL_OK) {
 			if (debug) {
 				fprintf(stderr, "could not digest the journal data\n");
@@ -168,9 +165,7 @@ extern "C" int jalls_handle_journal(struct jalls_thread_context *thread_ctx, uin
 		}
 		goto err_out;
 	}
-	size_t digest_length;
-	digest_length = digest_ctx->len;
-	jal_err = digest_ctx->final(sha256_instance, digest, &digest_length);
+	jal_err = jal_multi_digest_final(payload_md);
 	if(jal_err != JAL_OK) {
 		if (debug) {
 			fprintf(stderr, "could not digest the journal\n");
@@ -216,14 +211,14 @@ extern "C" int jalls_handle_journal(struct jalls_thread_context *thread_ctx, uin
 	}
 
 	if (meta_len) {
-		rec->app_meta = jaldb_create_segment();
+		rec->app_meta = jaldb_record_create_segment(rec);
 		rec->app_meta->length = meta_len;
 		rec->app_meta->payload = app_meta_buf;
 		rec->app_meta->on_disk = 0;
 		app_meta_buf = NULL;
 	}
 
-	rec->payload = jaldb_create_segment();
+	rec->payload = jaldb_record_create_segment(rec);
 	rec->payload->length = data_len;
 	rec->payload->payload = (uint8_t*)db_payload_path;
 	rec->payload->on_disk = 1;
@@ -231,24 +226,18 @@ extern "C" int jalls_handle_journal(struct jalls_thread_context *thread_ctx, uin
 	db_payload_path = NULL;
 
 	// Needed to generate system metadata
-	rec->source = jal_strdup("localhost");
+	rec->source = jaldb_record_strdup(rec, "localhost");
 
 	if (thread_ctx->ctx->manifest_sys_meta) {
-		if (rec->payload) {
-			if (rec->payload->on_disk) {
-				err = jal_digest_fd(digest_ctx, rec->payload->fd, &payload_digest);
-			} else {
-				err = jal_digest_buffer(digest_ctx, rec->payload->payload, rec->payload->length, &payload_digest);
-			}
-			if (JAL_OK != err) {
-				if (debug) {
-					fprintf(stderr, "Failed to calculate digest for record payload\n");
-				}
-				goto err_out;
+		// The payload was digested while it was written to the DB file.
+		err = jal_multi_digest_get(payload_md, payload_algorithm, &payload_digest, &payload_digest_len);
+		if (JAL_OK != err) {
+			if (debug) {
+				fprintf(stderr, "Failed to calculate digest for record payload\n");
 			}
-			payload_digest_len = digest_ctx->len;
-			payload_alg = jal_strdup(digest_ctx->algorithm_uri); 
+			goto err_out;
 		}
+		payload_alg = jal_strdup(digest_ctx->algorithm_uri);
 
 		if (rec->app_meta) {
 			err = jal_digest_buffer(digest_ctx, rec->app_meta->payload, rec->app_meta->length, &app_meta_digest);
@@ -264,9 +253,9 @@ extern "C" int jalls_handle_journal(struct jalls_thread_context *thread_ctx, uin
 
 	}
 
-	rec->sys_meta = jaldb_create_segment();
+	rec->sys_meta = jaldb_record_create_segment(rec);
 	db_err = jaldb_record_to_system_metadata_doc(rec,
-						signing_key,
+						signing_pool,
 						app_meta_digest,
 						app_meta_digest_len,
 						app_meta_alg,
@@ -304,11 +293,8 @@ extern "C" int jalls_handle_journal(struct jalls_thread_context *thread_ctx, uin
 	ret = 0;
 
 err_out:
-	if (digest_ctx) {
-		digest_ctx->destroy(sha256_instance);
-		jal_digest_ctx_destroy(&digest_ctx);
-	}
-	free(digest);
+	jal_digest_ctx_destroy(&digest_ctx);
+	jal_multi_digest_destroy(&payload_md);
 	free(app_meta_buf);
 	jaldb_destroy_record(&rec);
 	free(app_meta_digest);
@@ -27,6 +27,7 @@
  * limitations under the License.
  */
 
+#include <inttypes.h>
 #include <stdio.h>
 #include <string.h>
 #include <sys/types.h>
@@ -46,11 +47,10 @@
 #include "jalls_msg.h"
 #include "jalls_handle_journal_fd.hpp"
 #include "jalls_handler.h"
+#include "jalls_journal_copy.h"
 #include "jalls_record_utils.h"
 #include "jaldb_record_xml.h"
 
-#define JALLS_JOURNAL_BUF_LEN 8192
-
 extern "C" int jalls_handle_journal_fd(struct jalls_thread_context *thread_ctx, uint64_t data_len, uint64_t meta_len, int journal_fd)
 {
 	if (!thread_ctx || !(thread_ctx->ctx)) {
@@ -68,7 +68,8 @@ extern "C" int jalls_handle_journal_fd(struct jalls_thread_context *thread_ctx,
 	uint8_t *app_meta_buf = NULL;
 
 	struct jal_digest_ctx *digest_ctx = NULL;
-	uint8_t *digest = NULL;
+	struct jal_multi_digest *payload_md = NULL;
+	enum jal_digest_algorithm payload_algorithm = JAL_DIGEST_ALGORITHM_SHA256;
 	uint8_t *payload_digest = NULL;
 	int payload_digest_len = 0;
 	char *payload_alg = NULL;
@@ -76,37 +77,15 @@ extern "C" int jalls_handle_journal_fd(struct jalls_thread_context *thread_ctx,
 	int app_meta_digest_len = 0;
 	char *app_meta_alg = NULL;
 
-	void *sha256_instance = NULL;
-
-	//get the payload, write it to the db file.
-	char data_buf[JALLS_JOURNAL_BUF_LEN];
-	memset(data_buf, 0, JALLS_JOURNAL_BUF_LEN);
-
-	struct iovec iov[1];
-	iov[0].iov_base = data_buf;
-	iov[0].iov_len = JALLS_JOURNAL_BUF_LEN;
-
-	struct msghdr msgh;
-	memset(&msgh, 0, sizeof(msgh));
-
-	msgh.msg_iov = iov;
-	msgh.msg_iovlen = 1;
-
-	//data_len should be the size of the file, and there should be no
-	//data or first break string
-	uint64_t bytes_remaining = data_len;
-	size_t bytes_to_read = JALLS_JOURNAL_BUF_LEN;
-	int bytes_written;
-	ssize_t bytes_read = 0;
-
+	enum jalls_copy_method copy_method = JALLS_COPY_READ_WRITE;
 	int db_payload_fd = -1;
 	char *db_payload_path = NULL;
 	char *nonce = NULL;
 	
-	RSA *signing_key = NULL;
+	struct jal_sign_pool *signing_pool = NULL;
 
 	if (thread_ctx->ctx->sign_sys_meta) {
-		signing_key = thread_ctx->signing_key;
+		signing_pool = thread_ctx->signing_pool;
 	}
 
 	//get a file from the db layer to write the journal data to.
@@ -122,51 +101,31 @@ extern "C" int jalls_handle_journal_fd(struct jalls_thread_context *thread_ctx,
 	}
 
 	//digest and write the file
-	digest_ctx = jal_digest_ctx_create(JAL_DIGEST_ALGORITHM_SHA256);
-	sha256_instance = digest_ctx->create();
-	digest = (uint8_t *)jal_malloc(digest_ctx->len);
-	jal_err = digest_ctx->init(sha256_instance);
-	if(jal_err != JAL_OK) {
+	digest_ctx = jal_digest_ctx_create(payload_algorithm);
+	payload_md = jal_multi_digest_create(&payload_algorithm, 1);
+	if (!payload_md) {
 		if (debug) {
 			fprintf(stderr, "could not init sha256 digest context\n");
 		}
 		goto err_out;
 	}
 
-	if ((off_t) -1 == lseek(journal_fd, 0, SEEK_SET)) {
+	//data_len should be the size of the file, and there should be no
+	//data or first break string
+	err = jalls_copy_journal_fd(journal_fd, db_payload_fd, data_len, payload_md,
+			thread_ctx->ctx->journal_zero_copy, &copy_method, debug);
+	if (err < 0) {
 		if (debug) {
-			fprintf(stderr, "failed to reset journal file to the beginning\n");
+			fprintf(stderr, "could not copy the journal to the database file\n");
 		}
+		goto err_out;
 	}
-	while (bytes_remaining > 0) {
-		bytes_to_read = (bytes_remaining < JALLS_JOURNAL_BUF_LEN) ? bytes_remaining : JALLS_JOURNAL_BUF_LEN;
-		bytes_read = read(journal_fd, data_buf, bytes_to_read);
-		if (bytes_read < 0) {
-			if (debug) {
-				fprintf(stderr, "failed to read from file descriptor\n");
-			}
-			goto err_out;
-		}
-		jal_err = digest_ctx->update(sha256_instance, (uint8_t *)data_buf, bytes_read);
-		if (jal_err != JAL_OK) {
-			if (debug) {
-				fprintf(stderr, "could not digest the journal data\n");
-			}
-			goto err_out;
-		}
-		bytes_written = write(db_payload_fd, data_buf, bytes_read);
-		if (bytes_written < 0) {
-			if (debug) {
-				fprintf(stderr, "could not write journal to file");
-			}
-			goto err_out;
-		}
-		bytes_remaining -= (uint64_t)bytes_read;
+	if (debug) {
+		fprintf(stderr, "copied %" PRIu64 " bytes of journal data with %s\n",
+			data_len, jalls_copy_method_str(copy_method));
 	}
 
-	size_t digest_length;
-	digest_length = digest_ctx->len;
-	jal_err = digest_ctx->final(sha256_instance, digest, &digest_length);
+	jal_err = jal_multi_digest_final(payload_md);
 	if(jal_err != JAL_OK) {
 		if (debug) {
 			fprintf(stderr, "could not digest the journal\n");
@@ -204,14 +163,14 @@ extern "C" int jalls_handle_journal_fd(struct jalls_thread_context *thread_ctx,
 	}
 
 	if (meta_len) {
-		rec->app_meta = jaldb_create_segment();
+		rec->app_meta = jaldb_record_create_segment(rec);
 		rec->app_meta->length = meta_len;
 		rec->app_meta->payload = app_meta_buf;
 		rec->app_meta->on_disk = 0;
 		app_meta_buf = NULL;
 	}
 
-	rec->payload = jaldb_create_segment();
+	rec->payload = jaldb_record_create_segment(rec);
 	rec->payload->length = data_len;
 	rec->payload->payload = (uint8_t*)db_payload_path;
 	rec->payload->on_disk = 1;
@@ -219,24 +178,18 @@ extern "C" int jalls_handle_journal_fd(struct jalls_thread_context *thread_ctx,
 	db_payload_path = NULL;
 
 	// Needed to generate system metadata
-	rec->source = jal_strdup("localhost");
+	rec->source = jaldb_record_strdup(rec, "localhost");
 
 	if (thread_ctx->ctx->manifest_sys_meta) {
-		if (rec->payload) {
-			if (rec->payload->on_disk) {
-				err = jal_digest_fd(digest_ctx, rec->payload->fd, &payload_digest);
-			} else {
-				err = jal_digest_buffer(digest_ctx, rec->payload->payload, rec->payload->length, &payload_digest);
-			}
-			if (JAL_OK != err) {
-				if (debug) {
-					fprintf(stderr, "Failed to calculate digest for record payload\n");
-				}
-				goto err_out;
+		// The payload was digested while it was written to the DB file.
+		err = jal_multi_digest_get(payload_md, payload_algorithm, &payload_digest, &payload_digest_len);
+		if (JAL_OK != err) {
+			if (debug) {
+				fprintf(stderr, "Failed to calculate digest for record payload\n");
 			}
-			payload_digest_len = digest_ctx->len;
-			payload_alg = jal_strdup(digest_ctx->algorithm_uri); 
+			goto err_out;
 		}
+		payload_alg = jal_strdup(digest_ctx->algorithm_uri);
 
 		if (rec->app_meta) {
 			err = jal_digest_buffer(digest_ctx, rec->app_meta->payload, rec->app_meta->length, &app_meta_digest);
@@ -252,9 +205,9 @@ extern "C" int jalls_handle_journal_fd(struct jalls_thread_context *thread_ctx,
 
 	}
 
-	rec->sys_meta = jaldb_create_segment();
+	rec->sys_meta = jaldb_record_create_segment(rec);
 	db_err = jaldb_record_to_system_metadata_doc(rec,
-						signing_key,
+						signing_pool,
 						app_meta_digest,
 						app_meta_digest_len,
 						app_meta_alg,
@@ -293,11 +246,8 @@ err_out:
 	nonce = NULL;
 	close(journal_fd);
 	free(app_meta_buf);
-	if (digest_ctx) {
-		digest_ctx->destroy(sha256_instance);
-		jal_digest_ctx_destroy(&digest_ctx);
-	}
-	free(digest);
+	jal_digest_ctx_destroy(&digest_ctx);
+	jal_multi_digest_destroy(&payload_md);
 	jaldb_destroy_record(&rec);
 	free(app_meta_digest);
 	free(app_meta_alg);
@@ -88,10 +88,10 @@ extern "C" int jalls_handle_log(struct jalls_thread_context *thread_ctx, uint64_
 
 	char *nonce = NULL;
 
-	RSA *signing_key = NULL;
+	struct jal_sign_pool *signing_pool = NULL;
 
 	if (thread_ctx->ctx->sign_sys_meta) {
-		signing_key = thread_ctx->signing_key;
+		signing_pool = thread_ctx->signing_pool;
 	}
 
 	if (data_len > 0) {
@@ -142,7 +142,7 @@ extern "C" int jalls_handle_log(struct jalls_thread_context *thread_ctx, uint64_
 	}
 
 	if (meta_len) {
-		rec->app_meta = jaldb_create_segment();
+		rec->app_meta = jaldb_record_create_segment(rec);
 		rec->app_meta->length = meta_len;
 		rec->app_meta->payload = app_meta_buf;
 		rec->app_meta->on_disk = 0;
@@ -150,7 +150,7 @@ extern "C" int jalls_handle_log(struct jalls_thread_context *thread_ctx, uint64_
 	}
 
 	if (data_len > 0) {
-		rec->payload = jaldb_create_segment();
+		rec->payload = jaldb_record_create_segment(rec);
 		rec->payload->length = data_len;
 		rec->payload->payload = data_buf;
 		rec->payload->on_disk = 0;
@@ -158,7 +158,7 @@ extern "C" int jalls_handle_log(struct jalls_thread_context *thread_ctx, uint64_
 	}
 
 	// Needed to generate system metadata
-	rec->source = jal_strdup("localhost");
+	rec->source = jaldb_record_strdup(rec, "localhost");
 
 	if (thread_ctx->ctx->manifest_sys_meta) {
 		digest_ctx = jal_digest_ctx_create(JAL_DIGEST_ALGORITHM_SHA256);
@@ -188,9 +188,9 @@ extern "C" int jalls_handle_log(struct jalls_thread_context *thread_ctx, uint64_
 
 	}
 
-	rec->sys_meta = jaldb_create_segment();
+	rec->sys_meta = jaldb_record_create_segment(rec);
 	db_err = jaldb_record_to_system_metadata_doc(rec,
-						signing_key,
+						signing_pool,
 						app_meta_digest,
 						app_meta_digest_len,
 						app_meta_alg,
@@ -45,12 +45,15 @@
 
 #include <jalop/jal_version.h>
 #include "jal_alloc.h"
+#include "jalls_batch.h"
 #include "jalls_msg.h"
 #include "jalls_handler.h"
 #include "jalls_handle_journal.hpp"
 #include "jalls_handle_log.hpp"
 #include "jalls_handle_audit.hpp"
 #include "jalls_handle_journal_fd.hpp"
+#include "jalls_handle_batch.hpp"
+#include "jalls_shm.h"
 
 #define JALLS_LOG_MSG 1
 #define JALLS_AUDIT_MSG 2
@@ -68,8 +71,6 @@ void *jalls_handler(void *thread_ctx_p) {
 
 	struct jalls_thread_context *thread_ctx = NULL;
 	thread_ctx = thread_ctx_p;
-	pid_t *pid = NULL;
-	uid_t *uid = NULL;
 	int debug = thread_ctx->ctx->debug;
 	int err = pthread_detach(pthread_self());
 	if (err < 0) {
@@ -80,173 +81,224 @@ void *jalls_handler(void *thread_ctx_p) {
 	}
 
 	while (!should_exit) {
+		if (thread_ctx->shm) {
+			err = jalls_shm_handle_ready(thread_ctx, -1);
+		} else {
+			err = jalls_handle_message(thread_ctx);
+		}
+		if (err <= 0) {
+			if (JALDB_E_INTERNAL_ERROR == err) {
+				should_exit = 1;
+			}
+			goto out;
+		}
+	}
+
+out:
+	jalls_shm_destroy(&thread_ctx->shm);
+	close(thread_ctx->fd);
+	free(thread_ctx);
+	if (should_exit) {
+		kill(getpid(), SIGTERM);
+	}
+	return NULL;
+}
+
+int jalls_handle_message(struct jalls_thread_context *thread_ctx) {
+	if (!thread_ctx || !thread_ctx->ctx) {
+		return -1; //should never happen.
+	}
 
-		// read protocol version, message type, data length,
-		// metadata length and possible fd.
-		uint16_t protocol_version;
-		uint16_t message_type;
-		uint64_t data_len;
-		uint64_t meta_len;
-		int msg_fd = -1;
+	pid_t *pid = NULL;
+	uid_t *uid = NULL;
+	int debug = thread_ctx->ctx->debug;
+	int err;
+
+	// read protocol version, message type, data length,
+	// metadata length and possible fd.
+	uint16_t protocol_version;
+	uint16_t message_type;
+	uint64_t data_len;
+	uint64_t meta_len;
+	int msg_fd = -1;
+	int shm_fds[JALLS_SHM_SETUP_FDS];
+	int shm_fd_count = 0;
 
-		struct msghdr msgh;
-		memset(&msgh, 0, sizeof(msgh));
+	struct msghdr msgh;
+	memset(&msgh, 0, sizeof(msgh));
 
-		struct iovec iov[4];
-		iov[0].iov_base = &protocol_version;
-		iov[0].iov_len = sizeof(protocol_version);
-		iov[1].iov_base = &message_type;
-		iov[1].iov_len = sizeof(message_type);
-		iov[2].iov_base = &data_len;
-		iov[2].iov_len = sizeof(data_len);
-		iov[3].iov_base = &meta_len;
-		iov[3].iov_len = sizeof(meta_len);
+	struct iovec iov[4];
+	iov[0].iov_base = &protocol_version;
+	iov[0].iov_len = sizeof(protocol_version);
+	iov[1].iov_base = &message_type;
+	iov[1].iov_len = sizeof(message_type);
+	iov[2].iov_base = &data_len;
+	iov[2].iov_len = sizeof(data_len);
+	iov[3].iov_base = &meta_len;
+	iov[3].iov_len = sizeof(meta_len);
 
-		msgh.msg_iov = iov;
-		msgh.msg_iovlen = 4;
+	msgh.msg_iov = iov;
+	msgh.msg_iovlen = 4;
 
-		char msg_control_buffer[CMSG_SPACE(sizeof(msg_fd))];
+	// Big enough for the descriptors of a shm setup message
+	char msg_control_buffer[CMSG_SPACE(sizeof(shm_fds))];
 
-		msgh.msg_control = msg_control_buffer;
-		msgh.msg_controllen = sizeof(msg_control_buffer);
+	msgh.msg_control = msg_control_buffer;
+	msgh.msg_controllen = sizeof(msg_control_buffer);
 
 #ifdef SO_PEERCRED
-		struct ucred cred;
-		memset(&cred, 0, sizeof(cred));
-		pid = &cred.pid;
-		uid = &cred.uid;
-		*pid = -1;
-		*uid = 0;
-		socklen_t cred_len = sizeof(cred);
-		if (-1 == getsockopt(thread_ctx->fd, SOL_SOCKET, SO_PEERCRED, &cred, &cred_len)) {
-			if (debug) {
-				fprintf(stderr, "failed receiving peer crendentials\n");
-			}
+	struct ucred cred;
+	memset(&cred, 0, sizeof(cred));
+	pid = &cred.pid;
+	uid = &cred.uid;
+	*pid = -1;
+	*uid = 0;
+	socklen_t cred_len = sizeof(cred);
+	if (-1 == getsockopt(thread_ctx->fd, SOL_SOCKET, SO_PEERCRED, &cred, &cred_len)) {
+		if (debug) {
+			fprintf(stderr, "failed receiving peer crendentials\n");
 		}
+	}
 #endif
 #ifdef SCM_UCRED
-		ucred_t *cred = NULL;
-		pid_t tmp_pid = -1;
-		uid_t tmp_uid = 0;
-		pid = &tmp_pid;
-		uid = &tmp_uid;
-		if (-1 == getpeerucred(thread_ctx->fd, &cred)) {
-			if (debug) {
-				fprintf(stderr, "failed receiving peer credentials\n");
-			}
-		} else {
-			tmp_pid = ucred_getpid(cred);
-			tmp_uid = ucred_geteuid(cred);
-			ucred_free(cred);
+	ucred_t *cred = NULL;
+	pid_t tmp_pid = -1;
+	uid_t tmp_uid = 0;
+	pid = &tmp_pid;
+	uid = &tmp_uid;
+	if (-1 == getpeerucred(thread_ctx->fd, &cred)) {
+		if (debug) {
+			fprintf(stderr, "failed receiving peer credentials\n");
 		}
+	} else {
+		tmp_pid = ucred_getpid(cred);
+		tmp_uid = ucred_geteuid(cred);
+		ucred_free(cred);
+	}
 #endif
-		
-		ssize_t bytes_recv = jalls_recvmsg_helper(thread_ctx->fd, &msgh, debug);
-		if (bytes_recv < 0) {
-			if (debug) {
-				fprintf(stderr, "Failed to receive the message header\n");
-			}
-			goto out;
+
+	ssize_t bytes_recv = jalls_recvmsg_helper(thread_ctx->fd, &msgh, debug);
+	if (bytes_recv < 0) {
+		if (debug) {
+			fprintf(stderr, "Failed to receive the message header\n");
 		}
-		if (bytes_recv == 0) {
-			if (debug) {
-				fprintf(stderr, "The peer has shutdown\n");
-			}
-			goto out;
+		return -1;
+	}
+	if (bytes_recv == 0) {
+		if (debug) {
+			fprintf(stderr, "The peer has shutdown\n");
 		}
+		return 0;
+	}
 
-		//receive fd
-		struct cmsghdr *cmsg;
-		cmsg = CMSG_FIRSTHDR(&msgh);
-		while (cmsg != NULL) {
-			if (cmsg->cmsg_level == SOL_SOCKET) {
-				if (cmsg->cmsg_type == SCM_RIGHTS && cmsg->cmsg_len == CMSG_LEN(sizeof(msg_fd))) {
-					if (message_type != JALLS_JOURNAL_FD_MSG) {
-						if (debug) {
-							fprintf(stderr, "received an fd for a message type that was not journal_fd\n");
-						}
-						goto out;
-					}
-					void *tmp_fd = CMSG_DATA(cmsg);
-					if (debug && msg_fd != -1) {
-						fprintf(stderr, "received duplicate ancillary data: overwrote the fd\n");
+	//receive fd
+	struct cmsghdr *cmsg;
+	cmsg = CMSG_FIRSTHDR(&msgh);
+	while (cmsg != NULL) {
+		if (cmsg->cmsg_level == SOL_SOCKET) {
+			if (cmsg->cmsg_type == SCM_RIGHTS && cmsg->cmsg_len == CMSG_LEN(sizeof(msg_fd))) {
+				if (message_type != JALLS_JOURNAL_FD_MSG) {
+					if (debug) {
+						fprintf(stderr, "received an fd for a message type that was not journal_fd\n");
 					}
-					msg_fd = *((int *)tmp_fd);
-					if (msg_fd < 0) {
-						if (debug) {
-							fprintf(stderr, "received an fd < 0\n");
-						}
-						goto out;
+					return -1;
+				}
+				void *tmp_fd = CMSG_DATA(cmsg);
+				if (debug && msg_fd != -1) {
+					fprintf(stderr, "received duplicate ancillary data: overwrote the fd\n");
+				}
+				msg_fd = *((int *)tmp_fd);
+				if (msg_fd < 0) {
+					if (debug) {
+						fprintf(stderr, "received an fd < 0\n");
 					}
-				} else {
+					return -1;
+				}
+			} else if (cmsg->cmsg_type == SCM_RIGHTS && cmsg->cmsg_len == CMSG_LEN(sizeof(shm_fds))) {
+				memcpy(shm_fds, CMSG_DATA(cmsg), sizeof(shm_fds));
+				shm_fd_count = JALLS_SHM_SETUP_FDS;
+				if (message_type != JALLS_SHM_SETUP_MSG) {
 					if (debug) {
-						fprintf(stderr, "received unrecognized ancillary data\n");
+						fprintf(stderr, "received fds for a message type that was not shm_setup\n");
 					}
-					goto out;
+					err = -1;
+					goto err_out;
+				}
+			} else {
+				if (debug) {
+					fprintf(stderr, "received unrecognized ancillary data\n");
 				}
+				err = -1;
+				goto err_out;
 			}
-			cmsg = CMSG_NXTHDR(&msgh, cmsg);
 		}
+		cmsg = CMSG_NXTHDR(&msgh, cmsg);
+	}
 
 #ifdef SO_PEERCRED
-		thread_ctx->peer_pid = *pid;
-		thread_ctx->peer_uid = *uid;
-		if (debug && *pid == -1) {
-			thread_ctx->peer_pid = 0;
-			thread_ctx->peer_uid = 0;
+	thread_ctx->peer_pid = *pid;
+	thread_ctx->peer_uid = *uid;
+	if (debug && *pid == -1) {
+		thread_ctx->peer_pid = 0;
+		thread_ctx->peer_uid = 0;
 
-			fprintf(stderr, "Did not receive credentials\n");
-		}
+		fprintf(stderr, "Did not receive credentials\n");
+	}
 #endif
 
-		if (protocol_version != JPP_VERSION) {
-			if (debug) {
-				fprintf(stderr, "received protocol version != %d\n", JPP_VERSION);
-			}
-			return NULL;
+	if (protocol_version != JPP_VERSION) {
+		if (debug) {
+			fprintf(stderr, "received protocol version != %d\n", JPP_VERSION);
 		}
+		err = -1;
+		goto err_out;
+	}
 
-		//call appropriate handler
-		switch (message_type) {
-			case JALLS_LOG_MSG:
-				err = jalls_handle_log(thread_ctx, data_len, meta_len);
-				break;
-			case JALLS_AUDIT_MSG:
-				err = jalls_handle_audit(thread_ctx, data_len, meta_len);
-				break;
-			case JALLS_JOURNAL_MSG:
-				err = jalls_handle_journal(thread_ctx, data_len, meta_len);
-				break;
-			case JALLS_JOURNAL_FD_MSG:
-				if (msg_fd < 0) {
-					if (debug) {
-						fprintf(stderr, "Message type is journal_fd, but no fd was received\n");
-					}
-					goto out;
-				}
-				err = jalls_handle_journal_fd(thread_ctx, data_len, meta_len, msg_fd);
-				break;
-			default:
+	//call appropriate handler
+	switch (message_type) {
+		case JALLS_LOG_MSG:
+			err = jalls_handle_log(thread_ctx, data_len, meta_len);
+			break;
+		case JALLS_AUDIT_MSG:
+			err = jalls_handle_audit(thread_ctx, data_len, meta_len);
+			break;
+		case JALLS_JOURNAL_MSG:
+			err = jalls_handle_journal(thread_ctx, data_len, meta_len);
+			break;
+		case JALLS_JOURNAL_FD_MSG:
+			if (msg_fd < 0) {
 				if (debug) {
-					fprintf(stderr, "Message type is not legal.\n");
+					fprintf(stderr, "Message type is journal_fd, but no fd was received\n");
 				}
-				goto out;
-		}
-		if (err < 0) {
-			if (JALDB_E_INTERNAL_ERROR == err) {
-				should_exit = 1;
+				return -1;
 			}
-			goto out;
-		}
+			err = jalls_handle_journal_fd(thread_ctx, data_len, meta_len, msg_fd);
+			break;
+		case JALLS_BATCH_MSG:
+			err = jalls_handle_batch(thread_ctx, data_len, meta_len);
+			break;
+		case JALLS_SHM_SETUP_MSG:
+			// closes or keeps the descriptors
+			err = jalls_shm_setup(thread_ctx, shm_fds, shm_fd_count, data_len, meta_len);
+			shm_fd_count = 0;
+			break;
+		default:
+			if (debug) {
+				fprintf(stderr, "Message type is not legal.\n");
+			}
+			err = -1;
+			goto err_out;
 	}
+	if (err < 0) {
+		return err;
+	}
+	return 1;
 
-out:
-	close(thread_ctx->fd);
-	free(thread_ctx);
-	if (should_exit) {
-		kill(getpid(), SIGTERM);
+err_out:
+	for (int i = 0; i < shm_fd_count; i++) {
+		close(shm_fds[i]);
 	}
-	return NULL;
+	return err;
 }
 
 int jalls_handle_app_meta(uint8_t **app_meta_buf, size_t app_meta_len, int fd, int debug) {
@@ -40,8 +40,9 @@ extern "C" {
 
 /**
  * Waits for data to become available on the domain socket. When data appears,
- * calls handle_audit() handle_log(), handle_journal(), or handle_journal_fd(),
- * depending on the message type.
+ * calls handle_audit() handle_log(), handle_journal(), handle_journal_fd(), or
+ * handle_batch(), depending on the message type. Once the peer has set up a
+ * shared memory ring, waits on the ring as well with jalls_shm_handle_ready().
  *
  * @param[in] thread_ctx A pointer to a jalls_thread_context struct that holds
  * the fd for the connection, the key and cert to sign the system metadata,
@@ -49,6 +50,21 @@ extern "C" {
 */
 void *jalls_handler(void *thread_ctx);
 
+/**
+ * Receives a single message from the connection in \p thread_ctx and passes
+ * it to handle_audit() handle_log(), handle_journal(), handle_journal_fd(),
+ * handle_batch(), or jalls_shm_setup(), depending on the message type. Used by both jalls_handler()
+ * and the worker pool.
+ *
+ * @param[in] thread_ctx A pointer to a jalls_thread_context struct for the
+ * connection.
+ *
+ * @return 1 if a message was handled and the connection should be kept open,
+ * 0 if the peer has shutdown, or a negative value on error.
+ * JALDB_E_INTERNAL_ERROR indicates the local store should exit.
+ */
+int jalls_handle_message(struct jalls_thread_context *thread_ctx);
+
 int jalls_handle_app_meta(uint8_t **app_meta_buf, size_t app_meta_len, int fd, int debug);
 
 int jalls_handle_break(int fd);
@@ -0,0 +1,338 @@
+/**
+ * @file jalls_journal_copy.c This file contains functions to copy journal
+ * data received as a file descriptor into the database.
+ *
+ * @section LICENSE
+ *
+ * Source code in 3rd-party is licensed and owned by their respective
+ * copyright holders.
+ *
+ * All other source code is copyright Tresys Technology and licensed as below.
+ *
+ * Copyright (c) 2012 Tresys Technology LLC, Columbia, Maryland, USA
+ *
+ * This software was developed by Tresys Technology LLC
+ * with U.S. Government sponsorship.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/types.h>
+
+#include "jalls_journal_copy.h"
+
+#ifndef FICLONE
+#define FICLONE _IOW(0x94, 9, int)
+#endif
+
+#define JALLS_COPY_BUF_LEN 8192
+/** Largest request handed to copy_file_range() and splice() at once */
+#define JALLS_COPY_CHUNK_LEN (1024 * 1024 * 1024)
+/** Capacity of a default pipe, the most a single splice() moves */
+#define JALLS_SPLICE_PIPE_LEN (64 * 1024)
+/** Size of the window mapped at a time to digest the copied data */
+#define JALLS_DIGEST_MAP_LEN (64 * 1024 * 1024)
+
+/** The zero copy method is not supported for these files, try the next one */
+#define JALLS_COPY_UNSUPPORTED 1
+
+static int jalls_copy_unsupported_errno(int err)
+{
+	return EXDEV == err || EINVAL == err || ENOSYS == err || EOPNOTSUPP == err ||
+		ENOTTY == err || EBADF == err || EPERM == err;
+}
+
+static int jalls_write_all(int fd, const char *buf, size_t len)
+{
+	while (len > 0) {
+		ssize_t bytes_written = write(fd, buf, len);
+		if (bytes_written < 0) {
+			if (EINTR == errno) {
+				continue;
+			}
+			return -1;
+		}
+		buf += bytes_written;
+		len -= (size_t)bytes_written;
+	}
+	return 0;
+}
+
+static int jalls_copy_read_write(int src_fd, int dst_fd, uint64_t len,
+		struct jal_multi_digest *md, int debug)
+{
+	char data_buf[JALLS_COPY_BUF_LEN];
+	uint64_t bytes_remaining = len;
+
+	if ((off_t) -1 == lseek(src_fd, 0, SEEK_SET)) {
+		if (debug) {
+			fprintf(stderr, "failed to reset journal file to the beginning\n");
+		}
+	}
+	while (bytes_remaining > 0) {
+		size_t bytes_to_read = (bytes_remaining < JALLS_COPY_BUF_LEN) ?
+			bytes_remaining : JALLS_COPY_BUF_LEN;
+		ssize_t bytes_read = read(src_fd, data_buf, bytes_to_read);
+		if (bytes_read < 0 && EINTR == errno) {
+			continue;
+		}
+		if (bytes_read <= 0) {
+			if (debug) {
+				fprintf(stderr, "failed to read from file descriptor\n");
+			}
+			return -1;
+		}
+		if (JAL_OK != jal_multi_digest_update(md, (uint8_t *)data_buf, bytes_read)) {
+			if (debug) {
+				fprintf(stderr, "could not digest the journal data\n");
+			}
+			return -1;
+		}
+		if (0 != jalls_write_all(dst_fd, data_buf, bytes_read)) {
+			if (debug) {
+				fprintf(stderr, "could not write journal to file\n");
+			}
+			return -1;
+		}
+		bytes_remaining -= (uint64_t)bytes_read;
+	}
+	return 0;
+}
+
+static int jalls_copy_clone(int src_fd, int dst_fd)
+{
+	if (0 == ioctl(dst_fd, FICLONE, src_fd)) {
+		return 0;
+	}
+	return JALLS_COPY_UNSUPPORTED;
+}
+
+static int jalls_copy_range(int src_fd, int dst_fd, uint64_t len, int debug)
+{
+#ifdef __NR_copy_file_range
+	loff_t off_in = 0;
+	loff_t off_out = 0;
+	uint64_t bytes_remaining = len;
+
+	while (bytes_remaining > 0) {
+		size_t chunk = (bytes_remaining < JALLS_COPY_CHUNK_LEN) ?
+			bytes_remaining : JALLS_COPY_CHUNK_LEN;
+		ssize_t copied = syscall(__NR_copy_file_range, src_fd, &off_in,
+				dst_fd, &off_out, chunk, 0);
+		if (copied < 0) {
+			if (EINTR == errno) {
+				continue;
+			}
+			if (bytes_remaining == len && jalls_copy_unsupported_errno(errno)) {
+				return JALLS_COPY_UNSUPPORTED;
+			}
+		}
+		if (copied <= 0) {
+			if (debug) {
+				fprintf(stderr, "copy_file_range failed: %s\n",
+					copied ? strerror(errno) : "unexpected end of file");
+			}
+			return -1;
+		}
+		bytes_remaining -= (uint64_t)copied;
+	}
+	return 0;
+#else
+	(void) src_fd;
+	(void) dst_fd;
+	(void) len;
+	(void) debug;
+	return JALLS_COPY_UNSUPPORTED;
+#endif
+}
+
+static int jalls_copy_splice(int src_fd, int dst_fd, uint64_t len, int debug)
+{
+	int pipe_fds[2];
+	loff_t off_in = 0;
+	loff_t off_out = 0;
+	uint64_t bytes_remaining = len;
+	int ret = -1;
+
+	if (0 != pipe2(pipe_fds, O_CLOEXEC)) {
+		return JALLS_COPY_UNSUPPORTED;
+	}
+
+	while (bytes_remaining > 0) {
+		size_t chunk = (bytes_remaining < JALLS_SPLICE_PIPE_LEN) ?
+			bytes_remaining : JALLS_SPLICE_PIPE_LEN;
+		ssize_t in_pipe = splice(src_fd, &off_in, pipe_fds[1], NULL, chunk, SPLICE_F_MOVE);
+		if (in_pipe < 0) {
+			if (EINTR == errno) {
+				continue;
+			}
+			if (bytes_remaining == len && jalls_copy_unsupported_errno(errno)) {
+				ret = JALLS_COPY_UNSUPPORTED;
+				goto out;
+			}
+		}
+		if (in_pipe <= 0) {
+			if (debug) {
+				fprintf(stderr, "splice from journal failed: %s\n",
+					in_pipe ? strerror(errno) : "unexpected end of file");
+			}
+			goto out;
+		}
+		while (in_pipe > 0) {
+			ssize_t out_pipe = splice(pipe_fds[0], NULL, dst_fd, &off_out,
+					in_pipe, SPLICE_F_MOVE);
+			if (out_pipe < 0 && EINTR == errno) {
+				continue;
+			}
+			if (out_pipe <= 0) {
+				if (debug) {
+					fprintf(stderr, "splice to database file failed: %s\n",
+						strerror(errno));
+				}
+				goto out;
+			}
+			in_pipe -= out_pipe;
+			bytes_remaining -= (uint64_t)out_pipe;
+		}
+	}
+	ret = 0;
+
+out:
+	close(pipe_fds[0]);
+	close(pipe_fds[1]);
+	return ret;
+}
+
+static int jalls_digest_pread(int fd, uint64_t len, struct jal_multi_digest *md)
+{
+	char data_buf[JALLS_COPY_BUF_LEN];
+	uint64_t offset = 0;
+
+	while (offset < len) {
+		size_t bytes_to_read = (len - offset < JALLS_COPY_BUF_LEN) ?
+			len - offset : JALLS_COPY_BUF_LEN;
+		ssize_t bytes_read = pread(fd, data_buf, bytes_to_read, offset);
+		if (bytes_read < 0 && EINTR == errno) {
+			continue;
+		}
+		if (bytes_read <= 0 ||
+				JAL_OK != jal_multi_digest_update(md, (uint8_t *)data_buf, bytes_read)) {
+			return -1;
+		}
+		offset += (uint64_t)bytes_read;
+	}
+	return 0;
+}
+
+/*
+ * The copy is digested rather than the producer's file, so the manifest
+ * describes what was stored even if the producer keeps writing to its file.
+ */
+static int jalls_digest_copy(int fd, uint64_t len, struct jal_multi_digest *md, int debug)
+{
+	uint64_t offset = 0;
+
+	while (offset < len) {
+		size_t map_len = (len - offset < JALLS_DIGEST_MAP_LEN) ?
+			len - offset : JALLS_DIGEST_MAP_LEN;
+		void *map = mmap(NULL, map_len, PROT_READ, MAP_SHARED, fd, offset);
+		if (MAP_FAILED == map) {
+			if (0 != offset) {
+				if (debug) {
+					fprintf(stderr, "failed to map the journal copy: %s\n",
+						strerror(errno));
+				}
+				return -1;
+			}
+			return jalls_digest_pread(fd, len, md);
+		}
+		madvise(map, map_len, MADV_SEQUENTIAL);
+		enum jal_status jal_err = jal_multi_digest_update(md, map, map_len);
+		munmap(map, map_len);
+		if (JAL_OK != jal_err) {
+			if (debug) {
+				fprintf(stderr, "could not digest the journal data\n");
+			}
+			return -1;
+		}
+		offset += map_len;
+	}
+	return 0;
+}
+
+int jalls_copy_journal_fd(int src_fd, int dst_fd, uint64_t len,
+		struct jal_multi_digest *md, int zero_copy,
+		enum jalls_copy_method *method, int debug)
+{
+	struct stat st;
+	enum jalls_copy_method used = JALLS_COPY_READ_WRITE;
+	int ret = JALLS_COPY_UNSUPPORTED;
+
+	if (src_fd < 0 || dst_fd < 0 || !md) {
+		return -1;
+	}
+
+	if (zero_copy && 0 == fstat(src_fd, &st) && S_ISREG(st.st_mode) &&
+			(uint64_t)st.st_size >= len) {
+		if ((uint64_t)st.st_size == len) {
+			used = JALLS_COPY_CLONE;
+			ret = jalls_copy_clone(src_fd, dst_fd);
+		}
+		if (JALLS_COPY_UNSUPPORTED == ret) {
+			used = JALLS_COPY_RANGE;
+			ret = jalls_copy_range(src_fd, dst_fd, len, debug);
+		}
+		if (JALLS_COPY_UNSUPPORTED == ret) {
+			used = JALLS_COPY_SPLICE;
+			ret = jalls_copy_splice(src_fd, dst_fd, len, debug);
+		}
+		if (0 == ret) {
+			ret = jalls_digest_copy(dst_fd, len, md, debug);
+		}
+	}
+
+	if (JALLS_COPY_UNSUPPORTED == ret) {
+		used = JALLS_COPY_READ_WRITE;
+		ret = jalls_copy_read_write(src_fd, dst_fd, len, md, debug);
+	}
+
+	if (0 == ret && method) {
+		*method = used;
+	}
+	return ret;
+}
+
+const char *jalls_copy_method_str(enum jalls_copy_method method)
+{
+	switch (method) {
+	case JALLS_COPY_CLONE:
+		return "clone";
+	case JALLS_COPY_RANGE:
+		return "copy_file_range";
+	case JALLS_COPY_SPLICE:
+		return "splice";
+	case JALLS_COPY_READ_WRITE:
+		return "read/write";
+	default:
+		return "unknown";
+	}
+}
@@ -0,0 +1,87 @@
+/**
+ * @file jalls_journal_copy.h This file contains functions to copy journal
+ * data received as a file descriptor into the database.
+ *
+ * @section LICENSE
+ *
+ * Source code in 3rd-party is licensed and owned by their respective
+ * copyright holders.
+ *
+ * All other source code is copyright Tresys Technology and licensed as below.
+ *
+ * Copyright (c) 2012 Tresys Technology LLC, Columbia, Maryland, USA
+ *
+ * This software was developed by Tresys Technology LLC
+ * with U.S. Government sponsorship.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _JALLS_JOURNAL_COPY_H_
+#define _JALLS_JOURNAL_COPY_H_
+
+#include <stdint.h>
+#include <jalop/jal_digest.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * The ways journal data can be copied, from fastest to slowest.
+ */
+enum jalls_copy_method {
+	/** Share the extents of the source file (FICLONE) */
+	JALLS_COPY_CLONE,
+	/** Copy inside the kernel with copy_file_range() */
+	JALLS_COPY_RANGE,
+	/** Move pages through a pipe with splice() */
+	JALLS_COPY_SPLICE,
+	/** read() and write() through a user space buffer */
+	JALLS_COPY_READ_WRITE,
+};
+
+/**
+ * Copy the first \p len bytes of \p src_fd to the start of \p dst_fd and
+ * digest them.
+ *
+ * When \p zero_copy is set and \p src_fd is a regular file, the data is
+ * copied without passing through user space, trying each of
+ * JALLS_COPY_CLONE, JALLS_COPY_RANGE and JALLS_COPY_SPLICE in turn, and the
+ * copy in \p dst_fd is then digested through a read only mapping. Otherwise
+ * the data is read into a buffer, digested and written out.
+ *
+ * @param[in] src_fd The journal file received from the producer.
+ * @param[in] dst_fd The empty file that receives the journal data.
+ * @param[in] len The number of bytes to copy.
+ * @param[in] md The digest to update with the journal data.
+ * @param[in] zero_copy Whether to try the zero copy methods.
+ * @param[out] method Optional, receives the method used to copy the data.
+ * @param[in] debug Whether to print debug messages.
+ *
+ * @return 0 on success, -1 on error.
+ */
+int jalls_copy_journal_fd(int src_fd, int dst_fd, uint64_t len,
+		struct jal_multi_digest *md, int zero_copy,
+		enum jalls_copy_method *method, int debug);
+
+/**
+ * Get a printable name for a copy method.
+ */
+const char *jalls_copy_method_str(enum jalls_copy_method method);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _JALLS_JOURNAL_COPY_H_
@@ -98,7 +98,7 @@ int jalls_create_record(enum jaldb_rec_type rec_type, struct jalls_thread_contex
 		return -1;
 	}
 
-	struct jaldb_record *rec = jaldb_create_record();
+	struct jaldb_record *rec = jaldb_create_arena_record();
 
 	rec->type = rec_type;
 #ifdef SO_PEERCRED
@@ -106,7 +106,7 @@ int jalls_create_record(enum jaldb_rec_type rec_type, struct jalls_thread_contex
 	rec->have_uid = 1;
 	rec->uid = thread_ctx->peer_uid;
 #endif
-	rec->hostname = jal_strdup(thread_ctx->ctx->hostname);
+	rec->hostname = jaldb_record_strdup(rec, thread_ctx->ctx->hostname);
 	rec->timestamp = timestamp;
 #ifdef SO_PEERCRED
 	rec->username = jalls_get_user_id_str(thread_ctx->peer_uid);
@@ -0,0 +1,394 @@
+/**
+ * @file jalls_shm.c This file contains the functions used to receive
+ * records through a shared memory ring set up by a producer.
+ *
+ * @section LICENSE
+ *
+ * Source code in 3rd-party is licensed and owned by their respective
+ * copyright holders.
+ *
+ * All other source code is copyright Tresys Technology and licensed as below.
+ *
+ * Copyright (c) 2012 Tresys Technology LLC, Columbia, Maryland, USA
+ *
+ * This software was developed by Tresys Technology LLC
+ * with U.S. Government sponsorship.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <jalop/jal_version.h>
+#include "jal_alloc.h"
+#include "jal_shm_ring.h"
+#include "jalls_batch.h"
+#include "jalls_handler.h"
+#include "jalls_handle_batch.hpp"
+#include "jalls_shm.h"
+
+// These match the message types in jalls_handler.c
+#define JALLS_SHM_LOG_MSG 1
+#define JALLS_SHM_AUDIT_MSG 2
+
+#define JALLS_SHM_MAX_EVENTS 2
+
+struct jalls_shm {
+	struct jal_shm_ring ring;
+	void *map;
+	size_t map_len;
+	/** Written to by the producer when it adds records */
+	int data_efd;
+	/** Written to when records are taken out of the ring */
+	int space_efd;
+	/** An epoll instance watching the socket and data_efd */
+	int wait_fd;
+};
+
+static void jalls_shm_close_fds(int *fds, int fd_count)
+{
+	for (int i = 0; i < fd_count; i++) {
+		if (0 <= fds[i]) {
+			close(fds[i]);
+			fds[i] = -1;
+		}
+	}
+}
+
+static int jalls_shm_answer(int fd, uint8_t answer)
+{
+	struct iovec iov;
+	iov.iov_base = &answer;
+	iov.iov_len = sizeof(answer);
+
+	struct msghdr msgh;
+	memset(&msgh, 0, sizeof(msgh));
+	msgh.msg_iov = &iov;
+	msgh.msg_iovlen = 1;
+
+	ssize_t sent;
+	do {
+		sent = sendmsg(fd, &msgh, MSG_NOSIGNAL);
+	} while (-1 == sent && EINTR == errno);
+	return (sizeof(answer) == sent) ? 0 : -1;
+}
+
+/**
+ * Both sides only read the eventfds once they are known to be readable, and
+ * the local store must never block writing to one.
+ */
+static int jalls_shm_eventfd_ok(int fd)
+{
+	int flags = fcntl(fd, F_GETFL);
+	return -1 != flags && (flags & O_NONBLOCK);
+}
+
+static int jalls_shm_watch(int wait_fd, int fd, uint32_t events)
+{
+	struct epoll_event ev;
+	memset(&ev, 0, sizeof(ev));
+	ev.events = events;
+	ev.data.fd = fd;
+	return epoll_ctl(wait_fd, EPOLL_CTL_ADD, fd, &ev);
+}
+
+int jalls_shm_setup(struct jalls_thread_context *thread_ctx, int *fds, int fd_count,
+		uint64_t data_len, uint64_t meta_len)
+{
+	if (!thread_ctx || !thread_ctx->ctx || !fds || 0 > fd_count) {
+		return -1; //should never happen.
+	}
+
+	int debug = thread_ctx->ctx->debug;
+	int ret = -1;
+	const char *why = NULL;
+	struct jalls_shm *shm = NULL;
+	struct stat st;
+
+	if (0 != data_len || 0 != meta_len ||
+			0 != jalls_handle_break(thread_ctx->fd) ||
+			0 != jalls_handle_break(thread_ctx->fd)) {
+		if (debug) {
+			fprintf(stderr, "malformed shm setup message\n");
+		}
+		goto out;
+	}
+
+	if (thread_ctx->shm) {
+		why = "the connection already has one";
+		goto refuse;
+	}
+	if (0 == thread_ctx->ctx->shm_max_ring_size) {
+		why = "shared memory is disabled";
+		goto refuse;
+	}
+	if (JALLS_SHM_SETUP_FDS != fd_count) {
+		why = "wrong number of file descriptors";
+		goto refuse;
+	}
+	if (0 >= thread_ctx->peer_pid) {
+		why = "no peer credentials";
+		goto refuse;
+	}
+
+	// The ring must belong to the process at the other end of the
+	// socket, and must not be able to shrink while it is mapped.
+	if (-1 == fstat(fds[0], &st) || !S_ISREG(st.st_mode) ||
+			st.st_uid != thread_ctx->peer_uid) {
+		why = "not owned by the peer";
+		goto refuse;
+	}
+	int seals = fcntl(fds[0], F_GET_SEALS);
+	if (-1 == seals || !(seals & F_SEAL_SHRINK)) {
+		why = "not sealed";
+		goto refuse;
+	}
+	if (st.st_size <= JAL_SHM_RING_HEADER_SIZE ||
+			(uint64_t) st.st_size > jal_shm_ring_map_size(thread_ctx->ctx->shm_max_ring_size)) {
+		why = "bad size";
+		goto refuse;
+	}
+	if (!jalls_shm_eventfd_ok(fds[1]) || !jalls_shm_eventfd_ok(fds[2])) {
+		why = "blocking doorbell";
+		goto refuse;
+	}
+
+	shm = jal_calloc(1, sizeof(*shm));
+	shm->data_efd = fds[1];
+	shm->space_efd = fds[2];
+	shm->wait_fd = -1;
+	fds[1] = -1;
+	fds[2] = -1;
+
+	shm->map = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fds[0], 0);
+	if (MAP_FAILED == shm->map) {
+		shm->map = NULL;
+		why = "mmap failed";
+		goto refuse;
+	}
+	shm->map_len = st.st_size;
+	if (0 != jal_shm_ring_attach(&shm->ring, shm->map, shm->map_len)) {
+		why = "bad ring header";
+		goto refuse;
+	}
+
+	shm->wait_fd = epoll_create1(EPOLL_CLOEXEC);
+	if (-1 == shm->wait_fd ||
+			-1 == jalls_shm_watch(shm->wait_fd, thread_ctx->fd, EPOLLIN | EPOLLRDHUP) ||
+			-1 == jalls_shm_watch(shm->wait_fd, shm->data_efd, EPOLLIN)) {
+		why = "could not watch the doorbell";
+		goto refuse;
+	}
+
+	// So the first record rings the doorbell
+	jal_shm_ring_consumer_wait(&shm->ring);
+
+	if (0 != jalls_shm_answer(thread_ctx->fd, 0)) {
+		if (debug) {
+			fprintf(stderr, "failed to answer shm setup\n");
+		}
+		goto out;
+	}
+	if (debug) {
+		fprintf(stderr, "Receiving records through a %" PRIu64 " byte ring\n", shm->ring.size);
+	}
+	thread_ctx->shm = shm;
+	shm = NULL;
+	ret = 0;
+	goto out;
+
+refuse:
+	if (debug) {
+		fprintf(stderr, "turned down shared memory ring: %s\n", why);
+	}
+	ret = jalls_shm_answer(thread_ctx->fd, 1);
+
+out:
+	jalls_shm_close_fds(fds, fd_count);
+	jalls_shm_destroy(&shm);
+	return ret;
+}
+
+/**
+ * Add a frame taken from the ring to \p entries.
+ */
+static int jalls_shm_add_frame(const struct jal_shm_ring_frame *frame,
+		struct jalls_batch_entry **entries, uint32_t *count, uint32_t *size)
+{
+	struct jalls_batch_entry *batch = NULL;
+	uint32_t batch_count = 1;
+	struct jalls_batch_entry single;
+
+	if (JPP_VERSION != frame->protocol_version) {
+		return -1;
+	}
+
+	switch (frame->message_type) {
+	case JALLS_SHM_LOG_MSG:
+	case JALLS_SHM_AUDIT_MSG:
+		single.message_type = frame->message_type;
+		single.data = frame->data_len ? frame->data : NULL;
+		single.data_len = frame->data_len;
+		single.meta = frame->meta_len ? frame->meta : NULL;
+		single.meta_len = frame->meta_len;
+		if (0 != jalls_check_batch_entry(&single)) {
+			return -1;
+		}
+		batch = &single;
+		break;
+	case JALLS_BATCH_MSG:
+		if (0 != frame->meta_len ||
+				0 != jalls_parse_batch(frame->data, frame->data_len, &batch, &batch_count)) {
+			return -1;
+		}
+		break;
+	default:
+		return -1;
+	}
+
+	if (*count + batch_count > *size) {
+		*size = *count + batch_count + JALLS_BATCH_MAX_RECORDS;
+		*entries = jal_realloc(*entries, *size * sizeof(**entries));
+	}
+	memcpy(*entries + *count, batch, batch_count * sizeof(*batch));
+	*count += batch_count;
+	if (batch != &single) {
+		free(batch);
+	}
+	return 0;
+}
+
+/**
+ * Store every record in the ring, in place, then hand the space back to
+ * the producer. Records are inserted JALLS_BATCH_MAX_RECORDS or so at a
+ * time.
+ */
+static int jalls_shm_drain(struct jalls_thread_context *thread_ctx)
+{
+	struct jalls_shm *shm = thread_ctx->shm;
+	int debug = thread_ctx->ctx->debug;
+	struct jalls_batch_entry *entries = NULL;
+	uint32_t count = 0;
+	uint32_t size = 0;
+	uint64_t pos = shm->ring.pos;
+	struct jal_shm_ring_frame frame;
+	int ret = -1;
+	int err;
+
+	for (;;) {
+		err = jal_shm_ring_next(&shm->ring, &pos, &frame);
+		if (0 > err || (0 < err && 0 != jalls_shm_add_frame(&frame, &entries, &count, &size))) {
+			if (debug) {
+				fprintf(stderr, "malformed record in the shared memory ring\n");
+			}
+			goto out;
+		}
+		if (0 < err && count < JALLS_BATCH_MAX_RECORDS) {
+			continue;
+		}
+
+		if (count) {
+			err = jalls_insert_batch_entries(thread_ctx, entries, count);
+			if (0 != err) {
+				ret = err;
+				goto out;
+			}
+			count = 0;
+			if (jal_shm_ring_release(&shm->ring, pos)) {
+				uint64_t one = 1;
+				if (-1 == write(shm->space_efd, &one, sizeof(one))) {
+					// The counter is full, so the producer
+					// is awake anyway
+				}
+			}
+			continue;
+		}
+
+		if (jal_shm_ring_consumer_wait(&shm->ring)) {
+			break;
+		}
+	}
+	ret = 0;
+
+out:
+	free(entries);
+	return ret;
+}
+
+int jalls_shm_handle_ready(struct jalls_thread_context *thread_ctx, int timeout_ms)
+{
+	if (!thread_ctx || !thread_ctx->ctx || !thread_ctx->shm) {
+		return -1; //should never happen.
+	}
+
+	struct jalls_shm *shm = thread_ctx->shm;
+	struct epoll_event events[JALLS_SHM_MAX_EVENTS];
+	int socket_ready = 0;
+	int err;
+
+	int nfds = epoll_wait(shm->wait_fd, events, JALLS_SHM_MAX_EVENTS, timeout_ms);
+	if (-1 == nfds) {
+		return (EINTR == errno) ? 1 : -1;
+	}
+	for (int i = 0; i < nfds; i++) {
+		if (events[i].data.fd == thread_ctx->fd) {
+			socket_ready = 1;
+		}
+	}
+
+	// Reset the doorbell before looking at the ring, so a record added
+	// from now on rings it again.
+	uint64_t rings;
+	if (-1 == read(shm->data_efd, &rings, sizeof(rings)) && EAGAIN != errno) {
+		return -1;
+	}
+
+	err = jalls_shm_drain(thread_ctx);
+	if (0 > err) {
+		return err;
+	}
+	if (socket_ready) {
+		return jalls_handle_message(thread_ctx);
+	}
+	return 1;
+}
+
+int jalls_shm_get_wait_fd(struct jalls_shm *shm)
+{
+	return shm ? shm->wait_fd : -1;
+}
+
+void jalls_shm_destroy(struct jalls_shm **shm)
+{
+	if (!shm || !*shm) {
+		return;
+	}
+	if ((*shm)->map) {
+		munmap((*shm)->map, (*shm)->map_len);
+	}
+	int fds[3] = { (*shm)->data_efd, (*shm)->space_efd, (*shm)->wait_fd };
+	jalls_shm_close_fds(fds, 3);
+	free(*shm);
+	*shm = NULL;
+}
@@ -0,0 +1,107 @@
+/**
+ * @file jalls_shm.h This file defines the functions used to receive records
+ * through a shared memory ring set up by a producer.
+ *
+ * @section LICENSE
+ *
+ * Source code in 3rd-party is licensed and owned by their respective
+ * copyright holders.
+ *
+ * All other source code is copyright Tresys Technology and licensed as below.
+ *
+ * Copyright (c) 2012 Tresys Technology LLC, Columbia, Maryland, USA
+ *
+ * This software was developed by Tresys Technology LLC
+ * with U.S. Government sponsorship.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _JALLS_SHM_H_
+#define _JALLS_SHM_H_
+
+#include <stdint.h>
+
+#include "jalls_context.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * A shm setup message offers a ring, described in jal_shm_ring.h, for the
+ * rest of the connection. It has no data or application metadata, and
+ * carries JALLS_SHM_SETUP_FDS file descriptors: the sealed memfd holding
+ * the ring, the eventfd the producer writes to when it adds records, and
+ * the eventfd the local store writes to when it makes room. The local store
+ * answers with one byte, 0 if it took the ring and 1 if it did not.
+ *
+ * Once the ring is taken, log, audit and batch messages arrive through it
+ * and journal messages still arrive on the socket. The producer waits for
+ * the ring to empty before it uses the socket, so records stay in order.
+ */
+#define JALLS_SHM_SETUP_MSG 6
+#define JALLS_SHM_SETUP_FDS 3
+
+/** The ring of a connection */
+struct jalls_shm;
+
+/**
+ * Check the ring offered by a shm setup message and take it if it is
+ * acceptable. The peer credentials gathered from the socket are checked
+ * here, once, and used for every record that comes through the ring.
+ *
+ * @param[in] thread_ctx The connection, whose ring is set on success.
+ * @param[in] fds The file descriptors that came with the message, which
+ * are closed or kept in the ring.
+ * @param[in] fd_count The number of file descriptors.
+ * @param[in] data_len Must be 0.
+ * @param[in] meta_len Must be 0.
+ *
+ * @return 0 if the ring was taken or turned down, -1 if the message was
+ * malformed.
+ */
+int jalls_shm_setup(struct jalls_thread_context *thread_ctx, int *fds, int fd_count,
+		uint64_t data_len, uint64_t meta_len);
+
+/**
+ * Wait for records in the ring or a message on the socket of a connection
+ * with a ring, and handle them.
+ *
+ * @param[in] thread_ctx The connection.
+ * @param[in] timeout_ms How long to wait, or -1 to wait until something
+ * arrives.
+ *
+ * @return Like jalls_handle_message(), 1 if the connection should be kept
+ * open, 0 if the peer has shutdown, or a negative value on error.
+ */
+int jalls_shm_handle_ready(struct jalls_thread_context *thread_ctx, int timeout_ms);
+
+/**
+ * Get the file descriptor that becomes readable when the ring or the
+ * socket of a connection needs attention.
+ */
+int jalls_shm_get_wait_fd(struct jalls_shm *shm);
+
+/**
+ * Unmap the ring and close its file descriptors.
+ *
+ * @param[in,out] shm The ring. Set to NULL.
+ */
+void jalls_shm_destroy(struct jalls_shm **shm);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _JALLS_SHM_H_
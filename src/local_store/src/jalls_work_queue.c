@@ -0,0 +1,137 @@
+/**
+ * @file jalls_work_queue.c This file contains a bounded, blocking queue used
+ * to hand connections from the epoll loop to the worker pool.
+ *
+ * @section LICENSE
+ *
+ * Source code in 3rd-party is licensed and owned by their respective
+ * copyright holders.
+ *
+ * All other source code is copyright Tresys Technology and licensed as below.
+ *
+ * Copyright (c) 2012 Tresys Technology LLC, Columbia, Maryland, USA
+ *
+ * This software was developed by Tresys Technology LLC
+ * with U.S. Government sponsorship.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <pthread.h>
+#include <stdlib.h>
+
+#include "jal_alloc.h"
+#include "jalls_work_queue.h"
+
+struct jalls_work_queue {
+	pthread_mutex_t lock;
+	pthread_cond_t not_empty;
+	pthread_cond_t not_full;
+	void **items;
+	size_t capacity;
+	size_t head;
+	size_t count;
+	int closed;
+};
+
+struct jalls_work_queue *jalls_work_queue_create(size_t capacity)
+{
+	if (0 == capacity) {
+		return NULL;
+	}
+	struct jalls_work_queue *queue = jal_calloc(1, sizeof(*queue));
+	queue->items = jal_calloc(capacity, sizeof(*queue->items));
+	queue->capacity = capacity;
+	pthread_mutex_init(&queue->lock, NULL);
+	pthread_cond_init(&queue->not_empty, NULL);
+	pthread_cond_init(&queue->not_full, NULL);
+	return queue;
+}
+
+void jalls_work_queue_destroy(struct jalls_work_queue **queue)
+{
+	if (!queue || !*queue) {
+		return;
+	}
+	pthread_cond_destroy(&(*queue)->not_full);
+	pthread_cond_destroy(&(*queue)->not_empty);
+	pthread_mutex_destroy(&(*queue)->lock);
+	free((*queue)->items);
+	free(*queue);
+	*queue = NULL;
+}
+
+int jalls_work_queue_push(struct jalls_work_queue *queue, void *item)
+{
+	if (!queue || !item) {
+		return -1;
+	}
+	pthread_mutex_lock(&queue->lock);
+	while (queue->count == queue->capacity && !queue->closed) {
+		pthread_cond_wait(&queue->not_full, &queue->lock);
+	}
+	if (queue->closed) {
+		pthread_mutex_unlock(&queue->lock);
+		return -1;
+	}
+	queue->items[(queue->head + queue->count) % queue->capacity] = item;
+	queue->count++;
+	pthread_cond_signal(&queue->not_empty);
+	pthread_mutex_unlock(&queue->lock);
+	return 0;
+}
+
+void *jalls_work_queue_pop(struct jalls_work_queue *queue)
+{
+	void *item = NULL;
+	if (!queue) {
+		return NULL;
+	}
+	pthread_mutex_lock(&queue->lock);
+	while (0 == queue->count && !queue->closed) {
+		pthread_cond_wait(&queue->not_empty, &queue->lock);
+	}
+	if (0 < queue->count) {
+		item = queue->items[queue->head];
+		queue->items[queue->head] = NULL;
+		queue->head = (queue->head + 1) % queue->capacity;
+		queue->count--;
+		pthread_cond_signal(&queue->not_full);
+	}
+	pthread_mutex_unlock(&queue->lock);
+	return item;
+}
+
+void jalls_work_queue_close(struct jalls_work_queue *queue)
+{
+	if (!queue) {
+		return;
+	}
+	pthread_mutex_lock(&queue->lock);
+	queue->closed = 1;
+	pthread_cond_broadcast(&queue->not_empty);
+	pthread_cond_broadcast(&queue->not_full);
+	pthread_mutex_unlock(&queue->lock);
+}
+
+size_t jalls_work_queue_depth(struct jalls_work_queue *queue)
+{
+	size_t depth;
+	if (!queue) {
+		return 0;
+	}
+	pthread_mutex_lock(&queue->lock);
+	depth = queue->count;
+	pthread_mutex_unlock(&queue->lock);
+	return depth;
+}
@@ -0,0 +1,96 @@
+/**
+ * @file jalls_work_queue.h This file contains a bounded, blocking queue used
+ * to hand connections from the epoll loop to the worker pool.
+ *
+ * @section LICENSE
+ *
+ * Source code in 3rd-party is licensed and owned by their respective
+ * copyright holders.
+ *
+ * All other source code is copyright Tresys Technology and licensed as below.
+ *
+ * Copyright (c) 2012 Tresys Technology LLC, Columbia, Maryland, USA
+ *
+ * This software was developed by Tresys Technology LLC
+ * with U.S. Government sponsorship.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _JALLS_WORK_QUEUE_H_
+#define _JALLS_WORK_QUEUE_H_
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct jalls_work_queue;
+
+/**
+ * Create a work queue that holds at most \p capacity items.
+ *
+ * @param[in] capacity The maximum number of queued items, must be > 0.
+ *
+ * @return the new queue, or NULL if \p capacity is 0.
+ */
+struct jalls_work_queue *jalls_work_queue_create(size_t capacity);
+
+/**
+ * Destroy a work queue. Any items still in the queue are not freed.
+ *
+ * @param[in,out] queue The queue to destroy, will be set to NULL.
+ */
+void jalls_work_queue_destroy(struct jalls_work_queue **queue);
+
+/**
+ * Add an item to the tail of the queue. If the queue is full, the caller
+ * blocks until a consumer removes an item or the queue is closed.
+ *
+ * @param[in] queue The queue.
+ * @param[in] item The item to add, must not be NULL.
+ *
+ * @return 0 on success, -1 if the queue was closed or the arguments are
+ * invalid.
+ */
+int jalls_work_queue_push(struct jalls_work_queue *queue, void *item);
+
+/**
+ * Remove an item from the head of the queue. If the queue is empty, the
+ * caller blocks until an item is added or the queue is closed.
+ *
+ * @param[in] queue The queue.
+ *
+ * @return the item, or NULL once the queue is closed and drained.
+ */
+void *jalls_work_queue_pop(struct jalls_work_queue *queue);
+
+/**
+ * Close the queue and wake up every blocked producer and consumer. Items
+ * already queued can still be popped.
+ *
+ * @param[in] queue The queue.
+ */
+void jalls_work_queue_close(struct jalls_work_queue *queue);
+
+/**
+ * @return the number of items currently in the queue.
+ */
+size_t jalls_work_queue_depth(struct jalls_work_queue *queue);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _JALLS_WORK_QUEUE_H_
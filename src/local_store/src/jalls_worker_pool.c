@@ -0,0 +1,313 @@
+/**
+ * @file jalls_worker_pool.c This file contains the epoll based connection
+ * engine for the jal local store.
+ *
+ * @section LICENSE
+ *
+ * Source code in 3rd-party is licensed and owned by their respective
+ * copyright holders.
+ *
+ * All other source code is copyright Tresys Technology and licensed as below.
+ *
+ * Copyright (c) 2012 Tresys Technology LLC, Columbia, Maryland, USA
+ *
+ * This software was developed by Tresys Technology LLC
+ * with U.S. Government sponsorship.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+
+#include "jal_alloc.h"
+#include "jalls_handler.h"
+#include "jalls_shm.h"
+#include "jalls_work_queue.h"
+#include "jalls_worker_pool.h"
+
+#define JALLS_EPOLL_MAX_EVENTS 64
+#define JALLS_EPOLL_TIMEOUT_MS 1000
+#define JALLS_CONN_EVENTS (EPOLLIN | EPOLLRDHUP | EPOLLONESHOT)
+
+extern volatile int should_exit;
+
+/** A connection owned by the worker pool */
+struct jalls_pool_conn {
+	/** The context handed to jalls_handle_message() */
+	struct jalls_thread_context thread_ctx;
+	struct jalls_pool_conn *prev;
+	struct jalls_pool_conn *next;
+};
+
+struct jalls_worker_pool {
+	int epoll_fd;
+	int listen_fd;
+	int debug;
+	int max_conns;
+	const struct jalls_thread_context *proto_ctx;
+	struct jalls_work_queue *queue;
+	pthread_t *workers;
+	int worker_count;
+	/** Protects the fields below */
+	pthread_mutex_t lock;
+	/** Set while listen_fd is armed in the epoll set */
+	int listening;
+	int open_conns;
+	/** Every open connection, whether idle, queued or being serviced */
+	struct jalls_pool_conn *conns;
+};
+
+static int jalls_pool_set_listening(struct jalls_worker_pool *pool, int listening)
+{
+	struct epoll_event ev;
+	memset(&ev, 0, sizeof(ev));
+	ev.events = listening ? EPOLLIN : 0;
+	ev.data.ptr = NULL;
+	if (-1 == epoll_ctl(pool->epoll_fd, EPOLL_CTL_MOD, pool->listen_fd, &ev)) {
+		if (pool->debug) {
+			fprintf(stderr, "Failed to %s the listening socket: %s\n",
+				listening ? "resume" : "pause", strerror(errno));
+		}
+		return -1;
+	}
+	pool->listening = listening;
+	return 0;
+}
+
+static void jalls_pool_close_conn(struct jalls_worker_pool *pool, struct jalls_pool_conn *conn)
+{
+	pthread_mutex_lock(&pool->lock);
+	if (conn->prev) {
+		conn->prev->next = conn->next;
+	} else {
+		pool->conns = conn->next;
+	}
+	if (conn->next) {
+		conn->next->prev = conn->prev;
+	}
+	pool->open_conns--;
+	if (!pool->listening && !should_exit && pool->open_conns < pool->max_conns) {
+		jalls_pool_set_listening(pool, 1);
+	}
+	pthread_mutex_unlock(&pool->lock);
+
+	jalls_shm_destroy(&conn->thread_ctx.shm);
+	close(conn->thread_ctx.fd);
+	free(conn);
+}
+
+static void jalls_pool_accept(struct jalls_worker_pool *pool)
+{
+	int fd = accept(pool->listen_fd, NULL, NULL);
+	if (-1 == fd) {
+		if (pool->debug) {
+			fprintf(stderr, "Failed to accept: %s\n", strerror(errno));
+		}
+		return;
+	}
+
+	struct jalls_pool_conn *conn = jal_calloc(1, sizeof(*conn));
+	conn->thread_ctx = *pool->proto_ctx;
+	conn->thread_ctx.fd = fd;
+	conn->thread_ctx.peer_pid = 0;
+	conn->thread_ctx.peer_uid = 0;
+
+	pthread_mutex_lock(&pool->lock);
+	conn->next = pool->conns;
+	if (pool->conns) {
+		pool->conns->prev = conn;
+	}
+	pool->conns = conn;
+	pool->open_conns++;
+	if (pool->open_conns >= pool->max_conns) {
+		if (pool->debug) {
+			fprintf(stderr, "Reached %d connections, pausing accept\n", pool->open_conns);
+		}
+		jalls_pool_set_listening(pool, 0);
+	}
+	pthread_mutex_unlock(&pool->lock);
+
+	struct epoll_event ev;
+	memset(&ev, 0, sizeof(ev));
+	ev.events = JALLS_CONN_EVENTS;
+	ev.data.ptr = conn;
+	if (-1 == epoll_ctl(pool->epoll_fd, EPOLL_CTL_ADD, fd, &ev)) {
+		if (pool->debug) {
+			fprintf(stderr, "Failed to add connection to epoll set: %s\n", strerror(errno));
+		}
+		jalls_pool_close_conn(pool, conn);
+	}
+}
+
+static void *jalls_pool_worker(void *arg)
+{
+	struct jalls_worker_pool *pool = arg;
+	struct jalls_pool_conn *conn;
+
+	while (NULL != (conn = jalls_work_queue_pop(pool->queue))) {
+		int err = 0;
+		int had_shm = NULL != conn->thread_ctx.shm;
+		if (!should_exit) {
+			if (had_shm) {
+				err = jalls_shm_handle_ready(&conn->thread_ctx, 0);
+			} else {
+				err = jalls_handle_message(&conn->thread_ctx);
+			}
+		}
+		if (0 < err) {
+			struct epoll_event ev;
+			memset(&ev, 0, sizeof(ev));
+			ev.events = JALLS_CONN_EVENTS;
+			ev.data.ptr = conn;
+			int op = EPOLL_CTL_MOD;
+			int fd = conn->thread_ctx.fd;
+			if (conn->thread_ctx.shm) {
+				fd = jalls_shm_get_wait_fd(conn->thread_ctx.shm);
+			}
+			if (!had_shm && conn->thread_ctx.shm) {
+				// The ring's wait fd watches the socket from now on
+				epoll_ctl(pool->epoll_fd, EPOLL_CTL_DEL, conn->thread_ctx.fd, NULL);
+				op = EPOLL_CTL_ADD;
+			}
+			if (0 == epoll_ctl(pool->epoll_fd, op, fd, &ev)) {
+				continue;
+			}
+			if (pool->debug) {
+				fprintf(stderr, "Failed to re-arm connection: %s\n", strerror(errno));
+			}
+		}
+		if (JALDB_E_INTERNAL_ERROR == err) {
+			should_exit = 1;
+			kill(getpid(), SIGTERM);
+		}
+		jalls_pool_close_conn(pool, conn);
+	}
+	return NULL;
+}
+
+static void jalls_pool_shutdown(struct jalls_worker_pool *pool)
+{
+	jalls_work_queue_close(pool->queue);
+
+	// Wake up any worker blocked receiving from a stalled producer
+	pthread_mutex_lock(&pool->lock);
+	for (struct jalls_pool_conn *conn = pool->conns; conn; conn = conn->next) {
+		shutdown(conn->thread_ctx.fd, SHUT_RDWR);
+	}
+	pthread_mutex_unlock(&pool->lock);
+
+	for (int i = 0; i < pool->worker_count; i++) {
+		pthread_join(pool->workers[i], NULL);
+	}
+
+	// Whatever is left was idle in the epoll set
+	while (pool->conns) {
+		jalls_pool_close_conn(pool, pool->conns);
+	}
+}
+
+int jalls_worker_pool_run(int listen_fd, const struct jalls_thread_context *proto_ctx)
+{
+	if (listen_fd < 0 || !proto_ctx || !proto_ctx->ctx) {
+		return -1;
+	}
+
+	int ret = -1;
+	struct jalls_context *ctx = proto_ctx->ctx;
+	struct jalls_worker_pool pool;
+	memset(&pool, 0, sizeof(pool));
+	pool.listen_fd = listen_fd;
+	pool.debug = ctx->debug;
+	pool.max_conns = ctx->max_connections;
+	pool.proto_ctx = proto_ctx;
+	pthread_mutex_init(&pool.lock, NULL);
+
+	pool.epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+	if (-1 == pool.epoll_fd) {
+		fprintf(stderr, "failed to create the epoll instance: %s\n", strerror(errno));
+		goto out;
+	}
+
+	struct epoll_event ev;
+	memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN;
+	ev.data.ptr = NULL;
+	if (-1 == epoll_ctl(pool.epoll_fd, EPOLL_CTL_ADD, listen_fd, &ev)) {
+		fprintf(stderr, "failed to add the socket to the epoll set: %s\n", strerror(errno));
+		goto out;
+	}
+	pool.listening = 1;
+
+	pool.queue = jalls_work_queue_create(ctx->work_queue_size);
+	if (!pool.queue) {
+		fprintf(stderr, "failed to create the work queue\n");
+		goto out;
+	}
+
+	pool.workers = jal_calloc(ctx->worker_threads, sizeof(*pool.workers));
+	for (; pool.worker_count < ctx->worker_threads; pool.worker_count++) {
+		int err = pthread_create(&pool.workers[pool.worker_count], NULL, jalls_pool_worker, &pool);
+		if (0 != err) {
+			fprintf(stderr, "failed to create worker thread: %s\n", strerror(err));
+			goto out;
+		}
+	}
+	if (pool.debug) {
+		fprintf(stderr, "Started %d worker threads\n", pool.worker_count);
+	}
+
+	struct epoll_event events[JALLS_EPOLL_MAX_EVENTS];
+	while (!should_exit) {
+		int nfds = epoll_wait(pool.epoll_fd, events, JALLS_EPOLL_MAX_EVENTS, JALLS_EPOLL_TIMEOUT_MS);
+		if (-1 == nfds) {
+			if (EINTR == errno) {
+				continue;
+			}
+			fprintf(stderr, "epoll_wait failed: %s\n", strerror(errno));
+			goto out;
+		}
+		for (int i = 0; i < nfds && !should_exit; i++) {
+			if (NULL == events[i].data.ptr) {
+				jalls_pool_accept(&pool);
+				continue;
+			}
+			// Blocks while every worker is busy and the queue is
+			// full, which keeps further connections unserviced.
+			if (0 != jalls_work_queue_push(pool.queue, events[i].data.ptr)) {
+				goto out;
+			}
+		}
+	}
+	ret = 0;
+
+out:
+	if (pool.queue) {
+		jalls_pool_shutdown(&pool);
+		jalls_work_queue_destroy(&pool.queue);
+	}
+	free(pool.workers);
+	if (-1 != pool.epoll_fd) {
+		close(pool.epoll_fd);
+	}
+	pthread_mutex_destroy(&pool.lock);
+	return ret;
+}
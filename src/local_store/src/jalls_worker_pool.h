@@ -0,0 +1,65 @@
+/**
+ * @file jalls_worker_pool.h This file contains the epoll based connection
+ * engine for the jal local store.
+ *
+ * @section LICENSE
+ *
+ * Source code in 3rd-party is licensed and owned by their respective
+ * copyright holders.
+ *
+ * All other source code is copyright Tresys Technology and licensed as below.
+ *
+ * Copyright (c) 2012 Tresys Technology LLC, Columbia, Maryland, USA
+ *
+ * This software was developed by Tresys Technology LLC
+ * with U.S. Government sponsorship.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _JALLS_WORKER_POOL_H_
+#define _JALLS_WORKER_POOL_H_
+
+#include "jalls_context.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Accept and service producer connections until should_exit is set.
+ *
+ * A single thread waits in epoll for new connections and for connections
+ * with a pending message. Ready connections are handed to a fixed-size pool
+ * of worker threads (jalls_context::worker_threads) through a bounded queue
+ * (jalls_context::work_queue_size). Each worker receives and stores exactly
+ * one message with jalls_handle_message() and then re-arms the connection.
+ *
+ * Backpressure is applied instead of delaying accept(): when the queue is
+ * full the event loop blocks until a worker is free, and once
+ * jalls_context::max_connections connections are open the listening socket
+ * is removed from the epoll set until a connection closes.
+ *
+ * @param[in] listen_fd The listening UNIX domain socket.
+ * @param[in] proto_ctx The thread context every connection's context is
+ * copied from. The fd and peer fields are ignored.
+ *
+ * @return 0 when should_exit was set, -1 if the engine could not be started.
+ */
+int jalls_worker_pool_run(int listen_fd, const struct jalls_thread_context *proto_ctx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _JALLS_WORKER_POOL_H_
@@ -0,0 +1,187 @@
+/**
+ * @file test_jalls_batch.c This file contains tests for jalls_batch.c
+ * functions.
+ *
+ * @section LICENSE
+ *
+ * Source code in 3rd-party is licensed and owned by their respective
+ * copyright holders.
+ *
+ * All other source code is copyright Tresys Technology and licensed as below.
+ *
+ * Copyright (c) 2012 Tresys Technology LLC, Columbia, Maryland, USA
+ *
+ * This software was developed by Tresys Technology LLC
+ * with U.S. Government sponsorship.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <test-dept.h>
+
+#include "jalls_batch.h"
+
+#define BUF_LEN 256
+
+static uint8_t buf[BUF_LEN];
+static uint64_t len;
+static struct jalls_batch_entry *entries;
+static uint32_t count;
+
+static void put(const void *src, size_t n)
+{
+	memcpy(buf + len, src, n);
+	len += n;
+}
+
+static void put_header(uint16_t version, uint32_t n)
+{
+	uint16_t reserved = 0;
+	put(&version, sizeof(version));
+	put(&reserved, sizeof(reserved));
+	put(&n, sizeof(n));
+}
+
+static void put_entry(uint16_t type, uint64_t data_len, uint64_t meta_len)
+{
+	uint8_t reserved[6] = { 0 };
+	put(&type, sizeof(type));
+	put(reserved, sizeof(reserved));
+	put(&data_len, sizeof(data_len));
+	put(&meta_len, sizeof(meta_len));
+}
+
+void setup()
+{
+	memset(buf, 0, sizeof(buf));
+	len = 0;
+	entries = NULL;
+	count = 0;
+}
+
+void teardown()
+{
+	free(entries);
+}
+
+void test_parse_batch_works()
+{
+	put_header(JALLS_BATCH_VERSION, 3);
+	put_entry(1, 4, 0);
+	put_entry(2, 5, 6);
+	put_entry(1, 0, 3);
+	put("log1", 4);
+	put("audit", 5);
+	put("<meta>", 6);
+	put("<m>", 3);
+
+	assert_equals(0, jalls_parse_batch(buf, len, &entries, &count));
+	assert_equals(3, count);
+
+	assert_equals(1, entries[0].message_type);
+	assert_equals(4, entries[0].data_len);
+	assert_equals(0, memcmp("log1", entries[0].data, 4));
+	assert_equals(0, entries[0].meta_len);
+	assert_equals((void *) NULL, entries[0].meta);
+
+	assert_equals(2, entries[1].message_type);
+	assert_equals(0, memcmp("audit", entries[1].data, 5));
+	assert_equals(6, entries[1].meta_len);
+	assert_equals(0, memcmp("<meta>", entries[1].meta, 6));
+
+	assert_equals(1, entries[2].message_type);
+	assert_equals((void *) NULL, entries[2].data);
+	assert_equals(0, memcmp("<m>", entries[2].meta, 3));
+}
+
+void test_parse_batch_fails_with_bad_input()
+{
+	put_header(JALLS_BATCH_VERSION, 1);
+	put_entry(1, 1, 0);
+	put("x", 1);
+	assert_equals(-1, jalls_parse_batch(NULL, len, &entries, &count));
+	assert_equals(-1, jalls_parse_batch(buf, len, NULL, &count));
+	assert_equals(-1, jalls_parse_batch(buf, len, &entries, NULL));
+	assert_equals(-1, jalls_parse_batch(buf, JALLS_BATCH_HEADER_LEN - 1, &entries, &count));
+	assert_equals((void *) NULL, entries);
+}
+
+void test_parse_batch_fails_with_wrong_version()
+{
+	put_header(JALLS_BATCH_VERSION + 1, 1);
+	put_entry(1, 1, 0);
+	put("x", 1);
+	assert_equals(-1, jalls_parse_batch(buf, len, &entries, &count));
+}
+
+void test_parse_batch_fails_with_bad_count()
+{
+	put_header(JALLS_BATCH_VERSION, 0);
+	assert_equals(-1, jalls_parse_batch(buf, len, &entries, &count));
+
+	setup();
+	put_header(JALLS_BATCH_VERSION, JALLS_BATCH_MAX_RECORDS + 1);
+	assert_equals(-1, jalls_parse_batch(buf, len, &entries, &count));
+
+	// Not enough room for the table
+	setup();
+	put_header(JALLS_BATCH_VERSION, 2);
+	put_entry(1, 1, 0);
+	assert_equals(-1, jalls_parse_batch(buf, len, &entries, &count));
+}
+
+void test_parse_batch_fails_with_bad_record_type()
+{
+	put_header(JALLS_BATCH_VERSION, 1);
+	put_entry(3, 1, 0);
+	put("x", 1);
+	assert_equals(-1, jalls_parse_batch(buf, len, &entries, &count));
+}
+
+void test_parse_batch_fails_with_empty_records()
+{
+	put_header(JALLS_BATCH_VERSION, 1);
+	put_entry(1, 0, 0);
+	assert_equals(-1, jalls_parse_batch(buf, len, &entries, &count));
+
+	// Audit records need data
+	setup();
+	put_header(JALLS_BATCH_VERSION, 1);
+	put_entry(2, 0, 1);
+	put("x", 1);
+	assert_equals(-1, jalls_parse_batch(buf, len, &entries, &count));
+}
+
+void test_parse_batch_fails_when_lengths_do_not_add_up()
+{
+	put_header(JALLS_BATCH_VERSION, 1);
+	put_entry(1, 2, 0);
+	put("x", 1);
+	assert_equals(-1, jalls_parse_batch(buf, len, &entries, &count));
+
+	setup();
+	put_header(JALLS_BATCH_VERSION, 1);
+	put_entry(1, 1, UINT64_MAX);
+	put("xy", 2);
+	assert_equals(-1, jalls_parse_batch(buf, len, &entries, &count));
+
+	// Trailing bytes
+	setup();
+	put_header(JALLS_BATCH_VERSION, 1);
+	put_entry(1, 1, 0);
+	put("xy", 2);
+	assert_equals(-1, jalls_parse_batch(buf, len, &entries, &count));
+	assert_equals((void *) NULL, entries);
+}
@@ -41,6 +41,7 @@
 #include "jalls_msg.h"
 #include "jalls_handler.h"
 #include "jalls_handle_log.hpp"
+#include "jalls_handle_batch.hpp"
 
 #define FAKE_MSG_SIZE 128
 
@@ -177,6 +178,20 @@ static int recvmsg_returns_non_null_cmsg_len_zero(__attribute__((unused)) int fd
 	return FAKE_MSG_SIZE;
 }
 
+static int recvmsg_returns_msg_type_jalls_batch_msg(__attribute__((unused)) int fd,
+						struct msghdr *msg,
+						__attribute__((unused)) int flags)
+{
+	*(uint16_t *)msg->msg_iov[0].iov_base = 1;
+	*(uint16_t *)msg->msg_iov[1].iov_base = 5;
+	*(uint64_t *)msg->msg_iov[2].iov_base = 0;
+	*(uint64_t *)msg->msg_iov[3].iov_base = 0;
+
+	msg->msg_control = NULL;
+
+	return FAKE_MSG_SIZE;
+}
+
 static int recvmsg_always_fails(__attribute__((unused)) int fd,
 			__attribute__((unused)) struct msghdr *msg,
 			__attribute__((unused)) int flags)
@@ -191,6 +206,15 @@ static int fake_jalls_handle_log(__attribute__((unused)) struct jalls_thread_con
 	return -1;
 }
 
+static int fake_jalls_handle_batch_called;
+static int fake_jalls_handle_batch(__attribute__((unused)) struct jalls_thread_context *ctx,
+				__attribute__((unused)) uint64_t data_len,
+				__attribute__((unused)) uint64_t meta_len)
+{
+	fake_jalls_handle_batch_called = 1;
+	return -1;
+}
+
 struct jalls_context *jalls_ctx = NULL;
 struct jalls_thread_context *thread_ctx = NULL;
 jaldb_context *db_ctx = NULL;
@@ -280,6 +304,17 @@ void test_jalls_handler_msg_type_is_jalls_journal_fd_msg()
 	assert_equals((void *) NULL, ret);
 }
 
+void test_jalls_handler_msg_type_is_jalls_batch_msg()
+{
+	fake_jalls_handle_batch_called = 0;
+	replace_function(jalls_recvmsg_helper, recvmsg_returns_msg_type_jalls_batch_msg);
+	replace_function(jalls_handle_batch, fake_jalls_handle_batch);
+	void *ret = jalls_handler(thread_ctx);
+	assert_equals((void *) NULL, ret);
+	assert_equals(1, fake_jalls_handle_batch_called);
+	restore_function(jalls_handle_batch);
+}
+
 void test_jalls_handler_protocol_is_zero()
 {
 	replace_function(jalls_recvmsg_helper, recvmsg_returns_protocol_zero);
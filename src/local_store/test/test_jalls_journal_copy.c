@@ -0,0 +1,125 @@
+/**
+ * @file test_jalls_journal_copy.c This file contains tests for
+ * jalls_copy_journal_fd().
+ *
+ * @section LICENSE
+ *
+ * Source code in 3rd-party is licensed and owned by their respective
+ * copyright holders.
+ *
+ * All other source code is copyright Tresys Technology and licensed as below.
+ *
+ * Copyright (c) 2012 Tresys Technology LLC, Columbia, Maryland, USA
+ *
+ * This software was developed by Tresys Technology LLC
+ * with U.S. Government sponsorship.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <test-dept.h>
+#include <jalop/jal_digest.h>
+#include "jalls_journal_copy.h"
+
+#define SRC_FILE "./test_jalls_journal_copy_src"
+#define DST_FILE "./test_jalls_journal_copy_dst"
+// Larger than the read/write buffer and not a multiple of it.
+#define JOURNAL_LEN (3 * 8192 + 17)
+
+static int src_fd = -1;
+static int dst_fd = -1;
+static uint8_t journal[JOURNAL_LEN];
+static struct jal_multi_digest *md = NULL;
+static enum jal_digest_algorithm alg = JAL_DIGEST_ALGORITHM_SHA256;
+
+void setup()
+{
+	for (int i = 0; i < JOURNAL_LEN; i++) {
+		journal[i] = (uint8_t)(i * 7);
+	}
+	src_fd = open(SRC_FILE, O_RDWR | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+	assert_equals(JOURNAL_LEN, write(src_fd, journal, JOURNAL_LEN));
+	dst_fd = open(DST_FILE, O_RDWR | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+	md = jal_multi_digest_create(&alg, 1);
+}
+
+void teardown()
+{
+	close(src_fd);
+	close(dst_fd);
+	unlink(SRC_FILE);
+	unlink(DST_FILE);
+	jal_multi_digest_destroy(&md);
+}
+
+static void assert_copied(uint64_t len)
+{
+	uint8_t buf[JOURNAL_LEN + 1];
+	uint8_t *expected = NULL;
+	uint8_t *actual = NULL;
+	struct jal_digest_ctx *ctx = jal_digest_ctx_create(alg);
+	int len_out = 0;
+
+	assert_equals((ssize_t)len, pread(dst_fd, buf, sizeof(buf), 0));
+	assert_equals(0, memcmp(journal, buf, len));
+
+	assert_equals(JAL_OK, jal_multi_digest_final(md));
+	assert_equals(JAL_OK, jal_multi_digest_get(md, alg, &actual, &len_out));
+	assert_equals(JAL_OK, jal_digest_buffer(ctx, journal, len, &expected));
+	assert_equals(ctx->len, len_out);
+	assert_equals(0, memcmp(expected, actual, len_out));
+
+	free(expected);
+	free(actual);
+	jal_digest_ctx_destroy(&ctx);
+}
+
+void test_copy_with_read_write()
+{
+	enum jalls_copy_method method = JALLS_COPY_CLONE;
+	assert_equals(0, jalls_copy_journal_fd(src_fd, dst_fd, JOURNAL_LEN, md, 0, &method, 0));
+	assert_equals(JALLS_COPY_READ_WRITE, method);
+	assert_copied(JOURNAL_LEN);
+}
+
+void test_copy_with_zero_copy()
+{
+	assert_equals(0, jalls_copy_journal_fd(src_fd, dst_fd, JOURNAL_LEN, md, 1, NULL, 0));
+	assert_copied(JOURNAL_LEN);
+}
+
+void test_zero_copy_copies_only_len_bytes()
+{
+	enum jalls_copy_method method = JALLS_COPY_CLONE;
+	assert_equals(0, jalls_copy_journal_fd(src_fd, dst_fd, JOURNAL_LEN - 100, md, 1, &method, 0));
+	// Cloning shares the whole file, so it must not be used for a prefix.
+	assert_not_equals(JALLS_COPY_CLONE, method);
+	assert_copied(JOURNAL_LEN - 100);
+}
+
+void test_copy_fails_when_file_is_short()
+{
+	assert_equals(-1, jalls_copy_journal_fd(src_fd, dst_fd, JOURNAL_LEN + 1, md, 1, NULL, 0));
+}
+
+void test_copy_fails_with_bad_input()
+{
+	assert_equals(-1, jalls_copy_journal_fd(-1, dst_fd, JOURNAL_LEN, md, 1, NULL, 0));
+	assert_equals(-1, jalls_copy_journal_fd(src_fd, -1, JOURNAL_LEN, md, 1, NULL, 0));
+	assert_equals(-1, jalls_copy_journal_fd(src_fd, dst_fd, JOURNAL_LEN, NULL, 1, NULL, 0));
+}
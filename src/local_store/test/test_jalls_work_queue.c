@@ -0,0 +1,118 @@
+/**
+ * @file test_jalls_work_queue.c This file contains tests for jalls_work_queue
+ * functions.
+ *
+ * @section LICENSE
+ *
+ * Source code in 3rd-party is licensed and owned by their respective
+ * copyright holders.
+ *
+ * All other source code is copyright Tresys Technology and licensed as below.
+ *
+ * Copyright (c) 2012 Tresys Technology LLC, Columbia, Maryland, USA
+ *
+ * This software was developed by Tresys Technology LLC
+ * with U.S. Government sponsorship.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdlib.h>
+#include <pthread.h>
+#include <test-dept.h>
+#include "jalls_work_queue.h"
+
+#define QUEUE_CAPACITY 3
+
+static struct jalls_work_queue *queue = NULL;
+static int items[QUEUE_CAPACITY + 1];
+
+void setup()
+{
+	queue = jalls_work_queue_create(QUEUE_CAPACITY);
+}
+
+void teardown()
+{
+	jalls_work_queue_destroy(&queue);
+}
+
+static void *push_last_item(__attribute__((unused)) void *arg)
+{
+	jalls_work_queue_push(queue, &items[QUEUE_CAPACITY]);
+	return NULL;
+}
+
+void test_create_returns_null_for_zero_capacity()
+{
+	assert_equals((void *) NULL, jalls_work_queue_create(0));
+}
+
+void test_destroy_sets_queue_to_null()
+{
+	jalls_work_queue_destroy(&queue);
+	assert_equals((void *) NULL, queue);
+	jalls_work_queue_destroy(&queue);
+	jalls_work_queue_destroy(NULL);
+}
+
+void test_push_fails_with_null_item()
+{
+	assert_equals(-1, jalls_work_queue_push(queue, NULL));
+	assert_equals(-1, jalls_work_queue_push(NULL, &items[0]));
+}
+
+void test_pop_returns_items_in_fifo_order()
+{
+	for (int i = 0; i < QUEUE_CAPACITY; i++) {
+		assert_equals(0, jalls_work_queue_push(queue, &items[i]));
+	}
+	assert_equals(QUEUE_CAPACITY, jalls_work_queue_depth(queue));
+	for (int i = 0; i < QUEUE_CAPACITY; i++) {
+		assert_pointer_equals(&items[i], jalls_work_queue_pop(queue));
+	}
+	assert_equals(0, jalls_work_queue_depth(queue));
+}
+
+void test_queue_wraps_around()
+{
+	for (int round = 0; round < 2 * QUEUE_CAPACITY; round++) {
+		assert_equals(0, jalls_work_queue_push(queue, &items[0]));
+		assert_equals(0, jalls_work_queue_push(queue, &items[1]));
+		assert_pointer_equals(&items[0], jalls_work_queue_pop(queue));
+		assert_pointer_equals(&items[1], jalls_work_queue_pop(queue));
+	}
+}
+
+void test_push_blocks_until_pop_when_full()
+{
+	pthread_t thread;
+	for (int i = 0; i < QUEUE_CAPACITY; i++) {
+		assert_equals(0, jalls_work_queue_push(queue, &items[i]));
+	}
+	assert_equals(0, pthread_create(&thread, NULL, push_last_item, NULL));
+	assert_pointer_equals(&items[0], jalls_work_queue_pop(queue));
+	assert_equals(0, pthread_join(thread, NULL));
+	for (int i = 1; i <= QUEUE_CAPACITY; i++) {
+		assert_pointer_equals(&items[i], jalls_work_queue_pop(queue));
+	}
+}
+
+void test_close_drains_then_returns_null()
+{
+	assert_equals(0, jalls_work_queue_push(queue, &items[0]));
+	jalls_work_queue_close(queue);
+	assert_equals(-1, jalls_work_queue_push(queue, &items[1]));
+	assert_pointer_equals(&items[0], jalls_work_queue_pop(queue));
+	assert_equals((void *) NULL, jalls_work_queue_pop(queue));
+}
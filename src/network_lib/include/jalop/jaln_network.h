@@ -40,6 +40,13 @@ extern "C" {
 #include <jalop/jaln_connection_callbacks.h>
 #include <jalop/jaln_publisher_callbacks.h>
 
+/** The number of records a publisher session has in flight by default */
+#define JALN_DEFAULT_PIPELINE_DEPTH 1
+/** The largest number of records a publisher session may have in flight */
+#define JALN_MAX_PIPELINE_DEPTH 64
+/** The largest number of threads a jaln_pub_engine may run */
+#define JALN_MAX_ENGINE_THREADS 64
+
 /**
  * Create and initialize a new jaln_context
  * @return A pointer to the new context
@@ -374,6 +381,21 @@ enum jal_status jaln_send_log(
  */
 enum jal_status jaln_finish(jaln_session *sess);
 
+/**
+ * Wait for every record in flight on a session to be acknowledged.
+ *
+ * When a publisher pipeline depth greater than 1 is configured,
+ * jaln_send_audit and jaln_send_log return as soon as the record is queued,
+ * and the digest and sync callbacks for it run during later calls. A
+ * publisher should call this before waiting for more records, so the
+ * subscriber is not left holding records it cannot sync.
+ *
+ * @param[in] sess The session containing the connection information
+ *
+ * @return JAL_OK once nothing is in flight, or an error if the session failed
+ */
+enum jal_status jaln_flush(jaln_session *sess);
+
 /**
  * Set network timeout value.
  *
@@ -381,6 +403,129 @@ enum jal_status jaln_finish(jaln_session *sess);
  */
 void setNetworkTimeout(jaln_context *ctx, const long long int timeout);
 
+/**
+ * Set how many audit or log records a publisher session keeps in flight.
+ *
+ * With a depth of 1, each record is sent and its digest challenge answered
+ * before the next record starts, so every record costs two round trips.
+ * With a larger depth, up to \p depth records are sent over concurrent
+ * keep-alive connections (or multiplexed on one connection when HTTP/2 is
+ * negotiated), and digest responses for earlier records are sent as their
+ * challenges arrive. The library copies each record before sending it, so
+ * jaln_publisher_callbacks::on_record_complete is called as soon as the
+ * record is queued. Journal records are always sent one at a time.
+ *
+ * @param[in] ctx The context to configure.
+ * @param[in] depth A value between 1 and JALN_MAX_PIPELINE_DEPTH.
+ *
+ * @return JAL_OK, or JAL_E_INVAL if \p depth is out of range.
+ */
+enum jal_status jaln_set_pipeline_depth(jaln_context *ctx, int depth);
+
+/**
+ * Create an engine that drives publisher sessions without a thread per
+ * session.
+ *
+ * Each engine thread runs an event loop over one curl multi handle, so the
+ * records of every session it drives are sent concurrently, and are
+ * multiplexed on one connection per subscriber when HTTP/2 is negotiated.
+ * Sessions are spread across the threads as they are added.
+ *
+ * @param[in] num_threads The number of event loops, between 1 and
+ * JALN_MAX_ENGINE_THREADS.
+ * @param[in] poll_interval_ms How long to wait before asking a
+ * jaln_record_source that had nothing to send for a record again.
+ *
+ * @return The new engine, or NULL on error.
+ */
+jaln_pub_engine *jaln_pub_engine_create(int num_threads, long poll_interval_ms);
+
+/**
+ * Stop an engine and free it.
+ *
+ * Every session still driven by the engine is closed, its records in flight
+ * are given until their transfers end, and
+ * jaln_record_source::on_finished is called for it before this returns.
+ *
+ * @param[in,out] engine The engine to destroy, set to NULL.
+ */
+void jaln_pub_engine_destroy(jaln_pub_engine **engine);
+
+/**
+ * Hand a publisher session to an engine, typically from
+ * jaln_publisher_callbacks::on_subscribe.
+ *
+ * From then on the engine asks \p source for records whenever the session
+ * has room in its pipeline (see jaln_set_pipeline_depth), and sends them
+ * without blocking. Once the session is closed, by jaln_disconnect or an
+ * error, the engine waits out the records in flight, calls jaln_finish and
+ * then jaln_record_source::on_finished. The application must not call
+ * jaln_flush for the session.
+ *
+ * @param[in] engine The engine to use.
+ * @param[in] sess The subscribed session.
+ * @param[in] source Where to get records from, copied by the engine.
+ *
+ * @return JAL_OK, or JAL_E_INVAL_PARAM on bad input.
+ */
+enum jal_status jaln_pub_engine_add_session(jaln_pub_engine *engine,
+		jaln_session *sess,
+		const struct jaln_record_source *source);
+
+/**
+ * Tell an engine that records of the given types are ready to be sent.
+ *
+ * Sessions of these types that were waiting out the poll interval after
+ * their jaln_record_source had nothing to send are asked for records again
+ * right away. Applications that can tell when new records arrive should
+ * call this so that records go out without waiting for the poll interval.
+ *
+ * @param[in] engine The engine.
+ * @param[in] types A bitwise or of jaln_record_type values.
+ *
+ * @return JAL_OK, or JAL_E_INVAL_PARAM on bad input.
+ */
+enum jal_status jaln_pub_engine_notify(jaln_pub_engine *engine, int types);
+
+/**
+ * Create a source for the payload of a journal record stored in a file.
+ *
+ * The source does not take ownership of \p fd, which must stay open until
+ * the source is destroyed. Reads use absolute offsets, so the file offset
+ * of \p fd is never changed and journal resume needs no seek.
+ *
+ * If the file can't be mapped, a JALN_PAYLOAD_SOURCE_MMAP source falls back
+ * to reading with pread.
+ *
+ * @param[in] fd The payload file, open for reading.
+ * @param[in] size The size of the payload. The file must be at least this
+ * large.
+ * @param[in] type How to read the file.
+ *
+ * @return The new source, or NULL on error.
+ */
+jaln_payload_source *jaln_payload_source_create(int fd, uint64_t size,
+		enum jaln_payload_source_type type);
+
+/**
+ * Destroy a payload source. This does not close the file.
+ *
+ * @param[in,out] src The source to destroy, set to NULL.
+ */
+void jaln_payload_source_destroy(jaln_payload_source **src);
+
+/**
+ * Fill in a jaln_payload_feeder that reads from \p src, for use with
+ * jaln_send_journal.
+ *
+ * @param[in] src The payload source.
+ * @param[out] feeder The feeder to fill in.
+ *
+ * @return JAL_OK, or JAL_E_INVAL_PARAM on bad input.
+ */
+enum jal_status jaln_payload_source_get_feeder(jaln_payload_source *src,
+		struct jaln_payload_feeder *feeder);
+
 #ifdef __cplusplus
 }
 #endif
@@ -321,6 +321,75 @@ typedef struct jaln_session_t jaln_session;
  */
 typedef struct jaln_context_t jaln_context;
 
+/**
+ * Drives the publisher sessions of any number of contexts from a small pool
+ * of threads.
+ */
+typedef struct jaln_pub_engine_t jaln_pub_engine;
+
+/**
+ * Serves the bytes of a journal payload file to a jaln_payload_feeder
+ * without a seek and a read for every buffer sent.
+ */
+typedef struct jaln_payload_source_t jaln_payload_source;
+
+/**
+ * How a jaln_payload_source reads the payload file.
+ */
+enum jaln_payload_source_type {
+	/** Map the whole file and copy out of the mapping */
+	JALN_PAYLOAD_SOURCE_MMAP,
+	/** Read the file in large windows with pread, asking the kernel to
+	 * read the next window ahead */
+	JALN_PAYLOAD_SOURCE_PREAD,
+};
+
+/**
+ * @struct jaln_record_source
+ * A jaln_record_source hands records to a jaln_pub_engine, which calls it
+ * whenever a session it drives has room for another record.
+ */
+struct jaln_record_source {
+	/**
+	 * An application may set this to anything they like. It will be passed
+	 * as the \p source_data parameter of #send_next and #on_finished.
+	 */
+	void *source_data;
+	/**
+	 * The engine calls this when \p sess can take another record. The
+	 * application should call jaln_send_journal, jaln_send_audit or
+	 * jaln_send_log at most once, without waiting for a record to become
+	 * available. If it does not send anything, the engine calls again after
+	 * the poll interval given to jaln_pub_engine_create.
+	 *
+	 * This is called from an engine thread and must not block.
+	 *
+	 * @param[in] sess The session to send on.
+	 * @param[in] ch_info Information about the channel.
+	 * @param[in] source_data The application defined source_data pointer of this struct.
+	 *
+	 * @return JAL_OK to keep the session going, some other value to close it.
+	 */
+	enum jal_status (*send_next)(jaln_session *sess,
+			const struct jaln_channel_info *ch_info,
+			void *source_data);
+	/**
+	 * The engine calls this once the session is closed and it no longer
+	 * holds a reference to it, to give the application a chance to release
+	 * \p source_data.
+	 *
+	 * @param[in] sess The session that was closed.
+	 * @param[in] ch_info Information about the channel.
+	 * @param[in] status JAL_OK if the session was closed by jaln_disconnect,
+	 * or the error that closed it.
+	 * @param[in] source_data The application defined source_data pointer of this struct.
+	 */
+	void (*on_finished)(jaln_session *sess,
+			const struct jaln_channel_info *ch_info,
+			enum jal_status status,
+			void *source_data);
+};
+
 #ifdef __cplusplus
 }
 #endif
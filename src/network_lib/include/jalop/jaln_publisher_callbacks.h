@@ -102,6 +102,10 @@ struct jaln_publisher_callbacks {
 	 * application to clean up any resources (including those in
 	 * record_info);
 	 *
+	 * When records are pipelined (see jaln_set_pipeline_depth), the JNL
+	 * copies audit and log records and calls this as soon as the copy is
+	 * queued, before the subscriber has acknowledged the record.
+	 *
 	 * @param[in] session The jaln_session.
 	 * @param[in] ch_info Information about the connection
 	 * @param[in] type The type of record (journal, audit, or log)
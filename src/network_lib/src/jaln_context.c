@@ -61,6 +61,7 @@ jaln_context *jaln_context_create(void)
 	}
 
 	ctx->network_timeout = 0L;
+	ctx->pipeline_depth = JALN_DEFAULT_PIPELINE_DEPTH;
 
 	return ctx;
 }
@@ -224,3 +225,12 @@ void setNetworkTimeout(jaln_context *ctx, const long long int timeout) {
 	ctx->network_timeout = timeout;
 }
 
+
+enum jal_status jaln_set_pipeline_depth(jaln_context *ctx, int depth)
+{
+	if (!ctx || depth < 1 || depth > JALN_MAX_PIPELINE_DEPTH) {
+		return JAL_E_INVAL;
+	}
+	ctx->pipeline_depth = depth;
+	return JAL_OK;
+}
@@ -73,6 +73,7 @@ struct jaln_context_t {
 	void *user_data;
 	char pub_id[37]; // holds textual UUID (32 hex chars, 4 dashes, 1 NUL)
 	long long int network_timeout;
+	int pipeline_depth; // Number of audit or log records a publisher session may have in flight
 };
 
 /**
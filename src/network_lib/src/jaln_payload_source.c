@@ -0,0 +1,181 @@
+/**
+ * @file jaln_payload_source.c This file contains the functions that serve
+ * journal payloads from a file.
+ *
+ * @section LICENSE
+ *
+ * Source code in 3rd-party is licensed and owned by their respective
+ * copyright holders.
+ *
+ * All other source code is copyright Tresys Technology and licensed as below.
+ *
+ * Copyright (c) 2012 Tresys Technology LLC, Columbia, Maryland, USA
+ *
+ * This software was developed by Tresys Technology LLC
+ * with U.S. Government sponsorship.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "jal_alloc.h"
+
+#include "jaln_payload_source.h"
+
+/*
+ * Read the window that starts at \p offset, then have the kernel start
+ * reading the one after it so the next refill doesn't wait on the disk.
+ */
+static enum jal_status jaln_payload_source_fill_window(jaln_payload_source *src,
+		uint64_t offset)
+{
+	uint64_t want = src->size - offset;
+	if (want > JALN_PAYLOAD_SOURCE_WINDOW) {
+		want = JALN_PAYLOAD_SOURCE_WINDOW;
+	}
+
+	uint64_t got = 0;
+	while (got < want) {
+		ssize_t n = pread(src->fd, src->window + got, want - got, offset + got);
+		if (0 > n) {
+			if (EINTR == errno) {
+				continue;
+			}
+			break;
+		}
+		if (0 == n) {
+			// The file is shorter than it was at create
+			break;
+		}
+		got += n;
+	}
+	src->window_off = offset;
+	src->window_len = got;
+	if (0 == got) {
+		return JAL_E_FILE_IO;
+	}
+
+	uint64_t next = offset + got;
+	if (next < src->size) {
+		posix_fadvise(src->fd, next, JALN_PAYLOAD_SOURCE_WINDOW, POSIX_FADV_WILLNEED);
+	}
+	return JAL_OK;
+}
+
+jaln_payload_source *jaln_payload_source_create(int fd, uint64_t size,
+		enum jaln_payload_source_type type)
+{
+	struct stat st;
+
+	if (0 > fd || (JALN_PAYLOAD_SOURCE_MMAP != type && JALN_PAYLOAD_SOURCE_PREAD != type)) {
+		return NULL;
+	}
+	if (0 != fstat(fd, &st) || (uint64_t) st.st_size < size) {
+		return NULL;
+	}
+
+	jaln_payload_source *src = jal_calloc(1, sizeof(*src));
+	src->fd = fd;
+	src->size = size;
+	src->type = type;
+
+	if (JALN_PAYLOAD_SOURCE_MMAP == type) {
+		void *map = MAP_FAILED;
+		if (0 < size && (uint64_t) (size_t) size == size) {
+			map = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+		}
+		if (MAP_FAILED != map) {
+			madvise(map, size, MADV_SEQUENTIAL);
+			src->map = map;
+			return src;
+		}
+		src->type = JALN_PAYLOAD_SOURCE_PREAD;
+	}
+
+	posix_fadvise(fd, 0, size, POSIX_FADV_SEQUENTIAL);
+	src->window = jal_malloc(JALN_PAYLOAD_SOURCE_WINDOW);
+	return src;
+}
+
+void jaln_payload_source_destroy(jaln_payload_source **psrc)
+{
+	if (!psrc || !*psrc) {
+		return;
+	}
+	jaln_payload_source *src = *psrc;
+	if (src->map) {
+		munmap(src->map, src->size);
+	}
+	free(src->window);
+	free(src);
+	*psrc = NULL;
+}
+
+enum jal_status jaln_payload_source_get_bytes(const uint64_t offset,
+		uint8_t * const buffer,
+		uint64_t *size,
+		void *feeder_data)
+{
+	jaln_payload_source *src = (jaln_payload_source *) feeder_data;
+	enum jal_status ret;
+
+	if (!src || !buffer || !size) {
+		return JAL_E_INVAL_PARAM;
+	}
+	if (offset >= src->size) {
+		*size = 0;
+		return JAL_OK;
+	}
+
+	uint64_t to_copy = src->size - offset;
+	if (to_copy > *size) {
+		to_copy = *size;
+	}
+
+	if (src->map) {
+		memcpy(buffer, src->map + offset, to_copy);
+		*size = to_copy;
+		return JAL_OK;
+	}
+
+	if (offset < src->window_off || offset >= src->window_off + src->window_len) {
+		ret = jaln_payload_source_fill_window(src, offset);
+		if (JAL_OK != ret) {
+			return ret;
+		}
+	}
+	uint64_t in_window = src->window_off + src->window_len - offset;
+	if (to_copy > in_window) {
+		to_copy = in_window;
+	}
+	memcpy(buffer, src->window + (offset - src->window_off), to_copy);
+	*size = to_copy;
+	return JAL_OK;
+}
+
+enum jal_status jaln_payload_source_get_feeder(jaln_payload_source *src,
+		struct jaln_payload_feeder *feeder)
+{
+	if (!src || !feeder) {
+		return JAL_E_INVAL_PARAM;
+	}
+	feeder->feeder_data = src;
+	feeder->get_bytes = jaln_payload_source_get_bytes;
+	return JAL_OK;
+}
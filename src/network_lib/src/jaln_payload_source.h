@@ -0,0 +1,74 @@
+/**
+ * @file jaln_payload_source.h This file contains the structures used to
+ * serve journal payloads from a file.
+ *
+ * @section LICENSE
+ *
+ * Source code in 3rd-party is licensed and owned by their respective
+ * copyright holders.
+ *
+ * All other source code is copyright Tresys Technology and licensed as below.
+ *
+ * Copyright (c) 2012 Tresys Technology LLC, Columbia, Maryland, USA
+ *
+ * This software was developed by Tresys Technology LLC
+ * with U.S. Government sponsorship.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef _JALN_PAYLOAD_SOURCE_H_
+#define _JALN_PAYLOAD_SOURCE_H_
+
+#include <stdint.h>
+#include <jalop/jal_status.h>
+#include <jalop/jaln_network.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** The size of the window a pread source reads at once */
+#define JALN_PAYLOAD_SOURCE_WINDOW (1024 * 1024)
+
+struct jaln_payload_source_t {
+	enum jaln_payload_source_type type;  //!< How the file is read, after any fallback
+	int fd;                              //!< The payload file, not owned
+	uint64_t size;                       //!< The size of the payload
+	uint8_t *map;                        //!< The mapped file, for JALN_PAYLOAD_SOURCE_MMAP
+	uint8_t *window;                     //!< The read buffer, for JALN_PAYLOAD_SOURCE_PREAD
+	uint64_t window_off;                 //!< The payload offset of window[0]
+	uint64_t window_len;                 //!< The number of valid bytes in window
+};
+
+/**
+ * The jaln_payload_feeder::get_bytes function of a payload source.
+ *
+ * @param[in] offset The payload offset to copy from.
+ * @param[in] buffer The buffer to copy to.
+ * @param[in,out] size The size of \p buffer, set to the number of bytes
+ * copied. 0 once \p offset is at the end of the payload.
+ * @param[in] feeder_data The jaln_payload_source.
+ *
+ * @return JAL_OK, JAL_E_INVAL_PARAM on bad input, or JAL_E_FILE_IO if the
+ * file could not be read.
+ */
+enum jal_status jaln_payload_source_get_bytes(const uint64_t offset,
+		uint8_t * const buffer,
+		uint64_t *size,
+		void *feeder_data);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _JALN_PAYLOAD_SOURCE_H_
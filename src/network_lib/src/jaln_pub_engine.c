@@ -0,0 +1,329 @@
+/**
+ * @file jaln_pub_engine.c This file contains the functions that drive
+ * publisher sessions from a pool of event loops.
+ *
+ * @section LICENSE
+ *
+ * Source code in 3rd-party is licensed and owned by their respective
+ * copyright holders.
+ *
+ * All other source code is copyright Tresys Technology and licensed as below.
+ *
+ * Copyright (c) 2012 Tresys Technology LLC, Columbia, Maryland, USA
+ *
+ * This software was developed by Tresys Technology LLC
+ * with U.S. Government sponsorship.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <time.h>
+#include <unistd.h>
+
+#include "jal_alloc.h"
+
+#include "jaln_pub_engine.h"
+#include "jaln_pub_pipeline.h"
+#include "jaln_session.h"
+
+/** The longest a loop waits before checking on its sessions, in milliseconds */
+#define JALN_ENGINE_WAIT_MS 1000
+
+/* curl_multi_poll and curl_multi_wakeup were added in libcurl 7.68.0 */
+#if LIBCURL_VERSION_NUM >= 0x074400
+#define JALN_ENGINE_HAVE_WAKEUP 1
+#endif
+
+static uint64_t jaln_pub_engine_now_ms()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static void jaln_pub_loop_wakeup(struct jaln_pub_loop *loop)
+{
+#ifdef JALN_ENGINE_HAVE_WAKEUP
+	curl_multi_wakeup(loop->multi);
+#else
+	// The loop notices within JALN_ENGINE_WAIT_MS
+	(void) loop;
+#endif
+}
+
+static void jaln_pub_loop_wait(struct jaln_pub_loop *loop, long timeout_ms)
+{
+	if (0 >= timeout_ms) {
+		return;
+	}
+#ifdef JALN_ENGINE_HAVE_WAKEUP
+	curl_multi_poll(loop->multi, NULL, 0, (int) timeout_ms, NULL);
+#else
+	// curl_multi_wait returns right away when there is nothing to wait on
+	uint64_t start = jaln_pub_engine_now_ms();
+	curl_multi_wait(loop->multi, NULL, 0, (int) timeout_ms, NULL);
+	uint64_t waited = jaln_pub_engine_now_ms() - start;
+	if (waited < (uint64_t) timeout_ms) {
+		usleep((useconds_t) (timeout_ms - waited) * 1000);
+	}
+#endif
+}
+
+/*
+ * Ask the session's source for records until its pipeline is full or the
+ * source has nothing to send, and lower \p timeout_ms to when the session
+ * next needs attention.
+ */
+static void jaln_pub_engine_feed(jaln_pub_engine *engine,
+		struct jaln_pub_engine_session *es,
+		axl_bool stopping,
+		uint64_t now,
+		long *timeout_ms)
+{
+	jaln_session *sess = es->sess;
+
+	if (es->closing) {
+		return;
+	}
+	if (stopping) {
+		sess->closing = axl_true;
+	}
+	if (JAL_OK != jaln_session_is_ok(sess)) {
+		es->closing = axl_true;
+		es->status = sess->errored ? JAL_E_COMM : JAL_OK;
+		return;
+	}
+	if (now < es->idle_until_ms) {
+		if ((long) (es->idle_until_ms - now) < *timeout_ms) {
+			*timeout_ms = (long) (es->idle_until_ms - now);
+		}
+		return;
+	}
+
+	const int depth = jaln_pub_pipeline_depth(sess);
+	int in_flight = jaln_pub_pipeline_in_flight(sess);
+	while (in_flight < depth) {
+		enum jal_status ret = es->source.send_next(sess, sess->ch_info,
+				es->source.source_data);
+		if (JAL_OK != ret) {
+			es->closing = axl_true;
+			es->status = ret;
+			return;
+		}
+		int now_in_flight = jaln_pub_pipeline_in_flight(sess);
+		if (now_in_flight == in_flight) {
+			// Nothing to send yet
+			es->idle_until_ms = now + engine->poll_interval_ms;
+			if (engine->poll_interval_ms < *timeout_ms) {
+				*timeout_ms = engine->poll_interval_ms;
+			}
+			return;
+		}
+		in_flight = now_in_flight;
+	}
+}
+
+/*
+ * Close a session once nothing is in flight, and give it back to the
+ * application.
+ */
+static void jaln_pub_engine_end_session(struct jaln_pub_loop *loop,
+		struct jaln_pub_engine_session *es)
+{
+	jaln_session *sess = es->sess;
+
+	jaln_finish(sess);
+	jaln_pub_pipeline_destroy(&sess->pipeline);
+	sess->pub_multi = NULL;
+	if (es->source.on_finished) {
+		es->source.on_finished(sess, sess->ch_info, es->status, es->source.source_data);
+	}
+
+	pthread_mutex_lock(&loop->engine->lock);
+	loop->session_cnt--;
+	pthread_mutex_unlock(&loop->engine->lock);
+
+	jaln_session_unref(sess);
+	free(es);
+}
+
+static void *jaln_pub_loop_run(void *arg)
+{
+	struct jaln_pub_loop *loop = (struct jaln_pub_loop *) arg;
+	jaln_pub_engine *engine = loop->engine;
+
+	while (1) {
+		pthread_mutex_lock(&engine->lock);
+		const axl_bool stopping = engine->stopping;
+		const int ready_types = loop->ready_types;
+		loop->ready_types = 0;
+		while (loop->added) {
+			struct jaln_pub_engine_session *es = loop->added;
+			loop->added = es->next;
+			es->next = loop->sessions;
+			loop->sessions = es;
+		}
+		pthread_mutex_unlock(&engine->lock);
+
+		if (stopping && !loop->sessions) {
+			break;
+		}
+
+		const uint64_t now = jaln_pub_engine_now_ms();
+		long timeout_ms = JALN_ENGINE_WAIT_MS;
+		struct jaln_pub_engine_session **pos = &loop->sessions;
+		while (*pos) {
+			struct jaln_pub_engine_session *es = *pos;
+			if (ready_types & es->sess->ch_info->type) {
+				es->idle_until_ms = 0;
+			}
+			jaln_pub_engine_feed(engine, es, stopping, now, &timeout_ms);
+			if (es->closing && 0 == jaln_pub_pipeline_in_flight(es->sess)) {
+				*pos = es->next;
+				jaln_pub_engine_end_session(loop, es);
+				continue;
+			}
+			pos = &es->next;
+		}
+
+		jaln_pub_loop_wait(loop, timeout_ms);
+		jaln_pub_pipeline_perform(loop->multi, 0);
+	}
+	return NULL;
+}
+
+jaln_pub_engine *jaln_pub_engine_create(int num_threads, long poll_interval_ms)
+{
+	if (num_threads < 1 || num_threads > JALN_MAX_ENGINE_THREADS ||
+			poll_interval_ms < 0) {
+		return NULL;
+	}
+
+	jaln_pub_engine *engine = jal_calloc(1, sizeof(*engine));
+	pthread_mutex_init(&engine->lock, NULL);
+	engine->poll_interval_ms = poll_interval_ms;
+	engine->num_loops = num_threads;
+	engine->loops = jal_calloc(num_threads, sizeof(*engine->loops));
+
+	for (int i = 0; i < num_threads; i++) {
+		struct jaln_pub_loop *loop = engine->loops + i;
+		loop->engine = engine;
+		loop->multi = curl_multi_init();
+		if (!loop->multi) {
+			goto err_out;
+		}
+#ifdef CURLPIPE_MULTIPLEX
+		curl_multi_setopt(loop->multi, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+#endif
+		if (0 != pthread_create(&loop->thread, NULL, jaln_pub_loop_run, loop)) {
+			goto err_out;
+		}
+		loop->started = axl_true;
+	}
+	return engine;
+
+err_out:
+	jaln_pub_engine_destroy(&engine);
+	return NULL;
+}
+
+void jaln_pub_engine_destroy(jaln_pub_engine **pengine)
+{
+	if (!pengine || !*pengine) {
+		return;
+	}
+	jaln_pub_engine *engine = *pengine;
+
+	pthread_mutex_lock(&engine->lock);
+	engine->stopping = axl_true;
+	pthread_mutex_unlock(&engine->lock);
+
+	for (int i = 0; i < engine->num_loops; i++) {
+		struct jaln_pub_loop *loop = engine->loops + i;
+		if (loop->started) {
+			jaln_pub_loop_wakeup(loop);
+			pthread_join(loop->thread, NULL);
+		}
+		if (loop->multi) {
+			curl_multi_cleanup(loop->multi);
+		}
+	}
+
+	pthread_mutex_destroy(&engine->lock);
+	free(engine->loops);
+	free(engine);
+	*pengine = NULL;
+}
+
+enum jal_status jaln_pub_engine_add_session(jaln_pub_engine *engine,
+		jaln_session *sess,
+		const struct jaln_record_source *source)
+{
+	if (!engine || !sess || !sess->ch_info || !sess->pub_data ||
+			sess->pub_multi || !source || !source->send_next) {
+		return JAL_E_INVAL_PARAM;
+	}
+
+	if (sess->pipeline) {
+		// Records sent before the session was handed over must be flushed
+		if (0 < sess->pipeline->in_flight) {
+			return JAL_E_INVAL_PARAM;
+		}
+		jaln_pub_pipeline_destroy(&sess->pipeline);
+	}
+
+	struct jaln_pub_engine_session *es = jal_calloc(1, sizeof(*es));
+	es->sess = sess;
+	es->source = *source;
+	es->status = JAL_OK;
+
+	pthread_mutex_lock(&engine->lock);
+	if (engine->stopping) {
+		pthread_mutex_unlock(&engine->lock);
+		free(es);
+		return JAL_E_INVAL;
+	}
+	struct jaln_pub_loop *loop = engine->loops;
+	for (int i = 1; i < engine->num_loops; i++) {
+		if (engine->loops[i].session_cnt < loop->session_cnt) {
+			loop = engine->loops + i;
+		}
+	}
+	jaln_session_ref(sess);
+	sess->pub_multi = loop->multi;
+	es->next = loop->added;
+	loop->added = es;
+	loop->session_cnt++;
+	pthread_mutex_unlock(&engine->lock);
+
+	jaln_pub_loop_wakeup(loop);
+	return JAL_OK;
+}
+
+enum jal_status jaln_pub_engine_notify(jaln_pub_engine *engine, int types)
+{
+	if (!engine || 0 == types) {
+		return JAL_E_INVAL_PARAM;
+	}
+
+	pthread_mutex_lock(&engine->lock);
+	for (int i = 0; i < engine->num_loops; i++) {
+		struct jaln_pub_loop *loop = engine->loops + i;
+		if (0 < loop->session_cnt) {
+			loop->ready_types |= types;
+			jaln_pub_loop_wakeup(loop);
+		}
+	}
+	pthread_mutex_unlock(&engine->lock);
+	return JAL_OK;
+}
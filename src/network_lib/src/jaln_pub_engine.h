@@ -0,0 +1,81 @@
+/**
+ * @file jaln_pub_engine.h This file contains the structures used to drive
+ * publisher sessions from a pool of event loops.
+ *
+ * @section LICENSE
+ *
+ * Source code in 3rd-party is licensed and owned by their respective
+ * copyright holders.
+ *
+ * All other source code is copyright Tresys Technology and licensed as below.
+ *
+ * Copyright (c) 2012 Tresys Technology LLC, Columbia, Maryland, USA
+ *
+ * This software was developed by Tresys Technology LLC
+ * with U.S. Government sponsorship.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef _JALN_PUB_ENGINE_H_
+#define _JALN_PUB_ENGINE_H_
+
+#include <pthread.h>
+#include <stdint.h>
+#include <axl.h>
+#include <curl/curl.h>
+#include <jalop/jaln_network.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * A session driven by an engine loop.
+ */
+struct jaln_pub_engine_session {
+	jaln_session *sess;                     //!< The session, the engine holds a reference to it
+	struct jaln_record_source source;       //!< Where records come from
+	uint64_t idle_until_ms;                 //!< Don't ask the source for a record before this time
+	axl_bool closing;                       //!< Set once the session is closed, records in flight are still finishing
+	enum jal_status status;                 //!< Passed to jaln_record_source::on_finished
+	struct jaln_pub_engine_session *next;   //!< The next session of the loop
+};
+
+/**
+ * One event loop of an engine. The sessions list is only touched by the
+ * loop's thread, new sessions are handed over through the added list.
+ */
+struct jaln_pub_loop {
+	jaln_pub_engine *engine;                //!< The engine this loop belongs to
+	pthread_t thread;                       //!< The thread running the loop
+	axl_bool started;                       //!< Whether the thread was started
+	CURLM *multi;                           //!< Drives the transfers of every session in the loop
+	struct jaln_pub_engine_session *added;  //!< Sessions not yet picked up by the loop, guarded by the engine lock
+	struct jaln_pub_engine_session *sessions; //!< Sessions driven by the loop
+	int session_cnt;                        //!< The number of sessions in the loop, guarded by the engine lock
+	int ready_types;                        //!< Record types passed to jaln_pub_engine_notify, guarded by the engine lock
+};
+
+struct jaln_pub_engine_t {
+	pthread_mutex_t lock;
+	axl_bool stopping;         // Set by jaln_pub_engine_destroy
+	long poll_interval_ms;     // How long to wait on a source that had nothing to send
+	int num_loops;
+	struct jaln_pub_loop *loops;
+};
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _JALN_PUB_ENGINE_H_
@@ -35,6 +35,7 @@
 #include "jaln_context.h"
 #include "jaln_message_helpers.h"
 #include "jaln_publisher.h"
+#include "jaln_pub_pipeline.h"
 #include "jaln_strings.h"
 
 axl_bool jaln_pub_feeder_get_size(jaln_session *sess, uint64_t *size)
@@ -50,7 +51,7 @@ size_t jaln_pub_feeder_fill_buffer(void *b, size_t size, size_t nmemb, void *use
 	uint64_t dst_off = 0;
 	struct jaln_readfunc_info *info = (struct jaln_readfunc_info *)userdata;
 	jaln_session *sess = info->sess;
-	struct jaln_pub_data *pd = sess->pub_data;
+	struct jaln_pub_data *pd = info->pub_data ? info->pub_data : sess->pub_data;
 	struct jaln_publisher_callbacks *cbs = sess->jaln_ctx->pub_callbacks;
 	struct jaln_channel_info *ch_info = sess->ch_info;
 	void *ud = sess->jaln_ctx->user_data;
@@ -174,7 +175,7 @@ axl_bool jaln_pub_feeder_is_finished(jaln_session *sess, int *finished)
 	return *finished;
 }
 
-static enum jal_status jaln_pub_verify_sync(jaln_session *sess, struct jaln_response_header_info *info)
+enum jal_status jaln_pub_verify_sync(jaln_session *sess, struct jaln_response_header_info *info)
 {
 	enum jal_status rc;
 	if (!info->last_message) {
@@ -200,11 +201,13 @@ void jaln_pub_feeder_handler(jaln_session* sess)
 {
 	const long curl_timeout_period = sess->jaln_ctx->network_timeout * 60L;
 
-	CURL *ctx = curl_easy_duphandle(sess->curl_ctx);
+	// Reuse the session's handle so every record goes over the same
+	// keep-alive connection instead of reconnecting.
+	CURL *ctx = sess->curl_ctx;
 	if (!ctx) {
 		// Error
 		jaln_session_set_errored(sess);
-		goto out;
+		return;
 	}
 
 	struct jaln_response_header_info *info = jaln_response_header_info_create(sess);
@@ -214,7 +217,7 @@ void jaln_pub_feeder_handler(jaln_session* sess)
 	jaln_pub_feeder_get_size(sess, &size);
 	curl_easy_setopt(ctx, CURLOPT_POSTFIELDSIZE_LARGE, size);
 
-	struct jaln_readfunc_info read_info = { sess };
+	struct jaln_readfunc_info read_info = { sess, NULL };
 	curl_easy_setopt(ctx, CURLOPT_READFUNCTION, jaln_pub_feeder_fill_buffer);
 	curl_easy_setopt(ctx, CURLOPT_READDATA, &read_info);
 
@@ -329,7 +332,11 @@ void jaln_pub_feeder_handler(jaln_session* sess)
 	jaln_response_header_info_destroy(&info);
 
 out:
-	curl_easy_cleanup(ctx);
+	// Don't leave the handle pointing at this stack frame
+	curl_easy_setopt(ctx, CURLOPT_READFUNCTION, NULL);
+	curl_easy_setopt(ctx, CURLOPT_READDATA, NULL);
+	curl_easy_setopt(ctx, CURLOPT_HTTPHEADER, NULL);
+	curl_easy_setopt(ctx, CURLOPT_ERRORBUFFER, NULL);
 }
 
 void jaln_pub_feeder_reset_state(jaln_session *sess)
@@ -439,6 +446,11 @@ enum jal_status jaln_pub_begin_next_record_ans(jaln_session *sess,
 
 	jaln_pub_feeder_calculate_size(sess);
 
+	if (jaln_pub_pipeline_is_enabled(sess)) {
+		// The pipeline takes the headers along with the rest of the record
+		return jaln_pub_pipeline_send(sess);
+	}
+
 	jaln_session_ref(sess);
 
 	jaln_pub_feeder_handler(sess);
@@ -33,6 +33,8 @@
 
 #include "jaln_session.h"
 
+struct jaln_response_header_info;
+
 /**
  * return the 'size' of the record.
  *
@@ -54,6 +56,7 @@ axl_bool jaln_pub_feeder_get_size(
 struct jaln_readfunc_info
 {
         jaln_session *sess;
+        struct jaln_pub_data *pub_data; //!< The record to send, or NULL for jaln_session::pub_data
 };
 
 /**
@@ -86,6 +89,18 @@ axl_bool jaln_pub_feeder_is_finished(
 		jaln_session *sess,
 		int *finished);
 
+/**
+ * Check the response to a record or digest response that should carry a
+ * sync, and notify the application of the sync.
+ *
+ * @param[in] sess The session the record was sent on.
+ * @param[in] info The parsed response headers.
+ *
+ * @return JAL_OK if the response was a valid sync, or an error.
+ */
+enum jal_status jaln_pub_verify_sync(jaln_session *sess,
+		struct jaln_response_header_info *info);
+
 /**
  * Function used to send a record using curl and receive
  * the response.
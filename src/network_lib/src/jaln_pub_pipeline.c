@@ -0,0 +1,495 @@
+/**
+ * @file jaln_pub_pipeline.c This file contains the functions used by a
+ * publisher to keep several audit or log records in flight on a session.
+ *
+ * @section LICENSE
+ *
+ * Source code in 3rd-party is licensed and owned by their respective
+ * copyright holders.
+ *
+ * All other source code is copyright Tresys Technology and licensed as below.
+ *
+ * Copyright (c) 2012 Tresys Technology LLC, Columbia, Maryland, USA
+ *
+ * This software was developed by Tresys Technology LLC
+ * with U.S. Government sponsorship.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "jal_alloc.h"
+
+#include "jaln_context.h"
+#include "jaln_digest_info.h"
+#include "jaln_digest_resp_info.h"
+#include "jaln_message_helpers.h"
+#include "jaln_publisher.h"
+#include "jaln_pub_feeder.h"
+#include "jaln_pub_pipeline.h"
+
+/** How long to block waiting for network activity, in milliseconds */
+#define JALN_PIPELINE_WAIT_MS 1000
+
+struct jaln_pub_pipeline *jaln_pub_pipeline_create(int depth, CURLM *multi)
+{
+	if (depth < 1) {
+		return NULL;
+	}
+	axl_bool shared = multi ? axl_true : axl_false;
+	if (!shared) {
+		multi = curl_multi_init();
+		if (!multi) {
+			return NULL;
+		}
+		// HTTP/1.1 has no usable pipelining in libcurl, so each record in
+		// flight gets its own keep-alive connection unless the subscriber
+		// negotiates HTTP/2, in which case they share one.
+		curl_multi_setopt(multi, CURLMOPT_MAX_HOST_CONNECTIONS, (long) depth);
+#ifdef CURLPIPE_MULTIPLEX
+		curl_multi_setopt(multi, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+#endif
+	}
+	struct jaln_pub_pipeline *pipeline = jal_calloc(1, sizeof(*pipeline));
+	pipeline->multi = multi;
+	pipeline->shared = shared;
+	pipeline->depth = depth;
+	pipeline->handles = jal_calloc(depth, sizeof(*pipeline->handles));
+	pipeline->records = jal_calloc(depth, sizeof(*pipeline->records));
+	return pipeline;
+}
+
+void jaln_pub_pipeline_destroy(struct jaln_pub_pipeline **ppipeline)
+{
+	if (!ppipeline || !*ppipeline) {
+		return;
+	}
+	struct jaln_pub_pipeline *pipeline = *ppipeline;
+	for (int i = 0; i < pipeline->depth; i++) {
+		if (pipeline->records[i]) {
+			jaln_session *sess = pipeline->records[i]->read_info.sess;
+			curl_multi_remove_handle(pipeline->multi, pipeline->handles[i]);
+			jaln_pub_record_destroy(sess, &pipeline->records[i]);
+		}
+		if (pipeline->handles[i]) {
+			curl_easy_cleanup(pipeline->handles[i]);
+		}
+	}
+	if (!pipeline->shared) {
+		curl_multi_cleanup(pipeline->multi);
+	}
+	free(pipeline->handles);
+	free(pipeline->records);
+	free(pipeline);
+	*ppipeline = NULL;
+}
+
+axl_bool jaln_pub_pipeline_is_enabled(jaln_session *sess)
+{
+	if (!sess || !sess->jaln_ctx || !sess->ch_info) {
+		return axl_false;
+	}
+	if (sess->pub_multi) {
+		return axl_true;
+	}
+	return sess->jaln_ctx->pipeline_depth > 1 &&
+		JALN_RTYPE_JOURNAL != sess->ch_info->type;
+}
+
+int jaln_pub_pipeline_depth(jaln_session *sess)
+{
+	if (!sess || !sess->jaln_ctx || !sess->ch_info) {
+		return 1;
+	}
+	// The journal feeder is read while the record is sent, and the
+	// application only has one journal open at a time
+	if (JALN_RTYPE_JOURNAL == sess->ch_info->type) {
+		return 1;
+	}
+	return sess->jaln_ctx->pipeline_depth;
+}
+
+int jaln_pub_pipeline_in_flight(jaln_session *sess)
+{
+	if (!sess || !sess->pipeline) {
+		return 0;
+	}
+	return sess->pipeline->in_flight;
+}
+
+enum jal_status jaln_pub_pipeline_take_record(jaln_session *sess,
+		struct jaln_pub_record *rec)
+{
+	if (!sess || !sess->pub_data || !sess->pub_data->nonce || !rec) {
+		return JAL_E_INVAL;
+	}
+	struct jaln_pub_data *src = sess->pub_data;
+	const axl_bool journal = JALN_RTYPE_JOURNAL == sess->ch_info->type;
+	const uint64_t payload_sz = journal ? 0 : src->payload_sz;
+	int64_t len = 0;
+	if (!jaln_pub_feeder_safe_add_size(&len, src->sys_meta_sz) ||
+			!jaln_pub_feeder_safe_add_size(&len, src->app_meta_sz) ||
+			!jaln_pub_feeder_safe_add_size(&len, payload_sz) ||
+			(uint64_t) len > SIZE_MAX) {
+		return JAL_E_INVAL;
+	}
+
+	struct jaln_pub_data *pd = jaln_pub_data_create();
+	*pd = *src;
+	pd->nonce = jal_strdup(src->nonce);
+
+	// The headers and digest now belong to the copy
+	src->headers = NULL;
+	src->dgst_inst = NULL;
+	src->dgst = NULL;
+
+	// The application owns the buffers and may reuse them once we return
+	rec->buf = jal_malloc(len ? (size_t) len : 1);
+	uint8_t *pos = rec->buf;
+	if (src->sys_meta_sz) {
+		memcpy(pos, src->sys_meta, src->sys_meta_sz);
+	}
+	pd->sys_meta = pos;
+	pos += src->sys_meta_sz;
+	if (src->app_meta_sz) {
+		memcpy(pos, src->app_meta, src->app_meta_sz);
+	}
+	pd->app_meta = pos;
+	pos += src->app_meta_sz;
+	if (journal) {
+		// Read through pd->journal_feeder as it is sent
+		pd->payload = NULL;
+	} else {
+		if (payload_sz) {
+			memcpy(pos, src->payload, payload_sz);
+		}
+		pd->payload = pos;
+	}
+
+	rec->pub_data = pd;
+	rec->read_info.sess = sess;
+	rec->read_info.pub_data = pd;
+	rec->info = jaln_response_header_info_create(sess);
+	rec->info->expected_nonce = jal_strdup(pd->nonce);
+	return JAL_OK;
+}
+
+void jaln_pub_record_destroy(jaln_session *sess, struct jaln_pub_record **prec)
+{
+	if (!prec || !*prec) {
+		return;
+	}
+	struct jaln_pub_record *rec = *prec;
+	struct jaln_pub_data *pd = rec->pub_data;
+	if (pd) {
+		curl_slist_free_all(pd->headers);
+		free(pd->nonce);
+		if (pd->dgst_inst && sess && sess->dgst) {
+			sess->dgst->destroy(pd->dgst_inst);
+		}
+		free(pd->dgst);
+		free(pd);
+	}
+	if (rec->info) {
+		jaln_response_header_info_destroy(&rec->info);
+	}
+	curl_slist_free_all(rec->dgst_resp_headers);
+	free(rec->buf);
+	free(rec);
+	*prec = NULL;
+}
+
+static void jaln_pub_pipeline_set_timeout(jaln_session *sess, CURL *curl)
+{
+	const long curl_timeout_period = sess->jaln_ctx->network_timeout * 60L;
+	if (curl_timeout_period > 0) {
+		curl_easy_setopt(curl, CURLOPT_TIMEOUT, curl_timeout_period);
+		curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+	}
+}
+
+/*
+ * Let the application know the library is done with the record's
+ * buffers, and its journal feeder.
+ */
+static void jaln_pub_pipeline_complete(jaln_session *sess, struct jaln_pub_record *rec)
+{
+	if (rec->completed) {
+		return;
+	}
+	rec->completed = axl_true;
+	sess->jaln_ctx->pub_callbacks->on_record_complete(sess, sess->ch_info,
+			sess->ch_info->type, rec->pub_data->nonce, sess->jaln_ctx->user_data);
+}
+
+static void jaln_pub_pipeline_release(jaln_session *sess, struct jaln_pub_record *rec)
+{
+	struct jaln_pub_pipeline *pipeline = sess->pipeline;
+	jaln_pub_pipeline_complete(sess, rec);
+	pipeline->records[rec->slot] = NULL;
+	pipeline->in_flight--;
+	jaln_pub_record_destroy(sess, &rec);
+}
+
+/*
+ * The record body has been sent and the subscriber answered with either a
+ * digest challenge or, with digest challenges off, a sync. Answer the
+ * challenge on the same slot.
+ */
+static void jaln_pub_pipeline_on_record_sent(jaln_session *sess,
+		struct jaln_pub_record *rec, CURL *curl)
+{
+	struct jaln_response_header_info *info = rec->info;
+
+	jaln_pub_pipeline_complete(sess, rec);
+
+	if (!sess->dgst_on) {
+		if (JAL_OK != jaln_pub_verify_sync(sess, info) &&
+				JAL_OK != jaln_verify_sync_failure_headers(info)) {
+			fprintf(stderr, "%s(): Sync verification failed for %s\n",
+				__func__, info->expected_nonce);
+			jaln_session_set_errored(sess);
+		}
+		jaln_pub_pipeline_release(sess, rec);
+		return;
+	}
+
+	if (JAL_OK != jaln_verify_digest_challenge_headers(info)) {
+		if (JAL_OK != jaln_verify_record_failure_headers(info)) {
+			fprintf(stderr, "%s(): Digest challenge verification failed for %s\n",
+				__func__, info->expected_nonce);
+			jaln_session_set_errored(sess);
+		}
+		jaln_pub_pipeline_release(sess, rec);
+		return;
+	}
+
+	struct jaln_digest_resp_info *resp_info = NULL;
+	struct jaln_digest_info *peer_dgst = jaln_digest_info_create(info->expected_nonce,
+			info->peer_dgst, info->peer_dgst_len);
+	jaln_pub_notify_digests_and_create_digest_response(sess, sess->dgst_list,
+			peer_dgst, &resp_info);
+	jaln_digest_info_destroy(&peer_dgst);
+
+	char *resp_header = NULL;
+	uint64_t resp_header_len = 0;
+	if (!resp_info || JAL_OK != jaln_create_digest_response_msg(sess->id, resp_info,
+				&resp_header, &resp_header_len)) {
+		jaln_digest_resp_info_destroy(&resp_info);
+		jaln_session_set_errored(sess);
+		jaln_pub_pipeline_release(sess, rec);
+		return;
+	}
+	rec->dgst_resp_status = resp_info->status;
+	rec->dgst_resp_headers = curl_slist_append(NULL, resp_header);
+	free(resp_header);
+	jaln_digest_resp_info_destroy(&resp_info);
+
+	curl_easy_setopt(curl, CURLOPT_HTTPHEADER, rec->dgst_resp_headers);
+	curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, 0L);
+	if (JALN_DIGEST_STATUS_CONFIRMED == rec->dgst_resp_status) {
+		curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, jaln_publisher_sync_handler);
+	} else {
+		curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, jaln_publisher_failed_digest_handler);
+	}
+	// A shared multi handle is being read by jaln_pub_pipeline_perform, the
+	// handle is picked up on its next pass
+	if (CURLM_OK != curl_multi_add_handle(sess->pipeline->multi, curl)) {
+		jaln_session_set_errored(sess);
+		jaln_pub_pipeline_release(sess, rec);
+	}
+}
+
+static void jaln_pub_pipeline_on_dgst_resp_sent(jaln_session *sess,
+		struct jaln_pub_record *rec)
+{
+	enum jal_status rc;
+	if (JALN_DIGEST_STATUS_CONFIRMED == rec->dgst_resp_status) {
+		rc = jaln_pub_verify_sync(sess, rec->info);
+	} else {
+		rc = jaln_verify_failed_digest_headers(rec->info);
+	}
+	if (JAL_OK != rc) {
+		fprintf(stderr, "%s(): Failed digest resp for %s\n",
+			__func__, rec->info->expected_nonce);
+		jaln_session_set_errored(sess);
+	}
+	jaln_pub_pipeline_release(sess, rec);
+}
+
+enum jal_status jaln_pub_pipeline_perform(CURLM *multi, int wait_ms)
+{
+	int running = 0;
+	int msgs_left = 0;
+	CURLMsg *msg = NULL;
+
+	if (!multi) {
+		return JAL_E_INVAL;
+	}
+	if (0 < wait_ms && CURLM_OK != curl_multi_wait(multi, NULL, 0, wait_ms, NULL)) {
+		return JAL_E_COMM;
+	}
+	if (CURLM_OK != curl_multi_perform(multi, &running)) {
+		return JAL_E_COMM;
+	}
+
+	while ((msg = curl_multi_info_read(multi, &msgs_left))) {
+		if (CURLMSG_DONE != msg->msg) {
+			continue;
+		}
+		CURL *curl = msg->easy_handle;
+		CURLcode res = msg->data.result;
+		struct jaln_pub_record *rec = NULL;
+		curl_easy_getinfo(curl, CURLINFO_PRIVATE, (char **) &rec);
+		curl_multi_remove_handle(multi, curl);
+		if (!rec) {
+			continue;
+		}
+		jaln_session *sess = rec->read_info.sess;
+
+		if (CURLE_OK != res || sess->errored) {
+			fprintf(stderr, "%s(): Failed: %d: %s\n", __func__, res, rec->err_buf);
+			(void)fflush(stderr);
+			jaln_session_set_errored(sess);
+			jaln_pub_pipeline_release(sess, rec);
+		} else if (!rec->dgst_resp_headers) {
+			jaln_pub_pipeline_on_record_sent(sess, rec, curl);
+		} else {
+			jaln_pub_pipeline_on_dgst_resp_sent(sess, rec);
+		}
+	}
+	return JAL_OK;
+}
+
+/*
+ * Move every transfer of a pipeline with its own multi handle along. When
+ * \p wait is set, block until there is network activity first.
+ */
+static enum jal_status jaln_pub_pipeline_run(jaln_session *sess, axl_bool wait)
+{
+	enum jal_status ret = jaln_pub_pipeline_perform(sess->pipeline->multi,
+			wait ? JALN_PIPELINE_WAIT_MS : 0);
+	if (JAL_OK != ret) {
+		return ret;
+	}
+	return sess->errored ? JAL_E_COMM : JAL_OK;
+}
+
+enum jal_status jaln_pub_pipeline_send(jaln_session *sess)
+{
+	if (!sess || !sess->pub_data || !sess->curl_ctx) {
+		return JAL_E_INVAL;
+	}
+	if (!sess->pipeline) {
+		sess->pipeline = jaln_pub_pipeline_create(jaln_pub_pipeline_depth(sess),
+				sess->pub_multi);
+		if (!sess->pipeline) {
+			return JAL_E_NO_MEM;
+		}
+	}
+	struct jaln_pub_pipeline *pipeline = sess->pipeline;
+	enum jal_status ret = JAL_OK;
+
+	if (pipeline->shared && pipeline->in_flight >= pipeline->depth) {
+		// Only the engine loop may run the shared multi handle
+		return JAL_E_INVAL;
+	}
+	while (pipeline->in_flight >= pipeline->depth) {
+		ret = jaln_pub_pipeline_run(sess, axl_true);
+		if (JAL_OK != ret) {
+			return ret;
+		}
+	}
+
+	int slot = 0;
+	while (pipeline->records[slot]) {
+		slot++;
+	}
+	if (!pipeline->handles[slot]) {
+		pipeline->handles[slot] = curl_easy_duphandle(sess->curl_ctx);
+		if (!pipeline->handles[slot]) {
+			return JAL_E_NO_MEM;
+		}
+	}
+	CURL *curl = pipeline->handles[slot];
+
+	struct jaln_pub_record *rec = jal_calloc(1, sizeof(*rec));
+	rec->slot = slot;
+	ret = jaln_pub_pipeline_take_record(sess, rec);
+	if (JAL_OK != ret) {
+		free(rec);
+		return ret;
+	}
+	if (JALN_RTYPE_JOURNAL == sess->ch_info->type) {
+		// The journal is still read through the feeder, on_record_complete
+		// is called once it has been sent
+		sess->pub_data->payload_off = 0;
+	} else {
+		// The application's buffers are no longer needed
+		jaln_pub_feeder_on_finished(sess);
+		rec->completed = axl_true;
+	}
+
+	uint64_t size = rec->pub_data->feeder_sz - rec->pub_data->payload_off;
+	curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE_LARGE, (curl_off_t) size);
+	curl_easy_setopt(curl, CURLOPT_READFUNCTION, jaln_pub_feeder_fill_buffer);
+	curl_easy_setopt(curl, CURLOPT_READDATA, &rec->read_info);
+	if (sess->dgst_on) {
+		curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, jaln_publisher_digest_challenge_handler);
+	} else {
+		curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, jaln_publisher_sync_handler);
+	}
+	curl_easy_setopt(curl, CURLOPT_HEADERDATA, rec->info);
+	curl_easy_setopt(curl, CURLOPT_HTTPHEADER, rec->pub_data->headers);
+	curl_easy_setopt(curl, CURLOPT_ERRORBUFFER, rec->err_buf);
+	curl_easy_setopt(curl, CURLOPT_PRIVATE, rec);
+#ifdef CURL_HTTP_VERSION_2TLS
+	curl_easy_setopt(curl, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_2TLS);
+	curl_easy_setopt(curl, CURLOPT_PIPEWAIT, 1L);
+#endif
+	jaln_pub_pipeline_set_timeout(sess, curl);
+
+	if (CURLM_OK != curl_multi_add_handle(pipeline->multi, curl)) {
+		jaln_pub_pipeline_complete(sess, rec);
+		jaln_pub_record_destroy(sess, &rec);
+		return JAL_E_COMM;
+	}
+	pipeline->records[slot] = rec;
+	pipeline->in_flight++;
+
+	if (pipeline->shared) {
+		return JAL_OK;
+	}
+	// Get the new record moving without waiting on the network
+	return jaln_pub_pipeline_run(sess, axl_false);
+}
+
+enum jal_status jaln_pub_pipeline_flush(jaln_session *sess)
+{
+	if (!sess) {
+		return JAL_E_INVAL;
+	}
+	enum jal_status ret = JAL_OK;
+	if (sess->pipeline && sess->pipeline->shared) {
+		return JAL_OK;
+	}
+	while (sess->pipeline && sess->pipeline->in_flight > 0) {
+		ret = jaln_pub_pipeline_run(sess, axl_true);
+		if (JAL_OK != ret) {
+			break;
+		}
+	}
+	return ret;
+}
@@ -0,0 +1,188 @@
+/**
+ * @file jaln_pub_pipeline.h This file contains the functions used by a
+ * publisher to keep several audit or log records in flight on a session.
+ *
+ * @section LICENSE
+ *
+ * Source code in 3rd-party is licensed and owned by their respective
+ * copyright holders.
+ *
+ * All other source code is copyright Tresys Technology and licensed as below.
+ *
+ * Copyright (c) 2012 Tresys Technology LLC, Columbia, Maryland, USA
+ *
+ * This software was developed by Tresys Technology LLC
+ * with U.S. Government sponsorship.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef _JALN_PUB_PIPELINE_H_
+#define _JALN_PUB_PIPELINE_H_
+
+#include <curl/curl.h>
+#include <jalop/jal_status.h>
+
+#include "jaln_digest_resp_info.h"
+#include "jaln_pub_feeder.h"
+#include "jaln_session.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * A record that has been handed to the pipeline and is waiting on either
+ * its digest challenge or the sync that answers its digest response.
+ */
+struct jaln_pub_record {
+	int slot;                                    //!< Index of the slot (and curl handle) this record uses
+	struct jaln_pub_data *pub_data;              //!< The copy of the record being sent
+	uint8_t *buf;                                //!< The copies of the system metadata, application metadata and payload
+	struct jaln_readfunc_info read_info;         //!< Passed to jaln_pub_feeder_fill_buffer
+	struct jaln_response_header_info *info;      //!< The parsed response headers
+	struct curl_slist *dgst_resp_headers;        //!< Headers of the digest response, once it is sent
+	enum jaln_digest_status dgst_resp_status;    //!< The status reported in the digest response
+	char err_buf[CURL_ERROR_SIZE];               //!< Error buffer for the curl handle
+	axl_bool completed;                          //!< Whether on_record_complete was called for this record
+};
+
+/**
+ * The records a publisher session has in flight.
+ */
+struct jaln_pub_pipeline {
+	CURLM *multi;                    //!< Drives the transfers of every record in flight
+	axl_bool shared;                 //!< Whether jaln_pub_pipeline::multi belongs to a jaln_pub_engine
+	int depth;                       //!< The most records that may be in flight
+	int in_flight;                   //!< The number of records in flight
+	CURL **handles;                  //!< One curl handle per slot, kept between records so connections are reused
+	struct jaln_pub_record **records;  //!< The record in each slot, or NULL
+};
+
+/**
+ * Create a pipeline that keeps up to \p depth records in flight.
+ *
+ * @param[in] depth The number of slots.
+ * @param[in] multi The multi handle of the engine loop that drives the
+ * pipeline, or NULL for the pipeline to create its own and drive it from
+ * jaln_pub_pipeline_send and jaln_pub_pipeline_flush.
+ *
+ * @return The new pipeline, or NULL if the curl multi handle could not be
+ * created.
+ */
+struct jaln_pub_pipeline *jaln_pub_pipeline_create(int depth, CURLM *multi);
+
+/**
+ * Destroy a pipeline, abandoning any records still in flight.
+ *
+ * @param[in,out] pipeline The pipeline to destroy, set to NULL.
+ */
+void jaln_pub_pipeline_destroy(struct jaln_pub_pipeline **pipeline);
+
+/**
+ * Check whether records on a session should go through the pipeline. This
+ * is true for every session driven by a jaln_pub_engine, and for audit and
+ * log sessions when the context has a pipeline depth larger than 1.
+ *
+ * @param[in] sess The session to check.
+ *
+ * @return axl_true if jaln_pub_pipeline_send should be used.
+ */
+axl_bool jaln_pub_pipeline_is_enabled(jaln_session *sess);
+
+/**
+ * Take the record described by jaln_session::pub_data for the pipeline.
+ *
+ * The system metadata, application metadata and payload are copied since the
+ * application owns them, and the headers and digest are moved to the new
+ * jaln_pub_data, leaving jaln_session::pub_data ready for
+ * jaln_pub_feeder_reset_state. Journal payloads are not copied, they are
+ * still read through the application's jaln_payload_feeder.
+ *
+ * @param[in] sess The session holding the record.
+ * @param[out] rec The record to fill in.
+ *
+ * @return JAL_OK, or an error.
+ */
+enum jal_status jaln_pub_pipeline_take_record(jaln_session *sess,
+		struct jaln_pub_record *rec);
+
+/**
+ * Free a record taken by jaln_pub_pipeline_take_record.
+ *
+ * @param[in] sess The session the record belongs to.
+ * @param[in,out] rec The record to free, set to NULL.
+ */
+void jaln_pub_record_destroy(jaln_session *sess, struct jaln_pub_record **rec);
+
+/**
+ * Get the number of records a session has in flight.
+ *
+ * @param[in] sess The session to check.
+ *
+ * @return The number of records in flight.
+ */
+int jaln_pub_pipeline_in_flight(jaln_session *sess);
+
+/**
+ * Get the number of records a session may have in flight. This is 1 for
+ * journal sessions, and the context's pipeline depth otherwise.
+ *
+ * @param[in] sess The session to check.
+ *
+ * @return The depth of the session's pipeline.
+ */
+int jaln_pub_pipeline_depth(jaln_session *sess);
+
+/**
+ * Queue the record described by jaln_session::pub_data, waiting first for a
+ * slot if the pipeline is full. Responses to records already in flight are
+ * handled while waiting.
+ *
+ * A pipeline driven by an engine loop never waits, the record is only added
+ * to the loop's multi handle, and JAL_E_INVAL is returned if it is full.
+ *
+ * @param[in] sess The session to send on.
+ *
+ * @return JAL_OK if the record was queued, or an error.
+ */
+enum jal_status jaln_pub_pipeline_send(jaln_session *sess);
+
+/**
+ * Move every transfer on a multi handle along and handle the ones that
+ * completed, which may belong to any number of sessions.
+ *
+ * @param[in] multi The multi handle to run.
+ * @param[in] wait_ms How long to wait for network activity first, 0 to not
+ * wait at all.
+ *
+ * @return JAL_OK, or JAL_E_COMM if the multi handle failed.
+ */
+enum jal_status jaln_pub_pipeline_perform(CURLM *multi, int wait_ms);
+
+/**
+ * Wait for every record in flight on a session to finish.
+ *
+ * Sessions driven by an engine loop are flushed by the loop, so this returns
+ * immediately for them.
+ *
+ * @param[in] sess The session to flush.
+ *
+ * @return JAL_OK, or an error if the session failed.
+ */
+enum jal_status jaln_pub_pipeline_flush(jaln_session *sess);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _JALN_PUB_PIPELINE_H_
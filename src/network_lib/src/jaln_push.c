@@ -34,6 +34,7 @@
 #include "jaln_message_helpers.h"
 #include "jaln_session.h"
 #include "jaln_pub_feeder.h"
+#include "jaln_pub_pipeline.h"
 #include "jaln_push.h"
 
 /*
@@ -348,9 +349,21 @@ enum jal_status jaln_finish(jaln_session *sess)
 	if (NULL == sess || NULL == sess->pub_data) {
 		return JAL_E_INVAL_PARAM;
 	}
-	// cancel queued records and wait for any running ones to complete
-	jaln_send_close_session(sess);
 	jaln_context *ctx = sess->jaln_ctx;
+	// A failed send already finished the session, don't close it twice
+	pthread_mutex_lock(&ctx->lock);
+	if (sess->finished) {
+		pthread_mutex_unlock(&ctx->lock);
+		return JAL_OK;
+	}
+	sess->finished = axl_true;
+	pthread_mutex_unlock(&ctx->lock);
+
+	// wait for any records in flight to be synced before closing
+	if (JAL_OK == jaln_session_is_ok(sess)) {
+		jaln_pub_pipeline_flush(sess);
+	}
+	jaln_send_close_session(sess);
 	pthread_mutex_lock(&ctx->lock);
 	ctx->conn_callbacks->on_channel_close(sess->ch_info, ctx->user_data);
 	if (0 >= --ctx->sess_cnt) {
@@ -360,3 +373,11 @@ enum jal_status jaln_finish(jaln_session *sess)
 
 	return JAL_OK;
 }
+
+enum jal_status jaln_flush(jaln_session *sess)
+{
+	if (NULL == sess || NULL == sess->pub_data) {
+		return JAL_E_INVAL_PARAM;
+	}
+	return jaln_pub_pipeline_flush(sess);
+}
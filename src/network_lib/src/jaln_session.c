@@ -37,6 +37,7 @@
 #include "jaln_context.h"
 #include "jaln_digest_info.h"
 #include "jaln_publisher.h"
+#include "jaln_pub_pipeline.h"
 #include "jaln_session.h"
 
 jaln_session *jaln_session_create()
@@ -122,6 +123,8 @@ void jaln_session_destroy(jaln_session **psession) {
 	}
 
 	jaln_session *sess = *psession;
+	// Records in flight hold on to the digest, so release them first
+	jaln_pub_pipeline_destroy(&sess->pipeline);
 	if (sess->dgst_list) {
 		axl_list_free(sess->dgst_list);
 	}
@@ -48,6 +48,7 @@ extern "C" {
 
 struct jaln_sub_state_machine;
 struct jaln_pub_data;
+struct jaln_pub_pipeline;
 
 /**
  * The session context represents a connection to a peer for either sending or
@@ -66,11 +67,14 @@ struct jaln_session_t {
 
 	axl_bool closing;                    //!< Flag that indicates this
 	axl_bool errored;                    //!< Flag that indicates an error occurred within the session
+	axl_bool finished;                   //!< Flag that indicates jaln_finish was called for the session
 	axlList *dgst_list;                  //!< A list of jaln_digest_info structures that are calculated as data is sent/received
 	enum jaln_role role;                 //!< The role this context is performing (subscriber or publisher)
 	int dgst_list_max;                   //!< The maximum number of digest entries to keep as a subscriber
 	long dgst_timeout;                   //!< The maximum amount of time to wait before sending a 'digest' message
 	struct jaln_pub_data* pub_data;      //!< Data specific to a publisher
+	struct jaln_pub_pipeline *pipeline;  //!< Records a publisher has in flight, when pipelining is enabled
+	CURLM *pub_multi;                    //!< The multi handle of the jaln_pub_engine loop driving this session, or NULL
 };
 
 
@@ -38,20 +38,17 @@ class BerkeleyDb : public JalSubDatabase
 	std::string databasePath;
 
 	// For Audit, Log, the payload is always inserted as a value to the db. In the cases where
-	// the payload was written to disk, we will collect it into a vector first for processing
-	uint8_t* payloadCollector = NULL;
-
-	const uint8_t* getNonJournalPayload(const RecordInfo& recordInfo)
+	// the payload was written to disk, we will collect it into a buffer first for processing
+	// The buffer belongs to the caller so concurrent inserts don't share one
+	const uint8_t* getNonJournalPayload(
+		const RecordInfo& recordInfo,
+		std::vector<uint8_t>& payloadCollector)
 	{
 		if(recordInfo.payloadLen > 0 && recordInfo.payload.empty())
 		{
 			try
 			{
-				if(payloadCollector)
-				{
-					delete[] payloadCollector;
-				}
-				payloadCollector = new uint8_t[recordInfo.payloadLen];
+				payloadCollector.resize(recordInfo.payloadLen);
 			}
 			catch(...)
 			{
@@ -65,13 +62,13 @@ class BerkeleyDb : public JalSubDatabase
 					" for insertion to BerkeleyDB.";
 				throw std::runtime_error(errMsg);
 			}
-			f.read((char*)payloadCollector, recordInfo.payloadLen);
+			f.read((char*)payloadCollector.data(), recordInfo.payloadLen);
 			if(!f)
 			{
 				throw std::runtime_error("Failed to completely read payload file for insertion"
 					" to BerkeleyDB");
 			}
-			return payloadCollector;
+			return payloadCollector.data();
 		}
 		else
 		{
@@ -106,11 +103,6 @@ class BerkeleyDb : public JalSubDatabase
 
 	~BerkeleyDb()
 	{
-		if(payloadCollector)
-		{
-			delete[] payloadCollector;
-			payloadCollector = NULL;
-		}
 		jsub_teardown_db_layer(&db_ctx);
 	}
 
@@ -119,9 +111,10 @@ class BerkeleyDb : public JalSubDatabase
 		const uint8_t* sys_meta_ptr = recordInfo.sysMetadata.data();
 		const uint8_t* app_meta_ptr = recordInfo.appMetadata.data();
 		const uint8_t* payload_ptr;
+		std::vector<uint8_t> payloadCollector;
 		try
 		{
-			payload_ptr = getNonJournalPayload(recordInfo);
+			payload_ptr = getNonJournalPayload(recordInfo, payloadCollector);
 		}
 		catch(std::runtime_error& e)
 		{
@@ -167,9 +160,10 @@ class BerkeleyDb : public JalSubDatabase
 		const uint8_t* sys_meta_ptr = recordInfo.sysMetadata.data();
 		const uint8_t* app_meta_ptr = recordInfo.appMetadata.data();
 		const uint8_t* payload_ptr;
+		std::vector<uint8_t> payloadCollector;
 		try
 		{
-			payload_ptr = getNonJournalPayload(recordInfo);
+			payload_ptr = getNonJournalPayload(recordInfo, payloadCollector);
 		}
 		catch(std::runtime_error& e)
 		{
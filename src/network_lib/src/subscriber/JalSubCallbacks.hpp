@@ -16,17 +16,18 @@
 #ifndef __JAL__SUB__CALLBACKS__H__
 #define __JAL__SUB__CALLBACKS__H__
 
+#include <memory>
+
 #include "JalSubMessaging.hpp"
 #include "JalSubDigestCalculator.hpp"
+#include "JalSubSession.hpp"
 
 // A simple struct to hold the callbacks passed from the JalSubscriber to the
 // JalSubNetworkLayer
 struct SubscriberCallbacks
 {
 	std::function<Response(Message&)> messageHandler;
-	std::function<enum jal_digest_algorithm(Message&)> getDigestAlgorithm;
-	std::function<std::string(Message&)> getPublisherId;
-	std::function<ModeType(Message&)> getReceiveMode;
+	std::function<std::shared_ptr<Session>(const std::string&)> findSession;
 	std::function<void(Message&)> notifyTimeout;
 };
 
@@ -262,6 +262,12 @@ SubscriberConfig::SubscriberConfig(std::string configFilePath)
 	{
 		this->dbType = dbTypeFromString(dbTypeStr);
 	}
+
+	handleIntConfigSetting(config, "insert_threads", OPTIONAL, insertThreads);
+	if(insertThreads < 0)
+	{
+		throw std::runtime_error("Config setting: insert_threads must not be negative");
+	}
 }
 
 void SubscriberConfig::printConfiguration() const
@@ -296,4 +302,5 @@ void SubscriberConfig::printConfiguration() const
 	}
 	printf("digest_algorithms: %s\n", configuredAllowedAlgorithms.c_str());
 	printf("database_type: %s\n", dbTypeToString(dbType).c_str());
+	printf("insert_threads: %d\n", insertThreads);
 }
@@ -48,6 +48,8 @@ struct SubscriberConfig
 	int networkTimeout;
 	// Default to BerkeleyDB storage
 	DBType dbType = DBType::BDB;
+	// Default to inserting records on the thread that received them
+	int insertThreads = 0;
 	// Default to listen on all addresses
 	std::string ipAddr = "0.0.0.0";
 	
@@ -114,6 +114,10 @@ const std::string JAL_INVALID_DIGEST_STATUS = "JAL-Invalid-Digest-Status";
 const std::string JAL_INVALID_DIGEST = "JAL-Invalid-Digest";
 const std::string JAL_SYNC_FAILURE = "JAL-Sync-Failure";
 
+// The most records a session holds while waiting for their digest responses.
+// Matches the largest pipeline depth a JALoP publisher allows.
+const size_t MAX_PENDING_RECORDS = 64;
+
 // Translation of microhttpd constants
 const int JAL_STATUS_OK = MHD_HTTP_OK;
 const int JAL_STATUS_SERVER_ERROR = MHD_HTTP_INTERNAL_SERVER_ERROR;
@@ -16,17 +16,15 @@
 #ifndef __JAL__SUB__DATABASE__H__
 #define __JAL__SUB__DATABASE__H__
 
-#include <mutex>
-#include <shared_mutex>
-
 struct RecordInfo;
 
 // This header defines the interface any database implementation must follow
 // to be used by the subscriber
+// Each message is handled on its own thread, so the insert functions are
+// called concurrently and implementations must be safe for that
 class JalSubDatabase
 {
 	private:
-	std::shared_mutex dbMutex;
 	virtual bool insertAuditImpl(const RecordInfo& recordInfo) = 0;
 	virtual bool insertLogImpl(const RecordInfo& recordInfo) = 0;
 	virtual bool insertJournalImpl(const RecordInfo& recordInfo) = 0;
@@ -35,17 +33,14 @@ class JalSubDatabase
 	virtual ~JalSubDatabase(){};
 	bool insertAudit(const RecordInfo& recordInfo)
 	{
-		std::unique_lock lock(dbMutex);
 		return insertAuditImpl(recordInfo);
 	}
 	bool insertLog(const RecordInfo& recordInfo)
 	{
-		std::unique_lock lock(dbMutex);
 		return insertLogImpl(recordInfo);
 	}
 	bool insertJournal(const RecordInfo& recordInfo)
 	{
-		std::unique_lock lock(dbMutex);
 		return insertJournalImpl(recordInfo);
 	}
 };
@@ -17,6 +17,7 @@
 #ifndef __JAL__SUB__FS__DB__H__
 #define __JAL__SUB__FS__DB__H__
 
+#include <atomic>
 #include <vector>
 #include <stdexcept>
 #include <fstream>
@@ -40,9 +41,11 @@ class FsDb : public JalSubDatabase
 	std::string journalStoragePath;
 	std::string logStoragePath;
 
-	uint64_t auditCounter = 0;
-	uint64_t journalCounter = 0;
-	uint64_t logCounter = 0;
+	// Inserts of the same type take their record numbers from the same
+	// counter, from several threads at once
+	std::atomic<uint64_t> auditCounter{0};
+	std::atomic<uint64_t> journalCounter{0};
+	std::atomic<uint64_t> logCounter{0};
 
 	SubscriberConfig config;
 
@@ -135,10 +138,26 @@ class FsDb : public JalSubDatabase
 		return nextRecordNum;
 	}
 
+	// Take the next record number from counter, rolling over to 0 once it
+	// reaches COUNTER_MAX
+	// Note - if the user hasn't done something to clear old records when this rollover
+	// happens, further inserts will fail because the directories for the new inserts
+	// will already exist
+	uint64_t takeRecordNum(std::atomic<uint64_t>& counter)
+	{
+		uint64_t current = counter.load();
+		uint64_t recordNum;
+		do
+		{
+			recordNum = current >= COUNTER_MAX ? 0 : current;
+		} while(!counter.compare_exchange_weak(current, recordNum + 1));
+		return recordNum;
+	}
+
 	bool writeData(
 		const std::string& recordDir,
 		const std::string& fileName,
-		std::vector<uint8_t> data)
+		const std::vector<uint8_t>& data)
 	{
 		// If no data exists, do nothing, return success
 		if(data.empty())
@@ -295,38 +314,17 @@ class FsDb : public JalSubDatabase
 
 	bool insertAuditImpl(const RecordInfo& recordInfo) override
 	{
-		// Note - if the user hasn't done something to clear old records when this rollover
-		// happens, further inserts will fail because the directories for the new inserts
-		// will already exist
-		if(auditCounter >= COUNTER_MAX)
-		{
-			auditCounter = 0;
-		}
-		return writeToDb(auditStoragePath, auditCounter++, recordInfo);
+		return writeToDb(auditStoragePath, takeRecordNum(auditCounter), recordInfo);
 	}
 
 	bool insertLogImpl(const RecordInfo& recordInfo) override
 	{
-		// Note - if the user hasn't done something to clear old records when this rollover
-		// happens, further inserts will fail because the directories for the new inserts
-		// will already exist
-		if(logCounter >= COUNTER_MAX)
-		{
-			logCounter = 0;
-		}
-		return writeToDb(logStoragePath, logCounter++, recordInfo);
+		return writeToDb(logStoragePath, takeRecordNum(logCounter), recordInfo);
 	}
 
 	bool insertJournalImpl(const RecordInfo& recordInfo) override
 	{
-		// Note - if the user hasn't done something to clear old records when this rollover
-		// happens, further inserts will fail because the directories for the new inserts
-		// will already exist
-		if(journalCounter >= COUNTER_MAX)
-		{
-			journalCounter = 0;
-		}
-		return writeToDb(journalStoragePath, journalCounter++, recordInfo);
+		return writeToDb(journalStoragePath, takeRecordNum(journalCounter), recordInfo);
 	}
 };
 
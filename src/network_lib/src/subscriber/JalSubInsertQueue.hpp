@@ -0,0 +1,132 @@
+/*
+ * Copyright (C) 2023 The National Security Agency (NSA)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __JAL__SUB__INSERT__QUEUE__H__
+#define __JAL__SUB__INSERT__QUEUE__H__
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "JalSubDatabase.hpp"
+#include "JalSubRecordInfo.hpp"
+
+// Hands inserts to a fixed number of writer threads instead of running them on
+// the http thread that received the record. With a thread per connection, this
+// keeps the number of concurrent database writers bounded no matter how many
+// publishers are connected. The http thread still waits for its insert, so a
+// sync is only ever sent once the record is durable.
+class InsertQueue : public JalSubDatabase
+{
+	private:
+	std::shared_ptr<JalSubDatabase> db;
+
+	std::mutex queueMutex;
+	std::condition_variable queueCond;
+	std::deque<std::packaged_task<bool()>> queue;
+	bool stopping = false;
+
+	std::vector<std::thread> writers;
+
+	void writerLoop()
+	{
+		while(true)
+		{
+			std::packaged_task<bool()> task;
+			{
+				std::unique_lock lock(queueMutex);
+				queueCond.wait(lock, [this]{ return stopping || !queue.empty(); });
+				if(queue.empty())
+				{
+					// Only reached once stopping
+					return;
+				}
+				task = std::move(queue.front());
+				queue.pop_front();
+			}
+			task();
+		}
+	}
+
+	bool enqueue(std::function<bool()> insert)
+	{
+		std::packaged_task<bool()> task(std::move(insert));
+		std::future<bool> result = task.get_future();
+		{
+			std::lock_guard lock(queueMutex);
+			queue.push_back(std::move(task));
+		}
+		queueCond.notify_one();
+		return result.get();
+	}
+
+	bool insertAuditImpl(const RecordInfo& recordInfo) override
+	{
+		return enqueue([this, &recordInfo]{ return db->insertAudit(recordInfo); });
+	}
+
+	bool insertLogImpl(const RecordInfo& recordInfo) override
+	{
+		return enqueue([this, &recordInfo]{ return db->insertLog(recordInfo); });
+	}
+
+	bool insertJournalImpl(const RecordInfo& recordInfo) override
+	{
+		return enqueue([this, &recordInfo]{ return db->insertJournal(recordInfo); });
+	}
+
+	public:
+	static std::shared_ptr<JalSubDatabase> insertQueueFactory(
+		std::shared_ptr<JalSubDatabase> db,
+		int numWriters)
+	{
+		return std::make_shared<InsertQueue>(db, numWriters);
+	}
+
+	InsertQueue(std::shared_ptr<JalSubDatabase> paramDb, int numWriters) : db(paramDb)
+	{
+		if(numWriters < 1)
+		{
+			throw std::runtime_error("An insert queue needs at least one writer thread");
+		}
+		for(int i = 0; i < numWriters; i++)
+		{
+			writers.emplace_back(&InsertQueue::writerLoop, this);
+		}
+	}
+
+	// Inserts already queued are finished before the writers exit
+	~InsertQueue()
+	{
+		{
+			std::lock_guard lock(queueMutex);
+			stopping = true;
+		}
+		queueCond.notify_all();
+		for(auto& writer : writers)
+		{
+			writer.join();
+		}
+	}
+};
+
+#endif
@@ -119,6 +119,66 @@ static char* load_file(const char* filename)
 	return buffer;
 }
 
+// State kept for the life of a connection
+// A publisher sends the messages of a session over the same keep-alive
+// connections, so the session found for one message is remembered for the next
+struct ConnectionContext
+{
+	std::string sessionId;
+	std::weak_ptr<Session> session;
+};
+
+static void connection_notify(
+	void* cls,
+	struct MHD_Connection* conn,
+	void** socket_context,
+	enum MHD_ConnectionNotificationCode toe)
+{
+	(void)cls;
+	(void)conn;
+
+	if(MHD_CONNECTION_NOTIFY_STARTED == toe)
+	{
+		*socket_context = new ConnectionContext();
+	}
+	else if(MHD_CONNECTION_NOTIFY_CLOSED == toe)
+	{
+		delete (ConnectionContext*)(*socket_context);
+		*socket_context = NULL;
+	}
+}
+
+// Find the session a message belongs to, asking the subscriber only when it
+// isn't the one the connection used last
+// Returns nullptr if there is no session by the message's JAL-Session-Id
+static std::shared_ptr<Session> find_session(
+	struct MHD_Connection* conn,
+	const SubscriberCallbacks& callbacks,
+	const Message& message)
+{
+	std::string uuid = message.getHeader(HEADER_JAL_SESSION_ID_TYPE);
+	const union MHD_ConnectionInfo* info =
+		MHD_get_connection_info(conn, MHD_CONNECTION_INFO_SOCKET_CONTEXT);
+	ConnectionContext* connCtx = info ? (ConnectionContext*)info->socket_context : NULL;
+
+	if(connCtx && connCtx->sessionId == uuid)
+	{
+		std::shared_ptr<Session> session = connCtx->session.lock();
+		if(session && session->isActive())
+		{
+			return session;
+		}
+	}
+
+	std::shared_ptr<Session> session = callbacks.findSession(uuid);
+	if(connCtx)
+	{
+		connCtx->sessionId = uuid;
+		connCtx->session = session;
+	}
+	return session;
+}
+
 void* request_completed(
 	void* cls,
 	struct MHD_Connection* conn,
@@ -128,7 +188,7 @@ void* request_completed(
 	(void)conn;
 
 	// Extract callbacks handle
-	SubscriberCallbacks callbacks = ((ResponseFuncSettings*)cls)->callbacks;
+	const SubscriberCallbacks& callbacks = ((ResponseFuncSettings*)cls)->callbacks;
 
 	Message* messagePtr = (Message*)(*con_cls);
 	
@@ -182,7 +242,7 @@ static int response_func(
 	size_t upload_data_received = *upload_data_size;
 
 	// Extract cls values
-	SubscriberCallbacks callbacks = ((ResponseFuncSettings*)cls)->callbacks;
+	const SubscriberCallbacks& callbacks = ((ResponseFuncSettings*)cls)->callbacks;
 	bool debug = ((ResponseFuncSettings*)cls)->debug;
 
 	if(NULL == *con_cls)
@@ -234,23 +294,22 @@ static int response_func(
 	if(messagePtr->isRecord())
 	{
 		// Only if this is the first round of processing
-		// Hand the message off to the Subscriber (by reference) to attempt to
-		// get the digestAlgorithm associated with the session that shares this
-		// message's Id.
+		// Find the session that shares this message's Id to get the
+		// digestAlgorithm, publisherId and receiveMode to use.
 		// Note that the first iteration through POST messages usually has only the headers
 		// and no data
 		if(newMessage)
 		{
-			try
+			std::shared_ptr<Session> session = find_session(conn, callbacks, *messagePtr);
+			if(session)
 			{
-				messagePtr->setDigestAlgorithm(callbacks.getDigestAlgorithm(*messagePtr));
-				messagePtr->setPublisherId(callbacks.getPublisherId(*messagePtr));
-				messagePtr->setReceiveMode(callbacks.getReceiveMode(*messagePtr));
+				messagePtr->setDigestAlgorithm(session->getDigestAlgorithm());
+				messagePtr->setPublisherId(session->getPublisherId());
+				messagePtr->setReceiveMode(session->getReceiveMode());
 			}
-			catch(...)
+			else
 			{
-				// If the digest algorithm, receiveMode, or publisherId couldn't be obtained,
-				// a session hasn't been created with an Id matching the one in this message
+				// A session hasn't been created with an Id matching the one in this message
 				messagePtr->setError(MSG_SESSION_FAILURE_STR, JAL_UNSUPPORTED_SESSION_ID);
 			}
 		}
@@ -375,6 +434,7 @@ HttpServer::HttpServer(
 			MHD_OPTION_HTTPS_MEM_CERT, publicCert,
 			MHD_OPTION_HTTPS_MEM_TRUST, trustStore,
 			MHD_OPTION_NOTIFY_COMPLETED, request_completed, &(this->responseFuncSettings),
+			MHD_OPTION_NOTIFY_CONNECTION, connection_notify, NULL,
 			MHD_OPTION_HTTPS_MEM_KEY, privateKey,
 			MHD_OPTION_CONNECTION_TIMEOUT, config.networkTimeout,
 			MHD_OPTION_SOCK_ADDR, res->ai_addr,
@@ -390,6 +450,7 @@ HttpServer::HttpServer(
 			&response_func,
 			&(this->responseFuncSettings),
 			MHD_OPTION_NOTIFY_COMPLETED, request_completed, &(this->responseFuncSettings),
+			MHD_OPTION_NOTIFY_CONNECTION, connection_notify, NULL,
 			MHD_OPTION_CONNECTION_TIMEOUT, config.networkTimeout,
 			MHD_OPTION_SOCK_ADDR, res->ai_addr,
 			MHD_OPTION_END);
@@ -22,10 +22,8 @@ enum class AuditFormat
 	XML
 };
 
-// TODO: Currently a Session can have only one record in progress at a time
-// It may be useful to have a map of jalId to Record mappings if it is necessary
-// to allow parallel record flows over the same session
-// I don't believe the publisher currently supports this sort of parallelism
+// A Session keeps one RecordInfo per record waiting on its digest response,
+// keyed by jalId, so a pipelining publisher can have several in flight
 struct RecordInfo
 {
 	// The intent for the RecordInfo class is for it to be one-to-one with a received
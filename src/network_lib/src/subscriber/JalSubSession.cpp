@@ -86,6 +86,16 @@ ModeType Session::getReceiveMode()
 	return config.mode;
 }
 
+bool Session::isActive() const
+{
+	return active;
+}
+
+void Session::deactivate()
+{
+	active = false;
+}
+
 // shorthand for reducing duplication
 Response Session::generateNack(std::string errorMessage)
 {
@@ -96,12 +106,12 @@ Response Session::generateNack(std::string errorMessage)
 }
 
 // shorthand for reducing duplication
-Response Session::generateDigestChallenge()
+Response Session::generateDigestChallenge(const std::string& jalId, const std::string& digest)
 {
 	Response response;
 	response.addHeader(HEADER_MESSAGE_TYPE, MSG_DIGEST_CHALLENGE_STR);
-	response.addHeader(HEADER_JAL_ID_TYPE, currentRecordInfo.jalId);
-	response.addHeader(HEADER_JAL_DIGEST_VALUE, currentRecordInfo.digest);
+	response.addHeader(HEADER_JAL_ID_TYPE, jalId);
+	response.addHeader(HEADER_JAL_DIGEST_VALUE, digest);
 	return response;
 }
 
@@ -118,12 +128,12 @@ Response Session::generateRecordFailure(std::string errorMessage, std::string ja
 }
 
 // shorthand for reducing duplication
-Response Session::generateSyncFailure()
+Response Session::generateSyncFailure(const std::string& jalId)
 {
 	debugOutput(config.debug, stderr, "generating sync failure\n");
 	Response response;
 	response.addHeader(HEADER_MESSAGE_TYPE, MSG_SYNC_FAILURE_STR);
-	response.addHeader(HEADER_JAL_ID_TYPE, currentRecordInfo.jalId);
+	response.addHeader(HEADER_JAL_ID_TYPE, jalId);
 	response.addHeader(HEADER_JAL_ERROR_MESSAGE_TYPE, JAL_SYNC_FAILURE);
 	return response;
 }
@@ -446,28 +456,25 @@ bool Session::validateMode(const Message& message)
 	return true;
 }
 
-Response Session::handleAuditMessage(const Message& message)
+Response Session::handleAuditMessage(const std::string& jalId, const std::string& digest)
 {
-	(void)message;
 	//Always print
 	fprintf(stdout, "Sending digest challenge for type: audit sessionId: %s\n", uuid.c_str());
-	return generateDigestChallenge();
+	return generateDigestChallenge(jalId, digest);
 }
 
-Response Session::handleLogMessage(const Message& message)
+Response Session::handleLogMessage(const std::string& jalId, const std::string& digest)
 {
-	(void)message;
 	//Always print
 	fprintf(stdout, "Sending digest challenge for type: log sessionId: %s\n", uuid.c_str());
-	return generateDigestChallenge();
+	return generateDigestChallenge(jalId, digest);
 }
 
-Response Session::handleJournalMessage(const Message& message)
+Response Session::handleJournalMessage(const std::string& jalId, const std::string& digest)
 {
-	(void)message;
 	//Always print
 	fprintf(stdout, "Sending digest challenge for type: journal sessionId: %s\n", uuid.c_str());
-	return generateDigestChallenge();
+	return generateDigestChallenge(jalId, digest);
 }
 
 Response Session::handleJournalMissing(const Message& message)
@@ -509,10 +516,18 @@ Response Session::handleDigestChallengeResponse(const Message& message)
 		return generateRecordFailure(JAL_INVALID_JAL_ID, "");
 	}
 
-	// Ensure the received JAL_ID matches the record we're working on
-	if(jalId != currentRecordInfo.jalId)
+	// Ensure the received JAL_ID matches a record we're working on, and take it
+	// so a repeated digest response can't insert it twice
+	RecordInfo currentRecordInfo;
 	{
-		return generateRecordFailure(JAL_INVALID_JAL_ID, jalId);
+		std::lock_guard<std::mutex> lock(sessionMutex);
+		auto it = pendingRecords.find(jalId);
+		if(it == pendingRecords.end())
+		{
+			return generateRecordFailure(JAL_INVALID_JAL_ID, jalId);
+		}
+		currentRecordInfo = std::move(it->second);
+		pendingRecords.erase(it);
 	}
 
 	DigestStatus status;
@@ -522,11 +537,13 @@ Response Session::handleDigestChallengeResponse(const Message& message)
 	}
 	catch(std::runtime_error& e)
 	{
+		removePayloadFile(currentRecordInfo);
 		return generateRecordFailure(JAL_INVALID_DIGEST_STATUS, jalId);
 	}
 
 	if(DigestStatus::INVALID == status)
 	{
+		removePayloadFile(currentRecordInfo);
 		return generateRecordFailure(JAL_INVALID_DIGEST, jalId);
 	}
 
@@ -536,6 +553,7 @@ Response Session::handleDigestChallengeResponse(const Message& message)
 		// This would be extremely unusual and probably implies state corruption of the
 		// Subscriber class which contains the db and Sessions
 		fprintf(stderr, "Failed to get handle to db interface\n");
+		removePayloadFile(currentRecordInfo);
 		return generateRecordFailure(JAL_RECORD_FAILURE, currentRecordInfo.jalId);
 	}
 
@@ -560,19 +578,13 @@ Response Session::handleDigestChallengeResponse(const Message& message)
 	// Discard the payload file - if any
 	// If the file has been moved by the db interface, the remove will fail, which is fine
 	// as long as the temporary is gone one way or another
-	if(!currentRecordInfo.payloadFileName.empty())
-	{
-		remove(currentRecordInfo.payloadFileName.c_str());
-		debugOutput(config.debug, stdout, "handle digestChallengeResponse removing file: %s\n",
-			currentRecordInfo.payloadFileName.c_str());
-		currentRecordInfo.payloadFileName.clear();
-	}
+	removePayloadFile(currentRecordInfo);
 
 	if(false == inserted)
 	{
 		// Always print
 		fprintf(stdout, "Sending SYNC failure for jalId: %s\n", currentRecordInfo.jalId.c_str());
-		return generateSyncFailure();
+		return generateSyncFailure(currentRecordInfo.jalId);
 	}
 
 	Response response;
@@ -588,7 +600,7 @@ Response Session::handleRecord(const Message& message, RecordType messageRecordT
 	// Audit, Log, and Journal record messages have similar information except for
 	// the additional AuditFormat header on audit messages.
 	// The other notable difference is that the name of the payload header varies
-	// Process these common headers and store them in the Session's currentRecordInfo
+	// Process these common headers and store them in the Session's pendingRecords
 
 	// Some headers were already pre-processed
 	// in the network layer for efficiency reasons and will already be present in
@@ -605,31 +617,49 @@ Response Session::handleRecord(const Message& message, RecordType messageRecordT
 	// We're going to cheat a little bit - the move constructor violates the constness
 	// of the message, but the const label is useful everywhere else in the chain
 	// Fortunately, we know the underlying storage is always a mutable object, so this is legal
-	currentRecordInfo = (const_cast<Message&>(message)).getInfo();
+	RecordInfo recordInfo = std::move((const_cast<Message&>(message)).getInfo());
+	const std::string jalId = recordInfo.jalId;
+	const std::string digest = recordInfo.digest;
+	{
+		std::lock_guard<std::mutex> lock(sessionMutex);
+		// A resent record replaces the pending one, anything else must fit
+		// within the publisher's pipeline depth
+		if(pendingRecords.size() >= MAX_PENDING_RECORDS &&
+			pendingRecords.find(jalId) == pendingRecords.end())
+		{
+			fprintf(stderr, "Too many records waiting on digest responses, rejecting jalId: %s\n",
+				jalId.c_str());
+			removePayloadFile(recordInfo);
+			return generateRecordFailure(JAL_RECORD_FAILURE, jalId);
+		}
+		pendingRecords[jalId] = std::move(recordInfo);
+	}
 
 	// Set some values based on the type we're dealing with
-	std::function<Response(const Message&)> messageHandler;
+	std::function<Response(const std::string&, const std::string&)> messageHandler;
 	switch(messageRecordType)
 	{
 		case RecordType::JAL_AUDIT:
-			messageHandler = std::bind(&Session::handleAuditMessage, this, std::placeholders::_1);
+			messageHandler = std::bind(&Session::handleAuditMessage, this,
+				std::placeholders::_1, std::placeholders::_2);
 			break;
 		case RecordType::JAL_LOG:
-			messageHandler = std::bind(&Session::handleLogMessage, this, std::placeholders::_1);
+			messageHandler = std::bind(&Session::handleLogMessage, this,
+				std::placeholders::_1, std::placeholders::_2);
 			break;
 		case RecordType::JAL_JOURNAL:
-			messageHandler = std::bind(&Session::handleJournalMessage, this, std::placeholders::_1);
+			messageHandler = std::bind(&Session::handleJournalMessage, this,
+				std::placeholders::_1, std::placeholders::_2);
 			break;
 		default:
 			// Shouldn't be possible to reach
 			fprintf(stderr, "Unreachable code reached in Session::handleRecord. "
 				"Generating Record Failure response\n");
-			generateRecordFailure(JAL_UNSUPPORTED_RECORD_TYPE, currentRecordInfo.jalId);
-			break;
+			return generateRecordFailure(JAL_UNSUPPORTED_RECORD_TYPE, jalId);
 	}
 
 	// Defer to the appropriate specific function based on message type
-	return messageHandler(message);
+	return messageHandler(jalId, digest);
 }
 
 Response Session::handleInitMessage(const Message& message)
@@ -726,7 +756,10 @@ Response Session::handleCloseMessage(const Message& message)
 Response Session::handleMessage(ReceiveMessageType type, const Message& message)
 {
 	// Update last-access time
-	lastAccess = std::chrono::steady_clock::now();
+	{
+		std::lock_guard<std::mutex> lock(sessionMutex);
+		lastAccess = std::chrono::steady_clock::now();
+	}
 	switch(type)
 	{
 		case(ReceiveMessageType::MSG_INIT):
@@ -777,9 +810,30 @@ Session::Session(
 
 Session::~Session()
 {
+	// Journal payloads are kept in the staging directory so the publisher can
+	// resume them, any other record left waiting is abandoned
+	if(RecordType::JAL_JOURNAL != recordType)
+	{
+		for(auto& [jalId, record] : pendingRecords)
+		{
+			removePayloadFile(record);
+		}
+	}
+}
+
+void Session::removePayloadFile(RecordInfo& record)
+{
+	if(!record.payloadFileName.empty())
+	{
+		remove(record.payloadFileName.c_str());
+		debugOutput(config.debug, stdout, "removing payload file: %s\n",
+			record.payloadFileName.c_str());
+		record.payloadFileName.clear();
+	}
 }
 
 std::chrono::time_point<std::chrono::steady_clock> Session::getLastAccess() const
 {
+	std::lock_guard<std::mutex> lock(sessionMutex);
 	return lastAccess;
 }
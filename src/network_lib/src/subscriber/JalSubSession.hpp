@@ -20,8 +20,10 @@
 #include <regex>
 #include <stdexcept>
 #include <sstream>
+#include <atomic>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <utility>
 #include <chrono>
 #include <jalop/jal_digest.h>
@@ -55,7 +57,14 @@ class Session final
 
 	std::string sessionId;
 
-	RecordInfo currentRecordInfo;
+	// Records that were received and challenged, keyed by jalId, waiting on
+	// their digest responses. A pipelining publisher has several in flight
+	// at once, each on its own connection.
+	std::map<std::string, RecordInfo> pendingRecords;
+
+	// Guards pendingRecords and lastAccess, since messages for the same
+	// session can arrive on several connections at once
+	mutable std::mutex sessionMutex;
 
 	// Each session is configured to use a specific digest algorithm during initialization
 	enum jal_digest_algorithm digestAlgorithm = JAL_DIGEST_ALGORITHM_DEFAULT;
@@ -86,6 +95,10 @@ class Session final
 	std::chrono::time_point<std::chrono::steady_clock> lastAccess 
 		= std::chrono::steady_clock::now();
 	
+	// Cleared once the session is removed from the subscriber's session table.
+	// Connections that still hold the session must not use it any more
+	std::atomic<bool> active{true};
+
 	// Information about whether or not this session should request a journal resume
 	std::string resumeId;
 	size_t resumeOffset = 0;
@@ -105,11 +118,11 @@ class Session final
 
 	bool validateMode(const Message& message);
 
-	Response handleAuditMessage(const Message& message);
+	Response handleAuditMessage(const std::string& jalId, const std::string& digest);
 
-	Response handleLogMessage(const Message& message);
+	Response handleLogMessage(const std::string& jalId, const std::string& digest);
 
-	Response handleJournalMessage(const Message& message);
+	Response handleJournalMessage(const std::string& jalId, const std::string& digest);
 
 	Response handleJournalMissing(const Message& message);
 
@@ -119,14 +132,16 @@ class Session final
 
 	Response generateNack(std::string errorMessage);
 
-	Response generateDigestChallenge();
+	Response generateDigestChallenge(const std::string& jalId, const std::string& digest);
 
 	Response generateRecordFailure(std::string errorMessage, std::string jalId);
 
-	Response generateSyncFailure();
+	Response generateSyncFailure(const std::string& jalId);
 
 	bool shouldResume();
 
+	void removePayloadFile(RecordInfo& record);
+
 	public:
 	enum jal_digest_algorithm getDigestAlgorithm();
 
@@ -144,10 +159,16 @@ class Session final
 
 	std::chrono::time_point<std::chrono::steady_clock> getLastAccess() const;
 
+	bool isActive() const;
+
+	void deactivate();
+
+	// Sessions are shared between the session table and the connections
+	// using them, since the mutex can't be moved
 	Session(const Session& orig) = delete;
-	Session(Session&&) = default;
+	Session(Session&&) = delete;
 	Session& operator=(const Session&) = delete;
-	Session& operator=(Session&&) = default;
+	Session& operator=(Session&&) = delete;
 
 	Session(
 		std::string uuid,
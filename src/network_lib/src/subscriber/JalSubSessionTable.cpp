@@ -0,0 +1,120 @@
+/*
+ * Copyright (C) 2023 The National Security Agency (NSA)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <functional>
+
+#include "JalSubSessionTable.hpp"
+
+SessionTable::SessionTable(size_t paramSessionLimit) :
+	sessionLimit(paramSessionLimit)
+{
+}
+
+SessionTable::Shard& SessionTable::shardFor(const std::string& uuid)
+{
+	return shards[std::hash<std::string>{}(uuid) % SHARD_COUNT];
+}
+
+std::shared_ptr<Session> SessionTable::find(const std::string& uuid)
+{
+	Shard& shard = shardFor(uuid);
+	std::lock_guard lock(shard.mutex);
+	auto it = shard.sessions.find(uuid);
+	if(it == shard.sessions.end())
+	{
+		return nullptr;
+	}
+	Entry& entry = it->second;
+	shard.lru.splice(shard.lru.begin(), shard.lru, entry.lruPos);
+	entry.lastAccess = std::chrono::steady_clock::now();
+	return entry.session;
+}
+
+bool SessionTable::insert(const std::string& uuid, std::shared_ptr<Session> session)
+{
+	// Same as before sharding, the limit is checked before the new session
+	// is added
+	if(count > sessionLimit)
+	{
+		evictOldest();
+	}
+
+	Shard& shard = shardFor(uuid);
+	std::lock_guard lock(shard.mutex);
+	auto [it, inserted] = shard.sessions.try_emplace(uuid);
+	if(!inserted)
+	{
+		return false;
+	}
+	shard.lru.push_front(uuid);
+	it->second.session = std::move(session);
+	it->second.lruPos = shard.lru.begin();
+	it->second.lastAccess = std::chrono::steady_clock::now();
+	++count;
+	return true;
+}
+
+void SessionTable::erase(const std::string& uuid)
+{
+	// Let the session be destroyed outside the shard lock, it may have
+	// files to clean up
+	std::shared_ptr<Session> session;
+	{
+		Shard& shard = shardFor(uuid);
+		std::lock_guard lock(shard.mutex);
+		auto it = shard.sessions.find(uuid);
+		if(it == shard.sessions.end())
+		{
+			return;
+		}
+		session = std::move(it->second.session);
+		session->deactivate();
+		shard.lru.erase(it->second.lruPos);
+		shard.sessions.erase(it);
+		--count;
+	}
+}
+
+// Each shard's least recently used session is at the back of its list, so
+// the oldest session overall is the oldest of those
+void SessionTable::evictOldest()
+{
+	std::string oldestKey;
+	std::chrono::time_point<std::chrono::steady_clock> tp;
+	for(Shard& shard : shards)
+	{
+		std::lock_guard lock(shard.mutex);
+		if(shard.lru.empty())
+		{
+			continue;
+		}
+		const std::string& key = shard.lru.back();
+		const Entry& entry = shard.sessions.at(key);
+		if(oldestKey.empty() || entry.lastAccess < tp)
+		{
+			oldestKey = key;
+			tp = entry.lastAccess;
+		}
+	}
+	if(!oldestKey.empty())
+	{
+		erase(oldestKey);
+	}
+}
+
+size_t SessionTable::size() const
+{
+	return count;
+}
@@ -0,0 +1,85 @@
+/*
+ * Copyright (C) 2023 The National Security Agency (NSA)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef __JAL__SUB__SESSION__TABLE__H__
+#define __JAL__SUB__SESSION__TABLE__H__
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "JalSubSession.hpp"
+
+// The active sessions of a subscriber, keyed by the JAL-Session-Id.
+// Sessions are spread over several shards, each with its own lock, so
+// messages for different sessions rarely wait on each other. Each shard
+// keeps its sessions in least recently used order, so the oldest session
+// can be found without scanning every session when the limit is reached.
+class SessionTable
+{
+	private:
+	static constexpr size_t SHARD_COUNT = 16;
+
+	struct Entry
+	{
+		std::shared_ptr<Session> session;
+		// Position of the session in its shard's lru list
+		std::list<std::string>::iterator lruPos;
+		std::chrono::time_point<std::chrono::steady_clock> lastAccess;
+	};
+
+	struct Shard
+	{
+		std::mutex mutex;
+		std::unordered_map<std::string, Entry> sessions;
+		// Most recently used first
+		std::list<std::string> lru;
+	};
+
+	std::array<Shard, SHARD_COUNT> shards;
+
+	std::atomic<size_t> count{0};
+
+	// The number of sessions that may be kept before the least recently
+	// used one is dropped to make room for a new one
+	size_t sessionLimit;
+
+	Shard& shardFor(const std::string& uuid);
+
+	void evictOldest();
+
+	public:
+	// Returns the session, or nullptr if there is none by this uuid
+	// Marks the session as the most recently used in its shard
+	std::shared_ptr<Session> find(const std::string& uuid);
+
+	// Returns false if there is already a session by this uuid
+	// If the table is over the session limit, the least recently used
+	// session is dropped first
+	bool insert(const std::string& uuid, std::shared_ptr<Session> session);
+
+	void erase(const std::string& uuid);
+
+	size_t size() const;
+
+	SessionTable(size_t sessionLimit);
+};
+
+#endif
@@ -15,14 +15,15 @@
  */
 #include <random>
 #include <exception>
-#include <mutex>
-#include <shared_mutex>
+#include <memory>
+#include <stdexcept>
 
 #include "JalSubscriber.hpp"
 #include "JalSubConfig.hpp"
 #include "JalSubUtils.hpp"
 #include "JalSubBerkeleyDb.hpp"
 #include "JalSubFsDb.hpp"
+#include "JalSubInsertQueue.hpp"
 
 // TODO: Replace with libuuid or similar
 // This implementation is "insufficiently random" according to some research into
@@ -70,34 +71,6 @@ static std::string generateNewUuid()
 	return ss.str();
 }
 
-// Helper to remove oldest session from the active session list
-void JalSubscriber::pruneOldestSession()
-{
-	std::string oldestKey = "";
-	std::chrono::time_point<std::chrono::steady_clock> tp;
-	// obtain exclusive access to the session list before modifying
-	// released when the lock goes out of scope
-	std::unique_lock lock(sessionsMutex);
-	for( auto const& [key, value] : activeSessions)
-	{
-		if(oldestKey.empty())
-		{
-			oldestKey = key;
-			tp = value.getLastAccess();
-			continue;
-		}
-		else
-		{
-			if(value.getLastAccess() < tp)
-			{
-				oldestKey = key;
-				tp = value.getLastAccess();
-			}
-		}
-	}
-	activeSessions.erase(oldestKey);
-}
-
 Response generateSessFailure(
 	const Message& message,
 	std::string uuid,
@@ -117,39 +90,12 @@ Response generateSessFailure(
 }
 
 // This callback is used by the httpServer to associate a given incoming message with
-// the digest algorithm to use during payload receipt
-// Throws out_of_range if there is no matching session or the HEADER_JAL_SESSION_ID_TYPE
-// header is missing
-enum jal_digest_algorithm JalSubscriber::getDigestAlgorithm(const Message& message)
-{
-	std::string uuid = message.getHeader(HEADER_JAL_SESSION_ID_TYPE);
-	// Obtain a read-lock on the session list.
-	std::shared_lock lock(sessionsMutex);
-	return activeSessions.at(uuid).getDigestAlgorithm();
-}
-
-// This callback is used by the httpServer to associate a given incoming message with
-// the publisherId to use during payload receipt
-// Throws out_of_range if there is no matching session or the HEADER_JAL_SESSION_ID_TYPE
-// header is missing
-std::string JalSubscriber::getPublisherId(const Message& message)
+// the session it belongs to, which holds the digest algorithm, publisherId and
+// receive mode to use during payload receipt
+// Returns nullptr if there is no matching session
+std::shared_ptr<Session> JalSubscriber::findSession(const std::string& uuid)
 {
-	std::string uuid = message.getHeader(HEADER_JAL_SESSION_ID_TYPE);
-	// Obtain a read-lock on the session list.
-	std::shared_lock lock(sessionsMutex);
-	return activeSessions.at(uuid).getPublisherId();
-}
-
-// This callback is used by the httpServer to associate a given incoming message with
-// the receive mode to use during payload receipt
-// Throws out_of_range if there is no matching session or the HEADER_JAL_SESSION_ID_TYPE
-// header is missing
-ModeType JalSubscriber::getReceiveMode(const Message& message)
-{
-	std::string uuid = message.getHeader(HEADER_JAL_SESSION_ID_TYPE);
-	// Obtain a read-lock on the session list.
-	std::shared_lock lock(sessionsMutex);
-	return activeSessions.at(uuid).getReceiveMode();
+	return activeSessions.find(uuid);
 }
 
 // This callback is used by the httpServer to notify the subscriber that a particular
@@ -165,8 +111,6 @@ void JalSubscriber::notifyTimeout(Message& message)
 	try
 	{
 		std::string uuid = message.getHeader(HEADER_JAL_SESSION_ID_TYPE);
-		// Obtain an exclusive-lock on the session list.
-		std::unique_lock lock(sessionsMutex);
 		activeSessions.erase(uuid);
 	}
 	catch(...)
@@ -192,6 +136,7 @@ Response JalSubscriber::messageHandler(const Message& message)
 
 	// At this point, we have a valid message Type, figure out who its for
 	std::string uuid;
+	std::shared_ptr<Session> session;
 	// If the messageType is initialize, create a new session to handle it
 	if(ReceiveMessageType::MSG_INIT == type)
 	{
@@ -199,35 +144,30 @@ Response JalSubscriber::messageHandler(const Message& message)
 		// There's an extremely low chance of uuid collision, but we'll make sure we don't already
 		// have a session by this uuid and retry until we get a new one
 		// TODO: Put a limit on this so it can't run forever - probably generate a NACK after X retries
+		// If this session would put us over the sesion limit, the table first prunes the
+		// least recently used session
 		do
 		{
 			uuid = generateNewUuid();
-		} while(activeSessions.find(uuid) != activeSessions.end());
-		// If this session would put us over the sesion limit, first prune the oldest
-		// current session
-		// This cast is safe because the config setting for sessionLimit cannot be < 0
-		if(activeSessions.size() > (size_t)config.sessionLimit)
-		{
-			// locks the sessionList internally
-			pruneOldestSession();
-		}
-		// Obtain an exclusive-lock on the session list.
-		std::unique_lock lock(sessionsMutex);
-		activeSessions.emplace(
-			std::make_pair(uuid, Session(uuid, jdb, config)));
+			session = std::make_shared<Session>(uuid, jdb, config);
+		} while(!activeSessions.insert(uuid, session));
 	}
 	// Else, hand off the message to an existing session
 	else
 	{
 		uuid = message.getHeader(HEADER_JAL_SESSION_ID_TYPE);
+		// Also marks the session as recently used
+		session = activeSessions.find(uuid);
 	}
 
 	// Dispatch message handling to the appropriate session
 	try
 	{
-		// Obtain a read-lock on the session list.
-		std::shared_lock lock(sessionsMutex);
-		response = activeSessions.at(uuid).handleMessage(type, message);
+		if(!session)
+		{
+			throw std::out_of_range(uuid);
+		}
+		response = session->handleMessage(type, message);
 	}
 	catch(std::out_of_range& e)
 	{
@@ -241,8 +181,6 @@ Response JalSubscriber::messageHandler(const Message& message)
 	// handling
 	if(ReceiveMessageType::MSG_CLOSE_SESSION == type)
 	{
-		// Obtain an exclusive-lock on the session list.
-		std::unique_lock lock(sessionsMutex);
 		activeSessions.erase(uuid);
 	}
 
@@ -258,15 +196,13 @@ Response JalSubscriber::messageHandler(const Message& message)
 JalSubscriber::JalSubscriber(
 	SubscriberConfig paramConfig) :
 	config(paramConfig),
+	// This cast is safe because the config setting for sessionLimit cannot be < 0
+	activeSessions((size_t)config.sessionLimit),
 	httpServer(
 		{},
 		{ std::bind(&JalSubscriber::messageHandler,
 			this, std::placeholders::_1),
-			std::bind(&JalSubscriber::getDigestAlgorithm,
-			this, std::placeholders::_1),
-			std::bind(&JalSubscriber::getPublisherId,
-			this, std::placeholders::_1),
-			std::bind(&JalSubscriber::getReceiveMode,
+			std::bind(&JalSubscriber::findSession,
 			this, std::placeholders::_1),
 			std::bind(&JalSubscriber::notifyTimeout,
 			this, std::placeholders::_1)
@@ -288,4 +224,8 @@ JalSubscriber::JalSubscriber(
 		// Purposely omitting the default statement, if any valid value of the enum
 		// is ever not covered, we want the compiler to complain
 	}
+	if(config.insertThreads > 0)
+	{
+		jdb = InsertQueue::insertQueueFactory(jdb, config.insertThreads);
+	}
 }
@@ -19,10 +19,10 @@
 #include <memory> // smart pointers
 #include <vector>
 #include <string>
-#include <shared_mutex>
 
 #include "JalSubConfig.hpp"
 #include "JalSubSession.hpp"
+#include "JalSubSessionTable.hpp"
 #include "JalSubNetworkLayer.hpp"
 #include "JalSubEnumTypes.hpp"
 #include "JalSubDatabase.hpp"
@@ -40,12 +40,10 @@ class JalSubscriber
 	// Polymorphic base class pointer
 	std::shared_ptr<JalSubDatabase> jdb;
 
-	// A list of active sessions using the sesionId as a key
-	std::map<std::string, Session> activeSessions;
-
-	// A lock to guard against the activeSessions list being modified by multiple
-	// threads simultaneously, or while is is being read
-	std::shared_mutex sessionsMutex;
+	// The active sessions using the sessionId as a key
+	// The table does its own locking, messages for different sessions can be
+	// handled concurrently
+	SessionTable activeSessions;
 
 	// A wrapper for the libmicrohttpd server to manage state and lifetime
 	// Note - keep this declared last. the HttpServer relies on some of the other members
@@ -54,16 +52,10 @@ class JalSubscriber
 
 	Response messageHandler(const Message& message);
 
-	enum jal_digest_algorithm getDigestAlgorithm(const Message& message);
-
-	std::string getPublisherId(const Message& message);
-
-	ModeType getReceiveMode(const Message& message);
+	std::shared_ptr<Session> findSession(const std::string& uuid);
 
 	void notifyTimeout(Message& message);
 
-	void pruneOldestSession();
-
 	public:
 	JalSubscriber(
 		SubscriberConfig config);
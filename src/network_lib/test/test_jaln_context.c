@@ -67,6 +67,7 @@ void test_context_create()
 	assert_not_equals((void*) NULL, ctx->xml_compressions);
 	assert_equals(1, ctx->ref_cnt);
 	assert_false(ctx->is_connected);
+	assert_equals(JALN_DEFAULT_PIPELINE_DEPTH, ctx->pipeline_depth);
 }
 
 void test_context_destroy_does_not_crash()
@@ -89,3 +90,21 @@ void test_ref_and_unref_work()
 	// for leaks.
 	ctx = NULL;
 }
+
+void test_set_pipeline_depth_works()
+{
+	assert_equals(JAL_OK, jaln_set_pipeline_depth(ctx, 8));
+	assert_equals(8, ctx->pipeline_depth);
+	assert_equals(JAL_OK, jaln_set_pipeline_depth(ctx, JALN_MAX_PIPELINE_DEPTH));
+	assert_equals(JALN_MAX_PIPELINE_DEPTH, ctx->pipeline_depth);
+	assert_equals(JAL_OK, jaln_set_pipeline_depth(ctx, 1));
+	assert_equals(1, ctx->pipeline_depth);
+}
+
+void test_set_pipeline_depth_fails_with_bad_input()
+{
+	assert_equals(JAL_E_INVAL, jaln_set_pipeline_depth(NULL, 8));
+	assert_equals(JAL_E_INVAL, jaln_set_pipeline_depth(ctx, 0));
+	assert_equals(JAL_E_INVAL, jaln_set_pipeline_depth(ctx, JALN_MAX_PIPELINE_DEPTH + 1));
+	assert_equals(JALN_DEFAULT_PIPELINE_DEPTH, ctx->pipeline_depth);
+}
@@ -0,0 +1,205 @@
+/**
+ * @file test_jaln_payload_source.c This file contains tests for
+ * jaln_payload_source.c functions.
+ *
+ * @section LICENSE
+ *
+ * Source code in 3rd-party is licensed and owned by their respective
+ * copyright holders.
+ *
+ * All other source code is copyright Tresys Technology and licensed as below.
+ *
+ * Copyright (c) 2012 Tresys Technology LLC, Columbia, Maryland, USA
+ *
+ * This software was developed by Tresys Technology LLC
+ * with U.S. Government sponsorship.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <jalop/jal_status.h>
+#include <jalop/jaln_network.h>
+#include <stdlib.h>
+#include <string.h>
+#include <test-dept.h>
+#include <unistd.h>
+
+#include "jal_alloc.h"
+
+#include "jaln_payload_source.h"
+
+#define FILE_SIZE (JALN_PAYLOAD_SOURCE_WINDOW + 5000)
+
+static char path[] = "./test_jaln_payload_source_XXXXXX";
+static int fd;
+static uint8_t *contents;
+static jaln_payload_source *src;
+
+void setup()
+{
+	strcpy(path + strlen(path) - 6, "XXXXXX");
+	fd = mkstemp(path);
+	contents = jal_malloc(FILE_SIZE);
+	for (int i = 0; i < FILE_SIZE; i++) {
+		contents[i] = (uint8_t) (i * 7);
+	}
+	uint64_t written = 0;
+	while (written < FILE_SIZE) {
+		ssize_t n = write(fd, contents + written, FILE_SIZE - written);
+		if (0 >= n) {
+			break;
+		}
+		written += n;
+	}
+	src = NULL;
+}
+
+void teardown()
+{
+	jaln_payload_source_destroy(&src);
+	close(fd);
+	unlink(path);
+	free(contents);
+}
+
+/* Read the payload from \p offset to the end, \p chunk bytes at a time */
+static void read_all(jaln_payload_source *s, uint64_t offset, uint64_t chunk)
+{
+	uint8_t *buf = jal_malloc(chunk);
+	while (offset < FILE_SIZE) {
+		uint64_t size = chunk;
+		assert_equals(JAL_OK, jaln_payload_source_get_bytes(offset, buf, &size, s));
+		assert_true(0 < size && size <= chunk);
+		assert_equals(0, memcmp(contents + offset, buf, size));
+		offset += size;
+	}
+	uint64_t size = chunk;
+	assert_equals(JAL_OK, jaln_payload_source_get_bytes(offset, buf, &size, s));
+	assert_equals(0, size);
+	free(buf);
+}
+
+void test_mmap_source_reads_the_whole_file()
+{
+	src = jaln_payload_source_create(fd, FILE_SIZE, JALN_PAYLOAD_SOURCE_MMAP);
+	assert_not_equals((void *) NULL, src);
+	assert_equals(JALN_PAYLOAD_SOURCE_MMAP, src->type);
+	assert_not_equals((void *) NULL, src->map);
+	read_all(src, 0, 16 * 1024);
+}
+
+void test_pread_source_reads_the_whole_file()
+{
+	src = jaln_payload_source_create(fd, FILE_SIZE, JALN_PAYLOAD_SOURCE_PREAD);
+	assert_not_equals((void *) NULL, src);
+	assert_equals(JALN_PAYLOAD_SOURCE_PREAD, src->type);
+	assert_equals((void *) NULL, src->map);
+	read_all(src, 0, 16 * 1024);
+}
+
+void test_pread_source_serves_reads_from_its_window()
+{
+	src = jaln_payload_source_create(fd, FILE_SIZE, JALN_PAYLOAD_SOURCE_PREAD);
+	uint8_t buf[100];
+	uint64_t size = sizeof(buf);
+	assert_equals(JAL_OK, jaln_payload_source_get_bytes(0, buf, &size, src));
+	assert_equals(0, src->window_off);
+	assert_equals(JALN_PAYLOAD_SOURCE_WINDOW, src->window_len);
+
+	// Reads inside the window don't refill it
+	src->window[200] = 'x';
+	size = sizeof(buf);
+	assert_equals(JAL_OK, jaln_payload_source_get_bytes(200, buf, &size, src));
+	assert_equals('x', buf[0]);
+}
+
+void test_pread_source_stops_at_the_end_of_the_window()
+{
+	src = jaln_payload_source_create(fd, FILE_SIZE, JALN_PAYLOAD_SOURCE_PREAD);
+	uint8_t buf[4096];
+	uint64_t size = sizeof(buf);
+	assert_equals(JAL_OK, jaln_payload_source_get_bytes(0, buf, &size, src));
+	size = sizeof(buf);
+	assert_equals(JAL_OK, jaln_payload_source_get_bytes(JALN_PAYLOAD_SOURCE_WINDOW - 100,
+			buf, &size, src));
+	assert_equals(100, size);
+	assert_equals(0, memcmp(contents + JALN_PAYLOAD_SOURCE_WINDOW - 100, buf, size));
+}
+
+void test_sources_start_at_a_resume_offset()
+{
+	src = jaln_payload_source_create(fd, FILE_SIZE, JALN_PAYLOAD_SOURCE_PREAD);
+	read_all(src, JALN_PAYLOAD_SOURCE_WINDOW + 17, 4096);
+	assert_equals(0, lseek(fd, 0, SEEK_CUR));
+	jaln_payload_source_destroy(&src);
+
+	src = jaln_payload_source_create(fd, FILE_SIZE, JALN_PAYLOAD_SOURCE_MMAP);
+	read_all(src, 12345, 4096);
+	assert_equals(0, lseek(fd, 0, SEEK_CUR));
+}
+
+void test_sources_can_be_smaller_than_the_file()
+{
+	src = jaln_payload_source_create(fd, 10, JALN_PAYLOAD_SOURCE_MMAP);
+	uint8_t buf[100];
+	uint64_t size = sizeof(buf);
+	assert_equals(JAL_OK, jaln_payload_source_get_bytes(0, buf, &size, src));
+	assert_equals(10, size);
+}
+
+void test_empty_mmap_source_falls_back_to_pread()
+{
+	src = jaln_payload_source_create(fd, 0, JALN_PAYLOAD_SOURCE_MMAP);
+	assert_not_equals((void *) NULL, src);
+	assert_equals(JALN_PAYLOAD_SOURCE_PREAD, src->type);
+	uint8_t buf[10];
+	uint64_t size = sizeof(buf);
+	assert_equals(JAL_OK, jaln_payload_source_get_bytes(0, buf, &size, src));
+	assert_equals(0, size);
+}
+
+void test_create_fails_with_bad_input()
+{
+	assert_equals((void *) NULL, jaln_payload_source_create(-1, 10, JALN_PAYLOAD_SOURCE_MMAP));
+	assert_equals((void *) NULL, jaln_payload_source_create(fd, FILE_SIZE + 1, JALN_PAYLOAD_SOURCE_MMAP));
+	assert_equals((void *) NULL, jaln_payload_source_create(fd, FILE_SIZE + 1, JALN_PAYLOAD_SOURCE_PREAD));
+	assert_equals((void *) NULL, jaln_payload_source_create(fd, 10, (enum jaln_payload_source_type) 42));
+}
+
+void test_destroy_does_not_crash_on_null()
+{
+	jaln_payload_source *null_src = NULL;
+	jaln_payload_source_destroy(NULL);
+	jaln_payload_source_destroy(&null_src);
+}
+
+void test_get_bytes_fails_with_bad_input()
+{
+	src = jaln_payload_source_create(fd, FILE_SIZE, JALN_PAYLOAD_SOURCE_PREAD);
+	uint8_t buf[10];
+	uint64_t size = sizeof(buf);
+	assert_equals(JAL_E_INVAL_PARAM, jaln_payload_source_get_bytes(0, buf, &size, NULL));
+	assert_equals(JAL_E_INVAL_PARAM, jaln_payload_source_get_bytes(0, NULL, &size, src));
+	assert_equals(JAL_E_INVAL_PARAM, jaln_payload_source_get_bytes(0, buf, NULL, src));
+}
+
+void test_get_feeder_works()
+{
+	struct jaln_payload_feeder feeder;
+	src = jaln_payload_source_create(fd, FILE_SIZE, JALN_PAYLOAD_SOURCE_MMAP);
+	assert_equals(JAL_OK, jaln_payload_source_get_feeder(src, &feeder));
+	assert_pointer_equals(src, feeder.feeder_data);
+	assert_pointer_equals(jaln_payload_source_get_bytes, feeder.get_bytes);
+	assert_equals(JAL_E_INVAL_PARAM, jaln_payload_source_get_feeder(NULL, &feeder));
+	assert_equals(JAL_E_INVAL_PARAM, jaln_payload_source_get_feeder(src, NULL));
+}
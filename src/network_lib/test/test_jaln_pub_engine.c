@@ -0,0 +1,174 @@
+/**
+ * @file test_jaln_pub_engine.c This file contains tests for
+ * jaln_pub_engine.c functions.
+ *
+ * @section LICENSE
+ *
+ * Source code in 3rd-party is licensed and owned by their respective
+ * copyright holders.
+ *
+ * All other source code is copyright Tresys Technology and licensed as below.
+ *
+ * Copyright (c) 2012 Tresys Technology LLC, Columbia, Maryland, USA
+ *
+ * This software was developed by Tresys Technology LLC
+ * with U.S. Government sponsorship.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <jalop/jal_status.h>
+#include <jalop/jaln_network.h>
+#include <test-dept.h>
+
+#include "jaln_context.h"
+#include "jaln_pub_engine.h"
+#include "jaln_session.h"
+
+static jaln_pub_engine *engine;
+static jaln_session *sess;
+static struct jaln_record_source source;
+static int send_next_calls;
+static int on_finished_calls;
+static enum jal_status finished_status;
+
+static enum jal_status fake_send_next(
+		__attribute__((unused)) jaln_session *s,
+		__attribute__((unused)) const struct jaln_channel_info *ch_info,
+		__attribute__((unused)) void *source_data)
+{
+	send_next_calls++;
+	return JAL_OK;
+}
+
+static void fake_on_finished(
+		__attribute__((unused)) jaln_session *s,
+		__attribute__((unused)) const struct jaln_channel_info *ch_info,
+		enum jal_status status,
+		__attribute__((unused)) void *source_data)
+{
+	on_finished_calls++;
+	finished_status = status;
+}
+
+void setup()
+{
+	engine = jaln_pub_engine_create(2, 10);
+	sess = jaln_session_create();
+	sess->jaln_ctx = jaln_context_create();
+	sess->ch_info->type = JALN_RTYPE_LOG;
+	sess->role = JALN_ROLE_PUBLISHER;
+	sess->pub_data = jaln_pub_data_create();
+
+	source.source_data = NULL;
+	source.send_next = fake_send_next;
+	source.on_finished = fake_on_finished;
+	send_next_calls = 0;
+	on_finished_calls = 0;
+	finished_status = JAL_E_INVAL;
+}
+
+void teardown()
+{
+	jaln_pub_engine_destroy(&engine);
+	jaln_session_unref(sess);
+}
+
+void test_create_and_destroy_work()
+{
+	assert_not_equals((void *) NULL, engine);
+	assert_equals(2, engine->num_loops);
+	assert_equals(10, engine->poll_interval_ms);
+	assert_false(engine->stopping);
+	for (int i = 0; i < engine->num_loops; i++) {
+		assert_true(engine->loops[i].started);
+		assert_not_equals((void *) NULL, engine->loops[i].multi);
+		assert_equals(0, engine->loops[i].session_cnt);
+	}
+	jaln_pub_engine_destroy(&engine);
+	assert_equals((void *) NULL, engine);
+}
+
+void test_create_fails_with_bad_input()
+{
+	assert_equals((void *) NULL, jaln_pub_engine_create(0, 10));
+	assert_equals((void *) NULL, jaln_pub_engine_create(JALN_MAX_ENGINE_THREADS + 1, 10));
+	assert_equals((void *) NULL, jaln_pub_engine_create(1, -1));
+}
+
+void test_destroy_does_not_crash_on_null()
+{
+	jaln_pub_engine *null_engine = NULL;
+	jaln_pub_engine_destroy(NULL);
+	jaln_pub_engine_destroy(&null_engine);
+}
+
+void test_add_session_fails_with_bad_input()
+{
+	assert_equals(JAL_E_INVAL_PARAM, jaln_pub_engine_add_session(NULL, sess, &source));
+	assert_equals(JAL_E_INVAL_PARAM, jaln_pub_engine_add_session(engine, NULL, &source));
+	assert_equals(JAL_E_INVAL_PARAM, jaln_pub_engine_add_session(engine, sess, NULL));
+
+	source.send_next = NULL;
+	assert_equals(JAL_E_INVAL_PARAM, jaln_pub_engine_add_session(engine, sess, &source));
+}
+
+void test_add_session_fails_for_a_session_already_in_an_engine()
+{
+	sess->pub_multi = engine->loops[0].multi;
+	assert_equals(JAL_E_INVAL_PARAM, jaln_pub_engine_add_session(engine, sess, &source));
+	sess->pub_multi = NULL;
+}
+
+void test_add_session_fails_when_stopping()
+{
+	pthread_mutex_lock(&engine->lock);
+	engine->stopping = axl_true;
+	pthread_mutex_unlock(&engine->lock);
+	assert_equals(JAL_E_INVAL, jaln_pub_engine_add_session(engine, sess, &source));
+	assert_equals((void *) NULL, sess->pub_multi);
+}
+
+void test_add_session_hands_back_a_closed_session()
+{
+	// Not connected, and already finished so no close message is sent
+	sess->finished = axl_true;
+
+	assert_equals(JAL_OK, jaln_pub_engine_add_session(engine, sess, &source));
+	assert_not_equals((void *) NULL, sess->pub_multi);
+
+	// The loops only exit once every session is handed back
+	jaln_pub_engine_destroy(&engine);
+
+	assert_equals(0, send_next_calls);
+	assert_equals(1, on_finished_calls);
+	assert_equals(JAL_OK, finished_status);
+	assert_equals((void *) NULL, sess->pub_multi);
+	assert_equals(1, sess->ref_cnt);
+}
+
+void test_notify_fails_with_bad_input()
+{
+	assert_equals(JAL_E_INVAL_PARAM, jaln_pub_engine_notify(NULL, JALN_RTYPE_LOG));
+	assert_equals(JAL_E_INVAL_PARAM, jaln_pub_engine_notify(engine, 0));
+}
+
+void test_notify_skips_loops_without_sessions()
+{
+	assert_equals(JAL_OK, jaln_pub_engine_notify(engine, JALN_RTYPE_LOG | JALN_RTYPE_AUDIT));
+	pthread_mutex_lock(&engine->lock);
+	for (int i = 0; i < engine->num_loops; i++) {
+		assert_equals(0, engine->loops[i].ready_types);
+	}
+	pthread_mutex_unlock(&engine->lock);
+}
@@ -0,0 +1,252 @@
+/**
+ * @file test_jaln_pub_pipeline.c This file contains tests for
+ * jaln_pub_pipeline.c functions.
+ *
+ * @section LICENSE
+ *
+ * Source code in 3rd-party is licensed and owned by their respective
+ * copyright holders.
+ *
+ * All other source code is copyright Tresys Technology and licensed as below.
+ *
+ * Copyright (c) 2012 Tresys Technology LLC, Columbia, Maryland, USA
+ *
+ * This software was developed by Tresys Technology LLC
+ * with U.S. Government sponsorship.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <jalop/jal_status.h>
+#include <jalop/jaln_network.h>
+#include <string.h>
+#include <stdlib.h>
+#include <test-dept.h>
+#include <curl/curl.h>
+
+#include "jal_alloc.h"
+
+#include "jaln_context.h"
+#include "jaln_message_helpers.h"
+#include "jaln_pub_feeder.h"
+#include "jaln_pub_pipeline.h"
+#include "jaln_session.h"
+
+#define NONCE "nonce_1234"
+#define HEADERS "some headers"
+#define SYS_META "system meta"
+#define APP_META "app meta"
+#define PAYLOAD "payload text"
+
+static struct jal_digest_ctx *dctx;
+static jaln_session *sess;
+static struct jaln_pub_record *rec;
+
+void setup()
+{
+	dctx = jal_digest_ctx_create(JAL_DIGEST_ALGORITHM_DEFAULT);
+	sess = jaln_session_create();
+	sess->jaln_ctx = jaln_context_create();
+	jaln_register_digest_algorithm(sess->jaln_ctx, dctx);
+	sess->ch_info->type = JALN_RTYPE_LOG;
+	sess->dgst = dctx;
+	sess->role = JALN_ROLE_PUBLISHER;
+	sess->pub_data = jaln_pub_data_create();
+	sess->pub_data->dgst_inst = sess->dgst->create();
+	sess->dgst->init(sess->pub_data->dgst_inst);
+	sess->pub_data->nonce = jal_strdup(NONCE);
+	sess->pub_data->headers = curl_slist_append(NULL, HEADERS);
+	sess->pub_data->headers_sz = strlen(HEADERS);
+	sess->pub_data->sys_meta_sz = strlen(SYS_META);
+	sess->pub_data->app_meta_sz = strlen(APP_META);
+	sess->pub_data->payload_sz = strlen(PAYLOAD);
+	sess->pub_data->sys_meta = (uint8_t *) jal_strdup(SYS_META);
+	sess->pub_data->app_meta = (uint8_t *) jal_strdup(APP_META);
+	sess->pub_data->payload = (uint8_t *) jal_strdup(PAYLOAD);
+
+	rec = jal_calloc(1, sizeof(*rec));
+
+	// The jaln_context owns the digest algorithm, so don't keep a
+	// reference to it.
+	dctx = NULL;
+}
+
+void teardown()
+{
+	jaln_pub_record_destroy(sess, &rec);
+	free(sess->pub_data->sys_meta);
+	free(sess->pub_data->app_meta);
+	free(sess->pub_data->payload);
+	if (sess->pub_data->dgst_inst) {
+		sess->dgst->destroy(sess->pub_data->dgst_inst);
+		sess->pub_data->dgst_inst = NULL;
+	}
+	// The session was using the dgst created by the context, prevent
+	// both from freeing it.
+	sess->dgst = NULL;
+	jaln_session_unref(sess);
+}
+
+void test_create_and_destroy_work()
+{
+	struct jaln_pub_pipeline *pipeline = jaln_pub_pipeline_create(4, NULL);
+	assert_not_equals((void *) NULL, pipeline);
+	assert_not_equals((void *) NULL, pipeline->multi);
+	assert_equals(4, pipeline->depth);
+	assert_equals(0, pipeline->in_flight);
+	for (int i = 0; i < pipeline->depth; i++) {
+		assert_equals((void *) NULL, pipeline->handles[i]);
+		assert_equals((void *) NULL, pipeline->records[i]);
+	}
+	jaln_pub_pipeline_destroy(&pipeline);
+	assert_equals((void *) NULL, pipeline);
+}
+
+void test_destroy_does_not_crash_on_null()
+{
+	struct jaln_pub_pipeline *pipeline = NULL;
+	jaln_pub_pipeline_destroy(NULL);
+	jaln_pub_pipeline_destroy(&pipeline);
+}
+
+void test_is_enabled_depends_on_depth()
+{
+	assert_false(jaln_pub_pipeline_is_enabled(sess));
+	assert_equals(JAL_OK, jaln_set_pipeline_depth(sess->jaln_ctx, 8));
+	assert_true(jaln_pub_pipeline_is_enabled(sess));
+}
+
+void test_is_enabled_returns_false_for_journal()
+{
+	assert_equals(JAL_OK, jaln_set_pipeline_depth(sess->jaln_ctx, 8));
+	sess->ch_info->type = JALN_RTYPE_AUDIT;
+	assert_true(jaln_pub_pipeline_is_enabled(sess));
+	sess->ch_info->type = JALN_RTYPE_JOURNAL;
+	assert_false(jaln_pub_pipeline_is_enabled(sess));
+}
+
+void test_is_enabled_returns_true_for_engine_sessions()
+{
+	CURLM *multi = curl_multi_init();
+	sess->ch_info->type = JALN_RTYPE_JOURNAL;
+	sess->pub_multi = multi;
+	assert_true(jaln_pub_pipeline_is_enabled(sess));
+	sess->pub_multi = NULL;
+	curl_multi_cleanup(multi);
+}
+
+void test_create_with_a_shared_multi_does_not_own_it()
+{
+	CURLM *multi = curl_multi_init();
+	struct jaln_pub_pipeline *pipeline = jaln_pub_pipeline_create(2, multi);
+	assert_not_equals((void *) NULL, pipeline);
+	assert_pointer_equals(multi, pipeline->multi);
+	assert_true(pipeline->shared);
+	jaln_pub_pipeline_destroy(&pipeline);
+	curl_multi_cleanup(multi);
+}
+
+void test_depth_is_1_for_journal()
+{
+	assert_equals(JAL_OK, jaln_set_pipeline_depth(sess->jaln_ctx, 8));
+	assert_equals(8, jaln_pub_pipeline_depth(sess));
+	sess->ch_info->type = JALN_RTYPE_JOURNAL;
+	assert_equals(1, jaln_pub_pipeline_depth(sess));
+}
+
+void test_is_enabled_returns_false_with_bad_input()
+{
+	assert_false(jaln_pub_pipeline_is_enabled(NULL));
+}
+
+void test_take_record_copies_buffers()
+{
+	assert_equals(JAL_OK, jaln_pub_pipeline_take_record(sess, rec));
+	struct jaln_pub_data *pd = rec->pub_data;
+	assert_not_equals((void *) NULL, pd);
+
+	assert_not_equals(sess->pub_data->sys_meta, pd->sys_meta);
+	assert_not_equals(sess->pub_data->app_meta, pd->app_meta);
+	assert_not_equals(sess->pub_data->payload, pd->payload);
+	assert_equals(strlen(SYS_META), pd->sys_meta_sz);
+	assert_equals(strlen(APP_META), pd->app_meta_sz);
+	assert_equals(strlen(PAYLOAD), pd->payload_sz);
+
+	// The application may reuse its buffers once the record is taken
+	memset(sess->pub_data->sys_meta, 'x', strlen(SYS_META));
+	memset(sess->pub_data->app_meta, 'x', strlen(APP_META));
+	memset(sess->pub_data->payload, 'x', strlen(PAYLOAD));
+	assert_equals(0, memcmp(SYS_META, pd->sys_meta, strlen(SYS_META)));
+	assert_equals(0, memcmp(APP_META, pd->app_meta, strlen(APP_META)));
+	assert_equals(0, memcmp(PAYLOAD, pd->payload, strlen(PAYLOAD)));
+}
+
+void test_take_record_does_not_copy_journal_payloads()
+{
+	sess->ch_info->type = JALN_RTYPE_JOURNAL;
+	assert_equals(JAL_OK, jaln_pub_pipeline_take_record(sess, rec));
+	struct jaln_pub_data *pd = rec->pub_data;
+
+	assert_equals((void *) NULL, pd->payload);
+	assert_equals(strlen(PAYLOAD), pd->payload_sz);
+	assert_equals(0, memcmp(SYS_META, pd->sys_meta, strlen(SYS_META)));
+	assert_equals(0, memcmp(APP_META, pd->app_meta, strlen(APP_META)));
+}
+
+void test_take_record_moves_headers_and_digest()
+{
+	struct curl_slist *headers = sess->pub_data->headers;
+	void *dgst_inst = sess->pub_data->dgst_inst;
+
+	assert_equals(JAL_OK, jaln_pub_pipeline_take_record(sess, rec));
+	struct jaln_pub_data *pd = rec->pub_data;
+
+	assert_pointer_equals(headers, pd->headers);
+	assert_pointer_equals(dgst_inst, pd->dgst_inst);
+	assert_equals((void *) NULL, sess->pub_data->headers);
+	assert_equals((void *) NULL, sess->pub_data->dgst_inst);
+	assert_equals((void *) NULL, sess->pub_data->dgst);
+
+	assert_not_equals(sess->pub_data->nonce, pd->nonce);
+	assert_string_equals(NONCE, pd->nonce);
+}
+
+void test_take_record_sets_up_the_response_info()
+{
+	assert_equals(JAL_OK, jaln_pub_pipeline_take_record(sess, rec));
+	assert_pointer_equals(sess, rec->read_info.sess);
+	assert_pointer_equals(rec->pub_data, rec->read_info.pub_data);
+	assert_not_equals((void *) NULL, rec->info);
+	assert_string_equals(NONCE, rec->info->expected_nonce);
+}
+
+void test_take_record_fails_without_a_nonce()
+{
+	free(sess->pub_data->nonce);
+	sess->pub_data->nonce = NULL;
+	assert_equals(JAL_E_INVAL, jaln_pub_pipeline_take_record(sess, rec));
+	assert_equals((void *) NULL, rec->pub_data);
+}
+
+void test_take_record_fails_with_bad_input()
+{
+	assert_equals(JAL_E_INVAL, jaln_pub_pipeline_take_record(NULL, rec));
+	assert_equals(JAL_E_INVAL, jaln_pub_pipeline_take_record(sess, NULL));
+}
+
+void test_record_destroy_does_not_crash_on_null()
+{
+	struct jaln_pub_record *null_rec = NULL;
+	jaln_pub_record_destroy(sess, NULL);
+	jaln_pub_record_destroy(sess, &null_rec);
+}
@@ -45,11 +45,14 @@
 
 #include "jal_base64_internal.h"
 #include "jaldb_context.hpp"
+#include "jaldb_record_cache.h"
+#include "jaldb_sys_meta_cache.h"
 #include "jalns_strings.h"
 #include "jalu_daemonize.h"
 #include "jalu_config.h"
 #include "jaldb_segment.h"
 #include "jaldb_record.h"
+#include "jaldb_record_view.h"
 #include "jaldb_utils.h"
 #include "jal_alloc.h"
 #include "jal_linux_seccomp.h"
@@ -121,8 +124,15 @@ struct peer_config_t {
 };
 
 struct session_ctx_t {
-	struct jaldb_record *rec;
+	struct jaldb_record *rec;		/* Journal records */
+	struct jaldb_record_view view;		/* Audit and log records in live mode */
+	struct jaldb_record_cache_entry *cached;	/* The same, when they come from record_cache */
+	struct jaldb_record_batch batch;	/* Audit and log records in archive mode */
+	size_t batch_next;			/* The next record of batch to send */
+	char **sent;				/* Records of batch sent but not marked yet */
+	size_t sent_count;
 	jaldb_context_t* db_ctx;
+	jaln_payload_source *payload_src;
 };
 
 struct global_config_t {
@@ -134,6 +144,11 @@ struct global_config_t {
 	long long int retry_interval;
 	const char *pub_id;
 	long long int network_timeout;
+	int pipeline_depth;
+	int publisher_threads;
+	int sys_meta_cache_size;
+	bool sys_meta_write_back;
+	long long int record_cache_size;
 	int num_peers;
 	struct peer_config_t *peers;
 	char* pid_file;
@@ -167,7 +182,36 @@ static axlHash *gs_journal_subs = NULL;
 static axlHash *gs_audit_subs = NULL;
 static axlHash *gs_log_subs = NULL;
 static int exiting = 0;
-static int threads_to_exit = 0;
+static int sessions_to_exit = 0;
+static jaln_pub_engine *pub_engine = NULL;
+static struct jaldb_sys_meta_cache *sys_meta_cache = NULL;
+static struct jaldb_record_cache *record_cache = NULL;
+
+/** How long an insert watcher waits before checking whether jald is exiting */
+#define JALD_WATCH_TIMEOUT_MS 1000
+
+// Archive mode reads audit and log records this many at a time, and marks
+// them sent together
+#define JALD_BATCH_RECORDS 256
+#define JALD_BATCH_BYTES (4 * 1024 * 1024)
+
+/**
+ * Wakes the publisher engine when the local store inserts records of one
+ * type, so they are sent without waiting out poll_time.
+ */
+struct insert_watcher_t {
+	enum jaldb_rec_type db_type;
+	enum jaln_record_type type;
+	pthread_t thread;
+	bool started;
+};
+
+static jaldb_context_t *watch_db_ctx = NULL;
+static struct insert_watcher_t insert_watchers[] = {
+	{ JALDB_RTYPE_JOURNAL, JALN_RTYPE_JOURNAL, pthread_t(), false },
+	{ JALDB_RTYPE_AUDIT, JALN_RTYPE_AUDIT, pthread_t(), false },
+	{ JALDB_RTYPE_LOG, JALN_RTYPE_LOG, pthread_t(), false },
+};
 
 static void usage();
 static int process_options(int argc, char **argv);
@@ -180,8 +224,10 @@ static void print_record_types(enum jaln_record_type rtype);
 static void print_peer_config(peer_config_t *peer);
 static void print_config(void);
 static enum jald_status set_global_config(config_t *config);
-static enum jal_status pub_get_bytes(const uint64_t offset, uint8_t * const buffer, uint64_t *size, void *feeder_data);
 static jaldb_context_t* setup_db_layer(void);
+static void *watch_inserts(void *arg);
+static void start_insert_watchers(void);
+static void stop_insert_watchers(void);
 static enum jal_status select_channel(const struct jaln_channel_info* ch_info, axlHash** hash, pthread_mutex_t** sub_lock);
 
 enum jaln_connect_error on_connect_request(
@@ -194,24 +240,56 @@ enum jaln_connect_error on_connect_request(
 	return JALN_CE_UNAUTHORIZED_MODE;
 }
 
+/*
+ * Mark the records of a session that were sent in archive mode since the
+ * last time, all in one transaction. The caller holds the lock of the
+ * session's hash.
+ */
+static enum jaldb_status pub_mark_sent(
+		const struct jaln_channel_info *ch_info,
+		struct session_ctx_t *ctx,
+		enum jaldb_rec_type db_type)
+{
+	if (0 == ctx->sent_count) {
+		return JALDB_OK;
+	}
+	enum jaldb_status db_ret = jaldb_mark_sent_batch(ctx->db_ctx, db_type,
+			ctx->sent, ctx->sent_count, 1);
+	if (JALDB_OK != db_ret) {
+		DEBUG_LOG_SUB_SESSION(ch_info, "Failed to mark %zu records as sent: %d",
+				ctx->sent_count, db_ret);
+	} else {
+		DEBUG_LOG_SUB_SESSION(ch_info, "Marked %zu records as sent", ctx->sent_count);
+	}
+	for (size_t i = 0; i < ctx->sent_count; i++) {
+		free(ctx->sent[i]);
+	}
+	ctx->sent_count = 0;
+	return db_ret;
+}
+
 void on_channel_close(
 		const struct jaln_channel_info *ch_info,
 		__attribute__((unused)) void *user_data)
 {
 	axlHash *hash = NULL;
 	pthread_mutex_t *sub_lock = NULL;
+	enum jaldb_rec_type db_type = JALDB_RTYPE_UNKNOWN;
 	switch (ch_info->type) {
 	case JALN_RTYPE_JOURNAL:
 		hash = gs_journal_subs;
 		sub_lock = &gs_journal_sub_lock;
+		db_type = JALDB_RTYPE_JOURNAL;
 		break;
 	case JALN_RTYPE_AUDIT:
 		hash = gs_audit_subs;
 		sub_lock = &gs_audit_sub_lock;
+		db_type = JALDB_RTYPE_AUDIT;
 		break;
 	case JALN_RTYPE_LOG:
 		hash = gs_log_subs;
 		sub_lock = &gs_log_sub_lock;
+		db_type = JALDB_RTYPE_LOG;
 		break;
 	default:
 		DEBUG_LOG_SUB_SESSION(ch_info, "Illegal record type");
@@ -226,6 +304,14 @@ void on_channel_close(
 		DEBUG_LOG_SUB_SESSION(ch_info, "ERROR: No context or BDB context associated with closing channel");
 	}
 	else {
+		pthread_mutex_lock(sub_lock);
+		pub_mark_sent(ch_info, ctx, db_type);
+		pthread_mutex_unlock(sub_lock);
+		jaln_payload_source_destroy(&ctx->payload_src);
+		jaldb_record_cache_release(record_cache, &ctx->cached);
+		jaldb_record_view_free(&ctx->view);
+		jaldb_record_batch_free(&ctx->batch);
+		free(ctx->sent);
 		jaldb_context_destroy(&ctx->db_ctx);
 	}
 
@@ -328,6 +414,8 @@ enum jal_status pub_on_journal_resume(
 	axl_hash_insert_full(gs_journal_subs, strdup(ch_info->hostname), free, ctx, free);
 	pthread_mutex_unlock(&gs_journal_sub_lock);
 	ctx->rec = NULL;
+	jaldb_record_view_init(&ctx->view);
+	jaldb_record_batch_init(&ctx->batch);
 	ctx->db_ctx = setup_db_layer();
 	if(NULL == ctx->db_ctx) {
 		return JAL_E_INVAL;
@@ -351,69 +439,224 @@ enum jal_status pub_on_journal_resume(
 	return JAL_OK;
 }
 
+/*
+ * Get the next record of the session's batch of unsynced records, reading
+ * the next batch once this one is used up. The records sent from this
+ * batch have to be marked first, or they would be read again.
+ */
+static enum jaldb_status pub_next_batch_view(
+			struct session_ctx_t *ctx,
+			enum jaldb_rec_type db_type,
+			struct jaldb_record_view **view)
+{
+	enum jaldb_status ret;
+
+	if (ctx->batch_next == ctx->batch.count) {
+		jaldb_record_batch_release(&ctx->batch);
+		ctx->batch_next = 0;
+		ret = jaldb_next_unsynced_records(ctx->db_ctx, db_type,
+				JALD_BATCH_RECORDS, JALD_BATCH_BYTES, &ctx->batch);
+		if (JALDB_OK != ret) {
+			return ret;
+		}
+		ctx->sent = (char **) jal_realloc(ctx->sent,
+				ctx->batch.count * sizeof(*ctx->sent));
+	}
+	*view = &ctx->batch.views[ctx->batch_next++];
+	return JALDB_OK;
+}
+
+/*
+ * Get the next record of a session in live mode from the record cache
+ * shared by every session, so a record sent to several peers is only read
+ * from the database once. The position of the session only moves on once
+ * the record is read, or found to be gone.
+ */
+static enum jaldb_status pub_next_cached_view(
+			struct session_ctx_t *ctx,
+			enum jaldb_rec_type db_type,
+			char **timestamp,
+			char **last_nonce,
+			struct jaldb_record_view **view)
+{
+	enum jaldb_status ret;
+	char *next_timestamp = jal_strdup(*timestamp);
+	char *next_nonce = *last_nonce ? jal_strdup(*last_nonce) : NULL;
+
+	ret = jaldb_next_chronological_nonce(ctx->db_ctx, db_type,
+			&next_timestamp, &next_nonce);
+	if (JALDB_OK != ret) {
+		goto out;
+	}
+	ret = jaldb_record_cache_get(record_cache, db_type, next_nonce, &ctx->cached);
+	if (JALDB_E_NOT_FOUND == ret) {
+		ret = jaldb_get_record_view(ctx->db_ctx, db_type, next_nonce, &ctx->view);
+		if (JALDB_OK == ret) {
+			ret = jaldb_record_cache_put(record_cache, db_type, next_nonce,
+					&ctx->view, &ctx->cached);
+		}
+		jaldb_record_view_release(&ctx->view);
+	}
+	if (JALDB_OK == ret || JALDB_E_NOT_FOUND == ret) {
+		// A record removed since it was found is skipped
+		free(*timestamp);
+		*timestamp = next_timestamp;
+		next_timestamp = NULL;
+		free(*last_nonce);
+		*last_nonce = next_nonce;
+		next_nonce = NULL;
+	}
+	if (JALDB_OK == ret) {
+		*view = jaldb_record_cache_entry_view(ctx->cached);
+	}
+out:
+	free(next_timestamp);
+	free(next_nonce);
+	return ret;
+}
+
+/*
+ * Look up the next audit or log record to send on a session. The buffers
+ * point straight into the session's view of the record as the database
+ * returned it, so the payload is not copied before it is sent.
+ */
+static enum jaldb_status pub_get_next_view(
+			const struct jaln_channel_info *ch_info,
+			struct session_ctx_t *ctx,
+			char **nonce,
+			char **timestamp,
+			char **last_nonce,
+			uint8_t **sys_meta_buf,
+			uint64_t *sys_meta_len,
+			uint8_t **app_meta_buf,
+			uint64_t *app_meta_len,
+			uint8_t **payload_buf,
+			uint64_t *payload_len,
+			enum jaldb_rec_type db_type)
+{
+	enum jaldb_status ret = JALDB_E_NOT_FOUND;
+	struct jaldb_record_view *view = &ctx->view;
+	const uint8_t *buf = NULL;
+	const char *view_nonce = NULL;
+	int on_disk = 0;
+
+	if (!*timestamp) {
+		// Archive mode
+		ret = pub_next_batch_view(ctx, db_type, &view);
+		if (JALDB_OK == ret) {
+			ret = jaldb_record_view_get_string(view, JALDB_VIEW_NETWORK_NONCE, &view_nonce);
+		}
+		if (JALDB_OK == ret) {
+			*nonce = jal_strdup(view_nonce);
+		}
+	} else if (record_cache) {
+		// Live mode, shared with the other sessions
+		ret = pub_next_cached_view(ctx, db_type, timestamp, last_nonce, &view);
+		if (JALDB_OK == ret) {
+			ret = jaldb_record_view_get_string(view, JALDB_VIEW_NETWORK_NONCE, &view_nonce);
+		}
+		if (JALDB_OK == ret) {
+			*nonce = jal_strdup(view_nonce);
+		}
+	} else {
+		// Live mode
+		ret = jaldb_next_chronological_record_view(ctx->db_ctx, db_type, nonce,
+				view, timestamp, last_nonce);
+	}
+	if (JALDB_OK != ret) {
+		if (JALDB_E_NOT_FOUND != ret) {
+			DEBUG_LOG_SUB_SESSION(ch_info, "Failed to get next record");
+		}
+		return ret;
+	}
+
+	// The network library only reads the buffers
+	*sys_meta_buf = NULL;
+	ret = jaldb_record_view_get_segment(view, JALDB_VIEW_SYS_META, &buf,
+			sys_meta_len, &on_disk);
+	if (JALDB_OK == ret && !on_disk) {
+		// TODO: Handle for on disk (once the LS is updated to support it). i.e. memmap the file or whatever
+		*sys_meta_buf = (uint8_t *) buf;
+	}
+	*app_meta_buf = NULL;
+	if (JALDB_OK == ret) {
+		ret = jaldb_record_view_get_segment(view, JALDB_VIEW_APP_META, &buf,
+				app_meta_len, &on_disk);
+	}
+	if (JALDB_OK == ret && !on_disk) {
+		*app_meta_buf = (uint8_t *) buf;
+	}
+	*payload_buf = NULL;
+	if (JALDB_OK == ret) {
+		ret = jaldb_record_view_get_segment(view, JALDB_VIEW_PAYLOAD, &buf,
+				payload_len, &on_disk);
+	}
+	if (JALDB_OK == ret && !on_disk) {
+		*payload_buf = (uint8_t *) buf;
+	}
+	if (JALDB_OK != ret) {
+		DEBUG_LOG_SUB_SESSION(ch_info, "Malformed record %s", *nonce);
+		free(*nonce);
+		*nonce = NULL;
+		if (ctx->cached) {
+			jaldb_record_cache_release(record_cache, &ctx->cached);
+		} else {
+			jaldb_record_view_release(view);
+		}
+	}
+	return ret;
+}
+
+/*
+ * Look up the next record to send on a session without waiting for one.
+ * Returns JALDB_E_NOT_FOUND if there is nothing to send yet.
+ */
 enum jaldb_status pub_get_next_record(
-			jaln_session *sess,
 			const struct jaln_channel_info *ch_info,
+			struct session_ctx_t *ctx,
 			char **nonce,
 			char **timestamp,
+			char **last_nonce,
 			uint8_t **sys_meta_buf,
 			uint64_t *sys_meta_len,
 			uint8_t **app_meta_buf,
 			uint64_t *app_meta_len,
 			uint8_t **payload_buf,
 			uint64_t *payload_len,
-			axlHash *hash,
-			pthread_mutex_t *sub_lock,
 			enum jaldb_rec_type db_type)
 {
 	enum jaldb_status ret = JALDB_E_NOT_FOUND;
-	struct session_ctx_t *ctx = NULL;
 	struct jaldb_record *rec = NULL;
-	pthread_mutex_lock(sub_lock);
-	ctx = (struct session_ctx_t*)axl_hash_get(hash, ch_info->hostname);
-	pthread_mutex_unlock(sub_lock);
-	if (!ctx) {
-		DEBUG_LOG_SUB_SESSION(ch_info, "Couldn't find session");
-		goto out;
+
+	if (JALDB_RTYPE_JOURNAL != db_type) {
+		return pub_get_next_view(ch_info, ctx, nonce, timestamp, last_nonce,
+				sys_meta_buf, sys_meta_len, app_meta_buf, app_meta_len,
+				payload_buf, payload_len, db_type);
 	}
-	if ((ctx->rec) && (JALDB_RTYPE_JOURNAL == db_type)) {
+
+	if (ctx->rec) {
 		/* Journal resume, so we already have a record */
 		// Make a copy to match behavior of jaldb_next_*_record functions
 		*nonce = jal_strdup(ctx->rec->network_nonce);
 		ret = JALDB_OK;
+	} else if (!*timestamp) {
+		// Have to use timestamp since sess->mode is internal to the network library
+		// Archive mode
+		ret = jaldb_next_unsynced_record(ctx->db_ctx, db_type, nonce, &(ctx->rec));
 	} else {
-		while (JALDB_E_NOT_FOUND == ret) {
-			// Have to use timestamp since sess->mode is internal to the network library
-			if (!*timestamp) {
-				// Archive mode
-				DEBUG_LOG_SUB_SESSION(ch_info, "Looking for a record in Archive Mode");
-				ret = jaldb_next_unsynced_record(ctx->db_ctx, db_type, nonce, &(ctx->rec));
-			} else {
-				// Live mode
-				DEBUG_LOG_SUB_SESSION(ch_info, "Looking for a record in Live Mode, timestamp: %s",*timestamp);
-				ret = jaldb_next_chronological_record(ctx->db_ctx,
-								     db_type,
-								     nonce,
-								     &(ctx->rec),
-								     timestamp);
-			}
-
-			// Check if jaln_session is fine.
-			if (JAL_OK != jaln_session_is_ok(sess)) {
-				DEBUG_LOG_SUB_SESSION(ch_info, "Session issues detected 1");
-				ret = JALDB_E_NETWORK_DISCONNECTED;
-				goto out;
-			}
-
-			if (JALDB_E_NOT_FOUND == ret) {
-				sleep(global_config.poll_time);
-
-			}
-		}
+		// Live mode
+		ret = jaldb_next_chronological_record(ctx->db_ctx,
+						     db_type,
+						     nonce,
+						     &(ctx->rec),
+						     timestamp,
+						     last_nonce);
 	}
 
 	if (JALDB_OK != ret) {
-		DEBUG_LOG_SUB_SESSION(ch_info, "Failed to get next record");
+		if (JALDB_E_NOT_FOUND != ret) {
+			DEBUG_LOG_SUB_SESSION(ch_info, "Failed to get next record");
+		}
 		goto out;
 	}
 
@@ -456,28 +699,36 @@ enum jaldb_status pub_get_next_record(
 	ret = JALDB_OK;
 out:
 	if(JALDB_OK != ret) {
+		jaln_payload_source_destroy(&ctx->payload_src);
 		jaldb_destroy_record(&ctx->rec);
 	}
 	return ret;
 }
 
 /*
- * Should support every record type in the future.
- * TODO: Convert log and audit record handling to feeders
+ * Where the publisher engine gets the records for a session.
+ */
+struct pub_source_t {
+	char *timestamp;		/* Only set in live mode */
+	char *last_nonce;		/* The last record sent in live mode */
+	axlHash *hash;
+	pthread_mutex_t *sub_lock;
+	enum jaldb_rec_type db_type;
+};
+
+/*
+ * Called by the publisher engine when a session has room for another record.
+ * Sends at most one record and returns right away if there is none yet, the
+ * engine asks again after poll_time.
  */
-enum jal_status pub_send_records_feeder(
+static enum jal_status pub_send_next_record(
 			jaln_session *sess,
 			const struct jaln_channel_info *ch_info,
-			char **timestamp,
-			axlHash *hash,
-			pthread_mutex_t *sub_lock,
-			enum jal_status (*send)(jaln_session *, char *, uint8_t *,
-						uint64_t, uint8_t *, uint64_t,
-						uint64_t, struct jaln_payload_feeder *))
+			void *source_data)
 {
+	struct pub_source_t *src = (struct pub_source_t *) source_data;
 	enum jal_status ret = JAL_E_INVAL;
 	enum jaldb_status db_ret = JALDB_E_INVAL;
-	enum jaln_record_type type = ch_info->type;
 	char *nonce = NULL;
 	uint8_t *sys_meta_buf = NULL;
 	uint64_t sys_meta_len = 0;
@@ -488,383 +739,126 @@ enum jal_status pub_send_records_feeder(
 	struct session_ctx_t *ctx = NULL;
 	struct jaln_payload_feeder feeder;
 
-	enum jaldb_rec_type db_type;
-	switch (type) {
-	case JALN_RTYPE_JOURNAL:
-		db_type = JALDB_RTYPE_JOURNAL;
-		break;
-	default:
-		return JAL_E_INVAL;
+	pthread_mutex_lock(src->sub_lock);
+	ctx = (struct session_ctx_t*)axl_hash_get(src->hash, ch_info->hostname);
+	db_ret = JALDB_OK;
+	if (ctx && ctx->batch_next == ctx->batch.count) {
+		// Mark what was sent from a used up batch before reading the next
+		db_ret = pub_mark_sent(ch_info, ctx, src->db_type);
 	}
-
-	pthread_mutex_lock(sub_lock);
-
-	ctx = (struct session_ctx_t *) axl_hash_get(hash, ch_info->hostname);
+	pthread_mutex_unlock(src->sub_lock);
 	if (!ctx) {
-		ctx = (struct session_ctx_t*) calloc(1, sizeof(*ctx));
-		if (!ctx) {
-			DEBUG_LOG_SUB_SESSION(ch_info, "Failed to allocate context");
-			pthread_mutex_unlock(sub_lock);
-			ret = JAL_E_NO_MEM;
-			goto out;
-		}
-		DEBUG_LOG_SUB_SESSION(ch_info, "Inserting new session");
-
-		ctx->db_ctx = setup_db_layer();
-		if(NULL == ctx->db_ctx) {
-			DEBUG_LOG_SUB_SESSION(ch_info, "Failed to setup db");
-			pthread_mutex_unlock(sub_lock);
-			ret = JAL_E_INVAL;
-			goto out;
-		}
-
-		axl_hash_insert_full(hash, strdup(ch_info->hostname), free, ctx, free);
+		DEBUG_LOG_SUB_SESSION(ch_info, "Couldn't find session");
+		goto out;
 	}
-
-	DEBUG_LOG_SUB_SESSION(ch_info, "Verifying previously sent records.");
-	// Only need to clear sent flags for archive mode connection
-	// Have to use timestamp since sess->mode is internal to the network library
-	if (!*timestamp) {
-		db_ret = jaldb_mark_unsynced_records_unsent(ctx->db_ctx, db_type);
-		if (JALDB_OK != db_ret) {
-			DEBUG_LOG_SUB_SESSION(ch_info, "Failed to verify records.");
-			ret = JAL_E_INVAL;
-			pthread_mutex_unlock(sub_lock);
-			goto out;
-		}
+	if (JALDB_OK != db_ret) {
+		ret = JAL_E_INVAL_NONCE;
+		goto out;
 	}
 
-	pthread_mutex_unlock(sub_lock);
-
-	feeder.feeder_data = ctx;
-	feeder.get_bytes = pub_get_bytes;
+	// nonce will be a new copy that the caller must free
+	// The buffers will point to the record stored within the session
+	// The record is cleaned up by pub_on_record_complete
+	db_ret = pub_get_next_record(
+				ch_info,
+				ctx,
+				&nonce,
+				&src->timestamp,
+				&src->last_nonce,
+				&sys_meta_buf,
+				&sys_meta_len,
+				&app_meta_buf,
+				&app_meta_len,
+				&payload_buf,
+				&payload_len,
+				src->db_type);
+	if (JALDB_E_NOT_FOUND == db_ret) {
+		ret = JAL_OK;
+		goto out;
+	}
+	if (JALDB_OK != db_ret) {
+		DEBUG_LOG_SUB_SESSION(ch_info, "Failed to get next record (%d)", db_ret);
+		ret = JAL_E_INVAL;
+		goto out;
+	}
 
-	do {
-		// nonce will be a new copy that the caller must free
-		// The buffers will point to the record stored within the session
-		// The record is cleaned up by pub_on_record_complete
-		db_ret = pub_get_next_record(
-					sess,
-					ch_info,
-					&nonce,
-					timestamp,
-					&sys_meta_buf,
-					&sys_meta_len,
-					&app_meta_buf,
-					&app_meta_len,
-					&payload_buf,
-					&payload_len,
-					hash,
-					sub_lock,
-					db_type);
-		if (JALDB_OK != db_ret) {
-			if (JALDB_E_NOT_FOUND == db_ret) {
-				ret = JAL_OK;
-				goto out;
-			}
-			if (JALDB_E_NETWORK_DISCONNECTED == db_ret) {
-				// Check if jaln_session is fine.
-				if (JAL_OK != jaln_session_is_ok(sess)) {
-					DEBUG_LOG_SUB_SESSION(ch_info, "Session issues detected 2");
-					DEBUG_LOG_SUB_SESSION(ch_info, "Calling jaln_finish() 2");
-					ret = jaln_finish(sess);
-					goto out;
-				}
-				ret = JAL_E_NOT_CONNECTED;
-				goto out;
-			}
-			DEBUG_LOG_SUB_SESSION(ch_info, "Failed to get next record (%d)", db_ret);
-			ret = JAL_E_INVAL;
+	switch (src->db_type) {
+	case JALDB_RTYPE_JOURNAL:
+		// Read the payload straight from the page cache instead of a
+		// seek and a read for every buffer curl asks for
+		jaln_payload_source_destroy(&ctx->payload_src);
+		ctx->payload_src = jaln_payload_source_create(ctx->rec->payload->fd,
+				payload_len, JALN_PAYLOAD_SOURCE_MMAP);
+		if (!ctx->payload_src) {
+			DEBUG_LOG_SUB_SESSION(ch_info, "Failed to read the payload of %s", nonce);
+			ret = JAL_E_FILE_IO;
 			goto out;
 		}
-
-		ret = send(sess, nonce, sys_meta_buf, sys_meta_len,
+		jaln_payload_source_get_feeder(ctx->payload_src, &feeder);
+		ret = jaln_send_journal(sess, nonce, sys_meta_buf, sys_meta_len,
 				app_meta_buf, app_meta_len, payload_len, &feeder);
-		if (JAL_OK != ret) {
-			DEBUG_LOG_SUB_SESSION(ch_info, "Failed to send record (%d)", ret);
-			goto out;
-		}
-		// Have to use timestamp since sess->mode is internal to the network library
-		if (!*timestamp) {
-			//Archive mode
-			pthread_mutex_lock(sub_lock);
-			db_ret = jaldb_mark_sent(ctx->db_ctx, db_type, nonce, 1);
-			pthread_mutex_unlock(sub_lock);
-			if (JALDB_OK != db_ret) {
-				DEBUG_LOG_SUB_SESSION(ch_info, "Failed to mark %s as sent: %d", nonce, db_ret);
-				ret = JAL_E_INVAL_NONCE;
-				goto out;
-			} else {
-				DEBUG_LOG_SUB_SESSION(ch_info, "Marked %s as sent", nonce);
-			}
-		}
-
-		free(nonce);
-		nonce = NULL;
-	} while (JALDB_OK == db_ret);
-
-	DEBUG_LOG_SUB_SESSION(ch_info, "Calling jaln_finish() 3");
-	ret = jaln_finish(sess);
-out:
-	free(nonce);
-	return ret;
-}
-
-
-enum jal_status pub_send_records(
-			jaln_session *sess,
-			const struct jaln_channel_info *ch_info,
-			char **timestamp,
-			axlHash *hash,
-			pthread_mutex_t *sub_lock,
-			enum jal_status (*send)(jaln_session *, char *, uint8_t *,
-						uint64_t, uint8_t *, uint64_t,
-						uint8_t *, uint64_t))
-{
-	enum jal_status ret = JAL_E_INVAL;
-	enum jaldb_status db_ret = JALDB_E_INVAL;
-	enum jaln_record_type type = ch_info->type;
-	char *nonce = NULL;
-	uint8_t *sys_meta_buf = NULL;
-	uint64_t sys_meta_len = 0;
-	uint8_t *app_meta_buf = NULL;
-	uint64_t app_meta_len = 0;
-	uint8_t *payload_buf = NULL;
-	uint64_t payload_len = 0;
-	struct session_ctx_t *ctx = NULL;
-
-	enum jaldb_rec_type db_type;
-	switch (type) {
-	case JALN_RTYPE_AUDIT:
-		db_type = JALDB_RTYPE_AUDIT;
 		break;
-	case JALN_RTYPE_LOG:
-		db_type = JALDB_RTYPE_LOG;
+	case JALDB_RTYPE_AUDIT:
+		ret = jaln_send_audit(sess, nonce, sys_meta_buf, sys_meta_len,
+				app_meta_buf, app_meta_len, payload_buf, payload_len);
 		break;
 	default:
-		return JAL_E_INVAL;
-	}
-
-	pthread_mutex_lock(sub_lock);
-
-	ctx = (struct session_ctx_t *) axl_hash_get(hash, ch_info->hostname);
-	if (ctx) {
-		// The library should prevent this from happening, but just in case.
-		DEBUG_LOG_SUB_SESSION(ch_info, "Subscribe exists, rejecting subscribe request");
-		pthread_mutex_unlock(sub_lock);
-		ret = JAL_E_INVAL;
-		goto out;
-	}
-
-	ctx = (struct session_ctx_t*) calloc(1, sizeof(*ctx));
-	if (!ctx) {
-		DEBUG_LOG_SUB_SESSION(ch_info, "Failed to allocate context");
-		pthread_mutex_unlock(sub_lock);
-		ret = JAL_E_NO_MEM;
-		goto out;
+		ret = jaln_send_log(sess, nonce, sys_meta_buf, sys_meta_len,
+				app_meta_buf, app_meta_len, payload_buf, payload_len);
+		break;
 	}
-
-	ctx->db_ctx = setup_db_layer();
-	if(NULL == ctx->db_ctx) {
-		DEBUG_LOG_SUB_SESSION(ch_info, "Failed to setup db");
-		pthread_mutex_unlock(sub_lock);
-		return JAL_E_INVAL;
+	if (JAL_OK != ret) {
+		DEBUG_LOG_SUB_SESSION(ch_info, "Failed to send record (%d)", ret);
+		// The network library did not take the record
+		jaldb_record_cache_release(record_cache, &ctx->cached);
+		jaldb_record_view_release(&ctx->view);
 		goto out;
 	}
 
-	DEBUG_LOG_SUB_SESSION(ch_info, "Inserting new session");
-
-	axl_hash_insert_full(hash, strdup(ch_info->hostname), free, ctx, free);
-
-	DEBUG_LOG_SUB_SESSION(ch_info, "Verifying previously sent records.");
-	// Only need to clear sent flags for archive mode connection
 	// Have to use timestamp since sess->mode is internal to the network library
-	if (!*timestamp) {
-		db_ret = jaldb_mark_unsynced_records_unsent(ctx->db_ctx, db_type);
+	if (!src->timestamp && JALDB_RTYPE_JOURNAL != src->db_type) {
+		// Archive mode, marked with the rest of the batch
+		pthread_mutex_lock(src->sub_lock);
+		ctx->sent[ctx->sent_count++] = nonce;
+		nonce = NULL;
+		pthread_mutex_unlock(src->sub_lock);
+	} else if (!src->timestamp) {
+		//Archive mode
+		pthread_mutex_lock(src->sub_lock);
+		db_ret = jaldb_mark_sent(ctx->db_ctx, src->db_type, nonce, 1);
+		pthread_mutex_unlock(src->sub_lock);
 		if (JALDB_OK != db_ret) {
-			DEBUG_LOG_SUB_SESSION(ch_info, "Failed to verify records.");
-			ret = JAL_E_INVAL;
-			pthread_mutex_unlock(sub_lock);
+			DEBUG_LOG_SUB_SESSION(ch_info, "Failed to mark %s as sent: %d", nonce, db_ret);
+			ret = JAL_E_INVAL_NONCE;
 			goto out;
+		} else {
+			DEBUG_LOG_SUB_SESSION(ch_info, "Marked %s as sent", nonce);
 		}
 	}
-
-	pthread_mutex_unlock(sub_lock);
-
-	do {
-		// nonce will be a new copy that the caller must free
-		// The buffers will point to the record stored within the session
-		// The record is cleaned up by pub_on_record_complete
-		db_ret = pub_get_next_record(
-					sess,
-					ch_info,
-					&nonce,
-					timestamp,
-					&sys_meta_buf,
-					&sys_meta_len,
-					&app_meta_buf,
-					&app_meta_len,
-					&payload_buf,
-					&payload_len,
-					hash,
-					sub_lock,
-					db_type);
-		if (JALDB_OK != db_ret) {
-			if (JALDB_E_NOT_FOUND == db_ret) {
-				ret = JAL_OK;
-				goto out;
-			}
-			if (JALDB_E_NETWORK_DISCONNECTED == db_ret) {
-				// Check if jaln_session is fine.
-				if (JAL_OK != jaln_session_is_ok(sess)) {
-					DEBUG_LOG_SUB_SESSION(ch_info, "Session issues detected 4");
-					DEBUG_LOG_SUB_SESSION(ch_info, "Calling jaln_finish() 4");
-					ret = jaln_finish(sess);
-					goto out;
-				}
-				ret = JAL_E_NOT_CONNECTED;
-				goto out;
-			}
-			DEBUG_LOG_SUB_SESSION(ch_info, "Failed to get next record (%d)", db_ret);
-			ret = JAL_E_INVAL;
-			goto out;
-		}
-
-		ret = send(sess, nonce, sys_meta_buf, sys_meta_len,
-				app_meta_buf, app_meta_len, payload_buf, payload_len);
-		if (JAL_OK != ret) {
-			DEBUG_LOG_SUB_SESSION(ch_info, "Failed to send record (%d)", ret);
-			goto out;
-		}
-		// Have to use timestamp since sess->mode is internal to the network library
-		if (!*timestamp) {
-			//Archive mode
-			pthread_mutex_lock(sub_lock);
-			db_ret = jaldb_mark_sent(ctx->db_ctx, db_type, nonce, 1);
-			pthread_mutex_unlock(sub_lock);
-			if (JALDB_OK != db_ret) {
-				DEBUG_LOG_SUB_SESSION(ch_info, "Failed to mark %s as sent", nonce);
-				ret = JAL_E_INVAL_NONCE;
-				goto out;
-			} else {
-				DEBUG_LOG_SUB_SESSION(ch_info, "Marked %s as sent", nonce);
-			}
-		}
-
-		free(nonce);
-		nonce = NULL;
-	} while (JALDB_OK == db_ret);
-
-	DEBUG_LOG_SUB_SESSION(ch_info, "Calling jaln_finish() 5");
-	ret = jaln_finish(sess);
 out:
 	free(nonce);
 	return ret;
 }
 
-struct thread_data {
-	jaln_session *sess;
-	const struct jaln_channel_info *ch_info;
-	char *timestamp;
-};
-
-/*
- * Called in a thread to handle journal data publishing.  Allocates memory for return status.
- * Caller is reponsible for freeing this memory
- */
-__attribute__((noreturn))
-void *pub_send_journal(__attribute__((unused)) void *args)
-{
-	struct thread_data *data = (struct thread_data *) args;
-	jaln_session *sess = data->sess;
-	const struct jaln_channel_info *ch_info = data->ch_info;
-	axlHash *hash = gs_journal_subs;
-	pthread_mutex_t *sub_lock = &gs_journal_sub_lock;
-
-	char *journal_timestamp = NULL;
-
-	if (data->timestamp) {
-		journal_timestamp = jal_strdup(data->timestamp);
-		free(data->timestamp);
-	}
-
-	free(data);
-
-	pub_send_records_feeder(sess, ch_info, &journal_timestamp, hash, sub_lock, &jaln_send_journal);
-
-	free(journal_timestamp);
-
-	pthread_mutex_lock(&exit_count_lock);
-	threads_to_exit -= 1;
-	pthread_mutex_unlock(&exit_count_lock);
-
-	pthread_exit((void*)NULL);
-}
-
-/*
-* Called in a thread to handle audit data publishing.  Allocates memory for return status.
-* Caller is reponsible for freeing this memory
-*/
-__attribute__((noreturn))
-void *pub_send_audit(void *args)
-{
-	struct thread_data *data = (struct thread_data *) args;
-	jaln_session *sess = data->sess;
-	const struct jaln_channel_info *ch_info = data->ch_info;
-	axlHash *hash = gs_audit_subs;
-	pthread_mutex_t *sub_lock = &gs_audit_sub_lock;
-
-	char *audit_timestamp = NULL;
-
-	if (data->timestamp) {
-		audit_timestamp = jal_strdup(data->timestamp);
-		free(data->timestamp);
-	}
-
-	free(data);
-
-	pub_send_records(sess, ch_info, &audit_timestamp, hash, sub_lock, &jaln_send_audit);
-
-	free(audit_timestamp);
-
-	pthread_mutex_lock(&exit_count_lock);
-	threads_to_exit -= 1;
-	pthread_mutex_unlock(&exit_count_lock);
-
-	pthread_exit((void*)NULL);
-}
-
 /*
- * Called in a thread to handle log data publishing.  Allocates memory for return status.
- * Caller is reponsible for freeing this memory
+ * Called by the publisher engine once a session is closed.
  */
-__attribute__((noreturn))
-void *pub_send_log(void *args)
+static void pub_on_session_finished(
+			__attribute__((unused)) jaln_session *sess,
+			const struct jaln_channel_info *ch_info,
+			enum jal_status status,
+			void *source_data)
 {
-	struct thread_data *data = (struct thread_data *) args;
-	jaln_session *sess = data->sess;
-	const struct jaln_channel_info *ch_info = data->ch_info;
-	axlHash *hash = gs_log_subs;
-	pthread_mutex_t *sub_lock = &gs_log_sub_lock;
+	struct pub_source_t *src = (struct pub_source_t *) source_data;
+	DEBUG_LOG_SUB_SESSION(ch_info, "Session finished (%d)", status);
 
-	char *log_timestamp = NULL;
-
-	if (data->timestamp) {
-		log_timestamp = jal_strdup(data->timestamp);
-		free(data->timestamp);
-	}
-
-	free(data);
-
-	pub_send_records(sess, ch_info, &log_timestamp, hash, sub_lock, &jaln_send_log);
-
-	free(log_timestamp);
+	free(src->timestamp);
+	free(src->last_nonce);
+	free(src);
 
 	pthread_mutex_lock(&exit_count_lock);
-	threads_to_exit -= 1;
+	sessions_to_exit -= 1;
 	pthread_mutex_unlock(&exit_count_lock);
-
-	pthread_exit((void*)NULL);
 }
 
 enum jal_status pub_on_subscribe(
@@ -875,81 +869,120 @@ enum jal_status pub_on_subscribe(
 		__attribute__((unused)) struct jaln_mime_header *headers,
 		__attribute__((unused)) void *user_data)
 {
-	pthread_t journal_thread;
-	pthread_t audit_thread;
-	pthread_t log_thread;
-	pthread_attr_t attr;
-	struct thread_data *data = (struct thread_data *) jal_malloc(sizeof(struct thread_data));
-
-	if (0 != pthread_attr_init(&attr)) {
-		DEBUG_LOG_SUB_SESSION(ch_info, "ERROR in pthread_attr_init()");
-		return JAL_E_INVAL;
-	}
+	enum jal_status ret = JAL_E_INVAL;
+	enum jaldb_status db_ret = JALDB_E_INVAL;
+	struct session_ctx_t *ctx = NULL;
+	struct jaln_record_source source;
+	struct pub_source_t *src = (struct pub_source_t *) jal_calloc(1, sizeof(*src));
 
-	//pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
-	if (0 != pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_JOINABLE)) {
-		pthread_attr_destroy(&attr);
-		DEBUG_LOG_SUB_SESSION(ch_info, "ERROR in pthread_attr_setdetachstate()");
-		return JAL_E_INVAL;
+	switch (type) {
+	case JALN_RTYPE_JOURNAL:
+		src->db_type = JALDB_RTYPE_JOURNAL;
+		break;
+	case JALN_RTYPE_AUDIT:
+		src->db_type = JALDB_RTYPE_AUDIT;
+		break;
+	case JALN_RTYPE_LOG:
+		src->db_type = JALDB_RTYPE_LOG;
+		break;
+	default:
+		DEBUG_LOG_SUB_SESSION(ch_info, "Illegal Record Type");
+		goto out;
+	}
+	ret = select_channel(ch_info, &src->hash, &src->sub_lock);
+	if (JAL_OK != ret) {
+		goto out;
 	}
-
-	pthread_mutex_lock(&exit_count_lock);
-	threads_to_exit += 1;
-	pthread_mutex_unlock(&exit_count_lock);
-
-	data->sess = sess;
-	data->ch_info = ch_info;
-	data->timestamp = NULL;
 
 	if (JALN_LIVE_MODE == mode) {
-		data->timestamp = jaldb_gen_timestamp();
-		if (!data->timestamp) {
+		src->timestamp = jaldb_gen_timestamp();
+		if (!src->timestamp) {
 			DEBUG_LOG_SUB_SESSION(ch_info, "Error: Error generating timestamp");
-			return JAL_E_INVAL_TIMESTAMP;
+			ret = JAL_E_INVAL_TIMESTAMP;
+			goto out;
 		}
 	} else if (JALN_ARCHIVE_MODE != mode) {
 		// Bad mode
 		DEBUG_LOG_SUB_SESSION(ch_info, "ERROR: Bad mode");
-		return JAL_E_INVAL;
+		ret = JAL_E_INVAL;
+		goto out;
 	}
 
-	switch (type) {
-	case JALN_RTYPE_JOURNAL:
-		DEBUG_LOG_SUB_SESSION(ch_info, "Starting journal thread.");
-		if(0 != pthread_create(&journal_thread, &attr, pub_send_journal, data)) {
-			DEBUG_LOG_SUB_SESSION(ch_info, "ERROR creating a thread");
-			return JAL_E_INVAL;
-		}
+	pthread_mutex_lock(src->sub_lock);
 
-		pthread_attr_destroy(&attr);
+	ctx = (struct session_ctx_t *) axl_hash_get(src->hash, ch_info->hostname);
+	if (ctx && JALDB_RTYPE_JOURNAL != src->db_type) {
+		// The library should prevent this from happening, but just in case.
+		DEBUG_LOG_SUB_SESSION(ch_info, "Subscribe exists, rejecting subscribe request");
+		pthread_mutex_unlock(src->sub_lock);
+		ret = JAL_E_INVAL;
+		goto out;
+	}
+	// A journal resume has already set up the context
+	if (!ctx) {
+		ctx = (struct session_ctx_t*) calloc(1, sizeof(*ctx));
+		if (!ctx) {
+			DEBUG_LOG_SUB_SESSION(ch_info, "Failed to allocate context");
+			pthread_mutex_unlock(src->sub_lock);
+			ret = JAL_E_NO_MEM;
+			goto out;
+		}
 
-		break;
-	case JALN_RTYPE_AUDIT:
-		DEBUG_LOG_SUB_SESSION(ch_info, "Starting audit thread.");
-		if(0 != pthread_create(&audit_thread, &attr, pub_send_audit, data)) {
-			DEBUG_LOG_SUB_SESSION(ch_info, "ERROR creating a thread");
-			return JAL_E_INVAL;
+		jaldb_record_view_init(&ctx->view);
+		jaldb_record_batch_init(&ctx->batch);
+		ctx->db_ctx = setup_db_layer();
+		if(NULL == ctx->db_ctx) {
+			DEBUG_LOG_SUB_SESSION(ch_info, "Failed to setup db");
+			pthread_mutex_unlock(src->sub_lock);
+			free(ctx);
+			ret = JAL_E_INVAL;
+			goto out;
 		}
 
-		pthread_attr_destroy(&attr);
+		DEBUG_LOG_SUB_SESSION(ch_info, "Inserting new session");
 
-		break;
-	case JALN_RTYPE_LOG:
-		DEBUG_LOG_SUB_SESSION(ch_info, "Starting log thread.");
-		if (0 != pthread_create(&log_thread, &attr, pub_send_log, data)) {
-			DEBUG_LOG_SUB_SESSION(ch_info, "ERROR creating a thread");
-			return JAL_E_INVAL;
+		axl_hash_insert_full(src->hash, strdup(ch_info->hostname), free, ctx, free);
+	}
+
+	DEBUG_LOG_SUB_SESSION(ch_info, "Verifying previously sent records.");
+	// Only need to clear sent flags for archive mode connection
+	if (!src->timestamp) {
+		db_ret = jaldb_mark_unsynced_records_unsent(ctx->db_ctx, src->db_type);
+		if (JALDB_OK != db_ret) {
+			DEBUG_LOG_SUB_SESSION(ch_info, "Failed to verify records.");
+			pthread_mutex_unlock(src->sub_lock);
+			ret = JAL_E_INVAL;
+			goto out;
 		}
+	}
 
-		pthread_attr_destroy(&attr);
+	pthread_mutex_unlock(src->sub_lock);
 
-		break;
-	default:
-		DEBUG_LOG_SUB_SESSION(ch_info, "Illegal Record Type");
-		return JAL_E_INVAL;
-	}
+	source.source_data = src;
+	source.send_next = pub_send_next_record;
+	source.on_finished = pub_on_session_finished;
 
+	pthread_mutex_lock(&exit_count_lock);
+	sessions_to_exit += 1;
+	pthread_mutex_unlock(&exit_count_lock);
+
+	DEBUG_LOG_SUB_SESSION(ch_info, "Handing the session to the publisher engine.");
+	ret = jaln_pub_engine_add_session(pub_engine, sess, &source);
+	if (JAL_OK != ret) {
+		DEBUG_LOG_SUB_SESSION(ch_info, "Failed to add the session to the publisher engine (%d)", ret);
+		pthread_mutex_lock(&exit_count_lock);
+		sessions_to_exit -= 1;
+		pthread_mutex_unlock(&exit_count_lock);
+		goto out;
+	}
+	// The engine owns src now
 	return JAL_OK;
+
+out:
+	free(src->timestamp);
+	free(src->last_nonce);
+	free(src);
+	return ret;
 }
 
 enum jal_status pub_on_record_complete(
@@ -975,7 +1008,10 @@ enum jal_status pub_on_record_complete(
 		return JAL_E_INVAL;
 	}
 
+	jaln_payload_source_destroy(&ctx->payload_src);
 	jaldb_destroy_record(&ctx->rec);
+	jaldb_record_cache_release(record_cache, &ctx->cached);
+	jaldb_record_view_release(&ctx->view);
 	return JAL_OK;
 }
 
@@ -1121,6 +1157,10 @@ error:
 	// The digests do not match. We need to mark the record as unsent so it can be sent again by the publisher.
 	if(ctx)
 	{
+		// The record may still be waiting to be marked sent with its batch
+		pthread_mutex_lock(sub_lock);
+		pub_mark_sent(ch_info, ctx, db_type);
+		pthread_mutex_unlock(sub_lock);
 		db_ret = jaldb_mark_sent(ctx->db_ctx, db_type, nonce, 0);
 	}
 
@@ -1261,6 +1301,16 @@ int main(int argc, char **argv)
 		rc = -1;
 		goto out;
 	}
+	sys_meta_cache = jaldb_sys_meta_cache_create(global_config.sys_meta_cache_size, 0);
+	record_cache = jaldb_record_cache_create(global_config.record_cache_size);
+	pub_engine = jaln_pub_engine_create(global_config.publisher_threads,
+			global_config.poll_time * 1000);
+	if (!pub_engine) {
+		DEBUG_LOG("Failed to start the publisher engine");
+		rc = -1;
+		goto out;
+	}
+	start_insert_watchers();
 	gs_journal_subs = axl_hash_new(axl_hash_string, axl_hash_equal_string);
 	gs_audit_subs = axl_hash_new(axl_hash_string, axl_hash_equal_string);
 	gs_log_subs = axl_hash_new(axl_hash_string, axl_hash_equal_string);
@@ -1380,6 +1430,11 @@ int main(int argc, char **argv)
 			pub_cbs = NULL;
 
 			setNetworkTimeout(jctx, global_config.network_timeout);
+			if (JAL_OK != jaln_set_pipeline_depth(jctx, global_config.pipeline_depth)) {
+				DEBUG_LOG("Failed to set the pipeline depth");
+				rc = -1;
+				goto out;
+			}
 			peer->net_ctx = jctx;
 
 			++peer->retries;
@@ -1427,9 +1482,29 @@ int main(int argc, char **argv)
 	}
 
 out:
-	while (threads_to_exit > 0) {
+	while (sessions_to_exit > 0) {
 		sleep(1);
 	}
+	stop_insert_watchers();
+	jaln_pub_engine_destroy(&pub_engine);
+	if (sys_meta_cache) {
+		struct jaldb_sys_meta_cache_stats stats;
+		jaldb_sys_meta_cache_get_stats(sys_meta_cache, &stats);
+		DEBUG_LOG("System metadata cache: %llu hits, %llu misses, %llu evictions, %llu write backs",
+				(unsigned long long) stats.hits, (unsigned long long) stats.misses,
+				(unsigned long long) stats.evictions, (unsigned long long) stats.write_backs);
+		jaldb_sys_meta_cache_destroy(&sys_meta_cache);
+	}
+	if (record_cache) {
+		struct jaldb_record_cache_stats stats;
+		jaldb_record_cache_get_stats(record_cache, &stats);
+		uint64_t lookups = stats.hits + stats.misses;
+		DEBUG_LOG("Record cache: %llu hits, %llu misses (%.1f%% hit ratio), %llu evictions",
+				(unsigned long long) stats.hits, (unsigned long long) stats.misses,
+				lookups ? 100.0 * stats.hits / lookups : 0.0,
+				(unsigned long long) stats.evictions);
+		jaldb_record_cache_destroy(&record_cache);
+	}
 	// try to free the connection to each peer
 	for (int i = 0; i < global_config.num_peers; ++i) {
 		peer = global_config.peers + i;
@@ -1658,6 +1733,11 @@ void print_config(void)
 	printf("POLL TIME:\t\t%lld\n", global_config.poll_time);
 	printf("RETRY INTERNVAL:\t%lld\n", global_config.retry_interval);
 	printf("NETWORK TIMEOUT:\t%lld\n", global_config.network_timeout);
+	printf("PIPELINE DEPTH:\t\t%d\n", global_config.pipeline_depth);
+	printf("PUBLISHER THREADS:\t%d\n", global_config.publisher_threads);
+	printf("SYS META CACHE SIZE:\t%d\n", global_config.sys_meta_cache_size);
+	printf("SYS META WRITE BACK:\t%s\n", global_config.sys_meta_write_back ? "true" : "false");
+	printf("RECORD CACHE SIZE:\t%lld\n", global_config.record_cache_size);
 	printf("DB ROOT:\t\t%s\n", global_config.db_root);
 	printf("SCHEMAS ROOT:\t\t%s\n", global_config.schemas_root);
 	if(global_config.pid_file) {
@@ -1896,6 +1976,58 @@ enum jald_status set_global_config(config_t *config)
 		CONFIG_ERROR(root, JALNS_NETWORK_TIMEOUT, "expected positive integer value or 0");
 		return JALD_E_CONFIG_LOAD;
 	}
+	// pipeline_depth is optional
+	global_config.pipeline_depth = JALN_DEFAULT_PIPELINE_DEPTH;
+	if (config_setting_get_member(root, JALNS_PIPELINE_DEPTH)) {
+		rc = config_setting_lookup_int(root, JALNS_PIPELINE_DEPTH, &global_config.pipeline_depth);
+		if (CONFIG_FALSE == rc || global_config.pipeline_depth < 1 ||
+				global_config.pipeline_depth > JALN_MAX_PIPELINE_DEPTH) {
+			CONFIG_ERROR(root, JALNS_PIPELINE_DEPTH, "expected integer value between 1 and 64");
+			return JALD_E_CONFIG_LOAD;
+		}
+	}
+	// publisher_threads is optional
+	global_config.publisher_threads = 1;
+	if (config_setting_get_member(root, JALNS_PUBLISHER_THREADS)) {
+		rc = config_setting_lookup_int(root, JALNS_PUBLISHER_THREADS, &global_config.publisher_threads);
+		if (CONFIG_FALSE == rc || global_config.publisher_threads < 1 ||
+				global_config.publisher_threads > JALN_MAX_ENGINE_THREADS) {
+			CONFIG_ERROR(root, JALNS_PUBLISHER_THREADS, "expected integer value between 1 and 64");
+			return JALD_E_CONFIG_LOAD;
+		}
+	}
+	// sys_meta_cache_size is optional
+	global_config.sys_meta_cache_size = 0;
+	if (config_setting_get_member(root, JALNS_SYS_META_CACHE_SIZE)) {
+		rc = config_setting_lookup_int(root, JALNS_SYS_META_CACHE_SIZE, &global_config.sys_meta_cache_size);
+		if (CONFIG_FALSE == rc || global_config.sys_meta_cache_size < 0) {
+			CONFIG_ERROR(root, JALNS_SYS_META_CACHE_SIZE, "expected positive integer value or 0");
+			return JALD_E_CONFIG_LOAD;
+		}
+	}
+
+	// sys_meta_write_back is optional
+	global_config.sys_meta_write_back = false;
+	if (config_setting_get_member(root, JALNS_SYS_META_WRITE_BACK)) {
+		int write_back = 0;
+		rc = config_setting_lookup_bool(root, JALNS_SYS_META_WRITE_BACK, &write_back);
+		if (CONFIG_FALSE == rc) {
+			CONFIG_ERROR(root, JALNS_SYS_META_WRITE_BACK, "expected boolean value");
+			return JALD_E_CONFIG_LOAD;
+		}
+		global_config.sys_meta_write_back = write_back;
+	}
+
+	// record_cache_size is optional
+	global_config.record_cache_size = 0;
+	if (config_setting_get_member(root, JALNS_RECORD_CACHE_SIZE)) {
+		rc = config_setting_lookup_int64(root, JALNS_RECORD_CACHE_SIZE, &global_config.record_cache_size);
+		if (CONFIG_FALSE == rc || global_config.record_cache_size < 0) {
+			CONFIG_ERROR(root, JALNS_RECORD_CACHE_SIZE, "expected positive integer value or 0");
+			return JALD_E_CONFIG_LOAD;
+		}
+	}
+
 	rc = config_setting_lookup_string(root, JALNS_PUBLISHER_ID, &global_config.pub_id);
 	if (CONFIG_FALSE == rc) {
 		CONFIG_ERROR(root, JALNS_PUBLISHER_ID, "expected string value");
@@ -1957,6 +2089,12 @@ static jaldb_context_t* setup_db_layer(void)
 	jaldb_context_t* db_ctx = jaldb_context_create();
 
 	jaldb_ret = jaldb_context_init(db_ctx, global_config.db_root, JDB_NONE);
+	if (JALDB_OK == jaldb_ret) {
+		// Every session shares one cache, so a record sent to several
+		// peers only has its system metadata generated once
+		jaldb_ret = jaldb_set_sys_meta_cache(db_ctx, sys_meta_cache,
+				global_config.sys_meta_write_back);
+	}
 
 	if (JALDB_OK != jaldb_ret) {
 		jaldb_context_destroy(&db_ctx);
@@ -1965,28 +2103,56 @@ static jaldb_context_t* setup_db_layer(void)
 	return db_ctx;
 }
 
-static enum jal_status pub_get_bytes(const uint64_t offset, uint8_t * const buffer, uint64_t *size, void *feeder_data)
+static void *watch_inserts(void *arg)
 {
-	// TODO: this may need to support reading from buffers stored in RAM,
-	// rather than disk.
-#define ERRNO_STR_LEN 128
-	off64_t err;
-	struct session_ctx_t *ctx = (struct session_ctx_t*) feeder_data;
-	errno = 0;
-	err = lseek64(ctx->rec->payload->fd, offset, SEEK_SET);
-	int my_errno = errno;
-	if (-1 == err) {
-		char buf[ERRNO_STR_LEN];
-		DEBUG_LOG("Failed to seek, errno %s\n", strerror_r(my_errno, buf, ERRNO_STR_LEN));
-		return JAL_E_INVAL;
+	struct insert_watcher_t *watcher = (struct insert_watcher_t *)arg;
+	uint32_t seq = 0;
+
+	jaldb_get_insert_seq(watch_db_ctx, watcher->db_type, &seq);
+	while (!exiting) {
+		enum jaldb_status ret = jaldb_wait_for_insert(watch_db_ctx,
+				watcher->db_type, &seq, JALD_WATCH_TIMEOUT_MS);
+		if (JALDB_OK == ret) {
+			jaln_pub_engine_notify(pub_engine, watcher->type);
+		}
 	}
-	size_t to_read = *size;
-	ssize_t bytes_read = read(ctx->rec->payload->fd, buffer, to_read);
-	if (bytes_read < 0) {
-		return JAL_E_INVAL;
+	return NULL;
+}
+
+static void start_insert_watchers(void)
+{
+	// Without the watchers, sources are still polled every poll_time
+	watch_db_ctx = setup_db_layer();
+	if (!watch_db_ctx) {
+		DEBUG_LOG("Failed to open the database for insert notifications");
+		return;
+	}
+	size_t num_watchers = sizeof(insert_watchers) / sizeof(insert_watchers[0]);
+	for (size_t i = 0; i < num_watchers; i++) {
+		struct insert_watcher_t *watcher = insert_watchers + i;
+		if (0 != pthread_create(&watcher->thread, NULL, watch_inserts, watcher)) {
+			DEBUG_LOG("Failed to start the insert watcher thread");
+			continue;
+		}
+		watcher->started = true;
+	}
+}
+
+static void stop_insert_watchers(void)
+{
+	// The watchers also stop when jald gives up on an error
+	exiting = 1;
+	size_t num_watchers = sizeof(insert_watchers) / sizeof(insert_watchers[0]);
+	for (size_t i = 0; i < num_watchers; i++) {
+		struct insert_watcher_t *watcher = insert_watchers + i;
+		if (watcher->started) {
+			pthread_join(watcher->thread, NULL);
+			watcher->started = false;
+		}
+	}
+	if (watch_db_ctx) {
+		jaldb_context_destroy(&watch_db_ctx);
 	}
-	*size = bytes_read;
-	return JAL_OK;
 }
 
 static enum jal_status select_channel(const struct jaln_channel_info * ch_info, axlHash ** hash, pthread_mutex_t ** sub_lock)
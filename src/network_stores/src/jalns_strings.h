@@ -55,6 +55,11 @@ extern "C" {
 #define JALNS_RETRY_INTERVAL "retry_interval"
 #define JALNS_CERT_DIR "cert_dir"
 #define JALNS_NETWORK_TIMEOUT "network_timeout"
+#define JALNS_PIPELINE_DEPTH "pipeline_depth"
+#define JALNS_PUBLISHER_THREADS "publisher_threads"
+#define JALNS_SYS_META_CACHE_SIZE "sys_meta_cache_size"
+#define JALNS_SYS_META_WRITE_BACK "sys_meta_write_back"
+#define JALNS_RECORD_CACHE_SIZE "record_cache_size"
 #define JALNS_PID_FILE "pid_file"
 #define JALNS_LOG_DIR "log_dir"
 #define JALNS_DIGEST_ALGORITHMS "digest_algorithms"
@@ -64,11 +64,19 @@ extern "C" {
 /**
  * Opaque pointer to the jalp_context.
  * The jalp_context holds information about the connection to the JALoP Local Store.
- * The jalp_context is not thread safe. Applications must either create
- * separate logging connections for each thread, or properly guard the jalp_context.
+ * Once it is set up, threads may share a jalp_context and call jalp_log(),
+ * jalp_audit() and the journal functions at the same time. Each thread
+ * sends on a connection of its own, opened the first time it is needed,
+ * up to 16 connections; beyond that, threads wait for a connection to be
+ * free. Records from an asynchronous context (jalp_context_enable_async())
+ * or between jalp_context_begin_batch() and jalp_context_end_batch() are
+ * queued one thread at a time and keep their order.
  *
- * Because each connection requires resources in the JAL Local Store, a
- * massively threaded process should avoid creating a connection for each thread.
+ * Functions that change the context, such as jalp_context_init(), loading
+ * keys and certificates, setting digest callbacks or flags, and enabling
+ * asynchronous sending or the shared memory ring, must not be called while
+ * other threads use it. jalp_context_begin_batch() and
+ * jalp_context_end_batch() may be.
  */
 typedef struct jalp_context_t jalp_context;
 
@@ -162,6 +170,175 @@ enum jal_status jalp_context_set_digest_callbacks(jalp_context *ctx,
 		const struct jal_digest_ctx *digest_ctx);
 
 
+/**
+ * What an asynchronous context does with a record when its queue is full.
+ */
+enum jalp_async_overflow {
+	/** Wait until the background thread has made room for the record. */
+	JALP_ASYNC_BLOCK,
+	/** Drop the record that did not fit. */
+	JALP_ASYNC_DROP_NEWEST,
+	/**
+	 * Append the record to a spill file. Spilled records are sent, in
+	 * order, once the queue has drained.
+	 */
+	JALP_ASYNC_SPILL,
+};
+
+/**
+ * Record counts of an asynchronous context.
+ */
+struct jalp_async_stats {
+	uint64_t queued;	/**< Records accepted, into the queue or the spill file */
+	uint64_t sent;		/**< Records written to the JALoP Local Store */
+	uint64_t dropped;	/**< Records dropped because there was no room for them */
+	uint64_t spilled;	/**< Records written to the spill file */
+};
+
+/**
+ * Default size of the queue of an asynchronous context, in bytes.
+ */
+#define JALP_ASYNC_DEFAULT_QUEUE_SIZE (4 * 1024 * 1024)
+
+/**
+ * Send records from a background thread.
+ *
+ * Once enabled, #jalp_log, #jalp_audit and #jalp_journal (and their
+ * variants) copy the finished message into a bounded queue and return
+ * without waiting for the JALoP Local Store. A background thread writes
+ * the queued messages to the Local Store, many at a time, reconnecting if
+ * it has to.
+ *
+ * Journal records passed as file descriptors, and records too big for the
+ * queue, are still sent by the calling thread, after everything queued
+ * before them.
+ *
+ * Errors from the Local Store are no longer returned by the calls that
+ * produced the records. Use #jalp_context_flush to find out if the
+ * records made it. A record that had to be dropped makes the call return
+ * JAL_E_NO_MEM.
+ *
+ * @param[in] ctx The context, which must be initialized.
+ * @param[in] queue_size The size of the queue in bytes, or 0 for
+ * #JALP_ASYNC_DEFAULT_QUEUE_SIZE.
+ * @param[in] overflow What to do with records that do not fit in the queue.
+ * @param[in] spill_path The file to spill records to. Required for
+ * #JALP_ASYNC_SPILL, and must be NULL otherwise. Records left in the file
+ * by an earlier run are sent first.
+ *
+ * @return JAL_OK on success, or one of the following possible errors:
+ * JAL_E_INVAL, JAL_E_UNINITIALIZED, JAL_E_INITIALIZED if asynchronous
+ * sending is already enabled, JAL_E_FILE_OPEN if the spill file could not
+ * be opened, JAL_E_INTERNAL_ERROR if the thread could not be started.
+ */
+enum jal_status jalp_context_enable_async(jalp_context *ctx,
+		size_t queue_size,
+		enum jalp_async_overflow overflow,
+		const char *spill_path);
+
+/**
+ * Wait until every record queued on an asynchronous context has been
+ * written to the JALoP Local Store.
+ *
+ * #jalp_context_destroy does this too, waiting up to a few seconds.
+ * Whatever is left after that is kept in the spill file if there is one,
+ * and dropped otherwise.
+ *
+ * @param[in] ctx The context.
+ * @param[in] timeout_ms The longest to wait, in milliseconds, or a negative
+ * number to wait as long as the Local Store can be reached.
+ *
+ * @return JAL_OK if the queue is empty, or does not exist,
+ * JAL_E_NOT_CONNECTED if the Local Store could not be reached or the
+ * timeout passed first, JAL_E_INVAL if \p ctx is NULL.
+ */
+enum jal_status jalp_context_flush(jalp_context *ctx, long timeout_ms);
+
+/**
+ * Get the record counts of an asynchronous context.
+ *
+ * @param[in] ctx The context.
+ * @param[out] stats The counts. All zero if asynchronous sending is not
+ * enabled.
+ *
+ * @return JAL_OK, or JAL_E_INVAL if a parameter is NULL.
+ */
+enum jal_status jalp_context_get_async_stats(jalp_context *ctx,
+		struct jalp_async_stats *stats);
+
+/**
+ * The most records sent in one batch.
+ */
+#define JALP_BATCH_MAX_RECORDS 1024
+
+/**
+ * A batch is sent once its records hold this many bytes of data and
+ * application metadata.
+ */
+#define JALP_BATCH_MAX_BYTES (1024 * 1024)
+
+/**
+ * Start collecting log and audit records into batches.
+ *
+ * Until #jalp_context_end_batch is called, #jalp_log and #jalp_audit (and
+ * their variants) only add the finished record to the batch. The batch is
+ * sent as a single message once it holds #JALP_BATCH_MAX_RECORDS records
+ * or #JALP_BATCH_MAX_BYTES bytes, when a journal record is sent, and by
+ * #jalp_context_end_batch. The JALoP Local Store inserts all of the
+ * records in a batch with one transaction.
+ *
+ * An error sending a batch is returned by the call that caused it to be
+ * sent, and the records in that batch are dropped.
+ *
+ * Batches need a JALoP Local Store that supports them.
+ *
+ * @param[in] ctx The context, which must be initialized.
+ *
+ * @return JAL_OK on success, JAL_E_INVAL if \p ctx is NULL,
+ * JAL_E_UNINITIALIZED, or JAL_E_INITIALIZED if a batch is already open.
+ */
+enum jal_status jalp_context_begin_batch(jalp_context *ctx);
+
+/**
+ * Send the records collected since #jalp_context_begin_batch and stop
+ * collecting them. #jalp_context_destroy does this too.
+ *
+ * @param[in] ctx The context.
+ *
+ * @return JAL_OK, JAL_E_INVAL if \p ctx is NULL or has no open batch, or
+ * the error from sending the records.
+ */
+enum jal_status jalp_context_end_batch(jalp_context *ctx);
+
+/**
+ * The ring size used when 0 is passed to #jalp_context_enable_shm.
+ */
+#define JALP_SHM_DEFAULT_RING_SIZE (4 * 1024 * 1024)
+
+/**
+ * Send log, audit and batch messages through a ring in shared memory
+ * instead of writing them to the socket.
+ *
+ * The ring is offered to the JALoP Local Store over the socket each time
+ * the context connects, starting now. A Local Store that does not support
+ * it, or does not want it, keeps receiving everything over the socket.
+ * Journal records, and records bigger than half the ring, are still sent
+ * over the socket, after everything in the ring.
+ *
+ * Records queued by #jalp_context_enable_async always go over the socket,
+ * so this must be called first if at all.
+ *
+ * @param[in] ctx The context, which must be initialized.
+ * @param[in] ring_size The size of the ring in bytes, a power of two
+ * between 64 KiB and 1 GiB, or 0 for #JALP_SHM_DEFAULT_RING_SIZE.
+ *
+ * @return JAL_OK if the ring is in use, JAL_E_COMM if the Local Store
+ * turned it down, JAL_E_NOT_CONNECTED if the Local Store could not be
+ * reached, JAL_E_UNINITIALIZED, or JAL_E_INVAL if \p ctx is NULL or
+ * asynchronous, or \p ring_size is not allowed.
+ */
+enum jal_status jalp_context_enable_shm(jalp_context *ctx, size_t ring_size);
+
 /** @} */
 
 /**
@@ -0,0 +1,850 @@
+/**
+ * @file jalp_async.c This file contains functions to queue records and send
+ * them to the JALoP Local Store from a background thread.
+ *
+ * @section LICENSE
+ *
+ * Source code in 3rd-party is licensed and owned by their respective
+ * copyright holders.
+ *
+ * All other source code is copyright Tresys Technology and licensed as below.
+ *
+ * Copyright (c) 2012 Tresys Technology LLC, Columbia, Maryland, USA
+ *
+ * This software was developed by Tresys Technology LLC
+ * with U.S. Government sponsorship.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <jalop/jal_status.h>
+#include <jalop/jal_version.h>
+#include "jal_alloc.h"
+#include "jal_asprintf_internal.h"
+#include "jalp_async_internal.h"
+#include "jalp_connection_internal.h"
+#include "jalp_context_internal.h"
+
+#define JALP_ASYNC_HEADER_LEN (2 * sizeof(uint16_t) + 2 * sizeof(uint64_t))
+#define JALP_ASYNC_BREAK_LEN (sizeof(JALP_BREAK_STR) - 1)
+#define JALP_ASYNC_FRAME_IOVS 6
+#define JALP_ASYNC_MIN_RETRY_MS 10
+#define JALP_ASYNC_MAX_RETRY_MS 1000
+#define JALP_ASYNC_COPY_CHUNK (64 * 1024)
+
+#ifdef MSG_NOSIGNAL
+#define JALP_ASYNC_SEND_FLAGS MSG_NOSIGNAL
+#else
+#define JALP_ASYNC_SEND_FLAGS 0
+#endif
+
+struct jalp_async {
+	jalp_context *ctx;		//!< The context to send with
+	uint8_t *ring;			//!< Queued messages, in the format they are sent in
+	uint64_t size;			//!< The size of the ring
+	uint64_t head;			//!< Bytes ever queued, only written by the producer
+	uint64_t tail;			//!< Bytes ever sent, only written by the flusher
+	enum jalp_async_overflow overflow;
+
+	pthread_t thread;
+	pthread_mutex_t lock;		//!< Protects everything below that is not atomic
+	pthread_cond_t wake;		//!< Signaled when the flusher has work
+	pthread_cond_t space;		//!< Signaled when the ring has more room
+	pthread_cond_t drained;		//!< Signaled when the flusher runs out of work or fails
+	int flusher_idle;		//!< Set while the flusher waits for work
+	int producer_waiting;		//!< Set while the producer waits for room
+	int stop;
+	uint64_t failures;		//!< How many times sending has failed
+
+	int spill_fd;			//!< The spill file, or -1
+	char *spill_path;
+	uint64_t spill_len;		//!< The number of bytes in the spill file
+	uint64_t spill_off;		//!< How much of the spill file has been sent
+	int spilling;			//!< Set while records go to the spill file
+	uint8_t *spill_buf;		//!< Flusher buffer for one spilled message
+	uint64_t spill_buf_len;
+
+	uint64_t queued;
+	uint64_t sent;
+	uint64_t dropped;
+	uint64_t spilled;
+};
+
+static uint64_t jalp_async_frame_len(uint64_t data_len, uint64_t meta_len)
+{
+	const uint64_t max = UINT64_MAX / 4;
+	if (data_len > max || meta_len > max) {
+		return UINT64_MAX;
+	}
+	return JALP_ASYNC_HEADER_LEN + data_len + JALP_ASYNC_BREAK_LEN +
+		meta_len + JALP_ASYNC_BREAK_LEN;
+}
+
+/**
+ * Get the length of the message that starts with \p hdr.
+ *
+ * @return 0 on success, -1 if the header is not one that can be queued.
+ */
+static int jalp_async_parse_header(const uint8_t *hdr, uint64_t *frame_len)
+{
+	uint16_t version;
+	uint16_t message_type;
+	uint64_t data_len;
+	uint64_t meta_len;
+
+	memcpy(&version, hdr, sizeof(version));
+	hdr += sizeof(version);
+	memcpy(&message_type, hdr, sizeof(message_type));
+	hdr += sizeof(message_type);
+	memcpy(&data_len, hdr, sizeof(data_len));
+	hdr += sizeof(data_len);
+	memcpy(&meta_len, hdr, sizeof(meta_len));
+
+	if (JPP_VERSION != version || (JALP_LOG_MSG != message_type &&
+			JALP_AUDIT_MSG != message_type &&
+			JALP_JOURNAL_MSG != message_type &&
+			JALP_BATCH_MSG != message_type)) {
+		return -1;
+	}
+	*frame_len = jalp_async_frame_len(data_len, meta_len);
+	return UINT64_MAX == *frame_len ? -1 : 0;
+}
+
+/**
+ * Point \p iov at the pieces of a message, with the header written to
+ * \p hdr. This is the same layout jalp_connection_fill_out_msghdr() uses.
+ *
+ * @return The length of the message.
+ */
+static uint64_t jalp_async_fill_iov(struct iovec *iov, uint8_t *hdr,
+		uint16_t message_type, const void *data, uint64_t data_len,
+		const void *meta, uint64_t meta_len)
+{
+	uint16_t version = JPP_VERSION;
+	uint8_t *cur = hdr;
+	memcpy(cur, &version, sizeof(version));
+	cur += sizeof(version);
+	memcpy(cur, &message_type, sizeof(message_type));
+	cur += sizeof(message_type);
+	memcpy(cur, &data_len, sizeof(data_len));
+	cur += sizeof(data_len);
+	memcpy(cur, &meta_len, sizeof(meta_len));
+
+	iov[0].iov_base = hdr;
+	iov[0].iov_len = JALP_ASYNC_HEADER_LEN;
+	iov[1].iov_base = (void *) data;
+	iov[1].iov_len = data_len;
+	iov[2].iov_base = JALP_BREAK_STR;
+	iov[2].iov_len = JALP_ASYNC_BREAK_LEN;
+	iov[3].iov_base = (void *) meta;
+	iov[3].iov_len = meta_len;
+	iov[4].iov_base = JALP_BREAK_STR;
+	iov[4].iov_len = JALP_ASYNC_BREAK_LEN;
+	return jalp_async_frame_len(data_len, meta_len);
+}
+
+static void jalp_async_ring_write(struct jalp_async *async, uint64_t pos,
+		const void *src, uint64_t len)
+{
+	uint64_t off = pos % async->size;
+	uint64_t first = async->size - off;
+	if (first > len) {
+		first = len;
+	}
+	memcpy(async->ring + off, src, first);
+	memcpy(async->ring, (const uint8_t *) src + first, len - first);
+}
+
+static void jalp_async_ring_read(struct jalp_async *async, uint64_t pos,
+		void *dst, uint64_t len)
+{
+	uint64_t off = pos % async->size;
+	uint64_t first = async->size - off;
+	if (first > len) {
+		first = len;
+	}
+	memcpy(dst, async->ring + off, first);
+	memcpy((uint8_t *) dst + first, async->ring, len - first);
+}
+
+static uint64_t jalp_async_ring_frame_len(struct jalp_async *async, uint64_t pos)
+{
+	uint8_t hdr[JALP_ASYNC_HEADER_LEN];
+	uint64_t frame_len = 0;
+	jalp_async_ring_read(async, pos, hdr, sizeof(hdr));
+	// Only whole, valid messages are ever queued
+	jalp_async_parse_header(hdr, &frame_len);
+	return frame_len;
+}
+
+static void jalp_async_deadline(long timeout_ms, struct timespec *ts)
+{
+	clock_gettime(CLOCK_MONOTONIC, ts);
+	ts->tv_sec += timeout_ms / 1000;
+	ts->tv_nsec += (timeout_ms % 1000) * 1000000;
+	if (ts->tv_nsec >= 1000000000) {
+		ts->tv_sec++;
+		ts->tv_nsec -= 1000000000;
+	}
+}
+
+static int jalp_async_write_all(int fd, struct iovec *iov, int iovcnt)
+{
+	while (iovcnt > 0) {
+		ssize_t n = writev(fd, iov, iovcnt);
+		if (-1 == n) {
+			if (EINTR == errno) {
+				continue;
+			}
+			return -1;
+		}
+		while (iovcnt > 0 && (size_t) n >= iov->iov_len) {
+			n -= iov->iov_len;
+			iov++;
+			iovcnt--;
+		}
+		if (iovcnt > 0) {
+			iov->iov_base = (uint8_t *) iov->iov_base + n;
+			iov->iov_len -= n;
+		}
+	}
+	return 0;
+}
+
+static int jalp_async_pread_all(int fd, void *buf, uint64_t len, uint64_t off)
+{
+	while (len > 0) {
+		ssize_t n = pread(fd, buf, len, off);
+		if (-1 == n && EINTR == errno) {
+			continue;
+		}
+		if (n <= 0) {
+			return -1;
+		}
+		buf = (uint8_t *) buf + n;
+		len -= n;
+		off += n;
+	}
+	return 0;
+}
+
+static int jalp_async_send_all(int fd, struct iovec *iov, int iovcnt)
+{
+	struct msghdr msgh;
+	while (iovcnt > 0) {
+		memset(&msgh, 0, sizeof(msgh));
+		msgh.msg_iov = iov;
+		msgh.msg_iovlen = iovcnt;
+		ssize_t n = sendmsg(fd, &msgh, JALP_ASYNC_SEND_FLAGS);
+		if (-1 == n) {
+			if (EINTR == errno) {
+				continue;
+			}
+			return -1;
+		}
+		while (iovcnt > 0 && (size_t) n >= iov->iov_len) {
+			n -= iov->iov_len;
+			iov++;
+			iovcnt--;
+		}
+		if (iovcnt > 0) {
+			iov->iov_base = (uint8_t *) iov->iov_base + n;
+			iov->iov_len -= n;
+		}
+	}
+	return 0;
+}
+
+/**
+ * Empty the spill file. Must be called with the lock held.
+ */
+static void jalp_async_spill_reset(struct jalp_async *async)
+{
+	if (0 != ftruncate(async->spill_fd, 0)) {
+		// Keep going, the offsets still say it is empty
+	}
+	async->spill_len = 0;
+	async->spill_off = 0;
+	__atomic_store_n(&async->spilling, 0, __ATOMIC_RELEASE);
+}
+
+/**
+ * Open the spill file and keep the whole messages an earlier run left in it.
+ */
+static enum jal_status jalp_async_spill_open(struct jalp_async *async, const char *path)
+{
+	uint8_t hdr[JALP_ASYNC_HEADER_LEN];
+	struct stat st;
+	uint64_t off = 0;
+	uint64_t frame_len;
+
+	async->spill_fd = open(path, O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, S_IRUSR | S_IWUSR);
+	if (-1 == async->spill_fd || 0 != fstat(async->spill_fd, &st)) {
+		return JAL_E_FILE_OPEN;
+	}
+	async->spill_path = jal_strdup(path);
+
+	// A message that was being written when the last run stopped is cut
+	// off, along with anything after it.
+	while (off + JALP_ASYNC_HEADER_LEN <= (uint64_t) st.st_size &&
+			0 == jalp_async_pread_all(async->spill_fd, hdr, sizeof(hdr), off) &&
+			0 == jalp_async_parse_header(hdr, &frame_len) &&
+			off + frame_len <= (uint64_t) st.st_size) {
+		off += frame_len;
+	}
+	if (off != (uint64_t) st.st_size && 0 != ftruncate(async->spill_fd, off)) {
+		return JAL_E_FILE_IO;
+	}
+	async->spill_len = off;
+	async->spilling = off > 0;
+	return JAL_OK;
+}
+
+/**
+ * Copy the unsent part of the spill file to \p fd.
+ */
+static int jalp_async_spill_copy(struct jalp_async *async, int fd)
+{
+	uint8_t buf[JALP_ASYNC_COPY_CHUNK];
+	uint64_t off = async->spill_off;
+	while (off < async->spill_len) {
+		uint64_t len = async->spill_len - off;
+		if (len > sizeof(buf)) {
+			len = sizeof(buf);
+		}
+		struct iovec iov = { buf, len };
+		if (0 != jalp_async_pread_all(async->spill_fd, buf, len, off) ||
+				0 != jalp_async_write_all(fd, &iov, 1)) {
+			return -1;
+		}
+		off += len;
+	}
+	return 0;
+}
+
+/**
+ * Rewrite the spill file so it holds only what was not sent, starting with
+ * the messages still in the ring, which are older than the spilled ones.
+ * Called once the flusher has stopped.
+ */
+static void jalp_async_spill_save(struct jalp_async *async)
+{
+	uint64_t head = async->head;
+	uint64_t tail = async->tail;
+	char *tmp_path = NULL;
+	int fd = -1;
+
+	if (tail == head && 0 == async->spill_off) {
+		return;
+	}
+	if (tail == head && async->spill_off == async->spill_len) {
+		jalp_async_spill_reset(async);
+		return;
+	}
+
+	jal_asprintf(&tmp_path, "%s.tmp", async->spill_path);
+	fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, S_IRUSR | S_IWUSR);
+	if (-1 == fd) {
+		goto out;
+	}
+	if (tail != head) {
+		uint64_t off = tail % async->size;
+		uint64_t len = head - tail;
+		uint64_t first = async->size - off < len ? async->size - off : len;
+		struct iovec iov[2] = {
+			{ async->ring + off, first },
+			{ async->ring, len - first },
+		};
+		if (0 != jalp_async_write_all(fd, iov, 2)) {
+			goto out;
+		}
+	}
+	if (0 != jalp_async_spill_copy(async, fd) || 0 != fsync(fd) ||
+			0 != rename(tmp_path, async->spill_path)) {
+		goto out;
+	}
+	async->tail = head;
+out:
+	if (-1 != fd) {
+		close(fd);
+	}
+	if (tmp_path) {
+		unlink(tmp_path);
+	}
+	free(tmp_path);
+}
+
+/**
+ * Send the messages in the ring, advancing the tail past each one as soon
+ * as it has been written completely. If sending fails, the message that was
+ * cut off is sent again, from the start, once reconnected.
+ */
+static enum jal_status jalp_async_send_ring(struct jalp_async *async)
+{
+	uint64_t head = __atomic_load_n(&async->head, __ATOMIC_ACQUIRE);
+	uint64_t tail = async->tail;
+	uint64_t pos = tail;
+	uint64_t frame_end = tail + jalp_async_ring_frame_len(async, tail);
+	struct msghdr msgh;
+	struct iovec iov[2];
+
+	while (pos < head) {
+		uint64_t off = pos % async->size;
+		uint64_t len = head - pos;
+		uint64_t first = async->size - off < len ? async->size - off : len;
+		iov[0].iov_base = async->ring + off;
+		iov[0].iov_len = first;
+		iov[1].iov_base = async->ring;
+		iov[1].iov_len = len - first;
+
+		memset(&msgh, 0, sizeof(msgh));
+		msgh.msg_iov = iov;
+		msgh.msg_iovlen = len > first ? 2 : 1;
+		ssize_t n = sendmsg(async->ctx->socket, &msgh, JALP_ASYNC_SEND_FLAGS);
+		if (-1 == n) {
+			if (EINTR == errno) {
+				continue;
+			}
+			return JAL_E_NOT_CONNECTED;
+		}
+		pos += n;
+
+		uint64_t sent = 0;
+		while (frame_end <= pos) {
+			sent++;
+			tail = frame_end;
+			if (frame_end == head) {
+				break;
+			}
+			frame_end += jalp_async_ring_frame_len(async, frame_end);
+		}
+		if (sent) {
+			__atomic_store_n(&async->tail, tail, __ATOMIC_SEQ_CST);
+			__atomic_add_fetch(&async->sent, sent, __ATOMIC_RELAXED);
+			if (__atomic_load_n(&async->producer_waiting, __ATOMIC_SEQ_CST)) {
+				pthread_mutex_lock(&async->lock);
+				pthread_cond_broadcast(&async->space);
+				pthread_mutex_unlock(&async->lock);
+			}
+		}
+	}
+	return JAL_OK;
+}
+
+/**
+ * Send the oldest message in the spill file.
+ */
+static enum jal_status jalp_async_send_spill(struct jalp_async *async)
+{
+	uint8_t hdr[JALP_ASYNC_HEADER_LEN];
+	uint64_t frame_len = 0;
+
+	pthread_mutex_lock(&async->lock);
+	uint64_t off = async->spill_off;
+	uint64_t len = async->spill_len;
+	pthread_mutex_unlock(&async->lock);
+
+	if (0 != jalp_async_pread_all(async->spill_fd, hdr, sizeof(hdr), off) ||
+			0 != jalp_async_parse_header(hdr, &frame_len) ||
+			off + frame_len > len) {
+		goto err_io;
+	}
+	if (async->spill_buf_len < frame_len) {
+		async->spill_buf = jal_realloc(async->spill_buf, frame_len);
+		async->spill_buf_len = frame_len;
+	}
+	if (0 != jalp_async_pread_all(async->spill_fd, async->spill_buf, frame_len, off)) {
+		goto err_io;
+	}
+
+	struct iovec iov = { async->spill_buf, frame_len };
+	if (0 != jalp_async_send_all(async->ctx->socket, &iov, 1)) {
+		return JAL_E_NOT_CONNECTED;
+	}
+
+	pthread_mutex_lock(&async->lock);
+	async->spill_off += frame_len;
+	if (async->spill_off == async->spill_len) {
+		jalp_async_spill_reset(async);
+	}
+	pthread_mutex_unlock(&async->lock);
+	__atomic_add_fetch(&async->sent, 1, __ATOMIC_RELAXED);
+	return JAL_OK;
+
+err_io:
+	// The file can't be read back, so nothing after this point can be
+	// trusted either
+	pthread_mutex_lock(&async->lock);
+	jalp_async_spill_reset(async);
+	pthread_mutex_unlock(&async->lock);
+	__atomic_add_fetch(&async->dropped, 1, __ATOMIC_RELAXED);
+	return JAL_OK;
+}
+
+static void *jalp_async_run(void *arg)
+{
+	struct jalp_async *async = (struct jalp_async *) arg;
+	long retry_ms = JALP_ASYNC_MIN_RETRY_MS;
+	struct timespec ts;
+
+	pthread_mutex_lock(&async->lock);
+	while (!async->stop) {
+		int ring_empty = async->tail == __atomic_load_n(&async->head, __ATOMIC_SEQ_CST);
+		if (ring_empty && async->spill_off == async->spill_len) {
+			pthread_cond_broadcast(&async->drained);
+			// The producer checks flusher_idle after publishing a
+			// message, so either it sees the flag or this sees the
+			// message.
+			__atomic_store_n(&async->flusher_idle, 1, __ATOMIC_SEQ_CST);
+			if (async->tail == __atomic_load_n(&async->head, __ATOMIC_SEQ_CST)) {
+				pthread_cond_wait(&async->wake, &async->lock);
+			}
+			__atomic_store_n(&async->flusher_idle, 0, __ATOMIC_SEQ_CST);
+			continue;
+		}
+		pthread_mutex_unlock(&async->lock);
+
+		enum jal_status ret = JAL_OK;
+		if (-1 == async->ctx->socket) {
+			ret = jalp_context_connect(async->ctx);
+		}
+		if (JAL_OK == ret) {
+			// Everything in the ring is older than what is in the
+			// spill file
+			ret = ring_empty ? jalp_async_send_spill(async) : jalp_async_send_ring(async);
+		}
+
+		pthread_mutex_lock(&async->lock);
+		if (JAL_OK == ret) {
+			retry_ms = JALP_ASYNC_MIN_RETRY_MS;
+			continue;
+		}
+		jalp_context_disconnect(async->ctx);
+		async->failures++;
+		pthread_cond_broadcast(&async->drained);
+		if (!async->stop) {
+			jalp_async_deadline(retry_ms, &ts);
+			pthread_cond_timedwait(&async->wake, &async->lock, &ts);
+		}
+		retry_ms = retry_ms * 2 < JALP_ASYNC_MAX_RETRY_MS ? retry_ms * 2 : JALP_ASYNC_MAX_RETRY_MS;
+	}
+	pthread_cond_broadcast(&async->drained);
+	pthread_cond_broadcast(&async->space);
+	pthread_mutex_unlock(&async->lock);
+	return NULL;
+}
+
+static void jalp_async_free(struct jalp_async *async)
+{
+	if (-1 != async->spill_fd) {
+		close(async->spill_fd);
+	}
+	pthread_cond_destroy(&async->drained);
+	pthread_cond_destroy(&async->space);
+	pthread_cond_destroy(&async->wake);
+	pthread_mutex_destroy(&async->lock);
+	free(async->spill_path);
+	free(async->spill_buf);
+	free(async->ring);
+	free(async);
+}
+
+enum jal_status jalp_async_create(jalp_context *ctx, size_t queue_size,
+		enum jalp_async_overflow overflow, const char *spill_path,
+		struct jalp_async **out)
+{
+	enum jal_status ret;
+	pthread_condattr_t attr;
+
+	if (!ctx || 0 == queue_size || !out || *out) {
+		return JAL_E_INVAL;
+	}
+
+	struct jalp_async *async = jal_calloc(1, sizeof(*async));
+	async->ctx = ctx;
+	async->ring = jal_malloc(queue_size);
+	async->size = queue_size;
+	async->overflow = overflow;
+	async->spill_fd = -1;
+
+	pthread_mutex_init(&async->lock, NULL);
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	pthread_cond_init(&async->wake, &attr);
+	pthread_cond_init(&async->space, &attr);
+	pthread_cond_init(&async->drained, &attr);
+	pthread_condattr_destroy(&attr);
+
+	if (spill_path) {
+		ret = jalp_async_spill_open(async, spill_path);
+		if (JAL_OK != ret) {
+			goto err_out;
+		}
+	}
+
+	if (0 != pthread_create(&async->thread, NULL, jalp_async_run, async)) {
+		ret = JAL_E_INTERNAL_ERROR;
+		goto err_out;
+	}
+
+	*out = async;
+	return JAL_OK;
+
+err_out:
+	jalp_async_free(async);
+	return ret;
+}
+
+void jalp_async_destroy(struct jalp_async **pasync)
+{
+	if (!pasync || !*pasync) {
+		return;
+	}
+	struct jalp_async *async = *pasync;
+
+	enum jal_status ret = jalp_async_flush(async, JALP_ASYNC_DESTROY_TIMEOUT_MS);
+
+	pthread_mutex_lock(&async->lock);
+	async->stop = 1;
+	pthread_cond_signal(&async->wake);
+	pthread_mutex_unlock(&async->lock);
+	if (JAL_OK != ret && -1 != async->ctx->socket) {
+		// The flusher may be stuck writing to a Local Store that
+		// stopped reading.
+		shutdown(async->ctx->socket, SHUT_RDWR);
+	}
+	pthread_join(async->thread, NULL);
+
+	if (-1 != async->spill_fd) {
+		jalp_async_spill_save(async);
+	}
+	for (uint64_t pos = async->tail; pos < async->head;
+			pos += jalp_async_ring_frame_len(async, pos)) {
+		async->dropped++;
+	}
+
+	jalp_async_free(async);
+	*pasync = NULL;
+}
+
+int jalp_async_fits(struct jalp_async *async, uint64_t data_len, uint64_t meta_len)
+{
+	return jalp_async_frame_len(data_len, meta_len) <= async->size;
+}
+
+static int jalp_async_has_room(struct jalp_async *async, uint64_t frame_len)
+{
+	uint64_t tail = __atomic_load_n(&async->tail, __ATOMIC_SEQ_CST);
+	return async->head - tail + frame_len <= async->size;
+}
+
+static void jalp_async_push(struct jalp_async *async, struct iovec *iov, uint64_t frame_len)
+{
+	uint64_t pos = async->head;
+	for (int i = 0; i < JALP_ASYNC_FRAME_IOVS - 1; i++) {
+		if (0 == iov[i].iov_len) {
+			continue;
+		}
+		jalp_async_ring_write(async, pos, iov[i].iov_base, iov[i].iov_len);
+		pos += iov[i].iov_len;
+	}
+	__atomic_store_n(&async->head, async->head + frame_len, __ATOMIC_SEQ_CST);
+	__atomic_add_fetch(&async->queued, 1, __ATOMIC_RELAXED);
+
+	if (__atomic_load_n(&async->flusher_idle, __ATOMIC_SEQ_CST)) {
+		pthread_mutex_lock(&async->lock);
+		pthread_cond_signal(&async->wake);
+		pthread_mutex_unlock(&async->lock);
+	}
+}
+
+static enum jal_status jalp_async_spill(struct jalp_async *async, struct iovec *iov,
+		uint64_t frame_len)
+{
+	enum jal_status ret = JAL_OK;
+
+	pthread_mutex_lock(&async->lock);
+	if (0 != jalp_async_write_all(async->spill_fd, iov, JALP_ASYNC_FRAME_IOVS - 1)) {
+		// Don't leave part of a message behind
+		if (0 != ftruncate(async->spill_fd, async->spill_len)) {
+			jalp_async_spill_reset(async);
+		}
+		__atomic_add_fetch(&async->dropped, 1, __ATOMIC_RELAXED);
+		ret = JAL_E_FILE_IO;
+		goto out;
+	}
+	async->spill_len += frame_len;
+	__atomic_store_n(&async->spilling, 1, __ATOMIC_RELEASE);
+	__atomic_add_fetch(&async->spilled, 1, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&async->queued, 1, __ATOMIC_RELAXED);
+	pthread_cond_signal(&async->wake);
+out:
+	pthread_mutex_unlock(&async->lock);
+	return ret;
+}
+
+enum jal_status jalp_async_enqueue(struct jalp_async *async, uint16_t message_type,
+		const void *data, uint64_t data_len, const void *meta, uint64_t meta_len)
+{
+	uint8_t hdr[JALP_ASYNC_HEADER_LEN];
+	struct iovec iov[JALP_ASYNC_FRAME_IOVS];
+
+	if (!async || JALP_JOURNAL_FD_MSG == message_type) {
+		return JAL_E_INVAL;
+	}
+	uint64_t frame_len = jalp_async_fill_iov(iov, hdr, message_type,
+			data, data_len, meta, meta_len);
+	if (frame_len > async->size) {
+		return JAL_E_INVAL;
+	}
+
+	// Once records go to the spill file, they keep going there until the
+	// flusher has caught up, so they stay in order.
+	if (!__atomic_load_n(&async->spilling, __ATOMIC_ACQUIRE)) {
+		if (!jalp_async_has_room(async, frame_len) && JALP_ASYNC_BLOCK == async->overflow) {
+			pthread_mutex_lock(&async->lock);
+			__atomic_store_n(&async->producer_waiting, 1, __ATOMIC_SEQ_CST);
+			while (!jalp_async_has_room(async, frame_len) && !async->stop) {
+				pthread_cond_wait(&async->space, &async->lock);
+			}
+			__atomic_store_n(&async->producer_waiting, 0, __ATOMIC_SEQ_CST);
+			pthread_mutex_unlock(&async->lock);
+		}
+		if (jalp_async_has_room(async, frame_len)) {
+			jalp_async_push(async, iov, frame_len);
+			return JAL_OK;
+		}
+	}
+
+	if (JALP_ASYNC_SPILL == async->overflow) {
+		return jalp_async_spill(async, iov, frame_len);
+	}
+	__atomic_add_fetch(&async->dropped, 1, __ATOMIC_RELAXED);
+	return JAL_E_NO_MEM;
+}
+
+enum jal_status jalp_async_flush(struct jalp_async *async, long timeout_ms)
+{
+	enum jal_status ret = JAL_OK;
+	struct timespec deadline;
+
+	if (!async) {
+		return JAL_E_INVAL;
+	}
+	if (timeout_ms >= 0) {
+		jalp_async_deadline(timeout_ms, &deadline);
+	}
+
+	pthread_mutex_lock(&async->lock);
+	uint64_t failures = async->failures;
+	// Don't wait out a retry delay
+	pthread_cond_signal(&async->wake);
+	while (__atomic_load_n(&async->tail, __ATOMIC_SEQ_CST) !=
+				__atomic_load_n(&async->head, __ATOMIC_SEQ_CST) ||
+			async->spill_off != async->spill_len) {
+		if (async->failures != failures || async->stop) {
+			ret = JAL_E_NOT_CONNECTED;
+			break;
+		}
+		if (timeout_ms < 0) {
+			pthread_cond_wait(&async->drained, &async->lock);
+		} else if (ETIMEDOUT == pthread_cond_timedwait(&async->drained,
+					&async->lock, &deadline)) {
+			ret = JAL_E_NOT_CONNECTED;
+			break;
+		}
+	}
+	pthread_mutex_unlock(&async->lock);
+	return ret;
+}
+
+void jalp_async_get_stats(struct jalp_async *async, struct jalp_async_stats *stats)
+{
+	stats->queued = __atomic_load_n(&async->queued, __ATOMIC_RELAXED);
+	stats->sent = __atomic_load_n(&async->sent, __ATOMIC_RELAXED);
+	stats->dropped = __atomic_load_n(&async->dropped, __ATOMIC_RELAXED);
+	stats->spilled = __atomic_load_n(&async->spilled, __ATOMIC_RELAXED);
+}
+
+enum jal_status jalp_context_enable_async(jalp_context *ctx, size_t queue_size,
+		enum jalp_async_overflow overflow, const char *spill_path)
+{
+	if (!ctx) {
+		return JAL_E_INVAL;
+	}
+	if (!ctx->path || !ctx->hostname || !ctx->app_name) {
+		return JAL_E_UNINITIALIZED;
+	}
+	if (ctx->async) {
+		return JAL_E_INITIALIZED;
+	}
+
+	switch (overflow) {
+	case JALP_ASYNC_BLOCK:
+	case JALP_ASYNC_DROP_NEWEST:
+		if (spill_path) {
+			return JAL_E_INVAL;
+		}
+		break;
+	case JALP_ASYNC_SPILL:
+		if (!spill_path) {
+			return JAL_E_INVAL;
+		}
+		break;
+	default:
+		return JAL_E_INVAL;
+	}
+
+	if (0 == queue_size) {
+		queue_size = JALP_ASYNC_DEFAULT_QUEUE_SIZE;
+	}
+	return jalp_async_create(ctx, queue_size, overflow, spill_path, &ctx->async);
+}
+
+enum jal_status jalp_context_flush(jalp_context *ctx, long timeout_ms)
+{
+	if (!ctx) {
+		return JAL_E_INVAL;
+	}
+	if (!ctx->async) {
+		return JAL_OK;
+	}
+	return jalp_async_flush(ctx->async, timeout_ms);
+}
+
+enum jal_status jalp_context_get_async_stats(jalp_context *ctx,
+		struct jalp_async_stats *stats)
+{
+	if (!ctx || !stats) {
+		return JAL_E_INVAL;
+	}
+	if (!ctx->async) {
+		memset(stats, 0, sizeof(*stats));
+		return JAL_OK;
+	}
+	jalp_async_get_stats(ctx->async, stats);
+	return JAL_OK;
+}
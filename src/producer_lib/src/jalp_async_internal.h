@@ -0,0 +1,131 @@
+/**
+ * @file jalp_async_internal.h This file defines the private functions used
+ * to queue records and send them from a background thread.
+ *
+ * @section LICENSE
+ *
+ * Source code in 3rd-party is licensed and owned by their respective
+ * copyright holders.
+ *
+ * All other source code is copyright Tresys Technology and licensed as below.
+ *
+ * Copyright (c) 2012 Tresys Technology LLC, Columbia, Maryland, USA
+ *
+ * This software was developed by Tresys Technology LLC
+ * with U.S. Government sponsorship.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef _JALP_ASYNC_INTERNAL_H_
+#define _JALP_ASYNC_INTERNAL_H_
+
+#include <stdint.h>
+#include <jalop/jal_status.h>
+#include <jalop/jalp_context.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * How long #jalp_async_destroy waits for the queue to drain.
+ */
+#define JALP_ASYNC_DESTROY_TIMEOUT_MS 5000
+
+/**
+ * The send queue of an asynchronous #jalp_context.
+ *
+ * Messages are copied into a ring buffer in the same format they are sent
+ * in, so the background thread can write any number of them with a single
+ * sendmsg(). There is one writer, the thread using the jalp_context, and
+ * one reader, the background thread, so the ring itself needs no lock.
+ */
+struct jalp_async;
+
+/**
+ * Create the queue and start the background thread.
+ *
+ * @param[in] ctx The context the background thread sends with.
+ * @param[in] queue_size The size of the ring buffer in bytes.
+ * @param[in] overflow What to do when the ring buffer is full.
+ * @param[in] spill_path The spill file, for #JALP_ASYNC_SPILL.
+ * @param[out] async The new queue.
+ *
+ * @return JAL_OK, JAL_E_FILE_OPEN if the spill file could not be opened, or
+ * JAL_E_INTERNAL_ERROR if the thread could not be started.
+ */
+enum jal_status jalp_async_create(jalp_context *ctx, size_t queue_size,
+		enum jalp_async_overflow overflow, const char *spill_path,
+		struct jalp_async **async);
+
+/**
+ * Wait up to #JALP_ASYNC_DESTROY_TIMEOUT_MS for the queue to drain, then
+ * stop the background thread. Messages that were not sent are moved to the
+ * spill file, if there is one.
+ *
+ * @param[in,out] async The queue to destroy. Set to NULL.
+ */
+void jalp_async_destroy(struct jalp_async **async);
+
+/**
+ * Check whether a message fits in the queue at all.
+ *
+ * @param[in] async The queue.
+ * @param[in] data_len The length of the data record.
+ * @param[in] meta_len The length of the application metadata document.
+ *
+ * @return 1 if it fits in an empty queue, 0 otherwise.
+ */
+int jalp_async_fits(struct jalp_async *async, uint64_t data_len, uint64_t meta_len);
+
+/**
+ * Queue a message. Messages that carry a file descriptor cannot be queued.
+ *
+ * @param[in] async The queue.
+ * @param[in] message_type The #jalp_connection_msg_type of the message.
+ * @param[in] data The data record.
+ * @param[in] data_len The length of the data record.
+ * @param[in] meta The application metadata document.
+ * @param[in] meta_len The length of the application metadata document.
+ *
+ * @return JAL_OK if the message was queued or spilled, JAL_E_NO_MEM if it
+ * was dropped because the queue was full, or JAL_E_FILE_IO if it could
+ * not be written to the spill file.
+ */
+enum jal_status jalp_async_enqueue(struct jalp_async *async, uint16_t message_type,
+		const void *data, uint64_t data_len, const void *meta, uint64_t meta_len);
+
+/**
+ * Wait until the queue and the spill file are empty.
+ *
+ * @param[in] async The queue.
+ * @param[in] timeout_ms The longest to wait, or a negative number to wait
+ * until the Local Store cannot be reached.
+ *
+ * @return JAL_OK, or JAL_E_NOT_CONNECTED if messages are still queued.
+ */
+enum jal_status jalp_async_flush(struct jalp_async *async, long timeout_ms);
+
+/**
+ * Get the record counts of the queue.
+ *
+ * @param[in] async The queue.
+ * @param[out] stats The counts.
+ */
+void jalp_async_get_stats(struct jalp_async *async, struct jalp_async_stats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _JALP_ASYNC_INTERNAL_H_
@@ -82,8 +82,8 @@ enum jal_status jalp_audit(jalp_context *ctx,
 	// If schema validation has been requested, do it here
 	if(flags & JAF_VALIDATE_XML)
 	{
-		// If the schema context is not already cached
-		if(!ctx->jaf_validCtxt)
+		// If the schema is not already compiled
+		if(!jalp_schema_loaded(ctx))
 		{
 			jal_asprintf(&eventList_schema, "%s/" XML_JAF_SCHEMA_NEW, ctx->schema_root);
 
@@ -112,12 +112,10 @@ enum jal_status jalp_audit(jalp_context *ctx,
 				event_schema = NULL;
 			}
 		}
-		else // always validate xml if the JAF_VALIDATE_XML is set...schema context is cached
+		else // always validate xml if the JAF_VALIDATE_XML is set...schema is compiled
 		{
-			// validate the xml document..0 == ok else error
-			int ret = xmlSchemaValidateDoc(ctx->jaf_validCtxt, validated_doc);
-			if (ret != 0) {
-				status = JAL_E_XML_PARSE;
+			status = jalp_validate_xml(ctx, validated_doc, NULL);
+			if (status != JAL_OK) {
 				goto out;
 			}
 		}
@@ -170,7 +168,7 @@ enum jal_status jalp_audit(jalp_context *ctx,
 		}
 		if (ctx->signing_key) {
 			const xmlChar *id = xmlGetProp(app_meta_elem, (xmlChar *)JALP_XML_JID);
-			status = jal_add_signature_block(ctx->signing_key, ctx->signing_cert, doc, last_elem, (char *)id);
+			status = jal_sign_pool_add_signature_block(ctx->signing_pool, doc, last_elem, (char *)id);
 			xmlFree((void*)id);
 			if (status != JAL_OK) {
 				goto out;
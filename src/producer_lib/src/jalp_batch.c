@@ -0,0 +1,206 @@
+/**
+ * @file jalp_batch.c This file contains functions to collect log and audit
+ * records and send them to the JALoP Local Store in batch messages.
+ *
+ * @section LICENSE
+ *
+ * Source code in 3rd-party is licensed and owned by their respective
+ * copyright holders.
+ *
+ * All other source code is copyright Tresys Technology and licensed as below.
+ *
+ * Copyright (c) 2012 Tresys Technology LLC, Columbia, Maryland, USA
+ *
+ * This software was developed by Tresys Technology LLC
+ * with U.S. Government sponsorship.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <jalop/jal_status.h>
+#include "jal_alloc.h"
+#include "jalp_batch_internal.h"
+#include "jalp_connection_internal.h"
+#include "jalp_context_internal.h"
+
+#define JALP_BATCH_INITIAL_SIZE 4096
+
+struct jalp_batch {
+	uint8_t *table;		//!< The batch header followed by the record lengths
+	size_t table_len;
+	uint8_t *records;	//!< The data and metadata of each record
+	size_t records_len;
+	size_t records_cap;
+	uint32_t count;
+};
+
+static void jalp_batch_reset(struct jalp_batch *batch)
+{
+	batch->table_len = JALP_BATCH_HEADER_LEN;
+	batch->records_len = 0;
+	batch->count = 0;
+}
+
+static struct jalp_batch *jalp_batch_create()
+{
+	struct jalp_batch *batch = jal_calloc(1, sizeof(*batch));
+	batch->table = jal_malloc(JALP_BATCH_HEADER_LEN +
+			JALP_BATCH_MAX_RECORDS * JALP_BATCH_ENTRY_LEN);
+	jalp_batch_reset(batch);
+	return batch;
+}
+
+static void jalp_batch_destroy(struct jalp_batch **batch)
+{
+	if (!batch || !*batch) {
+		return;
+	}
+	free((*batch)->table);
+	free((*batch)->records);
+	free(*batch);
+	*batch = NULL;
+}
+
+static void jalp_batch_append(struct jalp_batch *batch, const void *buf, uint64_t len)
+{
+	if (0 == len) {
+		return;
+	}
+	if (batch->records_cap - batch->records_len < len) {
+		size_t cap = batch->records_cap ? batch->records_cap : JALP_BATCH_INITIAL_SIZE;
+		while (cap - batch->records_len < len) {
+			cap *= 2;
+		}
+		batch->records = jal_realloc(batch->records, cap);
+		batch->records_cap = cap;
+	}
+	memcpy(batch->records + batch->records_len, buf, len);
+	batch->records_len += len;
+}
+
+enum jal_status jalp_batch_add(jalp_context *ctx, uint16_t message_type,
+		const void *data, uint64_t data_len, const void *meta, uint64_t meta_len)
+{
+	enum jal_status status = JAL_OK;
+	uint8_t entry[JALP_BATCH_ENTRY_LEN];
+
+	if (!ctx || !ctx->batch ||
+			(JALP_LOG_MSG != message_type && JALP_AUDIT_MSG != message_type)) {
+		return JAL_E_INVAL;
+	}
+	struct jalp_batch *batch = ctx->batch;
+
+	if (JALP_BATCH_MAX_RECORDS == batch->count || (batch->count > 0 &&
+			JALP_BATCH_MAX_BYTES - batch->records_len < data_len + meta_len)) {
+		status = jalp_batch_send(ctx);
+	}
+
+	memset(entry, 0, sizeof(entry));
+	memcpy(entry, &message_type, sizeof(message_type));
+	memcpy(entry + 8, &data_len, sizeof(data_len));
+	memcpy(entry + 16, &meta_len, sizeof(meta_len));
+	memcpy(batch->table + batch->table_len, entry, sizeof(entry));
+	batch->table_len += sizeof(entry);
+	jalp_batch_append(batch, data, data_len);
+	jalp_batch_append(batch, meta, meta_len);
+	batch->count++;
+
+	return status;
+}
+
+enum jal_status jalp_batch_send(jalp_context *ctx)
+{
+	enum jal_status status = JAL_OK;
+	uint8_t *buf = NULL;
+
+	if (!ctx || !ctx->batch) {
+		return JAL_E_INVAL;
+	}
+	struct jalp_batch *batch = ctx->batch;
+
+	if (0 == batch->count) {
+		return JAL_OK;
+	}
+
+	if (1 == batch->count) {
+		// Nothing to gain from a batch of one
+		uint16_t message_type;
+		uint64_t data_len;
+		uint64_t meta_len;
+		const uint8_t *entry = batch->table + JALP_BATCH_HEADER_LEN;
+		memcpy(&message_type, entry, sizeof(message_type));
+		memcpy(&data_len, entry + 8, sizeof(data_len));
+		memcpy(&meta_len, entry + 16, sizeof(meta_len));
+		status = jalp_send_unbatched(ctx, message_type,
+				data_len ? batch->records : NULL, data_len,
+				meta_len ? batch->records + data_len : NULL, meta_len, -1);
+		goto out;
+	}
+
+	uint16_t version = JALP_BATCH_VERSION;
+	uint16_t reserved = 0;
+	memcpy(batch->table, &version, sizeof(version));
+	memcpy(batch->table + 2, &reserved, sizeof(reserved));
+	memcpy(batch->table + 4, &batch->count, sizeof(batch->count));
+
+	buf = jal_malloc(batch->table_len + batch->records_len);
+	memcpy(buf, batch->table, batch->table_len);
+	memcpy(buf + batch->table_len, batch->records, batch->records_len);
+	status = jalp_send_unbatched(ctx, JALP_BATCH_MSG, buf,
+			batch->table_len + batch->records_len, NULL, 0, -1);
+
+out:
+	free(buf);
+	jalp_batch_reset(batch);
+	return status;
+}
+
+enum jal_status jalp_context_begin_batch(jalp_context *ctx)
+{
+	if (!ctx) {
+		return JAL_E_INVAL;
+	}
+	if (!ctx->path || !ctx->hostname || !ctx->app_name) {
+		return JAL_E_UNINITIALIZED;
+	}
+	enum jal_status status = JAL_OK;
+	pthread_mutex_lock(&ctx->send_lock);
+	if (ctx->batch) {
+		status = JAL_E_INITIALIZED;
+	} else {
+		__atomic_store_n(&ctx->batch, jalp_batch_create(), __ATOMIC_RELEASE);
+	}
+	pthread_mutex_unlock(&ctx->send_lock);
+	return status;
+}
+
+enum jal_status jalp_context_end_batch(jalp_context *ctx)
+{
+	if (!ctx) {
+		return JAL_E_INVAL;
+	}
+	pthread_mutex_lock(&ctx->send_lock);
+	if (!ctx->batch) {
+		pthread_mutex_unlock(&ctx->send_lock);
+		return JAL_E_INVAL;
+	}
+	enum jal_status status = jalp_batch_send(ctx);
+	struct jalp_batch *batch = ctx->batch;
+	__atomic_store_n(&ctx->batch, NULL, __ATOMIC_RELEASE);
+	pthread_mutex_unlock(&ctx->send_lock);
+	jalp_batch_destroy(&batch);
+	return status;
+}
@@ -0,0 +1,98 @@
+/**
+ * @file jalp_batch_internal.h This file defines the private functions used
+ * to collect log and audit records into batch messages.
+ *
+ * @section LICENSE
+ *
+ * Source code in 3rd-party is licensed and owned by their respective
+ * copyright holders.
+ *
+ * All other source code is copyright Tresys Technology and licensed as below.
+ *
+ * Copyright (c) 2012 Tresys Technology LLC, Columbia, Maryland, USA
+ *
+ * This software was developed by Tresys Technology LLC
+ * with U.S. Government sponsorship.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef _JALP_BATCH_INTERNAL_H_
+#define _JALP_BATCH_INTERNAL_H_
+
+#include <stdint.h>
+#include <jalop/jal_status.h>
+#include <jalop/jalp_context.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * A batch message carries several log or audit records in the data section
+ * of one #JALP_BATCH_MSG message, with no application metadata section.
+ * The data section is laid out as follows, in host byte order:
+ *
+ *   uint16_t version          JALP_BATCH_VERSION
+ *   uint16_t reserved         0
+ *   uint32_t count            number of records
+ *   count times:
+ *     uint16_t message_type   JALP_LOG_MSG or JALP_AUDIT_MSG
+ *     uint16_t reserved       0
+ *     uint32_t reserved       0
+ *     uint64_t data_len
+ *     uint64_t meta_len
+ *   count times:
+ *     data_len bytes of data, then meta_len bytes of application metadata
+ *
+ * This must match jalls_batch.h in the local store.
+ */
+#define JALP_BATCH_VERSION 1
+#define JALP_BATCH_HEADER_LEN 8
+#define JALP_BATCH_ENTRY_LEN 24
+
+/**
+ * The records collected by #jalp_context_begin_batch.
+ */
+struct jalp_batch;
+
+/**
+ * Add a message to the batch of \p ctx, sending the batch first if the
+ * message would not fit.
+ *
+ * @param[in] ctx The context, which has a batch, with send_lock held.
+ * @param[in] message_type JALP_LOG_MSG or JALP_AUDIT_MSG.
+ * @param[in] data The data record.
+ * @param[in] data_len The length of the data record.
+ * @param[in] meta The application metadata document.
+ * @param[in] meta_len The length of the application metadata document.
+ *
+ * @return JAL_OK, or the error from sending the full batch.
+ */
+enum jal_status jalp_batch_add(jalp_context *ctx, uint16_t message_type,
+		const void *data, uint64_t data_len, const void *meta, uint64_t meta_len);
+
+/**
+ * Send the records in the batch of \p ctx and empty it. The records are
+ * dropped if they cannot be sent.
+ *
+ * @param[in] ctx The context, which has a batch, with send_lock held.
+ *
+ * @return JAL_OK, or the error from jalp_send_unbatched().
+ */
+enum jal_status jalp_batch_send(jalp_context *ctx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _JALP_BATCH_INTERNAL_H_
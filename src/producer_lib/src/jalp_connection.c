@@ -35,8 +35,11 @@
 #include <jalop/jal_status.h>
 #include <jalop/jal_version.h>
 #include "jal_alloc.h"
+#include "jalp_async_internal.h"
+#include "jalp_batch_internal.h"
 #include "jalp_connection_internal.h"
 #include "jalp_context_internal.h"
+#include "jalp_shm_internal.h"
 
 struct jalp_connection_headers *jalp_connection_headers_create(uint16_t message_type,
 		uint64_t data_len, uint64_t meta_len)
@@ -157,7 +160,10 @@ enum jal_status jalp_sendmsg(jalp_context *ctx, struct msghdr *msgh)
 	return JAL_OK;
 }
 
-enum jal_status jalp_send_buffer(jalp_context *ctx, uint16_t message_type,
+/**
+ * Send a message on the socket, or through the ring, of one connection.
+ */
+static enum jal_status jalp_send_direct(jalp_context *conn, uint16_t message_type,
 		void *data, uint64_t data_len, void *meta, uint64_t meta_len, int fd)
 {
 	struct jalp_connection_headers *connection_headers = NULL;
@@ -173,9 +179,114 @@ enum jal_status jalp_send_buffer(jalp_context *ctx, uint16_t message_type,
 	msgh.msg_iovlen = iovlen;
 	msgh.msg_iov = iov;
 
+	// if we are not connected, try to connect
+	if (conn->socket == -1) {
+		status = jalp_context_connect(conn);
+		if (status != JAL_OK) {
+			status = JAL_E_NOT_CONNECTED;
+			goto out;
+		}
+	}
+
+
+	// An asynchronous context only uses the socket
+	if (!conn->async && conn->shm) {
+		if (message_type != JALP_JOURNAL_MSG && message_type != JALP_JOURNAL_FD_MSG &&
+				jalp_shm_fits(conn->shm, data_len, meta_len)) {
+			status = jalp_shm_send(conn, message_type,
+					data, data_len, meta, meta_len);
+			goto out;
+		}
+		// Let the Local Store take everything out of the ring
+		// before it reads the socket, so records stay in order
+		status = jalp_shm_drain(conn);
+		if (status != JAL_OK) {
+			goto out;
+		}
+	}
+
+	connection_headers = jalp_connection_headers_create(message_type, data_len, meta_len);
+
+	status = jalp_connection_fill_out_msghdr(iov, connection_headers, data, meta);
+	if (status != JAL_OK) {
+		status = JAL_E_NOT_CONNECTED;
+		goto out;
+	}
+
+
+	// also send fd if this is a journal fd message
+	if (message_type == JALP_JOURNAL_FD_MSG) {
+		// this code is from man 3 cmsg
+		struct cmsghdr *cmsg;
+		int *fdptr;
+
+		msgh.msg_control = buffer;
+		msgh.msg_controllen = sizeof(buffer);
+
+		cmsg = CMSG_FIRSTHDR(&msgh);
+		cmsg->cmsg_level = SOL_SOCKET;
+		cmsg->cmsg_type = SCM_RIGHTS;
+		cmsg->cmsg_len = CMSG_LEN(sizeof(fd));
+		fdptr = (int *) CMSG_DATA(cmsg);
+		memcpy(fdptr, &fd, sizeof(fd));
+		msgh.msg_controllen = cmsg->cmsg_len;
+	}
+
+
+	status = jalp_sendmsg(conn, &msgh);
+
+out:
+	jalp_connection_headers_destroy(&connection_headers);
+	return status;
+}
+
+/**
+ * Send a message on a connection no other thread is using.
+ */
+static enum jal_status jalp_send_pooled(jalp_context *ctx, uint16_t message_type,
+		void *data, uint64_t data_len, void *meta, uint64_t meta_len, int fd)
+{
+	jalp_context *conn = jalp_context_get_conn(ctx);
+	enum jal_status status = jalp_send_direct(conn, message_type,
+			data, data_len, meta, meta_len, fd);
+	jalp_context_put_conn(ctx, conn);
+	return status;
+}
+
+enum jal_status jalp_send_unbatched(jalp_context *ctx, uint16_t message_type,
+		void *data, uint64_t data_len, void *meta, uint64_t meta_len, int fd)
+{
+	enum jal_status status;
+
+	if (!ctx->async) {
+		return jalp_send_pooled(ctx, message_type,
+				data, data_len, meta, meta_len, fd);
+	}
+
+	if (message_type != JALP_JOURNAL_FD_MSG &&
+			jalp_async_fits(ctx->async, data_len, meta_len)) {
+		return jalp_async_enqueue(ctx->async, message_type,
+				data, data_len, meta, meta_len);
+	}
+	// The background thread owns the socket until it has sent
+	// everything queued before this message
+	status = jalp_async_flush(ctx->async, -1);
+	if (status != JAL_OK) {
+		return status;
+	}
+	return jalp_send_direct(ctx, message_type,
+			data, data_len, meta, meta_len, fd);
+}
+
+enum jal_status jalp_send_buffer(jalp_context *ctx, uint16_t message_type,
+		void *data, uint64_t data_len, void *meta, uint64_t meta_len, int fd)
+{
+	enum jal_status status;
+
 	// make sure message type is one of the allowed ones
 	if (message_type != JALP_LOG_MSG && message_type != JALP_AUDIT_MSG &&
-			message_type != JALP_JOURNAL_MSG && message_type != JALP_JOURNAL_FD_MSG) {
+			message_type != JALP_JOURNAL_MSG && message_type != JALP_JOURNAL_FD_MSG &&
+			message_type != JALP_BATCH_MSG) {
 		status = JAL_E_INVAL;
 		goto out;
 	}
@@ -225,48 +336,33 @@ enum jal_status jalp_send_buffer(jalp_context *ctx, uint16_t message_type,
 		goto out;
 	}
 
-	// if we are not connected, try to connect
-	if (ctx->socket == -1) {
-		status = jalp_context_connect(ctx);
-		if (status != JAL_OK) {
-			status = JAL_E_NOT_CONNECTED;
-			goto out;
-		}
-	}
-
-
-	connection_headers = jalp_connection_headers_create(message_type, data_len, meta_len);
-
-	status = jalp_connection_fill_out_msghdr(iov, connection_headers, data, meta);
-	if (status != JAL_OK) {
-		status = JAL_E_NOT_CONNECTED;
+	// Without a batch or a background thread, each thread sends on a
+	// connection of its own and nothing is shared.
+	if (!__atomic_load_n(&ctx->batch, __ATOMIC_ACQUIRE) && !ctx->async) {
+		status = jalp_send_pooled(ctx, message_type,
+				data, data_len, meta, meta_len, fd);
 		goto out;
 	}
 
-
-	// also send fd if this is a journal fd message
-	if (message_type == JALP_JOURNAL_FD_MSG) {
-		// this code is from man 3 cmsg
-		struct cmsghdr *cmsg;
-		int *fdptr;
-
-		msgh.msg_control = buffer;
-		msgh.msg_controllen = sizeof(buffer);
-
-		cmsg = CMSG_FIRSTHDR(&msgh);
-		cmsg->cmsg_level = SOL_SOCKET;
-		cmsg->cmsg_type = SCM_RIGHTS;
-		cmsg->cmsg_len = CMSG_LEN(sizeof(fd));
-		fdptr = (int *) CMSG_DATA(cmsg);
-		memcpy(fdptr, &fd, sizeof(fd));
-		msgh.msg_controllen = cmsg->cmsg_len;
+	pthread_mutex_lock(&ctx->send_lock);
+	if (ctx->batch) {
+		if (message_type == JALP_LOG_MSG || message_type == JALP_AUDIT_MSG) {
+			status = jalp_batch_add(ctx, message_type,
+					data, data_len, meta, meta_len);
+			goto unlock;
+		}
+		// Send what was collected first, so records stay in order
+		status = jalp_batch_send(ctx);
+		if (status != JAL_OK) {
+			goto unlock;
+		}
 	}
-
-
-	status = jalp_sendmsg(ctx, &msgh);
+	status = jalp_send_unbatched(ctx, message_type,
+			data, data_len, meta, meta_len, fd);
+unlock:
+	pthread_mutex_unlock(&ctx->send_lock);
 
 out:
-	jalp_connection_headers_destroy(&connection_headers);
 	return status;
 
 }
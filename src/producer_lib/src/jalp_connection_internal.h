@@ -53,6 +53,8 @@ enum jalp_connection_msg_type {
 	JALP_AUDIT_MSG = 2,
 	JALP_JOURNAL_MSG = 3,
 	JALP_JOURNAL_FD_MSG = 4,
+	JALP_BATCH_MSG = 5,
+	JALP_SHM_SETUP_MSG = 6,
 };
 
 /**
@@ -165,6 +167,20 @@ enum jal_status jalp_sendmsg(jalp_context *ctx, struct msghdr *msgh);
 enum jal_status jalp_send_buffer(jalp_context *ctx, uint16_t message_type,
 		void *data, uint64_t data_len, void *meta, uint64_t meta_len, int fd);
 
+/**
+ * Send a message without adding it to the batch of \p ctx. The message is
+ * queued for the background thread if \p ctx is asynchronous, and sent on
+ * a connection from jalp_context_get_conn() otherwise.
+ *
+ * @param[in] ctx The context, with send_lock held if it has a batch or a
+ * background thread.
+ *
+ * The other parameters and the return value are the same as
+ * jalp_send_buffer(), which has already checked them.
+ */
+enum jal_status jalp_send_unbatched(jalp_context *ctx, uint16_t message_type,
+		void *data, uint64_t data_len, void *meta, uint64_t meta_len, int fd);
+
 #ifdef __cplusplus
 }
 #endif
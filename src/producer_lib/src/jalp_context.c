@@ -42,8 +42,11 @@
 #include <jalop/jalp_context.h>
 #include "jal_alloc.h"
 #include "jal_asprintf_internal.h"
+#include "jalp_async_internal.h"
 #include "jalp_config_internal.h"
 #include "jalp_context_internal.h"
+#include "jalp_shm_internal.h"
+#include "jal_xml_utils.h"
 
 
 jalp_context *jalp_context_create(void)
@@ -56,12 +59,16 @@ jalp_context *jalp_context_create(void)
 	}
 
 	context->socket = -1;
+	pthread_mutex_init(&context->pool_lock, NULL);
+	pthread_cond_init(&context->conn_free, NULL);
+	pthread_mutex_init(&context->send_lock, NULL);
 	return context;
 }
 
 void jalp_context_disconnect(jalp_context *ctx)
 {
 	if (ctx) {
+		jalp_shm_destroy(&ctx->shm);
 		close(ctx->socket);
 		ctx->socket = -1;
 	}
@@ -73,7 +80,16 @@ void jalp_context_destroy(jalp_context **ctx)
 		return;
 	}
 
+	if ((*ctx)->batch) {
+		jalp_context_end_batch(*ctx);
+	}
+	jalp_async_destroy(&(*ctx)->async);
 	jalp_context_disconnect(*ctx);
+	while ((*ctx)->idle_conns) {
+		jalp_context *conn = (*ctx)->idle_conns;
+		(*ctx)->idle_conns = conn->next_conn;
+		jalp_context_destroy(&conn);
+	}
 
 	jal_digest_ctx_destroy(&(*ctx)->digest_ctx);
 	free((*ctx)->path);
@@ -81,8 +97,15 @@ void jalp_context_destroy(jalp_context **ctx)
 	free((*ctx)->app_name);
 	RSA_free((*ctx)->signing_key);
 	X509_free((*ctx)->signing_cert);
+	jal_sign_pool_destroy(&(*ctx)->signing_pool);
 	free((*ctx)->schema_root);
-	xmlSchemaFreeValidCtxt((*ctx)->jaf_validCtxt);
+	for (int i = 0; i < (*ctx)->idle_valid_ctxt_count; i++) {
+		xmlSchemaFreeValidCtxt((*ctx)->idle_valid_ctxts[i]);
+	}
+	xmlSchemaFree((*ctx)->jaf_schema);
+	pthread_mutex_destroy(&(*ctx)->send_lock);
+	pthread_cond_destroy(&(*ctx)->conn_free);
+	pthread_mutex_destroy(&(*ctx)->pool_lock);
 	free(*ctx);
 	*ctx = NULL;
 }
@@ -152,31 +175,16 @@ enum jal_status jalp_context_init(jalp_context *ctx, const char *path,
 #endif /* JALP_HAVE_PROCFS */
 		ctx->app_name = abspath;
 	}
-	ctx->jaf_validCtxt = NULL;
 	ctx->flags = 0;
 
 	return JAL_OK;
 }
 
-enum jal_status jalp_context_connect(jalp_context *ctx)
+static enum jal_status jalp_context_open_socket(jalp_context *ctx)
 {
 	int err;
 	struct sockaddr_un sock_addr;
 
-	if (!ctx) {
-		return JAL_E_INVAL;
-	}
-
-	// make sure the context has been initialized
-	if (!ctx->path || !ctx->hostname || !ctx->app_name) {
-		return JAL_E_UNINITIALIZED;
-	}
-
-	// close the socket in case it is already open
-	if (ctx->socket != -1) {
-		jalp_context_disconnect(ctx);
-	}
-
 	ctx->socket = socket(AF_UNIX, SOCK_STREAM, 0);
 	if (ctx->socket == -1) {
 		goto err_out;
@@ -203,6 +211,81 @@ err_out:
 	jalp_context_disconnect(ctx);
 	return JAL_E_NOT_CONNECTED;
 }
+
+enum jal_status jalp_context_connect(jalp_context *ctx)
+{
+	enum jal_status ret;
+
+	if (!ctx) {
+		return JAL_E_INVAL;
+	}
+
+	// make sure the context has been initialized
+	if (!ctx->path || !ctx->hostname || !ctx->app_name) {
+		return JAL_E_UNINITIALIZED;
+	}
+
+	// close the socket in case it is already open
+	if (ctx->socket != -1) {
+		jalp_context_disconnect(ctx);
+	}
+
+	ret = jalp_context_open_socket(ctx);
+	if (JAL_OK != ret || 0 == ctx->shm_ring_size) {
+		return ret;
+	}
+
+	// A Local Store that does not know about the ring hangs up on it
+	if (JAL_E_NOT_CONNECTED == jalp_shm_setup(ctx)) {
+		jalp_context_disconnect(ctx);
+		ret = jalp_context_open_socket(ctx);
+	}
+	return ret;
+}
+
+jalp_context *jalp_context_get_conn(jalp_context *ctx)
+{
+	jalp_context *conn = NULL;
+
+	pthread_mutex_lock(&ctx->pool_lock);
+	while (ctx->conn_busy && !ctx->idle_conns &&
+			ctx->extra_conns >= JALP_CONTEXT_MAX_CONNECTIONS - 1) {
+		pthread_cond_wait(&ctx->conn_free, &ctx->pool_lock);
+	}
+	if (!ctx->conn_busy) {
+		ctx->conn_busy = 1;
+		conn = ctx;
+	} else if (ctx->idle_conns) {
+		conn = ctx->idle_conns;
+		ctx->idle_conns = conn->next_conn;
+		conn->next_conn = NULL;
+	} else {
+		ctx->extra_conns++;
+	}
+	pthread_mutex_unlock(&ctx->pool_lock);
+
+	if (!conn) {
+		// Only used to send, so it needs no keys or schemas
+		conn = jalp_context_create();
+		jalp_context_init(conn, ctx->path, ctx->hostname, ctx->app_name, ctx->schema_root);
+		conn->shm_ring_size = ctx->shm_ring_size;
+	}
+	return conn;
+}
+
+void jalp_context_put_conn(jalp_context *ctx, jalp_context *conn)
+{
+	pthread_mutex_lock(&ctx->pool_lock);
+	if (conn == ctx) {
+		ctx->conn_busy = 0;
+	} else {
+		conn->next_conn = ctx->idle_conns;
+		ctx->idle_conns = conn;
+	}
+	pthread_cond_signal(&ctx->conn_free);
+	pthread_mutex_unlock(&ctx->pool_lock);
+}
+
 enum jal_status jalp_context_set_digest_callbacks(jalp_context *ctx,
 		const struct jal_digest_ctx *digest_ctx)
 {
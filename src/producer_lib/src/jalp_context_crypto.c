@@ -33,6 +33,21 @@
 #include <jalop/jal_status.h>
 #include <jalop/jalp_context.h>
 #include "jalp_context_internal.h"
+#include "jal_xml_utils.h"
+
+/*
+ * Load the key and certificate into a new signing context pool, so the
+ * records that follow don't each have to load them.
+ */
+static enum jal_status jalp_context_reset_signing_pool(jalp_context *ctx)
+{
+	jal_sign_pool_destroy(&ctx->signing_pool);
+	if (!ctx->signing_key) {
+		return JAL_OK;
+	}
+	ctx->signing_pool = jal_sign_pool_create(ctx->signing_key, ctx->signing_cert);
+	return ctx->signing_pool ? JAL_OK : JAL_E_INVAL;
+}
 
 enum jal_status jalp_context_load_pem_rsa(jalp_context *ctx,
 		const char *keyfile,
@@ -58,7 +73,7 @@ enum jal_status jalp_context_load_pem_rsa(jalp_context *ctx,
 		return JAL_E_READ_PRIVKEY;
 	}
 	ctx->signing_key = key;
-	return JAL_OK;
+	return jalp_context_reset_signing_pool(ctx);
 }
 
 enum jal_status jalp_context_load_pem_cert(jalp_context *ctx,
@@ -84,5 +99,5 @@ enum jal_status jalp_context_load_pem_cert(jalp_context *ctx,
 		X509_free(ctx->signing_cert);
 	}
 	ctx->signing_cert = cert;
-	return JAL_OK;
+	return jalp_context_reset_signing_pool(ctx);
 }
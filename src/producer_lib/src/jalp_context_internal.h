@@ -29,6 +29,7 @@
 #ifndef _JALP_CONTEXT_INTERNAL_H_
 #define _JALP_CONTEXT_INTERNAL_H_
 
+#include <pthread.h>
 #include <libxml/tree.h>
 #include <libxml/xmlschemas.h>
 
@@ -40,6 +41,16 @@
 extern "C" {
 #endif
 
+/**
+ * The most connections to the JALoP Local Store a context opens for
+ * threads sending at the same time. Other threads wait for one of them.
+ */
+#define JALP_CONTEXT_MAX_CONNECTIONS 16
+
+struct jalp_async;
+struct jalp_batch;
+struct jalp_shm;
+
 struct jalp_context_t {
 	int socket; /**< The socket used to communicate with the JALoP Local Store */
 	char *path; /**< The path that was originally used to connect to the socket */
@@ -49,8 +60,30 @@ struct jalp_context_t {
 	struct jal_digest_ctx *digest_ctx; /**< The registered callback functions to use when creating a digest */
 	RSA *signing_key; /**< The RSA private key to use when signing application metadata documents */
 	X509 *signing_cert; /**< The certificate used for signing the application metadata */
+	struct jal_sign_pool *signing_pool; /**< Signing contexts loaded with signing_key and signing_cert */
+	struct jalp_async *async; /**< The queue and thread used to send records in the background, or NULL */
+	struct jalp_batch *batch; /**< Log and audit records collected since jalp_context_begin_batch(), or NULL */
+	size_t shm_ring_size; /**< The size of the ring offered on connect, or 0 for none */
+	struct jalp_shm *shm; /**< The shared memory ring the Local Store took, or NULL */
 	uint8_t flags;
-	xmlSchemaValidCtxtPtr jaf_validCtxt;
+	xmlSchemaPtr jaf_schema; /**< The audit schema, compiled by the first jalp_audit() that validates */
+	/** Set while a thread sends on the socket of the context itself */
+	int conn_busy;
+	/** Connections opened for other threads, not in use */
+	struct jalp_context_t *idle_conns;
+	/** The next idle connection in the list */
+	struct jalp_context_t *next_conn;
+	/** The number of connections opened for other threads */
+	int extra_conns;
+	/** Validation contexts for jaf_schema, not in use */
+	xmlSchemaValidCtxtPtr idle_valid_ctxts[JALP_CONTEXT_MAX_CONNECTIONS];
+	int idle_valid_ctxt_count;
+	/** Protects the connection and validation context pools */
+	pthread_mutex_t pool_lock;
+	/** Signaled when a connection is given back */
+	pthread_cond_t conn_free;
+	/** Held while adding to the batch or the queue of the background thread */
+	pthread_mutex_t send_lock;
 };
 
 /**
@@ -70,6 +103,26 @@ void jalp_context_disconnect(jalp_context *ctx);
  */
 enum jal_status jalp_context_connect(jalp_context *ctx);
 
+/**
+ * Get a connection to send one message with. This is \p ctx itself if no
+ * other thread is using it, otherwise another context with its own socket
+ * and ring, opened the first time it is needed. The connection may not be
+ * connected yet.
+ *
+ * @param[in] ctx The context.
+ *
+ * @return The connection, to be given back with jalp_context_put_conn().
+ */
+jalp_context *jalp_context_get_conn(jalp_context *ctx);
+
+/**
+ * Give back a connection from jalp_context_get_conn().
+ *
+ * @param[in] ctx The context.
+ * @param[in] conn The connection.
+ */
+void jalp_context_put_conn(jalp_context *ctx, jalp_context *conn);
+
 #ifdef __cplusplus
 }
 #endif
@@ -95,7 +95,7 @@ enum jal_status jalp_send_buffer_xml(jalp_context *ctx,
 		}
 		if (ctx->signing_key) {
 			const xmlChar *id = xmlGetProp(app_meta_elem, (xmlChar *)JALP_XML_JID);
-			status = jal_add_signature_block(ctx->signing_key, ctx->signing_cert, doc, last_elem, (char *)id);
+			status = jal_sign_pool_add_signature_block(ctx->signing_pool, doc, last_elem, (char *)id);
 			xmlFree((void*)id);
 			if (status != JAL_OK) {
 				goto out;
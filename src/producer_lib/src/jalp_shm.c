@@ -0,0 +1,336 @@
+/**
+ * @file jalp_shm.c This file contains the functions used to send records
+ * to the JALoP Local Store through a shared memory ring.
+ *
+ * @section LICENSE
+ *
+ * Source code in 3rd-party is licensed and owned by their respective
+ * copyright holders.
+ *
+ * All other source code is copyright Tresys Technology and licensed as below.
+ *
+ * Copyright (c) 2012 Tresys Technology LLC, Columbia, Maryland, USA
+ *
+ * This software was developed by Tresys Technology LLC
+ * with U.S. Government sponsorship.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/eventfd.h>
+#endif
+#include <jalop/jal_status.h>
+#include <jalop/jal_version.h>
+#include <jalop/jalp_context.h>
+#include "jal_alloc.h"
+#include "jal_shm_ring.h"
+#include "jalp_connection_internal.h"
+#include "jalp_context_internal.h"
+#include "jalp_shm_internal.h"
+
+struct jalp_shm {
+	struct jal_shm_ring ring;
+	void *map;
+	size_t map_len;
+	/** Written to when records are added */
+	int data_efd;
+	/** Written to by the Local Store when it makes room */
+	int space_efd;
+};
+
+static void jalp_shm_ring_doorbell(int efd)
+{
+	uint64_t one = 1;
+	if (-1 == write(efd, &one, sizeof(one))) {
+		// Only fails if the counter is about to overflow, in
+		// which case the Local Store is awake anyway.
+	}
+}
+
+/**
+ * Sleep until the Local Store makes room or hangs up. It never writes to
+ * the socket after answering #jalp_shm_setup, so anything to read there
+ * means it went away.
+ */
+static enum jal_status jalp_shm_wait(jalp_context *ctx)
+{
+	struct jalp_shm *shm = ctx->shm;
+	struct pollfd pfd[2];
+	memset(pfd, 0, sizeof(pfd));
+	pfd[0].fd = shm->space_efd;
+	pfd[0].events = POLLIN;
+	pfd[1].fd = ctx->socket;
+	pfd[1].events = POLLIN;
+
+	if (-1 == poll(pfd, 2, -1)) {
+		return (EINTR == errno) ? JAL_OK : JAL_E_NOT_CONNECTED;
+	}
+	if (pfd[1].revents) {
+		return JAL_E_NOT_CONNECTED;
+	}
+	if (pfd[0].revents & POLLIN) {
+		uint64_t count;
+		if (-1 == read(shm->space_efd, &count, sizeof(count))) {
+			// EAGAIN, someone else reset it
+		}
+	}
+	return JAL_OK;
+}
+
+enum jal_status jalp_shm_setup(jalp_context *ctx)
+{
+#if defined(__linux__) && defined(MFD_ALLOW_SEALING)
+	enum jal_status ret = JAL_E_COMM;
+	int mem_fd = -1;
+	size_t map_len = jal_shm_ring_map_size(ctx->shm_ring_size);
+	struct jalp_shm *shm = jal_calloc(1, sizeof(*shm));
+	shm->data_efd = -1;
+	shm->space_efd = -1;
+
+	// The seals keep the ring from shrinking under the Local Store
+	mem_fd = memfd_create("jalp_shm", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+	if (-1 == mem_fd || 0 != ftruncate(mem_fd, map_len) ||
+			0 != fcntl(mem_fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL)) {
+		goto out;
+	}
+	shm->map = mmap(NULL, map_len, PROT_READ | PROT_WRITE, MAP_SHARED, mem_fd, 0);
+	if (MAP_FAILED == shm->map) {
+		shm->map = NULL;
+		goto out;
+	}
+	shm->map_len = map_len;
+	if (0 != jal_shm_ring_init(&shm->ring, shm->map, map_len)) {
+		goto out;
+	}
+	shm->data_efd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	shm->space_efd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	if (-1 == shm->data_efd || -1 == shm->space_efd) {
+		goto out;
+	}
+
+	// The message has no data or application metadata, just the header
+	// and the two BREAK strings.
+	uint8_t msg[JAL_SHM_RING_FRAME_HEADER_LEN + 2 * JAL_SHM_RING_BREAK_LEN];
+	uint16_t version = JPP_VERSION;
+	uint16_t type = JALP_SHM_SETUP_MSG;
+	uint64_t len = 0;
+	memcpy(msg, &version, sizeof(version));
+	memcpy(msg + 2, &type, sizeof(type));
+	memcpy(msg + 4, &len, sizeof(len));
+	memcpy(msg + 12, &len, sizeof(len));
+	memcpy(msg + JAL_SHM_RING_FRAME_HEADER_LEN, JALP_BREAK_STR JALP_BREAK_STR,
+			2 * JAL_SHM_RING_BREAK_LEN);
+
+	int fds[3] = { mem_fd, shm->data_efd, shm->space_efd };
+	char buffer[CMSG_SPACE(sizeof(fds))];
+	struct iovec iov;
+	iov.iov_base = msg;
+	iov.iov_len = sizeof(msg);
+	struct msghdr msgh;
+	memset(&msgh, 0, sizeof(msgh));
+	msgh.msg_iov = &iov;
+	msgh.msg_iovlen = 1;
+	msgh.msg_control = buffer;
+	msgh.msg_controllen = sizeof(buffer);
+	struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msgh);
+	cmsg->cmsg_level = SOL_SOCKET;
+	cmsg->cmsg_type = SCM_RIGHTS;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+	memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+	msgh.msg_controllen = cmsg->cmsg_len;
+
+	// Small enough to always go out in one piece
+	ssize_t sent;
+	do {
+		sent = sendmsg(ctx->socket, &msgh, MSG_NOSIGNAL);
+	} while (-1 == sent && EINTR == errno);
+	if ((ssize_t) sizeof(msg) != sent) {
+		ret = JAL_E_NOT_CONNECTED;
+		goto out;
+	}
+
+	struct pollfd pfd;
+	memset(&pfd, 0, sizeof(pfd));
+	pfd.fd = ctx->socket;
+	pfd.events = POLLIN;
+	int n;
+	do {
+		n = poll(&pfd, 1, JALP_SHM_SETUP_TIMEOUT_MS);
+	} while (-1 == n && EINTR == errno);
+
+	uint8_t answer = 1;
+	ssize_t got = 0;
+	if (1 == n) {
+		do {
+			got = read(ctx->socket, &answer, sizeof(answer));
+		} while (-1 == got && EINTR == errno);
+	}
+	if ((ssize_t) sizeof(answer) != got) {
+		ret = JAL_E_NOT_CONNECTED;
+		goto out;
+	}
+	if (0 != answer) {
+		goto out;
+	}
+
+	ctx->shm = shm;
+	shm = NULL;
+	ret = JAL_OK;
+
+out:
+	if (-1 != mem_fd) {
+		close(mem_fd);
+	}
+	jalp_shm_destroy(&shm);
+	return ret;
+#else
+	(void) ctx;
+	return JAL_E_COMM;
+#endif
+}
+
+void jalp_shm_destroy(struct jalp_shm **shm)
+{
+	if (!shm || !*shm) {
+		return;
+	}
+	if ((*shm)->map) {
+		munmap((*shm)->map, (*shm)->map_len);
+	}
+	if (-1 != (*shm)->data_efd) {
+		close((*shm)->data_efd);
+	}
+	if (-1 != (*shm)->space_efd) {
+		close((*shm)->space_efd);
+	}
+	free(*shm);
+	*shm = NULL;
+}
+
+int jalp_shm_fits(struct jalp_shm *shm, uint64_t data_len, uint64_t meta_len)
+{
+	uint64_t frame_len = jal_shm_ring_frame_len(data_len, meta_len);
+	return 0 != frame_len && frame_len <= shm->ring.size / 2;
+}
+
+enum jal_status jalp_shm_send(jalp_context *ctx, uint16_t message_type,
+		const void *data, uint64_t data_len, const void *meta, uint64_t meta_len)
+{
+	struct jalp_shm *shm = ctx->shm;
+	enum jal_status ret = JAL_OK;
+	uint64_t frame_len = jal_shm_ring_frame_len(data_len, meta_len);
+	uint8_t *frame = NULL;
+	int err;
+
+	while (1 == (err = jal_shm_ring_reserve(&shm->ring, frame_len, &frame))) {
+		jal_shm_ring_producer_wait(&shm->ring);
+		err = jal_shm_ring_reserve(&shm->ring, frame_len, &frame);
+		if (1 != err) {
+			break;
+		}
+		ret = jalp_shm_wait(ctx);
+		if (JAL_OK != ret) {
+			goto out;
+		}
+	}
+	if (0 != err) {
+		ret = JAL_E_INVAL;
+		goto out;
+	}
+
+	uint16_t version = JPP_VERSION;
+	memcpy(frame, &version, sizeof(version));
+	memcpy(frame + 2, &message_type, sizeof(message_type));
+	memcpy(frame + 4, &data_len, sizeof(data_len));
+	memcpy(frame + 12, &meta_len, sizeof(meta_len));
+	uint8_t *p = frame + JAL_SHM_RING_FRAME_HEADER_LEN;
+	if (data_len) {
+		memcpy(p, data, data_len);
+		p += data_len;
+	}
+	memcpy(p, JAL_SHM_RING_BREAK_STR, JAL_SHM_RING_BREAK_LEN);
+	p += JAL_SHM_RING_BREAK_LEN;
+	if (meta_len) {
+		memcpy(p, meta, meta_len);
+		p += meta_len;
+	}
+	memcpy(p, JAL_SHM_RING_BREAK_STR, JAL_SHM_RING_BREAK_LEN);
+
+	if (jal_shm_ring_commit(&shm->ring, frame_len)) {
+		jalp_shm_ring_doorbell(shm->data_efd);
+	}
+
+out:
+	if (JAL_E_NOT_CONNECTED == ret) {
+		jalp_context_disconnect(ctx);
+	}
+	return ret;
+}
+
+enum jal_status jalp_shm_drain(jalp_context *ctx)
+{
+	struct jalp_shm *shm = ctx->shm;
+	enum jal_status ret = JAL_OK;
+
+	while (!jal_shm_ring_is_drained(&shm->ring)) {
+		jal_shm_ring_producer_wait(&shm->ring);
+		if (jal_shm_ring_is_drained(&shm->ring)) {
+			break;
+		}
+		ret = jalp_shm_wait(ctx);
+		if (JAL_OK != ret) {
+			jalp_context_disconnect(ctx);
+			break;
+		}
+	}
+	return ret;
+}
+
+enum jal_status jalp_context_enable_shm(jalp_context *ctx, size_t ring_size)
+{
+	if (!ctx) {
+		return JAL_E_INVAL;
+	}
+	if (!ctx->path || !ctx->hostname || !ctx->app_name) {
+		return JAL_E_UNINITIALIZED;
+	}
+	if (ctx->async) {
+		return JAL_E_INVAL;
+	}
+
+	if (0 == ring_size) {
+		ring_size = JALP_SHM_DEFAULT_RING_SIZE;
+	}
+	if (ring_size < JAL_SHM_RING_MIN_SIZE || ring_size > JAL_SHM_RING_MAX_SIZE ||
+			0 != (ring_size & (ring_size - 1))) {
+		return JAL_E_INVAL;
+	}
+
+	ctx->shm_ring_size = ring_size;
+	enum jal_status ret = jalp_context_connect(ctx);
+	if (JAL_OK != ret) {
+		return ret;
+	}
+	return ctx->shm ? JAL_OK : JAL_E_COMM;
+}
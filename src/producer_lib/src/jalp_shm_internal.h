@@ -0,0 +1,123 @@
+/**
+ * @file jalp_shm_internal.h This file defines the private functions used
+ * to send records through a shared memory ring instead of the socket.
+ *
+ * @section LICENSE
+ *
+ * Source code in 3rd-party is licensed and owned by their respective
+ * copyright holders.
+ *
+ * All other source code is copyright Tresys Technology and licensed as below.
+ *
+ * Copyright (c) 2012 Tresys Technology LLC, Columbia, Maryland, USA
+ *
+ * This software was developed by Tresys Technology LLC
+ * with U.S. Government sponsorship.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef _JALP_SHM_INTERNAL_H_
+#define _JALP_SHM_INTERNAL_H_
+
+#include <stdint.h>
+#include <jalop/jal_status.h>
+#include <jalop/jalp_context.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * How long #jalp_shm_setup waits for the Local Store to answer.
+ */
+#define JALP_SHM_SETUP_TIMEOUT_MS 5000
+
+/**
+ * The shared memory ring of a connected #jalp_context, set up by
+ * #jalp_shm_setup. The ring itself is described in jal_shm_ring.h.
+ *
+ * The ring is offered with a #JALP_SHM_SETUP_MSG message, which has no data
+ * or application metadata and carries three file descriptors: the sealed
+ * memfd holding the ring, the eventfd the producer writes to when it adds
+ * records, and the eventfd the Local Store writes to when it makes room.
+ * The Local Store answers with a single byte, 0 if it took the ring.
+ *
+ * After that, log, audit and batch messages go through the ring. Journal
+ * messages still go over the socket, once the Local Store has taken
+ * everything out of the ring, so records stay in order.
+ */
+struct jalp_shm;
+
+/**
+ * Offer a ring of ctx->shm_ring_size bytes on the socket of \p ctx, which
+ * was just connected. Sets ctx->shm if the Local Store takes it.
+ *
+ * @param[in] ctx The context.
+ *
+ * @return JAL_OK if the ring is in use, JAL_E_COMM if the Local Store
+ * turned it down and the socket can still be used, or JAL_E_NOT_CONNECTED
+ * if the Local Store did not answer. A Local Store that does not know the
+ * message closes the connection, so the caller must connect again.
+ */
+enum jal_status jalp_shm_setup(jalp_context *ctx);
+
+/**
+ * Unmap the ring and close the eventfds.
+ *
+ * @param[in,out] shm The ring to destroy. Set to NULL.
+ */
+void jalp_shm_destroy(struct jalp_shm **shm);
+
+/**
+ * Check whether a message can go through the ring at all.
+ *
+ * @param[in] shm The ring.
+ * @param[in] data_len The length of the data record.
+ * @param[in] meta_len The length of the application metadata document.
+ *
+ * @return 1 if it fits, 0 otherwise.
+ */
+int jalp_shm_fits(struct jalp_shm *shm, uint64_t data_len, uint64_t meta_len);
+
+/**
+ * Add a message to the ring of \p ctx, waiting for room if necessary.
+ *
+ * @param[in] ctx The context, which has a ring.
+ * @param[in] message_type The #jalp_connection_msg_type of the message.
+ * @param[in] data The data record.
+ * @param[in] data_len The length of the data record.
+ * @param[in] meta The application metadata document.
+ * @param[in] meta_len The length of the application metadata document.
+ *
+ * @return JAL_OK, or JAL_E_NOT_CONNECTED if the Local Store went away, in
+ * which case \p ctx is disconnected.
+ */
+enum jal_status jalp_shm_send(jalp_context *ctx, uint16_t message_type,
+		const void *data, uint64_t data_len, const void *meta, uint64_t meta_len);
+
+/**
+ * Wait until the Local Store has taken every message out of the ring of
+ * \p ctx.
+ *
+ * @param[in] ctx The context, which has a ring.
+ *
+ * @return JAL_OK, or JAL_E_NOT_CONNECTED if the Local Store went away, in
+ * which case \p ctx is disconnected.
+ */
+enum jal_status jalp_shm_drain(jalp_context *ctx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _JALP_SHM_INTERNAL_H_
@@ -34,6 +34,53 @@
 
 #include "jalp_xml_validate.h"
 
+/**
+ * Compile the schema in \p xsdFileName, unless another thread got there
+ * first.
+ */
+static enum jal_status jalp_load_schema(jalp_context *jalp_ctx, const char *xsdFileName)
+{
+	xmlSchemaParserCtxtPtr parseCtxt = NULL;
+	xmlSchemaPtr jaf_schema = NULL;
+
+	if((xsdFileName == NULL) || (strcmp(xsdFileName, "")) == 0) {
+		return JAL_E_INVAL;
+	}
+
+	if(access(xsdFileName, F_OK) != 0) {
+		return JAL_E_INVAL;
+	}
+
+	//Setup parser context
+	parseCtxt = xmlSchemaNewParserCtxt(xsdFileName);
+
+	if(parseCtxt == NULL) {
+		return JAL_E_XML_PARSE;
+	}
+
+	//Parse schema
+	if( (jaf_schema = xmlSchemaParse(parseCtxt)) == NULL) {
+		xmlSchemaFreeParserCtxt(parseCtxt);
+		return JAL_E_XML_SCHEMA;
+	}
+	xmlSchemaFreeParserCtxt(parseCtxt);
+
+	pthread_mutex_lock(&jalp_ctx->pool_lock);
+	if (jalp_ctx->jaf_schema == NULL) {
+		__atomic_store_n(&jalp_ctx->jaf_schema, jaf_schema, __ATOMIC_RELEASE);
+		jaf_schema = NULL;
+	}
+	pthread_mutex_unlock(&jalp_ctx->pool_lock);
+	xmlSchemaFree(jaf_schema);
+
+	return JAL_OK;
+}
+
+int jalp_schema_loaded(jalp_context *jalp_ctx)
+{
+	return NULL != __atomic_load_n(&jalp_ctx->jaf_schema, __ATOMIC_ACQUIRE);
+}
+
 /**
  * Function to validate xml doc against xsd
  * 
@@ -45,47 +92,45 @@
  */
 enum jal_status jalp_validate_xml(jalp_context *jalp_ctx, xmlDocPtr doc, const char *xsdFileName)
 {
-	xmlSchemaParserCtxtPtr parseCtxt = NULL;
-	xmlSchemaPtr jaf_schema = NULL;
+	xmlSchemaValidCtxtPtr validCtxt = NULL;
 
-	if(jalp_ctx->jaf_validCtxt == NULL) 
+	if(!jalp_schema_loaded(jalp_ctx))
 	{
-		if((xsdFileName == NULL) || (strcmp(xsdFileName, "")) == 0) {
-			return JAL_E_INVAL;
-		}
-
-		if(access(xsdFileName, F_OK) != 0) {
-			return JAL_E_INVAL;
+		enum jal_status status = jalp_load_schema(jalp_ctx, xsdFileName);
+		if (status != JAL_OK) {
+			return status;
 		}
+	}
 
-		//Setup parser context
-		parseCtxt = xmlSchemaNewParserCtxt(xsdFileName);
-	
-		if(parseCtxt == NULL) {
-			return JAL_E_XML_PARSE;
-		}
+	// The compiled schema is shared, each thread validates with its
+	// own validation context.
+	pthread_mutex_lock(&jalp_ctx->pool_lock);
+	if (jalp_ctx->idle_valid_ctxt_count > 0) {
+		validCtxt = jalp_ctx->idle_valid_ctxts[--jalp_ctx->idle_valid_ctxt_count];
+	}
+	pthread_mutex_unlock(&jalp_ctx->pool_lock);
 
-		//Parse schema
-		if( (jaf_schema = xmlSchemaParse(parseCtxt)) == NULL) {
-			xmlSchemaFreeParserCtxt(parseCtxt);
+	if (validCtxt == NULL) {
+		validCtxt = xmlSchemaNewValidCtxt(jalp_ctx->jaf_schema);
+		if (validCtxt == NULL) {
 			return JAL_E_XML_SCHEMA;
 		}
-		xmlSchemaFreeParserCtxt(parseCtxt);
+	}
 
-		jalp_ctx->jaf_validCtxt = xmlSchemaNewValidCtxt(jaf_schema);
+	// validate the xml document..returns 0 on success
+	int ret = xmlSchemaValidateDoc(validCtxt, doc);
 
-		if(jalp_ctx->jaf_validCtxt == NULL)
-		{
-			xmlSchemaFree(jaf_schema);
-			return JAL_E_XML_SCHEMA;
-		}
+	pthread_mutex_lock(&jalp_ctx->pool_lock);
+	if (jalp_ctx->idle_valid_ctxt_count < JALP_CONTEXT_MAX_CONNECTIONS) {
+		jalp_ctx->idle_valid_ctxts[jalp_ctx->idle_valid_ctxt_count++] = validCtxt;
+		validCtxt = NULL;
 	}
-	// validate the xml document..returns 0 on success
-	int ret = xmlSchemaValidateDoc(jalp_ctx->jaf_validCtxt, doc);
+	pthread_mutex_unlock(&jalp_ctx->pool_lock);
+	xmlSchemaFreeValidCtxt(validCtxt);
+
 	if(ret != 0) {
 		return JAL_E_XML_PARSE;
 	}
 
 	return JAL_OK;
 }
-
@@ -31,7 +31,12 @@
 #include <jalop/jal_status.h>
 #include "jalp_context_internal.h"
 
-// function to validate an XML document against a specific schema
+// check whether the audit schema has been compiled, so the
+// file name passed to jalp_validate_xml() is not needed
+int jalp_schema_loaded(jalp_context *jalp_ctx);
+
+// function to validate an XML document against a specific schema,
+// compiled by the first call
 enum jal_status jalp_validate_xml(
 	jalp_context *jalp_ctx, 
 	xmlDocPtr doc, 
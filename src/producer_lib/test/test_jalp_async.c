@@ -0,0 +1,293 @@
+/**
+ * @file test_jalp_async.c This file contains tests for jalp_async.c functions.
+ *
+ * @section LICENSE
+ *
+ * Source code in 3rd-party is licensed and owned by their respective
+ * copyright holders.
+ *
+ * All other source code is copyright Tresys Technology and licensed as below.
+ *
+ * Copyright (c) 2012 Tresys Technology LLC, Columbia, Maryland, USA
+ *
+ * This software was developed by Tresys Technology LLC
+ * with U.S. Government sponsorship.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <test-dept.h>
+
+#include <jalop/jalp_context.h>
+#include <jalop/jal_version.h>
+#include "jalp_async_internal.h"
+#include "jalp_connection_internal.h"
+#include "jalp_context_internal.h"
+
+#define SOCK_PATH "./test_jalp_async.sock"
+#define MISSING_PATH "./test_jalp_async_missing.sock"
+#define SPILL_PATH "./test_jalp_async.spill"
+#define SOME_HOST "some_host"
+#define SOME_APP "test_jalp_async"
+#define SOME_SCHEMA_ROOT "/path/to/jalop/schemas"
+
+// Each record in these tests is 5 bytes, with no application metadata
+#define RECORD_LEN 5
+#define FRAME_LEN (20 + RECORD_LEN + 5 + 5)
+
+static jalp_context *ctx;
+static int listen_fd;
+
+static jalp_context *make_context(const char *path)
+{
+	jalp_context *c = jalp_context_create();
+	assert_equals(JAL_OK, jalp_context_init(c, path, SOME_HOST, SOME_APP, SOME_SCHEMA_ROOT));
+	return c;
+}
+
+static void start_store()
+{
+	struct sockaddr_un addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strncpy(addr.sun_path, SOCK_PATH, sizeof(addr.sun_path) - 1);
+	listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	assert_not_equals(-1, listen_fd);
+	assert_equals(0, bind(listen_fd, (struct sockaddr *) &addr, sizeof(addr)));
+	assert_equals(0, listen(listen_fd, 1));
+}
+
+static enum jal_status send_record(jalp_context *c, int i)
+{
+	char rec[RECORD_LEN + 1];
+	snprintf(rec, sizeof(rec), "rec%02d", i);
+	return jalp_send_buffer(c, JALP_LOG_MSG, rec, RECORD_LEN, NULL, 0, -1);
+}
+
+static void read_all(int fd, uint8_t *buf, size_t len)
+{
+	while (len > 0) {
+		ssize_t n = read(fd, buf, len);
+		assert_true(n > 0);
+		buf += n;
+		len -= n;
+	}
+}
+
+// Check that \p buf holds the records numbered first to first + count - 1
+static void check_records(const uint8_t *buf, int first, int count)
+{
+	for (int i = 0; i < count; i++) {
+		const uint8_t *frame = buf + i * FRAME_LEN;
+		uint16_t version;
+		uint16_t type;
+		uint64_t data_len;
+		uint64_t meta_len;
+		char rec[RECORD_LEN + 1];
+		memcpy(&version, frame, sizeof(version));
+		memcpy(&type, frame + 2, sizeof(type));
+		memcpy(&data_len, frame + 4, sizeof(data_len));
+		memcpy(&meta_len, frame + 12, sizeof(meta_len));
+		assert_equals(JPP_VERSION, version);
+		assert_equals(JALP_LOG_MSG, type);
+		assert_equals(RECORD_LEN, data_len);
+		assert_equals(0, meta_len);
+		snprintf(rec, sizeof(rec), "rec%02d", first + i);
+		assert_equals(0, memcmp(rec, frame + 20, RECORD_LEN));
+		assert_equals(0, memcmp("BREAKBREAK", frame + 20 + RECORD_LEN, 10));
+	}
+}
+
+static void *store_reader(void *arg)
+{
+	int count = *(int *) arg;
+	uint8_t *buf = malloc(count * FRAME_LEN);
+	int fd = accept(listen_fd, NULL, NULL);
+	read_all(fd, buf, count * FRAME_LEN);
+	close(fd);
+	return buf;
+}
+
+void setup()
+{
+	unlink(SOCK_PATH);
+	unlink(SPILL_PATH);
+	listen_fd = -1;
+	ctx = make_context(SOCK_PATH);
+}
+
+void teardown()
+{
+	jalp_context_destroy(&ctx);
+	if (-1 != listen_fd) {
+		close(listen_fd);
+	}
+	unlink(SOCK_PATH);
+	unlink(SPILL_PATH);
+}
+
+void test_enable_async_fails_with_bad_input()
+{
+	jalp_context *uninit = jalp_context_create();
+	assert_equals(JAL_E_INVAL, jalp_context_enable_async(NULL, 0, JALP_ASYNC_BLOCK, NULL));
+	assert_equals(JAL_E_UNINITIALIZED, jalp_context_enable_async(uninit, 0, JALP_ASYNC_BLOCK, NULL));
+	assert_equals(JAL_E_INVAL, jalp_context_enable_async(ctx, 0, JALP_ASYNC_BLOCK, SPILL_PATH));
+	assert_equals(JAL_E_INVAL, jalp_context_enable_async(ctx, 0, JALP_ASYNC_DROP_NEWEST, SPILL_PATH));
+	assert_equals(JAL_E_INVAL, jalp_context_enable_async(ctx, 0, JALP_ASYNC_SPILL, NULL));
+	assert_equals(JAL_E_INVAL, jalp_context_enable_async(ctx, 0, (enum jalp_async_overflow) 42, NULL));
+	assert_equals((void *) NULL, ctx->async);
+	jalp_context_destroy(&uninit);
+}
+
+void test_enable_async_fails_when_already_enabled()
+{
+	assert_equals(JAL_OK, jalp_context_enable_async(ctx, 0, JALP_ASYNC_BLOCK, NULL));
+	assert_equals(JAL_E_INITIALIZED, jalp_context_enable_async(ctx, 0, JALP_ASYNC_BLOCK, NULL));
+}
+
+void test_flush_and_stats_work_without_async()
+{
+	struct jalp_async_stats stats;
+	memset(&stats, 0xff, sizeof(stats));
+	assert_equals(JAL_OK, jalp_context_flush(ctx, 0));
+	assert_equals(JAL_OK, jalp_context_get_async_stats(ctx, &stats));
+	assert_equals(0, stats.queued);
+	assert_equals(0, stats.sent);
+	assert_equals(0, stats.dropped);
+	assert_equals(0, stats.spilled);
+	assert_equals(JAL_E_INVAL, jalp_context_flush(NULL, 0));
+	assert_equals(JAL_E_INVAL, jalp_context_get_async_stats(ctx, NULL));
+}
+
+void test_queued_records_are_sent_in_order()
+{
+	struct jalp_async_stats stats;
+	uint8_t buf[10 * FRAME_LEN];
+
+	start_store();
+	assert_equals(JAL_OK, jalp_context_enable_async(ctx, 0, JALP_ASYNC_BLOCK, NULL));
+	for (int i = 0; i < 10; i++) {
+		assert_equals(JAL_OK, send_record(ctx, i));
+	}
+	assert_equals(JAL_OK, jalp_context_flush(ctx, -1));
+
+	int fd = accept(listen_fd, NULL, NULL);
+	read_all(fd, buf, sizeof(buf));
+	close(fd);
+	check_records(buf, 0, 10);
+
+	assert_equals(JAL_OK, jalp_context_get_async_stats(ctx, &stats));
+	assert_equals(10, stats.queued);
+	assert_equals(10, stats.sent);
+	assert_equals(0, stats.dropped);
+	assert_equals(0, stats.spilled);
+}
+
+void test_block_waits_for_room()
+{
+	int count = 50;
+	pthread_t reader;
+	uint8_t *buf = NULL;
+
+	start_store();
+	assert_equals(JAL_OK, pthread_create(&reader, NULL, store_reader, &count));
+	// Room for two records at a time
+	assert_equals(JAL_OK, jalp_context_enable_async(ctx, 2 * FRAME_LEN, JALP_ASYNC_BLOCK, NULL));
+	for (int i = 0; i < count; i++) {
+		assert_equals(JAL_OK, send_record(ctx, i));
+	}
+	assert_equals(JAL_OK, jalp_context_flush(ctx, -1));
+	pthread_join(reader, (void **) &buf);
+	check_records(buf, 0, count);
+	free(buf);
+}
+
+void test_drop_newest_drops_what_does_not_fit()
+{
+	struct jalp_async_stats stats;
+	jalp_context_destroy(&ctx);
+	ctx = make_context(MISSING_PATH);
+
+	assert_equals(JAL_OK, jalp_context_enable_async(ctx, FRAME_LEN, JALP_ASYNC_DROP_NEWEST, NULL));
+	assert_equals(JAL_OK, send_record(ctx, 0));
+	assert_equals(JAL_E_NO_MEM, send_record(ctx, 1));
+	assert_equals(JAL_E_NOT_CONNECTED, jalp_context_flush(ctx, 1000));
+
+	assert_equals(JAL_OK, jalp_context_get_async_stats(ctx, &stats));
+	assert_equals(1, stats.queued);
+	assert_equals(0, stats.sent);
+	assert_equals(1, stats.dropped);
+	assert_equals(0, stats.spilled);
+}
+
+void test_records_too_big_for_the_queue_are_sent_directly()
+{
+	jalp_context_destroy(&ctx);
+	ctx = make_context(MISSING_PATH);
+
+	assert_equals(JAL_OK, jalp_context_enable_async(ctx, FRAME_LEN - 1, JALP_ASYNC_DROP_NEWEST, NULL));
+	assert_equals(JAL_E_NOT_CONNECTED, send_record(ctx, 0));
+}
+
+void test_spill_keeps_records_until_the_store_is_back()
+{
+	struct jalp_async_stats stats;
+	struct stat st;
+	uint8_t buf[5 * FRAME_LEN];
+
+	jalp_context_destroy(&ctx);
+	ctx = make_context(SOCK_PATH);
+
+	// Nothing is listening yet
+	assert_equals(JAL_OK, jalp_context_enable_async(ctx, 2 * FRAME_LEN, JALP_ASYNC_SPILL, SPILL_PATH));
+	for (int i = 0; i < 5; i++) {
+		assert_equals(JAL_OK, send_record(ctx, i));
+	}
+	assert_equals(JAL_OK, jalp_context_get_async_stats(ctx, &stats));
+	assert_equals(5, stats.queued);
+	assert_equals(3, stats.spilled);
+	assert_equals(0, stats.dropped);
+
+	// Everything, including what was still in the queue, ends up in the
+	// spill file, oldest first.
+	jalp_async_destroy(&ctx->async);
+	assert_equals(0, stat(SPILL_PATH, &st));
+	assert_equals(5 * FRAME_LEN, st.st_size);
+
+	// A partly written record at the end is dropped
+	FILE *f = fopen(SPILL_PATH, "a");
+	fwrite("junk", 1, 4, f);
+	fclose(f);
+
+	start_store();
+	assert_equals(JAL_OK, jalp_context_enable_async(ctx, 2 * FRAME_LEN, JALP_ASYNC_SPILL, SPILL_PATH));
+	assert_equals(JAL_OK, jalp_context_flush(ctx, -1));
+
+	int fd = accept(listen_fd, NULL, NULL);
+	read_all(fd, buf, sizeof(buf));
+	close(fd);
+	check_records(buf, 0, 5);
+
+	assert_equals(0, stat(SPILL_PATH, &st));
+	assert_equals(0, st.st_size);
+	assert_equals(JAL_OK, jalp_context_get_async_stats(ctx, &stats));
+	assert_equals(5, stats.sent);
+}
@@ -93,6 +93,13 @@ enum jal_status jalp_send_buffer(jalp_context *jctx, uint16_t message_type,
 	return JAL_OK;
 }
 
+// jalp_batch.c sends through this, batches are not used here
+enum jal_status jalp_send_unbatched(jalp_context *jctx, uint16_t message_type,
+		void *data, uint64_t data_len, void *meta, uint64_t meta_len, int fd)
+{
+	return jalp_send_buffer(jctx, message_type, data, data_len, meta, meta_len, fd);
+}
+
 void setup()
 {
 	jalp_init();
@@ -247,7 +254,7 @@ void test_jalp_digest_audit_record_returns_schema_err_with_invalid_schema_root()
 	free(ctx->schema_root); // init'd in setup()
 	ctx->schema_root = jal_strdup("/");
 	ctx->flags = JAF_VALIDATE_XML;
-	ctx->jaf_validCtxt = NULL;
+	ctx->jaf_schema = NULL;
 
 	enum jal_status ret = jalp_audit(ctx, app_meta, (uint8_t *)VALID_XML, strlen(VALID_XML));
 
@@ -262,7 +269,7 @@ void test_audit_returns_inval_with_null_schema_root()
 	// Setting schema_root to NULL causes JAL_E_INVAL during NULL checks
 	ctx->schema_root = NULL;
 	ctx->flags = JAF_VALIDATE_XML;
-	ctx->jaf_validCtxt = NULL;
+	ctx->jaf_schema = NULL;
 
 	enum jal_status ret = jalp_audit(ctx, app_meta, (uint8_t *)VALID_XML, strlen(VALID_XML));
 
@@ -272,7 +279,7 @@ void test_audit_returns_inval_with_null_schema_root()
 void test_audit_works_with_good_input()
 {
 	ctx->flags = JAF_VALIDATE_XML;
-	ctx->jaf_validCtxt = NULL;
+	ctx->jaf_schema = NULL;
 	ctx->signing_key = 0;
 
 	expected_data_len = buff_len;
@@ -293,7 +300,7 @@ void test_audit_schema_validation_failure()
 	// Exactly the same as the good_input test, but with xml data that is valid
 	// but not matching the schema
 	ctx->flags = JAF_VALIDATE_XML;
-	ctx->jaf_validCtxt = NULL;
+	ctx->jaf_schema = NULL;
 	ctx->signing_key = 0;
 
 	expected_data_len = buff_len;
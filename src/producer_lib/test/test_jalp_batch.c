@@ -0,0 +1,321 @@
+/**
+ * @file test_jalp_batch.c This file contains tests for jalp_batch.c functions.
+ *
+ * @section LICENSE
+ *
+ * Source code in 3rd-party is licensed and owned by their respective
+ * copyright holders.
+ *
+ * All other source code is copyright Tresys Technology and licensed as below.
+ *
+ * Copyright (c) 2012 Tresys Technology LLC, Columbia, Maryland, USA
+ *
+ * This software was developed by Tresys Technology LLC
+ * with U.S. Government sponsorship.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <test-dept.h>
+
+#include <jalop/jalp_context.h>
+#include <jalop/jal_version.h>
+#include "jalp_batch_internal.h"
+#include "jalp_connection_internal.h"
+#include "jalp_context_internal.h"
+
+#define SOCK_PATH "./test_jalp_batch.sock"
+#define SOME_HOST "some_host"
+#define SOME_APP "test_jalp_batch"
+#define SOME_SCHEMA_ROOT "/path/to/jalop/schemas"
+#define MSG_HEADER_LEN 20
+#define BREAK_LEN 5
+
+static jalp_context *ctx;
+static int listen_fd;
+static int store_fd;
+
+struct msg {
+	uint16_t type;
+	uint64_t data_len;
+	uint64_t meta_len;
+	uint8_t *data;
+	uint8_t *meta;
+};
+
+static void read_all(uint8_t *buf, size_t len)
+{
+	while (len > 0) {
+		ssize_t n = read(store_fd, buf, len);
+		assert_true(n > 0);
+		buf += n;
+		len -= n;
+	}
+}
+
+static void read_msg(struct msg *m)
+{
+	uint8_t hdr[MSG_HEADER_LEN];
+	uint8_t brk[BREAK_LEN];
+	uint16_t version;
+
+	if (-1 == store_fd) {
+		store_fd = accept(listen_fd, NULL, NULL);
+		assert_not_equals(-1, store_fd);
+	}
+	read_all(hdr, sizeof(hdr));
+	memcpy(&version, hdr, sizeof(version));
+	memcpy(&m->type, hdr + 2, sizeof(m->type));
+	memcpy(&m->data_len, hdr + 4, sizeof(m->data_len));
+	memcpy(&m->meta_len, hdr + 12, sizeof(m->meta_len));
+	assert_equals(JPP_VERSION, version);
+
+	m->data = malloc(m->data_len + 1);
+	m->meta = malloc(m->meta_len + 1);
+	read_all(m->data, m->data_len);
+	read_all(brk, sizeof(brk));
+	assert_equals(0, memcmp(JALP_BREAK_STR, brk, BREAK_LEN));
+	read_all(m->meta, m->meta_len);
+	read_all(brk, sizeof(brk));
+	assert_equals(0, memcmp(JALP_BREAK_STR, brk, BREAK_LEN));
+}
+
+static void free_msg(struct msg *m)
+{
+	free(m->data);
+	free(m->meta);
+}
+
+static void check_entry(const struct msg *m, uint32_t i, uint16_t type,
+		uint64_t data_len, uint64_t meta_len)
+{
+	const uint8_t *entry = m->data + JALP_BATCH_HEADER_LEN + i * JALP_BATCH_ENTRY_LEN;
+	uint16_t entry_type;
+	uint64_t entry_data_len;
+	uint64_t entry_meta_len;
+	memcpy(&entry_type, entry, sizeof(entry_type));
+	memcpy(&entry_data_len, entry + 8, sizeof(entry_data_len));
+	memcpy(&entry_meta_len, entry + 16, sizeof(entry_meta_len));
+	assert_equals(type, entry_type);
+	assert_equals(data_len, entry_data_len);
+	assert_equals(meta_len, entry_meta_len);
+}
+
+void setup()
+{
+	struct sockaddr_un addr;
+
+	unlink(SOCK_PATH);
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strncpy(addr.sun_path, SOCK_PATH, sizeof(addr.sun_path) - 1);
+	listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	assert_equals(0, bind(listen_fd, (struct sockaddr *) &addr, sizeof(addr)));
+	assert_equals(0, listen(listen_fd, 1));
+	store_fd = -1;
+
+	ctx = jalp_context_create();
+	assert_equals(JAL_OK, jalp_context_init(ctx, SOCK_PATH, SOME_HOST, SOME_APP, SOME_SCHEMA_ROOT));
+}
+
+void teardown()
+{
+	jalp_context_destroy(&ctx);
+	if (-1 != store_fd) {
+		close(store_fd);
+	}
+	close(listen_fd);
+	unlink(SOCK_PATH);
+}
+
+#define THREAD_COUNT 4
+#define RECORDS_PER_THREAD 100
+
+static void *send_logs(void *failed)
+{
+	for (int i = 0; i < RECORDS_PER_THREAD; i++) {
+		if (JAL_OK != jalp_send_buffer(ctx, JALP_LOG_MSG, "log", 3, NULL, 0, -1)) {
+			return failed;
+		}
+	}
+	return NULL;
+}
+
+void test_begin_batch_fails_with_bad_input()
+{
+	jalp_context *uninit = jalp_context_create();
+	assert_equals(JAL_E_INVAL, jalp_context_begin_batch(NULL));
+	assert_equals(JAL_E_UNINITIALIZED, jalp_context_begin_batch(uninit));
+	assert_equals(JAL_OK, jalp_context_begin_batch(ctx));
+	assert_equals(JAL_E_INITIALIZED, jalp_context_begin_batch(ctx));
+	jalp_context_destroy(&uninit);
+}
+
+void test_end_batch_fails_without_a_batch()
+{
+	assert_equals(JAL_E_INVAL, jalp_context_end_batch(NULL));
+	assert_equals(JAL_E_INVAL, jalp_context_end_batch(ctx));
+}
+
+void test_end_batch_sends_one_message()
+{
+	struct msg m;
+	assert_equals(JAL_OK, jalp_context_begin_batch(ctx));
+	assert_equals(JAL_OK, jalp_send_buffer(ctx, JALP_LOG_MSG, "log", 3, NULL, 0, -1));
+	assert_equals(JAL_OK, jalp_send_buffer(ctx, JALP_AUDIT_MSG, "audit", 5, "<meta/>", 7, -1));
+	assert_equals(JAL_OK, jalp_send_buffer(ctx, JALP_LOG_MSG, NULL, 0, "<m/>", 4, -1));
+	// Nothing has been sent yet
+	assert_equals(-1, ctx->socket);
+	assert_equals(JAL_OK, jalp_context_end_batch(ctx));
+	assert_equals((void *) NULL, ctx->batch);
+
+	read_msg(&m);
+	assert_equals(JALP_BATCH_MSG, m.type);
+	assert_equals(0, m.meta_len);
+	assert_equals(JALP_BATCH_HEADER_LEN + 3 * JALP_BATCH_ENTRY_LEN + 3 + 5 + 7 + 4, m.data_len);
+
+	uint16_t version;
+	uint32_t count;
+	memcpy(&version, m.data, sizeof(version));
+	memcpy(&count, m.data + 4, sizeof(count));
+	assert_equals(JALP_BATCH_VERSION, version);
+	assert_equals(3, count);
+	check_entry(&m, 0, JALP_LOG_MSG, 3, 0);
+	check_entry(&m, 1, JALP_AUDIT_MSG, 5, 7);
+	check_entry(&m, 2, JALP_LOG_MSG, 0, 4);
+	assert_equals(0, memcmp("logaudit<meta/><m/>",
+			m.data + JALP_BATCH_HEADER_LEN + 3 * JALP_BATCH_ENTRY_LEN, 19));
+	free_msg(&m);
+}
+
+void test_a_batch_of_one_is_sent_as_a_plain_message()
+{
+	struct msg m;
+	assert_equals(JAL_OK, jalp_context_begin_batch(ctx));
+	assert_equals(JAL_OK, jalp_send_buffer(ctx, JALP_AUDIT_MSG, "audit", 5, "<meta/>", 7, -1));
+	assert_equals(JAL_OK, jalp_context_end_batch(ctx));
+
+	read_msg(&m);
+	assert_equals(JALP_AUDIT_MSG, m.type);
+	assert_equals(5, m.data_len);
+	assert_equals(7, m.meta_len);
+	assert_equals(0, memcmp("audit", m.data, 5));
+	assert_equals(0, memcmp("<meta/>", m.meta, 7));
+	free_msg(&m);
+}
+
+void test_journal_records_are_sent_after_the_batch()
+{
+	struct msg m;
+	assert_equals(JAL_OK, jalp_context_begin_batch(ctx));
+	assert_equals(JAL_OK, jalp_send_buffer(ctx, JALP_LOG_MSG, "log1", 4, NULL, 0, -1));
+	assert_equals(JAL_OK, jalp_send_buffer(ctx, JALP_LOG_MSG, "log2", 4, NULL, 0, -1));
+	assert_equals(JAL_OK, jalp_send_buffer(ctx, JALP_JOURNAL_MSG, "journal", 7, NULL, 0, -1));
+
+	read_msg(&m);
+	assert_equals(JALP_BATCH_MSG, m.type);
+	free_msg(&m);
+	read_msg(&m);
+	assert_equals(JALP_JOURNAL_MSG, m.type);
+	free_msg(&m);
+	// The batch stays open
+	assert_not_equals((void *) NULL, ctx->batch);
+}
+
+void test_full_batches_are_sent()
+{
+	struct msg m;
+	uint32_t count;
+	assert_equals(JAL_OK, jalp_context_begin_batch(ctx));
+	for (int i = 0; i < JALP_BATCH_MAX_RECORDS + 2; i++) {
+		assert_equals(JAL_OK, jalp_send_buffer(ctx, JALP_LOG_MSG, "x", 1, NULL, 0, -1));
+	}
+	read_msg(&m);
+	assert_equals(JALP_BATCH_MSG, m.type);
+	memcpy(&count, m.data + 4, sizeof(count));
+	assert_equals(JALP_BATCH_MAX_RECORDS, count);
+	free_msg(&m);
+
+	// Destroying the context sends the rest
+	jalp_context_destroy(&ctx);
+	read_msg(&m);
+	assert_equals(JALP_BATCH_MSG, m.type);
+	memcpy(&count, m.data + 4, sizeof(count));
+	assert_equals(2, count);
+	free_msg(&m);
+}
+
+static void *read_two_msgs(void *arg)
+{
+	struct msg *m = (struct msg *) arg;
+	read_msg(&m[0]);
+	read_msg(&m[1]);
+	return NULL;
+}
+
+void test_big_records_start_a_new_batch()
+{
+	struct msg m[2];
+	pthread_t reader;
+	uint8_t *big = calloc(1, JALP_BATCH_MAX_BYTES);
+
+	// The second message is bigger than the socket buffer
+	assert_equals(0, pthread_create(&reader, NULL, read_two_msgs, m));
+	assert_equals(JAL_OK, jalp_context_begin_batch(ctx));
+	assert_equals(JAL_OK, jalp_send_buffer(ctx, JALP_LOG_MSG, "x", 1, NULL, 0, -1));
+	assert_equals(JAL_OK, jalp_send_buffer(ctx, JALP_LOG_MSG, big, JALP_BATCH_MAX_BYTES, NULL, 0, -1));
+	assert_equals(JAL_OK, jalp_context_end_batch(ctx));
+	pthread_join(reader, NULL);
+
+	assert_equals(JALP_LOG_MSG, m[0].type);
+	assert_equals(1, m[0].data_len);
+	assert_equals(JALP_LOG_MSG, m[1].type);
+	assert_equals(JALP_BATCH_MAX_BYTES, m[1].data_len);
+	free_msg(&m[0]);
+	free_msg(&m[1]);
+	free(big);
+}
+
+void test_threads_share_a_batch()
+{
+	struct msg m;
+	pthread_t threads[THREAD_COUNT];
+	int failed;
+	uint32_t count;
+
+	assert_equals(JAL_OK, jalp_context_begin_batch(ctx));
+	for (int i = 0; i < THREAD_COUNT; i++) {
+		assert_equals(0, pthread_create(&threads[i], NULL, send_logs, &failed));
+	}
+	for (int i = 0; i < THREAD_COUNT; i++) {
+		void *ret;
+		pthread_join(threads[i], &ret);
+		assert_equals((void *) NULL, ret);
+	}
+	assert_equals(JAL_OK, jalp_context_end_batch(ctx));
+
+	read_msg(&m);
+	assert_equals(JALP_BATCH_MSG, m.type);
+	memcpy(&count, m.data + 4, sizeof(count));
+	assert_equals(THREAD_COUNT * RECORDS_PER_THREAD, count);
+	check_entry(&m, count - 1, JALP_LOG_MSG, 3, 0);
+	free_msg(&m);
+}
@@ -28,6 +28,7 @@
 
 #include <test-dept.h>
 #include <jalop/jalp_context.h>
+#include <pthread.h>
 #include <sys/types.h>
 #include <unistd.h>
 #include <sys/socket.h>
@@ -743,3 +744,57 @@ void test_second_call_to_jalp_set_digest_ctx_with_missing_destroy_function_retai
 	assert_equals(jpctx->digest_ctx->final, dctx->final);
 	assert_equals(jpctx->digest_ctx->destroy, dctx->destroy);
 }
+
+void test_get_conn_hands_out_the_context_first()
+{
+	assert_equals(JAL_OK, jalp_context_init(jpctx, SOME_PATH, SOME_HOST, SOME_APP, SOME_SCHEMA_ROOT));
+
+	jalp_context *first = jalp_context_get_conn(jpctx);
+	assert_pointer_equals(jpctx, first);
+
+	// Another thread gets a connection of its own
+	jalp_context *second = jalp_context_get_conn(jpctx);
+	assert_not_equals((void *) NULL, second);
+	assert_not_equals(jpctx, second);
+	assert_string_equals(SOME_PATH, second->path);
+	assert_equals(-1, second->socket);
+	assert_equals(1, jpctx->extra_conns);
+
+	// Connections are kept for the next thread that needs one
+	jalp_context_put_conn(jpctx, first);
+	jalp_context_put_conn(jpctx, second);
+	assert_pointer_equals(jpctx, jalp_context_get_conn(jpctx));
+	assert_pointer_equals(second, jalp_context_get_conn(jpctx));
+	assert_equals(1, jpctx->extra_conns);
+	jalp_context_put_conn(jpctx, second);
+	jalp_context_put_conn(jpctx, jpctx);
+}
+
+static void *get_conn_in_thread(void *arg)
+{
+	return jalp_context_get_conn(arg);
+}
+
+void test_get_conn_waits_when_every_connection_is_in_use()
+{
+	jalp_context *conns[JALP_CONTEXT_MAX_CONNECTIONS];
+	pthread_t thread;
+	void *got;
+
+	assert_equals(JAL_OK, jalp_context_init(jpctx, SOME_PATH, SOME_HOST, SOME_APP, SOME_SCHEMA_ROOT));
+	for (int i = 0; i < JALP_CONTEXT_MAX_CONNECTIONS; i++) {
+		conns[i] = jalp_context_get_conn(jpctx);
+	}
+	assert_equals(JALP_CONTEXT_MAX_CONNECTIONS - 1, jpctx->extra_conns);
+
+	assert_equals(0, pthread_create(&thread, NULL, get_conn_in_thread, jpctx));
+	usleep(50000);
+	jalp_context_put_conn(jpctx, conns[3]);
+	pthread_join(thread, &got);
+	assert_pointer_equals(conns[3], got);
+	assert_equals(JALP_CONTEXT_MAX_CONNECTIONS - 1, jpctx->extra_conns);
+
+	for (int i = 0; i < JALP_CONTEXT_MAX_CONNECTIONS; i++) {
+		jalp_context_put_conn(jpctx, conns[i]);
+	}
+}
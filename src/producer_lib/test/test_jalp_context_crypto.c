@@ -150,6 +150,24 @@ void test_jalp_context_load_pem_rsa_suceeds_with_key()
 	assert_equals(ret, JAL_OK);
 	assert_not_equals((jalp_context *) NULL, context);
 	assert_not_equals((RSA *) NULL, context->signing_key);
+	assert_not_equals((void *) NULL, context->signing_pool);
+}
+
+void test_jalp_context_signing_pool_is_rebuilt_when_cert_is_loaded()
+{
+	enum jal_status ret;
+
+	ret = jalp_context_load_pem_cert(context, TEST_CERT);
+	assert_equals(ret, JAL_OK);
+	assert_equals((void *) NULL, context->signing_pool);
+
+	ret = jalp_context_load_pem_rsa(context, TEST_RSA_KEY, NULL);
+	assert_equals(ret, JAL_OK);
+	assert_not_equals((void *) NULL, context->signing_pool);
+
+	ret = jalp_context_load_pem_cert(context, TEST_CERT);
+	assert_equals(ret, JAL_OK);
+	assert_not_equals((void *) NULL, context->signing_pool);
 }
 
 void test_jalp_context_load_pem_rsa_suceeds_with_password_key()
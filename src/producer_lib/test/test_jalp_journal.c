@@ -96,6 +96,13 @@ enum jal_status jalp_send_buffer(jalp_context *jctx, uint16_t message_type,
 	return JAL_OK;
 }
 
+// jalp_batch.c sends through this, batches are not used here
+enum jal_status jalp_send_unbatched(jalp_context *jctx, uint16_t message_type,
+		void *data, uint64_t data_len, void *meta, uint64_t meta_len, int fd)
+{
+	return jalp_send_buffer(jctx, message_type, data, data_len, meta, meta_len, fd);
+}
+
 void setup()
 {
 	jalp_init();
@@ -0,0 +1,352 @@
+/**
+ * @file test_jalp_shm.c This file contains tests for jalp_shm.c functions.
+ *
+ * @section LICENSE
+ *
+ * Source code in 3rd-party is licensed and owned by their respective
+ * copyright holders.
+ *
+ * All other source code is copyright Tresys Technology and licensed as below.
+ *
+ * Copyright (c) 2012 Tresys Technology LLC, Columbia, Maryland, USA
+ *
+ * This software was developed by Tresys Technology LLC
+ * with U.S. Government sponsorship.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <test-dept.h>
+
+#include <jalop/jalp_context.h>
+#include <jalop/jal_version.h>
+#include "jal_shm_ring.h"
+#include "jalp_async_internal.h"
+#include "jalp_connection_internal.h"
+#include "jalp_context_internal.h"
+#include "jalp_shm_internal.h"
+
+#define SOCK_PATH "./test_jalp_shm.sock"
+#define SOME_HOST "some_host"
+#define SOME_APP "test_jalp_shm"
+#define SOME_SCHEMA_ROOT "/path/to/jalop/schemas"
+
+#define RECORD_LEN 1000
+#define SETUP_LEN (JAL_SHM_RING_FRAME_HEADER_LEN + 2 * JAL_SHM_RING_BREAK_LEN)
+#define SOCKET_FRAME_LEN (JAL_SHM_RING_FRAME_HEADER_LEN + RECORD_LEN + 2 * JAL_SHM_RING_BREAK_LEN)
+
+/** What the fake Local Store does with a ring */
+enum store_mode {
+	STORE_TAKE,
+	STORE_REFUSE,
+	STORE_HANG_UP,
+};
+
+struct store_args {
+	enum store_mode mode;
+	/** Records expected in the ring */
+	int ring_records;
+	/** Records expected on the socket afterwards */
+	int socket_records;
+	/** Set by the store: the records that did not match */
+	int bad_records;
+	/** Set by the store: whether the memfd had the expected seals */
+	int sealed;
+};
+
+static jalp_context *ctx;
+static int listen_fd;
+
+static void start_store()
+{
+	struct sockaddr_un addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strncpy(addr.sun_path, SOCK_PATH, sizeof(addr.sun_path) - 1);
+	listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	assert_not_equals(-1, listen_fd);
+	assert_equals(0, bind(listen_fd, (struct sockaddr *) &addr, sizeof(addr)));
+	assert_equals(0, listen(listen_fd, 1));
+}
+
+static void fill_record(char *rec, int i)
+{
+	memset(rec, 'a' + (i % 26), RECORD_LEN);
+	snprintf(rec, RECORD_LEN, "rec%05d", i);
+}
+
+static enum jal_status send_record(jalp_context *c, uint16_t type, int i)
+{
+	char rec[RECORD_LEN];
+	fill_record(rec, i);
+	return jalp_send_buffer(c, type, rec, RECORD_LEN, NULL, 0, -1);
+}
+
+static int check_record(uint16_t type, const uint8_t *data, uint64_t data_len,
+		uint64_t meta_len, uint16_t want_type, int i)
+{
+	char rec[RECORD_LEN];
+	fill_record(rec, i);
+	return want_type == type && RECORD_LEN == data_len && 0 == meta_len &&
+		0 == memcmp(rec, data, RECORD_LEN);
+}
+
+static int read_all(int fd, void *buf, size_t len)
+{
+	uint8_t *p = buf;
+	while (len > 0) {
+		ssize_t n = read(fd, p, len);
+		if (n <= 0) {
+			return -1;
+		}
+		p += n;
+		len -= n;
+	}
+	return 0;
+}
+
+static void store_ring(struct store_args *args, int fd)
+{
+	uint8_t msg[SETUP_LEN];
+	int fds[3];
+	char buffer[CMSG_SPACE(sizeof(fds))];
+	struct iovec iov = { msg, sizeof(msg) };
+	struct msghdr msgh;
+	memset(&msgh, 0, sizeof(msgh));
+	msgh.msg_iov = &iov;
+	msgh.msg_iovlen = 1;
+	msgh.msg_control = buffer;
+	msgh.msg_controllen = sizeof(buffer);
+	if (sizeof(msg) != recvmsg(fd, &msgh, MSG_WAITALL)) {
+		return;
+	}
+	uint16_t type;
+	memcpy(&type, msg + 2, sizeof(type));
+	struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msgh);
+	if (JALP_SHM_SETUP_MSG != type || !cmsg || cmsg->cmsg_len != CMSG_LEN(sizeof(fds))) {
+		return;
+	}
+	memcpy(fds, CMSG_DATA(cmsg), sizeof(fds));
+
+	int seals = fcntl(fds[0], F_GET_SEALS);
+	args->sealed = (F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) == seals;
+
+	uint8_t answer = 1;
+	if (STORE_HANG_UP == args->mode) {
+		goto out;
+	}
+	if (STORE_REFUSE == args->mode) {
+		if (1 != write(fd, &answer, 1)) {
+			args->bad_records++;
+		}
+		goto out;
+	}
+
+	struct stat st;
+	struct jal_shm_ring ring;
+	void *map = MAP_FAILED;
+	if (0 == fstat(fds[0], &st)) {
+		map = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fds[0], 0);
+	}
+	if (MAP_FAILED == map || 0 != jal_shm_ring_attach(&ring, map, st.st_size)) {
+		args->bad_records++;
+		goto out;
+	}
+	// So the first record rings the doorbell
+	jal_shm_ring_consumer_wait(&ring);
+	answer = 0;
+	if (1 != write(fd, &answer, 1)) {
+		args->bad_records++;
+		goto out;
+	}
+
+	uint64_t pos = ring.pos;
+	struct jal_shm_ring_frame frame;
+	int seen = 0;
+	while (seen < args->ring_records) {
+		int err = jal_shm_ring_next(&ring, &pos, &frame);
+		if (0 > err) {
+			args->bad_records += args->ring_records - seen;
+			break;
+		}
+		if (1 == err) {
+			if (!check_record(frame.message_type, frame.data, frame.data_len,
+					frame.meta_len, JALP_LOG_MSG, seen)) {
+				args->bad_records++;
+			}
+			seen++;
+			// Hand the space back one record at a time, so the
+			// producer has to wait for room.
+			if (jal_shm_ring_release(&ring, pos)) {
+				uint64_t one = 1;
+				if (-1 == write(fds[2], &one, sizeof(one))) {
+					break;
+				}
+			}
+			continue;
+		}
+		if (jal_shm_ring_consumer_wait(&ring)) {
+			struct pollfd pfd = { fds[1], POLLIN, 0 };
+			uint64_t count;
+			poll(&pfd, 1, -1);
+			if (-1 == read(fds[1], &count, sizeof(count))) {
+				// reset by an earlier read
+			}
+		}
+	}
+	munmap(map, st.st_size);
+
+out:
+	for (int i = 0; i < 3; i++) {
+		close(fds[i]);
+	}
+}
+
+static void *store(void *arg)
+{
+	struct store_args *args = arg;
+	int fd = accept(listen_fd, NULL, NULL);
+
+	store_ring(args, fd);
+	if (STORE_HANG_UP == args->mode) {
+		close(fd);
+		fd = accept(listen_fd, NULL, NULL);
+	}
+
+	for (int i = 0; i < args->socket_records; i++) {
+		uint8_t frame[SOCKET_FRAME_LEN];
+		uint16_t type;
+		uint64_t data_len;
+		uint64_t meta_len;
+		if (0 != read_all(fd, frame, sizeof(frame))) {
+			args->bad_records += args->socket_records - i;
+			break;
+		}
+		memcpy(&type, frame + 2, sizeof(type));
+		memcpy(&data_len, frame + 4, sizeof(data_len));
+		memcpy(&meta_len, frame + 12, sizeof(meta_len));
+		if (!check_record(type, frame + JAL_SHM_RING_FRAME_HEADER_LEN, data_len,
+				meta_len, JALP_JOURNAL_MSG, args->ring_records + i)) {
+			args->bad_records++;
+		}
+	}
+	close(fd);
+	return NULL;
+}
+
+void setup()
+{
+	unlink(SOCK_PATH);
+	listen_fd = -1;
+	ctx = jalp_context_create();
+	assert_equals(JAL_OK, jalp_context_init(ctx, SOCK_PATH, SOME_HOST, SOME_APP, SOME_SCHEMA_ROOT));
+}
+
+void teardown()
+{
+	jalp_context_destroy(&ctx);
+	if (-1 != listen_fd) {
+		close(listen_fd);
+	}
+	unlink(SOCK_PATH);
+}
+
+void test_enable_shm_fails_with_bad_input()
+{
+	jalp_context *uninit = jalp_context_create();
+	assert_equals(JAL_E_INVAL, jalp_context_enable_shm(NULL, 0));
+	assert_equals(JAL_E_UNINITIALIZED, jalp_context_enable_shm(uninit, 0));
+	assert_equals(JAL_E_INVAL, jalp_context_enable_shm(ctx, JAL_SHM_RING_MIN_SIZE / 2));
+	assert_equals(JAL_E_INVAL, jalp_context_enable_shm(ctx, JAL_SHM_RING_MIN_SIZE + 8));
+	assert_equals(JAL_E_INVAL, jalp_context_enable_shm(ctx, (size_t) JAL_SHM_RING_MAX_SIZE * 2));
+	assert_equals(0, ctx->shm_ring_size);
+	jalp_context_destroy(&uninit);
+}
+
+void test_enable_shm_fails_when_async()
+{
+	assert_equals(JAL_OK, jalp_context_enable_async(ctx, 0, JALP_ASYNC_BLOCK, NULL));
+	assert_equals(JAL_E_INVAL, jalp_context_enable_shm(ctx, 0));
+}
+
+void test_enable_shm_fails_without_local_store()
+{
+	assert_equals(JAL_E_NOT_CONNECTED, jalp_context_enable_shm(ctx, 0));
+	assert_equals((void *) NULL, ctx->shm);
+}
+
+void test_records_go_through_the_ring_then_journals_over_the_socket()
+{
+	pthread_t thread;
+	// Enough to go around the smallest ring a few times
+	struct store_args args = { STORE_TAKE, 300, 2, 0, 0 };
+
+	start_store();
+	assert_equals(0, pthread_create(&thread, NULL, store, &args));
+	assert_equals(JAL_OK, jalp_context_enable_shm(ctx, JAL_SHM_RING_MIN_SIZE));
+	assert_not_equals((void *) NULL, ctx->shm);
+
+	for (int i = 0; i < args.ring_records; i++) {
+		assert_equals(JAL_OK, send_record(ctx, JALP_LOG_MSG, i));
+	}
+	for (int i = 0; i < args.socket_records; i++) {
+		assert_equals(JAL_OK, send_record(ctx, JALP_JOURNAL_MSG, args.ring_records + i));
+	}
+	pthread_join(thread, NULL);
+
+	assert_true(args.sealed);
+	assert_equals(0, args.bad_records);
+}
+
+void test_refused_ring_keeps_the_socket()
+{
+	pthread_t thread;
+	struct store_args args = { STORE_REFUSE, 0, 1, 0, 0 };
+
+	start_store();
+	assert_equals(0, pthread_create(&thread, NULL, store, &args));
+	assert_equals(JAL_E_COMM, jalp_context_enable_shm(ctx, 0));
+	assert_equals((void *) NULL, ctx->shm);
+	assert_not_equals(-1, ctx->socket);
+	assert_equals(JAL_OK, send_record(ctx, JALP_JOURNAL_MSG, 0));
+	pthread_join(thread, NULL);
+
+	assert_true(args.sealed);
+	assert_equals(0, args.bad_records);
+}
+
+void test_local_store_that_hangs_up_is_reconnected()
+{
+	pthread_t thread;
+	struct store_args args = { STORE_HANG_UP, 0, 1, 0, 0 };
+
+	start_store();
+	assert_equals(0, pthread_create(&thread, NULL, store, &args));
+	assert_equals(JAL_E_COMM, jalp_context_enable_shm(ctx, 0));
+	assert_equals((void *) NULL, ctx->shm);
+	assert_equals(JAL_OK, send_record(ctx, JALP_JOURNAL_MSG, 0));
+	pthread_join(thread, NULL);
+
+	assert_equals(0, args.bad_records);
+}
@@ -0,0 +1,428 @@
+/**
+ * @file jal_shm_bench.c Benchmark comparing the socket and the shared memory
+ * ring for handing log records to the local store.
+ *
+ * @section LICENSE
+ *
+ * Source code in 3rd-party is licensed and owned by their respective
+ * copyright holders.
+ *
+ * All other source code is copyright Tresys Technology and licensed as below.
+ *
+ * Copyright (c) 2012 Tresys Technology LLC, Columbia, Maryland, USA
+ *
+ * This software was developed by Tresys Technology LLC
+ * with U.S. Government sponsorship.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+
+#include "jal_shm_ring.h"
+
+#define DEFAULT_RECORDS 1000000
+#define DEFAULT_RECORD_SIZE 256
+#define DEFAULT_RING_SIZE (4 * 1024 * 1024)
+#define DEFAULT_SAMPLES 20000
+/** Frames the consumer takes out of the ring before handing the space back */
+#define RELEASE_EVERY 64
+
+/** One side of the socket or the ring, shared by the two threads */
+struct bench_transport {
+	int shm;
+	/** Wait for each record to be taken before sending the next */
+	int ping_pong;
+	int records;
+	uint64_t record_size;
+	/** The socket, both ends */
+	int sv[2];
+	/** The ring, one view for each thread */
+	struct jal_shm_ring producer_ring;
+	struct jal_shm_ring consumer_ring;
+	void *map;
+	size_t map_len;
+	int data_efd;
+	int space_efd;
+	int err;
+};
+
+static void print_usage()
+{
+	static const char *usage =
+	"Usage:\n\
+	-n N, --records=N	Number of records sent for throughput. Defaults to 1000000.\n\
+	-s S, --size=S		Size of each record in bytes. Defaults to 256.\n\
+	-r R, --ring=R		Size of the ring in bytes, a power of two. Defaults to 4194304.\n\
+	-l N, --samples=N	Number of round trips timed for latency. Defaults to 20000.\n\n";
+
+	printf("%s\n", usage);
+}
+
+static double now_sec()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+	double x = *(const double *) a;
+	double y = *(const double *) b;
+	return (x > y) - (x < y);
+}
+
+static int write_all(int fd, const uint8_t *buf, size_t len)
+{
+	while (len > 0) {
+		ssize_t n = write(fd, buf, len);
+		if (n < 0 && EINTR == errno) {
+			continue;
+		}
+		if (n <= 0) {
+			return -1;
+		}
+		buf += n;
+		len -= n;
+	}
+	return 0;
+}
+
+static int read_all(int fd, uint8_t *buf, size_t len)
+{
+	while (len > 0) {
+		ssize_t n = read(fd, buf, len);
+		if (n < 0 && EINTR == errno) {
+			continue;
+		}
+		if (n <= 0) {
+			return -1;
+		}
+		buf += n;
+		len -= n;
+	}
+	return 0;
+}
+
+static void doorbell(int efd)
+{
+	uint64_t one = 1;
+	if (-1 == write(efd, &one, sizeof(one))) {
+		// the other side is awake anyway
+	}
+}
+
+static void wait_doorbell(int efd)
+{
+	struct pollfd pfd = { efd, POLLIN, 0 };
+	uint64_t count;
+	poll(&pfd, 1, -1);
+	if (-1 == read(efd, &count, sizeof(count))) {
+		// reset by an earlier read
+	}
+}
+
+/** Build a log record message the way the producer library lays it out */
+static void build_frame(uint8_t *frame, uint64_t record_size)
+{
+	uint16_t version = 1;
+	uint16_t type = 1;
+	uint64_t meta_len = 0;
+	memcpy(frame, &version, sizeof(version));
+	memcpy(frame + 2, &type, sizeof(type));
+	memcpy(frame + 4, &record_size, sizeof(record_size));
+	memcpy(frame + 12, &meta_len, sizeof(meta_len));
+	memset(frame + JAL_SHM_RING_FRAME_HEADER_LEN, 'x', record_size);
+	memcpy(frame + JAL_SHM_RING_FRAME_HEADER_LEN + record_size,
+		JAL_SHM_RING_BREAK_STR JAL_SHM_RING_BREAK_STR, 2 * JAL_SHM_RING_BREAK_LEN);
+}
+
+static int socket_send(struct bench_transport *t, const uint8_t *frame, size_t frame_len)
+{
+	if (0 != write_all(t->sv[0], frame, frame_len)) {
+		return -1;
+	}
+	if (t->ping_pong) {
+		uint8_t ack;
+		return read_all(t->sv[0], &ack, 1);
+	}
+	return 0;
+}
+
+static int shm_send(struct bench_transport *t, const uint8_t *frame, size_t frame_len)
+{
+	struct jal_shm_ring *ring = &t->producer_ring;
+	// Frames in the ring are padded for alignment
+	uint64_t ring_len = jal_shm_ring_frame_len(t->record_size, 0);
+	uint8_t *dst = NULL;
+	int err;
+
+	while (1 == (err = jal_shm_ring_reserve(ring, ring_len, &dst))) {
+		jal_shm_ring_producer_wait(ring);
+		err = jal_shm_ring_reserve(ring, ring_len, &dst);
+		if (1 != err) {
+			break;
+		}
+		wait_doorbell(t->space_efd);
+	}
+	if (0 != err) {
+		return -1;
+	}
+	memcpy(dst, frame, frame_len);
+	if (jal_shm_ring_commit(ring, ring_len)) {
+		doorbell(t->data_efd);
+	}
+	while (t->ping_pong && !jal_shm_ring_is_drained(ring)) {
+		jal_shm_ring_producer_wait(ring);
+		if (jal_shm_ring_is_drained(ring)) {
+			break;
+		}
+		wait_doorbell(t->space_efd);
+	}
+	return 0;
+}
+
+static void *socket_consumer(void *arg)
+{
+	struct bench_transport *t = arg;
+	uint64_t body_len = t->record_size + 2 * JAL_SHM_RING_BREAK_LEN;
+	uint8_t hdr[JAL_SHM_RING_FRAME_HEADER_LEN];
+	uint8_t *body = malloc(body_len);
+
+	for (int i = 0; i < t->records; i++) {
+		uint64_t data_len;
+		if (0 != read_all(t->sv[1], hdr, sizeof(hdr))) {
+			t->err = -1;
+			break;
+		}
+		memcpy(&data_len, hdr + 4, sizeof(data_len));
+		if (data_len != t->record_size || 0 != read_all(t->sv[1], body, body_len) ||
+				0 != memcmp(body + data_len, JAL_SHM_RING_BREAK_STR, JAL_SHM_RING_BREAK_LEN)) {
+			t->err = -1;
+			break;
+		}
+		if (t->ping_pong && 0 != write_all(t->sv[1], (const uint8_t *) "", 1)) {
+			t->err = -1;
+			break;
+		}
+	}
+	free(body);
+	return NULL;
+}
+
+static void *shm_consumer(void *arg)
+{
+	struct bench_transport *t = arg;
+	struct jal_shm_ring *ring = &t->consumer_ring;
+	struct jal_shm_ring_frame frame;
+	uint64_t pos = ring->pos;
+	int taken = 0;
+	int seen = 0;
+
+	while (seen < t->records) {
+		int err = jal_shm_ring_next(ring, &pos, &frame);
+		if (0 > err || (1 == err && frame.data_len != t->record_size)) {
+			t->err = -1;
+			break;
+		}
+		if (1 == err) {
+			seen++;
+			taken++;
+			if (taken < RELEASE_EVERY && !t->ping_pong) {
+				continue;
+			}
+		}
+		if (taken) {
+			if (jal_shm_ring_release(ring, pos)) {
+				doorbell(t->space_efd);
+			}
+			taken = 0;
+			continue;
+		}
+		if (jal_shm_ring_consumer_wait(ring)) {
+			wait_doorbell(t->data_efd);
+		}
+	}
+	if (taken && jal_shm_ring_release(ring, pos)) {
+		doorbell(t->space_efd);
+	}
+	return NULL;
+}
+
+static int transport_open(struct bench_transport *t, uint64_t ring_size)
+{
+	if (!t->shm) {
+		return socketpair(AF_UNIX, SOCK_STREAM, 0, t->sv);
+	}
+	// Both threads live in this process, so an anonymous shared mapping
+	// stands in for the memfd the producer library creates.
+	t->map_len = jal_shm_ring_map_size(ring_size);
+	t->map = mmap(NULL, t->map_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (MAP_FAILED == t->map || 0 != jal_shm_ring_init(&t->producer_ring, t->map, t->map_len) ||
+			0 != jal_shm_ring_attach(&t->consumer_ring, t->map, t->map_len)) {
+		return -1;
+	}
+	jal_shm_ring_consumer_wait(&t->consumer_ring);
+	t->data_efd = eventfd(0, EFD_NONBLOCK);
+	t->space_efd = eventfd(0, EFD_NONBLOCK);
+	return (-1 == t->data_efd || -1 == t->space_efd) ? -1 : 0;
+}
+
+static void transport_close(struct bench_transport *t)
+{
+	if (!t->shm) {
+		close(t->sv[0]);
+		close(t->sv[1]);
+		return;
+	}
+	munmap(t->map, t->map_len);
+	close(t->data_efd);
+	close(t->space_efd);
+}
+
+/**
+ * Send \p records records through the socket or the ring to a consumer
+ * thread. With \p samples, the time each record takes to be taken out is
+ * stored there.
+ */
+static int run(int shm, int records, uint64_t record_size, uint64_t ring_size,
+		double *samples, double *elapsed)
+{
+	struct bench_transport t;
+	memset(&t, 0, sizeof(t));
+	t.shm = shm;
+	t.ping_pong = NULL != samples;
+	t.records = records;
+	t.record_size = record_size;
+
+	size_t frame_len = JAL_SHM_RING_FRAME_HEADER_LEN + record_size + 2 * JAL_SHM_RING_BREAK_LEN;
+	uint8_t *frame = malloc(frame_len);
+	build_frame(frame, record_size);
+
+	if (0 != transport_open(&t, ring_size)) {
+		perror("failed to set up the transport");
+		free(frame);
+		return -1;
+	}
+
+	pthread_t consumer;
+	pthread_create(&consumer, NULL, shm ? shm_consumer : socket_consumer, &t);
+
+	int err = 0;
+	double start = now_sec();
+	for (int i = 0; i < records && 0 == err; i++) {
+		double sent = now_sec();
+		// Only the sending side of the ring may be touched here, the
+		// consumer has its own view.
+		err = shm ? shm_send(&t, frame, frame_len) : socket_send(&t, frame, frame_len);
+		if (samples) {
+			samples[i] = now_sec() - sent;
+		}
+	}
+	pthread_join(consumer, NULL);
+	*elapsed = now_sec() - start;
+
+	transport_close(&t);
+	free(frame);
+	if (0 != err || 0 != t.err) {
+		fprintf(stderr, "%s transport failed\n", shm ? "shm" : "socket");
+		return -1;
+	}
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	static const char *optstring = "n:s:r:l:";
+	static const struct option long_options[] = {
+		{"records", required_argument, NULL, 'n'},
+		{"size", required_argument, NULL, 's'},
+		{"ring", required_argument, NULL, 'r'},
+		{"samples", required_argument, NULL, 'l'},
+		{0, 0, 0, 0} };
+	int records = DEFAULT_RECORDS;
+	uint64_t record_size = DEFAULT_RECORD_SIZE;
+	uint64_t ring_size = DEFAULT_RING_SIZE;
+	int sample_count = DEFAULT_SAMPLES;
+	int opt;
+
+	while (EOF != (opt = getopt_long(argc, argv, optstring, long_options, NULL))) {
+		switch (opt) {
+		case 'n':
+			records = atoi(optarg);
+			break;
+		case 's':
+			record_size = strtoull(optarg, NULL, 10);
+			break;
+		case 'r':
+			ring_size = strtoull(optarg, NULL, 10);
+			break;
+		case 'l':
+			sample_count = atoi(optarg);
+			break;
+		default:
+			print_usage();
+			return EXIT_FAILURE;
+		}
+	}
+	uint64_t frame_len = jal_shm_ring_frame_len(record_size, 0);
+	if (records <= 0 || sample_count <= 0 || 0 == record_size ||
+			ring_size < JAL_SHM_RING_MIN_SIZE || ring_size > JAL_SHM_RING_MAX_SIZE ||
+			0 != (ring_size & (ring_size - 1)) ||
+			0 == frame_len || frame_len > ring_size / 2) {
+		print_usage();
+		return EXIT_FAILURE;
+	}
+
+	double *samples = malloc(sample_count * sizeof(*samples));
+	double mib = (double) records * record_size / (1024.0 * 1024.0);
+	int ret = EXIT_SUCCESS;
+
+	printf("%d records of %" PRIu64 " bytes, %" PRIu64 " byte ring, %d round trips\n",
+		records, record_size, ring_size, sample_count);
+	printf("%-10s %12s %10s %12s %12s\n", "transport", "records/s", "MiB/s", "mean rtt us", "p99 rtt us");
+	for (int shm = 0; shm <= 1; shm++) {
+		double elapsed;
+		double unused;
+		if (0 != run(shm, records, record_size, ring_size, NULL, &elapsed) ||
+				0 != run(shm, sample_count, record_size, ring_size, samples, &unused)) {
+			ret = EXIT_FAILURE;
+			break;
+		}
+		double total = 0;
+		for (int i = 0; i < sample_count; i++) {
+			total += samples[i];
+		}
+		qsort(samples, sample_count, sizeof(*samples), cmp_double);
+		printf("%-10s %12.0f %10.1f %12.2f %12.2f\n", shm ? "shm" : "socket",
+			records / elapsed, mib / elapsed, total / sample_count * 1e6,
+			samples[(int) (sample_count * 0.99)] * 1e6);
+	}
+
+	free(samples);
+	return ret;
+}
@@ -0,0 +1,272 @@
+/**
+ * @file jal_sign_bench.c Benchmark for signing XML documents, loading the key
+ * for every signature and reusing signing contexts from a jal_sign_pool.
+ *
+ * @section LICENSE
+ *
+ * Source code in 3rd-party is licensed and owned by their respective
+ * copyright holders.
+ *
+ * All other source code is copyright Tresys Technology and licensed as below.
+ *
+ * Copyright (c) 2012 Tresys Technology LLC, Columbia, Maryland, USA
+ *
+ * This software was developed by Tresys Technology LLC
+ * with U.S. Government sponsorship.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <getopt.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <libxml/tree.h>
+#include <openssl/bn.h>
+#include <openssl/pem.h>
+#include <openssl/rsa.h>
+#include <xmlsec/xmlsec.h>
+#include <xmlsec/crypto.h>
+
+#include <jalop/jal_status.h>
+#include "jal_xml_utils.h"
+
+#define DEFAULT_RECORDS 2000
+#define DEFAULT_THREADS 1
+#define KEY_BITS 2048
+#define ID_NS "http://www.w3.org/XML/1998/namespace"
+#define ID_STR "xml-id-1234"
+
+struct bench_thread {
+	pthread_t thread;
+	RSA *key;
+	X509 *cert;
+	struct jal_sign_pool *pool;	//!< NULL to load the key for every record
+	int records;
+	int err;
+};
+
+static void print_usage()
+{
+	static const char *usage =
+	"Usage:\n\
+	-k K, --key=K		PEM RSA private key to sign with. Defaults to a generated\n\
+				2048 bit key.\n\
+	-c C, --cert=C		PEM certificate to add to the signatures. Defaults to none.\n\
+	-r N, --records=N	Number of records each thread signs. Defaults to 2000.\n\
+	-t N, --threads=N	Number of threads signing at once. Defaults to 1.\n\n";
+
+	printf("%s\n", usage);
+}
+
+static double now_sec()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static RSA *generate_key()
+{
+	RSA *rsa = RSA_new();
+	BIGNUM *e = BN_new();
+	if (!rsa || !e || !BN_set_word(e, RSA_F4) ||
+			!RSA_generate_key_ex(rsa, KEY_BITS, e, NULL)) {
+		RSA_free(rsa);
+		rsa = NULL;
+	}
+	BN_free(e);
+	return rsa;
+}
+
+// About the size of a record's system metadata
+static xmlDocPtr build_doc()
+{
+	xmlDocPtr doc = xmlNewDoc((xmlChar *)"1.0");
+	xmlNodePtr root = xmlNewDocNode(doc, NULL, (xmlChar *)"JALRecord", NULL);
+	xmlNsPtr ns = xmlNewNs(root, (xmlChar *)ID_NS, NULL);
+	xmlSetNs(root, ns);
+	xmlSetProp(root, (xmlChar *)"xml:id", (xmlChar *)ID_STR);
+	xmlDocSetRootElement(doc, root);
+	xmlNewChild(root, NULL, (xmlChar *)"JALDataType", (xmlChar *)"log");
+	xmlNewChild(root, NULL, (xmlChar *)"RecordID", (xmlChar *)"4f0ae1a0-6d4c-4b2a-9f33-2a2d9c2e5b1e");
+	xmlNewChild(root, NULL, (xmlChar *)"Hostname", (xmlChar *)"bench.example.com");
+	xmlNewChild(root, NULL, (xmlChar *)"HostUUID", (xmlChar *)"9a1c2b6e-2f0d-4a57-8d0b-6a5e4f3c2d1b");
+	xmlNewChild(root, NULL, (xmlChar *)"Timestamp", (xmlChar *)"2012-01-01T00:00:00.000000+00:00");
+	xmlNewChild(root, NULL, (xmlChar *)"ProcessID", (xmlChar *)"1234");
+	return doc;
+}
+
+static void *sign_records(void *arg)
+{
+	struct bench_thread *bt = (struct bench_thread *)arg;
+	for (int i = 0; i < bt->records; i++) {
+		xmlDocPtr doc = build_doc();
+		enum jal_status ret;
+		if (bt->pool) {
+			ret = jal_sign_pool_add_signature_block(bt->pool, doc, NULL, ID_STR);
+		} else {
+			ret = jal_add_signature_block(bt->key, bt->cert, doc, NULL, ID_STR);
+		}
+		xmlFreeDoc(doc);
+		if (JAL_OK != ret) {
+			bt->err = -1;
+			break;
+		}
+	}
+	return NULL;
+}
+
+static int run(const char *name, RSA *key, X509 *cert, int use_pool,
+		int records, int threads)
+{
+	struct bench_thread *bts = calloc(threads, sizeof(*bts));
+	struct jal_sign_pool *pool = NULL;
+	int err = 0;
+
+	if (use_pool) {
+		pool = jal_sign_pool_create(key, cert);
+		if (!pool) {
+			fprintf(stderr, "failed to create the signing pool\n");
+			free(bts);
+			return -1;
+		}
+	}
+
+	double start = now_sec();
+	for (int i = 0; i < threads; i++) {
+		bts[i].key = key;
+		bts[i].cert = cert;
+		bts[i].pool = pool;
+		bts[i].records = records;
+		if (0 != pthread_create(&bts[i].thread, NULL, sign_records, &bts[i])) {
+			perror("pthread_create");
+			threads = i;
+			err = -1;
+			break;
+		}
+	}
+	for (int i = 0; i < threads; i++) {
+		pthread_join(bts[i].thread, NULL);
+		err |= bts[i].err;
+	}
+	double elapsed = now_sec() - start;
+
+	jal_sign_pool_destroy(&pool);
+	free(bts);
+	if (0 != err) {
+		fprintf(stderr, "signing failed\n");
+		return -1;
+	}
+
+	double total = (double)records * threads;
+	printf("%-16s %10.3f %12.1f\n", name, elapsed * 1000, total / elapsed);
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	static const char *optstring = "k:c:r:t:";
+	static const struct option long_options[] = {
+		{"key", required_argument, NULL, 'k'},
+		{"cert", required_argument, NULL, 'c'},
+		{"records", required_argument, NULL, 'r'},
+		{"threads", required_argument, NULL, 't'},
+		{0, 0, 0, 0} };
+	const char *key_path = NULL;
+	const char *cert_path = NULL;
+	int records = DEFAULT_RECORDS;
+	int threads = DEFAULT_THREADS;
+	RSA *key = NULL;
+	X509 *cert = NULL;
+	FILE *fp = NULL;
+	int ret = EXIT_FAILURE;
+	int opt;
+
+	while (EOF != (opt = getopt_long(argc, argv, optstring, long_options, NULL))) {
+		switch (opt) {
+		case 'k':
+			key_path = optarg;
+			break;
+		case 'c':
+			cert_path = optarg;
+			break;
+		case 'r':
+			records = atoi(optarg);
+			break;
+		case 't':
+			threads = atoi(optarg);
+			break;
+		default:
+			print_usage();
+			return EXIT_FAILURE;
+		}
+	}
+	if (records <= 0 || threads <= 0) {
+		print_usage();
+		return EXIT_FAILURE;
+	}
+
+	if (key_path) {
+		fp = fopen(key_path, "r");
+		if (!fp) {
+			perror("failed to open the key");
+			return EXIT_FAILURE;
+		}
+		key = PEM_read_RSAPrivateKey(fp, NULL, NULL, NULL);
+		fclose(fp);
+	} else {
+		key = generate_key();
+	}
+	if (!key) {
+		fprintf(stderr, "failed to load the key\n");
+		return EXIT_FAILURE;
+	}
+	if (cert_path) {
+		fp = fopen(cert_path, "r");
+		if (!fp) {
+			perror("failed to open the certificate");
+			goto out;
+		}
+		cert = PEM_read_X509(fp, NULL, NULL, NULL);
+		fclose(fp);
+		if (!cert) {
+			fprintf(stderr, "failed to load the certificate\n");
+			goto out;
+		}
+	}
+
+	xmlInitParser();
+	xmlSecInit();
+	xmlSecCryptoAppInit(NULL);
+	xmlSecCryptoInit();
+
+	printf("%d records per thread, %d threads%s\n", records, threads,
+		cert ? ", with certificate" : "");
+	printf("%-16s %10s %12s\n", "method", "ms", "records/s");
+	if (0 == run("load per record", key, cert, 0, records, threads) &&
+			0 == run("sign pool", key, cert, 1, records, threads)) {
+		ret = EXIT_SUCCESS;
+	}
+
+	xmlSecCryptoShutdown();
+	xmlSecCryptoAppShutdown();
+	xmlSecShutdown();
+	xmlCleanupParser();
+out:
+	X509_free(cert);
+	RSA_free(key);
+	return ret;
+}
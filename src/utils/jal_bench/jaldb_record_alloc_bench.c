@@ -0,0 +1,220 @@
+/**
+ * @file jaldb_record_alloc_bench.c Benchmark for the heap allocations made
+ * while building, deserializing and destroying a jaldb_record, with its
+ * members allocated one by one or from an arena.
+ *
+ * @section LICENSE
+ *
+ * Source code in 3rd-party is licensed and owned by their respective
+ * copyright holders.
+ *
+ * All other source code is copyright Tresys Technology and licensed as below.
+ *
+ * Copyright (c) 2012 Tresys Technology LLC, Columbia, Maryland, USA
+ *
+ * This software was developed by Tresys Technology LLC
+ * with U.S. Government sponsorship.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <getopt.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <uuid/uuid.h>
+
+#include "jal_alloc.h"
+#include "jaldb_record.h"
+#include "jaldb_segment.h"
+#include "jaldb_serialize_record.h"
+
+#define DEFAULT_RECORDS 200000
+#define SYS_META_LEN 1500
+#define APP_META_LEN 300
+#define PAYLOAD_LEN 200
+
+// The benchmark counts heap allocations by providing malloc() and friends
+// itself, for the whole process, including the db layer library.
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void __libc_free(void *ptr);
+
+static unsigned long alloc_count;
+
+void *malloc(size_t size)
+{
+	alloc_count++;
+	return __libc_malloc(size);
+}
+
+void *calloc(size_t nmemb, size_t size)
+{
+	alloc_count++;
+	return __libc_calloc(nmemb, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+	alloc_count++;
+	return __libc_realloc(ptr, size);
+}
+
+void free(void *ptr)
+{
+	__libc_free(ptr);
+}
+
+enum method {
+	METHOD_MALLOC,
+	METHOD_ARENA,
+	METHOD_DESERIALIZE,
+};
+
+static uint8_t sys_meta[SYS_META_LEN];
+static uint8_t app_meta[APP_META_LEN];
+static uint8_t payload[PAYLOAD_LEN];
+static uuid_t host_uuid;
+
+static void print_usage()
+{
+	static const char *usage =
+	"Usage:\n\
+	-r N, --records=N	Number of records to build. Defaults to 200000.\n\n";
+
+	printf("%s\n", usage);
+}
+
+static double now_sec()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static struct jaldb_segment *make_segment(struct jaldb_record *rec,
+		const uint8_t *buf, uint64_t len)
+{
+	struct jaldb_segment *seg = jaldb_record_create_segment(rec);
+	seg->payload = jaldb_record_alloc(rec, len);
+	memcpy(seg->payload, buf, len);
+	seg->length = len;
+	return seg;
+}
+
+// A record like the ones the local store inserts
+static struct jaldb_record *make_record(int arena)
+{
+	struct jaldb_record *rec = arena ? jaldb_create_arena_record() : jaldb_create_record();
+	rec->type = JALDB_RTYPE_LOG;
+	rec->source = jaldb_record_strdup(rec, "localhost");
+	rec->hostname = jaldb_record_strdup(rec, "bench.example.com");
+	rec->timestamp = jaldb_record_strdup(rec, "2012-12-12T09:00:00.000000+00:00");
+	rec->username = jaldb_record_strdup(rec, "root");
+	rec->sec_lbl = jaldb_record_strdup(rec, "system_u:system_r:bench_t:s0");
+	rec->network_nonce = jaldb_record_strdup(rec, "1b4e28ba-2fa1-11d2-883f-b9a761bde3fb");
+	rec->pid = 1234;
+	rec->uid = 0;
+	rec->have_uid = 1;
+	uuid_copy(rec->uuid, host_uuid);
+	uuid_copy(rec->host_uuid, host_uuid);
+	rec->sys_meta = make_segment(rec, sys_meta, SYS_META_LEN);
+	rec->app_meta = make_segment(rec, app_meta, APP_META_LEN);
+	rec->payload = make_segment(rec, payload, PAYLOAD_LEN);
+	return rec;
+}
+
+static int run(const char *name, enum method m, uint8_t *buf, size_t bsize,
+		int records)
+{
+	unsigned long allocs = alloc_count;
+	double start = now_sec();
+	for (int i = 0; i < records; i++) {
+		struct jaldb_record *rec = NULL;
+		if (METHOD_DESERIALIZE == m) {
+			if (JALDB_OK != jaldb_deserialize_record(0, buf, bsize, &rec)) {
+				fprintf(stderr, "%s: failed to deserialize the record\n", name);
+				return -1;
+			}
+		} else {
+			rec = make_record(METHOD_ARENA == m);
+		}
+		jaldb_destroy_record(&rec);
+	}
+	double elapsed = now_sec() - start;
+	allocs = alloc_count - allocs;
+
+	printf("%-16s %10.3f %12.1f %10.2f %14.2f\n", name, elapsed * 1000,
+		records / elapsed, elapsed * 1e9 / records,
+		(double) allocs / records);
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	static const char *optstring = "r:";
+	static const struct option long_options[] = {
+		{"records", required_argument, NULL, 'r'},
+		{0, 0, 0, 0} };
+	int records = DEFAULT_RECORDS;
+	int ret = EXIT_FAILURE;
+	int opt;
+
+	while (EOF != (opt = getopt_long(argc, argv, optstring, long_options, NULL))) {
+		switch (opt) {
+		case 'r':
+			records = atoi(optarg);
+			break;
+		default:
+			print_usage();
+			return EXIT_FAILURE;
+		}
+	}
+	if (records <= 0) {
+		print_usage();
+		return EXIT_FAILURE;
+	}
+
+	memset(sys_meta, 's', sizeof(sys_meta));
+	memset(app_meta, 'a', sizeof(app_meta));
+	memset(payload, 'p', sizeof(payload));
+	uuid_generate(host_uuid);
+
+	// The serialized form of the record, as it is read back from the
+	// primary database.
+	uint8_t *buf = NULL;
+	size_t bsize = 0;
+	struct jaldb_record *rec = make_record(0);
+	enum jaldb_status db_err = jaldb_serialize_record(0, rec, &buf, &bsize);
+	jaldb_destroy_record(&rec);
+	if (JALDB_OK != db_err) {
+		fprintf(stderr, "failed to serialize the record\n");
+		goto out;
+	}
+
+	printf("%d records, %zu bytes serialized\n", records, bsize);
+	printf("%-16s %10s %12s %10s %14s\n", "method", "ms", "records/s",
+		"ns/record", "allocs/record");
+	if (0 == run("malloc", METHOD_MALLOC, buf, bsize, records) &&
+			0 == run("arena", METHOD_ARENA, buf, bsize, records) &&
+			0 == run("deserialize", METHOD_DESERIALIZE, buf, bsize, records)) {
+		ret = EXIT_SUCCESS;
+	}
+
+out:
+	free(buf);
+	return ret;
+}
@@ -0,0 +1,207 @@
+/**
+ * @file jaldb_sys_meta_bench.c Benchmark for generating system metadata
+ * documents, building them with libxml2 and writing them straight to a
+ * buffer.
+ *
+ * @section LICENSE
+ *
+ * Source code in 3rd-party is licensed and owned by their respective
+ * copyright holders.
+ *
+ * All other source code is copyright Tresys Technology and licensed as below.
+ *
+ * Copyright (c) 2012 Tresys Technology LLC, Columbia, Maryland, USA
+ *
+ * This software was developed by Tresys Technology LLC
+ * with U.S. Government sponsorship.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <uuid/uuid.h>
+#include <libxml/parser.h>
+
+#include <jalop/jal_digest.h>
+
+#include "jal_alloc.h"
+#include "jaldb_record.h"
+#include "jaldb_record_xml.h"
+#include "jaldb_segment.h"
+#include "jaldb_xml_writer.h"
+
+#define DEFAULT_RECORDS 200000
+#define DGST_LEN 32
+
+enum method {
+	METHOD_DOM,
+	METHOD_DOC,
+	METHOD_WRITER,
+};
+
+static void print_usage()
+{
+	static const char *usage =
+	"Usage:\n\
+	-r N, --records=N	Number of documents to generate. Defaults to 200000.\n\
+	-m, --manifest		Include payload and application metadata digests.\n\n";
+
+	printf("%s\n", usage);
+}
+
+static double now_sec()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// A record like the ones the local store inserts
+static struct jaldb_record *make_record()
+{
+	struct jaldb_record *rec = jaldb_create_record();
+	rec->version = JALDB_RECORD_VERSION;
+	rec->type = JALDB_RTYPE_LOG;
+	rec->source = jal_strdup("localhost");
+	rec->hostname = jal_strdup("bench.example.com");
+	rec->timestamp = jal_strdup("2012-12-12T09:00:00.000000+00:00");
+	rec->username = jal_strdup("root");
+	rec->pid = 1234;
+	rec->uid = 0;
+	rec->have_uid = 1;
+	uuid_generate(rec->uuid);
+	uuid_generate(rec->host_uuid);
+	rec->payload = jaldb_create_segment();
+	rec->payload->payload = (uint8_t *) jal_strdup("payload");
+	rec->payload->length = strlen("payload");
+	return rec;
+}
+
+static enum jaldb_status generate(enum method m, struct jaldb_record *rec,
+		uint8_t *dgst, struct jaldb_xml_writer *w, char **doc, size_t *dsize)
+{
+	const char *alg = dgst ? JAL_SHA256_ALGORITHM_URI : NULL;
+	switch (m) {
+	case METHOD_DOM:
+		return jaldb_record_to_system_metadata_dom(rec, NULL,
+				dgst, DGST_LEN, alg, dgst, DGST_LEN, alg, doc, dsize);
+	case METHOD_DOC:
+		return jaldb_record_to_system_metadata_doc(rec, NULL,
+				dgst, DGST_LEN, alg, dgst, DGST_LEN, alg, doc, dsize);
+	case METHOD_WRITER:
+	default:
+		jaldb_xml_writer_reset(w);
+		return jaldb_record_to_system_metadata_write(rec,
+				dgst, DGST_LEN, alg, dgst, DGST_LEN, alg, w);
+	}
+}
+
+static int run(const char *name, enum method m, struct jaldb_record *rec,
+		uint8_t *dgst, int records)
+{
+	struct jaldb_xml_writer w;
+	jaldb_xml_writer_init(&w, 0);
+
+	double start = now_sec();
+	for (int i = 0; i < records; i++) {
+		char *doc = NULL;
+		size_t dsize = 0;
+		if (JALDB_OK != generate(m, rec, dgst, &w, &doc, &dsize)) {
+			fprintf(stderr, "%s: failed to generate the document\n", name);
+			jaldb_xml_writer_free(&w);
+			return -1;
+		}
+		free(doc);
+	}
+	double elapsed = now_sec() - start;
+	jaldb_xml_writer_free(&w);
+
+	printf("%-16s %10.3f %12.1f %10.2f\n", name, elapsed * 1000,
+		records / elapsed, elapsed * 1e9 / records);
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	static const char *optstring = "r:m";
+	static const struct option long_options[] = {
+		{"records", required_argument, NULL, 'r'},
+		{"manifest", no_argument, NULL, 'm'},
+		{0, 0, 0, 0} };
+	int records = DEFAULT_RECORDS;
+	int manifest = 0;
+	uint8_t dgst_buf[DGST_LEN];
+	uint8_t *dgst = NULL;
+	int ret = EXIT_FAILURE;
+	int opt;
+
+	while (EOF != (opt = getopt_long(argc, argv, optstring, long_options, NULL))) {
+		switch (opt) {
+		case 'r':
+			records = atoi(optarg);
+			break;
+		case 'm':
+			manifest = 1;
+			break;
+		default:
+			print_usage();
+			return EXIT_FAILURE;
+		}
+	}
+	if (records <= 0) {
+		print_usage();
+		return EXIT_FAILURE;
+	}
+
+	if (manifest) {
+		for (int i = 0; i < DGST_LEN; i++) {
+			dgst_buf[i] = (uint8_t) (i * 37);
+		}
+		dgst = dgst_buf;
+	}
+
+	xmlInitParser();
+	struct jaldb_record *rec = make_record();
+
+	// Make sure both paths agree before timing them
+	char *dom_doc = NULL;
+	size_t dom_size = 0;
+	struct jaldb_xml_writer w;
+	jaldb_xml_writer_init(&w, 0);
+	if (JALDB_OK != generate(METHOD_DOM, rec, dgst, NULL, &dom_doc, &dom_size) ||
+			JALDB_OK != generate(METHOD_WRITER, rec, dgst, &w, NULL, NULL) ||
+			dom_size != w.len || 0 != memcmp(dom_doc, w.buf, dom_size)) {
+		fprintf(stderr, "the writer and libxml2 documents differ\n");
+		goto out;
+	}
+
+	printf("%d records%s, %zu byte documents\n", records,
+		manifest ? " with a manifest" : "", dom_size);
+	printf("%-16s %10s %12s %10s\n", "method", "ms", "records/s", "ns/record");
+	if (0 == run("libxml2 DOM", METHOD_DOM, rec, dgst, records) &&
+			0 == run("writer", METHOD_DOC, rec, dgst, records) &&
+			0 == run("writer, reused", METHOD_WRITER, rec, dgst, records)) {
+		ret = EXIT_SUCCESS;
+	}
+
+out:
+	free(dom_doc);
+	jaldb_xml_writer_free(&w);
+	jaldb_destroy_record(&rec);
+	xmlCleanupParser();
+	return ret;
+}
@@ -0,0 +1,298 @@
+/**
+ * @file jaldb_timestamp_bench.c Benchmark for the timestamp indices of the
+ * JALoP database.
+ *
+ * @section LICENSE
+ *
+ * Source code in 3rd-party is licensed and owned by their respective
+ * copyright holders.
+ *
+ * All other source code is copyright Tresys Technology and licensed as below.
+ *
+ * Copyright (c) 2012 Tresys Technology LLC, Columbia, Maryland, USA
+ *
+ * This software was developed by Tresys Technology LLC
+ * with U.S. Government sponsorship.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <db.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <libxml/xmlschemastypes.h>
+
+#include "jaldb_datetime.h"
+#include "jaldb_serialize_record.h"
+
+#define DEFAULT_RECORDS 200000
+#define DEFAULT_SCANS 1000
+#define DEFAULT_SCAN_LEN 100
+#define CACHE_SIZE (64 * 1024 * 1024)
+/* Large enough for the headers followed by a timestamp */
+#define RECORD_BUF_LEN (sizeof(struct jaldb_serialize_record_headers) + 64)
+
+struct index_kind {
+	const char *name;
+	const char *file;
+	int (*compare)(DB *, const DBT *, const DBT *);
+	int (*extract)(DB *, const DBT *, const DBT *, DBT *);
+};
+
+static const struct index_kind kinds[] = {
+	{ "xml datetime", "jaldb_timestamp_bench_xml.db",
+		jaldb_xml_datetime_compare, jaldb_extract_datetime_key },
+	{ "binary", "jaldb_timestamp_bench_bin.db",
+		jaldb_timestamp_key_compare, jaldb_extract_datetime_bin_key },
+};
+
+static void print_usage()
+{
+	static const char *usage =
+	"Usage:\n\
+	-d D, --dir=D		Directory to create the index files in. Defaults to the\n\
+				current directory.\n\
+	-n N, --records=N	Number of records to index. Defaults to 200000.\n\
+	-s S, --scans=S		Number of range scans. Defaults to 1000.\n\
+	-l L, --length=L	Number of records read by each range scan. Defaults to 100.\n\n";
+
+	printf("%s\n", usage);
+}
+
+static double now_sec()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Timestamps in the format the local store generates, spread over a day. */
+static void make_timestamp(char *buf, size_t len, uint64_t usec)
+{
+	time_t secs = (time_t)(1355302800 + usec / 1000000);
+	struct tm tm;
+	gmtime_r(&secs, &tm);
+	size_t off = strftime(buf, len, "%Y-%m-%dT%H:%M:%S", &tm);
+	snprintf(buf + off, len - off, ".%06" PRIu64, usec % 1000000);
+}
+
+static void make_record(uint8_t *buf, uint64_t usec)
+{
+	struct jaldb_serialize_record_headers *headers =
+		(struct jaldb_serialize_record_headers *) buf;
+	memset(buf, 0, RECORD_BUF_LEN);
+	headers->version = JALDB_DB_LAYOUT_VERSION;
+	make_timestamp((char *)(buf + sizeof(*headers)), RECORD_BUF_LEN - sizeof(*headers), usec);
+}
+
+static DB *open_index(const char *dir, const struct index_kind *kind)
+{
+	char path[4096];
+	DB *db = NULL;
+
+	snprintf(path, sizeof(path), "%s/%s", dir, kind->file);
+	unlink(path);
+	if (0 != db_create(&db, NULL, 0) ||
+			0 != db->set_cachesize(db, 0, CACHE_SIZE, 1) ||
+			0 != db->set_flags(db, DB_DUP | DB_DUPSORT) ||
+			0 != db->set_bt_compare(db, kind->compare) ||
+			0 != db->open(db, NULL, path, NULL, DB_BTREE, DB_CREATE, 0600)) {
+		if (db) {
+			db->close(db, 0);
+		}
+		return NULL;
+	}
+	return db;
+}
+
+/*
+ * Index the records the way a secondary index does: extract the key from the
+ * serialized record, then insert it with the primary key as the data.
+ */
+static int run_inserts(DB *db, const struct index_kind *kind, const uint64_t *times,
+		uint64_t records, double *elapsed)
+{
+	uint8_t buf[RECORD_BUF_LEN];
+	DBT key;
+	DBT pkey;
+	DBT data;
+	memset(&data, 0, sizeof(data));
+	data.data = buf;
+	data.size = RECORD_BUF_LEN;
+
+	double start = now_sec();
+	for (uint64_t i = 0; i < records; i++) {
+		make_record(buf, times[i]);
+		memset(&key, 0, sizeof(key));
+		memset(&pkey, 0, sizeof(pkey));
+		pkey.data = &i;
+		pkey.size = sizeof(i);
+		if (0 != kind->extract(db, &pkey, &data, &key)) {
+			fprintf(stderr, "failed to extract the key\n");
+			return -1;
+		}
+		int db_ret = db->put(db, NULL, &key, &pkey, 0);
+		if (key.flags & DB_DBT_APPMALLOC) {
+			free(key.data);
+		}
+		if (0 != db_ret) {
+			fprintf(stderr, "put failed: %s\n", db_strerror(db_ret));
+			return -1;
+		}
+	}
+	*elapsed = now_sec() - start;
+	return 0;
+}
+
+static int run_scans(DB *db, const struct index_kind *kind, uint64_t records,
+		uint64_t scans, uint64_t scan_len, double *elapsed, uint64_t *read)
+{
+	uint8_t buf[RECORD_BUF_LEN];
+	DBC *cursor = NULL;
+	DBT key;
+	DBT val;
+	DBT rec;
+	memset(&rec, 0, sizeof(rec));
+	rec.data = buf;
+	rec.size = RECORD_BUF_LEN;
+	*read = 0;
+
+	double start = now_sec();
+	for (uint64_t i = 0; i < scans; i++) {
+		DBT search;
+		memset(&search, 0, sizeof(search));
+		// Search keys are built the same way the readers build them.
+		make_record(buf, (uint64_t)rand() % records * 10);
+		if (0 != kind->extract(db, NULL, &rec, &search)) {
+			return -1;
+		}
+		if (0 != db->cursor(db, NULL, &cursor, 0)) {
+			free(search.data);
+			return -1;
+		}
+		memset(&key, 0, sizeof(key));
+		memset(&val, 0, sizeof(val));
+		key.data = search.data;
+		key.size = search.size;
+		int db_ret = cursor->c_get(cursor, &key, &val, DB_SET_RANGE);
+		for (uint64_t n = 0; 0 == db_ret && n < scan_len; n++) {
+			(*read)++;
+			db_ret = cursor->c_get(cursor, &key, &val, DB_NEXT);
+		}
+		cursor->c_close(cursor);
+		free(search.data);
+		if (0 != db_ret && DB_NOTFOUND != db_ret) {
+			fprintf(stderr, "scan failed: %s\n", db_strerror(db_ret));
+			return -1;
+		}
+	}
+	*elapsed = now_sec() - start;
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	static const char *optstring = "d:n:s:l:";
+	static const struct option long_options[] = {
+		{"dir", required_argument, NULL, 'd'},
+		{"records", required_argument, NULL, 'n'},
+		{"scans", required_argument, NULL, 's'},
+		{"length", required_argument, NULL, 'l'},
+		{0, 0, 0, 0} };
+	const char *dir = ".";
+	uint64_t records = DEFAULT_RECORDS;
+	uint64_t scans = DEFAULT_SCANS;
+	uint64_t scan_len = DEFAULT_SCAN_LEN;
+	int ret = EXIT_SUCCESS;
+	int opt;
+
+	while (EOF != (opt = getopt_long(argc, argv, optstring, long_options, NULL))) {
+		switch (opt) {
+		case 'd':
+			dir = optarg;
+			break;
+		case 'n':
+			records = strtoull(optarg, NULL, 10);
+			break;
+		case 's':
+			scans = strtoull(optarg, NULL, 10);
+			break;
+		case 'l':
+			scan_len = strtoull(optarg, NULL, 10);
+			break;
+		default:
+			print_usage();
+			return EXIT_FAILURE;
+		}
+	}
+	if (0 == records) {
+		print_usage();
+		return EXIT_FAILURE;
+	}
+
+	xmlSchemaInitTypes();
+
+	// Records arrive roughly in time order with some reordering between
+	// producers, shuffle a window of timestamps 10us apart.
+	uint64_t *times = malloc(records * sizeof(*times));
+	for (uint64_t i = 0; i < records; i++) {
+		times[i] = i * 10;
+	}
+	for (uint64_t i = 0; i < records; i++) {
+		uint64_t j = i + (uint64_t)rand() % 64;
+		if (j < records) {
+			uint64_t tmp = times[i];
+			times[i] = times[j];
+			times[j] = tmp;
+		}
+	}
+
+	printf("%" PRIu64 " records, %" PRIu64 " scans of %" PRIu64 " records\n",
+		records, scans, scan_len);
+	printf("%-14s %12s %12s\n", "index", "inserts/s", "scanned/s");
+	for (size_t k = 0; k < sizeof(kinds) / sizeof(kinds[0]); k++) {
+		double insert_time = 0;
+		double scan_time = 0;
+		uint64_t read = 0;
+		char path[4096];
+
+		DB *db = open_index(dir, &kinds[k]);
+		if (!db) {
+			fprintf(stderr, "failed to create %s/%s\n", dir, kinds[k].file);
+			ret = EXIT_FAILURE;
+			break;
+		}
+		srand(1);
+		if (0 != run_inserts(db, &kinds[k], times, records, &insert_time) ||
+				0 != run_scans(db, &kinds[k], records, scans, scan_len, &scan_time, &read)) {
+			ret = EXIT_FAILURE;
+		}
+		db->close(db, 0);
+		snprintf(path, sizeof(path), "%s/%s", dir, kinds[k].file);
+		unlink(path);
+		if (EXIT_SUCCESS != ret) {
+			break;
+		}
+		printf("%-14s %12.0f %12.0f\n", kinds[k].name, records / insert_time,
+			scan_time > 0 ? read / scan_time : 0);
+	}
+
+	free(times);
+	xmlSchemaCleanupTypes();
+	return ret;
+}
@@ -0,0 +1,199 @@
+/**
+ * @file jalls_ingest_bench.c Benchmark for copying journal files passed by
+ * descriptor into the local store.
+ *
+ * @section LICENSE
+ *
+ * Source code in 3rd-party is licensed and owned by their respective
+ * copyright holders.
+ *
+ * All other source code is copyright Tresys Technology and licensed as below.
+ *
+ * Copyright (c) 2012 Tresys Technology LLC, Columbia, Maryland, USA
+ *
+ * This software was developed by Tresys Technology LLC
+ * with U.S. Government sponsorship.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <fcntl.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <jalop/jal_digest.h>
+#include "jalls_journal_copy.h"
+
+#define DEFAULT_SIZE_MB 256
+#define DEFAULT_ITERATIONS 5
+#define FILL_BUF_LEN (1024 * 1024)
+
+static void print_usage()
+{
+	static const char *usage =
+	"Usage:\n\
+	-d D, --dir=D		Directory to create the test files in, should be on the same\n\
+				file system as the JALoP database. Defaults to the current directory.\n\
+	-s S, --size=S		Size of the journal in MiB. Defaults to 256.\n\
+	-i N, --iterations=N	Number of copies timed for each method. Defaults to 5.\n\
+	-c, --drop-cache	Evict the journal from the page cache before each copy.\n\n";
+
+	printf("%s\n", usage);
+}
+
+static double now_sec()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int create_journal(const char *path, uint64_t size)
+{
+	int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+	if (fd < 0) {
+		return -1;
+	}
+	char *buf = malloc(FILL_BUF_LEN);
+	for (size_t i = 0; i < FILL_BUF_LEN; i++) {
+		buf[i] = (char)rand();
+	}
+	uint64_t written = 0;
+	while (written < size) {
+		size_t len = (size - written < FILL_BUF_LEN) ? size - written : FILL_BUF_LEN;
+		if ((ssize_t)len != write(fd, buf, len)) {
+			free(buf);
+			close(fd);
+			return -1;
+		}
+		written += len;
+	}
+	free(buf);
+	fsync(fd);
+	return fd;
+}
+
+static int run(const char *dst_path, int src_fd, uint64_t size, int zero_copy,
+		int iterations, int drop_cache)
+{
+	enum jal_digest_algorithm alg = JAL_DIGEST_ALGORITHM_SHA256;
+	enum jalls_copy_method method = JALLS_COPY_READ_WRITE;
+	double best = 0;
+	double total = 0;
+
+	for (int i = 0; i < iterations; i++) {
+		int dst_fd = open(dst_path, O_RDWR | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+		if (dst_fd < 0) {
+			perror("open");
+			return -1;
+		}
+		if (drop_cache) {
+			posix_fadvise(src_fd, 0, 0, POSIX_FADV_DONTNEED);
+		}
+		struct jal_multi_digest *md = jal_multi_digest_create(&alg, 1);
+
+		double start = now_sec();
+		int err = jalls_copy_journal_fd(src_fd, dst_fd, size, md, zero_copy, &method, 0);
+		if (0 == err) {
+			err = jal_multi_digest_final(md) == JAL_OK ? 0 : -1;
+		}
+		double elapsed = now_sec() - start;
+
+		jal_multi_digest_destroy(&md);
+		close(dst_fd);
+		unlink(dst_path);
+		if (0 != err) {
+			fprintf(stderr, "copy failed\n");
+			return -1;
+		}
+		total += elapsed;
+		if (0 == i || elapsed < best) {
+			best = elapsed;
+		}
+	}
+
+	double mib = size / (1024.0 * 1024.0);
+	printf("%-16s %10.3f %10.3f %10.1f\n", jalls_copy_method_str(method),
+		best * 1000, total / iterations * 1000, mib / best);
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	static const char *optstring = "d:s:i:c";
+	static const struct option long_options[] = {
+		{"dir", required_argument, NULL, 'd'},
+		{"size", required_argument, NULL, 's'},
+		{"iterations", required_argument, NULL, 'i'},
+		{"drop-cache", no_argument, NULL, 'c'},
+		{0, 0, 0, 0} };
+	const char *dir = ".";
+	uint64_t size = (uint64_t)DEFAULT_SIZE_MB * 1024 * 1024;
+	int iterations = DEFAULT_ITERATIONS;
+	int drop_cache = 0;
+	int ret = EXIT_FAILURE;
+	int opt;
+
+	while (EOF != (opt = getopt_long(argc, argv, optstring, long_options, NULL))) {
+		switch (opt) {
+		case 'd':
+			dir = optarg;
+			break;
+		case 's':
+			size = strtoull(optarg, NULL, 10) * 1024 * 1024;
+			break;
+		case 'i':
+			iterations = atoi(optarg);
+			break;
+		case 'c':
+			drop_cache = 1;
+			break;
+		default:
+			print_usage();
+			return EXIT_FAILURE;
+		}
+	}
+	if (iterations <= 0) {
+		print_usage();
+		return EXIT_FAILURE;
+	}
+
+	char src_path[4096];
+	char dst_path[4096];
+	snprintf(src_path, sizeof(src_path), "%s/jalls_ingest_bench.src", dir);
+	snprintf(dst_path, sizeof(dst_path), "%s/jalls_ingest_bench.dst", dir);
+
+	int src_fd = create_journal(src_path, size);
+	if (src_fd < 0) {
+		perror("failed to create the journal");
+		return EXIT_FAILURE;
+	}
+
+	printf("journal size %" PRIu64 " MiB, %d iterations%s\n", size / (1024 * 1024),
+		iterations, drop_cache ? ", cold cache" : "");
+	printf("%-16s %10s %10s %10s\n", "method", "best ms", "mean ms", "MiB/s");
+	if (0 == run(dst_path, src_fd, size, 0, iterations, drop_cache) &&
+			0 == run(dst_path, src_fd, size, 1, iterations, drop_cache)) {
+		ret = EXIT_SUCCESS;
+	}
+
+	close(src_fd);
+	unlink(src_path);
+	return ret;
+}
@@ -0,0 +1,439 @@
+/**
+ * @file jalp_stress_bench.c Benchmark for producer threads sending log or
+ * audit records, sharing one jalp_context or using one each.
+ *
+ * @section LICENSE
+ *
+ * Source code in 3rd-party is licensed and owned by their respective
+ * copyright holders.
+ *
+ * All other source code is copyright Tresys Technology and licensed as below.
+ *
+ * Copyright (c) 2012 Tresys Technology LLC, Columbia, Maryland, USA
+ *
+ * This software was developed by Tresys Technology LLC
+ * with U.S. Government sponsorship.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include <jalop/jal_status.h>
+#include <jalop/jalp_audit.h>
+#include <jalop/jalp_context.h>
+#include <jalop/jalp_logger.h>
+
+#define DEFAULT_THREADS 8
+#define DEFAULT_RECORDS 20000
+#define DEFAULT_RECORD_SIZE 256
+/** The most connections the built in local store takes */
+#define MAX_STORE_CONNS 256
+#define MSG_HEADER_LEN 20
+#define BREAK_LEN 5
+
+enum bench_mode {
+	/** Every thread uses the same context */
+	MODE_SHARED,
+	/** Every thread uses the same context, one thread at a time */
+	MODE_LOCKED,
+	/** Every thread has a context of its own */
+	MODE_PER_THREAD,
+};
+
+static const char *mode_names[] = { "shared", "locked", "per-thread" };
+
+struct fake_store;
+
+struct store_conn {
+	struct fake_store *store;
+	int fd;
+	pthread_t drainer;
+};
+
+/** A local store that reads and counts records, and drops them */
+struct fake_store {
+	char dir[64];
+	char path[100];
+	int listen_fd;
+	pthread_t acceptor;
+	struct store_conn conns[MAX_STORE_CONNS];
+	int conn_count;
+	uint64_t records;
+};
+
+struct bench_thread {
+	pthread_t thread;
+	jalp_context *ctx;
+	pthread_mutex_t *lock;
+	int records;
+	uint8_t *record;
+	size_t record_len;
+	int audit;
+	enum jal_status err;
+};
+
+static void print_usage()
+{
+	static const char *usage =
+	"Usage:\n\
+	-t T, --threads=T	Number of sending threads. Defaults to 8.\n\
+	-n N, --records=N	Number of records each thread sends. Defaults to 20000.\n\
+	-s S, --size=S		Size of each log record in bytes. Defaults to 256.\n\
+	-a F, --audit=F		Send the XML document in F with jalp_audit, validated\n\
+				against the schemas, instead of log records.\n\
+	-x D, --schemas=D	The directory holding the JALoP schemas.\n\
+	-p P, --path=P		Send to the local store listening on P instead of\n\
+				the one built in. Records are then not counted.\n\n";
+
+	printf("%s\n", usage);
+}
+
+static double now_sec()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int read_all(int fd, uint8_t *buf, size_t len)
+{
+	while (len > 0) {
+		ssize_t n = read(fd, buf, len);
+		if (n < 0 && EINTR == errno) {
+			continue;
+		}
+		if (n <= 0) {
+			return -1;
+		}
+		buf += n;
+		len -= n;
+	}
+	return 0;
+}
+
+static int skip_all(int fd, uint64_t len)
+{
+	uint8_t buf[16384];
+	while (len > 0) {
+		size_t chunk = len < sizeof(buf) ? len : sizeof(buf);
+		if (0 != read_all(fd, buf, chunk)) {
+			return -1;
+		}
+		len -= chunk;
+	}
+	return 0;
+}
+
+static void *drain_conn(void *arg)
+{
+	struct store_conn *conn = arg;
+	uint8_t hdr[MSG_HEADER_LEN];
+	uint64_t data_len;
+	uint64_t meta_len;
+
+	while (0 == read_all(conn->fd, hdr, sizeof(hdr))) {
+		memcpy(&data_len, hdr + 4, sizeof(data_len));
+		memcpy(&meta_len, hdr + 12, sizeof(meta_len));
+		if (0 != skip_all(conn->fd, data_len + BREAK_LEN + meta_len + BREAK_LEN)) {
+			break;
+		}
+		__atomic_add_fetch(&conn->store->records, 1, __ATOMIC_RELAXED);
+	}
+	return NULL;
+}
+
+static void *accept_conns(void *arg)
+{
+	struct fake_store *store = arg;
+
+	while (store->conn_count < MAX_STORE_CONNS) {
+		int fd = accept(store->listen_fd, NULL, NULL);
+		if (-1 == fd) {
+			if (EINTR == errno) {
+				continue;
+			}
+			break;
+		}
+		struct store_conn *conn = &store->conns[store->conn_count];
+		conn->store = store;
+		conn->fd = fd;
+		if (0 != pthread_create(&conn->drainer, NULL, drain_conn, conn)) {
+			close(fd);
+			break;
+		}
+		store->conn_count++;
+	}
+	return NULL;
+}
+
+static int store_start(struct fake_store *store)
+{
+	struct sockaddr_un addr;
+
+	memset(store, 0, sizeof(*store));
+	strcpy(store->dir, "/tmp/jalp_stress_bench.XXXXXX");
+	if (!mkdtemp(store->dir)) {
+		return -1;
+	}
+	snprintf(store->path, sizeof(store->path), "%s/jalop.sock", store->dir);
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strncpy(addr.sun_path, store->path, sizeof(addr.sun_path) - 1);
+	store->listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (-1 == store->listen_fd ||
+			0 != bind(store->listen_fd, (struct sockaddr *) &addr, sizeof(addr)) ||
+			0 != listen(store->listen_fd, MAX_STORE_CONNS) ||
+			0 != pthread_create(&store->acceptor, NULL, accept_conns, store)) {
+		return -1;
+	}
+	return 0;
+}
+
+/**
+ * Stop taking connections and wait for the ones taken to be closed by
+ * the producer.
+ */
+static void store_stop(struct fake_store *store)
+{
+	shutdown(store->listen_fd, SHUT_RDWR);
+	pthread_join(store->acceptor, NULL);
+	close(store->listen_fd);
+	for (int i = 0; i < store->conn_count; i++) {
+		pthread_join(store->conns[i].drainer, NULL);
+		close(store->conns[i].fd);
+	}
+	unlink(store->path);
+	rmdir(store->dir);
+}
+
+static void *send_records(void *arg)
+{
+	struct bench_thread *t = arg;
+
+	for (int i = 0; i < t->records && JAL_OK == t->err; i++) {
+		if (t->lock) {
+			pthread_mutex_lock(t->lock);
+		}
+		if (t->audit) {
+			t->err = jalp_audit(t->ctx, NULL, t->record, t->record_len);
+		} else {
+			t->err = jalp_log(t->ctx, NULL, t->record, t->record_len);
+		}
+		if (t->lock) {
+			pthread_mutex_unlock(t->lock);
+		}
+	}
+	return NULL;
+}
+
+static jalp_context *make_context(const char *path, const char *schemas, int audit)
+{
+	jalp_context *ctx = jalp_context_create();
+	if (JAL_OK != jalp_context_init(ctx, path, NULL, "jalp_stress_bench", schemas)) {
+		jalp_context_destroy(&ctx);
+		return NULL;
+	}
+	if (audit) {
+		jalp_context_set_flag(ctx, JAF_VALIDATE_XML);
+	}
+	return ctx;
+}
+
+static int run(enum bench_mode mode, const char *path, const char *schemas,
+		int thread_count, int records, uint8_t *record, size_t record_len,
+		int audit, double *elapsed)
+{
+	struct bench_thread *threads = calloc(thread_count, sizeof(*threads));
+	pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+	jalp_context *shared = NULL;
+	int ret = 0;
+
+	if (MODE_PER_THREAD != mode) {
+		shared = make_context(path, schemas, audit);
+		if (!shared) {
+			free(threads);
+			return -1;
+		}
+	}
+	for (int i = 0; i < thread_count; i++) {
+		threads[i].ctx = shared ? shared : make_context(path, schemas, audit);
+		threads[i].lock = (MODE_LOCKED == mode) ? &lock : NULL;
+		threads[i].records = records;
+		threads[i].record = record;
+		threads[i].record_len = record_len;
+		threads[i].audit = audit;
+		threads[i].err = threads[i].ctx ? JAL_OK : JAL_E_INVAL;
+	}
+
+	double start = now_sec();
+	for (int i = 0; i < thread_count; i++) {
+		pthread_create(&threads[i].thread, NULL, send_records, &threads[i]);
+	}
+	for (int i = 0; i < thread_count; i++) {
+		pthread_join(threads[i].thread, NULL);
+	}
+	*elapsed = now_sec() - start;
+
+	for (int i = 0; i < thread_count; i++) {
+		if (JAL_OK != threads[i].err) {
+			fprintf(stderr, "%s: thread %d failed with %d\n",
+				mode_names[mode], i, threads[i].err);
+			ret = -1;
+		}
+		if (!shared) {
+			jalp_context_destroy(&threads[i].ctx);
+		}
+	}
+	jalp_context_destroy(&shared);
+	free(threads);
+	return ret;
+}
+
+static uint8_t *read_file(const char *name, size_t *len)
+{
+	FILE *f = fopen(name, "r");
+	struct stat st;
+	uint8_t *buf = NULL;
+
+	if (!f || 0 != fstat(fileno(f), &st) || 0 == st.st_size) {
+		goto out;
+	}
+	// jalp_audit() wants the document NUL terminated
+	buf = calloc(1, st.st_size + 1);
+	if (1 != fread(buf, st.st_size, 1, f)) {
+		free(buf);
+		buf = NULL;
+		goto out;
+	}
+	*len = st.st_size;
+out:
+	if (f) {
+		fclose(f);
+	}
+	return buf;
+}
+
+int main(int argc, char **argv)
+{
+	static const char *optstring = "t:n:s:a:x:p:";
+	static const struct option long_options[] = {
+		{"threads", required_argument, NULL, 't'},
+		{"records", required_argument, NULL, 'n'},
+		{"size", required_argument, NULL, 's'},
+		{"audit", required_argument, NULL, 'a'},
+		{"schemas", required_argument, NULL, 'x'},
+		{"path", required_argument, NULL, 'p'},
+		{0, 0, 0, 0} };
+	int thread_count = DEFAULT_THREADS;
+	int records = DEFAULT_RECORDS;
+	size_t record_len = DEFAULT_RECORD_SIZE;
+	const char *audit_file = NULL;
+	const char *schemas = SCHEMAS_ROOT;
+	const char *path = NULL;
+	uint8_t *record = NULL;
+	int ret = EXIT_SUCCESS;
+	int opt;
+
+	while (EOF != (opt = getopt_long(argc, argv, optstring, long_options, NULL))) {
+		switch (opt) {
+		case 't':
+			thread_count = atoi(optarg);
+			break;
+		case 'n':
+			records = atoi(optarg);
+			break;
+		case 's':
+			record_len = strtoull(optarg, NULL, 10);
+			break;
+		case 'a':
+			audit_file = optarg;
+			break;
+		case 'x':
+			schemas = optarg;
+			break;
+		case 'p':
+			path = optarg;
+			break;
+		default:
+			print_usage();
+			return EXIT_FAILURE;
+		}
+	}
+	if (thread_count <= 0 || thread_count > MAX_STORE_CONNS ||
+			records <= 0 || 0 == record_len) {
+		print_usage();
+		return EXIT_FAILURE;
+	}
+
+	if (audit_file) {
+		record = read_file(audit_file, &record_len);
+		if (!record) {
+			fprintf(stderr, "could not read %s\n", audit_file);
+			return EXIT_FAILURE;
+		}
+	} else {
+		record = malloc(record_len);
+		memset(record, 'x', record_len);
+	}
+
+	jalp_init();
+	printf("%d threads sending %d %s records of %zu bytes each\n",
+		thread_count, records, audit_file ? "validated audit" : "log", record_len);
+	printf("%-12s %12s %12s\n", "context", "records/s", "received");
+	for (int mode = MODE_SHARED; mode <= MODE_PER_THREAD; mode++) {
+		struct fake_store store;
+		double elapsed = 0;
+		int err;
+
+		if (!path && 0 != store_start(&store)) {
+			fprintf(stderr, "could not start the local store\n");
+			ret = EXIT_FAILURE;
+			break;
+		}
+		err = run(mode, path ? path : store.path, schemas, thread_count, records,
+			record, record_len, audit_file != NULL, &elapsed);
+		uint64_t sent = (uint64_t) thread_count * records;
+		if (!path) {
+			store_stop(&store);
+			if (store.records != sent) {
+				err = -1;
+			}
+		}
+		if (0 != err) {
+			ret = EXIT_FAILURE;
+		}
+		char received[32] = "-";
+		if (!path) {
+			snprintf(received, sizeof(received), "%llu",
+				(unsigned long long) store.records);
+		}
+		printf("%-12s %12.0f %12s\n", mode_names[mode], sent / elapsed, received);
+	}
+	jalp_shutdown();
+
+	free(record);
+	return ret;
+}
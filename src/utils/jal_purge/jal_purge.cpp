@@ -36,6 +36,7 @@
 #include <signal.h>
 
 #include "jaldb_context.hpp"
+#include "jaldb_datetime.h"
 #include "jaldb_record_dbs.h"
 #include "jaldb_serialize_record.h"
 #include "jaldb_utils.h"
@@ -330,12 +331,8 @@ enum jaldb_status iterate_by_timestamp(jaldb_context *ctx,
                 jaldb_iter_cb cb, void *up)
 {
         enum jaldb_status ret = JALDB_E_INVAL;
-        struct tm target_time, record_time;
-        memset(&target_time, 0, sizeof(target_time));
-        memset(&record_time, 0, sizeof(record_time));
-        int target_ms = 0;
-        int record_ms = 0;
-        char *tmp_time = NULL;
+        uint8_t target_key[JALDB_TIMESTAMP_KEY_LEN];
+        uint8_t record_key[JALDB_TIMESTAMP_KEY_LEN];
         struct jaldb_record *rec = NULL;
         int byte_swap = 0;
         struct jaldb_record_dbs *rdbs = NULL;
@@ -349,25 +346,16 @@ enum jaldb_status iterate_by_timestamp(jaldb_context *ctx,
         memset(&val, 0, sizeof(val));
         key.flags = DB_DBT_REALLOC;
         val.flags = DB_DBT_REALLOC;
-        time_t target_secs = 0;
         map<string, string> purge_map;
         char *path = NULL;
 
-        tmp_time = strptime(timestamp, "%Y-%m-%dT%H:%M:%S", &target_time);
-        if (!tmp_time) {
+        if (!timestamp ||
+                        JALDB_OK != jaldb_timestamp_key_encode(timestamp, strlen(timestamp), target_key)) {
                 fprintf(stderr, "ERROR: Invalid time format specified.\n");
                 ret = JALDB_E_INVAL_TIMESTAMP;
                 goto out;
         }
 
-        if (!sscanf(tmp_time,".%d-%*d:%*d", &target_ms)) {
-                fprintf(stderr, "ERROR: Invalid time format specified.\n");
-                ret = JALDB_E_INVAL_TIMESTAMP;
-                goto out;
-        }
-        // Calculate the target time in secs once before we start looping
-        target_secs = mktime(&target_time);
-
         if (!ctx || !cb) {
                 ret = JALDB_E_UNINITIALIZED;
                 goto out;
@@ -419,34 +407,17 @@ enum jaldb_status iterate_by_timestamp(jaldb_context *ctx,
                         goto out;
                 }
 
-                // mktime() like to set things like timezone to system timezone -
-                // need to clean out the tm struct before each call
-                memset(&record_time, 0, sizeof(record_time));
-
-                tmp_time = strptime((char*) key.data, "%Y-%m-%dT%H:%M:%S", &record_time);
-                if (!tmp_time) {
-                        fprintf(stderr, "ERROR: Cannot get strptime from record\n");
+                if (JALDB_OK != jaldb_record_dbs_timestamp_key(rdbs, &key, record_key)) {
+                        fprintf(stderr, "ERROR: Cannot get timestamp from record\n");
                         ret = JALDB_E_INVAL_TIMESTAMP;
                         goto out;
                 }
 
-                if (!sscanf(tmp_time,".%d-%*d:%*d", &record_ms)) {
-                        ret = JALDB_E_INVAL_TIMESTAMP;
-                        goto out;
-                }
-
-                double delta = difftime(target_secs,mktime(&record_time));
-                if (delta < 0) {
+                if (0 < memcmp(record_key, target_key, JALDB_TIMESTAMP_KEY_TIME_LEN)) {
                         // record_time is > target_time, so break out
                         goto out;
                 }
 
-                if (delta == 0) {
-                        if (record_ms > target_ms) {
-                                goto out;
-                        }
-                }
-
                 ret = jaldb_deserialize_record(byte_swap, (uint8_t*) val.data, val.size, &rec);
                 if (ret != JALDB_OK) {
                         goto out;
@@ -0,0 +1,199 @@
+/**
+ * @file jaldb_migrate.cpp This file contains the source for jaldb_migrate, which
+ * migrates the timestamp indices of a JALoP database to binary keys.
+ * @section LICENSE
+ *
+ * Source code in 3rd-party is licensed and owned by their respective
+ * copyright holders.
+ *
+ * All other source code is copyright Tresys Technology and licensed as below.
+ *
+ * Copyright (c) 2012-2014 Tresys Technology LLC, Columbia, Maryland, USA
+ *
+ * This software was developed by Tresys Technology LLC
+ * with U.S. Government sponsorship.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+
+
+#include <getopt.h>
+#include <inttypes.h>
+#include <jalop/jal_version.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "jaldb_context.h"
+#include "jaldb_status.h"
+
+#define DEFAULT_BATCH_SIZE 1000
+
+static struct global_args_t {
+	int check;
+	char type;
+	uint32_t batch_size;
+	char *home;
+} global_args;
+
+static void process_options(int argc, char **argv);
+__attribute__((noreturn)) static void usage();
+
+static const char *type_name(enum jaldb_rec_type type)
+{
+	switch (type) {
+	case JALDB_RTYPE_JOURNAL:
+		return "journal";
+	case JALDB_RTYPE_AUDIT:
+		return "audit";
+	case JALDB_RTYPE_LOG:
+		return "log";
+	default:
+		return "unknown";
+	}
+}
+
+static int migrate(jaldb_context *ctx, enum jaldb_rec_type type)
+{
+	int binary = 0;
+	uint64_t migrated = 0;
+	enum jaldb_status dbret;
+
+	dbret = jaldb_timestamp_keys_binary(ctx, type, &binary);
+	if (JALDB_OK != dbret) {
+		fprintf(stderr, "Failed to get the %s timestamp key format\n", type_name(type));
+		return -1;
+	}
+	if (binary) {
+		printf("%s: timestamp indices already use binary keys\n", type_name(type));
+		return 0;
+	}
+	if (global_args.check) {
+		printf("%s: timestamp indices use XML DateTime keys\n", type_name(type));
+		return 0;
+	}
+
+	dbret = jaldb_migrate_timestamp_keys(ctx, type, global_args.batch_size, &migrated);
+	if (JALDB_OK != dbret) {
+		fprintf(stderr, "Failed to migrate the %s timestamp indices (%d)\n",
+			type_name(type), dbret);
+		return -1;
+	}
+	printf("%s: indexed %" PRIu64 " records, binary keys are used from the next"
+		" time the database is opened\n", type_name(type), migrated);
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	enum jaldb_status dbret;
+	jaldb_context *ctx = NULL;
+	int ret = EXIT_FAILURE;
+	enum jaldb_rec_type types[] = { JALDB_RTYPE_JOURNAL, JALDB_RTYPE_AUDIT, JALDB_RTYPE_LOG };
+
+	process_options(argc, argv);
+
+	ctx = jaldb_context_create();
+	if (!ctx) {
+		fprintf(stderr, "Failed to create jaldb context\n");
+		goto out;
+	}
+
+	dbret = jaldb_context_init(ctx, global_args.home, global_args.check ? JDB_READONLY : JDB_NONE);
+	if (JALDB_OK != dbret) {
+		fprintf(stderr, "Failed to initialize jaldb context\n");
+		goto out;
+	}
+
+	ret = EXIT_SUCCESS;
+	for (size_t i = 0; i < sizeof(types) / sizeof(types[0]); i++) {
+		if (global_args.type && type_name(types[i])[0] != global_args.type) {
+			continue;
+		}
+		if (0 != migrate(ctx, types[i])) {
+			ret = EXIT_FAILURE;
+		}
+	}
+
+out:
+	jaldb_context_destroy(&ctx);
+	free(global_args.home);
+	return ret;
+}
+
+static void process_options(int argc, char **argv)
+{
+	int opt = 0;
+	static const char *opt_string = "t:b:h:cn";
+	static const struct option long_options[] = {
+		{"type", required_argument, NULL, 't'},
+		{"batch", required_argument, NULL, 'b'},
+		{"home", required_argument, NULL, 'h'},
+		{"check", no_argument, NULL, 'c'},
+		{"version", no_argument, NULL, 'n'},
+		{0, 0, 0, 0}
+	};
+
+	global_args.batch_size = DEFAULT_BATCH_SIZE;
+
+	while (EOF != (opt = getopt_long(argc, argv, opt_string, long_options, NULL))) {
+		switch (opt) {
+		case 't':
+			if ('j' != *optarg && 'a' != *optarg && 'l' != *optarg) {
+				usage();
+			}
+			global_args.type = *optarg;
+			break;
+		case 'b':
+			global_args.batch_size = (uint32_t) strtoul(optarg, NULL, 10);
+			if (0 == global_args.batch_size) {
+				usage();
+			}
+			break;
+		case 'h':
+			free(global_args.home);
+			global_args.home = strdup(optarg);
+			break;
+		case 'c':
+			global_args.check = 1;
+			break;
+		case 'n':
+			printf("%s", jal_version_as_string());
+			exit(0);
+		default:
+			usage();
+		}
+	}
+	if (optind < argc) {
+		usage();
+	}
+}
+
+__attribute__((noreturn)) static void usage()
+{
+	static const char *usage =
+	"Usage: jaldb_migrate [options]\n\
+	Rebuild the timestamp indices of a JALoP database with binary keys. The\n\
+	database may be in use while it is migrated, the JALoP processes switch\n\
+	to the new indices the next time they open the database.\n\n\
+	-t, --type=T		Only migrate one type of JAL record. 'T' may be 'j',\n\
+				'a', or 'l' for journal, audit, or logging, respectively.\n\
+				All types are migrated by default.\n\
+	-b, --batch=B		Number of records indexed per transaction, defaults to 1000.\n\
+	-c, --check		Only report which key format the indices use.\n\
+	-h, --home=H		Specify the root of the JALoP database,\n\
+				defaults to /var/lib/jalop/db\n\
+	-n, --version		Output the version information and exit.\n";
+	fprintf(stderr, "%s", usage);
+	exit(-1);
+}
@@ -409,7 +409,11 @@ static void do_work(void *ptr)
 	}
 	uuid_list.clear();
 
+	uint32_t insert_seq = 0;
 	while (mbrs->follow_flag && !exit_flag){
+		// Take the sequence number first so an insert that lands after
+		// the query still wakes us up
+		jaldb_get_insert_seq(mbrs->ctx, type, &insert_seq);
 		ret = jaldb_get_records_since_last_nonce(mbrs->ctx,
 						(char *) last_uuid.c_str(),
 						uuid_list,
@@ -425,7 +429,8 @@ static void do_work(void *ptr)
 		}
 
 		uuid_list.clear();
-		sleep(JALDB_TAIL_THREAD_SLEEP_SECONDS);
+		jaldb_wait_for_insert(mbrs->ctx, type, &insert_seq,
+				JALDB_TAIL_THREAD_SLEEP_SECONDS * 1000);
 	}
 	return;
 }